@@ -2,7 +2,10 @@
 #ifndef _ARCH_HALTPOLL_H
 #define _ARCH_HALTPOLL_H
 
+#include <linux/types.h>
+
 void arch_haltpoll_enable(unsigned int cpu);
 void arch_haltpoll_disable(unsigned int cpu);
+void arch_haltpoll_update(u64 poll_ns, u64 block_ns);
 
 #endif
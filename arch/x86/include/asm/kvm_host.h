@@ -964,6 +964,11 @@ struct kvm_vcpu_arch {
 
 	u64 msr_kvm_poll_control;
 
+	struct {
+		u64 msr_val;
+		struct gfn_to_hva_cache data;
+	} pv_poll_hint;
+
 	/* set at EPT violation at this point */
 	unsigned long exit_qualification;
 
@@ -220,6 +220,21 @@ static inline long arch_scale_freq_capacity(int cpu)
 }
 #define arch_scale_freq_capacity arch_scale_freq_capacity
 
+DECLARE_STATIC_KEY_FALSE(arch_freq_sensitivity_key);
+
+#define arch_freq_sensitivity_enabled() \
+	static_branch_unlikely(&arch_freq_sensitivity_key)
+
+DECLARE_PER_CPU(unsigned long, arch_freq_sensitivity);
+
+static inline unsigned long arch_scale_freq_sensitivity(int cpu)
+{
+	return per_cpu(arch_freq_sensitivity, cpu);
+}
+#define arch_scale_freq_sensitivity arch_scale_freq_sensitivity
+
+extern void arch_set_freq_sensitivity(bool enable);
+
 extern void arch_set_max_freq_ratio(bool turbo_disabled);
 extern void freq_invariance_set_perf_ratio(u64 ratio, bool turbo_disabled);
 #else
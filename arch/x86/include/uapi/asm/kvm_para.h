@@ -36,6 +36,7 @@
 #define KVM_FEATURE_MSI_EXT_DEST_ID	15
 #define KVM_FEATURE_HC_MAP_GPA_RANGE	16
 #define KVM_FEATURE_MIGRATION_CONTROL	17
+#define KVM_FEATURE_POLL_HINT		18
 
 #define KVM_HINTS_REALTIME      0
 
@@ -58,6 +59,7 @@
 #define MSR_KVM_ASYNC_PF_INT	0x4b564d06
 #define MSR_KVM_ASYNC_PF_ACK	0x4b564d07
 #define MSR_KVM_MIGRATION_CONTROL	0x4b564d08
+#define MSR_KVM_POLL_HINT	0x4b564d09
 
 struct kvm_steal_time {
 	__u64 steal;
@@ -84,6 +86,25 @@ struct kvm_clock_pairing {
 #define KVM_STEAL_VALID_BITS ((-1ULL << (KVM_STEAL_ALIGNMENT_BITS + 1)))
 #define KVM_STEAL_RESERVED_MASK (((1 << KVM_STEAL_ALIGNMENT_BITS) - 1 ) << 1)
 
+/*
+ * MSR_KVM_POLL_HINT: published by a guest that polls before halting.
+ * wake_hist[0] counts idle periods shorter than KVM_POLL_HINT_BASE_NS and
+ * wake_hist[i] the ones shorter than (KVM_POLL_HINT_BASE_NS << i), but not
+ * shorter than half of that, the last bucket collecting all of the longer ones.
+ */
+#define KVM_POLL_HINT_BUCKETS	8
+#define KVM_POLL_HINT_BASE_NS	8192
+
+struct kvm_poll_hint {
+	__u64 poll_ns;
+	__u32 wake_hist[KVM_POLL_HINT_BUCKETS];
+	__u32 pad[6];
+};
+
+#define KVM_POLL_HINT_ALIGNMENT_BITS 5
+#define KVM_POLL_HINT_VALID_BITS ((-1ULL << (KVM_POLL_HINT_ALIGNMENT_BITS + 1)))
+#define KVM_POLL_HINT_RESERVED_MASK (((1 << KVM_POLL_HINT_ALIGNMENT_BITS) - 1 ) << 1)
+
 #define KVM_MAX_MMU_OP_BATCH           32
 
 #define KVM_ASYNC_PF_ENABLED			(1 << 0)
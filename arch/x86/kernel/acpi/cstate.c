@@ -15,6 +15,7 @@
 #include <acpi/processor.h>
 #include <asm/mwait.h>
 #include <asm/special_insns.h>
+#include <asm/tsc.h>
 
 /*
  * Initialize bm_flags based on the CPU cache properties
@@ -215,6 +216,41 @@ void __cpuidle acpi_processor_ffh_cstate_enter(struct acpi_processor_cx *cx)
 }
 EXPORT_SYMBOL_GPL(acpi_processor_ffh_cstate_enter);
 
+/*
+ * The core C6 residency counter only advances while the core is in CC6, so it
+ * can be used to check whether or not FFH C-states requesting CC6 or deeper
+ * have actually been reached.
+ */
+static DEFINE_PER_CPU(u64, cc6_residency);
+
+bool acpi_processor_ffh_cstate_has_residency(struct acpi_processor_cx *cx)
+{
+	u64 val;
+
+	if (cx->entry_method != ACPI_CSTATE_FFH ||
+	    MWAIT_HINT2CSTATE(cx->address) < 2)
+		return false;
+
+	return boot_cpu_data.x86_vendor == X86_VENDOR_INTEL &&
+		boot_cpu_has(X86_FEATURE_CONSTANT_TSC) && tsc_khz &&
+		!rdmsrl_safe(MSR_CORE_C6_RESIDENCY, &val);
+}
+EXPORT_SYMBOL_GPL(acpi_processor_ffh_cstate_has_residency);
+
+bool acpi_processor_ffh_cstate_reached(struct acpi_processor_cx *cx,
+				       u64 residency_ns)
+{
+	u64 cc6, prev;
+
+	rdmsrl(MSR_CORE_C6_RESIDENCY, cc6);
+	prev = __this_cpu_read(cc6_residency);
+	__this_cpu_write(cc6_residency, cc6);
+
+	/* The counter runs at the TSC frequency. */
+	return mul_u64_u32_div(cc6 - prev, NSEC_PER_MSEC, tsc_khz) >= residency_ns / 2;
+}
+EXPORT_SYMBOL_GPL(acpi_processor_ffh_cstate_reached);
+
 static int __init ffh_cstate_init(void)
 {
 	struct cpuinfo_x86 *c = &boot_cpu_data;
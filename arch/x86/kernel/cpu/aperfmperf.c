@@ -6,12 +6,15 @@
  * Copyright (C) 2017 Intel Corp.
  * Author: Len Brown <len.brown@intel.com>
  */
+#include <linux/amd-pstate.h>
 #include <linux/cpufreq.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/ktime.h>
 #include <linux/math64.h>
 #include <linux/percpu.h>
 #include <linux/rcupdate.h>
+#include <linux/seq_file.h>
 #include <linux/sched/isolation.h>
 #include <linux/sched/topology.h>
 #include <linux/smp.h>
@@ -347,6 +350,90 @@ static DECLARE_WORK(disable_freq_invariance_work,
 
 DEFINE_PER_CPU(unsigned long, arch_freq_scale) = SCHED_CAPACITY_SCALE;
 
+/*
+ * Ticks with a frequency above the one corresponding to arch_max_freq_ratio,
+ * which get clipped, are counted in windows of FIE_CHECK_TICKS ticks.  If
+ * most of the ticks of a window got clipped, the maximum frequency assumed
+ * from the turbo ratio limits is too low for this system and the utilization
+ * of busy CPUs is underestimated.  With autocorrect set, arch_max_freq_ratio
+ * is then raised to the average ratio of the clipped ticks of the window.
+ */
+#define FIE_CHECK_TICKS		1024
+
+struct freq_invariance_stats {
+	unsigned int	ticks;
+	unsigned int	clipped;
+	u64		clipped_sum;
+	u64		max_ratio;	/* highest ratio seen, times 1024 */
+	unsigned long	clipped_total;
+};
+
+static DEFINE_PER_CPU(struct freq_invariance_stats, fie_stats);
+static bool fie_autocorrect;
+
+static void freq_invariance_check(u64 freq_scale)
+{
+	struct freq_invariance_stats *st = this_cpu_ptr(&fie_stats);
+	u64 max_ratio = READ_ONCE(arch_max_freq_ratio);
+
+	if (freq_scale > SCHED_CAPACITY_SCALE) {
+		u64 ratio = (freq_scale * max_ratio) >> SCHED_CAPACITY_SHIFT;
+
+		st->clipped++;
+		st->clipped_total++;
+		st->clipped_sum += ratio;
+		if (ratio > st->max_ratio)
+			st->max_ratio = ratio;
+	}
+
+	if (++st->ticks < FIE_CHECK_TICKS)
+		return;
+
+	if (READ_ONCE(fie_autocorrect) && st->clipped > FIE_CHECK_TICKS / 2) {
+		u64 ratio = div_u64(st->clipped_sum, st->clipped);
+
+		/* Only ever raise it, other CPUs may be doing the same */
+		while (ratio > max_ratio &&
+		       !try_cmpxchg64(&arch_max_freq_ratio, &max_ratio, ratio))
+			;
+	}
+
+	st->ticks = 0;
+	st->clipped = 0;
+	st->clipped_sum = 0;
+}
+
+static int freq_invariance_clipping_show(struct seq_file *m, void *unused)
+{
+	int cpu;
+
+	seq_puts(m, "cpu clipped_ticks max_ratio\n");
+	for_each_online_cpu(cpu) {
+		struct freq_invariance_stats *st = per_cpu_ptr(&fie_stats, cpu);
+
+		seq_printf(m, "%d %lu %llu\n", cpu, READ_ONCE(st->clipped_total),
+			   READ_ONCE(st->max_ratio));
+	}
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(freq_invariance_clipping);
+
+static int __init freq_invariance_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	if (!cpu_feature_enabled(X86_FEATURE_APERFMPERF))
+		return 0;
+
+	dir = debugfs_create_dir("freq_invariance", arch_debugfs_dir);
+	debugfs_create_u64("max_freq_ratio", 0444, dir, &arch_max_freq_ratio);
+	debugfs_create_bool("autocorrect", 0644, dir, &fie_autocorrect);
+	debugfs_create_file("clipping", 0444, dir, NULL,
+			    &freq_invariance_clipping_fops);
+	return 0;
+}
+late_initcall(freq_invariance_debugfs_init);
+
 static void scale_freq_tick(u64 acnt, u64 mcnt)
 {
 	u64 freq_scale;
@@ -364,6 +451,8 @@ static void scale_freq_tick(u64 acnt, u64 mcnt)
 	if (!freq_scale)
 		goto error;
 
+	freq_invariance_check(freq_scale);
+
 	if (freq_scale > SCHED_CAPACITY_SCALE)
 		freq_scale = SCHED_CAPACITY_SCALE;
 
@@ -374,9 +463,85 @@ static void scale_freq_tick(u64 acnt, u64 mcnt)
 	pr_warn("Scheduler frequency invariance went wobbly, disabling!\n");
 	schedule_work(&disable_freq_invariance_work);
 }
+
+/*
+ * Frequency sensitivity from the AMD frequency feedback counters, sampled on
+ * every tick while a user of arch_scale_freq_sensitivity() has asked for it
+ * with arch_set_freq_sensitivity().
+ */
+DEFINE_STATIC_KEY_FALSE(arch_freq_sensitivity_key);
+static bool freq_sensitivity_supported __ro_after_init;
+static atomic_t freq_sensitivity_users;
+static DEFINE_PER_CPU(struct amd_freq_sensitivity, fs_samples);
+DEFINE_PER_CPU(unsigned long, arch_freq_sensitivity) = SCHED_CAPACITY_SCALE;
+
+static void __init bp_init_freq_sensitivity(void)
+{
+	if (boot_cpu_has(X86_FEATURE_PROC_FEEDBACK) &&
+	    amd_freq_sensitivity_present())
+		freq_sensitivity_supported = true;
+}
+
+static void freq_sensitivity_workfn(struct work_struct *work)
+{
+	int cpu;
+
+	if (atomic_read(&freq_sensitivity_users)) {
+		static_branch_enable(&arch_freq_sensitivity_key);
+		return;
+	}
+
+	static_branch_disable(&arch_freq_sensitivity_key);
+	/* Wait for the ticks still updating the values before resetting them */
+	synchronize_rcu();
+	for_each_possible_cpu(cpu)
+		per_cpu(arch_freq_sensitivity, cpu) = SCHED_CAPACITY_SCALE;
+}
+
+static DECLARE_WORK(freq_sensitivity_work, freq_sensitivity_workfn);
+
+/**
+ * arch_set_freq_sensitivity - Start or stop estimating the frequency sensitivity.
+ * @enable: Whether the caller starts or stops using the estimate.
+ *
+ * The counters are only sampled on the tick while there is at least one user.
+ * The static key cannot be switched from every caller's context, so that is
+ * done asynchronously.
+ */
+void arch_set_freq_sensitivity(bool enable)
+{
+	if (!freq_sensitivity_supported)
+		return;
+
+	if (enable ? atomic_inc_return(&freq_sensitivity_users) == 1 :
+		     atomic_dec_and_test(&freq_sensitivity_users))
+		schedule_work(&freq_sensitivity_work);
+}
+
+static void sensitivity_tick(void)
+{
+	struct amd_freq_sensitivity *s = this_cpu_ptr(&fs_samples);
+	u64 actual, reference;
+	int sens;
+
+	if (!static_branch_unlikely(&arch_freq_sensitivity_key))
+		return;
+
+	rdmsrl(MSR_AMD64_FREQ_SENSITIVITY_ACTUAL, actual);
+	rdmsrl(MSR_AMD64_FREQ_SENSITIVITY_REFERENCE, reference);
+
+	/* Keep the last value if a counter wrapped around or did not move */
+	sens = amd_freq_sensitivity_update(s, actual, reference);
+	if (sens >= 0)
+		this_cpu_write(arch_freq_sensitivity,
+			       div_u64((u64)sens << SCHED_CAPACITY_SHIFT,
+				       AMD_FREQ_SENSITIVITY_MAX));
+}
 #else
 static inline void bp_init_freq_invariance(void) { }
 static inline void scale_freq_tick(u64 acnt, u64 mcnt) { }
+static inline void bp_init_freq_sensitivity(void) { }
+static inline void sensitivity_tick(void) { }
 #endif /* CONFIG_X86_64 && CONFIG_SMP */
 
 void arch_scale_freq_tick(void)
@@ -402,6 +567,7 @@ void arch_scale_freq_tick(void)
 	raw_write_seqcount_end(&s->seq);
 
 	scale_freq_tick(acnt, mcnt);
+	sensitivity_tick();
 }
 
 /*
@@ -411,6 +577,18 @@ void arch_scale_freq_tick(void)
  */
 #define MAX_SAMPLE_AGE	((unsigned long)HZ / 50)
 
+/**
+ * arch_freq_get_on_cpu - Return the effective frequency of a CPU.
+ * @cpu: Target CPU.
+ *
+ * The frequency is computed from the APERF and MPERF deltas sampled by the
+ * scheduler tick on @cpu, so this never interrupts @cpu and is cheap enough to
+ * be called for all CPUs periodically (e.g. through scaling_cur_freq in
+ * sysfs).  The value reflects the last tick period that ended at most
+ * MAX_SAMPLE_AGE ago.  If there is no such sample, because @cpu has not run
+ * the tick recently (it is idle or running in the NOHZ full mode), the last
+ * frequency known to cpufreq or the base frequency is returned instead.
+ */
 unsigned int arch_freq_get_on_cpu(int cpu)
 {
 	struct aperfmperf *s = per_cpu_ptr(&cpu_samples, cpu);
@@ -449,6 +627,7 @@ static int __init bp_init_aperfmperf(void)
 
 	init_counter_refs();
 	bp_init_freq_invariance();
+	bp_init_freq_sensitivity();
 	return 0;
 }
 early_initcall(bp_init_aperfmperf);
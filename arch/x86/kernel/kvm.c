@@ -70,6 +70,30 @@ DEFINE_PER_CPU_DECRYPTED(struct kvm_steal_time, steal_time) __aligned(64) __visi
 static int has_steal_clock = 0;
 
 static int has_guest_poll = 0;
+
+#ifdef CONFIG_ARCH_CPUIDLE_HALTPOLL
+static DEFINE_PER_CPU_DECRYPTED(struct kvm_poll_hint, poll_hint) __aligned(64);
+static DEFINE_PER_CPU(bool, poll_hint_enabled);
+
+static void kvm_register_poll_hint(void)
+{
+	struct kvm_poll_hint *hint = this_cpu_ptr(&poll_hint);
+
+	if (!__this_cpu_read(poll_hint_enabled))
+		return;
+
+	wrmsrl(MSR_KVM_POLL_HINT, slow_virt_to_phys(hint) | KVM_MSR_ENABLED);
+}
+
+static void kvm_disable_poll_hint(void)
+{
+	if (__this_cpu_read(poll_hint_enabled))
+		wrmsrl(MSR_KVM_POLL_HINT, 0);
+}
+#else
+static inline void kvm_register_poll_hint(void) { }
+static inline void kvm_disable_poll_hint(void) { }
+#endif
 /*
  * No need for any "IO delay" on KVM
  */
@@ -379,6 +403,8 @@ static void kvm_guest_cpu_init(void)
 
 	if (has_steal_clock)
 		kvm_register_steal_time();
+
+	kvm_register_poll_hint();
 }
 
 static void kvm_pv_disable_apf(void)
@@ -441,6 +467,9 @@ static void __init sev_map_percpu_data(void)
 		__set_percpu_decrypted(&per_cpu(apf_reason, cpu), sizeof(apf_reason));
 		__set_percpu_decrypted(&per_cpu(steal_time, cpu), sizeof(steal_time));
 		__set_percpu_decrypted(&per_cpu(kvm_apic_eoi, cpu), sizeof(kvm_apic_eoi));
+#ifdef CONFIG_ARCH_CPUIDLE_HALTPOLL
+		__set_percpu_decrypted(&per_cpu(poll_hint, cpu), sizeof(poll_hint));
+#endif
 	}
 }
 
@@ -452,6 +481,7 @@ static void kvm_guest_cpu_offline(bool shutdown)
 	if (kvm_para_has_feature(KVM_FEATURE_MIGRATION_CONTROL))
 		wrmsrl(MSR_KVM_MIGRATION_CONTROL, 0);
 	kvm_pv_disable_apf();
+	kvm_disable_poll_hint();
 	if (!shutdown)
 		apf_task_wake_all();
 	kvmclock_disable();
@@ -1127,8 +1157,29 @@ static void kvm_enable_host_haltpoll(void *i)
 	wrmsrl(MSR_KVM_POLL_CONTROL, 1);
 }
 
+static void kvm_enable_guest_poll_hint(void *i)
+{
+	__this_cpu_write(poll_hint_enabled, true);
+	kvm_register_poll_hint();
+}
+
+static void kvm_disable_guest_poll_hint(void *i)
+{
+	kvm_disable_poll_hint();
+	__this_cpu_write(poll_hint_enabled, false);
+}
+
 void arch_haltpoll_enable(unsigned int cpu)
 {
+	/*
+	 * If the host can take the guest poll window into account, publish it
+	 * instead of disabling host halt polling altogether.
+	 */
+	if (kvm_para_has_feature(KVM_FEATURE_POLL_HINT)) {
+		smp_call_function_single(cpu, kvm_enable_guest_poll_hint, NULL, 1);
+		return;
+	}
+
 	if (!kvm_para_has_feature(KVM_FEATURE_POLL_CONTROL)) {
 		pr_err_once("host does not support poll control\n");
 		pr_err_once("host upgrade recommended\n");
@@ -1142,6 +1193,11 @@ EXPORT_SYMBOL_GPL(arch_haltpoll_enable);
 
 void arch_haltpoll_disable(unsigned int cpu)
 {
+	if (kvm_para_has_feature(KVM_FEATURE_POLL_HINT)) {
+		smp_call_function_single(cpu, kvm_disable_guest_poll_hint, NULL, 1);
+		return;
+	}
+
 	if (!kvm_para_has_feature(KVM_FEATURE_POLL_CONTROL))
 		return;
 
@@ -1149,4 +1205,25 @@ void arch_haltpoll_disable(unsigned int cpu)
 	smp_call_function_single(cpu, kvm_enable_host_haltpoll, NULL, 1);
 }
 EXPORT_SYMBOL_GPL(arch_haltpoll_disable);
+
+/*
+ * Publish the current poll window of this CPU and the duration of its last
+ * idle period to the host.  Called with interrupts disabled.
+ */
+void arch_haltpoll_update(u64 poll_ns, u64 block_ns)
+{
+	struct kvm_poll_hint *hint = this_cpu_ptr(&poll_hint);
+	unsigned int bucket = 0;
+
+	if (!__this_cpu_read(poll_hint_enabled))
+		return;
+
+	if (block_ns >= KVM_POLL_HINT_BASE_NS)
+		bucket = min_t(unsigned int, ilog2(block_ns / KVM_POLL_HINT_BASE_NS) + 1,
+			       KVM_POLL_HINT_BUCKETS - 1);
+
+	WRITE_ONCE(hint->poll_ns, poll_ns);
+	WRITE_ONCE(hint->wake_hist[bucket], hint->wake_hist[bucket] + 1);
+}
+EXPORT_SYMBOL_GPL(arch_haltpoll_update);
 #endif
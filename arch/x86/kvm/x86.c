@@ -1564,6 +1564,7 @@ static const u32 emulated_msrs_all[] = {
 
 	MSR_K7_HWCR,
 	MSR_KVM_POLL_CONTROL,
+	MSR_KVM_POLL_HINT,
 };
 
 static u32 emulated_msrs[ARRAY_SIZE(emulated_msrs_all)];
@@ -3888,6 +3889,22 @@ int kvm_set_msr_common(struct kvm_vcpu *vcpu, struct msr_data *msr_info)
 		vcpu->arch.msr_kvm_poll_control = data;
 		break;
 
+	case MSR_KVM_POLL_HINT:
+		if (!guest_pv_has(vcpu, KVM_FEATURE_POLL_HINT))
+			return 1;
+
+		if (data & KVM_POLL_HINT_RESERVED_MASK)
+			return 1;
+
+		if ((data & KVM_MSR_ENABLED) &&
+		    kvm_gfn_to_hva_cache_init(vcpu->kvm, &vcpu->arch.pv_poll_hint.data,
+					      data & KVM_POLL_HINT_VALID_BITS,
+					      sizeof(struct kvm_poll_hint)))
+			return 1;
+
+		vcpu->arch.pv_poll_hint.msr_val = data;
+		break;
+
 	case MSR_IA32_MCG_CTL:
 	case MSR_IA32_MCG_STATUS:
 	case MSR_IA32_MC0_CTL ... MSR_IA32_MCx_CTL(KVM_MAX_MCE_BANKS) - 1:
@@ -4243,6 +4260,12 @@ int kvm_get_msr_common(struct kvm_vcpu *vcpu, struct msr_data *msr_info)
 
 		msr_info->data = vcpu->arch.msr_kvm_poll_control;
 		break;
+	case MSR_KVM_POLL_HINT:
+		if (!guest_pv_has(vcpu, KVM_FEATURE_POLL_HINT))
+			return 1;
+
+		msr_info->data = vcpu->arch.pv_poll_hint.msr_val;
+		break;
 	case MSR_IA32_P5_MC_ADDR:
 	case MSR_IA32_P5_MC_TYPE:
 	case MSR_IA32_MCG_CAP:
@@ -12049,6 +12072,7 @@ void kvm_vcpu_reset(struct kvm_vcpu *vcpu, bool init_event)
 	vcpu->arch.apf.msr_en_val = 0;
 	vcpu->arch.apf.msr_int_val = 0;
 	vcpu->arch.st.msr_val = 0;
+	vcpu->arch.pv_poll_hint.msr_val = 0;
 
 	kvmclock_reset(vcpu);
 
@@ -13276,9 +13300,35 @@ bool kvm_vector_hashing_enabled(void)
 	return vector_hashing;
 }
 
+/*
+ * If the guest has published a poll window at least as long as the longest
+ * one the host would use, the guest has already polled for as long as the host
+ * would, so polling in the host would be redundant.
+ */
+static bool kvm_guest_poll_covers_host(struct kvm_vcpu *vcpu)
+{
+	struct gfn_to_hva_cache *ghc = &vcpu->arch.pv_poll_hint.data;
+	u64 poll_ns;
+	int idx, ret;
+
+	if (!(vcpu->arch.pv_poll_hint.msr_val & KVM_MSR_ENABLED))
+		return false;
+
+	idx = srcu_read_lock(&vcpu->kvm->srcu);
+	ret = kvm_read_guest_offset_cached(vcpu->kvm, ghc, &poll_ns,
+					   offsetof(struct kvm_poll_hint, poll_ns),
+					   sizeof(poll_ns));
+	srcu_read_unlock(&vcpu->kvm->srcu, idx);
+
+	return !ret && poll_ns >= kvm_vcpu_max_halt_poll_ns(vcpu);
+}
+
 bool kvm_arch_no_poll(struct kvm_vcpu *vcpu)
 {
-	return (vcpu->arch.msr_kvm_poll_control & 1) == 0;
+	if ((vcpu->arch.msr_kvm_poll_control & 1) == 0)
+		return true;
+
+	return kvm_guest_poll_covers_host(vcpu);
 }
 EXPORT_SYMBOL_GPL(kvm_arch_no_poll);
 
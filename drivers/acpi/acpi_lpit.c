@@ -8,6 +8,7 @@
 
 #include <linux/cpu.h>
 #include <linux/acpi.h>
+#include <linux/suspend.h>
 #include <asm/msr.h>
 #include <asm/tsc.h>
 #include "internal.h"
@@ -95,6 +96,55 @@ int lpit_read_residency_count_address(u64 *address)
 }
 EXPORT_SYMBOL_GPL(lpit_read_residency_count_address);
 
+/* Residency counters at suspend-to-idle entry, U64_MAX if not available */
+static u64 lpit_s2idle_sys_us = U64_MAX;
+static u64 lpit_s2idle_cpu_us = U64_MAX;
+
+static u64 lpit_snapshot_us(bool io_mem)
+{
+	u64 counter;
+
+	if (io_mem ? !residency_info_mem.iomem_addr :
+		     !residency_info_ffh.gaddr.address)
+		return U64_MAX;
+
+	if (lpit_read_residency_counter_us(&counter, io_mem))
+		return U64_MAX;
+
+	return counter;
+}
+
+static u64 lpit_delta_us(u64 start, u64 end)
+{
+	/* Treat a counter that has wrapped or failed as not available. */
+	if (start == U64_MAX || end == U64_MAX || end < start)
+		return U64_MAX;
+
+	return end - start;
+}
+
+/* Called on suspend-to-idle entry, after the LPS0 entry notification. */
+void lpit_s2idle_prepare(void)
+{
+	lpit_s2idle_sys_us = lpit_snapshot_us(true);
+	lpit_s2idle_cpu_us = lpit_snapshot_us(false);
+}
+
+/*
+ * Called on resume from suspend-to-idle, before the LPS0 exit notification,
+ * to report how much the residency counters have grown in between.
+ */
+void lpit_s2idle_restore(void)
+{
+	u64 sys_us = lpit_delta_us(lpit_s2idle_sys_us, lpit_snapshot_us(true));
+	u64 cpu_us = lpit_delta_us(lpit_s2idle_cpu_us, lpit_snapshot_us(false));
+
+	if (sys_us == U64_MAX && cpu_us == U64_MAX)
+		return;
+
+	pm_report_lpi_residency(sys_us, cpu_us);
+}
+
 static void lpit_update_residency(struct lpit_residency_info *info,
 				 struct acpi_lpit_native *lpit_native)
 {
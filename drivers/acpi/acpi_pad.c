@@ -10,264 +10,226 @@
 #include <linux/module.h>
 #include <linux/init.h>
 #include <linux/types.h>
-#include <linux/kthread.h>
-#include <uapi/linux/sched/types.h>
-#include <linux/freezer.h>
 #include <linux/cpu.h>
-#include <linux/tick.h>
 #include <linux/slab.h>
 #include <linux/acpi.h>
-#include <linux/perf_event.h>
-#include <asm/mwait.h>
+#include <linux/idle_inject.h>
+#include <linux/workqueue.h>
 #include <xen/xen.h>
 
 #define ACPI_PROCESSOR_AGGREGATOR_CLASS	"acpi_pad"
 #define ACPI_PROCESSOR_AGGREGATOR_DEVICE_NAME "Processor Aggregator"
 #define ACPI_PROCESSOR_AGGREGATOR_NOTIFY 0x80
 static DEFINE_MUTEX(isolated_cpus_lock);
-static DEFINE_MUTEX(round_robin_lock);
 
-static unsigned long power_saving_mwait_eax;
-
-static unsigned char tsc_detected_unstable;
-static unsigned char tsc_marked_unstable;
-
-static void power_saving_mwait_init(void)
-{
-	unsigned int eax, ebx, ecx, edx;
-	unsigned int highest_cstate = 0;
-	unsigned int highest_subcstate = 0;
-	int i;
-
-	if (!boot_cpu_has(X86_FEATURE_MWAIT))
-		return;
-	if (boot_cpu_data.cpuid_level < CPUID_MWAIT_LEAF)
-		return;
-
-	cpuid(CPUID_MWAIT_LEAF, &eax, &ebx, &ecx, &edx);
-
-	if (!(ecx & CPUID5_ECX_EXTENSIONS_SUPPORTED) ||
-	    !(ecx & CPUID5_ECX_INTERRUPT_BREAK))
-		return;
+/*
+ * The idle demand of the platform is met by idle injection on the requested
+ * number of CPUs: each of them is idled, in the deepest idle state cpuidle
+ * has for it, for (100 - idlepct)% of every cycle.  The set of CPUs moves on
+ * every rrtime seconds, so that the idling is spread over all of them.
+ *
+ * Every CPU has its own idle injection device, so that moving the injection
+ * does not need to register new devices.  The devices are registered when the
+ * idling starts and unregistered when it stops.  CPUs used by another idle
+ * injection user at that time are skipped.
+ */
+#define PAD_CYCLE_US	(100 * USEC_PER_MSEC)
 
-	edx >>= MWAIT_SUBSTATE_SIZE;
-	for (i = 0; i < 7 && edx; i++, edx >>= MWAIT_SUBSTATE_SIZE) {
-		if (edx & MWAIT_SUBSTATE_MASK) {
-			highest_cstate = i;
-			highest_subcstate = edx & MWAIT_SUBSTATE_MASK;
-		}
-	}
-	power_saving_mwait_eax = (highest_cstate << MWAIT_SUBSTATE_SIZE) |
-		(highest_subcstate - 1);
-
-#if defined(CONFIG_X86)
-	switch (boot_cpu_data.x86_vendor) {
-	case X86_VENDOR_HYGON:
-	case X86_VENDOR_AMD:
-	case X86_VENDOR_INTEL:
-	case X86_VENDOR_ZHAOXIN:
-	case X86_VENDOR_CENTAUR:
-		/*
-		 * AMD Fam10h TSC will tick in all
-		 * C/P/S0/S1 states when this bit is set.
-		 */
-		if (!boot_cpu_has(X86_FEATURE_NONSTOP_TSC))
-			tsc_detected_unstable = 1;
-		break;
-	default:
-		/* TSC could halt in idle */
-		tsc_detected_unstable = 1;
-	}
-#endif
-}
+static unsigned int idle_pct = 5; /* percentage */
+static unsigned int round_robin_time = 1; /* second */
 
 static unsigned long cpu_weight[NR_CPUS];
-static int tsk_in_cpu[NR_CPUS] = {[0 ... NR_CPUS-1] = -1};
 static DECLARE_BITMAP(pad_busy_cpus_bits, NR_CPUS);
-static void round_robin_cpu(unsigned int tsk_index)
+static unsigned int pad_num_cpus;
+static struct idle_inject_device *pad_ii_devs[NR_CPUS];
+static bool pad_ii_registered;
+
+static void acpi_pad_rotate(struct work_struct *work);
+static DECLARE_DELAYED_WORK(pad_rotate_work, acpi_pad_rotate);
+
+/*
+ * Pick the @num least idled online CPUs with an idle injection device so far,
+ * avoiding HT siblings if possible.
+ */
+static void acpi_pad_pick_cpus(unsigned int num, struct cpumask *mask)
 {
-	struct cpumask *pad_busy_cpus = to_cpumask(pad_busy_cpus_bits);
-	cpumask_var_t tmp;
+	cpumask_var_t avail, tmp;
 	int cpu;
-	unsigned long min_weight = -1;
-	unsigned long preferred_cpu;
 
-	if (!alloc_cpumask_var(&tmp, GFP_KERNEL))
-		return;
+	cpumask_clear(mask);
 
-	mutex_lock(&round_robin_lock);
-	cpumask_clear(tmp);
-	for_each_cpu(cpu, pad_busy_cpus)
-		cpumask_or(tmp, tmp, topology_sibling_cpumask(cpu));
-	cpumask_andnot(tmp, cpu_online_mask, tmp);
-	/* avoid HT sibilings if possible */
-	if (cpumask_empty(tmp))
-		cpumask_andnot(tmp, cpu_online_mask, pad_busy_cpus);
-	if (cpumask_empty(tmp)) {
-		mutex_unlock(&round_robin_lock);
-		free_cpumask_var(tmp);
+	if (!alloc_cpumask_var(&avail, GFP_KERNEL))
 		return;
-	}
-	for_each_cpu(cpu, tmp) {
-		if (cpu_weight[cpu] < min_weight) {
-			min_weight = cpu_weight[cpu];
-			preferred_cpu = cpu;
-		}
+
+	if (!alloc_cpumask_var(&tmp, GFP_KERNEL))
+		goto free_avail;
+
+	cpumask_clear(avail);
+	for_each_online_cpu(cpu) {
+		if (pad_ii_devs[cpu])
+			cpumask_set_cpu(cpu, avail);
 	}
 
-	if (tsk_in_cpu[tsk_index] != -1)
-		cpumask_clear_cpu(tsk_in_cpu[tsk_index], pad_busy_cpus);
-	tsk_in_cpu[tsk_index] = preferred_cpu;
-	cpumask_set_cpu(preferred_cpu, pad_busy_cpus);
-	cpu_weight[preferred_cpu]++;
-	mutex_unlock(&round_robin_lock);
+	while (num--) {
+		unsigned long min_weight = -1;
+		unsigned long preferred_cpu;
+
+		cpumask_clear(tmp);
+		for_each_cpu(cpu, mask)
+			cpumask_or(tmp, tmp, topology_sibling_cpumask(cpu));
+		cpumask_andnot(tmp, avail, tmp);
+		if (cpumask_empty(tmp))
+			cpumask_andnot(tmp, avail, mask);
+		if (cpumask_empty(tmp))
+			break;
+
+		for_each_cpu(cpu, tmp) {
+			if (cpu_weight[cpu] < min_weight) {
+				min_weight = cpu_weight[cpu];
+				preferred_cpu = cpu;
+			}
+		}
 
-	set_cpus_allowed_ptr(current, cpumask_of(preferred_cpu));
+		cpumask_set_cpu(preferred_cpu, mask);
+		cpu_weight[preferred_cpu]++;
+	}
 
 	free_cpumask_var(tmp);
+free_avail:
+	free_cpumask_var(avail);
 }
 
-static void exit_round_robin(unsigned int tsk_index)
+static void acpi_pad_set_duration(int cpu)
 {
-	struct cpumask *pad_busy_cpus = to_cpumask(pad_busy_cpus_bits);
-
-	cpumask_clear_cpu(tsk_in_cpu[tsk_index], pad_busy_cpus);
-	tsk_in_cpu[tsk_index] = -1;
+	idle_inject_set_duration(pad_ii_devs[cpu],
+				 PAD_CYCLE_US * idle_pct / 100,
+				 PAD_CYCLE_US * (100 - idle_pct) / 100);
 }
 
-static unsigned int idle_pct = 5; /* percentage */
-static unsigned int round_robin_time = 1; /* second */
-static int power_saving_thread(void *data)
+static void acpi_pad_register(void)
 {
-	int do_sleep;
-	unsigned int tsk_index = (unsigned long)data;
-	u64 last_jiffies = 0;
-
-	sched_set_fifo_low(current);
-
-	while (!kthread_should_stop()) {
-		unsigned long expire_time;
-
-		/* round robin to cpus */
-		expire_time = last_jiffies + round_robin_time * HZ;
-		if (time_before(expire_time, jiffies)) {
-			last_jiffies = jiffies;
-			round_robin_cpu(tsk_index);
-		}
+	cpumask_var_t mask, conflict;
+	int cpu;
 
-		do_sleep = 0;
+	if (!zalloc_cpumask_var(&mask, GFP_KERNEL))
+		return;
 
-		expire_time = jiffies + HZ * (100 - idle_pct) / 100;
+	if (!zalloc_cpumask_var(&conflict, GFP_KERNEL))
+		goto free_mask;
 
-		while (!need_resched()) {
-			if (tsc_detected_unstable && !tsc_marked_unstable) {
-				/* TSC could halt in idle, so notify users */
-				mark_tsc_unstable("TSC halts in idle");
-				tsc_marked_unstable = 1;
-			}
-			local_irq_disable();
+	for_each_possible_cpu(cpu) {
+		cpumask_set_cpu(cpu, mask);
+		pad_ii_devs[cpu] = idle_inject_register(mask);
+		cpumask_clear_cpu(cpu, mask);
 
-			perf_lopwr_cb(true);
+		if (pad_ii_devs[cpu])
+			acpi_pad_set_duration(cpu);
+		else
+			cpumask_set_cpu(cpu, conflict);
+	}
 
-			tick_broadcast_enable();
-			tick_broadcast_enter();
-			stop_critical_timings();
+	if (!cpumask_empty(conflict))
+		pr_warn("Idle injection not available on CPUs %*pbl, not idling them\n",
+			cpumask_pr_args(conflict));
 
-			mwait_idle_with_hints(power_saving_mwait_eax, 1);
+	pad_ii_registered = true;
 
-			start_critical_timings();
-			tick_broadcast_exit();
+	free_cpumask_var(conflict);
+free_mask:
+	free_cpumask_var(mask);
+}
 
-			perf_lopwr_cb(false);
+static void acpi_pad_unregister(void)
+{
+	int cpu;
 
-			local_irq_enable();
+	for_each_possible_cpu(cpu) {
+		if (!pad_ii_devs[cpu])
+			continue;
 
-			if (time_before(expire_time, jiffies)) {
-				do_sleep = 1;
-				break;
-			}
-		}
-
-		/*
-		 * current sched_rt has threshold for rt task running time.
-		 * When a rt task uses 95% CPU time, the rt thread will be
-		 * scheduled out for 5% CPU time to not starve other tasks. But
-		 * the mechanism only works when all CPUs have RT task running,
-		 * as if one CPU hasn't RT task, RT task from other CPUs will
-		 * borrow CPU time from this CPU and cause RT task use > 95%
-		 * CPU time. To make 'avoid starvation' work, takes a nap here.
-		 */
-		if (unlikely(do_sleep))
-			schedule_timeout_killable(HZ * idle_pct / 100);
-
-		/* If an external event has set the need_resched flag, then
-		 * we need to deal with it, or this loop will continue to
-		 * spin without calling __mwait().
-		 */
-		if (unlikely(need_resched()))
-			schedule();
+		idle_inject_unregister(pad_ii_devs[cpu]);
+		pad_ii_devs[cpu] = NULL;
 	}
 
-	exit_round_robin(tsk_index);
-	return 0;
+	cpumask_clear(to_cpumask(pad_busy_cpus_bits));
+	pad_ii_registered = false;
 }
 
-static struct task_struct *ps_tsks[NR_CPUS];
-static unsigned int ps_tsk_num;
-static int create_power_saving_task(void)
+/*
+ * Move the idle injection to the next set of pad_num_cpus CPUs.
+ *
+ * The injection is restarted on all of the CPUs in the set, including the ones
+ * that were in the previous set, and they are started back to back, so that
+ * their idle periods are aligned and they can enter package idle states
+ * together.  The cycles have the same length everywhere, so they stay aligned
+ * until the next rotation.
+ */
+static void acpi_pad_update_cpus(void)
 {
-	int rc;
-
-	ps_tsks[ps_tsk_num] = kthread_run(power_saving_thread,
-		(void *)(unsigned long)ps_tsk_num,
-		"acpi_pad/%d", ps_tsk_num);
-
-	if (IS_ERR(ps_tsks[ps_tsk_num])) {
-		rc = PTR_ERR(ps_tsks[ps_tsk_num]);
-		ps_tsks[ps_tsk_num] = NULL;
-	} else {
-		rc = 0;
-		ps_tsk_num++;
-	}
+	struct cpumask *pad_busy_cpus = to_cpumask(pad_busy_cpus_bits);
+	int cpu;
 
-	return rc;
-}
+	/*
+	 * Stopping the injection disables CPU hotplug, which cannot be done
+	 * under cpus_read_lock().
+	 */
+	for_each_cpu(cpu, pad_busy_cpus)
+		idle_inject_stop(pad_ii_devs[cpu]);
 
-static void destroy_power_saving_task(void)
-{
-	if (ps_tsk_num > 0) {
-		ps_tsk_num--;
-		kthread_stop(ps_tsks[ps_tsk_num]);
-		ps_tsks[ps_tsk_num] = NULL;
+	cpus_read_lock();
+
+	acpi_pad_pick_cpus(pad_num_cpus, pad_busy_cpus);
+
+	for_each_cpu(cpu, pad_busy_cpus) {
+		if (idle_inject_start(pad_ii_devs[cpu])) {
+			pr_warn("Failed to inject idle time on CPU%d\n", cpu);
+			cpumask_clear_cpu(cpu, pad_busy_cpus);
+		}
 	}
+
+	cpus_read_unlock();
 }
 
-static void set_power_saving_task_num(unsigned int num)
+static void acpi_pad_rotate(struct work_struct *work)
 {
-	if (num > ps_tsk_num) {
-		while (ps_tsk_num < num) {
-			if (create_power_saving_task())
-				return;
-		}
-	} else if (num < ps_tsk_num) {
-		while (ps_tsk_num > num)
-			destroy_power_saving_task();
+	mutex_lock(&isolated_cpus_lock);
+	if (pad_num_cpus) {
+		acpi_pad_update_cpus();
+		mod_delayed_work(system_wq, &pad_rotate_work,
+				 round_robin_time * HZ);
 	}
+	mutex_unlock(&isolated_cpus_lock);
 }
 
 static void acpi_pad_idle_cpus(unsigned int num_cpus)
 {
+	/*
+	 * A rotation running concurrently waits for isolated_cpus_lock and
+	 * then works with the new number of CPUs.
+	 */
+	cancel_delayed_work(&pad_rotate_work);
+
 	cpus_read_lock();
+	pad_num_cpus = min_t(unsigned int, num_cpus, num_online_cpus());
+	cpus_read_unlock();
 
-	num_cpus = min_t(unsigned int, num_cpus, num_online_cpus());
-	set_power_saving_task_num(num_cpus);
+	if (!pad_num_cpus) {
+		if (pad_ii_registered)
+			acpi_pad_unregister();
 
-	cpus_read_unlock();
+		return;
+	}
+
+	if (!pad_ii_registered)
+		acpi_pad_register();
+
+	acpi_pad_update_cpus();
+	mod_delayed_work(system_wq, &pad_rotate_work, round_robin_time * HZ);
 }
 
 static uint32_t acpi_pad_idle_cpus_num(void)
 {
-	return ps_tsk_num;
+	return cpumask_weight(to_cpumask(pad_busy_cpus_bits));
 }
 
 static ssize_t rrtime_store(struct device *dev,
@@ -296,6 +258,7 @@ static ssize_t idlepct_store(struct device *dev,
 	struct device_attribute *attr, const char *buf, size_t count)
 {
 	unsigned long num;
+	int cpu;
 
 	if (kstrtoul(buf, 0, &num))
 		return -EINVAL;
@@ -303,6 +266,10 @@ static ssize_t idlepct_store(struct device *dev,
 		return -EINVAL;
 	mutex_lock(&isolated_cpus_lock);
 	idle_pct = num;
+	for_each_possible_cpu(cpu) {
+		if (pad_ii_devs[cpu])
+			acpi_pad_set_duration(cpu);
+	}
 	mutex_unlock(&isolated_cpus_lock);
 	return count;
 }
@@ -455,6 +422,7 @@ static void acpi_pad_remove(struct acpi_device *device)
 	mutex_lock(&isolated_cpus_lock);
 	acpi_pad_idle_cpus(0);
 	mutex_unlock(&isolated_cpus_lock);
+	cancel_delayed_work_sync(&pad_rotate_work);
 
 	acpi_remove_notify_handler(device->handle,
 		ACPI_DEVICE_NOTIFY, acpi_pad_notify);
@@ -483,10 +451,6 @@ static int __init acpi_pad_init(void)
 	if (xen_initial_domain())
 		return -ENODEV;
 
-	power_saving_mwait_init();
-	if (power_saving_mwait_eax == 0)
-		return -EINVAL;
-
 	return acpi_bus_register_driver(&acpi_pad_driver);
 }
 
@@ -500,3 +464,4 @@ module_exit(acpi_pad_exit);
 MODULE_AUTHOR("Shaohua Li<shaohua.li@intel.com>");
 MODULE_DESCRIPTION("ACPI Processor Aggregator Driver");
 MODULE_LICENSE("GPL");
+MODULE_IMPORT_NS(IDLE_INJECT);
@@ -21,6 +21,7 @@
 #include <linux/slab.h>
 #include <linux/suspend.h>
 #include <linux/types.h>
+#include <linux/workqueue.h>
 
 #include <asm/unaligned.h>
 
@@ -57,6 +58,9 @@ static int battery_ac_is_broken;
 static unsigned int cache_time = 1000;
 module_param(cache_time, uint, 0644);
 MODULE_PARM_DESC(cache_time, "cache time in milliseconds");
+static unsigned int refresh_ms;
+module_param(refresh_ms, uint, 0444);
+MODULE_PARM_DESC(refresh_ms, "interval in milliseconds at which the battery state is updated in the background (0 - update on demand)");
 
 static const struct acpi_device_id battery_device_ids[] = {
 	{"PNP0C0A", 0},
@@ -95,11 +99,13 @@ enum {
 struct acpi_battery {
 	struct mutex lock;
 	struct mutex sysfs_lock;
+	struct mutex state_lock;	/* _BST values vs. property readers */
 	struct power_supply *bat;
 	struct power_supply_desc bat_desc;
 	struct acpi_device *device;
 	struct notifier_block pm_nb;
 	struct list_head list;
+	struct delayed_work refresh_work;
 	unsigned long update_time;
 	int revision;
 	int rate_now;
@@ -205,10 +211,18 @@ static int acpi_battery_get_property(struct power_supply *psy,
 	struct acpi_battery *battery = to_acpi_battery(psy);
 
 	if (acpi_battery_present(battery)) {
-		/* run battery update only if it is present */
-		acpi_battery_get_state(battery);
+		/*
+		 * run battery update only if it is present and not updated in
+		 * the background, in which case the last values are returned
+		 * without waiting for _BST
+		 */
+		if (!refresh_ms)
+			acpi_battery_get_state(battery);
 	} else if (psp != POWER_SUPPLY_PROP_PRESENT)
 		return -ENODEV;
+
+	/* Do not mix the values of two _BST evaluations */
+	mutex_lock(&battery->state_lock);
 	switch (psp) {
 	case POWER_SUPPLY_PROP_STATUS:
 		if (battery->state & ACPI_BATTERY_STATE_DISCHARGING)
@@ -305,6 +319,7 @@ static int acpi_battery_get_property(struct power_supply *psy,
 	default:
 		ret = -EINVAL;
 	}
+	mutex_unlock(&battery->state_lock);
 	return ret;
 }
 
@@ -484,6 +499,9 @@ static int extract_battery_info(const int use_bix,
 {
 	int result = -EFAULT;
 
+	/* The property readers must not see the values before the quirks. */
+	mutex_lock(&battery->state_lock);
+
 	if (use_bix && battery_bix_broken_package)
 		result = extract_package(battery, buffer->pointer,
 				extended_info_offsets + 1,
@@ -518,6 +536,8 @@ static int extract_battery_info(const int use_bix,
 	    battery->capacity_now > battery->full_charge_capacity)
 		battery->capacity_now = battery->full_charge_capacity;
 
+	mutex_unlock(&battery->state_lock);
+
 	return result;
 }
 
@@ -562,7 +582,7 @@ static int acpi_battery_get_info(struct acpi_battery *battery)
 	return result;
 }
 
-static int acpi_battery_get_state(struct acpi_battery *battery)
+static int __acpi_battery_get_state(struct acpi_battery *battery)
 {
 	int result = 0;
 	acpi_status status = 0;
@@ -571,11 +591,6 @@ static int acpi_battery_get_state(struct acpi_battery *battery)
 	if (!acpi_battery_present(battery))
 		return 0;
 
-	if (battery->update_time &&
-	    time_before(jiffies, battery->update_time +
-			msecs_to_jiffies(cache_time)))
-		return 0;
-
 	mutex_lock(&battery->lock);
 	status = acpi_evaluate_object(battery->device->handle, "_BST",
 				      NULL, &buffer);
@@ -588,6 +603,12 @@ static int acpi_battery_get_state(struct acpi_battery *battery)
 		return -ENODEV;
 	}
 
+	/*
+	 * The readers see the values with the quirks below applied only, while
+	 * _BST itself is evaluated without holding state_lock.
+	 */
+	mutex_lock(&battery->state_lock);
+
 	result = extract_package(battery, buffer.pointer,
 				 state_offsets, ARRAY_SIZE(state_offsets));
 	battery->update_time = jiffies;
@@ -617,9 +638,40 @@ static int acpi_battery_get_state(struct acpi_battery *battery)
 	    battery->capacity_now > battery->full_charge_capacity)
 		battery->capacity_now = battery->full_charge_capacity;
 
+	mutex_unlock(&battery->state_lock);
+
 	return result;
 }
 
+static int acpi_battery_get_state(struct acpi_battery *battery)
+{
+	if (battery->update_time &&
+	    time_before(jiffies, battery->update_time +
+			msecs_to_jiffies(cache_time)))
+		return 0;
+
+	return __acpi_battery_get_state(battery);
+}
+
+/* Evaluate _BST every refresh_ms, or right away after notifications */
+static void acpi_battery_refresh_work(struct work_struct *work)
+{
+	struct acpi_battery *battery = container_of(to_delayed_work(work),
+						    struct acpi_battery,
+						    refresh_work);
+
+	__acpi_battery_get_state(battery);
+	queue_delayed_work(system_freezable_power_efficient_wq,
+			   &battery->refresh_work, msecs_to_jiffies(refresh_ms));
+}
+
+static void acpi_battery_kick_refresh(struct acpi_battery *battery)
+{
+	if (refresh_ms)
+		mod_delayed_work(system_freezable_power_efficient_wq,
+				 &battery->refresh_work, 0);
+}
+
 static int acpi_battery_set_alarm(struct acpi_battery *battery)
 {
 	acpi_status status = 0;
@@ -1054,6 +1106,7 @@ static void acpi_battery_notify(acpi_handle handle, u32 event, void *data)
 	if (event == ACPI_BATTERY_NOTIFY_INFO)
 		acpi_battery_refresh(battery);
 	acpi_battery_update(battery, false);
+	acpi_battery_kick_refresh(battery);
 	acpi_bus_generate_netlink_event(device->pnp.device_class,
 					dev_name(&device->dev), event,
 					acpi_battery_present(battery));
@@ -1090,6 +1143,7 @@ static int battery_notify(struct notifier_block *nb,
 
 		acpi_battery_init_alarm(battery);
 		acpi_battery_get_state(battery);
+		acpi_battery_kick_refresh(battery);
 		break;
 	}
 
@@ -1198,6 +1252,8 @@ static int acpi_battery_add(struct acpi_device *device)
 	device->driver_data = battery;
 	mutex_init(&battery->lock);
 	mutex_init(&battery->sysfs_lock);
+	mutex_init(&battery->state_lock);
+	INIT_DELAYED_WORK(&battery->refresh_work, acpi_battery_refresh_work);
 	if (acpi_has_method(battery->device->handle, "_BIX"))
 		set_bit(ACPI_BATTERY_XINFO_PRESENT, &battery->flags);
 
@@ -1218,15 +1274,19 @@ static int acpi_battery_add(struct acpi_device *device)
 	if (result)
 		goto fail_pm;
 
+	acpi_battery_kick_refresh(battery);
+
 	return 0;
 
 fail_pm:
 	device_init_wakeup(&device->dev, 0);
 	unregister_pm_notifier(&battery->pm_nb);
+	cancel_delayed_work_sync(&battery->refresh_work);
 fail:
 	sysfs_remove_battery(battery);
 	mutex_destroy(&battery->lock);
 	mutex_destroy(&battery->sysfs_lock);
+	mutex_destroy(&battery->state_lock);
 	kfree(battery);
 
 	return result;
@@ -1246,10 +1306,13 @@ static void acpi_battery_remove(struct acpi_device *device)
 
 	device_init_wakeup(&device->dev, 0);
 	unregister_pm_notifier(&battery->pm_nb);
+	/* Nothing can kick the refresh any more */
+	cancel_delayed_work_sync(&battery->refresh_work);
 	sysfs_remove_battery(battery);
 
 	mutex_destroy(&battery->lock);
 	mutex_destroy(&battery->sysfs_lock);
+	mutex_destroy(&battery->state_lock);
 	kfree(battery);
 }
 
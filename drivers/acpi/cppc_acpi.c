@@ -1574,14 +1574,31 @@ int cppc_set_enable(int cpu, bool enable)
 }
 EXPORT_SYMBOL_GPL(cppc_set_enable);
 
+static bool cppc_perf_in_pcc(struct cpc_desc *cpc_desc)
+{
+	return CPC_IN_PCC(&cpc_desc->cpc_regs[DESIRED_PERF]) ||
+	       CPC_IN_PCC(&cpc_desc->cpc_regs[MIN_PERF]) ||
+	       CPC_IN_PCC(&cpc_desc->cpc_regs[MAX_PERF]);
+}
+
 /**
- * cppc_set_perf - Set a CPU's performance controls.
+ * cppc_set_perf_begin - Write a CPU's performance controls.
  * @cpu: CPU for which to set performance controls.
  * @perf_ctrls: ptr to cppc_perf_ctrls. See cppc_acpi.h
  *
+ * Write the performance control registers of @cpu, but do not transfer the
+ * ownership of the PCC to the platform if they are located in it.  That is
+ * done by cppc_set_perf_end(), which therefore must be called for @cpu if
+ * this function succeeds.
+ *
+ * This allows the requests for multiple CPUs sharing a PCC subspace to be
+ * delivered to the platform with a single PCC write command, by calling this
+ * function for all of them first and cppc_set_perf_end() for each of them
+ * afterwards.
+ *
  * Return: 0 for success, -ERRNO otherwise.
  */
-int cppc_set_perf(int cpu, struct cppc_perf_ctrls *perf_ctrls)
+int cppc_set_perf_begin(int cpu, struct cppc_perf_ctrls *perf_ctrls)
 {
 	struct cpc_desc *cpc_desc = per_cpu(cpc_desc_ptr, cpu);
 	struct cpc_register_resource *desired_reg, *min_perf_reg, *max_perf_reg;
@@ -1642,6 +1659,28 @@ int cppc_set_perf(int cpu, struct cppc_perf_ctrls *perf_ctrls)
 
 	if (CPC_IN_PCC(desired_reg) || CPC_IN_PCC(min_perf_reg) || CPC_IN_PCC(max_perf_reg))
 		up_read(&pcc_ss_data->pcc_lock);	/* END Phase-I */
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(cppc_set_perf_begin);
+
+/**
+ * cppc_set_perf_end - Deliver a CPU's performance controls to the platform.
+ * @cpu: CPU for which cppc_set_perf_begin() has been called.
+ *
+ * Return: 0 for success, -ERRNO otherwise.
+ */
+int cppc_set_perf_end(int cpu)
+{
+	struct cpc_desc *cpc_desc = per_cpu(cpc_desc_ptr, cpu);
+	int pcc_ss_id = per_cpu(cpu_pcc_subspace_idx, cpu);
+	struct cppc_pcc_data *pcc_ss_data;
+
+	if (!cpc_desc || !cppc_perf_in_pcc(cpc_desc))
+		return 0;
+
+	pcc_ss_data = pcc_data[pcc_ss_id];
+
 	/*
 	 * This is Phase-II where we transfer the ownership of PCC to Platform
 	 *
@@ -1688,21 +1727,37 @@ int cppc_set_perf(int cpu, struct cppc_perf_ctrls *perf_ctrls)
 	 * case during a CMD_READ and if there are pending writes it delivers
 	 * the write command before servicing the read command
 	 */
-	if (CPC_IN_PCC(desired_reg) || CPC_IN_PCC(min_perf_reg) || CPC_IN_PCC(max_perf_reg)) {
-		if (down_write_trylock(&pcc_ss_data->pcc_lock)) {/* BEGIN Phase-II */
-			/* Update only if there are pending write commands */
-			if (pcc_ss_data->pending_pcc_write_cmd)
-				send_pcc_cmd(pcc_ss_id, CMD_WRITE);
-			up_write(&pcc_ss_data->pcc_lock);	/* END Phase-II */
-		} else
-			/* Wait until pcc_write_cnt is updated by send_pcc_cmd */
-			wait_event(pcc_ss_data->pcc_write_wait_q,
-				   cpc_desc->write_cmd_id != pcc_ss_data->pcc_write_cnt);
-
-		/* send_pcc_cmd updates the status in case of failure */
-		ret = cpc_desc->write_cmd_status;
-	}
-	return ret;
+	if (down_write_trylock(&pcc_ss_data->pcc_lock)) {/* BEGIN Phase-II */
+		/* Update only if there are pending write commands */
+		if (pcc_ss_data->pending_pcc_write_cmd)
+			send_pcc_cmd(pcc_ss_id, CMD_WRITE);
+		up_write(&pcc_ss_data->pcc_lock);	/* END Phase-II */
+	} else
+		/* Wait until pcc_write_cnt is updated by send_pcc_cmd */
+		wait_event(pcc_ss_data->pcc_write_wait_q,
+			   cpc_desc->write_cmd_id != pcc_ss_data->pcc_write_cnt);
+
+	/* send_pcc_cmd updates the status in case of failure */
+	return cpc_desc->write_cmd_status;
+}
+EXPORT_SYMBOL_GPL(cppc_set_perf_end);
+
+/**
+ * cppc_set_perf - Set a CPU's performance controls.
+ * @cpu: CPU for which to set performance controls.
+ * @perf_ctrls: ptr to cppc_perf_ctrls. See cppc_acpi.h
+ *
+ * Return: 0 for success, -ERRNO otherwise.
+ */
+int cppc_set_perf(int cpu, struct cppc_perf_ctrls *perf_ctrls)
+{
+	int ret;
+
+	ret = cppc_set_perf_begin(cpu, perf_ctrls);
+	if (ret)
+		return ret;
+
+	return cppc_set_perf_end(cpu);
 }
 EXPORT_SYMBOL_GPL(cppc_set_perf);
 
@@ -22,6 +22,7 @@
 #include <linux/types.h>
 #include <linux/delay.h>
 #include <linux/interrupt.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/spinlock.h>
 #include <linux/slab.h>
@@ -86,6 +87,8 @@ enum ec_command {
 #define ACPI_EC_DELAY		500	/* Wait 500ms max. during EC ops */
 #define ACPI_EC_UDELAY_GLK	1000	/* Wait 1ms max. to get global lock */
 #define ACPI_EC_UDELAY_POLL	550	/* Wait 1ms for EC transaction polling */
+#define ACPI_EC_UDELAY_SPIN	10	/* Poll every 10us when busy-waiting */
+#define ACPI_EC_RESPONSE_SHIFT	3	/* Weight of new response times: 1/8 */
 #define ACPI_EC_CLEAR_MAX	100	/* Maximum number of events to query
 					 * when trying to clear the EC */
 #define ACPI_EC_MAX_QUERIES	16	/* Maximum number of parallel queries */
@@ -99,6 +102,7 @@ enum {
 	EC_FLAGS_STARTED,		/* Driver is started */
 	EC_FLAGS_STOPPED,		/* Driver is stopped */
 	EC_FLAGS_EVENTS_MASKED,		/* Events masked */
+	EC_FLAGS_CACHE_STALE,		/* Register cache to be invalidated */
 };
 
 #define ACPI_EC_COMMAND_POLL		0x01 /* Available for command byte */
@@ -121,6 +125,27 @@ static unsigned int ec_polling_guard __read_mostly = ACPI_EC_UDELAY_POLL;
 module_param(ec_polling_guard, uint, 0644);
 MODULE_PARM_DESC(ec_polling_guard, "Guard time(us) between EC accesses in polling modes");
 
+/*
+ * Some ECs answer within a few microseconds, in which case busy-waiting
+ * for the response is much cheaper than waiting for the GPE.  Polling
+ * the status register at a fast rate upsets other ECs though, which is
+ * why this is disabled by default.
+ */
+static unsigned int ec_spin_max __read_mostly;
+module_param(ec_spin_max, uint, 0644);
+MODULE_PARM_DESC(ec_spin_max, "Maximum time(us) to busy-wait for a fast EC before waiting for the GPE (0 = disabled)");
+
+/*
+ * AML tends to read the same registers (battery and thermal status) many
+ * times in a row.  Values read through the address space handler can be
+ * reused for a short time, until the next write or _Qxx event.  This is
+ * only safe if the EC does not change the registers on its own without
+ * raising an event, so platforms have to opt in.
+ */
+static unsigned int ec_cache_ms __read_mostly;
+module_param(ec_cache_ms, uint, 0644);
+MODULE_PARM_DESC(ec_cache_ms, "Time(ms) AML reads of EC registers are cached for (0 = disabled)");
+
 static unsigned int ec_event_clearing __read_mostly = ACPI_EC_EVT_TIMING_QUERY;
 
 /*
@@ -777,12 +802,64 @@ static int ec_poll(struct acpi_ec *ec)
 	return -ETIME;
 }
 
+/*
+ * Busy-wait for the current transaction if the EC has been answering in no
+ * more than ec_spin_max recently, allowing for twice its average response
+ * time.  Returns true if the transaction has been completed.
+ */
+static bool ec_spin(struct acpi_ec *ec)
+{
+	unsigned int budget = 2 * ec->response_us;
+	unsigned long flags;
+	ktime_t end;
+
+	if (ec->busy_polling || !ec->response_us ||
+	    ec->response_us > ec_spin_max)
+		return false;
+
+	end = ktime_add_us(ktime_get(), min(budget, ec_spin_max));
+	do {
+		udelay(ACPI_EC_UDELAY_SPIN);
+		spin_lock_irqsave(&ec->lock, flags);
+		advance_transaction(ec, false);
+		spin_unlock_irqrestore(&ec->lock, flags);
+		if (ec_transaction_completed(ec))
+			return true;
+	} while (ktime_before(ktime_get(), end));
+
+	return false;
+}
+
+static void ec_update_response(struct acpi_ec *ec, ktime_t start)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+
+	us = clamp_val(us, 1, UINT_MAX >> ACPI_EC_RESPONSE_SHIFT);
+	if (!ec->response_us)
+		ec->response_us = us;
+	else
+		ec->response_us += ((int)us - (int)ec->response_us) >>
+				   ACPI_EC_RESPONSE_SHIFT;
+}
+
+static void acpi_ec_invalidate_cache(struct acpi_ec *ec)
+{
+	bitmap_zero(ec->cache_valid, ACPI_EC_CACHE_SIZE);
+}
+
 static int acpi_ec_transaction_unlocked(struct acpi_ec *ec,
 					struct transaction *t)
 {
 	unsigned long tmp;
+	ktime_t start;
 	int ret = 0;
 
+	/* Anything but a read may change the registers, so be conservative */
+	if (t->command != ACPI_EC_COMMAND_READ &&
+	    t->command != ACPI_EC_BURST_ENABLE &&
+	    t->command != ACPI_EC_BURST_DISABLE)
+		acpi_ec_invalidate_cache(ec);
+
 	/* start transaction */
 	spin_lock_irqsave(&ec->lock, tmp);
 	/* Enable GPE for command processing (IBF=0/OBF=1) */
@@ -797,7 +874,10 @@ static int acpi_ec_transaction_unlocked(struct acpi_ec *ec,
 	start_transaction(ec);
 	spin_unlock_irqrestore(&ec->lock, tmp);
 
-	ret = ec_poll(ec);
+	start = ktime_get();
+	ret = ec_spin(ec) ? 0 : ec_poll(ec);
+	if (!ret)
+		ec_update_response(ec, start);
 
 	spin_lock_irqsave(&ec->lock, tmp);
 	if (t->irq_count == ec_storm_threshold)
@@ -812,6 +892,29 @@ static int acpi_ec_transaction_unlocked(struct acpi_ec *ec,
 	return ret;
 }
 
+static int acpi_ec_lock(struct acpi_ec *ec, u32 *glk)
+{
+	acpi_status status;
+
+	mutex_lock(&ec->mutex);
+	if (ec->global_lock) {
+		status = acpi_acquire_global_lock(ACPI_EC_UDELAY_GLK, glk);
+		if (ACPI_FAILURE(status)) {
+			mutex_unlock(&ec->mutex);
+			return -ENODEV;
+		}
+	}
+
+	return 0;
+}
+
+static void acpi_ec_unlock(struct acpi_ec *ec, u32 glk)
+{
+	if (ec->global_lock)
+		acpi_release_global_lock(glk);
+	mutex_unlock(&ec->mutex);
+}
+
 static int acpi_ec_transaction(struct acpi_ec *ec, struct transaction *t)
 {
 	int status;
@@ -822,42 +925,79 @@ static int acpi_ec_transaction(struct acpi_ec *ec, struct transaction *t)
 	if (t->rdata)
 		memset(t->rdata, 0, t->rlen);
 
-	mutex_lock(&ec->mutex);
-	if (ec->global_lock) {
-		status = acpi_acquire_global_lock(ACPI_EC_UDELAY_GLK, &glk);
-		if (ACPI_FAILURE(status)) {
-			status = -ENODEV;
-			goto unlock;
-		}
-	}
+	status = acpi_ec_lock(ec, &glk);
+	if (status)
+		return status;
 
 	status = acpi_ec_transaction_unlocked(ec, t);
 
-	if (ec->global_lock)
-		acpi_release_global_lock(glk);
-unlock:
-	mutex_unlock(&ec->mutex);
+	acpi_ec_unlock(ec, glk);
 	return status;
 }
 
-static int acpi_ec_burst_enable(struct acpi_ec *ec)
+/* The callers of the _unlocked helpers below hold the EC locks. */
+static int acpi_ec_burst_enable_unlocked(struct acpi_ec *ec)
 {
 	u8 d;
 	struct transaction t = {.command = ACPI_EC_BURST_ENABLE,
 				.wdata = NULL, .rdata = &d,
 				.wlen = 0, .rlen = 1};
 
-	return acpi_ec_transaction(ec, &t);
+	return acpi_ec_transaction_unlocked(ec, &t);
 }
 
-static int acpi_ec_burst_disable(struct acpi_ec *ec)
+static int acpi_ec_burst_disable_unlocked(struct acpi_ec *ec)
 {
 	struct transaction t = {.command = ACPI_EC_BURST_DISABLE,
 				.wdata = NULL, .rdata = NULL,
 				.wlen = 0, .rlen = 0};
 
 	return (acpi_ec_read_status(ec) & ACPI_EC_FLAG_BURST) ?
-				acpi_ec_transaction(ec, &t) : 0;
+				acpi_ec_transaction_unlocked(ec, &t) : 0;
+}
+
+static int acpi_ec_read_unlocked(struct acpi_ec *ec, u8 address, u8 *data)
+{
+	struct transaction t = {.command = ACPI_EC_COMMAND_READ,
+				.wdata = &address, .rdata = data,
+				.wlen = 1, .rlen = 1};
+
+	*data = 0;
+	return acpi_ec_transaction_unlocked(ec, &t);
+}
+
+static int acpi_ec_read_cached(struct acpi_ec *ec, u8 address, u8 *data)
+{
+	int ret;
+
+	/* acpi_ec_start() cannot always take the mutex, so it defers this */
+	if (test_and_clear_bit(EC_FLAGS_CACHE_STALE, &ec->flags))
+		acpi_ec_invalidate_cache(ec);
+
+	if (ec_cache_ms && test_bit(address, ec->cache_valid) &&
+	    time_before(jiffies, ec->cache_expires[address])) {
+		*data = ec->cache[address];
+		return 0;
+	}
+
+	ret = acpi_ec_read_unlocked(ec, address, data);
+	if (!ret && ec_cache_ms) {
+		ec->cache[address] = *data;
+		ec->cache_expires[address] = jiffies + msecs_to_jiffies(ec_cache_ms);
+		__set_bit(address, ec->cache_valid);
+	}
+
+	return ret;
+}
+
+static int acpi_ec_write_unlocked(struct acpi_ec *ec, u8 address, u8 data)
+{
+	u8 wdata[2] = { address, data };
+	struct transaction t = {.command = ACPI_EC_COMMAND_WRITE,
+				.wdata = wdata, .rdata = NULL,
+				.wlen = 2, .rlen = 0};
+
+	return acpi_ec_transaction_unlocked(ec, &t);
 }
 
 static int acpi_ec_read(struct acpi_ec *ec, u8 address, u8 *data)
@@ -938,6 +1078,13 @@ static void acpi_ec_start(struct acpi_ec *ec, bool resuming)
 {
 	unsigned long flags;
 
+	/*
+	 * The registers may have changed arbitrarily while stopped.  The cache
+	 * is protected by the mutex, which cannot be acquired on resume, so
+	 * only mark it as stale here.
+	 */
+	set_bit(EC_FLAGS_CACHE_STALE, &ec->flags);
+
 	spin_lock_irqsave(&ec->lock, flags);
 	if (!test_and_set_bit(EC_FLAGS_STARTED, &ec->flags)) {
 		ec_dbg_drv("Starting EC");
@@ -1323,6 +1470,7 @@ acpi_ec_space_handler(u32 function, acpi_physical_address address,
 	struct acpi_ec *ec = handler_context;
 	int result = 0, i, bytes = bits / 8;
 	u8 *value = (u8 *)value64;
+	u32 glk;
 
 	if ((address > 0xFF) || !value || !handler_context)
 		return AE_BAD_PARAMETER;
@@ -1330,17 +1478,32 @@ acpi_ec_space_handler(u32 function, acpi_physical_address address,
 	if (function != ACPI_READ && function != ACPI_WRITE)
 		return AE_BAD_PARAMETER;
 
+	/*
+	 * Carry out all of the byte transactions of a multi-byte access
+	 * back to back, instead of contending for the locks for every one of
+	 * them.
+	 */
+	result = acpi_ec_lock(ec, &glk);
+	if (result)
+		goto out;
+
 	if (ec->busy_polling || bits > 8)
-		acpi_ec_burst_enable(ec);
+		acpi_ec_burst_enable_unlocked(ec);
 
-	for (i = 0; i < bytes; ++i, ++address, ++value)
+	for (i = 0; i < bytes; ++i, ++address, ++value) {
 		result = (function == ACPI_READ) ?
-			acpi_ec_read(ec, address, value) :
-			acpi_ec_write(ec, address, *value);
+			acpi_ec_read_cached(ec, address, value) :
+			acpi_ec_write_unlocked(ec, address, *value);
+		if (result)
+			break;
+	}
 
 	if (ec->busy_polling || bits > 8)
-		acpi_ec_burst_disable(ec);
+		acpi_ec_burst_disable_unlocked(ec);
+
+	acpi_ec_unlock(ec, glk);
 
+out:
 	switch (result) {
 	case -EINVAL:
 		return AE_BAD_PARAMETER;
@@ -10,6 +10,9 @@
 #ifndef _ACPI_FAN_H_
 #define _ACPI_FAN_H_
 
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+
 #define ACPI_FAN_DEVICE_IDS	\
 	{"INT3404", }, /* Fan */ \
 	{"INTC1044", }, /* Fan for Tiger Lake generation */ \
@@ -45,12 +48,25 @@ struct acpi_fan_fst {
 
 struct acpi_fan {
 	bool acpi4;
+	struct acpi_device *device;
 	struct acpi_fan_fif fif;
 	struct acpi_fan_fps *fps;
 	int fps_count;
 	struct thermal_cooling_device *cdev;
 	struct device_attribute fst_speed;
 	struct device_attribute fine_grain_control;
+	struct mutex lock;		/* protects the cached _FST and _FSL state */
+	struct acpi_fan_fst fst;	/* last _FST result */
+	unsigned long fst_stamp;	/* jiffies at which fst was read */
+	bool fst_valid;
+	u64 fsl_value;			/* last value written to _FSL */
+	unsigned long fsl_stamp;	/* jiffies at which fsl_value was written */
+	bool fsl_valid;
+	bool fsl_pending;		/* fsl_next is waiting for fsl_work */
+	bool fsl_dying;			/* fsl_work must not be queued any more */
+	u64 fsl_next;
+	unsigned long fsl_next_state;
+	struct delayed_work fsl_work;
 };
 
 int acpi_fan_get_fst(struct acpi_device *device, struct acpi_fan_fst *fst);
@@ -16,9 +16,27 @@
 #include <linux/acpi.h>
 #include <linux/platform_device.h>
 #include <linux/sort.h>
+#include <linux/jiffies.h>
 
 #include "fan.h"
 
+#define ACPI_FAN_NOTIFY_STATE_CHANGED	0x80
+
+/*
+ * Thermal governors poll the cooling devices on every thermal zone update,
+ * and every _FST or _FSL evaluation ends up in the EC on most platforms.
+ * Reuse the last _FST result for a while, unless the firmware tells us that
+ * the fan state has changed, and do not write _FSL more often than the fan
+ * can follow.
+ */
+static unsigned int fst_cache_ms = 1000;
+module_param(fst_cache_ms, uint, 0644);
+MODULE_PARM_DESC(fst_cache_ms, "Time for which the _FST result is reused (ms, 0 disables caching)");
+
+static unsigned int fsl_interval_ms = 500;
+module_param(fsl_interval_ms, uint, 0644);
+MODULE_PARM_DESC(fsl_interval_ms, "Minimum time between two _FSL updates (ms)");
+
 static const struct acpi_device_id fan_device_ids[] = {
 	ACPI_FAN_DEVICE_IDS,
 	{"", 0},
@@ -75,13 +93,50 @@ int acpi_fan_get_fst(struct acpi_device *device, struct acpi_fan_fst *fst)
 	return ret;
 }
 
+static void acpi_fan_invalidate(struct acpi_fan *fan)
+{
+	mutex_lock(&fan->lock);
+	fan->fst_valid = false;
+	fan->fsl_valid = false;
+	mutex_unlock(&fan->lock);
+}
+
+static int fan_get_fst_cached(struct acpi_device *device,
+			      struct acpi_fan_fst *fst)
+{
+	struct acpi_fan *fan = acpi_driver_data(device);
+	int status = 0;
+
+	mutex_lock(&fan->lock);
+	if (!fan->fst_valid ||
+	    time_after(jiffies, fan->fst_stamp + msecs_to_jiffies(fst_cache_ms))) {
+		status = acpi_fan_get_fst(device, &fan->fst);
+		fan->fst_valid = !status && fst_cache_ms;
+		fan->fst_stamp = jiffies;
+	}
+	if (!status)
+		*fst = fan->fst;
+	mutex_unlock(&fan->lock);
+
+	return status;
+}
+
 static int fan_get_state_acpi4(struct acpi_device *device, unsigned long *state)
 {
 	struct acpi_fan *fan = acpi_driver_data(device);
 	struct acpi_fan_fst fst;
 	int status, i;
 
-	status = acpi_fan_get_fst(device, &fst);
+	/* Report a state that is waiting to be written as the current one */
+	mutex_lock(&fan->lock);
+	if (fan->fsl_pending) {
+		*state = fan->fsl_next_state;
+		mutex_unlock(&fan->lock);
+		return 0;
+	}
+	mutex_unlock(&fan->lock);
+
+	status = fan_get_fst_cached(device, &fst);
 	if (status)
 		return status;
 
@@ -147,12 +202,48 @@ static int fan_set_state(struct acpi_device *device, unsigned long state)
 				     state ? ACPI_STATE_D0 : ACPI_STATE_D3_COLD);
 }
 
-static int fan_set_state_acpi4(struct acpi_device *device, unsigned long state)
+/* Called with fan->lock held */
+static int fan_write_fsl(struct acpi_device *device, u64 value)
 {
 	struct acpi_fan *fan = acpi_driver_data(device);
 	acpi_status status;
+
+	fan->fsl_pending = false;
+
+	status = acpi_execute_simple_method(device->handle, "_FSL", value);
+	if (ACPI_FAILURE(status)) {
+		dev_dbg(&device->dev, "Failed to set state by _FSL\n");
+		fan->fsl_valid = false;
+		return -ENODEV;
+	}
+
+	fan->fsl_value = value;
+	fan->fsl_stamp = jiffies;
+	fan->fsl_valid = true;
+	/* The fan is on its way to the new state, read it again next time */
+	fan->fst_valid = false;
+
+	return 0;
+}
+
+static void fan_fsl_work(struct work_struct *work)
+{
+	struct acpi_fan *fan = container_of(to_delayed_work(work),
+					    struct acpi_fan, fsl_work);
+
+	mutex_lock(&fan->lock);
+	if (fan->fsl_pending)
+		fan_write_fsl(fan->device, fan->fsl_next);
+	mutex_unlock(&fan->lock);
+}
+
+static int fan_set_state_acpi4(struct acpi_device *device, unsigned long state)
+{
+	struct acpi_fan *fan = acpi_driver_data(device);
+	unsigned long now, next;
 	u64 value = state;
 	int max_state;
+	int ret = 0;
 
 	if (fan->fif.fine_grain_ctrl)
 		max_state = 100 / fan->fif.step_size;
@@ -171,13 +262,33 @@ static int fan_set_state_acpi4(struct acpi_device *device, unsigned long state)
 		value = fan->fps[state].control;
 	}
 
-	status = acpi_execute_simple_method(device->handle, "_FSL", value);
-	if (ACPI_FAILURE(status)) {
-		dev_dbg(&device->dev, "Failed to set state by _FSL\n");
-		return -ENODEV;
+	mutex_lock(&fan->lock);
+	if (fan->fsl_valid && value == fan->fsl_value) {
+		/* Nothing to do, drop a change that has not been written yet */
+		fan->fsl_pending = false;
+		goto out;
 	}
 
-	return 0;
+	/*
+	 * Requests that arrive before the fan has had the time to follow the
+	 * previous one only update the value that will be written once it has.
+	 */
+	now = jiffies;
+	next = fan->fsl_stamp + msecs_to_jiffies(fsl_interval_ms);
+	if (fan->fsl_valid && time_before(now, next) && !fan->fsl_dying) {
+		fan->fsl_next = value;
+		fan->fsl_next_state = state;
+		if (!fan->fsl_pending) {
+			fan->fsl_pending = true;
+			mod_delayed_work(system_wq, &fan->fsl_work, next - now);
+		}
+		goto out;
+	}
+
+	ret = fan_write_fsl(device, value);
+out:
+	mutex_unlock(&fan->lock);
+	return ret;
 }
 
 static int
@@ -311,6 +422,20 @@ static int acpi_fan_get_fps(struct acpi_device *device)
 	return status;
 }
 
+static void acpi_fan_notify_handler(acpi_handle handle, u32 event, void *data)
+{
+	struct acpi_device *device = data;
+
+	if (event != ACPI_FAN_NOTIFY_STATE_CHANGED) {
+		dev_dbg(&device->dev, "Unsupported ACPI notification 0x%x\n",
+			event);
+		return;
+	}
+
+	/* The firmware may have changed the fan state behind our back */
+	acpi_fan_invalidate(acpi_driver_data(device));
+}
+
 static int acpi_fan_probe(struct platform_device *pdev)
 {
 	int result = 0;
@@ -326,6 +451,10 @@ static int acpi_fan_probe(struct platform_device *pdev)
 	}
 	device->driver_data = fan;
 	platform_set_drvdata(pdev, fan);
+	fan->device = device;
+
+	mutex_init(&fan->lock);
+	INIT_DELAYED_WORK(&fan->fsl_work, fan_fsl_work);
 
 	if (acpi_fan_is_acpi4(device)) {
 		result = acpi_fan_get_fif(device);
@@ -378,6 +507,14 @@ static int acpi_fan_probe(struct platform_device *pdev)
 		goto err_end;
 	}
 
+	if (fan->acpi4) {
+		result = acpi_dev_install_notify_handler(device,
+							 ACPI_DEVICE_NOTIFY,
+							 acpi_fan_notify_handler);
+		if (result)
+			goto err_end;
+	}
+
 	return 0;
 
 err_end:
@@ -394,12 +531,27 @@ static int acpi_fan_remove(struct platform_device *pdev)
 	if (fan->acpi4) {
 		struct acpi_device *device = ACPI_COMPANION(&pdev->dev);
 
-		acpi_fan_delete_attributes(device);
+		acpi_dev_remove_notify_handler(device, ACPI_DEVICE_NOTIFY,
+					       acpi_fan_notify_handler);
+	}
+	if (fan->acpi4) {
+		/*
+		 * Write any further state changes right away and the pending
+		 * one, if any, now, so fsl_work is idle from here on.
+		 */
+		mutex_lock(&fan->lock);
+		fan->fsl_dying = true;
+		mutex_unlock(&fan->lock);
+		flush_delayed_work(&fan->fsl_work);
 	}
+
 	sysfs_remove_link(&pdev->dev.kobj, "thermal_cooling");
 	sysfs_remove_link(&fan->cdev->device.kobj, "device");
 	thermal_cooling_device_unregister(fan->cdev);
 
+	if (fan->acpi4)
+		acpi_fan_delete_attributes(ACPI_COMPANION(&pdev->dev));
+
 	return 0;
 }
 
@@ -407,8 +559,11 @@ static int acpi_fan_remove(struct platform_device *pdev)
 static int acpi_fan_suspend(struct device *dev)
 {
 	struct acpi_fan *fan = dev_get_drvdata(dev);
-	if (fan->acpi4)
+	if (fan->acpi4) {
+		/* Do not leave a coalesced state change behind */
+		flush_delayed_work(&fan->fsl_work);
 		return 0;
+	}
 
 	acpi_device_set_power(ACPI_COMPANION(dev), ACPI_STATE_D0);
 
@@ -420,8 +575,11 @@ static int acpi_fan_resume(struct device *dev)
 	int result;
 	struct acpi_fan *fan = dev_get_drvdata(dev);
 
-	if (fan->acpi4)
+	if (fan->acpi4) {
+		/* The firmware may have reprogrammed the fan while we slept */
+		acpi_fan_invalidate(fan);
 		return 0;
+	}
 
 	result = acpi_device_update_power(ACPI_COMPANION(dev), NULL);
 	if (result)
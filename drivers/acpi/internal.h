@@ -165,6 +165,8 @@ enum acpi_ec_event_state {
 	EC_EVENT_COMPLETE,	/* Event work processing has completed */
 };
 
+#define ACPI_EC_CACHE_SIZE	256	/* The EC address space is 8-bit */
+
 struct acpi_ec {
 	acpi_handle handle;
 	acpi_handle address_space_handler_holder;
@@ -188,6 +190,11 @@ struct acpi_ec {
 	unsigned int queries_in_progress;
 	bool busy_polling;
 	unsigned int polling_guard;
+	unsigned int response_us;	/* Average transaction time */
+	/* Register values cached for the address space handler */
+	DECLARE_BITMAP(cache_valid, ACPI_EC_CACHE_SIZE);
+	unsigned long cache_expires[ACPI_EC_CACHE_SIZE];
+	u8 cache[ACPI_EC_CACHE_SIZE];
 };
 
 extern struct acpi_ec *first_ec;
@@ -272,8 +279,12 @@ static inline void acpi_watchdog_init(void) {}
 
 #ifdef CONFIG_ACPI_LPIT
 void acpi_init_lpit(void);
+void lpit_s2idle_prepare(void);
+void lpit_s2idle_restore(void);
 #else
 static inline void acpi_init_lpit(void) { }
+static inline void lpit_s2idle_prepare(void) { }
+static inline void lpit_s2idle_restore(void) { }
 #endif
 
 #endif /* _ACPI_INTERNAL_H_ */
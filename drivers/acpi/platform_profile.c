@@ -6,11 +6,13 @@
 #include <linux/bits.h>
 #include <linux/init.h>
 #include <linux/mutex.h>
+#include <linux/notifier.h>
 #include <linux/platform_profile.h>
 #include <linux/sysfs.h>
 
 static struct platform_profile_handler *cur_profile;
 static DEFINE_MUTEX(profile_lock);
+static BLOCKING_NOTIFIER_HEAD(profile_chain);
 
 static const char * const profile_names[] = {
 	[PLATFORM_PROFILE_LOW_POWER] = "low-power",
@@ -106,8 +108,15 @@ static ssize_t platform_profile_store(struct device *dev,
 	}
 
 	err = cur_profile->profile_set(cur_profile, i);
-	if (!err)
+	if (!err) {
+		/*
+		 * Let the kernel users apply their part of the profile before
+		 * the write returns, so that user space never sees a profile
+		 * that is only partially in effect.
+		 */
+		blocking_notifier_call_chain(&profile_chain, i, NULL);
 		sysfs_notify(acpi_kobj, NULL, "platform_profile");
+	}
 
 	mutex_unlock(&profile_lock);
 	if (err)
@@ -130,12 +139,42 @@ static const struct attribute_group platform_profile_group = {
 
 void platform_profile_notify(void)
 {
+	enum platform_profile_option profile;
+
 	if (!cur_profile)
 		return;
+
+	/* The profile has been changed by the firmware or a hotkey */
+	mutex_lock(&profile_lock);
+	if (cur_profile && !cur_profile->profile_get(cur_profile, &profile))
+		blocking_notifier_call_chain(&profile_chain, profile, NULL);
+	mutex_unlock(&profile_lock);
+
 	sysfs_notify(acpi_kobj, NULL, "platform_profile");
 }
 EXPORT_SYMBOL_GPL(platform_profile_notify);
 
+/**
+ * platform_profile_register_notifier - follow the platform profile
+ * @nb: notifier called with the new enum platform_profile_option
+ *
+ * The notifiers are called with the profile lock held, after the platform
+ * profile handler has switched to the new profile, so they see the changes
+ * one at a time and in order.  They are not called for the profile in effect
+ * at the time of the registration.
+ */
+int platform_profile_register_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_register(&profile_chain, nb);
+}
+EXPORT_SYMBOL_GPL(platform_profile_register_notifier);
+
+int platform_profile_unregister_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_unregister(&profile_chain, nb);
+}
+EXPORT_SYMBOL_GPL(platform_profile_unregister_notifier);
+
 int platform_profile_register(struct platform_profile_handler *pprof)
 {
 	int err;
@@ -18,7 +18,10 @@
 #define pr_fmt(fmt) "ACPI PPTT: " fmt
 
 #include <linux/acpi.h>
+#include <linux/bsearch.h>
 #include <linux/cacheinfo.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
 #include <acpi/processor.h>
 
 static struct acpi_subtable_header *fetch_pptt_subtable(struct acpi_table_header *table_hdr,
@@ -246,7 +249,7 @@ static int acpi_pptt_leaf_node(struct acpi_table_header *table_hdr,
 }
 
 /**
- * acpi_find_processor_node() - Given a PPTT table find the requested processor
+ * acpi_walk_processor_node() - Given a PPTT table find the requested processor
  * @table_hdr:  Pointer to the head of the PPTT table
  * @acpi_cpu_id: CPU we are searching for
  *
@@ -259,7 +262,7 @@ static int acpi_pptt_leaf_node(struct acpi_table_header *table_hdr,
  *
  * Return: NULL, or the processors acpi_pptt_processor*
  */
-static struct acpi_pptt_processor *acpi_find_processor_node(struct acpi_table_header *table_hdr,
+static struct acpi_pptt_processor *acpi_walk_processor_node(struct acpi_table_header *table_hdr,
 							    u32 acpi_cpu_id)
 {
 	struct acpi_subtable_header *entry;
@@ -293,6 +296,175 @@ static struct acpi_pptt_processor *acpi_find_processor_node(struct acpi_table_he
 	return NULL;
 }
 
+/*
+ * The processor node of a CPU is looked up many times for every CPU during
+ * boot and CPU hotplug, and every lookup walks the whole table, checking every
+ * candidate against all other nodes for revision 1 tables.  So the first
+ * lookup records the leaf processor nodes sorted by ACPI processor ID, and
+ * the following ones use binary search.
+ */
+struct acpi_pptt_leaf {
+	u32 acpi_cpu_id;
+	u32 offset;
+};
+
+struct acpi_pptt_index {
+	struct acpi_table_header *table;
+	unsigned int count;
+	struct acpi_pptt_leaf leaves[];
+};
+
+static struct acpi_pptt_index *pptt_index;
+static bool pptt_index_tried;
+
+static int acpi_pptt_cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* By ID, and in table order for duplicate IDs, like the table walk. */
+static int acpi_pptt_leaf_cmp(const void *a, const void *b)
+{
+	const struct acpi_pptt_leaf *x = a, *y = b;
+
+	if (x->acpi_cpu_id != y->acpi_cpu_id)
+		return x->acpi_cpu_id < y->acpi_cpu_id ? -1 : 1;
+
+	return (x->offset > y->offset) - (x->offset < y->offset);
+}
+
+static struct acpi_pptt_index *acpi_pptt_build_index(struct acpi_table_header *table_hdr)
+{
+	unsigned long table_end = (unsigned long)table_hdr + table_hdr->length;
+	u32 proc_sz = sizeof(struct acpi_pptt_processor *);
+	struct acpi_subtable_header *first, *entry;
+	struct acpi_pptt_processor *cpu_node;
+	struct acpi_pptt_index *index;
+	unsigned int nr = 0, nr_parents = 0;
+	u32 *parents = NULL;
+	u32 offset;
+
+	first = ACPI_ADD_PTR(struct acpi_subtable_header, table_hdr,
+			     sizeof(struct acpi_table_pptt));
+
+	for (entry = first; (unsigned long)entry + proc_sz < table_end;
+	     entry = ACPI_ADD_PTR(struct acpi_subtable_header, entry,
+				  entry->length)) {
+		/* Leave broken tables to the table walk and its warnings */
+		if (entry->length == 0)
+			return NULL;
+		if (entry->type == ACPI_PPTT_TYPE_PROCESSOR)
+			nr++;
+	}
+
+	if (!nr)
+		return NULL;
+
+	index = kmalloc(struct_size(index, leaves, nr), GFP_ATOMIC);
+	if (!index)
+		return NULL;
+
+	/* Leaf nodes are the ones no other node refers to as its parent */
+	if (table_hdr->revision < 2) {
+		parents = kmalloc_array(nr, sizeof(*parents), GFP_ATOMIC);
+		if (!parents) {
+			kfree(index);
+			return NULL;
+		}
+
+		for (entry = first; (unsigned long)entry + proc_sz < table_end;
+		     entry = ACPI_ADD_PTR(struct acpi_subtable_header, entry,
+					  entry->length)) {
+			cpu_node = (struct acpi_pptt_processor *)entry;
+			if (entry->type == ACPI_PPTT_TYPE_PROCESSOR)
+				parents[nr_parents++] = cpu_node->parent;
+		}
+		sort(parents, nr_parents, sizeof(*parents), acpi_pptt_cmp_u32,
+		     NULL);
+	}
+
+	index->table = table_hdr;
+	index->count = 0;
+	for (entry = first; (unsigned long)entry + proc_sz < table_end;
+	     entry = ACPI_ADD_PTR(struct acpi_subtable_header, entry,
+				  entry->length)) {
+		if (entry->type != ACPI_PPTT_TYPE_PROCESSOR)
+			continue;
+
+		cpu_node = (struct acpi_pptt_processor *)entry;
+		offset = ACPI_PTR_DIFF(cpu_node, table_hdr);
+		if (parents ? !!bsearch(&offset, parents, nr_parents,
+					sizeof(*parents), acpi_pptt_cmp_u32) :
+			      !(cpu_node->flags & ACPI_PPTT_ACPI_LEAF_NODE))
+			continue;
+
+		index->leaves[index->count].acpi_cpu_id = cpu_node->acpi_processor_id;
+		index->leaves[index->count].offset = offset;
+		index->count++;
+	}
+
+	kfree(parents);
+	sort(index->leaves, index->count, sizeof(*index->leaves),
+	     acpi_pptt_leaf_cmp, NULL);
+
+	return index;
+}
+
+static struct acpi_pptt_index *acpi_pptt_get_index(struct acpi_table_header *table_hdr)
+{
+	struct acpi_pptt_index *index = smp_load_acquire(&pptt_index);
+
+	if (index || READ_ONCE(pptt_index_tried) || !slab_is_available())
+		return index;
+
+	WRITE_ONCE(pptt_index_tried, true);
+	index = acpi_pptt_build_index(table_hdr);
+	if (index && cmpxchg_release(&pptt_index, NULL, index)) {
+		kfree(index);
+		index = smp_load_acquire(&pptt_index);
+	}
+
+	return index;
+}
+
+/**
+ * acpi_find_processor_node() - Given a PPTT table find the requested processor
+ * @table_hdr:  Pointer to the head of the PPTT table
+ * @acpi_cpu_id: CPU we are searching for
+ *
+ * Find the leaf processor node with the given ACPI processor ID, like
+ * acpi_walk_processor_node(), but using the sorted index of the leaf nodes
+ * when there is one.
+ *
+ * Return: NULL, or the processors acpi_pptt_processor*
+ */
+static struct acpi_pptt_processor *acpi_find_processor_node(struct acpi_table_header *table_hdr,
+							    u32 acpi_cpu_id)
+{
+	struct acpi_pptt_index *index = acpi_pptt_get_index(table_hdr);
+	unsigned int lo = 0, hi, mid;
+
+	if (!index || index->table != table_hdr)
+		return acpi_walk_processor_node(table_hdr, acpi_cpu_id);
+
+	/* First leaf with the ID */
+	hi = index->count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (index->leaves[mid].acpi_cpu_id < acpi_cpu_id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == index->count || index->leaves[lo].acpi_cpu_id != acpi_cpu_id)
+		return NULL;
+
+	return fetch_pptt_node(table_hdr, index->leaves[lo].offset);
+}
+
 static u8 acpi_cache_type(enum cache_type type)
 {
 	switch (type) {
@@ -47,6 +47,11 @@ module_param(bm_check_disable, bool, 0400);
 
 static unsigned int latency_factor __read_mostly = 2;
 module_param(latency_factor, uint, 0644);
+static bool hw_residency __read_mostly;
+module_param(hw_residency, bool, 0400);
+/* Keep the C-states of CPUs across offline/online instead of re-reading _CST. */
+static bool park_offline __read_mostly;
+module_param(park_offline, bool, 0644);
 
 static DEFINE_PER_CPU(struct cpuidle_device *, acpi_cpuidle_device);
 
@@ -609,9 +614,54 @@ static __always_inline bool acpi_idle_fallback_to_c1(struct acpi_processor *pr)
 		!(acpi_gbl_FADT.flags & ACPI_FADT_C2_MP_SUPPORTED);
 }
 
-static int c3_cpu_count;
+/*
+ * Bus master arbitration is disabled by the last CPU to enter C3 and enabled
+ * again by the first one to leave it.  c3_cpu_count is updated locklessly and
+ * c3_lock is only taken by those two CPUs, to serialize the ARB_DIS updates
+ * with the c3_arb_disabled flag.  The flag is set before the last CPU
+ * re-checks the count, and the count is decremented before a leaving CPU
+ * checks the flag, so either the last CPU will see that another one has left,
+ * or the leaving CPU will see the flag and enable arbitration again.
+ */
+static atomic_t c3_cpu_count;
+static bool c3_arb_disabled;
 static DEFINE_RAW_SPINLOCK(c3_lock);
 
+static void acpi_idle_bm_arb_enter(void)
+{
+	if (atomic_inc_return(&c3_cpu_count) != num_online_cpus())
+		return;
+
+	raw_spin_lock(&c3_lock);
+
+	WRITE_ONCE(c3_arb_disabled, true);
+	smp_mb();
+	/* Disable bus master arbitration when all CPUs are in C3 */
+	if (atomic_read(&c3_cpu_count) == num_online_cpus())
+		acpi_write_bit_register(ACPI_BITREG_ARB_DISABLE, 1);
+	else
+		WRITE_ONCE(c3_arb_disabled, false);
+
+	raw_spin_unlock(&c3_lock);
+}
+
+static void acpi_idle_bm_arb_exit(void)
+{
+	/* Full barrier, pairs with the one in acpi_idle_bm_arb_enter(). */
+	atomic_dec_return(&c3_cpu_count);
+	if (!READ_ONCE(c3_arb_disabled))
+		return;
+
+	raw_spin_lock(&c3_lock);
+
+	if (c3_arb_disabled) {
+		acpi_write_bit_register(ACPI_BITREG_ARB_DISABLE, 0);
+		WRITE_ONCE(c3_arb_disabled, false);
+	}
+
+	raw_spin_unlock(&c3_lock);
+}
+
 /**
  * acpi_idle_enter_bm - enters C3 with proper BM handling
  * @drv: cpuidle driver
@@ -652,14 +702,8 @@ static int __cpuidle acpi_idle_enter_bm(struct cpuidle_driver *drv,
 		}
 	}
 
-	if (dis_bm) {
-		raw_spin_lock(&c3_lock);
-		c3_cpu_count++;
-		/* Disable bus master arbitration when all CPUs are in C3 */
-		if (c3_cpu_count == num_online_cpus())
-			acpi_write_bit_register(ACPI_BITREG_ARB_DISABLE, 1);
-		raw_spin_unlock(&c3_lock);
-	}
+	if (dis_bm)
+		acpi_idle_bm_arb_enter();
 
 	ct_cpuidle_enter();
 
@@ -668,12 +712,8 @@ static int __cpuidle acpi_idle_enter_bm(struct cpuidle_driver *drv,
 	ct_cpuidle_exit();
 
 	/* Re-enable bus master arbitration */
-	if (dis_bm) {
-		raw_spin_lock(&c3_lock);
-		acpi_write_bit_register(ACPI_BITREG_ARB_DISABLE, 0);
-		c3_cpu_count--;
-		raw_spin_unlock(&c3_lock);
-	}
+	if (dis_bm)
+		acpi_idle_bm_arb_exit();
 
 	instrumentation_end();
 
@@ -777,6 +817,31 @@ static int acpi_processor_setup_cpuidle_cx(struct acpi_processor *pr,
 	return 0;
 }
 
+/*
+ * If the hardware residency counters indicate that the C-state at @index has
+ * not been reached, return the deepest shallower state of a lower ACPI type.
+ */
+static int acpi_idle_achieved(struct cpuidle_device *dev,
+			      struct cpuidle_driver *drv, int index,
+			      u64 residency_ns)
+{
+	struct acpi_processor_cx *cx = per_cpu(acpi_cstate[index], dev->cpu);
+	int i;
+
+	if (!cx || acpi_processor_ffh_cstate_reached(cx, residency_ns))
+		return index;
+
+	for (i = index - 1; i >= ACPI_IDLE_STATE_START; i--) {
+		struct acpi_processor_cx *shallower = per_cpu(acpi_cstate[i], dev->cpu);
+
+		if (shallower && shallower->type < cx->type &&
+		    !dev->states_usage[i].disable)
+			return i;
+	}
+
+	return index;
+}
+
 static int acpi_processor_setup_cstates(struct acpi_processor *pr)
 {
 	int i, count;
@@ -824,6 +889,9 @@ static int acpi_processor_setup_cstates(struct acpi_processor *pr)
 		if (cx->type != ACPI_STATE_C1 && !acpi_idle_fallback_to_c1(pr))
 			state->enter_s2idle = acpi_idle_enter_s2idle;
 
+		if (hw_residency && acpi_processor_ffh_cstate_has_residency(cx))
+			state->achieved = acpi_idle_achieved;
+
 		count++;
 		if (count == CPUIDLE_STATE_MAX)
 			break;
@@ -1299,6 +1367,14 @@ int acpi_processor_hotplug(struct acpi_processor *pr)
 		return -ENODEV;
 
 	dev = per_cpu(acpi_cpuidle_device, pr->id);
+
+	/*
+	 * The states of an enabled device are still valid, changes of _CST are
+	 * picked up through acpi_processor_power_state_has_changed() anyway.
+	 */
+	if (park_offline && dev && dev->enabled)
+		return 0;
+
 	cpuidle_pause_and_lock();
 	cpuidle_disable_device(dev);
 	ret = acpi_processor_get_power_info(pr);
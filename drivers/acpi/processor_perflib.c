@@ -16,6 +16,7 @@
 #include <linux/init.h>
 #include <linux/cpufreq.h>
 #include <linux/slab.h>
+#include <linux/topology.h>
 #include <linux/acpi.h>
 #include <acpi/processor.h>
 #ifdef CONFIG_X86
@@ -49,32 +50,40 @@ MODULE_PARM_DESC(ignore_ppc, "If the frequency of your machine gets wrongly" \
 
 static bool acpi_processor_ppc_in_use;
 
-static int acpi_processor_get_platform_limit(struct acpi_processor *pr)
-{
-	acpi_status status = 0;
-	unsigned long long ppc = 0;
-	s32 qos_value;
-	int index;
-	int ret;
+/*
+ * On systems with many processors per package which all return the same _PSS
+ * data, evaluating it only once per package saves a noticeable amount of time
+ * during the cpufreq driver initialization.
+ */
+static bool pss_per_package;
+module_param(pss_per_package, bool, 0444);
+MODULE_PARM_DESC(pss_per_package, "Evaluate _PSS once per package and share "
+		 "the result between all of the processors in it");
 
-	if (!pr)
-		return -EINVAL;
+/*
+ * Firmware often sends the _PPC change notification to all of the processors
+ * at once.  With ppc_per_domain set, the first notification for a processor in
+ * a _PSD domain evaluates _PPC and applies the result to the whole domain, and
+ * the notifications for the other processors in it that arrive shortly after
+ * that are acknowledged without evaluating _PPC again.
+ */
+static bool ppc_per_domain;
+module_param(ppc_per_domain, bool, 0644);
+MODULE_PARM_DESC(ppc_per_domain, "Evaluate _PPC once per _PSD domain on "
+		 "notifications and share the result between its processors");
 
-	/*
-	 * _PPC indicates the maximum state currently supported by the platform
-	 * (e.g. 0 = states 0..n; 1 = states 1..n; etc.
-	 */
-	status = acpi_evaluate_integer(pr->handle, "_PPC", NULL, &ppc);
-	if (status != AE_NOT_FOUND) {
-		acpi_processor_ppc_in_use = true;
+#define ACPI_PROCESSOR_PPC_SHARE_MS	100
 
-		if (ACPI_FAILURE(status)) {
-			acpi_evaluation_failure_warn(pr->handle, "_PPC", status);
-			return -ENODEV;
-		}
-	}
+static DEFINE_MUTEX(ppc_domain_mutex);
+/* jiffies when the platform limit was last set from a sibling's _PPC */
+static DEFINE_PER_CPU(unsigned long, ppc_shared_stamp);
 
-	index = ppc;
+static int acpi_processor_set_platform_limit(struct acpi_processor *pr,
+					     unsigned long long ppc)
+{
+	s32 qos_value;
+	int index = ppc;
+	int ret;
 
 	if (pr->performance_platform_limit == index ||
 	    ppc >= pr->performance->state_count)
@@ -106,6 +115,45 @@ static int acpi_processor_get_platform_limit(struct acpi_processor *pr)
 	return 0;
 }
 
+static int acpi_processor_eval_platform_limit(struct acpi_processor *pr,
+					      unsigned long long *ppc)
+{
+	acpi_status status;
+
+	*ppc = 0;
+
+	/*
+	 * _PPC indicates the maximum state currently supported by the platform
+	 * (e.g. 0 = states 0..n; 1 = states 1..n; etc.
+	 */
+	status = acpi_evaluate_integer(pr->handle, "_PPC", NULL, ppc);
+	if (status != AE_NOT_FOUND) {
+		acpi_processor_ppc_in_use = true;
+
+		if (ACPI_FAILURE(status)) {
+			acpi_evaluation_failure_warn(pr->handle, "_PPC", status);
+			return -ENODEV;
+		}
+	}
+
+	return 0;
+}
+
+static int acpi_processor_get_platform_limit(struct acpi_processor *pr)
+{
+	unsigned long long ppc;
+	int ret;
+
+	if (!pr)
+		return -EINVAL;
+
+	ret = acpi_processor_eval_platform_limit(pr, &ppc);
+	if (ret)
+		return ret;
+
+	return acpi_processor_set_platform_limit(pr, ppc);
+}
+
 #define ACPI_PROCESSOR_NOTIFY_PERFORMANCE	0x80
 /*
  * acpi_processor_ppc_ost: Notify firmware the _PPC evaluation status
@@ -121,6 +169,71 @@ static void acpi_processor_ppc_ost(acpi_handle handle, int status)
 				  status, NULL);
 }
 
+/* Whether the limit of @pr has just been set from another processor's _PPC */
+static bool acpi_processor_ppc_shared(struct acpi_processor *pr)
+{
+	unsigned long stamp;
+
+	if (pr->id >= nr_cpu_ids)
+		return false;
+
+	stamp = per_cpu(ppc_shared_stamp, pr->id);
+	per_cpu(ppc_shared_stamp, pr->id) = 0;
+
+	return stamp && time_before(jiffies, stamp +
+				    msecs_to_jiffies(ACPI_PROCESSOR_PPC_SHARE_MS));
+}
+
+/*
+ * Evaluate _PPC for @pr and apply the result to all of the processors in its
+ * _PSD domain, updating the limits of every cpufreq policy involved once.
+ */
+static int acpi_processor_ppc_domain_changed(struct acpi_processor *pr)
+{
+	unsigned long long ppc;
+	cpumask_var_t done;
+	unsigned int cpu;
+	int ret;
+
+	if (!zalloc_cpumask_var(&done, GFP_KERNEL))
+		return -ENOMEM;
+
+	ret = acpi_processor_eval_platform_limit(pr, &ppc);
+	if (ret)
+		goto out;
+
+	for_each_cpu(cpu, pr->performance->shared_cpu_map) {
+		struct acpi_processor *match = per_cpu(processors, cpu);
+
+		if (!match || !match->performance)
+			continue;
+
+		acpi_processor_set_platform_limit(match, ppc);
+		if (match != pr)
+			per_cpu(ppc_shared_stamp, cpu) = jiffies;
+	}
+
+	for_each_cpu(cpu, pr->performance->shared_cpu_map) {
+		struct cpufreq_policy *policy;
+
+		if (cpumask_test_cpu(cpu, done) || !per_cpu(processors, cpu))
+			continue;
+
+		cpufreq_update_limits(cpu);
+
+		policy = cpufreq_cpu_get(cpu);
+		if (policy) {
+			cpumask_or(done, done, policy->cpus);
+			cpufreq_cpu_put(policy);
+		}
+		cpumask_set_cpu(cpu, done);
+	}
+
+out:
+	free_cpumask_var(done);
+	return ret;
+}
+
 void acpi_processor_ppc_has_changed(struct acpi_processor *pr, int event_flag)
 {
 	int ret;
@@ -135,6 +248,20 @@ void acpi_processor_ppc_has_changed(struct acpi_processor *pr, int event_flag)
 		return;
 	}
 
+	if (event_flag && ppc_per_domain &&
+	    cpumask_available(pr->performance->shared_cpu_map) &&
+	    cpumask_weight(pr->performance->shared_cpu_map) > 1) {
+		mutex_lock(&ppc_domain_mutex);
+		if (acpi_processor_ppc_shared(pr))
+			ret = 0;
+		else
+			ret = acpi_processor_ppc_domain_changed(pr);
+		mutex_unlock(&ppc_domain_mutex);
+
+		acpi_processor_ppc_ost(pr->handle, ret < 0 ? 1 : 0);
+		return;
+	}
+
 	ret = acpi_processor_get_platform_limit(pr);
 	/*
 	 * Only when it is notification event, the _OST object
@@ -302,6 +429,45 @@ static void amd_fixup_frequency(struct acpi_processor_px *px, int i)
 static void amd_fixup_frequency(struct acpi_processor_px *px, int i) {};
 #endif
 
+/*
+ * Reuse the performance states of a registered processor in the same package
+ * as @pr, if there is one.
+ */
+static int acpi_processor_share_performance_states(struct acpi_processor *pr)
+{
+	struct acpi_processor_px *states;
+	struct acpi_processor *match;
+	unsigned int cpu;
+
+	if (pr->id >= nr_cpu_ids)
+		return -ENODEV;
+
+	for_each_possible_cpu(cpu) {
+		match = per_cpu(processors, cpu);
+		if (!match || match == pr || !match->performance ||
+		    !match->performance->states)
+			continue;
+
+		if (topology_physical_package_id(cpu) !=
+		    topology_physical_package_id(pr->id))
+			continue;
+
+		states = kmemdup(match->performance->states,
+				 match->performance->state_count * sizeof(*states),
+				 GFP_KERNEL);
+		if (!states)
+			return -ENOMEM;
+
+		acpi_handle_debug(pr->handle, "Using _PSS data of CPU %u\n", cpu);
+
+		pr->performance->states = states;
+		pr->performance->state_count = match->performance->state_count;
+		return 0;
+	}
+
+	return -ENODEV;
+}
+
 static int acpi_processor_get_performance_states(struct acpi_processor *pr)
 {
 	int result = 0;
@@ -313,6 +479,9 @@ static int acpi_processor_get_performance_states(struct acpi_processor *pr)
 	int i;
 	int last_invalid = -1;
 
+	if (pss_per_package && !acpi_processor_share_performance_states(pr))
+		return 0;
+
 	status = acpi_evaluate_object(pr->handle, "_PSS", NULL, &buffer);
 	if (ACPI_FAILURE(status)) {
 		acpi_evaluation_failure_warn(pr->handle, "_PSS", status);
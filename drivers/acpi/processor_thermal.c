@@ -16,6 +16,7 @@
 #include <linux/acpi.h>
 #include <acpi/processor.h>
 #include <linux/uaccess.h>
+#include <linux/slab.h>
 
 #ifdef CONFIG_CPU_FREQ
 
@@ -84,20 +85,31 @@ static int cpufreq_get_cur_state(unsigned int cpu)
 
 static int cpufreq_set_cur_state(unsigned int cpu, int state)
 {
+	struct freq_qos_request **reqs;
 	struct cpufreq_policy *policy;
 	struct acpi_processor *pr;
 	unsigned long max_freq;
-	int i, ret;
+	unsigned int nr = 0;
+	int i, ret, err = 0;
+	s32 *values;
 
 	if (!cpu_has_cpufreq(cpu))
 		return 0;
 
 	reduction_pctg(cpu) = state;
 
+	reqs = kcalloc(nr_cpu_ids, sizeof(*reqs), GFP_KERNEL);
+	values = kcalloc(nr_cpu_ids, sizeof(*values), GFP_KERNEL);
+	if (!reqs || !values) {
+		err = -ENOMEM;
+		goto out;
+	}
+
 	/*
 	 * Update all the CPUs in the same package because they all
 	 * contribute to the temperature and often share the same
-	 * frequency.
+	 * frequency.  The requests are updated together, so that each
+	 * policy is only re-evaluated once for the whole package.
 	 */
 	for_each_online_cpu(i) {
 		if (topology_physical_package_id(i) !=
@@ -110,20 +122,28 @@ static int cpufreq_set_cur_state(unsigned int cpu, int state)
 			continue;
 
 		policy = cpufreq_cpu_get(i);
-		if (!policy)
-			return -EINVAL;
+		if (!policy) {
+			err = -EINVAL;
+			break;
+		}
 
 		max_freq = (policy->cpuinfo.max_freq * (100 - reduction_pctg(i) * 20)) / 100;
 
 		cpufreq_cpu_put(policy);
 
-		ret = freq_qos_update_request(&pr->thermal_req, max_freq);
-		if (ret < 0) {
-			pr_warn("Failed to update thermal freq constraint: CPU%d (%d)\n",
-				pr->id, ret);
-		}
+		reqs[nr] = &pr->thermal_req;
+		values[nr++] = max_freq;
 	}
-	return 0;
+
+	ret = freq_qos_update_requests(reqs, values, nr);
+	if (ret < 0)
+		pr_warn("Failed to update thermal freq constraints: CPU%d package (%d)\n",
+			cpu, ret);
+
+out:
+	kfree(values);
+	kfree(reqs);
+	return err;
 }
 
 void acpi_thermal_cpufreq_init(struct cpufreq_policy *policy)
@@ -20,6 +20,7 @@
 #include <linux/dmi.h>
 #include <linux/suspend.h>
 
+#include "../internal.h"
 #include "../sleep.h"
 
 #ifdef CONFIG_SUSPEND
@@ -568,6 +569,8 @@ int acpi_s2idle_prepare_late(void)
 			handler->prepare();
 	}
 
+	lpit_s2idle_prepare();
+
 	return 0;
 }
 
@@ -591,6 +594,8 @@ void acpi_s2idle_restore_early(void)
 	if (!lps0_device_handle || sleep_no_lps0)
 		return;
 
+	lpit_s2idle_restore();
+
 	list_for_each_entry(handler, &lps0_s2idle_devops_head, list_node)
 		if (handler->restore)
 			handler->restore();
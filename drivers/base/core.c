@@ -4589,7 +4589,12 @@ int device_move(struct device *dev, struct device *new_parent,
 		break;
 	}
 
+	device_pm_unlock();
+	dev_pm_qos_device_moved(dev, old_parent);
 	put_device(old_parent);
+	put_device(dev);
+	return 0;
+
 out:
 	device_pm_unlock();
 	put_device(dev);
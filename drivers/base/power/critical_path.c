@@ -0,0 +1,267 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Critical path of system-wide device suspend and resume.
+ *
+ * The PM core records when every device starts and finishes each phase of a
+ * system-wide transition.  After the phase, the chain of devices that bounded
+ * its duration is found by starting from the device that finished last and
+ * repeatedly stepping to the superior (resume) or subordinate (suspend) it
+ * was still waiting for when it started.  The result for the last transition
+ * is exposed in debugfs as "suspend_critical_path".
+ */
+
+#include <linux/debugfs.h>
+#include <linux/device.h>
+#include <linux/init.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/string.h>
+#include <linux/suspend.h>
+
+#include "../base.h"
+#include "power.h"
+
+#define DPM_CP_DEPTH		16
+#define DPM_CP_NAME_LEN		40
+
+struct dpm_cp_entry {
+	char name[DPM_CP_NAME_LEN];
+	s64 start;	/* usecs since the start of the phase */
+	s64 wait;	/* usecs spent waiting for the previous entry */
+	s64 run;	/* usecs from there until completion */
+};
+
+struct dpm_cp_phase {
+	s64 total;
+	unsigned int depth;
+	bool truncated;
+	struct dpm_cp_entry path[DPM_CP_DEPTH];	/* Last entry finished last */
+};
+
+static const char * const dpm_cp_phase_names[DPM_PHASE_NR] = {
+	[DPM_PHASE_PREPARE] = "prepare",
+	[DPM_PHASE_SUSPEND] = "suspend",
+	[DPM_PHASE_SUSPEND_LATE] = "suspend_late",
+	[DPM_PHASE_SUSPEND_NOIRQ] = "suspend_noirq",
+	[DPM_PHASE_RESUME_NOIRQ] = "resume_noirq",
+	[DPM_PHASE_RESUME_EARLY] = "resume_early",
+	[DPM_PHASE_RESUME] = "resume",
+	[DPM_PHASE_COMPLETE] = "complete",
+};
+
+static const enum suspend_stat_phase dpm_cp_stat_phases[DPM_PHASE_NR] = {
+	[DPM_PHASE_PREPARE] = SUSPEND_PHASE_PREPARE,
+	[DPM_PHASE_SUSPEND] = SUSPEND_PHASE_SUSPEND,
+	[DPM_PHASE_SUSPEND_LATE] = SUSPEND_PHASE_SUSPEND_LATE,
+	[DPM_PHASE_SUSPEND_NOIRQ] = SUSPEND_PHASE_SUSPEND_NOIRQ,
+	[DPM_PHASE_RESUME_NOIRQ] = SUSPEND_PHASE_RESUME_NOIRQ,
+	[DPM_PHASE_RESUME_EARLY] = SUSPEND_PHASE_RESUME_EARLY,
+	[DPM_PHASE_RESUME] = SUSPEND_PHASE_RESUME,
+	[DPM_PHASE_COMPLETE] = SUSPEND_PHASE_COMPLETE,
+};
+
+static struct dpm_cp_phase dpm_cp_phases[DPM_PHASE_NR];
+static DEFINE_MUTEX(dpm_cp_mtx);
+
+/* Phase bookkeeping, serialized by dpm_list_mtx in the callers. */
+static enum dpm_phase dpm_cp_cur;
+static unsigned int dpm_cp_seq;
+static ktime_t dpm_cp_start;
+
+void dpm_cp_phase_start(enum dpm_phase phase)
+{
+	dpm_cp_cur = phase;
+	dpm_cp_start = ktime_get();
+	WRITE_ONCE(dpm_cp_seq, dpm_cp_seq + 1);
+}
+
+void dpm_cp_dev_start(struct device *dev)
+{
+	dev->power.dpm_seq = READ_ONCE(dpm_cp_seq);
+	dev->power.dpm_start = ktime_get();
+	dev->power.dpm_end = dev->power.dpm_start;
+}
+
+void dpm_cp_dev_end(struct device *dev)
+{
+	dev->power.dpm_end = ktime_get();
+}
+
+static bool dpm_cp_valid(struct device *dev)
+{
+	return dev->power.dpm_seq == dpm_cp_seq;
+}
+
+struct dpm_cp_search {
+	struct device *dev;
+	struct device *blocker;
+};
+
+/*
+ * @cand has to be waited for by @s->dev if it completed after @s->dev had
+ * started, and the one of those that completed last is the blocker.
+ */
+static void dpm_cp_consider(struct dpm_cp_search *s, struct device *cand)
+{
+	if (!cand || !dpm_cp_valid(cand) ||
+	    cand->power.dpm_end <= s->dev->power.dpm_start)
+		return;
+
+	if (s->blocker && cand->power.dpm_end <= s->blocker->power.dpm_end)
+		return;
+
+	put_device(s->blocker);
+	s->blocker = get_device(cand);
+}
+
+static int dpm_cp_consider_fn(struct device *dev, void *data)
+{
+	dpm_cp_consider(data, dev);
+	return 0;
+}
+
+/* Return the (referenced) device that @dev was waiting for, if any. */
+static struct device *dpm_cp_find_blocker(struct device *dev)
+{
+	struct dpm_cp_search s = { .dev = dev, };
+	struct device_link *link;
+	int idx;
+
+	switch (dpm_cp_cur) {
+	case DPM_PHASE_SUSPEND:
+	case DPM_PHASE_SUSPEND_LATE:
+	case DPM_PHASE_SUSPEND_NOIRQ:
+		device_for_each_child(dev, &s, dpm_cp_consider_fn);
+
+		idx = device_links_read_lock();
+		list_for_each_entry_rcu_locked(link, &dev->links.consumers, s_node)
+			if (READ_ONCE(link->status) != DL_STATE_DORMANT)
+				dpm_cp_consider(&s, link->consumer);
+		device_links_read_unlock(idx);
+		break;
+	case DPM_PHASE_RESUME_NOIRQ:
+	case DPM_PHASE_RESUME_EARLY:
+	case DPM_PHASE_RESUME:
+		dpm_cp_consider(&s, dev->parent);
+
+		idx = device_links_read_lock();
+		list_for_each_entry_rcu_locked(link, &dev->links.suppliers, c_node)
+			if (READ_ONCE(link->status) != DL_STATE_DORMANT)
+				dpm_cp_consider(&s, link->supplier);
+		device_links_read_unlock(idx);
+		break;
+	default:
+		/* Prepare and complete are carried out sequentially. */
+		break;
+	}
+
+	return s.blocker;
+}
+
+/**
+ * dpm_cp_phase_end - Compute the critical path of the current phase.
+ * @list: List of the devices that have been handled in the phase.
+ *
+ * Must be called under dpm_list_mtx after all of the async callbacks of the
+ * phase have returned.
+ */
+void dpm_cp_phase_end(struct list_head *list)
+{
+	struct dpm_cp_phase *p = &dpm_cp_phases[dpm_cp_cur];
+	struct device *dev, *last = NULL;
+	unsigned int i;
+
+	list_for_each_entry(dev, list, power.entry) {
+		if (!dpm_cp_valid(dev))
+			continue;
+
+		suspend_bench_report_dev(dpm_cp_stat_phases[dpm_cp_cur],
+					 dev_name(dev),
+					 ktime_us_delta(dev->power.dpm_end,
+							dev->power.dpm_start));
+
+		if (!last || dev->power.dpm_end > last->power.dpm_end)
+			last = dev;
+	}
+
+	mutex_lock(&dpm_cp_mtx);
+
+	memset(p, 0, sizeof(*p));
+	if (!last)
+		goto out;
+
+	p->total = ktime_us_delta(last->power.dpm_end, dpm_cp_start);
+
+	/* Walk backwards from the end, filling the path from its tail. */
+	dev = get_device(last);
+	while (dev) {
+		struct device *blocker = dpm_cp_find_blocker(dev);
+		struct dpm_cp_entry *e;
+		ktime_t ready;
+
+		if (p->depth == DPM_CP_DEPTH) {
+			p->truncated = true;
+			put_device(blocker);
+			put_device(dev);
+			break;
+		}
+
+		ready = blocker ? blocker->power.dpm_end : dev->power.dpm_start;
+
+		e = &p->path[DPM_CP_DEPTH - ++p->depth];
+		strscpy(e->name, dev_name(dev), sizeof(e->name));
+		e->start = ktime_us_delta(dev->power.dpm_start, dpm_cp_start);
+		e->wait = ktime_us_delta(ready, dev->power.dpm_start);
+		e->run = ktime_us_delta(dev->power.dpm_end, ready);
+
+		put_device(dev);
+		dev = blocker;
+	}
+
+	/* Move the path to the beginning of the array. */
+	for (i = 0; i < p->depth; i++)
+		p->path[i] = p->path[DPM_CP_DEPTH - p->depth + i];
+
+out:
+	mutex_unlock(&dpm_cp_mtx);
+}
+
+static int suspend_critical_path_show(struct seq_file *s, void *unused)
+{
+	enum dpm_phase phase;
+	unsigned int i;
+
+	mutex_lock(&dpm_cp_mtx);
+
+	for (phase = 0; phase < DPM_PHASE_NR; phase++) {
+		struct dpm_cp_phase *p = &dpm_cp_phases[phase];
+
+		if (!p->depth)
+			continue;
+
+		seq_printf(s, "%s: %lld usecs%s\n", dpm_cp_phase_names[phase],
+			   p->total, p->truncated ? " (truncated)" : "");
+		seq_printf(s, "  %10s %10s %10s  %s\n",
+			   "start", "wait", "run", "device");
+
+		for (i = 0; i < p->depth; i++)
+			seq_printf(s, "  %10lld %10lld %10lld  %s\n",
+				   p->path[i].start, p->path[i].wait,
+				   p->path[i].run, p->path[i].name);
+	}
+
+	mutex_unlock(&dpm_cp_mtx);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(suspend_critical_path);
+
+static int __init dpm_cp_debugfs_init(void)
+{
+	debugfs_create_file("suspend_critical_path", 0444, NULL, NULL,
+			    &suspend_critical_path_fops);
+	return 0;
+}
+
+late_initcall(dpm_cp_debugfs_init);
@@ -22,6 +22,7 @@
 #include <linux/export.h>
 #include <linux/cpu.h>
 #include <linux/debugfs.h>
+#include <linux/workqueue.h>
 
 #include "power.h"
 
@@ -461,6 +462,26 @@ int dev_pm_genpd_set_performance_state(struct device *dev, unsigned int state)
 }
 EXPORT_SYMBOL_GPL(dev_pm_genpd_set_performance_state);
 
+/*
+ * Keep the lower bound of the devices' next wakeups up to date without taking
+ * the domain lock.  Moving a wakeup earlier just lowers the bound, while moving
+ * the earliest one later needs the devices to be rescanned by the governor.
+ */
+static void genpd_update_dev_next_wakeup(struct genpd_governor_data *gd,
+					 ktime_t old, ktime_t next)
+{
+	s64 cur = atomic64_read(&gd->dev_next_wakeup);
+
+	if (next > old) {
+		if (old <= cur)
+			WRITE_ONCE(gd->dev_next_wakeup_stale, true);
+		return;
+	}
+
+	while (next < cur && !atomic64_try_cmpxchg(&gd->dev_next_wakeup, &cur, next))
+		;
+}
+
 /**
  * dev_pm_genpd_set_next_wakeup - Notify PM framework of an impending wakeup.
  *
@@ -480,14 +501,20 @@ void dev_pm_genpd_set_next_wakeup(struct device *dev, ktime_t next)
 {
 	struct generic_pm_domain *genpd;
 	struct gpd_timing_data *td;
+	ktime_t old;
 
 	genpd = dev_to_genpd_safe(dev);
 	if (!genpd)
 		return;
 
 	td = to_gpd_data(dev->power.subsys_data->domain_data)->td;
-	if (td)
-		td->next_wakeup = next;
+	if (!td)
+		return;
+
+	old = td->next_wakeup;
+	WRITE_ONCE(td->next_wakeup, next);
+	if (genpd->gd)
+		genpd_update_dev_next_wakeup(genpd->gd, old, next);
 }
 EXPORT_SYMBOL_GPL(dev_pm_genpd_set_next_wakeup);
 
@@ -541,6 +568,14 @@ void dev_pm_genpd_synced_poweroff(struct device *dev)
 }
 EXPORT_SYMBOL_GPL(dev_pm_genpd_synced_poweroff);
 
+static void genpd_lat_hist_add(u32 *hist, s64 elapsed_ns)
+{
+	s64 us = div_s64(elapsed_ns, NSEC_PER_USEC);
+	int bucket = us > 0 ? ilog2(us) : 0;
+
+	hist[min(bucket, GENPD_LAT_HIST_BUCKETS - 1)]++;
+}
+
 static int _genpd_power_on(struct generic_pm_domain *genpd, bool timed)
 {
 	unsigned int state_idx = genpd->state_idx;
@@ -559,7 +594,10 @@ static int _genpd_power_on(struct generic_pm_domain *genpd, bool timed)
 	if (!genpd->power_on)
 		goto out;
 
-	timed = timed && genpd->gd && !genpd->states[state_idx].fwnode;
+	/*
+	 * The untimed path is used with timekeeping suspended, during system
+	 * suspend and resume, so the clock must not be read then.
+	 */
 	if (!timed) {
 		ret = genpd->power_on(genpd);
 		if (ret)
@@ -574,7 +612,10 @@ static int _genpd_power_on(struct generic_pm_domain *genpd, bool timed)
 		goto err;
 
 	elapsed_ns = ktime_to_ns(ktime_sub(ktime_get(), time_start));
-	if (elapsed_ns <= genpd->states[state_idx].power_on_latency_ns)
+	genpd_lat_hist_add(genpd->states[state_idx].power_on_hist, elapsed_ns);
+
+	if (!genpd->gd || genpd->states[state_idx].fwnode ||
+	    elapsed_ns <= genpd->states[state_idx].power_on_latency_ns)
 		goto out;
 
 	genpd->states[state_idx].power_on_latency_ns = elapsed_ns;
@@ -610,7 +651,10 @@ static int _genpd_power_off(struct generic_pm_domain *genpd, bool timed)
 	if (!genpd->power_off)
 		goto out;
 
-	timed = timed && genpd->gd && !genpd->states[state_idx].fwnode;
+	/*
+	 * The untimed path is used with timekeeping suspended, during system
+	 * suspend and resume, so the clock must not be read then.
+	 */
 	if (!timed) {
 		ret = genpd->power_off(genpd);
 		if (ret)
@@ -625,7 +669,10 @@ static int _genpd_power_off(struct generic_pm_domain *genpd, bool timed)
 		goto busy;
 
 	elapsed_ns = ktime_to_ns(ktime_sub(ktime_get(), time_start));
-	if (elapsed_ns <= genpd->states[state_idx].power_off_latency_ns)
+	genpd_lat_hist_add(genpd->states[state_idx].power_off_hist, elapsed_ns);
+
+	if (!genpd->gd || genpd->states[state_idx].fwnode ||
+	    elapsed_ns <= genpd->states[state_idx].power_off_latency_ns)
 		goto out;
 
 	genpd->states[state_idx].power_off_latency_ns = elapsed_ns;
@@ -654,6 +701,16 @@ static void genpd_queue_power_off_work(struct generic_pm_domain *genpd)
 	queue_work(pm_wq, &genpd->power_off_work);
 }
 
+/*
+ * The governor has allowed the power off, but it is not going to happen, so
+ * it must not expect the domain to be powered on from the chosen state.
+ */
+static void genpd_power_off_aborted(struct generic_pm_domain *genpd)
+{
+	if (genpd->gd)
+		genpd->gd->off_pending = false;
+}
+
 /**
  * genpd_power_off - Remove power from a given PM domain.
  * @genpd: PM domain to power down.
@@ -687,11 +744,12 @@ static int genpd_power_off(struct generic_pm_domain *genpd, bool one_dev_on,
 	 * (1) The domain is configured as always on.
 	 * (2) When the domain has a subdomain being powered on.
 	 */
-	if (genpd_is_always_on(genpd) ||
-			genpd_is_rpm_always_on(genpd) ||
-			atomic_read(&genpd->sd_count) > 0)
+	if (genpd_is_always_on(genpd) || genpd_is_rpm_always_on(genpd))
 		return -EBUSY;
 
+	if (atomic_read(&genpd->sd_count) > 0)
+		goto busy;
+
 	/*
 	 * The children must be in their deepest (powered-off) states to allow
 	 * the parent to be powered off. Note that, there's no need for
@@ -701,7 +759,7 @@ static int genpd_power_off(struct generic_pm_domain *genpd, bool one_dev_on,
 	list_for_each_entry(link, &genpd->parent_links, parent_node) {
 		struct generic_pm_domain *child = link->child;
 		if (child->state_idx < child->state_count - 1)
-			return -EBUSY;
+			goto busy;
 	}
 
 	list_for_each_entry(pdd, &genpd->dev_list, list_node) {
@@ -715,11 +773,13 @@ static int genpd_power_off(struct generic_pm_domain *genpd, bool one_dev_on,
 	}
 
 	if (not_suspended > 1 || (not_suspended == 1 && !one_dev_on))
-		return -EBUSY;
+		goto busy;
 
 	if (genpd->gov && genpd->gov->power_down_ok) {
-		if (!genpd->gov->power_down_ok(&genpd->domain))
+		if (!genpd->gov->power_down_ok(&genpd->domain)) {
+			genpd->vetoed_count++;
 			return -EAGAIN;
+		}
 	}
 
 	/* Default to shallowest state. */
@@ -727,11 +787,14 @@ static int genpd_power_off(struct generic_pm_domain *genpd, bool one_dev_on,
 		genpd->state_idx = 0;
 
 	/* Don't power off, if a child domain is waiting to power on. */
-	if (atomic_read(&genpd->sd_count) > 0)
-		return -EBUSY;
+	if (atomic_read(&genpd->sd_count) > 0) {
+		genpd_power_off_aborted(genpd);
+		goto busy;
+	}
 
 	ret = _genpd_power_off(genpd, true);
 	if (ret) {
+		genpd_power_off_aborted(genpd);
 		genpd->states[genpd->state_idx].rejected++;
 		return ret;
 	}
@@ -748,6 +811,33 @@ static int genpd_power_off(struct generic_pm_domain *genpd, bool one_dev_on,
 	}
 
 	return 0;
+
+busy:
+	genpd->busy_count++;
+	return -EBUSY;
+}
+
+/*
+ * Powering on a domain may be needed to resume a device involved in memory
+ * reclaim, so the parallel power-on work must have a rescuer.
+ */
+static struct workqueue_struct *genpd_power_on_wq;
+
+static int __init genpd_power_on_wq_init(void)
+{
+	genpd_power_on_wq = alloc_workqueue("genpd_power_on",
+					    WQ_UNBOUND | WQ_MEM_RECLAIM, 0);
+	return genpd_power_on_wq ? 0 : -ENOMEM;
+}
+core_initcall(genpd_power_on_wq_init);
+
+/*
+ * The rescuer runs one work item at a time, so it must not wait for other work
+ * items queued to the same workqueue.
+ */
+static bool genpd_power_on_parallel_ok(void)
+{
+	return genpd_power_on_wq && !current_is_workqueue_rescuer();
 }
 
 /**
@@ -761,11 +851,21 @@ static int genpd_power_off(struct generic_pm_domain *genpd, bool one_dev_on,
 static int genpd_power_on(struct generic_pm_domain *genpd, unsigned int depth)
 {
 	struct gpd_link *link;
+	bool parallel;
 	int ret = 0;
 
 	if (genpd_status_on(genpd))
 		return 0;
 
+	/*
+	 * With more than one parent, power them on concurrently, unless that
+	 * is not possible, because this has to be done in atomic context.
+	 */
+	parallel = !genpd_is_irq_safe(genpd) &&
+		   !list_empty(&genpd->child_links) &&
+		   !list_is_singular(&genpd->child_links) &&
+		   genpd_power_on_parallel_ok();
+
 	/*
 	 * The list is guaranteed not to change while the loop below is being
 	 * executed, unless one of the parents' .power_on() callbacks fiddles
@@ -776,6 +876,12 @@ static int genpd_power_on(struct generic_pm_domain *genpd, unsigned int depth)
 
 		genpd_sd_counter_inc(parent);
 
+		if (parallel) {
+			link->power_on_depth = depth + 1;
+			queue_work(genpd_power_on_wq, &link->power_on_work);
+			continue;
+		}
+
 		genpd_lock_nested(parent, depth + 1);
 		ret = genpd_power_on(parent, depth + 1);
 		genpd_unlock(parent);
@@ -786,6 +892,17 @@ static int genpd_power_on(struct generic_pm_domain *genpd, unsigned int depth)
 		}
 	}
 
+	if (parallel) {
+		list_for_each_entry(link, &genpd->child_links, child_node) {
+			flush_work(&link->power_on_work);
+			if (link->power_on_ret && !ret)
+				ret = link->power_on_ret;
+		}
+
+		if (ret)
+			goto err_parallel;
+	}
+
 	ret = _genpd_power_on(genpd, true);
 	if (ret)
 		goto err;
@@ -793,6 +910,9 @@ static int genpd_power_on(struct generic_pm_domain *genpd, unsigned int depth)
 	genpd->status = GENPD_STATE_ON;
 	genpd_update_accounting(genpd);
 
+	if (genpd->gov && genpd->gov->power_on)
+		genpd->gov->power_on(&genpd->domain);
+
 	return 0;
 
  err:
@@ -806,8 +926,113 @@ static int genpd_power_on(struct generic_pm_domain *genpd, unsigned int depth)
 	}
 
 	return ret;
+
+ err_parallel:
+	list_for_each_entry(link, &genpd->child_links, child_node) {
+		genpd_sd_counter_dec(link->parent);
+		if (link->power_on_ret)
+			continue;
+
+		genpd_lock_nested(link->parent, depth + 1);
+		genpd_power_off(link->parent, false, depth + 1);
+		genpd_unlock(link->parent);
+	}
+
+	return ret;
+}
+
+static void genpd_power_on_parent_work_fn(struct work_struct *work)
+{
+	struct gpd_link *link = container_of(work, struct gpd_link, power_on_work);
+	struct generic_pm_domain *parent = link->parent;
+
+	genpd_lock_nested(parent, link->power_on_depth);
+	link->power_on_ret = genpd_power_on(parent, link->power_on_depth);
+	genpd_unlock(parent);
 }
 
+struct genpd_batch_work {
+	struct work_struct work;
+	struct generic_pm_domain *genpd;
+	int ret;
+};
+
+static void genpd_batch_power_on_work_fn(struct work_struct *work)
+{
+	struct genpd_batch_work *bw = container_of(work, struct genpd_batch_work,
+						   work);
+
+	genpd_lock(bw->genpd);
+	bw->ret = genpd_power_on(bw->genpd, 0);
+	genpd_unlock(bw->genpd);
+}
+
+/**
+ * pm_genpd_power_on_batch - Power on a set of PM domains concurrently.
+ * @genpds: PM domains to power on.
+ * @nr: Number of entries in @genpds.
+ *
+ * Power on all of the PM domains in @genpds, along with their parents, with
+ * the independent parts of the hierarchy being powered on in parallel, and
+ * keep them on until pm_genpd_power_off_batch() is called for them.  While
+ * that is the case, each of them is counted as one more subdomain being on.
+ *
+ * Return 0 on success, or the error code of the first domain that failed to
+ * power on, in which case none of the domains is kept on.
+ */
+int pm_genpd_power_on_batch(struct generic_pm_domain **genpds, unsigned int nr)
+{
+	struct genpd_batch_work *works;
+	unsigned int i;
+	int ret = 0;
+
+	works = kcalloc(nr, sizeof(*works), GFP_KERNEL);
+	if (!works)
+		return -ENOMEM;
+
+	for (i = 0; i < nr; i++) {
+		works[i].genpd = genpds[i];
+		INIT_WORK(&works[i].work, genpd_batch_power_on_work_fn);
+		genpd_sd_counter_inc(genpds[i]);
+		if (genpd_power_on_parallel_ok())
+			queue_work(genpd_power_on_wq, &works[i].work);
+		else
+			genpd_batch_power_on_work_fn(&works[i].work);
+	}
+
+	for (i = 0; i < nr; i++) {
+		flush_work(&works[i].work);
+		if (works[i].ret && !ret)
+			ret = works[i].ret;
+	}
+
+	kfree(works);
+
+	if (ret)
+		pm_genpd_power_off_batch(genpds, nr);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(pm_genpd_power_on_batch);
+
+/**
+ * pm_genpd_power_off_batch - Allow a set of PM domains to be powered off.
+ * @genpds: PM domains to handle.
+ * @nr: Number of entries in @genpds.
+ *
+ * Counterpart of pm_genpd_power_on_batch().
+ */
+void pm_genpd_power_off_batch(struct generic_pm_domain **genpds,
+			      unsigned int nr)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr; i++)
+		if (genpd_sd_counter_dec(genpds[i]))
+			genpd_queue_power_off_work(genpds[i]);
+}
+EXPORT_SYMBOL_GPL(pm_genpd_power_off_batch);
+
 static int genpd_dev_pm_start(struct device *dev)
 {
 	struct generic_pm_domain *genpd = dev_to_genpd(dev);
@@ -1706,8 +1931,10 @@ static int genpd_remove_device(struct generic_pm_domain *genpd,
 	}
 
 	genpd->device_count--;
-	if (genpd->gd)
+	if (genpd->gd) {
 		genpd->gd->max_off_time_changed = true;
+		WRITE_ONCE(genpd->gd->dev_next_wakeup_stale, true);
+	}
 
 	genpd_clear_cpumask(genpd, gpd_data->cpu);
 	dev_pm_domain_set(dev, NULL);
@@ -1865,6 +2092,8 @@ static int genpd_add_subdomain(struct generic_pm_domain *genpd,
 	if (!link)
 		return -ENOMEM;
 
+	INIT_WORK(&link->power_on_work, genpd_power_on_parent_work_fn);
+
 	genpd_lock(subdomain);
 	genpd_lock_nested(genpd, SINGLE_DEPTH_NESTING);
 
@@ -2000,6 +2229,8 @@ static int genpd_alloc_data(struct generic_pm_domain *genpd)
 		gd->max_off_time_changed = true;
 		gd->next_wakeup = KTIME_MAX;
 		gd->next_hrtimer = KTIME_MAX;
+		gd->dev_constraint_ns = -1;
+		atomic64_set(&gd->dev_next_wakeup, KTIME_MAX);
 	}
 
 	/* Use only one "off" state if there were no states declared */
@@ -3364,6 +3595,108 @@ static int perf_state_show(struct seq_file *s, void *data)
 	return 0;
 }
 
+/*
+ * Binary snapshot of the idle state statistics, in native byte order, meant
+ * for being collected without parsing the text files:
+ *
+ *	u32 number of states
+ *	u32 number of histogram buckets (GENPD_LAT_HIST_BUCKETS)
+ *	u64 power off attempts refused as devices or subdomains were still on
+ *	u64 power off attempts refused by the governor
+ *
+ * followed by, for each state:
+ *
+ *	u64 usage
+ *	u64 power off attempts rejected by the provider
+ *	u64 time spent in the state (nsecs)
+ *	s64 power off latency used by the governor (nsecs)
+ *	s64 power on latency used by the governor (nsecs)
+ *	u32 histogram of the power off latencies: bucket i counts the latencies
+ *	    from 2^i to 2^(i+1) - 1 usecs, with the first bucket also counting
+ *	    the shorter ones and the last bucket the longer ones.
+ *	u32 histogram of the power on latencies, likewise.
+ */
+struct genpd_idle_stats_hdr {
+	u32 state_count;
+	u32 buckets;
+	u64 busy;
+	u64 vetoed;
+} __packed;
+
+struct genpd_idle_stats_state {
+	u64 usage;
+	u64 rejected;
+	u64 idle_time;
+	s64 power_off_latency_ns;
+	s64 power_on_latency_ns;
+	u32 power_off_hist[GENPD_LAT_HIST_BUCKETS];
+	u32 power_on_hist[GENPD_LAT_HIST_BUCKETS];
+} __packed;
+
+static ssize_t idle_stats_read(struct file *file, char __user *ubuf,
+			       size_t count, loff_t *ppos)
+{
+	struct generic_pm_domain *genpd = file->private_data;
+	struct genpd_idle_stats_state *states;
+	struct genpd_idle_stats_hdr *hdr;
+	unsigned int i;
+	size_t size;
+	ssize_t ret;
+	u64 now;
+
+	size = sizeof(*hdr) + array_size(genpd->state_count, sizeof(*states));
+	hdr = kzalloc(size, GFP_KERNEL);
+	if (!hdr)
+		return -ENOMEM;
+
+	states = (struct genpd_idle_stats_state *)(hdr + 1);
+
+	ret = genpd_lock_interruptible(genpd);
+	if (ret) {
+		kfree(hdr);
+		return -ERESTARTSYS;
+	}
+
+	hdr->state_count = genpd->state_count;
+	hdr->buckets = GENPD_LAT_HIST_BUCKETS;
+	hdr->busy = genpd->busy_count;
+	hdr->vetoed = genpd->vetoed_count;
+
+	for (i = 0; i < genpd->state_count; i++) {
+		struct genpd_power_state *state = &genpd->states[i];
+
+		states[i].usage = state->usage;
+		states[i].rejected = state->rejected;
+		states[i].idle_time = state->idle_time;
+		states[i].power_off_latency_ns = state->power_off_latency_ns;
+		states[i].power_on_latency_ns = state->power_on_latency_ns;
+		memcpy(states[i].power_off_hist, state->power_off_hist,
+		       sizeof(states[i].power_off_hist));
+		memcpy(states[i].power_on_hist, state->power_on_hist,
+		       sizeof(states[i].power_on_hist));
+
+		if (genpd->status == GENPD_STATE_OFF && genpd->state_idx == i) {
+			now = ktime_get_mono_fast_ns();
+			if (now > genpd->accounting_time)
+				states[i].idle_time += now - genpd->accounting_time;
+		}
+	}
+
+	genpd_unlock(genpd);
+
+	ret = simple_read_from_buffer(ubuf, count, ppos, hdr, size);
+	kfree(hdr);
+
+	return ret;
+}
+
+static const struct file_operations idle_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.read = idle_stats_read,
+	.llseek = default_llseek,
+};
+
 DEFINE_SHOW_ATTRIBUTE(summary);
 DEFINE_SHOW_ATTRIBUTE(status);
 DEFINE_SHOW_ATTRIBUTE(sub_domains);
@@ -3388,6 +3721,8 @@ static void genpd_debug_add(struct generic_pm_domain *genpd)
 			    d, genpd, &sub_domains_fops);
 	debugfs_create_file("idle_states", 0444,
 			    d, genpd, &idle_states_fops);
+	debugfs_create_file("idle_stats", 0444,
+			    d, genpd, &idle_stats_fops);
 	debugfs_create_file("active_time", 0444,
 			    d, genpd, &active_time_fops);
 	debugfs_create_file("total_idle_time", 0444,
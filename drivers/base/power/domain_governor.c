@@ -81,8 +81,12 @@ static bool default_suspend_ok(struct device *dev)
 	 * We can walk the children without any additional locking, because
 	 * they all have been suspended at this point and their
 	 * effective_constraint_ns fields won't be modified in parallel with us.
+	 *
+	 * If neither the device nor any of its descendants has a constraint,
+	 * the children have nothing to add, so don't walk them at all.
 	 */
-	if (!dev->power.ignore_children)
+	if (!dev->power.ignore_children &&
+	    dev_pm_qos_subtree_resume_latency(dev) != PM_QOS_RESUME_LATENCY_NO_CONSTRAINT)
 		device_for_each_child(dev, &constraint_ns,
 				      dev_update_qos_constraint);
 
@@ -120,11 +124,50 @@ static bool default_suspend_ok(struct device *dev)
 	return td->cached_suspend_ok;
 }
 
-static void update_domain_next_wakeup(struct generic_pm_domain *genpd, ktime_t now)
+static ktime_t dev_next_wakeup(struct generic_pm_domain *genpd, ktime_t now)
 {
-	ktime_t domain_wakeup = KTIME_MAX;
+	struct genpd_governor_data *gd = genpd->gd;
+	ktime_t domain_wakeup = atomic64_read(&gd->dev_next_wakeup);
 	ktime_t next_wakeup;
 	struct pm_domain_data *pdd;
+	s64 cached;
+
+	/*
+	 * The cached value is a lower bound of the devices' next wakeups, so
+	 * it can be used as long as it still is in the future and none of the
+	 * devices has pushed back the earliest wakeup in the meantime.
+	 */
+	if (!READ_ONCE(gd->dev_next_wakeup_stale) &&
+	    !ktime_before(domain_wakeup, now))
+		return domain_wakeup;
+
+	WRITE_ONCE(gd->dev_next_wakeup_stale, false);
+	cached = domain_wakeup;
+
+	domain_wakeup = KTIME_MAX;
+	list_for_each_entry(pdd, &genpd->dev_list, list_node) {
+		next_wakeup = READ_ONCE(to_gpd_data(pdd)->td->next_wakeup);
+		if (next_wakeup != KTIME_MAX && !ktime_before(next_wakeup, now))
+			if (ktime_before(next_wakeup, domain_wakeup))
+				domain_wakeup = next_wakeup;
+	}
+
+	/*
+	 * If a device has lowered the bound during the scan, its new wakeup may
+	 * have been missed, so keep the lower value and rescan next time.
+	 */
+	if (!atomic64_try_cmpxchg(&gd->dev_next_wakeup, &cached, domain_wakeup)) {
+		WRITE_ONCE(gd->dev_next_wakeup_stale, true);
+		domain_wakeup = min(domain_wakeup, cached);
+	}
+
+	return domain_wakeup;
+}
+
+static void update_domain_next_wakeup(struct generic_pm_domain *genpd, ktime_t now)
+{
+	ktime_t domain_wakeup;
+	ktime_t next_wakeup;
 	struct gpd_link *link;
 
 	if (!(genpd->flags & GENPD_FLAG_MIN_RESIDENCY))
@@ -138,12 +181,7 @@ static void update_domain_next_wakeup(struct generic_pm_domain *genpd, ktime_t n
 	 * stale when we read that here. We will ignore to ensure the domain
 	 * is able to enter its optimal idle state.
 	 */
-	list_for_each_entry(pdd, &genpd->dev_list, list_node) {
-		next_wakeup = to_gpd_data(pdd)->td->next_wakeup;
-		if (next_wakeup != KTIME_MAX && !ktime_before(next_wakeup, now))
-			if (ktime_before(next_wakeup, domain_wakeup))
-				domain_wakeup = next_wakeup;
-	}
+	domain_wakeup = dev_next_wakeup(genpd, now);
 
 	list_for_each_entry(link, &genpd->parent_links, parent_node) {
 		struct genpd_governor_data *cgd = link->child->gd;
@@ -171,14 +209,41 @@ static bool next_wakeup_allows_state(struct generic_pm_domain *genpd,
 	return idle_time_ns >= min_sleep_ns;
 }
 
+/*
+ * Return the smallest effective constraint of the devices in the domain, or -1
+ * if none of them has one.  It only changes along with max_off_time_changed,
+ * so it need not be recomputed for every state that is checked.
+ */
+static s64 dev_min_constraint(struct generic_pm_domain *genpd)
+{
+	struct pm_domain_data *pdd;
+	s64 min_constraint_ns = -1;
+
+	list_for_each_entry(pdd, &genpd->dev_list, list_node) {
+		s64 constraint_ns = to_gpd_data(pdd)->td->effective_constraint_ns;
+
+		/*
+		 * Zero means "no suspend at all" and this runs only when all
+		 * devices in the domain are suspended, so it must be positive.
+		 */
+		if (constraint_ns == PM_QOS_RESUME_LATENCY_NO_CONSTRAINT_NS)
+			continue;
+
+		if (min_constraint_ns > constraint_ns || min_constraint_ns < 0)
+			min_constraint_ns = constraint_ns;
+	}
+
+	return min_constraint_ns;
+}
+
 static bool __default_power_down_ok(struct dev_pm_domain *pd,
 				     unsigned int state)
 {
 	struct generic_pm_domain *genpd = pd_to_genpd(pd);
 	struct gpd_link *link;
-	struct pm_domain_data *pdd;
 	s64 min_off_time_ns;
 	s64 off_on_time_ns;
+	s64 constraint_ns;
 
 	off_on_time_ns = genpd->states[state].power_off_latency_ns +
 		genpd->states[state].power_on_latency_ns;
@@ -210,26 +275,12 @@ static bool __default_power_down_ok(struct dev_pm_domain *pd,
 	}
 
 	/*
-	 * Check if the devices in the domain can be off enough time.
+	 * Check if the devices in the domain are allowed to be off long enough
+	 * for the domain to turn off and on (that's how much time they will
+	 * have to wait worst case).
 	 */
-	list_for_each_entry(pdd, &genpd->dev_list, list_node) {
-		struct gpd_timing_data *td;
-		s64 constraint_ns;
-
-		/*
-		 * Check if the device is allowed to be off long enough for the
-		 * domain to turn off and on (that's how much time it will
-		 * have to wait worst case).
-		 */
-		td = to_gpd_data(pdd)->td;
-		constraint_ns = td->effective_constraint_ns;
-		/*
-		 * Zero means "no suspend at all" and this runs only when all
-		 * devices in the domain are suspended, so it must be positive.
-		 */
-		if (constraint_ns == PM_QOS_RESUME_LATENCY_NO_CONSTRAINT_NS)
-			continue;
-
+	constraint_ns = genpd->gd->dev_constraint_ns;
+	if (constraint_ns >= 0) {
 		if (constraint_ns <= off_on_time_ns)
 			return false;
 
@@ -314,6 +365,7 @@ static bool _default_power_down_ok(struct dev_pm_domain *pd, ktime_t now)
 	gd->max_off_time_ns = -1;
 	gd->max_off_time_changed = false;
 	gd->cached_power_down_ok = true;
+	gd->dev_constraint_ns = dev_min_constraint(genpd);
 
 	/*
 	 * Find a state to power down to, starting from the state
@@ -339,12 +391,12 @@ static bool default_power_down_ok(struct dev_pm_domain *pd)
 }
 
 #ifdef CONFIG_CPU_IDLE
-static bool cpu_power_down_ok(struct dev_pm_domain *pd)
+static bool __cpu_power_down_ok(struct dev_pm_domain *pd, ktime_t now)
 {
 	struct generic_pm_domain *genpd = pd_to_genpd(pd);
 	struct cpuidle_device *dev;
 	ktime_t domain_wakeup, next_hrtimer;
-	ktime_t now = ktime_get();
+	bool forced_idle = true;
 	s64 idle_duration_ns;
 	int cpu, i;
 
@@ -359,6 +411,10 @@ static bool cpu_power_down_ok(struct dev_pm_domain *pd)
 	 * Find the next wakeup for any of the online CPUs within the PM domain
 	 * and its subdomains. Note, we only need the genpd->cpus, as it already
 	 * contains a mask of all CPUs from subdomains.
+	 *
+	 * Check if all of them are in forced idle, as during synchronized idle
+	 * injection, in the same pass, so the last CPU going idle only has to
+	 * look at the state of the others once.
 	 */
 	domain_wakeup = ktime_set(KTIME_SEC_MAX, 0);
 	for_each_cpu_and(cpu, genpd->cpus, cpu_online_mask) {
@@ -367,6 +423,10 @@ static bool cpu_power_down_ok(struct dev_pm_domain *pd)
 			next_hrtimer = READ_ONCE(dev->next_hrtimer);
 			if (ktime_before(next_hrtimer, domain_wakeup))
 				domain_wakeup = next_hrtimer;
+			if (!READ_ONCE(dev->forced_idle_latency_limit_ns))
+				forced_idle = false;
+		} else {
+			forced_idle = false;
 		}
 	}
 
@@ -377,6 +437,7 @@ static bool cpu_power_down_ok(struct dev_pm_domain *pd)
 
 	/* Store the next domain_wakeup to allow consumers to use it. */
 	genpd->gd->next_hrtimer = domain_wakeup;
+	genpd->gd->forced_idle = forced_idle;
 
 	/*
 	 * Find the deepest idle state that has its residency value satisfied
@@ -395,10 +456,149 @@ static bool cpu_power_down_ok(struct dev_pm_domain *pd)
 	return false;
 }
 
+static bool cpu_power_down_ok(struct dev_pm_domain *pd)
+{
+	return __cpu_power_down_ok(pd, ktime_get());
+}
+
 struct dev_power_governor pm_domain_cpu_gov = {
 	.suspend_ok = default_suspend_ok,
 	.power_down_ok = cpu_power_down_ok,
 };
+
+/*
+ * The CPU "TEO" governor below starts from the state picked by the next timer
+ * event, like cpu_power_down_ok(), but also learns from the way the previous
+ * power off periods ended, in analogy with the TEO cpuidle governor.
+ *
+ * When the domain is powered on, the time it has spent off is compared with
+ * the time to the timer event it was expecting.  If the domain stayed off long
+ * enough for the state the timer pointed to, that state gets a "hit".  If it
+ * was woken up earlier by something else, the state whose residency was
+ * actually met (if any) gets an "intercept".  All of the metrics decay over
+ * time, so more recent wakeups matter more.
+ */
+#define GENPD_TEO_PULSE		1024
+#define GENPD_TEO_DECAY_SHIFT	3
+
+/* Return the deepest state of @genpd that pays off for @duration_ns, or -1. */
+static int cpu_teo_state(struct generic_pm_domain *genpd, s64 duration_ns)
+{
+	int i;
+
+	for (i = genpd->state_count - 1; i >= 0; i--)
+		if (duration_ns >= genpd->states[i].residency_ns +
+				   genpd->states[i].power_off_latency_ns)
+			break;
+
+	return i;
+}
+
+static void cpu_teo_power_on(struct dev_pm_domain *pd)
+{
+	struct generic_pm_domain *genpd = pd_to_genpd(pd);
+	struct genpd_governor_data *gd = genpd->gd;
+	int i, timer_idx, idle_idx;
+	ktime_t now = ktime_get();
+
+	if (!gd->off_pending)
+		return;
+
+	gd->off_pending = false;
+
+	timer_idx = cpu_teo_state(genpd, ktime_to_ns(ktime_sub(gd->next_hrtimer,
+							      gd->off_time)));
+	idle_idx = cpu_teo_state(genpd, ktime_to_ns(ktime_sub(now, gd->off_time)));
+
+	for (i = 0; i < genpd->state_count; i++) {
+		genpd->states[i].hits -= genpd->states[i].hits >> GENPD_TEO_DECAY_SHIFT;
+		genpd->states[i].intercepts -=
+			genpd->states[i].intercepts >> GENPD_TEO_DECAY_SHIFT;
+	}
+	gd->short_intercepts -= gd->short_intercepts >> GENPD_TEO_DECAY_SHIFT;
+
+	if (timer_idx < 0)
+		return;
+
+	if (idle_idx >= timer_idx)
+		genpd->states[timer_idx].hits += GENPD_TEO_PULSE;
+	else if (idle_idx >= 0)
+		genpd->states[idle_idx].intercepts += GENPD_TEO_PULSE;
+	else
+		gd->short_intercepts += GENPD_TEO_PULSE;
+}
+
+/*
+ * If the early wakeups recorded for the states shallower than the one picked
+ * by the timer outweigh everything recorded for that state and the deeper
+ * ones, the timer is not a good predictor, so go for the deepest state that
+ * the majority of those early wakeups still would have allowed, if any.
+ */
+static bool cpu_teo_select(struct generic_pm_domain *genpd)
+{
+	struct genpd_governor_data *gd = genpd->gd;
+	int idx = genpd->state_idx;
+	unsigned int early, late = 0, sum = 0;
+	int i;
+
+	early = gd->short_intercepts;
+	for (i = 0; i < idx; i++)
+		early += genpd->states[i].intercepts;
+
+	for (i = idx; i < genpd->state_count; i++)
+		late += genpd->states[i].hits + genpd->states[i].intercepts;
+
+	if (early <= late)
+		return true;
+
+	for (i = idx - 1; i >= 0; i--) {
+		sum += genpd->states[i].intercepts;
+		if (2 * sum > early) {
+			genpd->state_idx = i;
+			return true;
+		}
+	}
+
+	/* Most of the time the domain would not have stayed off long enough. */
+	return false;
+}
+
+static bool cpu_teo_power_down_ok(struct dev_pm_domain *pd)
+{
+	struct generic_pm_domain *genpd = pd_to_genpd(pd);
+	ktime_t now = ktime_get();
+
+	/* Only the power off allowed below is to be recorded. */
+	genpd->gd->off_pending = false;
+
+	if (!__cpu_power_down_ok(pd, now))
+		return false;
+
+	/* Without the next timer event there is nothing to learn from. */
+	if (!(genpd->flags & GENPD_FLAG_CPU_DOMAIN))
+		return true;
+
+	/*
+	 * Go for the state picked by the timer right away during idle
+	 * injection and keep it out of the metrics, which describe the
+	 * regular wakeup pattern of the domain.
+	 */
+	if (genpd->gd->forced_idle)
+		return true;
+
+	if (!cpu_teo_select(genpd))
+		return false;
+
+	genpd->gd->off_time = now;
+	genpd->gd->off_pending = true;
+	return true;
+}
+
+struct dev_power_governor pm_domain_cpu_teo_gov = {
+	.suspend_ok = default_suspend_ok,
+	.power_down_ok = cpu_teo_power_down_ok,
+	.power_on = cpu_teo_power_on,
+};
 #endif
 
 struct dev_power_governor simple_qos_governor = {
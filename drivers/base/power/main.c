@@ -62,6 +62,7 @@ static LIST_HEAD(dpm_noirq_list);
 
 struct suspend_stats suspend_stats;
 static DEFINE_MUTEX(dpm_list_mtx);
+static DEFINE_MUTEX(async_wip_mtx);
 static pm_message_t pm_transition;
 
 static int async_error;
@@ -102,6 +103,7 @@ void device_pm_sleep_init(struct device *dev)
 	dev->power.is_late_suspended = false;
 	init_completion(&dev->power.completion);
 	complete_all(&dev->power.completion);
+	dev->power.work_in_progress = true;
 	dev->power.wakeup = NULL;
 	INIT_LIST_HEAD(&dev->power.entry);
 }
@@ -228,6 +230,20 @@ static void initcall_debug_report(struct device *dev, ktime_t calltime,
 		 (unsigned long long)ktime_us_delta(rettime, calltime));
 }
 
+/*
+ * Compute the critical path of the phase that has just been completed, which
+ * needs to be done after all of the async callbacks have returned.
+ */
+static void dpm_cp_phase_finish(struct list_head *list)
+{
+	if (!IS_ENABLED(CONFIG_PM_SLEEP_DEBUG))
+		return;
+
+	mutex_lock(&dpm_list_mtx);
+	dpm_cp_phase_end(list);
+	mutex_unlock(&dpm_list_mtx);
+}
+
 /**
  * dpm_wait - Wait for a PM operation to complete.
  * @dev: Device to wait for.
@@ -470,6 +486,18 @@ static void dpm_show_time(ktime_t starttime, pm_message_t state, int error,
 		  usecs / USEC_PER_MSEC, usecs % USEC_PER_MSEC);
 }
 
+/*
+ * Account the duration of a phase in suspend_stats, for system suspend and
+ * resume only, when it has run to completion.
+ */
+static void dpm_report_phase(enum suspend_stat_phase phase, ktime_t starttime,
+			     pm_message_t state, int error)
+{
+	if (!error && (state.event == PM_EVENT_SUSPEND ||
+		       state.event == PM_EVENT_RESUME))
+		pm_report_phase_time(phase, starttime);
+}
+
 static int dpm_run_callback(pm_callback_t cb, struct device *dev,
 			    pm_message_t state, const char *info)
 {
@@ -596,6 +624,7 @@ static int device_resume_noirq(struct device *dev, pm_message_t state, bool asyn
 
 	TRACE_DEVICE(dev);
 	TRACE_RESUME(0);
+	dpm_cp_dev_start(dev);
 
 	if (dev->power.syscore || dev->power.direct_complete)
 		goto Out;
@@ -653,6 +682,7 @@ static int device_resume_noirq(struct device *dev, pm_message_t state, bool asyn
 	dev->power.is_noirq_suspended = false;
 
 Out:
+	dpm_cp_dev_end(dev);
 	complete_all(&dev->power.completion);
 	TRACE_RESUME(error);
 	return error;
@@ -664,17 +694,162 @@ static bool is_async(struct device *dev)
 		&& !pm_trace_is_enabled();
 }
 
-static bool dpm_async_fn(struct device *dev, async_func_t func)
+static void dpm_clear_async_state(struct device *dev)
 {
 	reinit_completion(&dev->power.completion);
+	dev->power.work_in_progress = false;
+}
 
-	if (is_async(dev)) {
-		get_device(dev);
-		async_schedule_dev(func, dev);
+/*
+ * Schedule @func for @dev unless @dev is "sync" or has been scheduled already
+ * in the current phase.  Return true if @dev is going to be (or has been)
+ * handled asynchronously.
+ */
+static bool dpm_async_fn(struct device *dev, async_func_t func)
+{
+	if (!is_async(dev))
+		return false;
+
+	mutex_lock(&async_wip_mtx);
+
+	if (dev->power.work_in_progress) {
+		mutex_unlock(&async_wip_mtx);
 		return true;
 	}
 
-	return false;
+	dev->power.work_in_progress = true;
+
+	mutex_unlock(&async_wip_mtx);
+
+	/*
+	 * The flag claims @dev, so it can be scheduled without holding the
+	 * mutex, which would otherwise serialize every caller behind the
+	 * work allocation.
+	 */
+	get_device(dev);
+	async_schedule_dev(func, dev);
+
+	return true;
+}
+
+/*
+ * Check if the parent and all of the suppliers of @dev have completed the
+ * current resume phase, in which case @dev can be resumed without waiting.
+ */
+static bool dpm_superiors_done(struct device *dev)
+{
+	struct device_link *link;
+	bool ret = true;
+	int idx;
+
+	if (dev->parent && !completion_done(&dev->parent->power.completion))
+		return false;
+
+	idx = device_links_read_lock();
+
+	list_for_each_entry_rcu_locked(link, &dev->links.suppliers, c_node) {
+		if (READ_ONCE(link->status) != DL_STATE_DORMANT &&
+		    !completion_done(&link->supplier->power.completion)) {
+			ret = false;
+			break;
+		}
+	}
+
+	device_links_read_unlock(idx);
+
+	return ret;
+}
+
+static void dpm_async_resume_ready(struct device *dev, async_func_t func)
+{
+	if (dpm_superiors_done(dev))
+		dpm_async_fn(dev, func);
+}
+
+static int dpm_async_resume_child_fn(struct device *dev, void *data)
+{
+	dpm_async_resume_ready(dev, *(async_func_t *)data);
+	return 0;
+}
+
+/**
+ * dpm_async_resume_subordinate - Start resuming the children and consumers.
+ * @dev: Device that has just been resumed.
+ * @func: Async callback of the current resume phase.
+ *
+ * Instead of scheduling all "async" devices upfront and letting most of them
+ * block in dpm_wait_for_superior(), schedule every "async" child or consumer
+ * of @dev as soon as the last one of its superiors has been handled.  Since
+ * the completion of @dev has been signaled before this runs, at least one of
+ * the superiors racing with each other is guaranteed to see the subordinate
+ * as ready.
+ */
+static void dpm_async_resume_subordinate(struct device *dev, async_func_t func)
+{
+	struct device_link *link;
+	int idx;
+
+	device_for_each_child(dev, &func, dpm_async_resume_child_fn);
+
+	idx = device_links_read_lock();
+
+	list_for_each_entry_rcu_locked(link, &dev->links.consumers, s_node)
+		if (READ_ONCE(link->status) != DL_STATE_DORMANT)
+			dpm_async_resume_ready(link->consumer, func);
+
+	device_links_read_unlock(idx);
+}
+
+/*
+ * Make sure that all "async" superiors of a "sync" device are going to be
+ * handled, so the "sync" device does not wait for them forever in case they
+ * have not been scheduled by dpm_async_resume_subordinate() (which may happen
+ * if one of their own superiors has gone away in the meantime).
+ */
+static void dpm_async_resume_superiors(struct device *dev, async_func_t func)
+{
+	struct device_link *link;
+	int idx;
+
+	if (dev->parent)
+		dpm_async_fn(dev->parent, func);
+
+	idx = device_links_read_lock();
+
+	list_for_each_entry_rcu_locked(link, &dev->links.suppliers, c_node)
+		if (READ_ONCE(link->status) != DL_STATE_DORMANT)
+			dpm_async_fn(link->supplier, func);
+
+	device_links_read_unlock(idx);
+}
+
+/*
+ * Prepare the devices in @list for a resume phase and start resuming the
+ * "async" ones that do not depend on any other devices.  The rest of the
+ * "async" devices are scheduled by dpm_async_resume_subordinate() when their
+ * superiors are done.
+ */
+static void dpm_async_resume_start(struct list_head *list, async_func_t func)
+{
+	struct device *dev;
+
+	list_for_each_entry(dev, list, power.entry)
+		dpm_clear_async_state(dev);
+
+	list_for_each_entry(dev, list, power.entry)
+		dpm_async_resume_ready(dev, func);
+}
+
+/*
+ * Schedule any "async" devices in @list that have not been started yet.  That
+ * only happens if a superior has gone away before dispatching them.
+ */
+static void dpm_async_resume_finish(struct list_head *list, async_func_t func)
+{
+	struct device *dev;
+
+	list_for_each_entry(dev, list, power.entry)
+		dpm_async_fn(dev, func);
 }
 
 static void async_resume_noirq(void *data, async_cookie_t cookie)
@@ -686,6 +861,8 @@ static void async_resume_noirq(void *data, async_cookie_t cookie)
 	if (error)
 		pm_dev_err(dev, pm_transition, " async", error);
 
+	dpm_async_resume_subordinate(dev, async_resume_noirq);
+
 	put_device(dev);
 }
 
@@ -697,41 +874,53 @@ static void dpm_noirq_resume_devices(pm_message_t state)
 	trace_suspend_resume(TPS("dpm_resume_noirq"), state.event, true);
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
+	dpm_cp_phase_start(DPM_PHASE_RESUME_NOIRQ);
 
 	/*
-	 * Advanced the async threads upfront,
-	 * in case the starting of async threads is
-	 * delayed by non-async resuming devices.
+	 * Start the async threads upfront, in case the starting of async
+	 * threads is delayed by non-async resuming devices.
 	 */
-	list_for_each_entry(dev, &dpm_noirq_list, power.entry)
-		dpm_async_fn(dev, async_resume_noirq);
+	dpm_async_resume_start(&dpm_noirq_list, async_resume_noirq);
 
 	while (!list_empty(&dpm_noirq_list)) {
+		int error;
+
 		dev = to_device(dpm_noirq_list.next);
-		get_device(dev);
 		list_move_tail(&dev->power.entry, &dpm_late_early_list);
 
+		/*
+		 * "Async" devices are started by their superiors, so just move
+		 * them over without dropping the lock.
+		 */
+		if (is_async(dev))
+			continue;
+
+		get_device(dev);
+
 		mutex_unlock(&dpm_list_mtx);
 
-		if (!is_async(dev)) {
-			int error;
+		dpm_async_resume_superiors(dev, async_resume_noirq);
 
-			error = device_resume_noirq(dev, state, false);
-			if (error) {
-				suspend_stats.failed_resume_noirq++;
-				dpm_save_failed_step(SUSPEND_RESUME_NOIRQ);
-				dpm_save_failed_dev(dev_name(dev));
-				pm_dev_err(dev, state, " noirq", error);
-			}
+		error = device_resume_noirq(dev, state, false);
+		if (error) {
+			suspend_stats.failed_resume_noirq++;
+			dpm_save_failed_step(SUSPEND_RESUME_NOIRQ);
+			dpm_save_failed_dev(dev_name(dev));
+			pm_dev_err(dev, state, " noirq", error);
 		}
 
+		dpm_async_resume_subordinate(dev, async_resume_noirq);
+
 		put_device(dev);
 
 		mutex_lock(&dpm_list_mtx);
 	}
+	dpm_async_resume_finish(&dpm_late_early_list, async_resume_noirq);
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
+	dpm_cp_phase_finish(&dpm_late_early_list);
 	dpm_show_time(starttime, state, 0, "noirq");
+	dpm_report_phase(SUSPEND_PHASE_RESUME_NOIRQ, starttime, state, 0);
 	trace_suspend_resume(TPS("dpm_resume_noirq"), state.event, false);
 }
 
@@ -766,6 +955,7 @@ static int device_resume_early(struct device *dev, pm_message_t state, bool asyn
 
 	TRACE_DEVICE(dev);
 	TRACE_RESUME(0);
+	dpm_cp_dev_start(dev);
 
 	if (dev->power.syscore || dev->power.direct_complete)
 		goto Out;
@@ -810,6 +1000,7 @@ static int device_resume_early(struct device *dev, pm_message_t state, bool asyn
 	TRACE_RESUME(error);
 
 	pm_runtime_enable(dev);
+	dpm_cp_dev_end(dev);
 	complete_all(&dev->power.completion);
 	return error;
 }
@@ -823,6 +1014,8 @@ static void async_resume_early(void *data, async_cookie_t cookie)
 	if (error)
 		pm_dev_err(dev, pm_transition, " async", error);
 
+	dpm_async_resume_subordinate(dev, async_resume_early);
+
 	put_device(dev);
 }
 
@@ -838,41 +1031,53 @@ void dpm_resume_early(pm_message_t state)
 	trace_suspend_resume(TPS("dpm_resume_early"), state.event, true);
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
+	dpm_cp_phase_start(DPM_PHASE_RESUME_EARLY);
 
 	/*
-	 * Advanced the async threads upfront,
-	 * in case the starting of async threads is
-	 * delayed by non-async resuming devices.
+	 * Start the async threads upfront, in case the starting of async
+	 * threads is delayed by non-async resuming devices.
 	 */
-	list_for_each_entry(dev, &dpm_late_early_list, power.entry)
-		dpm_async_fn(dev, async_resume_early);
+	dpm_async_resume_start(&dpm_late_early_list, async_resume_early);
 
 	while (!list_empty(&dpm_late_early_list)) {
+		int error;
+
 		dev = to_device(dpm_late_early_list.next);
-		get_device(dev);
 		list_move_tail(&dev->power.entry, &dpm_suspended_list);
 
+		/*
+		 * "Async" devices are started by their superiors, so just move
+		 * them over without dropping the lock.
+		 */
+		if (is_async(dev))
+			continue;
+
+		get_device(dev);
+
 		mutex_unlock(&dpm_list_mtx);
 
-		if (!is_async(dev)) {
-			int error;
+		dpm_async_resume_superiors(dev, async_resume_early);
 
-			error = device_resume_early(dev, state, false);
-			if (error) {
-				suspend_stats.failed_resume_early++;
-				dpm_save_failed_step(SUSPEND_RESUME_EARLY);
-				dpm_save_failed_dev(dev_name(dev));
-				pm_dev_err(dev, state, " early", error);
-			}
+		error = device_resume_early(dev, state, false);
+		if (error) {
+			suspend_stats.failed_resume_early++;
+			dpm_save_failed_step(SUSPEND_RESUME_EARLY);
+			dpm_save_failed_dev(dev_name(dev));
+			pm_dev_err(dev, state, " early", error);
 		}
 
+		dpm_async_resume_subordinate(dev, async_resume_early);
+
 		put_device(dev);
 
 		mutex_lock(&dpm_list_mtx);
 	}
+	dpm_async_resume_finish(&dpm_suspended_list, async_resume_early);
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
+	dpm_cp_phase_finish(&dpm_suspended_list);
 	dpm_show_time(starttime, state, 0, "early");
+	dpm_report_phase(SUSPEND_PHASE_RESUME_EARLY, starttime, state, 0);
 	trace_suspend_resume(TPS("dpm_resume_early"), state.event, false);
 }
 
@@ -902,6 +1107,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 
 	TRACE_DEVICE(dev);
 	TRACE_RESUME(0);
+	dpm_cp_dev_start(dev);
 
 	if (dev->power.syscore)
 		goto Complete;
@@ -971,6 +1177,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 	dpm_watchdog_clear(&wd);
 
  Complete:
+	dpm_cp_dev_end(dev);
 	complete_all(&dev->power.completion);
 
 	TRACE_RESUME(error);
@@ -986,6 +1193,9 @@ static void async_resume(void *data, async_cookie_t cookie)
 	error = device_resume(dev, pm_transition, true);
 	if (error)
 		pm_dev_err(dev, pm_transition, " async", error);
+
+	dpm_async_resume_subordinate(dev, async_resume);
+
 	put_device(dev);
 }
 
@@ -1006,29 +1216,43 @@ void dpm_resume(pm_message_t state)
 
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
+	dpm_cp_phase_start(DPM_PHASE_RESUME);
 	async_error = 0;
 
-	list_for_each_entry(dev, &dpm_suspended_list, power.entry)
-		dpm_async_fn(dev, async_resume);
+	dpm_async_resume_start(&dpm_suspended_list, async_resume);
 
 	while (!list_empty(&dpm_suspended_list)) {
+		int error;
+
 		dev = to_device(dpm_suspended_list.next);
+
+		/*
+		 * "Async" devices are started by their superiors, so just move
+		 * them over without dropping the lock.
+		 */
+		if (is_async(dev)) {
+			list_move_tail(&dev->power.entry, &dpm_prepared_list);
+			continue;
+		}
+
 		get_device(dev);
-		if (!is_async(dev)) {
-			int error;
 
-			mutex_unlock(&dpm_list_mtx);
+		mutex_unlock(&dpm_list_mtx);
 
-			error = device_resume(dev, state, false);
-			if (error) {
-				suspend_stats.failed_resume++;
-				dpm_save_failed_step(SUSPEND_RESUME);
-				dpm_save_failed_dev(dev_name(dev));
-				pm_dev_err(dev, state, "", error);
-			}
+		dpm_async_resume_superiors(dev, async_resume);
 
-			mutex_lock(&dpm_list_mtx);
+		error = device_resume(dev, state, false);
+		if (error) {
+			suspend_stats.failed_resume++;
+			dpm_save_failed_step(SUSPEND_RESUME);
+			dpm_save_failed_dev(dev_name(dev));
+			pm_dev_err(dev, state, "", error);
 		}
+
+		dpm_async_resume_subordinate(dev, async_resume);
+
+		mutex_lock(&dpm_list_mtx);
+
 		if (!list_empty(&dev->power.entry))
 			list_move_tail(&dev->power.entry, &dpm_prepared_list);
 
@@ -1038,9 +1262,12 @@ void dpm_resume(pm_message_t state)
 
 		mutex_lock(&dpm_list_mtx);
 	}
+	dpm_async_resume_finish(&dpm_prepared_list, async_resume);
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
+	dpm_cp_phase_finish(&dpm_prepared_list);
 	dpm_show_time(starttime, state, 0, NULL);
+	dpm_report_phase(SUSPEND_PHASE_RESUME, starttime, state, 0);
 
 	cpufreq_resume();
 	devfreq_resume();
@@ -1101,6 +1328,7 @@ static void device_complete(struct device *dev, pm_message_t state)
  */
 void dpm_complete(pm_message_t state)
 {
+	ktime_t starttime = ktime_get();
 	struct list_head list;
 
 	trace_suspend_resume(TPS("dpm_complete"), state.event, true);
@@ -1108,6 +1336,7 @@ void dpm_complete(pm_message_t state)
 
 	INIT_LIST_HEAD(&list);
 	mutex_lock(&dpm_list_mtx);
+	dpm_cp_phase_start(DPM_PHASE_COMPLETE);
 	while (!list_empty(&dpm_prepared_list)) {
 		struct device *dev = to_device(dpm_prepared_list.prev);
 
@@ -1118,18 +1347,22 @@ void dpm_complete(pm_message_t state)
 		mutex_unlock(&dpm_list_mtx);
 
 		trace_device_pm_callback_start(dev, "", state.event);
+		dpm_cp_dev_start(dev);
 		device_complete(dev, state);
+		dpm_cp_dev_end(dev);
 		trace_device_pm_callback_end(dev, 0);
 
 		put_device(dev);
 
 		mutex_lock(&dpm_list_mtx);
 	}
+	dpm_cp_phase_end(&list);
 	list_splice(&list, &dpm_list);
 	mutex_unlock(&dpm_list_mtx);
 
 	/* Allow device probing and trigger re-probing of deferred devices */
 	device_unblock_probing();
+	dpm_report_phase(SUSPEND_PHASE_COMPLETE, starttime, state, 0);
 	trace_suspend_resume(TPS("dpm_complete"), state.event, false);
 }
 
@@ -1204,6 +1437,7 @@ static int __device_suspend_noirq(struct device *dev, pm_message_t state, bool a
 
 	TRACE_DEVICE(dev);
 	TRACE_SUSPEND(0);
+	dpm_cp_dev_start(dev);
 
 	dpm_wait_for_subordinate(dev, async);
 
@@ -1262,11 +1496,37 @@ static int __device_suspend_noirq(struct device *dev, pm_message_t state, bool a
 		dpm_superior_set_must_resume(dev);
 
 Complete:
+	dpm_cp_dev_end(dev);
 	complete_all(&dev->power.completion);
 	TRACE_SUSPEND(error);
 	return error;
 }
 
+/*
+ * Move an "async" @dev to @list and schedule @func for it.  dpm_list_mtx is
+ * dropped around the scheduling, so that the device list is not held while
+ * the work is allocated and queued.  Return false for a "sync" device, which
+ * is left where it is.
+ */
+static bool dpm_async_suspend_dev(struct device *dev, struct list_head *list,
+				  async_func_t func)
+{
+	if (!is_async(dev))
+		return false;
+
+	list_move(&dev->power.entry, list);
+	get_device(dev);
+
+	mutex_unlock(&dpm_list_mtx);
+
+	dpm_async_fn(dev, func);
+	put_device(dev);
+
+	mutex_lock(&dpm_list_mtx);
+
+	return true;
+}
+
 static void async_suspend_noirq(void *data, async_cookie_t cookie)
 {
 	struct device *dev = data;
@@ -1281,14 +1541,6 @@ static void async_suspend_noirq(void *data, async_cookie_t cookie)
 	put_device(dev);
 }
 
-static int device_suspend_noirq(struct device *dev)
-{
-	if (dpm_async_fn(dev, async_suspend_noirq))
-		return 0;
-
-	return __device_suspend_noirq(dev, pm_transition, false);
-}
-
 static int dpm_noirq_suspend_devices(pm_message_t state)
 {
 	ktime_t starttime = ktime_get();
@@ -1297,15 +1549,26 @@ static int dpm_noirq_suspend_devices(pm_message_t state)
 	trace_suspend_resume(TPS("dpm_suspend_noirq"), state.event, true);
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
+	dpm_cp_phase_start(DPM_PHASE_SUSPEND_NOIRQ);
 	async_error = 0;
 
 	while (!list_empty(&dpm_late_early_list)) {
 		struct device *dev = to_device(dpm_late_early_list.prev);
 
+		dpm_clear_async_state(dev);
+
+		if (dpm_async_suspend_dev(dev, &dpm_noirq_list,
+					  async_suspend_noirq)) {
+			if (async_error)
+				break;
+
+			continue;
+		}
+
 		get_device(dev);
 		mutex_unlock(&dpm_list_mtx);
 
-		error = device_suspend_noirq(dev);
+		error = __device_suspend_noirq(dev, state, false);
 
 		mutex_lock(&dpm_list_mtx);
 
@@ -1327,6 +1590,7 @@ static int dpm_noirq_suspend_devices(pm_message_t state)
 	}
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
+	dpm_cp_phase_finish(&dpm_noirq_list);
 	if (!error)
 		error = async_error;
 
@@ -1335,6 +1599,7 @@ static int dpm_noirq_suspend_devices(pm_message_t state)
 		dpm_save_failed_step(SUSPEND_SUSPEND_NOIRQ);
 	}
 	dpm_show_time(starttime, state, error, "noirq");
+	dpm_report_phase(SUSPEND_PHASE_SUSPEND_NOIRQ, starttime, state, error);
 	trace_suspend_resume(TPS("dpm_suspend_noirq"), state.event, false);
 	return error;
 }
@@ -1391,6 +1656,7 @@ static int __device_suspend_late(struct device *dev, pm_message_t state, bool as
 
 	TRACE_DEVICE(dev);
 	TRACE_SUSPEND(0);
+	dpm_cp_dev_start(dev);
 
 	__pm_runtime_disable(dev, false);
 
@@ -1444,6 +1710,7 @@ static int __device_suspend_late(struct device *dev, pm_message_t state, bool as
 
 Complete:
 	TRACE_SUSPEND(error);
+	dpm_cp_dev_end(dev);
 	complete_all(&dev->power.completion);
 	return error;
 }
@@ -1461,14 +1728,6 @@ static void async_suspend_late(void *data, async_cookie_t cookie)
 	put_device(dev);
 }
 
-static int device_suspend_late(struct device *dev)
-{
-	if (dpm_async_fn(dev, async_suspend_late))
-		return 0;
-
-	return __device_suspend_late(dev, pm_transition, false);
-}
-
 /**
  * dpm_suspend_late - Execute "late suspend" callbacks for all devices.
  * @state: PM transition of the system being carried out.
@@ -1482,16 +1741,27 @@ int dpm_suspend_late(pm_message_t state)
 	wake_up_all_idle_cpus();
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
+	dpm_cp_phase_start(DPM_PHASE_SUSPEND_LATE);
 	async_error = 0;
 
 	while (!list_empty(&dpm_suspended_list)) {
 		struct device *dev = to_device(dpm_suspended_list.prev);
 
+		dpm_clear_async_state(dev);
+
+		if (dpm_async_suspend_dev(dev, &dpm_late_early_list,
+					  async_suspend_late)) {
+			if (async_error)
+				break;
+
+			continue;
+		}
+
 		get_device(dev);
 
 		mutex_unlock(&dpm_list_mtx);
 
-		error = device_suspend_late(dev);
+		error = __device_suspend_late(dev, state, false);
 
 		mutex_lock(&dpm_list_mtx);
 
@@ -1514,6 +1784,7 @@ int dpm_suspend_late(pm_message_t state)
 	}
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
+	dpm_cp_phase_finish(&dpm_late_early_list);
 	if (!error)
 		error = async_error;
 	if (error) {
@@ -1522,6 +1793,7 @@ int dpm_suspend_late(pm_message_t state)
 		dpm_resume_early(resume_event(state));
 	}
 	dpm_show_time(starttime, state, error, "late");
+	dpm_report_phase(SUSPEND_PHASE_SUSPEND_LATE, starttime, state, error);
 	trace_suspend_resume(TPS("dpm_suspend_late"), state.event, false);
 	return error;
 }
@@ -1612,6 +1884,7 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 
 	TRACE_DEVICE(dev);
 	TRACE_SUSPEND(0);
+	dpm_cp_dev_start(dev);
 
 	dpm_wait_for_subordinate(dev, async);
 
@@ -1720,6 +1993,7 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 	if (error)
 		async_error = error;
 
+	dpm_cp_dev_end(dev);
 	complete_all(&dev->power.completion);
 	TRACE_SUSPEND(error);
 	return error;
@@ -1739,14 +2013,6 @@ static void async_suspend(void *data, async_cookie_t cookie)
 	put_device(dev);
 }
 
-static int device_suspend(struct device *dev)
-{
-	if (dpm_async_fn(dev, async_suspend))
-		return 0;
-
-	return __device_suspend(dev, pm_transition, false);
-}
-
 /**
  * dpm_suspend - Execute "suspend" callbacks for all non-sysdev devices.
  * @state: PM transition of the system being carried out.
@@ -1764,15 +2030,26 @@ int dpm_suspend(pm_message_t state)
 
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
+	dpm_cp_phase_start(DPM_PHASE_SUSPEND);
 	async_error = 0;
 	while (!list_empty(&dpm_prepared_list)) {
 		struct device *dev = to_device(dpm_prepared_list.prev);
 
+		dpm_clear_async_state(dev);
+
+		if (dpm_async_suspend_dev(dev, &dpm_suspended_list,
+					  async_suspend)) {
+			if (async_error)
+				break;
+
+			continue;
+		}
+
 		get_device(dev);
 
 		mutex_unlock(&dpm_list_mtx);
 
-		error = device_suspend(dev);
+		error = __device_suspend(dev, state, false);
 
 		mutex_lock(&dpm_list_mtx);
 
@@ -1794,6 +2071,7 @@ int dpm_suspend(pm_message_t state)
 	}
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
+	dpm_cp_phase_finish(&dpm_suspended_list);
 	if (!error)
 		error = async_error;
 	if (error) {
@@ -1801,6 +2079,7 @@ int dpm_suspend(pm_message_t state)
 		dpm_save_failed_step(SUSPEND_SUSPEND);
 	}
 	dpm_show_time(starttime, state, error, NULL);
+	dpm_report_phase(SUSPEND_PHASE_SUSPEND, starttime, state, error);
 	trace_suspend_resume(TPS("dpm_suspend"), state.event, false);
 	return error;
 }
@@ -1882,6 +2161,7 @@ static int device_prepare(struct device *dev, pm_message_t state)
  */
 int dpm_prepare(pm_message_t state)
 {
+	ktime_t starttime = ktime_get();
 	int error = 0;
 
 	trace_suspend_resume(TPS("dpm_prepare"), state.event, true);
@@ -1902,6 +2182,7 @@ int dpm_prepare(pm_message_t state)
 	device_block_probing();
 
 	mutex_lock(&dpm_list_mtx);
+	dpm_cp_phase_start(DPM_PHASE_PREPARE);
 	while (!list_empty(&dpm_list) && !error) {
 		struct device *dev = to_device(dpm_list.next);
 
@@ -1910,7 +2191,9 @@ int dpm_prepare(pm_message_t state)
 		mutex_unlock(&dpm_list_mtx);
 
 		trace_device_pm_callback_start(dev, "", state.event);
+		dpm_cp_dev_start(dev);
 		error = device_prepare(dev, state);
+		dpm_cp_dev_end(dev);
 		trace_device_pm_callback_end(dev, error);
 
 		mutex_lock(&dpm_list_mtx);
@@ -1932,7 +2215,9 @@ int dpm_prepare(pm_message_t state)
 
 		mutex_lock(&dpm_list_mtx);
 	}
+	dpm_cp_phase_end(&dpm_prepared_list);
 	mutex_unlock(&dpm_list_mtx);
+	dpm_report_phase(SUSPEND_PHASE_PREPARE, starttime, state, error);
 	trace_suspend_resume(TPS("dpm_prepare"), state.event, false);
 	return error;
 }
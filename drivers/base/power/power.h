@@ -6,6 +6,7 @@ static inline void device_pm_init_common(struct device *dev)
 	if (!dev->power.early_init) {
 		spin_lock_init(&dev->power.lock);
 		dev->power.qos = NULL;
+		dev->power.subtree_resume_latency = PM_QOS_RESUME_LATENCY_NO_CONSTRAINT;
 		dev->power.early_init = true;
 	}
 }
@@ -23,6 +24,11 @@ extern void pm_runtime_reinit(struct device *dev);
 extern void pm_runtime_remove(struct device *dev);
 extern u64 pm_runtime_active_time(struct device *dev);
 
+#ifdef CONFIG_PM_ADVANCED_DEBUG
+extern int pm_runtime_set_histograms(struct device *dev, bool enable);
+extern ssize_t pm_runtime_show_histograms(struct device *dev, char *buf);
+#endif
+
 #define WAKE_IRQ_DEDICATED_ALLOCATED	BIT(0)
 #define WAKE_IRQ_DEDICATED_MANAGED	BIT(1)
 #define WAKE_IRQ_DEDICATED_REVERSE	BIT(2)
@@ -30,6 +36,7 @@ extern u64 pm_runtime_active_time(struct device *dev);
 					 WAKE_IRQ_DEDICATED_MANAGED | \
 					 WAKE_IRQ_DEDICATED_REVERSE)
 #define WAKE_IRQ_DEDICATED_ENABLED	BIT(3)
+#define WAKE_IRQ_DEDICATED_ASYNC	BIT(4)
 
 struct wake_irq {
 	struct device *dev;
@@ -79,6 +86,8 @@ extern void pm_qos_sysfs_remove_flags(struct device *dev);
 extern int pm_qos_sysfs_add_latency_tolerance(struct device *dev);
 extern void pm_qos_sysfs_remove_latency_tolerance(struct device *dev);
 extern int dpm_sysfs_change_owner(struct device *dev, kuid_t kuid, kgid_t kgid);
+extern void dev_pm_qos_device_moved(struct device *dev,
+				    struct device *old_parent);
 
 #else /* CONFIG_PM */
 
@@ -95,6 +104,8 @@ static inline int dpm_sysfs_add(struct device *dev) { return 0; }
 static inline void dpm_sysfs_remove(struct device *dev) {}
 static inline int dpm_sysfs_change_owner(struct device *dev, kuid_t kuid,
 					 kgid_t kgid) { return 0; }
+static inline void dev_pm_qos_device_moved(struct device *dev,
+					   struct device *old_parent) {}
 
 #endif
 
@@ -124,6 +135,31 @@ static inline bool device_pm_initialized(struct device *dev)
 	return dev->power.in_dpm_list;
 }
 
+enum dpm_phase {
+	DPM_PHASE_PREPARE,
+	DPM_PHASE_SUSPEND,
+	DPM_PHASE_SUSPEND_LATE,
+	DPM_PHASE_SUSPEND_NOIRQ,
+	DPM_PHASE_RESUME_NOIRQ,
+	DPM_PHASE_RESUME_EARLY,
+	DPM_PHASE_RESUME,
+	DPM_PHASE_COMPLETE,
+	DPM_PHASE_NR,
+};
+
+#ifdef CONFIG_PM_SLEEP_DEBUG
+/* drivers/base/power/critical_path.c */
+extern void dpm_cp_phase_start(enum dpm_phase phase);
+extern void dpm_cp_phase_end(struct list_head *list);
+extern void dpm_cp_dev_start(struct device *dev);
+extern void dpm_cp_dev_end(struct device *dev);
+#else
+static inline void dpm_cp_phase_start(enum dpm_phase phase) {}
+static inline void dpm_cp_phase_end(struct list_head *list) {}
+static inline void dpm_cp_dev_start(struct device *dev) {}
+static inline void dpm_cp_dev_end(struct device *dev) {}
+#endif
+
 /* drivers/base/power/wakeup_stats.c */
 extern int wakeup_source_sysfs_add(struct device *parent,
 				   struct wakeup_source *ws);
@@ -138,6 +138,82 @@ s32 dev_pm_qos_read_value(struct device *dev, enum dev_pm_qos_req_type type)
 	return ret;
 }
 
+static int dev_pm_qos_subtree_min(struct device *dev, void *data)
+{
+	s32 *value = data;
+
+	if (dev->power.subtree_resume_latency < *value)
+		*value = dev->power.subtree_resume_latency;
+
+	return 0;
+}
+
+static s32 dev_pm_qos_compute_subtree(struct device *dev)
+{
+	s32 value = dev_pm_qos_raw_resume_latency(dev);
+
+	device_for_each_child(dev, &value, dev_pm_qos_subtree_min);
+	return value;
+}
+
+/*
+ * dev_pm_qos_update_subtree - Propagate a resume latency change up the tree.
+ * @dev: Device whose resume latency constraint has changed.
+ *
+ * Update the subtree resume latency of @dev and, as long as that changes, the
+ * ones of its ancestors.  A smaller value can simply be propagated, whereas if
+ * the previous minimum has gone up, the children of the given ancestor need to
+ * be looked at again.
+ *
+ * Must be called with dev_pm_qos_mtx held.
+ */
+static void dev_pm_qos_update_subtree(struct device *dev)
+{
+	s32 old = dev->power.subtree_resume_latency;
+	s32 new = dev_pm_qos_compute_subtree(dev);
+
+	while (new != old) {
+		struct device *parent = dev->parent;
+		s32 parent_old;
+
+		WRITE_ONCE(dev->power.subtree_resume_latency, new);
+
+		if (!parent)
+			break;
+
+		parent_old = parent->power.subtree_resume_latency;
+		if (new >= parent_old) {
+			if (old != parent_old)
+				break;
+
+			new = dev_pm_qos_compute_subtree(parent);
+		}
+
+		dev = parent;
+		old = parent_old;
+	}
+}
+
+/**
+ * dev_pm_qos_device_moved - Update subtree resume latencies after a move.
+ * @dev: Device that has been given a new parent.
+ * @old_parent: Previous parent of @dev.
+ *
+ * The subtree of @dev has left the subtree of @old_parent and joined the one
+ * of the new parent, so recompute the values of both and their ancestors.
+ */
+void dev_pm_qos_device_moved(struct device *dev, struct device *old_parent)
+{
+	mutex_lock(&dev_pm_qos_mtx);
+
+	if (old_parent)
+		dev_pm_qos_update_subtree(old_parent);
+	if (dev->parent)
+		dev_pm_qos_update_subtree(dev->parent);
+
+	mutex_unlock(&dev_pm_qos_mtx);
+}
+
 /**
  * apply_constraint - Add/modify/remove device PM QoS request.
  * @req: Constraint request to apply
@@ -160,6 +236,8 @@ static int apply_constraint(struct dev_pm_qos_request *req,
 
 		ret = pm_qos_update_target(&qos->resume_latency,
 					   &req->data.pnode, action, value);
+		if (ret > 0)
+			dev_pm_qos_update_subtree(req->dev);
 		break;
 	case DEV_PM_QOS_LATENCY_TOLERANCE:
 		ret = pm_qos_update_target(&qos->latency_tolerance,
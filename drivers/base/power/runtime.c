@@ -6,11 +6,15 @@
  * Copyright (C) 2010 Alan Stern <stern@rowland.harvard.edu>
  */
 #include <linux/sched/mm.h>
+#include <linux/debugfs.h>
 #include <linux/ktime.h>
 #include <linux/hrtimer.h>
 #include <linux/export.h>
 #include <linux/pm_runtime.h>
 #include <linux/pm_wakeirq.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
 #include <trace/events/rpm.h>
 
 #include "../base.h"
@@ -148,12 +152,280 @@ static void pm_runtime_cancel_pending(struct device *dev)
 	dev->power.request = RPM_REQ_NONE;
 }
 
+/*
+ * Adaptive autosuspend.
+ *
+ * The idle periods of the device (the time between the last "busy" mark and
+ * the next resume request) are collected in a histogram with logarithmic
+ * buckets: bucket 0 covers [0, 1) ms and bucket k covers [2^(k-1), 2^k) ms.
+ * The costs of the ->runtime_suspend() and ->runtime_resume() callbacks are
+ * tracked as running averages.
+ *
+ * Every time a new idle period is recorded, the autosuspend delay is chosen
+ * from 0 and the powers of 2 (in milliseconds) not exceeding autosuspend_delay
+ * so as to minimize the expected time during which the device is not
+ * suspended, counting a suspend-resume cycle as its callback time, as long as
+ * the expected resume latency added to each access (the probability of the
+ * device being suspended at that time multiplied by the resume cost) fits
+ * into the device's resume latency PM QoS limit.
+ */
+#define RPM_ADAPTIVE_BUCKETS		16
+#define RPM_ADAPTIVE_MIN_SAMPLES	8
+#define RPM_ADAPTIVE_MAX_SAMPLES	256
+
+struct pm_runtime_adaptive {
+	unsigned int hist[RPM_ADAPTIVE_BUCKETS];
+	unsigned int nr_samples;
+	u64 sampled_busy;	/* power.last_busy of the last idle period */
+	u64 suspend_cost;	/* nsecs */
+	u64 resume_cost;	/* nsecs */
+};
+
+/* Representative idle period length of the given bucket in usecs. */
+static u64 rpm_adaptive_idle_us(unsigned int bucket)
+{
+	return bucket ? 750ULL << bucket : 500;
+}
+
+static void rpm_adaptive_select(struct device *dev)
+{
+	struct pm_runtime_adaptive *ad = dev->power.adaptive;
+	s32 budget = dev_pm_qos_raw_resume_latency(dev);
+	u64 overhead = div_u64(ad->suspend_cost + ad->resume_cost, NSEC_PER_USEC);
+	u64 resume_us = div_u64(ad->resume_cost, NSEC_PER_USEC);
+	int max_delay = dev->power.autosuspend_delay;
+	u64 best_cost = U64_MAX;
+	int best = max_delay;
+	int i, k;
+
+	for (i = -1; i < RPM_ADAPTIVE_BUCKETS; i++) {
+		int delay = i < 0 ? 0 : min(1 << i, max_delay);
+		u64 delay_us = (u64)delay * USEC_PER_MSEC;
+		u64 cost = 0, late = 0;
+
+		for (k = 0; k < RPM_ADAPTIVE_BUCKETS; k++) {
+			u64 idle_us = rpm_adaptive_idle_us(k);
+
+			if (idle_us <= delay_us) {
+				cost += ad->hist[k] * idle_us;
+			} else {
+				cost += ad->hist[k] * (delay_us + overhead);
+				late += ad->hist[k];
+			}
+		}
+
+		if (budget != PM_QOS_RESUME_LATENCY_NO_CONSTRAINT &&
+		    late * resume_us > (u64)budget * ad->nr_samples)
+			goto next;
+
+		if (cost < best_cost) {
+			best_cost = cost;
+			best = delay;
+		}
+
+next:
+		if (delay >= max_delay)
+			break;
+	}
+
+	WRITE_ONCE(dev->power.adaptive_delay, best);
+}
+
+static void rpm_adaptive_record(struct device *dev, u64 idle)
+{
+	struct pm_runtime_adaptive *ad = dev->power.adaptive;
+	u64 ms = div_u64(idle, NSEC_PER_MSEC);
+	unsigned int bucket;
+
+	bucket = ms ? min_t(unsigned int, fls64(ms), RPM_ADAPTIVE_BUCKETS - 1) : 0;
+	ad->hist[bucket]++;
+
+	/* Age the history so the delay can follow changes of the workload. */
+	if (++ad->nr_samples > RPM_ADAPTIVE_MAX_SAMPLES) {
+		unsigned int k;
+
+		ad->nr_samples = 0;
+		for (k = 0; k < RPM_ADAPTIVE_BUCKETS; k++) {
+			ad->hist[k] >>= 1;
+			ad->nr_samples += ad->hist[k];
+		}
+	}
+
+	if (ad->nr_samples >= RPM_ADAPTIVE_MIN_SAMPLES &&
+	    dev->power.autosuspend_delay > 0)
+		rpm_adaptive_select(dev);
+}
+
+/*
+ * Record the idle period ending now if the device has been idle, that is
+ * either suspended or waiting for the autosuspend timer, since it was last
+ * marked as busy.
+ *
+ * This function must be called under dev->power.lock with interrupts disabled.
+ */
+static void rpm_adaptive_sample(struct device *dev)
+{
+	struct pm_runtime_adaptive *ad = dev->power.adaptive;
+	u64 last_busy, now;
+
+	if (!ad || !dev->power.use_autosuspend)
+		return;
+
+	if (dev->power.runtime_status == RPM_ACTIVE &&
+	    !dev->power.timer_autosuspends)
+		return;
+
+	last_busy = READ_ONCE(dev->power.last_busy);
+	if (last_busy == ad->sampled_busy)
+		return;
+
+	ad->sampled_busy = last_busy;
+
+	now = ktime_get_mono_fast_ns();
+	if (now > last_busy)
+		rpm_adaptive_record(dev, now - last_busy);
+}
+
+static void rpm_adaptive_cost(struct device *dev, u64 delta, bool resume)
+{
+	struct pm_runtime_adaptive *ad = dev->power.adaptive;
+	u64 *cost;
+
+	if (!ad)
+		return;
+
+	cost = resume ? &ad->resume_cost : &ad->suspend_cost;
+	*cost = *cost ? (*cost * 7 + delta) >> 3 : delta;
+}
+
+#ifdef CONFIG_PM_ADVANCED_DEBUG
+/*
+ * Runtime PM histograms.
+ *
+ * Bucket k of each histogram counts the events whose duration d (in usecs)
+ * satisfies 2^(k-1) <= d < 2^k (bucket 0 is for d < 1 us, the last bucket
+ * collects everything above its lower bound).  The counters are per-CPU, so
+ * updating them does not add any cache line bouncing.
+ */
+#define RPM_HIST_BUCKETS	32
+
+struct pm_runtime_hist {
+	unsigned long suspend[RPM_HIST_BUCKETS];
+	unsigned long resume[RPM_HIST_BUCKETS];
+	unsigned long idle[RPM_HIST_BUCKETS];
+};
+
+static unsigned int rpm_hist_bucket(u64 nsecs)
+{
+	u64 us = div_u64(nsecs, NSEC_PER_USEC);
+
+	return min_t(unsigned int, fls64(us), RPM_HIST_BUCKETS - 1);
+}
+
+static void rpm_hist_callback(struct device *dev, u64 delta)
+{
+	struct pm_runtime_hist __percpu *hist = dev->power.hist;
+	unsigned int bucket = rpm_hist_bucket(delta);
+
+	if (!hist)
+		return;
+
+	if (dev->power.runtime_status == RPM_RESUMING)
+		this_cpu_inc(hist->resume[bucket]);
+	else
+		this_cpu_inc(hist->suspend[bucket]);
+}
+
+/* Note the time when the device has been runtime-suspended. */
+static void rpm_hist_suspended(struct device *dev)
+{
+	if (dev->power.hist)
+		dev->power.hist_suspended_at = ktime_get_mono_fast_ns();
+}
+
+/*
+ * Record the time spent in the RPM_SUSPENDED state before a resume, if the
+ * device has been suspended by rpm_suspend() since the histograms were
+ * enabled.
+ */
+static void rpm_hist_idle(struct device *dev)
+{
+	struct pm_runtime_hist __percpu *hist = dev->power.hist;
+	u64 now, last;
+
+	last = dev->power.hist_suspended_at;
+	dev->power.hist_suspended_at = 0;
+
+	if (!hist || !last || dev->power.disable_depth > 0)
+		return;
+
+	now = ktime_get_mono_fast_ns();
+	if (now > last)
+		this_cpu_inc(hist->idle[rpm_hist_bucket(now - last)]);
+}
+
+static bool rpm_hist_enabled(struct device *dev)
+{
+	return dev->power.hist;
+}
+#else /* !CONFIG_PM_ADVANCED_DEBUG */
+static inline void rpm_hist_callback(struct device *dev, u64 delta) {}
+static inline void rpm_hist_suspended(struct device *dev) {}
+static inline void rpm_hist_idle(struct device *dev) {}
+static inline bool rpm_hist_enabled(struct device *dev) { return false; }
+#endif /* !CONFIG_PM_ADVANCED_DEBUG */
+
+static u64 rpm_callback_start(struct device *dev)
+{
+	if (!dev->power.adaptive && !rpm_hist_enabled(dev))
+		return 0;
+
+	return ktime_get_mono_fast_ns();
+}
+
+/*
+ * Update the statistics based on the duration of a ->runtime_suspend() or
+ * ->runtime_resume() callback.  The runtime PM status of the device has not
+ * been updated yet, so it tells which one of them has run.
+ *
+ * This function must be called under dev->power.lock with interrupts disabled.
+ */
+static void rpm_callback_end(struct device *dev, u64 start, int retval)
+{
+	bool resume = dev->power.runtime_status == RPM_RESUMING;
+	u64 delta;
+
+	if (!start)
+		return;
+
+	delta = ktime_get_mono_fast_ns() - start;
+
+	if (resume || !retval)
+		rpm_adaptive_cost(dev, delta, resume);
+
+	rpm_hist_callback(dev, delta);
+}
+
+/* Return the autosuspend delay to use for @dev, in milliseconds. */
+static int rpm_autosuspend_delay(struct device *dev)
+{
+	int autosuspend_delay = READ_ONCE(dev->power.autosuspend_delay);
+	int adaptive_delay = READ_ONCE(dev->power.adaptive_delay);
+
+	if (autosuspend_delay >= 0 && adaptive_delay >= 0 &&
+	    adaptive_delay < autosuspend_delay)
+		return adaptive_delay;
+
+	return autosuspend_delay;
+}
+
 /*
  * pm_runtime_autosuspend_expiration - Get a device's autosuspend-delay expiration time.
  * @dev: Device to handle.
  *
  * Compute the autosuspend-delay expiration time based on the device's
- * power.last_busy time.  If the delay has already expired or is disabled
+ * power.last_busy time and autosuspend delay (which may be reduced by the
+ * adaptive autosuspend logic).  If the delay has already expired or is disabled
  * (negative) or the power.use_autosuspend flag isn't set, return 0.
  * Otherwise return the expiration time in nanoseconds (adjusted to be nonzero).
  *
@@ -168,7 +440,7 @@ u64 pm_runtime_autosuspend_expiration(struct device *dev)
 	if (!dev->power.use_autosuspend)
 		return 0;
 
-	autosuspend_delay = READ_ONCE(dev->power.autosuspend_delay);
+	autosuspend_delay = rpm_autosuspend_delay(dev);
 	if (autosuspend_delay < 0)
 		return 0;
 
@@ -280,9 +552,33 @@ static int rpm_check_suspend_allowed(struct device *dev)
 	return retval;
 }
 
+/*
+ * Start resuming all of the suppliers of @dev asynchronously and take a
+ * reference to each of them upfront, so that rpm_get_suppliers() only needs
+ * to wait for them and independent suppliers can resume in parallel instead
+ * of one after another.
+ */
+static void rpm_get_suppliers_async(struct device *dev)
+{
+	struct device_link *link;
+
+	list_for_each_entry_rcu(link, &dev->links.suppliers, c_node,
+				device_links_read_lock_held()) {
+		if (!(link->flags & DL_FLAG_PM_RUNTIME))
+			continue;
+
+		__pm_runtime_resume(link->supplier, RPM_GET_PUT | RPM_ASYNC);
+		refcount_inc(&link->rpm_active);
+	}
+}
+
 static int rpm_get_suppliers(struct device *dev)
 {
 	struct device_link *link;
+	bool parallel = dev->power.parallel_suppliers && dev->power.links_count > 1;
+
+	if (parallel)
+		rpm_get_suppliers_async(dev);
 
 	list_for_each_entry_rcu(link, &dev->links.suppliers, c_node,
 				device_links_read_lock_held()) {
@@ -291,6 +587,18 @@ static int rpm_get_suppliers(struct device *dev)
 		if (!(link->flags & DL_FLAG_PM_RUNTIME))
 			continue;
 
+		if (parallel) {
+			/*
+			 * The reference has been taken already and it will be
+			 * dropped by rpm_put_suppliers() on errors.
+			 */
+			retval = pm_runtime_resume(link->supplier);
+			if (retval < 0 && retval != -EACCES)
+				return retval;
+
+			continue;
+		}
+
 		retval = pm_runtime_get_sync(link->supplier);
 		/* Ignore suppliers with disabled runtime PM. */
 		if (retval < 0 && retval != -EACCES) {
@@ -425,6 +733,7 @@ static int __rpm_callback(int (*cb)(struct device *), struct device *dev)
  */
 static int rpm_callback(int (*cb)(struct device *), struct device *dev)
 {
+	u64 start = rpm_callback_start(dev);
 	int retval;
 
 	if (dev->power.memalloc_noio) {
@@ -446,6 +755,8 @@ static int rpm_callback(int (*cb)(struct device *), struct device *dev)
 		retval = __rpm_callback(cb, dev);
 	}
 
+	rpm_callback_end(dev, start, retval);
+
 	dev->power.runtime_error = retval;
 	return retval != -EACCES ? retval : -EIO;
 }
@@ -597,7 +908,7 @@ static int rpm_suspend(struct device *dev, int rpmflags)
 				 * We add a slack of 25% to gather wakeups
 				 * without sacrificing the granularity.
 				 */
-				u64 slack = (u64)READ_ONCE(dev->power.autosuspend_delay) *
+				u64 slack = (u64)rpm_autosuspend_delay(dev) *
 						    (NSEC_PER_MSEC >> 2);
 
 				dev->power.timer_expires = expires;
@@ -675,6 +986,7 @@ static int rpm_suspend(struct device *dev, int rpmflags)
 
  no_callback:
 	__update_runtime_status(dev, RPM_SUSPENDED);
+	rpm_hist_suspended(dev);
 	pm_runtime_deactivate_timer(dev);
 
 	if (dev->parent) {
@@ -780,6 +1092,8 @@ static int rpm_resume(struct device *dev, int rpmflags)
 	if (retval)
 		goto out;
 
+	rpm_adaptive_sample(dev);
+
 	/*
 	 * Other scheduled or pending requests need to be canceled.  Small
 	 * optimization: If an autosuspend timer is running, leave it running
@@ -904,6 +1218,8 @@ static int rpm_resume(struct device *dev, int rpmflags)
 	if (dev->power.no_callbacks)
 		goto no_callback;	/* Assume success. */
 
+	rpm_hist_idle(dev);
+
 	__update_runtime_status(dev, RPM_RESUMING);
 
 	callback = RPM_GET_CALLBACK(dev, runtime_resume);
@@ -1623,6 +1939,88 @@ void pm_runtime_irq_safe(struct device *dev)
 }
 EXPORT_SYMBOL_GPL(pm_runtime_irq_safe);
 
+/**
+ * pm_runtime_parallel_suppliers - Resume suppliers of a device in parallel.
+ * @dev: Device to handle.
+ * @enable: Whether or not to resume the suppliers of @dev in parallel.
+ *
+ * Set or clear the power.parallel_suppliers flag of @dev.  If set, whenever
+ * @dev is resumed, all of its suppliers with DL_FLAG_PM_RUNTIME links are
+ * started to resume asynchronously first and then waited for, as opposed to
+ * being resumed synchronously one at a time.  That is only useful if the
+ * suppliers do not depend on one another.
+ */
+void pm_runtime_parallel_suppliers(struct device *dev, bool enable)
+{
+	spin_lock_irq(&dev->power.lock);
+	dev->power.parallel_suppliers = enable;
+	spin_unlock_irq(&dev->power.lock);
+}
+EXPORT_SYMBOL_GPL(pm_runtime_parallel_suppliers);
+
+/**
+ * pm_runtime_get_sync_batch - Resume a set of devices as one operation.
+ * @devs: Devices to resume.
+ * @nr: Number of entries in @devs.
+ *
+ * Bump up the usage counters of all of the devices in @devs and resume them,
+ * starting all of the resumes asynchronously before waiting for any of them,
+ * so that the devices can resume in parallel.
+ *
+ * Return 0 on success.  Otherwise, drop the usage counters of all of the
+ * devices, letting the ones that have been resumed suspend again, and return
+ * the error code of the first failing device.  Devices with runtime PM
+ * disabled are treated like in pm_runtime_resume_and_get().
+ */
+int pm_runtime_get_sync_batch(struct device **devs, unsigned int nr)
+{
+	unsigned int i;
+	int error = 0;
+
+	for (i = 0; i < nr; i++)
+		__pm_runtime_resume(devs[i], RPM_GET_PUT | RPM_ASYNC);
+
+	for (i = 0; i < nr; i++) {
+		int ret = pm_runtime_resume(devs[i]);
+
+		if (ret < 0 && !error)
+			error = ret;
+	}
+
+	if (!error)
+		return 0;
+
+	/*
+	 * All of the resumes have completed by now, so let the devices that
+	 * have been resumed suspend again.
+	 */
+	for (i = 0; i < nr; i++) {
+		if (pm_runtime_active(devs[i]))
+			pm_runtime_put(devs[i]);
+		else
+			pm_runtime_put_noidle(devs[i]);
+	}
+
+	return error;
+}
+EXPORT_SYMBOL_GPL(pm_runtime_get_sync_batch);
+
+/**
+ * pm_runtime_put_batch - Drop the usage counters of a set of devices.
+ * @devs: Devices to handle.
+ * @nr: Number of entries in @devs.
+ *
+ * Counterpart of pm_runtime_get_sync_batch().
+ */
+void pm_runtime_put_batch(struct device **devs, unsigned int nr)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr; i++)
+		pm_runtime_put(devs[i]);
+}
+EXPORT_SYMBOL_GPL(pm_runtime_put_batch);
+
 /**
  * update_autosuspend - Handle a change to a device's autosuspend settings.
  * @dev: Device to handle.
@@ -1705,6 +2103,111 @@ void __pm_runtime_use_autosuspend(struct device *dev, bool use)
 }
 EXPORT_SYMBOL_GPL(__pm_runtime_use_autosuspend);
 
+/**
+ * pm_runtime_set_adaptive_autosuspend - Enable or disable adaptive autosuspend.
+ * @dev: Device to handle.
+ * @enable: Whether or not to adapt the autosuspend delay of @dev.
+ *
+ * If enabled, the autosuspend delay of @dev is chosen automatically based on
+ * the observed idle periods of the device and the costs of its runtime PM
+ * callbacks.  The delay never exceeds power.autosuspend_delay, which still
+ * has to be set by the driver or user space and remains an upper bound.
+ */
+int pm_runtime_set_adaptive_autosuspend(struct device *dev, bool enable)
+{
+	struct pm_runtime_adaptive *ad = NULL;
+
+	if (enable) {
+		ad = kzalloc(sizeof(*ad), GFP_KERNEL);
+		if (!ad)
+			return -ENOMEM;
+	}
+
+	spin_lock_irq(&dev->power.lock);
+
+	if (!enable || !dev->power.adaptive) {
+		swap(ad, dev->power.adaptive);
+		WRITE_ONCE(dev->power.adaptive_delay, -1);
+	}
+
+	spin_unlock_irq(&dev->power.lock);
+
+	kfree(ad);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(pm_runtime_set_adaptive_autosuspend);
+
+#ifdef CONFIG_PM_ADVANCED_DEBUG
+/**
+ * pm_runtime_set_histograms - Enable or disable runtime PM histograms.
+ * @dev: Device to handle.
+ * @enable: Whether or not to collect the histograms for @dev.
+ *
+ * Enabling the histograms again after disabling them resets them.
+ */
+int pm_runtime_set_histograms(struct device *dev, bool enable)
+{
+	struct pm_runtime_hist __percpu *hist = NULL;
+
+	if (enable) {
+		hist = alloc_percpu(struct pm_runtime_hist);
+		if (!hist)
+			return -ENOMEM;
+	}
+
+	spin_lock_irq(&dev->power.lock);
+
+	if (!enable || !dev->power.hist) {
+		swap(hist, dev->power.hist);
+		dev->power.hist_suspended_at = 0;
+	}
+
+	spin_unlock_irq(&dev->power.lock);
+
+	free_percpu(hist);
+	return 0;
+}
+
+/**
+ * pm_runtime_show_histograms - Print runtime PM histograms of a device.
+ * @dev: Device to handle.
+ * @buf: Sysfs buffer to print into.
+ *
+ * The caller must prevent the histograms from being disabled concurrently.
+ */
+ssize_t pm_runtime_show_histograms(struct device *dev, char *buf)
+{
+	struct pm_runtime_hist __percpu *hist = dev->power.hist;
+	static const char * const names[] = { "suspend", "resume", "idle" };
+	ssize_t len = 0;
+	int i, k;
+
+	if (!hist)
+		return -ENODATA;
+
+	for (i = 0; i < ARRAY_SIZE(names); i++) {
+		len += sysfs_emit_at(buf, len, "%s:", names[i]);
+
+		for (k = 0; k < RPM_HIST_BUCKETS; k++) {
+			unsigned long sum = 0;
+			int cpu;
+
+			for_each_possible_cpu(cpu) {
+				struct pm_runtime_hist *h = per_cpu_ptr(hist, cpu);
+
+				sum += i == 0 ? h->suspend[k] :
+				       i == 1 ? h->resume[k] : h->idle[k];
+			}
+			len += sysfs_emit_at(buf, len, " %lu", sum);
+		}
+
+		len += sysfs_emit_at(buf, len, "\n");
+	}
+
+	return len;
+}
+#endif /* CONFIG_PM_ADVANCED_DEBUG */
+
 /**
  * pm_runtime_init - Initialize runtime PM fields in given device object.
  * @dev: Device object to initialize.
@@ -1731,6 +2234,7 @@ void pm_runtime_init(struct device *dev)
 	INIT_WORK(&dev->power.work, pm_runtime_work);
 
 	dev->power.timer_expires = 0;
+	dev->power.adaptive_delay = -1;
 	hrtimer_init(&dev->power.suspend_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
 	dev->power.suspend_timer.function = pm_suspend_timer_fn;
 
@@ -1764,6 +2268,10 @@ void pm_runtime_remove(struct device *dev)
 {
 	__pm_runtime_disable(dev, false);
 	pm_runtime_reinit(dev);
+	pm_runtime_set_adaptive_autosuspend(dev, false);
+#ifdef CONFIG_PM_ADVANCED_DEBUG
+	pm_runtime_set_histograms(dev, false);
+#endif
 }
 
 /**
@@ -1952,3 +2460,95 @@ int pm_runtime_force_resume(struct device *dev)
 	return ret;
 }
 EXPORT_SYMBOL_GPL(pm_runtime_force_resume);
+
+#if defined(CONFIG_PM_SLEEP) && defined(CONFIG_DEBUG_FS)
+/*
+ * Runtime PM state of all devices in one file, so that collecting it does not
+ * take opening and reading several sysfs attributes per device.
+ */
+static const char *rpm_status_name(struct device *dev)
+{
+	if (dev->power.runtime_error)
+		return "error";
+	if (dev->power.disable_depth)
+		return "unsupported";
+
+	switch (dev->power.runtime_status) {
+	case RPM_ACTIVE:
+		return "active";
+	case RPM_RESUMING:
+		return "resuming";
+	case RPM_SUSPENDED:
+		return "suspended";
+	case RPM_SUSPENDING:
+		return "suspending";
+	}
+
+	return "unknown";
+}
+
+static void *runtime_pm_summary_start(struct seq_file *s, loff_t *pos)
+{
+	device_pm_lock();
+	return seq_list_start_head(&dpm_list, *pos);
+}
+
+static void *runtime_pm_summary_next(struct seq_file *s, void *v, loff_t *pos)
+{
+	return seq_list_next(v, &dpm_list, pos);
+}
+
+static void runtime_pm_summary_stop(struct seq_file *s, void *v)
+{
+	device_pm_unlock();
+}
+
+static int runtime_pm_summary_show(struct seq_file *s, void *v)
+{
+	struct device *dev;
+	u64 active, suspended;
+	const char *status;
+	unsigned long flags;
+	int usage, children;
+
+	if (v == &dpm_list) {
+		seq_puts(s, "status      usage children active_ms suspended_ms device\n");
+		return 0;
+	}
+
+	dev = list_entry(v, struct device, power.entry);
+
+	/* Take the lock once for all of the fields of the device */
+	spin_lock_irqsave(&dev->power.lock, flags);
+	update_pm_runtime_accounting(dev);
+	status = rpm_status_name(dev);
+	usage = atomic_read(&dev->power.usage_count);
+	children = atomic_read(&dev->power.child_count);
+	active = dev->power.active_time;
+	suspended = dev->power.suspended_time;
+	spin_unlock_irqrestore(&dev->power.lock, flags);
+
+	seq_printf(s, "%-11s %5d %8d %9llu %12llu %s\n", status, usage,
+		   children, div_u64(active, NSEC_PER_MSEC),
+		   div_u64(suspended, NSEC_PER_MSEC), dev_name(dev));
+
+	return 0;
+}
+
+static const struct seq_operations runtime_pm_summary_sops = {
+	.start = runtime_pm_summary_start,
+	.next = runtime_pm_summary_next,
+	.stop = runtime_pm_summary_stop,
+	.show = runtime_pm_summary_show,
+};
+DEFINE_SEQ_ATTRIBUTE(runtime_pm_summary);
+
+static int __init runtime_pm_debugfs_init(void)
+{
+	debugfs_create_file("runtime_pm_summary", 0444, NULL, NULL,
+			    &runtime_pm_summary_fops);
+	return 0;
+}
+
+late_initcall(runtime_pm_debugfs_init);
+#endif /* CONFIG_PM_SLEEP && CONFIG_DEBUG_FS */
@@ -89,7 +89,24 @@
  *	NOTE: The autosuspend_delay_ms attribute and the autosuspend_delay
  *	value are used only if the driver calls pm_runtime_use_autosuspend().
  *
+ *	autosuspend_adaptive - Report/change adaptive autosuspend of a device
+ *
+ *	If set to 1, the autosuspend delay of the device is picked automatically
+ *	from the observed idle periods and runtime PM callback costs, within the
+ *	resume latency PM QoS limit, with autosuspend_delay_ms as the upper
+ *	bound.  The delay currently in use is shown by
+ *	autosuspend_adaptive_delay_ms (-1 if not chosen yet).
+ *
  *	wakeup_count - Report the number of wakeup events related to the device
+ *
+ *	runtime_histograms - Report/enable runtime PM histograms of the device
+ *
+ *	Writing 1 starts collecting histograms of the ->runtime_suspend() and
+ *	->runtime_resume() callback durations and of the lengths of the periods
+ *	spent in the "suspended" state, writing 0 stops it and frees them.
+ *	Reading returns one line per histogram with the numbers of events in
+ *	buckets of the form [2^(k-1), 2^k) us, for k = 0..31.  This attribute
+ *	is only present if CONFIG_PM_ADVANCED_DEBUG is set.
  */
 
 const char power_group_name[] = "power";
@@ -208,6 +225,48 @@ static ssize_t autosuspend_delay_ms_store(struct device *dev,
 
 static DEVICE_ATTR_RW(autosuspend_delay_ms);
 
+static ssize_t autosuspend_adaptive_show(struct device *dev,
+					 struct device_attribute *attr,
+					 char *buf)
+{
+	if (!dev->power.use_autosuspend)
+		return -EIO;
+
+	return sysfs_emit(buf, "%d\n", !!dev->power.adaptive);
+}
+
+static ssize_t autosuspend_adaptive_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t n)
+{
+	bool enable;
+	int ret;
+
+	if (!dev->power.use_autosuspend)
+		return -EIO;
+
+	if (kstrtobool(buf, &enable))
+		return -EINVAL;
+
+	device_lock(dev);
+	ret = pm_runtime_set_adaptive_autosuspend(dev, enable);
+	device_unlock(dev);
+	return ret < 0 ? ret : n;
+}
+
+static DEVICE_ATTR_RW(autosuspend_adaptive);
+
+static ssize_t autosuspend_adaptive_delay_ms_show(struct device *dev,
+						  struct device_attribute *attr,
+						  char *buf)
+{
+	if (!dev->power.use_autosuspend)
+		return -EIO;
+
+	return sysfs_emit(buf, "%d\n", READ_ONCE(dev->power.adaptive_delay));
+}
+
+static DEVICE_ATTR_RO(autosuspend_adaptive_delay_ms);
+
 static ssize_t pm_qos_resume_latency_us_show(struct device *dev,
 					     struct device_attribute *attr,
 					     char *buf)
@@ -584,6 +643,34 @@ static ssize_t runtime_enabled_show(struct device *dev,
 }
 static DEVICE_ATTR_RO(runtime_enabled);
 
+static ssize_t runtime_histograms_show(struct device *dev,
+				       struct device_attribute *attr, char *buf)
+{
+	ssize_t ret;
+
+	device_lock(dev);
+	ret = pm_runtime_show_histograms(dev, buf);
+	device_unlock(dev);
+	return ret;
+}
+
+static ssize_t runtime_histograms_store(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t n)
+{
+	bool enable;
+	int ret;
+
+	if (kstrtobool(buf, &enable))
+		return -EINVAL;
+
+	device_lock(dev);
+	ret = pm_runtime_set_histograms(dev, enable);
+	device_unlock(dev);
+	return ret < 0 ? ret : n;
+}
+static DEVICE_ATTR_RW(runtime_histograms);
+
 #ifdef CONFIG_PM_SLEEP
 static ssize_t async_show(struct device *dev, struct device_attribute *attr,
 			  char *buf)
@@ -619,6 +706,7 @@ static struct attribute *power_attrs[] = {
 	&dev_attr_runtime_usage.attr,
 	&dev_attr_runtime_active_kids.attr,
 	&dev_attr_runtime_enabled.attr,
+	&dev_attr_runtime_histograms.attr,
 #endif /* CONFIG_PM_ADVANCED_DEBUG */
 	NULL,
 };
@@ -657,6 +745,8 @@ static struct attribute *runtime_attrs[] = {
 	&dev_attr_runtime_suspended_time.attr,
 	&dev_attr_runtime_active_time.attr,
 	&dev_attr_autosuspend_delay_ms.attr,
+	&dev_attr_autosuspend_adaptive.attr,
+	&dev_attr_autosuspend_adaptive_delay_ms.attr,
 	NULL,
 };
 static const struct attribute_group pm_runtime_attr_group = {
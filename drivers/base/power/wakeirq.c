@@ -142,6 +142,29 @@ static irqreturn_t handle_threaded_wake_irq(int irq, void *_wirq)
 	return IRQ_HANDLED;
 }
 
+/**
+ * handle_wake_irq_async - Primary handler for dedicated wake-up interrupts
+ * @irq: Device specific dedicated wake-up interrupt
+ * @_wirq: Wake IRQ data
+ *
+ * Queue the runtime resume of the device on pm_wq right away instead of
+ * waiting for the IRQ thread to be scheduled. The thread still runs
+ * pm_runtime_resume(), which either does the resume itself if it gets
+ * there first or waits for the queued one to complete, so the interrupt
+ * stays masked until the device is active as with the threaded handler
+ * alone.
+ */
+static irqreturn_t handle_wake_irq_async(int irq, void *_wirq)
+{
+	struct wake_irq *wirq = _wirq;
+
+	/* The system suspend case is handled by the thread */
+	if (!irqd_is_wakeup_set(irq_get_irq_data(irq)))
+		pm_request_resume(wirq->dev);
+
+	return IRQ_WAKE_THREAD;
+}
+
 static int __dev_pm_set_dedicated_wake_irq(struct device *dev, int irq, unsigned int flag)
 {
 	struct wake_irq *wirq;
@@ -170,7 +193,10 @@ static int __dev_pm_set_dedicated_wake_irq(struct device *dev, int irq, unsigned
 	 * Consumer device may need to power up and restore state
 	 * so we use a threaded irq.
 	 */
-	err = request_threaded_irq(irq, NULL, handle_threaded_wake_irq,
+	err = request_threaded_irq(irq,
+				   flag & WAKE_IRQ_DEDICATED_ASYNC ?
+				   handle_wake_irq_async : NULL,
+				   handle_threaded_wake_irq,
 				   IRQF_ONESHOT | IRQF_NO_AUTOEN,
 				   wirq->name, wirq);
 	if (err)
@@ -233,6 +259,24 @@ int dev_pm_set_dedicated_wake_irq_reverse(struct device *dev, int irq)
 }
 EXPORT_SYMBOL_GPL(dev_pm_set_dedicated_wake_irq_reverse);
 
+/**
+ * dev_pm_set_dedicated_wake_irq_async - Request a dedicated wake-up interrupt
+ *                                       that starts the resume from hardirq
+ * @dev: Device entry
+ * @irq: Device wake-up interrupt
+ *
+ * Same as dev_pm_set_dedicated_wake_irq(), except that the runtime resume
+ * of @dev is queued from the primary interrupt handler so that it does not
+ * have to wait for the IRQ thread to be scheduled. Meant for devices that
+ * need to be woken up as fast as possible, like UARTs that lose data until
+ * they are active.
+ */
+int dev_pm_set_dedicated_wake_irq_async(struct device *dev, int irq)
+{
+	return __dev_pm_set_dedicated_wake_irq(dev, irq, WAKE_IRQ_DEDICATED_ASYNC);
+}
+EXPORT_SYMBOL_GPL(dev_pm_set_dedicated_wake_irq_async);
+
 /**
  * dev_pm_enable_wake_irq_check - Checks and enables wake-up interrupt
  * @dev: Device
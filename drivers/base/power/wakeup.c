@@ -36,21 +36,53 @@ static DEFINE_RAW_SPINLOCK(wakeup_irq_lock);
 static atomic_t pm_abort_suspend __read_mostly;
 
 /*
- * Combined counters of registered wakeup events and wakeup events in progress.
- * They need to be modified together atomically, so it's better to use one
- * atomic variable to hold them both.
+ * Counters of registered wakeup events and wakeup events in progress.
+ *
+ * They are kept per CPU, so that activating and deactivating wakeup sources
+ * doesn't write to shared cache lines, and summed up by the readers.  A wakeup
+ * source may be deactivated on a different CPU than the one it has been
+ * activated on, so the per-CPU counts of events in progress may be negative,
+ * but their sum may not.  Since an event is counted as registered before it
+ * stops being counted as in progress, a reader can only miss an event that
+ * has started on a CPU after the reader has looked at it, as if the event had
+ * started after the read.
  */
-static atomic_t combined_event_count = ATOMIC_INIT(0);
+struct wakeup_event_count {
+	unsigned int cnt;
+	int inpr;
+};
+
+static DEFINE_PER_CPU(struct wakeup_event_count, wakeup_event_count);
 
+/* For the combined counter value reported by the tracepoints. */
 #define IN_PROGRESS_BITS	(sizeof(int) * 4)
 #define MAX_IN_PROGRESS		((1 << IN_PROGRESS_BITS) - 1)
 
 static void split_counters(unsigned int *cnt, unsigned int *inpr)
 {
-	unsigned int comb = atomic_read(&combined_event_count);
+	unsigned int sum_cnt = 0;
+	int sum_inpr = 0;
+	int cpu;
 
-	*cnt = (comb >> IN_PROGRESS_BITS);
-	*inpr = comb & MAX_IN_PROGRESS;
+	for_each_possible_cpu(cpu) {
+		struct wakeup_event_count *wec = per_cpu_ptr(&wakeup_event_count, cpu);
+
+		sum_inpr += READ_ONCE(wec->inpr);
+		/* Pairs with smp_wmb() in wakeup_source_deactivate(). */
+		smp_rmb();
+		sum_cnt += READ_ONCE(wec->cnt);
+	}
+
+	*cnt = sum_cnt;
+	*inpr = max(sum_inpr, 0);
+}
+
+static unsigned int combined_event_count(void)
+{
+	unsigned int cnt, inpr;
+
+	split_counters(&cnt, &inpr);
+	return (cnt << IN_PROGRESS_BITS) | (inpr & MAX_IN_PROGRESS);
 }
 
 /* A preserved old value of the events counter. */
@@ -73,6 +105,70 @@ static struct wakeup_source deleted_ws = {
 
 static DEFINE_IDA(wakeup_ida);
 
+/*
+ * Index of the active wakeup sources, so that reporting them doesn't require
+ * walking all of the wakeup sources.  A source is put on the list of the CPU
+ * it is activated on, which usually is the CPU it is deactivated on too, so
+ * the lists don't add writes to shared cache lines.  These locks nest inside
+ * the wakeup sources' ones.
+ */
+struct wakeup_active {
+	raw_spinlock_t		lock;
+	struct hlist_head	list;
+	struct wakeup_source	*last;	/* Last deactivated from this list */
+};
+
+static DEFINE_PER_CPU(struct wakeup_active, wakeup_active) = {
+	.lock = __RAW_SPIN_LOCK_UNLOCKED(wakeup_active.lock),
+};
+
+/* Must be called with @ws->lock held and interrupts off. */
+static void wakeup_active_add(struct wakeup_source *ws)
+{
+	struct wakeup_active *wa = this_cpu_ptr(&wakeup_active);
+
+	raw_spin_lock(&wa->lock);
+	hlist_add_head(&ws->active_node, &wa->list);
+	ws->active_cpu = smp_processor_id();
+	raw_spin_unlock(&wa->lock);
+}
+
+/* Must be called with @ws->lock held and interrupts off. */
+static void wakeup_active_del(struct wakeup_source *ws, bool removed)
+{
+	struct wakeup_active *wa = per_cpu_ptr(&wakeup_active, ws->active_cpu);
+
+	raw_spin_lock(&wa->lock);
+	if (!hlist_unhashed(&ws->active_node)) {
+		hlist_del_init(&ws->active_node);
+		if (!removed)
+			wa->last = ws;
+	}
+	raw_spin_unlock(&wa->lock);
+}
+
+/* Drop all references to @ws from the index before it goes away. */
+static void wakeup_active_forget(struct wakeup_source *ws)
+{
+	unsigned long flags;
+	int cpu;
+
+	spin_lock_irqsave(&ws->lock, flags);
+
+	wakeup_active_del(ws, true);
+
+	for_each_possible_cpu(cpu) {
+		struct wakeup_active *wa = per_cpu_ptr(&wakeup_active, cpu);
+
+		raw_spin_lock(&wa->lock);
+		if (wa->last == ws)
+			wa->last = NULL;
+		raw_spin_unlock(&wa->lock);
+	}
+
+	spin_unlock_irqrestore(&ws->lock, flags);
+}
+
 /**
  * wakeup_source_create - Create a struct wakeup_source object.
  * @name: Name of the new wakeup source.
@@ -173,6 +269,9 @@ void wakeup_source_add(struct wakeup_source *ws)
 
 	spin_lock_init(&ws->lock);
 	timer_setup(&ws->timer, pm_wakeup_timer_fn, 0);
+	INIT_HLIST_NODE(&ws->active_node);
+	/* wakeup_active_del() uses it even if @ws has never been active. */
+	ws->active_cpu = 0;
 	ws->active = false;
 
 	raw_spin_lock_irqsave(&events_lock, flags);
@@ -197,6 +296,8 @@ void wakeup_source_remove(struct wakeup_source *ws)
 	raw_spin_unlock_irqrestore(&events_lock, flags);
 	synchronize_srcu(&wakeup_srcu);
 
+	wakeup_active_forget(ws);
+
 	del_timer_sync(&ws->timer);
 	/*
 	 * Clear timer.function to make wakeup_source_not_registered() treat
@@ -557,22 +658,22 @@ static bool wakeup_source_not_registered(struct wakeup_source *ws)
  */
 static void wakeup_source_activate(struct wakeup_source *ws)
 {
-	unsigned int cec;
-
 	if (WARN_ONCE(wakeup_source_not_registered(ws),
 			"unregistered wakeup source\n"))
 		return;
 
 	ws->active = true;
+	wakeup_active_add(ws);
 	ws->active_count++;
 	ws->last_time = ktime_get();
 	if (ws->autosleep_enabled)
 		ws->start_prevent_time = ws->last_time;
 
 	/* Increment the counter of events in progress. */
-	cec = atomic_inc_return(&combined_event_count);
+	this_cpu_inc(wakeup_event_count.inpr);
 
-	trace_wakeup_source_activate(ws->name, cec);
+	if (trace_wakeup_source_activate_enabled())
+		trace_wakeup_source_activate(ws->name, combined_event_count());
 }
 
 /**
@@ -662,7 +763,7 @@ static inline void update_prevent_sleep_time(struct wakeup_source *ws,
  */
 static void wakeup_source_deactivate(struct wakeup_source *ws)
 {
-	unsigned int cnt, inpr, cec;
+	unsigned int cnt, inpr;
 	ktime_t duration;
 	ktime_t now;
 
@@ -682,6 +783,7 @@ static void wakeup_source_deactivate(struct wakeup_source *ws)
 	}
 
 	ws->active = false;
+	wakeup_active_del(ws, false);
 
 	now = ktime_get();
 	duration = ktime_sub(now, ws->last_time);
@@ -697,15 +799,22 @@ static void wakeup_source_deactivate(struct wakeup_source *ws)
 		update_prevent_sleep_time(ws, now);
 
 	/*
-	 * Increment the counter of registered wakeup events and decrement the
-	 * counter of wakeup events in progress simultaneously.
+	 * Increment the counter of registered wakeup events before decrementing
+	 * the counter of wakeup events in progress, so that the event is never
+	 * missing from both.
 	 */
-	cec = atomic_add_return(MAX_IN_PROGRESS, &combined_event_count);
-	trace_wakeup_source_deactivate(ws->name, cec);
+	this_cpu_inc(wakeup_event_count.cnt);
+	smp_wmb();
+	this_cpu_dec(wakeup_event_count.inpr);
 
-	split_counters(&cnt, &inpr);
-	if (!inpr && waitqueue_active(&wakeup_count_wait_queue))
-		wake_up(&wakeup_count_wait_queue);
+	if (trace_wakeup_source_deactivate_enabled())
+		trace_wakeup_source_deactivate(ws->name, combined_event_count());
+
+	if (waitqueue_active(&wakeup_count_wait_queue)) {
+		split_counters(&cnt, &inpr);
+		if (!inpr)
+			wake_up(&wakeup_count_wait_queue);
+	}
 }
 
 /**
@@ -842,26 +951,32 @@ EXPORT_SYMBOL_GPL(pm_wakeup_dev_event);
 void pm_print_active_wakeup_sources(void)
 {
 	struct wakeup_source *ws;
-	int srcuidx, active = 0;
-	struct wakeup_source *last_activity_ws = NULL;
+	unsigned long flags;
+	int cpu, active = 0;
+	ktime_t last_time = 0;
+	char last_name[64] = "";
 
-	srcuidx = srcu_read_lock(&wakeup_srcu);
-	list_for_each_entry_rcu_locked(ws, &wakeup_sources, entry) {
-		if (ws->active) {
+	for_each_possible_cpu(cpu) {
+		struct wakeup_active *wa = per_cpu_ptr(&wakeup_active, cpu);
+
+		raw_spin_lock_irqsave(&wa->lock, flags);
+
+		hlist_for_each_entry(ws, &wa->list, active_node) {
 			pm_pr_dbg("active wakeup source: %s\n", ws->name);
 			active = 1;
-		} else if (!active &&
-			   (!last_activity_ws ||
-			    ktime_to_ns(ws->last_time) >
-			    ktime_to_ns(last_activity_ws->last_time))) {
-			last_activity_ws = ws;
 		}
+
+		ws = wa->last;
+		if (!active && ws && ktime_after(ws->last_time, last_time)) {
+			last_time = ws->last_time;
+			strscpy(last_name, ws->name, sizeof(last_name));
+		}
+
+		raw_spin_unlock_irqrestore(&wa->lock, flags);
 	}
 
-	if (!active && last_activity_ws)
-		pm_pr_dbg("last active wakeup source: %s\n",
-			last_activity_ws->name);
-	srcu_read_unlock(&wakeup_srcu, srcuidx);
+	if (!active && last_name[0])
+		pm_pr_dbg("last active wakeup source: %s\n", last_name);
 }
 EXPORT_SYMBOL_GPL(pm_print_active_wakeup_sources);
 
@@ -988,6 +1103,31 @@ bool pm_get_wakeup_count(unsigned int *count, bool block)
 	return !inpr;
 }
 
+#ifdef CONFIG_PM_AUTOSLEEP
+/**
+ * pm_wait_wakeup_count - Wait for a wakeup event to be registered.
+ * @count: Number of registered wakeup events to compare with.
+ * @timeout: Maximum time to wait, in jiffies.
+ *
+ * Wait until the current number of registered wakeup events is different from
+ * @count and no wakeup events are being processed, or until @timeout expires.
+ *
+ * Return 'true' if the number of registered wakeup events has changed, or
+ * 'false' if the wait has timed out.
+ */
+bool pm_wait_wakeup_count(unsigned int count, long timeout)
+{
+	unsigned int cnt, inpr;
+
+	wait_event_timeout(wakeup_count_wait_queue,
+			   (split_counters(&cnt, &inpr), !inpr && cnt != count),
+			   timeout);
+
+	split_counters(&cnt, &inpr);
+	return cnt != count;
+}
+#endif /* CONFIG_PM_AUTOSLEEP */
+
 /**
  * pm_save_wakeup_count - Save the current number of registered wakeup events.
  * @count: Value to compare with the current number of registered wakeup events.
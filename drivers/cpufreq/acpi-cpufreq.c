@@ -323,7 +323,7 @@ static u32 drv_read(struct acpi_cpufreq_data *data, const struct cpumask *mask)
 	return cmd.val;
 }
 
-/* Called via smp_call_function_many(), on the target CPUs */
+/* Called via smp_call_function_many() or _any(), on the target CPUs */
 static void do_drv_write(void *_cmd)
 {
 	struct drv_cmd *cmd = _cmd;
@@ -350,6 +350,25 @@ static void drv_write(struct acpi_cpufreq_data *data,
 	put_cpu();
 }
 
+/*
+ * With SW_ANY coordination writing the register on any one CPU of the domain
+ * is enough, so do it on this CPU if possible to avoid the IPI.
+ */
+static void drv_write_any(struct acpi_cpufreq_data *data,
+			  const struct cpumask *mask, u32 val)
+{
+	struct acpi_processor_performance *perf = to_perf_data(data);
+	struct drv_cmd cmd = {
+		.reg = &perf->control_register,
+		.val = val,
+		.func.write = data->cpu_freq_write,
+	};
+	int err;
+
+	err = smp_call_function_any(mask, do_drv_write, &cmd, 1);
+	WARN_ON_ONCE(err);
+}
+
 static u32 get_cur_val(const struct cpumask *mask, struct acpi_cpufreq_data *data)
 {
 	u32 val;
@@ -443,10 +462,12 @@ static int acpi_cpufreq_target(struct cpufreq_policy *policy,
 	 * The core won't allow CPUs to go away until the governor has been
 	 * stopped, so we can rely on the stability of policy->cpus.
 	 */
-	mask = policy->shared_type == CPUFREQ_SHARED_TYPE_ANY ?
-		cpumask_of(policy->cpu) : policy->cpus;
+	mask = policy->cpus;
 
-	drv_write(data, mask, perf->states[next_perf_state].control);
+	if (policy->shared_type == CPUFREQ_SHARED_TYPE_ANY)
+		drv_write_any(data, mask, perf->states[next_perf_state].control);
+	else
+		drv_write(data, mask, perf->states[next_perf_state].control);
 
 	if (acpi_pstate_strict) {
 		if (!check_freqs(policy, mask,
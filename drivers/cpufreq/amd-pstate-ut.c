@@ -26,10 +26,28 @@
 #include <linux/module.h>
 #include <linux/moduleparam.h>
 #include <linux/fs.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+#include <linux/smp.h>
+#include <linux/workqueue.h>
 #include <linux/amd-pstate.h>
 
 #include <acpi/cppc_acpi.h>
 
+#include <asm/tsc.h>
+
+static bool perf_tests;
+module_param(perf_tests, bool, 0444);
+MODULE_PARM_DESC(perf_tests, "Also run the performance cases, which change the frequency");
+
+/* Number of requests timed by the latency cases */
+#define AMD_PSTATE_UT_LOOPS		64
+/* Step load: idle time before it, its length and the sampling period */
+#define AMD_PSTATE_UT_STEP_IDLE_MS	100
+#define AMD_PSTATE_UT_STEP_LOAD_US	200000
+#define AMD_PSTATE_UT_STEP_SAMPLE_US	100
+
 /*
  * Abbreviations:
  * amd_pstate_ut: used as a shortform for AMD P-State unit test.
@@ -38,12 +56,14 @@
 enum amd_pstate_ut_result {
 	AMD_PSTATE_UT_RESULT_PASS,
 	AMD_PSTATE_UT_RESULT_FAIL,
+	AMD_PSTATE_UT_RESULT_SKIP,
 };
 
 struct amd_pstate_ut_struct {
 	const char *name;
 	void (*func)(u32 index);
 	enum amd_pstate_ut_result result;
+	bool perf;
 };
 
 /*
@@ -53,12 +73,20 @@ static void amd_pstate_ut_acpi_cpc_valid(u32 index);
 static void amd_pstate_ut_check_enabled(u32 index);
 static void amd_pstate_ut_check_perf(u32 index);
 static void amd_pstate_ut_check_freq(u32 index);
+static void amd_pstate_ut_perf_target(u32 index);
+static void amd_pstate_ut_perf_fast_switch(u32 index);
+static void amd_pstate_ut_perf_epp(u32 index);
+static void amd_pstate_ut_perf_step(u32 index);
 
 static struct amd_pstate_ut_struct amd_pstate_ut_cases[] = {
 	{"amd_pstate_ut_acpi_cpc_valid",   amd_pstate_ut_acpi_cpc_valid   },
 	{"amd_pstate_ut_check_enabled",    amd_pstate_ut_check_enabled    },
 	{"amd_pstate_ut_check_perf",       amd_pstate_ut_check_perf       },
-	{"amd_pstate_ut_check_freq",       amd_pstate_ut_check_freq       }
+	{"amd_pstate_ut_check_freq",       amd_pstate_ut_check_freq       },
+	{"amd_pstate_ut_perf_target",      amd_pstate_ut_perf_target,      .perf = true },
+	{"amd_pstate_ut_perf_fast_switch", amd_pstate_ut_perf_fast_switch, .perf = true },
+	{"amd_pstate_ut_perf_epp",         amd_pstate_ut_perf_epp,         .perf = true },
+	{"amd_pstate_ut_perf_step",        amd_pstate_ut_perf_step,        .perf = true }
 };
 
 static bool get_shared_mem(void)
@@ -251,16 +279,295 @@ static void amd_pstate_ut_check_freq(u32 index)
 	cpufreq_cpu_put(policy);
 }
 
+/*
+ * The performance cases print one line per measurement, made of "key=value"
+ * fields after a "perf" tag, so that they can be collected from the kernel
+ * log and compared between kernel versions:
+ *
+ *   amd_pstate_ut: perf case=target cpu=0 path=msr samples=64 min_ns=...
+ *
+ * "path" is "msr" or "shmem", depending on which way the driver programs
+ * the CPPC registers on this system.
+ */
+static const char *amd_pstate_ut_path(void)
+{
+	return get_shared_mem() ? "shmem" : "msr";
+}
+
+static void amd_pstate_ut_report(const char *name, int cpu, const u64 *ns,
+				 int nr)
+{
+	u64 min_ns = U64_MAX, max_ns = 0, sum = 0;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		min_ns = min(min_ns, ns[i]);
+		max_ns = max(max_ns, ns[i]);
+		sum += ns[i];
+	}
+
+	pr_info("perf case=%s cpu=%d path=%s samples=%d min_ns=%llu avg_ns=%llu max_ns=%llu\n",
+		name, cpu, amd_pstate_ut_path(), nr, nr ? min_ns : 0,
+		nr ? div_u64(sum, nr) : 0, max_ns);
+}
+
+/* The policy of the first online CPU, which all of the perf cases use */
+static struct cpufreq_policy *amd_pstate_ut_get_policy(u32 index)
+{
+	struct cpufreq_policy *policy;
+
+	policy = cpufreq_cpu_get(cpumask_first(cpu_online_mask));
+	if (!policy) {
+		amd_pstate_ut_cases[index].result = AMD_PSTATE_UT_RESULT_FAIL;
+		pr_err("%s no cpufreq policy!\n", __func__);
+	}
+
+	return policy;
+}
+
+/*
+ * Time frequency requests that go through ->target(), i.e. the path used by
+ * the userspace and ondemand governors, alternating between the limits so
+ * that every request changes the performance level.
+ */
+static void amd_pstate_ut_perf_target(u32 index)
+{
+	struct cpufreq_policy *policy;
+	unsigned int freq, orig;
+	u64 ns[AMD_PSTATE_UT_LOOPS];
+	int i, ret = 0;
+
+	policy = amd_pstate_ut_get_policy(index);
+	if (!policy)
+		return;
+
+	/* The active mode driver has no ->target() */
+	if (!policy->governor) {
+		amd_pstate_ut_cases[index].result = AMD_PSTATE_UT_RESULT_SKIP;
+		goto out;
+	}
+
+	down_write(&policy->rwsem);
+	orig = policy->cur;
+	for (i = 0; i < AMD_PSTATE_UT_LOOPS && !ret; i++) {
+		u64 start;
+
+		freq = i & 1 ? policy->min : policy->max;
+		start = ktime_get_ns();
+		ret = __cpufreq_driver_target(policy, freq, CPUFREQ_RELATION_L);
+		ns[i] = ktime_get_ns() - start;
+	}
+	__cpufreq_driver_target(policy, orig, CPUFREQ_RELATION_L);
+	up_write(&policy->rwsem);
+
+	if (ret) {
+		amd_pstate_ut_cases[index].result = AMD_PSTATE_UT_RESULT_FAIL;
+		pr_err("%s cpu%d target freq=%u ret=%d error!\n",
+			__func__, policy->cpu, freq, ret);
+		goto out;
+	}
+
+	amd_pstate_ut_report("target", policy->cpu, ns, i);
+	amd_pstate_ut_cases[index].result = AMD_PSTATE_UT_RESULT_PASS;
+out:
+	cpufreq_cpu_put(policy);
+}
+
+struct amd_pstate_ut_fast_switch {
+	struct cpufreq_policy *policy;
+	u64 ns[AMD_PSTATE_UT_LOOPS];
+};
+
+static void amd_pstate_ut_fast_switch_fn(void *data)
+{
+	struct amd_pstate_ut_fast_switch *fs = data;
+	struct cpufreq_policy *policy = fs->policy;
+	unsigned int orig = policy->cur;
+	int i;
+
+	for (i = 0; i < AMD_PSTATE_UT_LOOPS; i++) {
+		u64 start = ktime_get_ns();
+
+		cpufreq_driver_fast_switch(policy,
+					   i & 1 ? policy->min : policy->max);
+		fs->ns[i] = ktime_get_ns() - start;
+	}
+	cpufreq_driver_fast_switch(policy, orig);
+}
+
+/*
+ * Time the frequency switches done by schedutil from the scheduler, on the
+ * CPU that schedutil would do them on and with interrupts off like there.
+ */
+static void amd_pstate_ut_perf_fast_switch(u32 index)
+{
+	struct amd_pstate_ut_fast_switch *fs;
+	struct cpufreq_policy *policy;
+	int ret;
+
+	policy = amd_pstate_ut_get_policy(index);
+	if (!policy)
+		return;
+
+	if (!policy->fast_switch_enabled) {
+		amd_pstate_ut_cases[index].result = AMD_PSTATE_UT_RESULT_SKIP;
+		goto out;
+	}
+
+	fs = kzalloc(sizeof(*fs), GFP_KERNEL);
+	if (!fs) {
+		amd_pstate_ut_cases[index].result = AMD_PSTATE_UT_RESULT_FAIL;
+		goto out;
+	}
+
+	fs->policy = policy;
+	ret = smp_call_function_single(policy->cpu, amd_pstate_ut_fast_switch_fn,
+				       fs, true);
+	if (ret) {
+		amd_pstate_ut_cases[index].result = AMD_PSTATE_UT_RESULT_FAIL;
+		pr_err("%s cpu%d ret=%d error!\n", __func__, policy->cpu, ret);
+	} else {
+		amd_pstate_ut_report("fast_switch", policy->cpu, fs->ns,
+				     AMD_PSTATE_UT_LOOPS);
+		amd_pstate_ut_cases[index].result = AMD_PSTATE_UT_RESULT_PASS;
+	}
+
+	kfree(fs);
+out:
+	cpufreq_cpu_put(policy);
+}
+
+/*
+ * Time the CPPC request writes done for EPP updates in the active mode.
+ * The cached request is written back, so the setting does not change.
+ */
+static void amd_pstate_ut_perf_epp(u32 index)
+{
+	struct cpufreq_policy *policy;
+	struct amd_cpudata *cpudata;
+	u64 ns[AMD_PSTATE_UT_LOOPS];
+	int i, ret = 0;
+
+	policy = amd_pstate_ut_get_policy(index);
+	if (!policy)
+		return;
+	cpudata = policy->driver_data;
+
+	/* Writing the shared memory request back would also ring the doorbell */
+	if (policy->governor || get_shared_mem()) {
+		amd_pstate_ut_cases[index].result = AMD_PSTATE_UT_RESULT_SKIP;
+		goto out;
+	}
+
+	for (i = 0; i < AMD_PSTATE_UT_LOOPS && !ret; i++) {
+		u64 start = ktime_get_ns();
+
+		ret = wrmsrl_on_cpu(cpudata->cpu, MSR_AMD_CPPC_REQ,
+				    READ_ONCE(cpudata->cppc_req_cached));
+		ns[i] = ktime_get_ns() - start;
+	}
+
+	if (ret) {
+		amd_pstate_ut_cases[index].result = AMD_PSTATE_UT_RESULT_FAIL;
+		pr_err("%s cpu%d write CPPC_REQ ret=%d error!\n",
+			__func__, cpudata->cpu, ret);
+		goto out;
+	}
+
+	amd_pstate_ut_report("epp", cpudata->cpu, ns, i);
+	amd_pstate_ut_cases[index].result = AMD_PSTATE_UT_RESULT_PASS;
+out:
+	cpufreq_cpu_put(policy);
+}
+
+/*
+ * Load the CPU after it has been idle and return the time in us until the
+ * APERF/MPERF frequency reaches the target, or -ETIME if it does not.
+ */
+static long amd_pstate_ut_step_fn(void *data)
+{
+	unsigned int target = *(unsigned int *)data;
+	u64 aperf, mperf, last_aperf, last_mperf;
+	u64 start, now, last;
+
+	msleep(AMD_PSTATE_UT_STEP_IDLE_MS);
+
+	rdmsrl(MSR_IA32_APERF, last_aperf);
+	rdmsrl(MSR_IA32_MPERF, last_mperf);
+	start = last = ktime_get_ns();
+	do {
+		now = ktime_get_ns();
+		if (now - last < AMD_PSTATE_UT_STEP_SAMPLE_US * NSEC_PER_USEC)
+			continue;
+
+		rdmsrl(MSR_IA32_APERF, aperf);
+		rdmsrl(MSR_IA32_MPERF, mperf);
+		if (mperf != last_mperf &&
+		    div64_u64((aperf - last_aperf) * cpu_khz,
+			      mperf - last_mperf) >= target)
+			return div_u64(now - start, NSEC_PER_USEC);
+
+		last = now;
+		last_aperf = aperf;
+		last_mperf = mperf;
+	} while (now - start < AMD_PSTATE_UT_STEP_LOAD_US * NSEC_PER_USEC);
+
+	return -ETIME;
+}
+
+/*
+ * Measure how long the governor takes to bring an idle CPU to 90% of the
+ * nominal frequency once it becomes fully busy.
+ */
+static void amd_pstate_ut_perf_step(u32 index)
+{
+	struct cpufreq_policy *policy;
+	struct amd_cpudata *cpudata;
+	unsigned int target;
+	long us;
+
+	policy = amd_pstate_ut_get_policy(index);
+	if (!policy)
+		return;
+	cpudata = policy->driver_data;
+
+	if (!boot_cpu_has(X86_FEATURE_APERFMPERF)) {
+		amd_pstate_ut_cases[index].result = AMD_PSTATE_UT_RESULT_SKIP;
+		goto out;
+	}
+
+	target = cpudata->nominal_freq / 10 * 9;
+	us = work_on_cpu(policy->cpu, amd_pstate_ut_step_fn, &target);
+	if (us < 0) {
+		amd_pstate_ut_cases[index].result = AMD_PSTATE_UT_RESULT_FAIL;
+		pr_err("%s cpu%d did not reach %u kHz in %u us!\n", __func__,
+			policy->cpu, target, AMD_PSTATE_UT_STEP_LOAD_US);
+		goto out;
+	}
+
+	pr_info("perf case=step cpu=%d path=%s target_khz=%u time_us=%ld\n",
+		policy->cpu, amd_pstate_ut_path(), target, us);
+	amd_pstate_ut_cases[index].result = AMD_PSTATE_UT_RESULT_PASS;
+out:
+	cpufreq_cpu_put(policy);
+}
+
 static int __init amd_pstate_ut_init(void)
 {
 	u32 i = 0, arr_size = ARRAY_SIZE(amd_pstate_ut_cases);
 
 	for (i = 0; i < arr_size; i++) {
+		if (amd_pstate_ut_cases[i].perf && !perf_tests)
+			continue;
+
 		amd_pstate_ut_cases[i].func(i);
 		switch (amd_pstate_ut_cases[i].result) {
 		case AMD_PSTATE_UT_RESULT_PASS:
 			pr_info("%-4d %-20s\t success!\n", i+1, amd_pstate_ut_cases[i].name);
 			break;
+		case AMD_PSTATE_UT_RESULT_SKIP:
+			pr_info("%-4d %-20s\t skip!\n", i+1, amd_pstate_ut_cases[i].name);
+			break;
 		case AMD_PSTATE_UT_RESULT_FAIL:
 		default:
 			pr_info("%-4d %-20s\t fail!\n", i+1, amd_pstate_ut_cases[i].name);
@@ -37,6 +37,9 @@
 #include <linux/uaccess.h>
 #include <linux/static_call.h>
 #include <linux/amd-pstate.h>
+#include <linux/irq_work.h>
+#include <linux/kthread.h>
+#include <linux/topology.h>
 
 #include <acpi/processor.h>
 #include <acpi/cppc_acpi.h>
@@ -45,6 +48,9 @@
 #include <asm/processor.h>
 #include <asm/cpufeature.h>
 #include <asm/cpu_device_id.h>
+
+#include <trace/events/power.h>
+
 #include "amd-pstate-trace.h"
 
 #define AMD_PSTATE_TRANSITION_LATENCY	20000
@@ -65,6 +71,36 @@ static struct cpufreq_driver amd_pstate_epp_driver;
 static int cppc_state = AMD_PSTATE_UNDEFINED;
 static bool cppc_enabled;
 
+/*
+ * On shared memory designs, cppc_set_perf() may need to wait for the PCC
+ * mailbox, so it cannot be used for fast switching.  Instead, the requests
+ * made in the fast switching context are recorded and written by a worker
+ * thread, which handles all of the CPUs with pending requests at once, so
+ * that they are delivered to the platform with one PCC write command.
+ */
+static bool shmem_async = true;
+module_param(shmem_async, bool, 0444);
+MODULE_PARM_DESC(shmem_async, "Write shared memory CPPC requests asynchronously to allow fast switching");
+
+/*
+ * The frequency sensitivity counters tell how much of the time at the current
+ * frequency went into work that would have been faster at a higher one.  If
+ * freq_sensitivity_bias is set, the desired performance requested through
+ * ->adjust_perf() is scaled down by sensitivity / freq_sensitivity_bias when
+ * the sensitivity is below it, so memory bound phases run at a lower
+ * frequency with schedutil.  The range is 0 (off) to AMD_FREQ_SENSITIVITY_MAX.
+ * The counters are sampled at most once per jiffy on every CPU.
+ */
+static bool freq_sensitivity_supported;
+static unsigned int freq_sensitivity_bias;
+static DEFINE_MUTEX(amd_pstate_sensitivity_lock);
+
+static struct cpumask cppc_async_pending;
+static struct cpumask cppc_async_cpus;
+static struct kthread_worker *cppc_async_worker;
+static struct kthread_work cppc_async_work;
+static struct irq_work cppc_async_irq_work;
+
 /*
  * AMD Energy Preference Performance (EPP)
  * The EPP is used in the CCLK DPM controller to drive
@@ -370,12 +406,72 @@ static void pstate_update_perf(struct amd_cpudata *cpudata, u32 min_perf,
 			      READ_ONCE(cpudata->cppc_req_cached));
 }
 
+static void cppc_async_work_fn(struct kthread_work *work)
+{
+	struct cppc_perf_ctrls perf_ctrls;
+	int cpu;
+
+	cpumask_clear(&cppc_async_cpus);
+
+	for_each_cpu(cpu, &cppc_async_pending) {
+		struct cpufreq_policy *policy;
+		struct amd_cpudata *cpudata;
+		u64 value;
+
+		if (!cpumask_test_and_clear_cpu(cpu, &cppc_async_pending))
+			continue;
+
+		policy = cpufreq_cpu_get(cpu);
+		if (!policy)
+			continue;
+
+		cpudata = policy->driver_data;
+		value = READ_ONCE(cpudata->cppc_req_cached);
+		cpufreq_cpu_put(policy);
+
+		perf_ctrls.max_perf = value & AMD_CPPC_MAX_PERF(~0L);
+		perf_ctrls.min_perf = (value & AMD_CPPC_MIN_PERF(~0L)) >> 8;
+		perf_ctrls.desired_perf = (value & AMD_CPPC_DES_PERF(~0L)) >> 16;
+
+		if (!cppc_set_perf_begin(cpu, &perf_ctrls))
+			cpumask_set_cpu(cpu, &cppc_async_cpus);
+	}
+
+	for_each_cpu(cpu, &cppc_async_cpus)
+		cppc_set_perf_end(cpu);
+}
+
+static void cppc_async_irq_work_fn(struct irq_work *irq_work)
+{
+	kthread_queue_work(cppc_async_worker, &cppc_async_work);
+}
+
+static int __init cppc_async_init(void)
+{
+	cppc_async_worker = kthread_create_worker(0, "amd_pstate_cppc");
+	if (IS_ERR(cppc_async_worker))
+		return PTR_ERR(cppc_async_worker);
+
+	sched_set_fifo_low(cppc_async_worker->task);
+	kthread_init_work(&cppc_async_work, cppc_async_work_fn);
+	init_irq_work(&cppc_async_irq_work, cppc_async_irq_work_fn);
+
+	return 0;
+}
+
 static void cppc_update_perf(struct amd_cpudata *cpudata,
 			     u32 min_perf, u32 des_perf,
 			     u32 max_perf, bool fast_switch)
 {
 	struct cppc_perf_ctrls perf_ctrls;
 
+	/* The new values are in cppc_req_cached already. */
+	if (fast_switch) {
+		cpumask_set_cpu(cpudata->cpu, &cppc_async_pending);
+		irq_work_queue(&cppc_async_irq_work);
+		return;
+	}
+
 	perf_ctrls.max_perf = max_perf;
 	perf_ctrls.min_perf = min_perf;
 	perf_ctrls.desired_perf = des_perf;
@@ -448,6 +544,9 @@ static void amd_pstate_update(struct amd_cpudata *cpudata, u32 min_perf,
 	value &= ~AMD_CPPC_MAX_PERF(~0L);
 	value |= AMD_CPPC_MAX_PERF(max_perf);
 
+	trace_amd_pstate_update_tp(cpudata->cpu, min_perf, des_perf, max_perf,
+				   fast_switch);
+
 	if (trace_amd_pstate_perf_enabled() && amd_pstate_sample(cpudata)) {
 		trace_amd_pstate_perf(min_perf, des_perf, max_perf, cpudata->freq,
 			cpudata->cur.mperf, cpudata->cur.aperf, cpudata->cur.tsc,
@@ -521,6 +620,43 @@ static unsigned int amd_pstate_fast_switch(struct cpufreq_policy *policy,
 	return amd_pstate_update_freq(policy, target_freq, true);
 }
 
+/* Runs on the CPU of cpudata, from the scheduler */
+static unsigned long amd_pstate_sensitivity_perf(struct amd_cpudata *cpudata,
+						 unsigned long des_perf)
+{
+	unsigned int bias = READ_ONCE(freq_sensitivity_bias);
+	u64 actual, reference;
+	int sens;
+
+	if (!bias || cpudata->cpu != smp_processor_id())
+		return des_perf;
+
+#ifdef arch_freq_sensitivity_enabled
+	/* schedutil has scaled the utilization by the sensitivity already */
+	if (arch_freq_sensitivity_enabled())
+		return des_perf;
+#endif
+
+	if (cpudata->sens_jiffies != jiffies) {
+		cpudata->sens_jiffies = jiffies;
+
+		rdmsrl(MSR_AMD64_FREQ_SENSITIVITY_ACTUAL, actual);
+		rdmsrl(MSR_AMD64_FREQ_SENSITIVITY_REFERENCE, reference);
+
+		/* Keep the last value if the counters could not be used */
+		sens = amd_freq_sensitivity_update(&cpudata->sens, actual,
+						   reference);
+		if (sens >= 0)
+			cpudata->sens_last = sens;
+	}
+
+	sens = cpudata->sens_last;
+	if (sens >= bias)
+		return des_perf;
+
+	return DIV_ROUND_UP(des_perf * sens, bias);
+}
+
 static void amd_pstate_adjust_perf(unsigned int cpu,
 				   unsigned long _min_perf,
 				   unsigned long target_perf,
@@ -551,6 +687,7 @@ static void amd_pstate_adjust_perf(unsigned int cpu,
 	if (max_perf < min_perf)
 		max_perf = min_perf;
 
+	des_perf = amd_pstate_sensitivity_perf(cpudata, des_perf);
 	des_perf = clamp_t(unsigned long, des_perf, min_perf, max_perf);
 	target_freq = div_u64(des_perf * max_freq, max_perf);
 	policy->cur = target_freq;
@@ -696,6 +833,7 @@ static int amd_pstate_cpu_init(struct cpufreq_policy *policy)
 		return -ENOMEM;
 
 	cpudata->cpu = policy->cpu;
+	cpudata->sens_last = AMD_FREQ_SENSITIVITY_MAX;
 
 	ret = amd_pstate_init_perf(cpudata);
 	if (ret)
@@ -725,7 +863,7 @@ static int amd_pstate_cpu_init(struct cpufreq_policy *policy)
 	/* It will be updated by governor */
 	policy->cur = policy->cpuinfo.min_freq;
 
-	if (boot_cpu_has(X86_FEATURE_CPPC))
+	if (boot_cpu_has(X86_FEATURE_CPPC) || shmem_async)
 		policy->fast_switch_possible = true;
 
 	ret = freq_qos_add_request(&policy->constraints, &cpudata->req[0],
@@ -770,6 +908,13 @@ static int amd_pstate_cpu_exit(struct cpufreq_policy *policy)
 	freq_qos_remove_request(&cpudata->req[1]);
 	freq_qos_remove_request(&cpudata->req[0]);
 	policy->fast_switch_possible = false;
+
+	/* The governor has been stopped, so no new requests can be made. */
+	if (!boot_cpu_has(X86_FEATURE_CPPC) && shmem_async) {
+		irq_work_sync(&cppc_async_irq_work);
+		kthread_flush_work(&cppc_async_work);
+	}
+
 	kfree(cpudata);
 
 	return 0;
@@ -894,6 +1039,34 @@ static ssize_t show_energy_performance_preference(
 	return sysfs_emit(buf, "%s\n", energy_perf_strings[preference]);
 }
 
+/*
+ * Frequency sensitivity of the CPU since the previous read of this attribute,
+ * for user space tools that tune the EPP.
+ */
+static ssize_t show_freq_sensitivity(struct cpufreq_policy *policy, char *buf)
+{
+	struct amd_cpudata *cpudata = policy->driver_data;
+	u64 actual, reference;
+	int ret;
+
+	mutex_lock(&amd_pstate_sensitivity_lock);
+	ret = rdmsrl_on_cpu(cpudata->cpu, MSR_AMD64_FREQ_SENSITIVITY_ACTUAL,
+			    &actual);
+	if (!ret)
+		ret = rdmsrl_on_cpu(cpudata->cpu,
+				    MSR_AMD64_FREQ_SENSITIVITY_REFERENCE,
+				    &reference);
+	if (!ret)
+		ret = amd_freq_sensitivity_update(&cpudata->sens_user, actual,
+						  reference);
+	mutex_unlock(&amd_pstate_sensitivity_lock);
+
+	if (ret < 0)
+		return ret;
+
+	return sysfs_emit(buf, "%d\n", ret);
+}
+
 static void amd_pstate_driver_cleanup(void)
 {
 	amd_pstate_enable(false);
@@ -1024,6 +1197,31 @@ static ssize_t status_show(struct device *dev,
 	return ret;
 }
 
+static ssize_t freq_sensitivity_bias_show(struct device *dev,
+					  struct device_attribute *attr,
+					  char *buf)
+{
+	return sysfs_emit(buf, "%u\n", READ_ONCE(freq_sensitivity_bias));
+}
+
+static ssize_t freq_sensitivity_bias_store(struct device *dev,
+					   struct device_attribute *attr,
+					   const char *buf, size_t count)
+{
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	if (val > AMD_FREQ_SENSITIVITY_MAX)
+		return -EINVAL;
+
+	WRITE_ONCE(freq_sensitivity_bias, val);
+	return count;
+}
+
 static ssize_t status_store(struct device *a, struct device_attribute *b,
 			    const char *buf, size_t count)
 {
@@ -1043,12 +1241,15 @@ cpufreq_freq_attr_ro(amd_pstate_lowest_nonlinear_freq);
 cpufreq_freq_attr_ro(amd_pstate_highest_perf);
 cpufreq_freq_attr_rw(energy_performance_preference);
 cpufreq_freq_attr_ro(energy_performance_available_preferences);
+cpufreq_freq_attr_ro(freq_sensitivity);
 static DEVICE_ATTR_RW(status);
+static DEVICE_ATTR_RW(freq_sensitivity_bias);
 
 static struct freq_attr *amd_pstate_attr[] = {
 	&amd_pstate_max_freq,
 	&amd_pstate_lowest_nonlinear_freq,
 	&amd_pstate_highest_perf,
+	&freq_sensitivity,
 	NULL,
 };
 
@@ -1058,17 +1259,44 @@ static struct freq_attr *amd_pstate_epp_attr[] = {
 	&amd_pstate_highest_perf,
 	&energy_performance_preference,
 	&energy_performance_available_preferences,
+	&freq_sensitivity,
 	NULL,
 };
 
 static struct attribute *pstate_global_attributes[] = {
 	&dev_attr_status.attr,
+	&dev_attr_freq_sensitivity_bias.attr,
 	NULL
 };
 
+/* Drop @hide from the NULL-terminated @attrs */
+static void __init amd_pstate_hide_attr(struct freq_attr **attrs,
+					struct freq_attr *hide)
+{
+	for (; *attrs; attrs++) {
+		if (*attrs == hide) {
+			do {
+				attrs[0] = attrs[1];
+			} while (*attrs++);
+			break;
+		}
+	}
+}
+
+static umode_t amd_pstate_global_attr_visible(struct kobject *kobj,
+					      struct attribute *attr, int n)
+{
+	if (attr == &dev_attr_freq_sensitivity_bias.attr &&
+	    !freq_sensitivity_supported)
+		return 0;
+
+	return attr->mode;
+}
+
 static const struct attribute_group amd_pstate_global_attr_group = {
 	.name = "amd_pstate",
 	.attrs = pstate_global_attributes,
+	.is_visible = amd_pstate_global_attr_visible,
 };
 
 static bool amd_pstate_acpi_pm_profile_server(void)
@@ -1473,6 +1701,13 @@ static int __init amd_pstate_init(void)
 		return -EINVAL;
 	}
 
+	freq_sensitivity_supported = boot_cpu_has(X86_FEATURE_PROC_FEEDBACK) &&
+				     amd_freq_sensitivity_present();
+	if (!freq_sensitivity_supported) {
+		amd_pstate_hide_attr(amd_pstate_attr, &freq_sensitivity);
+		amd_pstate_hide_attr(amd_pstate_epp_attr, &freq_sensitivity);
+	}
+
 	/* capability check */
 	if (boot_cpu_has(X86_FEATURE_CPPC)) {
 		pr_debug("AMD CPPC MSR based functionality is supported\n");
@@ -1483,6 +1718,11 @@ static int __init amd_pstate_init(void)
 		static_call_update(amd_pstate_enable, cppc_enable);
 		static_call_update(amd_pstate_init_perf, cppc_init_perf);
 		static_call_update(amd_pstate_update_perf, cppc_update_perf);
+
+		if (shmem_async && cppc_async_init()) {
+			pr_warn("failed to create the CPPC request worker\n");
+			shmem_async = false;
+		}
 	}
 
 	/* enable amd pstate feature */
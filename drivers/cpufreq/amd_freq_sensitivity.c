@@ -15,6 +15,7 @@
 #include <linux/percpu-defs.h>
 #include <linux/init.h>
 #include <linux/mod_devicetable.h>
+#include <linux/amd-pstate.h>
 
 #include <asm/msr.h>
 #include <asm/cpufeature.h>
@@ -22,15 +23,10 @@
 
 #include "cpufreq_ondemand.h"
 
-#define MSR_AMD64_FREQ_SENSITIVITY_ACTUAL	0xc0010080
-#define MSR_AMD64_FREQ_SENSITIVITY_REFERENCE	0xc0010081
-#define CLASS_CODE_SHIFT			56
-#define POWERSAVE_BIAS_MAX			1000
 #define POWERSAVE_BIAS_DEF			400
 
 struct cpu_data_t {
-	u64 actual;
-	u64 reference;
+	struct amd_freq_sensitivity sens;
 	unsigned int freq_prev;
 };
 
@@ -41,8 +37,7 @@ static unsigned int amd_powersave_bias_target(struct cpufreq_policy *policy,
 					      unsigned int relation)
 {
 	int sensitivity;
-	long d_actual, d_reference;
-	struct msr actual, reference;
+	u64 actual, reference;
 	struct cpu_data_t *data = &per_cpu(cpu_data, policy->cpu);
 	struct policy_dbs_info *policy_dbs = policy->governor_data;
 	struct dbs_data *od_data = policy_dbs->dbs_data;
@@ -51,32 +46,14 @@ static unsigned int amd_powersave_bias_target(struct cpufreq_policy *policy,
 	if (!policy->freq_table)
 		return freq_next;
 
-	rdmsr_on_cpu(policy->cpu, MSR_AMD64_FREQ_SENSITIVITY_ACTUAL,
-		&actual.l, &actual.h);
-	rdmsr_on_cpu(policy->cpu, MSR_AMD64_FREQ_SENSITIVITY_REFERENCE,
-		&reference.l, &reference.h);
-	actual.h &= 0x00ffffff;
-	reference.h &= 0x00ffffff;
-
-	/* counter wrapped around, so stay on current frequency */
-	if (actual.q < data->actual || reference.q < data->reference) {
-		freq_next = policy->cur;
-		goto out;
-	}
-
-	d_actual = actual.q - data->actual;
-	d_reference = reference.q - data->reference;
-
-	/* divide by 0, so stay on current frequency as well */
-	if (d_reference == 0) {
-		freq_next = policy->cur;
-		goto out;
-	}
+	rdmsrl_on_cpu(policy->cpu, MSR_AMD64_FREQ_SENSITIVITY_ACTUAL, &actual);
+	rdmsrl_on_cpu(policy->cpu, MSR_AMD64_FREQ_SENSITIVITY_REFERENCE,
+		      &reference);
 
-	sensitivity = POWERSAVE_BIAS_MAX -
-		(POWERSAVE_BIAS_MAX * (d_reference - d_actual) / d_reference);
-
-	clamp(sensitivity, 0, POWERSAVE_BIAS_MAX);
+	/* counter wrapped around or did not move, so stay on current frequency */
+	sensitivity = amd_freq_sensitivity_update(&data->sens, actual, reference);
+	if (sensitivity < 0)
+		return policy->cur;
 
 	/* this workload is not CPU bound, so choose a lower freq */
 	if (sensitivity < od_tuners->powersave_bias) {
@@ -100,15 +77,11 @@ static unsigned int amd_powersave_bias_target(struct cpufreq_policy *policy,
 	} else
 		data->freq_prev = 0;
 
-out:
-	data->actual = actual.q;
-	data->reference = reference.q;
 	return freq_next;
 }
 
 static int __init amd_freq_sensitivity_init(void)
 {
-	u64 val;
 	struct pci_dev *pcidev;
 	unsigned int pci_vendor;
 
@@ -129,10 +102,7 @@ static int __init amd_freq_sensitivity_init(void)
 		pci_dev_put(pcidev);
 	}
 
-	if (rdmsrl_safe(MSR_AMD64_FREQ_SENSITIVITY_ACTUAL, &val))
-		return -ENODEV;
-
-	if (!(val >> CLASS_CODE_SHIFT))
+	if (!amd_freq_sensitivity_present())
 		return -ENODEV;
 
 	od_register_powersave_bias_handler(amd_powersave_bias_target,
@@ -161,10 +161,17 @@ static int apple_soc_cpufreq_set_target(struct cpufreq_policy *policy,
 static unsigned int apple_soc_cpufreq_fast_switch(struct cpufreq_policy *policy,
 						  unsigned int target_freq)
 {
-	if (apple_soc_cpufreq_set_target(policy, policy->cached_resolved_idx) < 0)
+	unsigned int index;
+
+	if (policy->cached_target_freq == target_freq)
+		index = policy->cached_resolved_idx;
+	else
+		index = cpufreq_table_find_index_dl(policy, target_freq, false);
+
+	if (apple_soc_cpufreq_set_target(policy, index) < 0)
 		return 0;
 
-	return policy->freq_table[policy->cached_resolved_idx].frequency;
+	return policy->freq_table[index].frequency;
 }
 
 static int apple_soc_cpufreq_find_cluster(struct cpufreq_policy *policy,
@@ -73,9 +73,27 @@ static enum {
 module_param(fie_disabled, int, 0444);
 MODULE_PARM_DESC(fie_disabled, "Disable Frequency Invariance Engine (FIE)");
 
+/*
+ * Upper bound of the FIE sampling interval.  If it is nonzero, the interval
+ * for a CPU grows from one tick up to it (by doubling) while the frequency
+ * scale of that CPU stays the same and drops to one tick when it changes.
+ */
+static unsigned int fie_max_interval_ms;
+module_param(fie_max_interval_ms, uint, 0444);
+MODULE_PARM_DESC(fie_max_interval_ms, "Maximum FIE sampling interval in ms (0 - sample on every tick)");
+
+/*
+ * The frequency scale computed from the feedback counters fluctuates slightly
+ * even if the frequency does not change, so treat changes within this margin
+ * (out of SCHED_CAPACITY_SCALE) as no change when adjusting the interval.
+ */
+#define CPPC_FIE_SCALE_TOLERANCE	16
+
 /* Frequency invariance support */
 struct cppc_freq_invariance {
 	int cpu;
+	unsigned long next_sample;	/* jiffies */
+	unsigned long interval;		/* jiffies */
 	struct irq_work irq_work;
 	struct kthread_work work;
 	struct cppc_perf_fb_ctrs prev_perf_fb_ctrs;
@@ -134,6 +152,19 @@ static void cppc_scale_freq_workfn(struct kthread_work *work)
 	if (unlikely(local_freq_scale > 1024))
 		local_freq_scale = 1024;
 
+	if (fie_max_interval_ms) {
+		unsigned long max_interval = msecs_to_jiffies(fie_max_interval_ms);
+
+		/* Back off while the frequency is stable. */
+		if (abs_diff(local_freq_scale, per_cpu(arch_freq_scale, cppc_fi->cpu)) <=
+		    CPPC_FIE_SCALE_TOLERANCE)
+			cppc_fi->interval = min(cppc_fi->interval * 2, max_interval);
+		else
+			cppc_fi->interval = 1;
+
+		WRITE_ONCE(cppc_fi->next_sample, jiffies + cppc_fi->interval);
+	}
+
 	per_cpu(arch_freq_scale, cppc_fi->cpu) = local_freq_scale;
 }
 
@@ -149,6 +180,10 @@ static void cppc_scale_freq_tick(void)
 {
 	struct cppc_freq_invariance *cppc_fi = &per_cpu(cppc_freq_inv, smp_processor_id());
 
+	if (fie_max_interval_ms &&
+	    time_before(jiffies, READ_ONCE(cppc_fi->next_sample)))
+		return;
+
 	/*
 	 * cppc_get_perf_ctrs() can potentially sleep, call that from the right
 	 * context.
@@ -173,6 +208,8 @@ static void cppc_cpufreq_cpu_fie_init(struct cpufreq_policy *policy)
 		cppc_fi = &per_cpu(cppc_freq_inv, cpu);
 		cppc_fi->cpu = cpu;
 		cppc_fi->cpu_data = policy->driver_data;
+		cppc_fi->next_sample = jiffies;
+		cppc_fi->interval = 1;
 		kthread_init_work(&cppc_fi->work, cppc_scale_freq_workfn);
 		init_irq_work(&cppc_fi->irq_work, cppc_irq_work);
 
@@ -15,6 +15,7 @@
 #include <linux/err.h>
 #include <linux/list.h>
 #include <linux/module.h>
+#include <linux/notifier.h>
 #include <linux/of.h>
 #include <linux/pm_opp.h>
 #include <linux/platform_device.h>
@@ -32,6 +33,15 @@ struct private_data {
 	struct cpufreq_frequency_table *freq_table;
 	bool have_static_opps;
 	int opp_token;
+
+	/*
+	 * OPPs matching the entries of freq_table, so that set_target() can skip
+	 * the clk_round_rate() and the OPP lookup done by dev_pm_opp_set_rate().
+	 * Not used anymore once the OPP table changes at runtime.
+	 */
+	struct dev_pm_opp **opps;
+	struct notifier_block opp_nb;
+	bool opps_stale;
 };
 
 static LIST_HEAD(priv_list);
@@ -59,9 +69,71 @@ static int set_target(struct cpufreq_policy *policy, unsigned int index)
 	struct private_data *priv = policy->driver_data;
 	unsigned long freq = policy->freq_table[index].frequency;
 
+	if (priv->opps && priv->opps[index] && !READ_ONCE(priv->opps_stale))
+		return dev_pm_opp_set_opp(priv->cpu_dev, priv->opps[index]);
+
 	return dev_pm_opp_set_rate(priv->cpu_dev, freq * 1000);
 }
 
+static void uncache_opps(struct private_data *priv)
+{
+	struct cpufreq_frequency_table *pos;
+
+	if (!priv->opps)
+		return;
+
+	if (priv->opp_nb.notifier_call)
+		dev_pm_opp_unregister_notifier(priv->cpu_dev, &priv->opp_nb);
+
+	cpufreq_for_each_entry(pos, priv->freq_table)
+		if (priv->opps[pos - priv->freq_table])
+			dev_pm_opp_put(priv->opps[pos - priv->freq_table]);
+
+	kfree(priv->opps);
+	priv->opps = NULL;
+}
+
+static int opp_notifier(struct notifier_block *nb, unsigned long event,
+			void *data)
+{
+	struct private_data *priv = container_of(nb, struct private_data, opp_nb);
+
+	/* The voltage is looked up at transition time, it can change freely */
+	if (event != OPP_EVENT_ADJUST_VOLTAGE)
+		WRITE_ONCE(priv->opps_stale, true);
+
+	return NOTIFY_OK;
+}
+
+static void cache_opps(struct private_data *priv)
+{
+	struct cpufreq_frequency_table *pos;
+	unsigned int count = 0;
+
+	cpufreq_for_each_entry(pos, priv->freq_table)
+		count++;
+
+	priv->opps = kcalloc(count, sizeof(*priv->opps), GFP_KERNEL);
+	if (!priv->opps)
+		return;
+
+	cpufreq_for_each_valid_entry(pos, priv->freq_table) {
+		unsigned long rate = pos->frequency * 1000UL;
+		struct dev_pm_opp *opp;
+
+		opp = dev_pm_opp_find_freq_ceil(priv->cpu_dev, &rate);
+		if (!IS_ERR(opp))
+			priv->opps[pos - priv->freq_table] = opp;
+	}
+
+	priv->opp_nb.notifier_call = opp_notifier;
+	if (dev_pm_opp_register_notifier(priv->cpu_dev, &priv->opp_nb)) {
+		dev_dbg(priv->cpu_dev, "no OPP notifier, not caching OPPs\n");
+		priv->opp_nb.notifier_call = NULL;
+		uncache_opps(priv);
+	}
+}
+
 /*
  * An earlier version of opp-v1 bindings used to name the regulator
  * "cpu0-supply", we still need to handle that for backwards compatibility.
@@ -286,6 +358,8 @@ static int dt_cpufreq_early_init(struct device *dev, int cpu)
 		goto out;
 	}
 
+	cache_opps(priv);
+
 	list_add(&priv->node, &priv_list);
 	return 0;
 
@@ -303,6 +377,7 @@ static void dt_cpufreq_release(void)
 	struct private_data *priv, *tmp;
 
 	list_for_each_entry_safe(priv, tmp, &priv_list, node) {
+		uncache_opps(priv);
 		dev_pm_opp_free_cpufreq_table(priv->cpu_dev, &priv->freq_table);
 		if (priv->have_static_opps)
 			dev_pm_opp_of_cpumask_remove_table(priv->cpus);
@@ -24,6 +24,7 @@
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/pm_qos.h>
+#include <linux/sched/clock.h>
 #include <linux/slab.h>
 #include <linux/suspend.h>
 #include <linux/syscore_ops.h>
@@ -80,6 +81,8 @@ bool has_target_index(void)
 
 /* internal prototypes */
 static unsigned int __cpufreq_get(struct cpufreq_policy *policy);
+static unsigned int cpufreq_verify_current_freq(struct cpufreq_policy *policy,
+						bool update);
 static int cpufreq_init_governor(struct cpufreq_policy *policy);
 static void cpufreq_exit_governor(struct cpufreq_policy *policy);
 static void cpufreq_governor_limits(struct cpufreq_policy *policy);
@@ -99,6 +102,12 @@ static BLOCKING_NOTIFIER_HEAD(cpufreq_policy_notifier_list);
 SRCU_NOTIFIER_HEAD_STATIC(cpufreq_transition_notifier_list);
 
 static int off __read_mostly;
+/* Window for coalescing the frequency QoS notifications of a policy. */
+static unsigned int qos_notify_delay_ms __read_mostly;
+/* Derive the default transition delay from measured latencies if unknown. */
+static bool measured_transition_delay __read_mostly;
+/* Keep the governor and driver state of policies whose CPUs all go offline. */
+static bool park_offline __read_mostly;
 static int cpufreq_disabled(void)
 {
 	return off;
@@ -164,6 +173,28 @@ u64 get_cpu_idle_time(unsigned int cpu, u64 *wall, int io_busy)
 }
 EXPORT_SYMBOL_GPL(get_cpu_idle_time);
 
+/**
+ * get_cpu_idle_time_at - Get the idle time of a CPU as of a given time.
+ * @cpu: CPU to get the idle time for.
+ * @now: Current time as returned by ktime_get().
+ * @wall: Return location for the wall time of the sample (in usecs).
+ * @io_busy: Whether or not to treat the iowait time as busy time.
+ *
+ * Like get_cpu_idle_time(), but does not read the current time, so it is
+ * cheaper to use for multiple CPUs in a row.
+ */
+u64 get_cpu_idle_time_at(unsigned int cpu, ktime_t now, u64 *wall, int io_busy)
+{
+	u64 idle_time = get_cpu_idle_time_us_at(cpu, now, !io_busy);
+
+	if (idle_time == -1ULL)
+		return get_cpu_idle_time_jiffy(cpu, wall);
+
+	*wall = ktime_to_us(now);
+	return idle_time;
+}
+EXPORT_SYMBOL_GPL(get_cpu_idle_time_at);
+
 /*
  * This is a generic cpufreq init() routine which can be used by cpufreq
  * drivers of SMP systems. It will do following:
@@ -533,22 +564,54 @@ void cpufreq_disable_fast_switch(struct cpufreq_policy *policy)
 }
 EXPORT_SYMBOL_GPL(cpufreq_disable_fast_switch);
 
-static unsigned int __resolve_freq(struct cpufreq_policy *policy,
-		unsigned int target_freq, unsigned int relation)
+static unsigned int __resolve_freq_limits(struct cpufreq_policy *policy,
+		unsigned int target_freq, unsigned int min, unsigned int max,
+		unsigned int relation)
 {
 	unsigned int idx;
 
-	target_freq = clamp_val(target_freq, policy->min, policy->max);
+	target_freq = clamp_val(target_freq, min, max);
 
 	if (!policy->freq_table)
 		return target_freq;
 
-	idx = cpufreq_frequency_table_target(policy, target_freq, relation);
+	idx = cpufreq_frequency_table_target(policy, target_freq, min, max,
+					     relation);
 	policy->cached_resolved_idx = idx;
 	policy->cached_target_freq = target_freq;
 	return policy->freq_table[idx].frequency;
 }
 
+static unsigned int __resolve_freq(struct cpufreq_policy *policy,
+		unsigned int target_freq, unsigned int relation)
+{
+	unsigned int min, max;
+
+	cpufreq_policy_fast_limits(policy, &min, &max);
+
+	return __resolve_freq_limits(policy, target_freq, min, max, relation);
+}
+
+static void cpufreq_policy_set_limits(struct cpufreq_policy *policy,
+				      unsigned int min, unsigned int max)
+{
+	unsigned long flags;
+
+	/*
+	 * The readers may run in interrupt context on this CPU, so they must
+	 * not be allowed to spin on an update that they have interrupted.
+	 */
+	local_irq_save(flags);
+	write_seqcount_begin(&policy->fast_limits.seq);
+	policy->fast_limits.min = min;
+	policy->fast_limits.max = max;
+	write_seqcount_end(&policy->fast_limits.seq);
+	local_irq_restore(flags);
+
+	policy->min = min;
+	policy->max = max;
+}
+
 /**
  * cpufreq_driver_resolve_freq - Map a target frequency to a driver-supported
  * one.
@@ -574,7 +637,12 @@ unsigned int cpufreq_policy_transition_delay_us(struct cpufreq_policy *policy)
 	if (policy->transition_delay_us)
 		return policy->transition_delay_us;
 
-	latency = policy->cpuinfo.transition_latency / NSEC_PER_USEC;
+	latency = policy->cpuinfo.transition_latency;
+	if (latency == CPUFREQ_ETERNAL && READ_ONCE(measured_transition_delay) &&
+	    READ_ONCE(policy->transition_latency_avg))
+		latency = READ_ONCE(policy->transition_latency_avg);
+
+	latency /= NSEC_PER_USEC;
 	if (latency) {
 		/*
 		 * For platforms that can change the frequency very fast (< 10
@@ -734,6 +802,7 @@ static ssize_t show_##file_name				\
 show_one(cpuinfo_min_freq, cpuinfo.min_freq);
 show_one(cpuinfo_max_freq, cpuinfo.max_freq);
 show_one(cpuinfo_transition_latency, cpuinfo.transition_latency);
+show_one(cpuinfo_transition_latency_avg, transition_latency_avg);
 show_one(scaling_min_freq, min);
 show_one(scaling_max_freq, max);
 
@@ -958,6 +1027,7 @@ cpufreq_freq_attr_ro_perm(cpuinfo_cur_freq, 0400);
 cpufreq_freq_attr_ro(cpuinfo_min_freq);
 cpufreq_freq_attr_ro(cpuinfo_max_freq);
 cpufreq_freq_attr_ro(cpuinfo_transition_latency);
+cpufreq_freq_attr_ro(cpuinfo_transition_latency_avg);
 cpufreq_freq_attr_ro(scaling_available_governors);
 cpufreq_freq_attr_ro(scaling_driver);
 cpufreq_freq_attr_ro(scaling_cur_freq);
@@ -973,6 +1043,7 @@ static struct attribute *cpufreq_attrs[] = {
 	&cpuinfo_min_freq.attr,
 	&cpuinfo_max_freq.attr,
 	&cpuinfo_transition_latency.attr,
+	&cpuinfo_transition_latency_avg.attr,
 	&scaling_min_freq.attr,
 	&scaling_max_freq.attr,
 	&affected_cpus.attr,
@@ -1270,6 +1341,7 @@ static struct cpufreq_policy *cpufreq_policy_alloc(unsigned int cpu)
 	}
 
 	freq_constraints_init(&policy->constraints);
+	freq_qos_set_notify_delay(&policy->constraints, qos_notify_delay_ms);
 
 	policy->nb_min.notifier_call = cpufreq_notifier_min;
 	policy->nb_max.notifier_call = cpufreq_notifier_max;
@@ -1292,6 +1364,7 @@ static struct cpufreq_policy *cpufreq_policy_alloc(unsigned int cpu)
 
 	INIT_LIST_HEAD(&policy->policy_list);
 	init_rwsem(&policy->rwsem);
+	seqcount_init(&policy->fast_limits.seq);
 	spin_lock_init(&policy->transition_lock);
 	init_waitqueue_head(&policy->transition_wait);
 	INIT_WORK(&policy->update, handle_update);
@@ -1336,6 +1409,9 @@ static void cpufreq_policy_free(struct cpufreq_policy *policy)
 		per_cpu(cpufreq_cpu_data, cpu) = NULL;
 	write_unlock_irqrestore(&cpufreq_driver_lock, flags);
 
+	/* Deliver any pending QoS notifications and stop deferring them. */
+	freq_qos_set_notify_delay(&policy->constraints, 0);
+
 	freq_qos_remove_notifier(&policy->constraints, FREQ_QOS_MAX,
 				 &policy->nb_max);
 	freq_qos_remove_notifier(&policy->constraints, FREQ_QOS_MIN,
@@ -1358,6 +1434,7 @@ static void cpufreq_policy_free(struct cpufreq_policy *policy)
 	freq_qos_remove_request(policy->min_freq_req);
 	kfree(policy->min_freq_req);
 
+	cpufreq_table_free_index(policy);
 	cpufreq_policy_put_kobj(policy);
 	free_cpumask_var(policy->real_cpus);
 	free_cpumask_var(policy->related_cpus);
@@ -1365,6 +1442,53 @@ static void cpufreq_policy_free(struct cpufreq_policy *policy)
 	kfree(policy);
 }
 
+/*
+ * The governor of a parked policy has not been torn down and the driver has
+ * only done its ->offline(), so only let the driver restore the hardware state
+ * with ->online() and restart the governor from the current frequency and
+ * limits.
+ */
+static int cpufreq_unpark_policy(struct cpufreq_policy *policy,
+				 unsigned int cpu)
+{
+	int ret;
+
+	down_write(&policy->rwsem);
+	policy->cpu = cpu;
+
+	if (cpufreq_driver->online) {
+		cpumask_copy(policy->cpus, policy->related_cpus);
+
+		ret = cpufreq_driver->online(policy);
+		if (ret) {
+			pr_debug("%s: %d: initialization failed\n", __func__,
+				 __LINE__);
+			cpumask_clear(policy->cpus);
+			goto unlock;
+		}
+
+		cpumask_and(policy->cpus, policy->cpus, cpu_online_mask);
+	} else {
+		cpumask_set_cpu(cpu, policy->cpus);
+	}
+
+	policy->parked = false;
+
+	/* The frequency may have been changed while the CPUs were offline. */
+	if (cpufreq_driver->get)
+		cpufreq_verify_current_freq(policy, false);
+
+	ret = cpufreq_start_governor(policy);
+	if (ret)
+		pr_err("%s: Failed to start governor\n", __func__);
+	else
+		refresh_frequency_limits(policy);
+
+unlock:
+	up_write(&policy->rwsem);
+	return ret;
+}
+
 static int cpufreq_online(unsigned int cpu)
 {
 	struct cpufreq_policy *policy;
@@ -1382,6 +1506,9 @@ static int cpufreq_online(unsigned int cpu)
 		if (!policy_is_inactive(policy))
 			return cpufreq_add_policy_cpu(policy, cpu);
 
+		if (policy->parked)
+			return cpufreq_unpark_policy(policy, cpu);
+
 		/* This is the only online CPU for the policy.  Start over. */
 		new_policy = false;
 		down_write(&policy->rwsem);
@@ -1438,6 +1565,14 @@ static int cpufreq_online(unsigned int cpu)
 	 */
 	cpumask_and(policy->cpus, policy->cpus, cpu_online_mask);
 
+	/*
+	 * Publish the limits set by the driver to the lockless readers, like
+	 * the initial frequency check below, until cpufreq_set_policy() applies
+	 * the QoS constraints.
+	 */
+	if (new_policy)
+		cpufreq_policy_set_limits(policy, policy->min, policy->max);
+
 	if (new_policy) {
 		for_each_cpu(j, policy->related_cpus) {
 			per_cpu(cpufreq_cpu_data, j) = policy;
@@ -1625,6 +1760,40 @@ static int cpufreq_add_dev(struct device *dev, struct subsys_interface *sif)
 	return 0;
 }
 
+static void cpufreq_policy_teardown(struct cpufreq_policy *policy)
+{
+	bool parked = policy->parked;
+
+	policy->parked = false;
+
+	if (has_target())
+		strncpy(policy->last_governor, policy->governor->name,
+			CPUFREQ_NAME_LEN);
+	else
+		policy->last_policy = policy->policy;
+
+	if (cpufreq_thermal_control_enabled(cpufreq_driver)) {
+		cpufreq_cooling_unregister(policy->cdev);
+		policy->cdev = NULL;
+	}
+
+	if (has_target())
+		cpufreq_exit_governor(policy);
+
+	/*
+	 * Perform the ->offline() during light-weight tear-down, as
+	 * that allows fast recovery when the CPU comes back.  It has been
+	 * done already for a parked policy.
+	 */
+	if (cpufreq_driver->offline) {
+		if (!parked)
+			cpufreq_driver->offline(policy);
+	} else if (cpufreq_driver->exit) {
+		cpufreq_driver->exit(policy);
+		policy->freq_table = NULL;
+	}
+}
+
 static void __cpufreq_offline(unsigned int cpu, struct cpufreq_policy *policy)
 {
 	int ret;
@@ -1649,30 +1818,21 @@ static void __cpufreq_offline(unsigned int cpu, struct cpufreq_policy *policy)
 		return;
 	}
 
-	if (has_target())
-		strncpy(policy->last_governor, policy->governor->name,
-			CPUFREQ_NAME_LEN);
-	else
-		policy->last_policy = policy->policy;
-
-	if (cpufreq_thermal_control_enabled(cpufreq_driver)) {
-		cpufreq_cooling_unregister(policy->cdev);
-		policy->cdev = NULL;
-	}
-
-	if (has_target())
-		cpufreq_exit_governor(policy);
-
 	/*
-	 * Perform the ->offline() during light-weight tear-down, as
-	 * that allows fast recovery when the CPU comes back.
+	 * The governor has been stopped already, keep it and the cooling
+	 * device around so that the policy can be restarted quickly when a
+	 * CPU comes back.  The driver still has to let go of the hardware,
+	 * ->online() is called for it again when the policy is unparked.
 	 */
-	if (cpufreq_driver->offline) {
-		cpufreq_driver->offline(policy);
-	} else if (cpufreq_driver->exit) {
-		cpufreq_driver->exit(policy);
-		policy->freq_table = NULL;
+	if (park_offline && has_target()) {
+		if (cpufreq_driver->offline)
+			cpufreq_driver->offline(policy);
+
+		policy->parked = true;
+		return;
 	}
+
+	cpufreq_policy_teardown(policy);
 }
 
 static int cpufreq_offline(unsigned int cpu)
@@ -1713,6 +1873,9 @@ static void cpufreq_remove_dev(struct device *dev, struct subsys_interface *sif)
 	if (cpu_online(cpu))
 		__cpufreq_offline(cpu, policy);
 
+	if (policy->parked)
+		cpufreq_policy_teardown(policy);
+
 	remove_cpu_dev_symlink(policy, cpu, dev);
 
 	if (!cpumask_empty(policy->real_cpus)) {
@@ -2137,6 +2300,26 @@ EXPORT_SYMBOL(cpufreq_unregister_notifier);
  *                              GOVERNORS                            *
  *********************************************************************/
 
+/*
+ * Account for a successful invocation of the driver's frequency change
+ * callback that started at @start.  Only the driver's own work is measured,
+ * not the transition notifiers.
+ */
+static void cpufreq_record_latency(struct cpufreq_policy *policy, u64 start)
+{
+	u64 delta = local_clock() - start;
+	unsigned int avg = policy->transition_latency_avg;
+
+	delta = min_t(u64, delta, UINT_MAX);
+	if (avg)
+		avg = avg - (avg >> 3) + ((unsigned int)delta >> 3);
+	else
+		avg = delta;
+
+	WRITE_ONCE(policy->transition_latency_avg, max(avg, 1U));
+	cpufreq_stats_record_latency(policy, delta);
+}
+
 /**
  * cpufreq_driver_fast_switch - Carry out a fast CPU frequency switch.
  * @policy: cpufreq policy to switch the frequency for.
@@ -2163,15 +2346,19 @@ EXPORT_SYMBOL(cpufreq_unregister_notifier);
 unsigned int cpufreq_driver_fast_switch(struct cpufreq_policy *policy,
 					unsigned int target_freq)
 {
-	unsigned int freq;
+	unsigned int freq, min, max;
+	u64 start;
 	int cpu;
 
-	target_freq = clamp_val(target_freq, policy->min, policy->max);
+	cpufreq_policy_fast_limits(policy, &min, &max);
+	target_freq = clamp_val(target_freq, min, max);
+	start = local_clock();
 	freq = cpufreq_driver->fast_switch(policy, target_freq);
 
 	if (!freq)
 		return 0;
 
+	cpufreq_record_latency(policy, start);
 	policy->cur = freq;
 	arch_set_freq_scale(policy->related_cpus, freq,
 			    policy->cpuinfo.max_freq);
@@ -2259,6 +2446,7 @@ static int __target_index(struct cpufreq_policy *policy, int index)
 	unsigned int newfreq = policy->freq_table[index].frequency;
 	int retval = -EINVAL;
 	bool notify;
+	u64 start;
 
 	if (newfreq == policy->cur)
 		return 0;
@@ -2287,10 +2475,13 @@ static int __target_index(struct cpufreq_policy *policy, int index)
 		cpufreq_freq_transition_begin(policy, &freqs);
 	}
 
+	start = local_clock();
 	retval = cpufreq_driver->target_index(policy, index);
 	if (retval)
 		pr_err("%s: Failed to change cpu frequency: %d\n", __func__,
 		       retval);
+	else
+		cpufreq_record_latency(policy, start);
 
 	if (notify) {
 		cpufreq_freq_transition_end(policy, &freqs, retval);
@@ -2611,11 +2802,16 @@ static int cpufreq_set_policy(struct cpufreq_policy *policy,
 	 * Resolve policy min/max to available frequencies. It ensures
 	 * no frequency resolution will neither overshoot the requested maximum
 	 * nor undershoot the requested minimum.
+	 *
+	 * The new limits are passed to the frequency table lookup, so that
+	 * policy->min and policy->max are only updated once, with the resolved
+	 * values, and the fast switch path never sees the unresolved ones.
 	 */
-	policy->min = new_data.min;
-	policy->max = new_data.max;
-	policy->min = __resolve_freq(policy, policy->min, CPUFREQ_RELATION_L);
-	policy->max = __resolve_freq(policy, policy->max, CPUFREQ_RELATION_H);
+	cpufreq_policy_set_limits(policy,
+		__resolve_freq_limits(policy, new_data.min, new_data.min,
+				      new_data.max, CPUFREQ_RELATION_L),
+		__resolve_freq_limits(policy, new_data.max, new_data.min,
+				      new_data.max, CPUFREQ_RELATION_H));
 	trace_cpu_frequency_limits(policy);
 
 	policy->cached_target_freq = UINT_MAX;
@@ -3001,5 +3197,8 @@ static int __init cpufreq_core_init(void)
 	return 0;
 }
 module_param(off, int, 0444);
+module_param(qos_notify_delay_ms, uint, 0444);
+module_param(measured_transition_delay, bool, 0644);
+module_param(park_offline, bool, 0644);
 module_param_string(default_governor, default_governor, CPUFREQ_NAME_LEN, 0444);
 core_initcall(cpufreq_core_init);
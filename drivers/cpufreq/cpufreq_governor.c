@@ -15,6 +15,7 @@
 
 #include <linux/export.h>
 #include <linux/kernel_stat.h>
+#include <linux/ktime.h>
 #include <linux/slab.h>
 
 #include "cpufreq_governor.h"
@@ -118,6 +119,7 @@ unsigned int dbs_update(struct cpufreq_policy *policy)
 	unsigned int ignore_nice = dbs_data->ignore_nice_load;
 	unsigned int max_load = 0, idle_periods = UINT_MAX;
 	unsigned int sampling_rate, io_busy, j;
+	ktime_t now;
 
 	/*
 	 * Sometimes governors may use an additional multiplier to increase
@@ -133,6 +135,9 @@ unsigned int dbs_update(struct cpufreq_policy *policy)
 	 */
 	io_busy = dbs_data->io_is_busy;
 
+	/* Sample all of the CPUs against the same timestamp. */
+	now = ktime_get();
+
 	/* Get Absolute Load */
 	for_each_cpu(j, policy->cpus) {
 		struct cpu_dbs_info *j_cdbs = &per_cpu(cpu_dbs, j);
@@ -140,7 +145,7 @@ unsigned int dbs_update(struct cpufreq_policy *policy)
 		unsigned int idle_time, time_elapsed;
 		unsigned int load;
 
-		cur_idle_time = get_cpu_idle_time(j, &update_time, io_busy);
+		cur_idle_time = get_cpu_idle_time_at(j, now, &update_time, io_busy);
 
 		time_elapsed = update_time - j_cdbs->prev_update_time;
 		j_cdbs->prev_update_time = update_time;
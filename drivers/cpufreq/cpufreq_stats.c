@@ -8,10 +8,18 @@
 
 #include <linux/cpu.h>
 #include <linux/cpufreq.h>
+#include <linux/gcd.h>
+#include <linux/log2.h>
 #include <linux/module.h>
 #include <linux/sched/clock.h>
 #include <linux/slab.h>
 
+/*
+ * Transition latencies are counted in power of two buckets of microseconds:
+ * [0, 1), [1, 2), [2, 4), ... and everything from 2^(BUCKETS - 2) onwards.
+ */
+#define CPUFREQ_STATS_LATENCY_BUCKETS	16
+
 struct cpufreq_stats {
 	unsigned int total_trans;
 	unsigned long long last_time;
@@ -21,6 +29,13 @@ struct cpufreq_stats {
 	u64 *time_in_state;
 	unsigned int *freq_table;
 	unsigned int *trans_table;
+	unsigned int latency_hist[CPUFREQ_STATS_LATENCY_BUCKETS];
+
+	/* Direct frequency to index map, if the table is regular enough */
+	int *index_map;
+	unsigned int map_base;
+	unsigned int map_step;
+	unsigned int map_size;
 
 	/* Deferred reset */
 	unsigned int reset_pending;
@@ -42,6 +57,7 @@ static void cpufreq_stats_reset_table(struct cpufreq_stats *stats)
 
 	memset(stats->time_in_state, 0, count * sizeof(u64));
 	memset(stats->trans_table, 0, count * count * sizeof(int));
+	memset(stats->latency_hist, 0, sizeof(stats->latency_hist));
 	stats->last_time = local_clock();
 	stats->total_trans = 0;
 
@@ -170,11 +186,33 @@ static ssize_t show_trans_table(struct cpufreq_policy *policy, char *buf)
 }
 cpufreq_freq_attr_ro(trans_table);
 
+static ssize_t show_latency_hist(struct cpufreq_policy *policy, char *buf)
+{
+	struct cpufreq_stats *stats = policy->stats;
+	bool pending = READ_ONCE(stats->reset_pending);
+	ssize_t len = 0;
+	int i;
+
+	for (i = 0; i < CPUFREQ_STATS_LATENCY_BUCKETS; i++) {
+		unsigned int count = pending ? 0 : stats->latency_hist[i];
+
+		if (i < CPUFREQ_STATS_LATENCY_BUCKETS - 1)
+			len += sysfs_emit_at(buf, len, "<%u us %u\n", 1U << i,
+					     count);
+		else
+			len += sysfs_emit_at(buf, len, ">=%u us %u\n",
+					     1U << (i - 1), count);
+	}
+	return len;
+}
+cpufreq_freq_attr_ro(latency_hist);
+
 static struct attribute *default_attrs[] = {
 	&total_trans.attr,
 	&time_in_state.attr,
 	&reset.attr,
 	&trans_table.attr,
+	&latency_hist.attr,
 	NULL
 };
 static const struct attribute_group stats_attr_group = {
@@ -182,9 +220,26 @@ static const struct attribute_group stats_attr_group = {
 	.name = "stats"
 };
 
+/*
+ * The index map is only used if it takes at most this many times the space of
+ * the table itself.
+ */
+#define CPUFREQ_STATS_MAP_RATIO		4
+
 static int freq_table_get_index(struct cpufreq_stats *stats, unsigned int freq)
 {
 	int index;
+
+	if (stats->index_map) {
+		unsigned int offset = freq - stats->map_base;
+
+		if (freq < stats->map_base || offset % stats->map_step)
+			return -1;
+
+		offset /= stats->map_step;
+		return offset < stats->map_size ? stats->index_map[offset] : -1;
+	}
+
 	for (index = 0; index < stats->max_state; index++)
 		if (stats->freq_table[index] == freq)
 			return index;
@@ -202,11 +257,53 @@ void cpufreq_stats_free_table(struct cpufreq_policy *policy)
 	pr_debug("%s: Free stats table\n", __func__);
 
 	sysfs_remove_group(&policy->kobj, &stats_attr_group);
+	kfree(stats->index_map);
 	kfree(stats->time_in_state);
 	kfree(stats);
 	policy->stats = NULL;
 }
 
+/*
+ * Frequency tables are usually made of evenly spaced entries, so it is
+ * possible to map a frequency to its index in constant time instead of
+ * searching the table on every transition.
+ */
+static void cpufreq_stats_create_map(struct cpufreq_stats *stats)
+{
+	unsigned int i, base = UINT_MAX, max = 0, step = 0, size;
+	int *map;
+
+	for (i = 0; i < stats->state_num; i++) {
+		base = min(base, stats->freq_table[i]);
+		max = max(max, stats->freq_table[i]);
+	}
+
+	for (i = 0; i < stats->state_num; i++)
+		step = gcd(step, stats->freq_table[i] - base);
+
+	if (!step)
+		step = 1;
+
+	size = (max - base) / step + 1;
+	if (size > CPUFREQ_STATS_MAP_RATIO * stats->state_num)
+		return;
+
+	map = kmalloc_array(size, sizeof(*map), GFP_KERNEL);
+	if (!map)
+		return;
+
+	for (i = 0; i < size; i++)
+		map[i] = -1;
+
+	for (i = 0; i < stats->state_num; i++)
+		map[(stats->freq_table[i] - base) / step] = i;
+
+	stats->map_base = base;
+	stats->map_step = step;
+	stats->map_size = size;
+	stats->index_map = map;
+}
+
 void cpufreq_stats_create_table(struct cpufreq_policy *policy)
 {
 	unsigned int i = 0, count;
@@ -248,6 +345,9 @@ void cpufreq_stats_create_table(struct cpufreq_policy *policy)
 			stats->freq_table[i++] = pos->frequency;
 
 	stats->state_num = i;
+	if (i)
+		cpufreq_stats_create_map(stats);
+
 	stats->last_time = local_clock();
 	stats->last_index = freq_table_get_index(stats, policy->cur);
 
@@ -257,6 +357,7 @@ void cpufreq_stats_create_table(struct cpufreq_policy *policy)
 
 	/* We failed, release resources */
 	policy->stats = NULL;
+	kfree(stats->index_map);
 	kfree(stats->time_in_state);
 free_stat:
 	kfree(stats);
@@ -287,3 +388,17 @@ void cpufreq_stats_record_transition(struct cpufreq_policy *policy,
 	stats->trans_table[old_index * stats->max_state + new_index]++;
 	stats->total_trans++;
 }
+
+void cpufreq_stats_record_latency(struct cpufreq_policy *policy, u64 delta_ns)
+{
+	struct cpufreq_stats *stats = policy->stats;
+	u64 us = div_u64(delta_ns, NSEC_PER_USEC);
+	unsigned int bucket;
+
+	if (unlikely(!stats))
+		return;
+
+	bucket = us ? ilog2(us) + 1 : 0;
+	bucket = min_t(unsigned int, bucket, CPUFREQ_STATS_LATENCY_BUCKETS - 1);
+	stats->latency_hist[bucket]++;
+}
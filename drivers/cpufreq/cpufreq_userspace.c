@@ -10,10 +10,14 @@
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 
 #include <linux/cpufreq.h>
+#include <linux/cpufreq_userspace.h>
+#include <linux/fs.h>
 #include <linux/init.h>
+#include <linux/miscdevice.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/slab.h>
+#include <linux/uaccess.h>
 
 static DEFINE_PER_CPU(unsigned int, cpu_is_managed);
 static DEFINE_MUTEX(userspace_mutex);
@@ -44,6 +48,129 @@ static int cpufreq_set(struct cpufreq_policy *policy, unsigned int freq)
 	return ret;
 }
 
+/*
+ * Switch the frequency directly with the driver's ->fast_switch() callback if
+ * that is possible from this CPU.  Returns -EAGAIN if it is not.
+ */
+static int cpufreq_fast_set(struct cpufreq_policy *policy, unsigned int freq)
+{
+	unsigned int *setspeed;
+	int ret = -EAGAIN;
+
+	mutex_lock(&userspace_mutex);
+	if (!per_cpu(cpu_is_managed, policy->cpu)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	if (!policy->fast_switch_enabled)
+		goto out;
+
+	preempt_disable();
+	if (policy->dvfs_possible_from_any_cpu ||
+	    cpumask_test_cpu(smp_processor_id(), policy->cpus)) {
+		/* ->fast_switch() expects a frequency the driver supports */
+		freq = cpufreq_driver_resolve_freq(policy, freq);
+		setspeed = policy->governor_data;
+		*setspeed = freq;
+		ret = cpufreq_driver_fast_switch(policy, freq) ? 0 : -EIO;
+	}
+	preempt_enable();
+
+ out:
+	mutex_unlock(&userspace_mutex);
+	return ret;
+}
+
+static int cpufreq_userspace_set_target(unsigned int cpu, unsigned int freq)
+{
+	struct cpufreq_policy *policy;
+	int ret;
+
+	/* The CPU number comes from user space */
+	if (cpu >= nr_cpu_ids)
+		return -EINVAL;
+
+	policy = cpufreq_cpu_get(cpu);
+	if (!policy)
+		return -ENODEV;
+
+	ret = cpufreq_fast_set(policy, freq);
+	if (ret == -EAGAIN) {
+		/* Same as writing to scaling_setspeed */
+		down_write(&policy->rwsem);
+		ret = cpufreq_set(policy, freq);
+		up_write(&policy->rwsem);
+	}
+
+	cpufreq_cpu_put(policy);
+	return ret;
+}
+
+#define CPUFREQ_USERSPACE_BATCH	16
+
+static long cpufreq_userspace_set_speeds(struct cpufreq_userspace_targets __user *arg)
+{
+	struct cpufreq_userspace_target batch[CPUFREQ_USERSPACE_BATCH];
+	struct cpufreq_userspace_target __user *targets;
+	struct cpufreq_userspace_targets t;
+	unsigned int i, n, done = 0;
+	int ret = 0;
+
+	if (copy_from_user(&t, arg, sizeof(t)))
+		return -EFAULT;
+
+	if (t.flags || t.nr > nr_cpu_ids)
+		return -EINVAL;
+
+	targets = u64_to_user_ptr(t.targets);
+
+	while (done < t.nr) {
+		n = min_t(unsigned int, t.nr - done, CPUFREQ_USERSPACE_BATCH);
+		if (copy_from_user(batch, targets + done, n * sizeof(batch[0]))) {
+			ret = -EFAULT;
+			break;
+		}
+
+		for (i = 0; i < n; i++) {
+			ret = cpufreq_userspace_set_target(batch[i].cpu,
+							   batch[i].freq);
+			if (ret)
+				break;
+		}
+
+		done += i;
+		if (ret)
+			break;
+	}
+
+	return done ? done : ret;
+}
+
+static long cpufreq_userspace_ioctl(struct file *filp, unsigned int cmd,
+				    unsigned long arg)
+{
+	switch (cmd) {
+	case CPUFREQ_USERSPACE_SET_SPEEDS:
+		return cpufreq_userspace_set_speeds((void __user *)arg);
+	default:
+		return -ENOTTY;
+	}
+}
+
+static const struct file_operations cpufreq_userspace_fops = {
+	.owner = THIS_MODULE,
+	.unlocked_ioctl = cpufreq_userspace_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
+	.llseek = noop_llseek,
+};
+
+static struct miscdevice cpufreq_userspace_miscdev = {
+	.minor = MISC_DYNAMIC_MINOR,
+	.name = "cpufreq_userspace",
+	.fops = &cpufreq_userspace_fops,
+};
+
 static ssize_t show_speed(struct cpufreq_policy *policy, char *buf)
 {
 	return sprintf(buf, "%u\n", policy->cur);
@@ -58,11 +185,14 @@ static int cpufreq_userspace_policy_init(struct cpufreq_policy *policy)
 		return -ENOMEM;
 
 	policy->governor_data = setspeed;
+	cpufreq_enable_fast_switch(policy);
 	return 0;
 }
 
 static void cpufreq_userspace_policy_exit(struct cpufreq_policy *policy)
 {
+	cpufreq_disable_fast_switch(policy);
+
 	mutex_lock(&userspace_mutex);
 	kfree(policy->governor_data);
 	policy->governor_data = NULL;
@@ -138,5 +268,49 @@ struct cpufreq_governor *cpufreq_default_governor(void)
 }
 #endif
 
-cpufreq_governor_init(cpufreq_gov_userspace);
-cpufreq_governor_exit(cpufreq_gov_userspace);
+static bool cpufreq_userspace_dev_registered;
+
+static void cpufreq_userspace_register_dev(void)
+{
+	int ret;
+
+	ret = misc_register(&cpufreq_userspace_miscdev);
+	if (ret)
+		pr_warn("unable to register %s: %d\n",
+			cpufreq_userspace_miscdev.name, ret);
+	else
+		cpufreq_userspace_dev_registered = true;
+}
+
+static int __init cpufreq_gov_userspace_init(void)
+{
+	int ret;
+
+	ret = cpufreq_register_governor(&cpufreq_gov_userspace);
+	if (ret)
+		return ret;
+
+	if (IS_MODULE(CONFIG_CPU_FREQ_GOV_USERSPACE))
+		cpufreq_userspace_register_dev();
+
+	return 0;
+}
+core_initcall(cpufreq_gov_userspace_init);
+
+#ifndef MODULE
+/* The governor is registered before the misc class exists */
+static int __init cpufreq_userspace_dev_init(void)
+{
+	cpufreq_userspace_register_dev();
+	return 0;
+}
+device_initcall(cpufreq_userspace_dev_init);
+#endif
+
+static void __exit cpufreq_gov_userspace_exit(void)
+{
+	if (cpufreq_userspace_dev_registered)
+		misc_deregister(&cpufreq_userspace_miscdev);
+	cpufreq_unregister_governor(&cpufreq_gov_userspace);
+}
+module_exit(cpufreq_gov_userspace_exit);
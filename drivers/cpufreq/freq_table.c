@@ -9,6 +9,23 @@
 
 #include <linux/cpufreq.h>
 #include <linux/module.h>
+#include <linux/overflow.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+
+/*
+ * Valid entries of an unsorted frequency table in ascending frequency order,
+ * so that it can be searched in logarithmic time.
+ */
+struct cpufreq_freq_index_entry {
+	unsigned int frequency;
+	unsigned int idx;
+};
+
+struct cpufreq_freq_index {
+	unsigned int count;
+	struct cpufreq_freq_index_entry entries[];
+};
 
 /*********************************************************************
  *                     FREQUENCY TABLE HELPERS                       *
@@ -115,9 +132,72 @@ int cpufreq_generic_frequency_table_verify(struct cpufreq_policy_data *policy)
 }
 EXPORT_SYMBOL_GPL(cpufreq_generic_frequency_table_verify);
 
+/*
+ * Return the position of the first entry at or above @freq, or strictly above
+ * it if @above is set.
+ */
+static unsigned int cpufreq_freq_index_bound(struct cpufreq_freq_index *fi,
+					     unsigned int freq, bool above)
+{
+	unsigned int lo = 0, hi = fi->count;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		unsigned int f = fi->entries[mid].frequency;
+
+		if (f < freq || (above && f == freq))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static int cpufreq_freq_index_lookup(struct cpufreq_policy *policy,
+				     unsigned int target_freq,
+				     unsigned int min, unsigned int max,
+				     unsigned int relation)
+{
+	struct cpufreq_freq_index *fi = policy->freq_index;
+	unsigned int first, end, pos;
+
+	/* Entries within the policy limits are at [first, end). */
+	first = cpufreq_freq_index_bound(fi, min, false);
+	end = cpufreq_freq_index_bound(fi, max, true);
+	if (first >= end) {
+		WARN(1, "Invalid frequency table: %d\n", policy->cpu);
+		return 0;
+	}
+
+	pos = clamp(cpufreq_freq_index_bound(fi, target_freq, false), first, end);
+	if (pos < end && fi->entries[pos].frequency == target_freq)
+		return fi->entries[pos].idx;
+
+	switch (relation) {
+	case CPUFREQ_RELATION_H:
+		if (pos > first)
+			pos--;
+		break;
+	case CPUFREQ_RELATION_L:
+		if (pos == end)
+			pos--;
+		break;
+	case CPUFREQ_RELATION_C:
+		/* Prefer the higher frequency if both are equally close. */
+		if (pos == end ||
+		    (pos > first && target_freq - fi->entries[pos - 1].frequency <
+				    fi->entries[pos].frequency - target_freq))
+			pos--;
+		break;
+	}
+
+	return fi->entries[pos].idx;
+}
+
 int cpufreq_table_index_unsorted(struct cpufreq_policy *policy,
-				 unsigned int target_freq,
-				 unsigned int relation)
+				 unsigned int target_freq, unsigned int min,
+				 unsigned int max, unsigned int relation)
 {
 	struct cpufreq_frequency_table optimal = {
 		.driver_data = ~0,
@@ -135,6 +215,10 @@ int cpufreq_table_index_unsorted(struct cpufreq_policy *policy,
 	pr_debug("request for target %u kHz (relation: %u) for cpu %u\n",
 					target_freq, relation, policy->cpu);
 
+	if (policy->freq_index)
+		return cpufreq_freq_index_lookup(policy, target_freq, min, max,
+						 relation);
+
 	switch (relation) {
 	case CPUFREQ_RELATION_H:
 		suboptimal.frequency = ~0;
@@ -148,7 +232,7 @@ int cpufreq_table_index_unsorted(struct cpufreq_policy *policy,
 	cpufreq_for_each_valid_entry_idx(pos, table, i) {
 		freq = pos->frequency;
 
-		if ((freq < policy->min) || (freq > policy->max))
+		if ((freq < min) || (freq > max))
 			continue;
 		if (freq == target_freq) {
 			optimal.driver_data = i;
@@ -351,6 +435,56 @@ static int set_freq_table_sorted(struct cpufreq_policy *policy)
 	return 0;
 }
 
+static int cpufreq_freq_index_cmp(const void *a, const void *b)
+{
+	const struct cpufreq_freq_index_entry *x = a, *y = b;
+
+	if (x->frequency != y->frequency)
+		return x->frequency < y->frequency ? -1 : 1;
+
+	return x->idx < y->idx ? -1 : x->idx > y->idx;
+}
+
+static void set_freq_table_index(struct cpufreq_policy *policy)
+{
+	struct cpufreq_frequency_table *pos, *table = policy->freq_table;
+	struct cpufreq_freq_index *fi;
+	unsigned int count;
+	int idx;
+
+	cpufreq_table_free_index(policy);
+
+	if (policy->freq_table_sorted != CPUFREQ_TABLE_UNSORTED)
+		return;
+
+	count = cpufreq_table_count_valid_entries(policy);
+	if (!count)
+		return;
+
+	/* Fall back to the linear search if this fails. */
+	fi = kmalloc(struct_size(fi, entries, count), GFP_KERNEL);
+	if (!fi)
+		return;
+
+	fi->count = 0;
+	cpufreq_for_each_valid_entry_idx(pos, table, idx) {
+		fi->entries[fi->count].frequency = pos->frequency;
+		fi->entries[fi->count].idx = idx;
+		fi->count++;
+	}
+
+	sort(fi->entries, fi->count, sizeof(fi->entries[0]),
+	     cpufreq_freq_index_cmp, NULL);
+
+	policy->freq_index = fi;
+}
+
+void cpufreq_table_free_index(struct cpufreq_policy *policy)
+{
+	kfree(policy->freq_index);
+	policy->freq_index = NULL;
+}
+
 int cpufreq_table_validate_and_sort(struct cpufreq_policy *policy)
 {
 	int ret;
@@ -367,7 +501,12 @@ int cpufreq_table_validate_and_sort(struct cpufreq_policy *policy)
 	if (ret)
 		return ret;
 
-	return set_freq_table_sorted(policy);
+	ret = set_freq_table_sorted(policy);
+	if (ret)
+		return ret;
+
+	set_freq_table_index(policy);
+	return 0;
 }
 
 MODULE_AUTHOR("Dominik Brodowski <linux@brodo.de>");
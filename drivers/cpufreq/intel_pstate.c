@@ -8,6 +8,7 @@
 
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 
+#include <linux/bitfield.h>
 #include <linux/kernel.h>
 #include <linux/kernel_stat.h>
 #include <linux/module.h>
@@ -25,6 +26,8 @@
 #include <linux/acpi.h>
 #include <linux/vmalloc.h>
 #include <linux/pm_qos.h>
+#include <linux/platform_profile.h>
+#include <linux/intel_hfi.h>
 #include <trace/events/power.h>
 
 #include <asm/cpu.h>
@@ -217,6 +220,11 @@ struct global_params {
  * @epp_cached		Cached HWP energy-performance preference value
  * @hwp_req_cached:	Cached value of the last HWP Request MSR
  * @hwp_cap_cached:	Cached value of the last HWP Capabilities MSR
+ * @hwp_pkg_ctl:	Whether or not the package-level HWP request is used
+ * @uncore_demand:	Last requested P-state relative to the max turbo one,
+ *			in SCHED_CAPACITY_SCALE units, for uncore following
+ * @uncore_demand_time:	Time when @uncore_demand was last updated
+ * @busy_est:		Busy fraction estimate of the "estimate" load predictor
  * @last_io_update:	Last time when IO wake flag was set
  * @sched_flags:	Store scheduler flags for possible cross CPU update
  * @hwp_boost_min:	Last HWP boosted min performance
@@ -256,6 +264,10 @@ struct cpudata {
 	s16 epp_cached;
 	u64 hwp_req_cached;
 	u64 hwp_cap_cached;
+	bool hwp_pkg_ctl;
+	unsigned int uncore_demand;
+	u64 uncore_demand_time;
+	int32_t busy_est;
 	u64 last_io_update;
 	unsigned int sched_flags;
 	u32 hwp_boost_min;
@@ -298,9 +310,13 @@ static int hwp_active __read_mostly;
 static int hwp_mode_bdw __read_mostly;
 static bool per_cpu_limits __read_mostly;
 static bool hwp_boost __read_mostly;
+/* hwp_dynamic_boost = 2: only boost for tasks with a non-zero uclamp min */
+static bool hwp_boost_uclamp __read_mostly;
 static bool hwp_forced __read_mostly;
+static bool hwp_pkg_req __read_mostly;
 
 static struct cpufreq_driver *intel_pstate_driver __read_mostly;
+static struct cpufreq_driver *default_driver;
 
 #define HYBRID_SCALING_FACTOR	78741
 
@@ -315,9 +331,43 @@ static bool acpi_ppc;
 
 static struct global_params global;
 
+/*
+ * Load predictors for the P-state selection without HWP.
+ *
+ * "busy" (the default) uses the busy fraction of the last sampling interval,
+ * corrected by half of the difference to the average P-state of the interval
+ * if that was higher.
+ *
+ * "estimate" keeps a busy fraction estimate per CPU, like the utilization
+ * estimation of the scheduler: it follows increases of the busy fraction
+ * immediately and decreases with an exponentially weighted moving average
+ * (weight 1/4), so the P-state stays up between the bursts of a bursty load
+ * instead of ramping up again for each of them.
+ */
+enum intel_pstate_predictor {
+	PREDICTOR_BUSY,
+	PREDICTOR_ESTIMATE,
+};
+
+static const char * const intel_pstate_predictors[] = {
+	[PREDICTOR_BUSY] = "busy",
+	[PREDICTOR_ESTIMATE] = "estimate",
+};
+
+static int load_predictor __read_mostly = PREDICTOR_BUSY;
+
 static DEFINE_MUTEX(intel_pstate_driver_lock);
 static DEFINE_MUTEX(intel_pstate_limits_lock);
 
+/*
+ * While the limits of all policies are being updated at once, the HWP Request
+ * MSR writes are deferred and collected in hwp_batch_cpus, so they can be
+ * carried out by one IPI broadcast, instead of a read and a write IPI for
+ * every CPU.  Both are protected by intel_pstate_limits_lock.
+ */
+static bool hwp_batch;
+static struct cpumask hwp_batch_cpus;
+
 #ifdef CONFIG_ACPI
 
 static bool intel_pstate_acpi_pm_profile_server(void)
@@ -371,8 +421,12 @@ static void intel_pstate_set_itmt_prio(int cpu)
 	 * The priorities can be set regardless of whether or not
 	 * sched_set_itmt_support(true) has been called and it is valid to
 	 * update them at any time after it has been called.
+	 *
+	 * If they are updated from the HFI, do not clobber them with the
+	 * static values.
 	 */
-	sched_set_itmt_core_prio(cppc_perf.highest_perf, cpu);
+	if (!intel_hfi_sets_itmt_prio())
+		sched_set_itmt_core_prio(cppc_perf.highest_perf, cpu);
 
 	if (max_highest_perf <= min_highest_perf) {
 		if (cppc_perf.highest_perf > max_highest_perf)
@@ -735,6 +789,7 @@ static int intel_pstate_set_epp(struct cpudata *cpu, u32 epp)
 	 * function, so it cannot run in parallel with the update below.
 	 */
 	WRITE_ONCE(cpu->hwp_req_cached, value);
+	cpu->hwp_pkg_ctl = false;
 	ret = wrmsrl_on_cpu(cpu->cpu, MSR_HWP_REQUEST, value);
 	if (!ret)
 		cpu->epp_cached = epp;
@@ -880,6 +935,64 @@ static ssize_t show_energy_performance_preference(
 
 cpufreq_freq_attr_rw(energy_performance_preference);
 
+/*
+ * With intel_pstate=profile_epp, the energy-performance preference of all CPUs
+ * follows the platform profile in the active mode, so that selecting a profile
+ * takes effect in the firmware and in the processor at the same time.
+ */
+static const int profile_epp_index[PLATFORM_PROFILE_LAST] = {
+	[PLATFORM_PROFILE_LOW_POWER] = EPP_INDEX_POWERSAVE,
+	[PLATFORM_PROFILE_COOL] = EPP_INDEX_BALANCE_POWERSAVE,
+	[PLATFORM_PROFILE_QUIET] = EPP_INDEX_BALANCE_POWERSAVE,
+	[PLATFORM_PROFILE_BALANCED] = EPP_INDEX_DEFAULT,
+	[PLATFORM_PROFILE_BALANCED_PERFORMANCE] = EPP_INDEX_BALANCE_PERFORMANCE,
+	[PLATFORM_PROFILE_PERFORMANCE] = EPP_INDEX_PERFORMANCE,
+};
+
+static bool profile_epp __initdata;
+
+static int intel_pstate_profile_notify(struct notifier_block *nb,
+				       unsigned long profile, void *data)
+{
+	unsigned int cpu;
+	int index;
+
+	if (profile >= PLATFORM_PROFILE_LAST)
+		return NOTIFY_DONE;
+
+	/* There is no power-on default EPB value to go back to. */
+	index = profile_epp_index[profile];
+	if (!hwp_active && index == EPP_INDEX_DEFAULT)
+		index = EPP_INDEX_BALANCE_PERFORMANCE;
+
+	mutex_lock(&intel_pstate_driver_lock);
+
+	if (intel_pstate_driver != &intel_pstate)
+		goto out;
+
+	mutex_lock(&intel_pstate_limits_lock);
+
+	for_each_online_cpu(cpu) {
+		struct cpudata *cpudata = all_cpu_data[cpu];
+
+		/* The "performance" policy overrides the EPP anyway. */
+		if (cpudata)
+			intel_pstate_set_energy_pref_index(cpudata, index,
+							   false, 0);
+	}
+
+	mutex_unlock(&intel_pstate_limits_lock);
+
+out:
+	mutex_unlock(&intel_pstate_driver_lock);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block intel_pstate_profile_nb = {
+	.notifier_call = intel_pstate_profile_notify,
+};
+
 static ssize_t show_base_frequency(struct cpufreq_policy *policy, char *buf)
 {
 	struct cpudata *cpu = all_cpu_data[policy->cpu];
@@ -950,7 +1063,20 @@ static void intel_pstate_hwp_set(unsigned int cpu)
 	if (cpu_data->policy == CPUFREQ_POLICY_PERFORMANCE)
 		min = max;
 
-	rdmsrl_on_cpu(cpu, MSR_HWP_REQUEST, &value);
+	/*
+	 * In the batch mode, start from the cached value to avoid the MSR read,
+	 * which is only possible if nothing else needs to be read from the
+	 * target CPU below.
+	 */
+	value = READ_ONCE(cpu_data->hwp_req_cached);
+	if (!hwp_batch || !value || !boot_cpu_has(X86_FEATURE_HWP_EPP))
+		rdmsrl_on_cpu(cpu, MSR_HWP_REQUEST, &value);
+	else
+		cpumask_set_cpu(cpu, &hwp_batch_cpus);
+
+	/* The package control bit is only set on the way to the register. */
+	if (hwp_pkg_req)
+		value &= ~HWP_PACKAGE_CONTROL(1);
 
 	value &= ~HWP_MIN_PERF(~0L);
 	value |= HWP_MIN_PERF(min);
@@ -997,7 +1123,105 @@ static void intel_pstate_hwp_set(unsigned int cpu)
 	}
 skip_epp:
 	WRITE_ONCE(cpu_data->hwp_req_cached, value);
-	wrmsrl_on_cpu(cpu, MSR_HWP_REQUEST, value);
+	if (!cpumask_test_cpu(cpu, &hwp_batch_cpus)) {
+		cpu_data->hwp_pkg_ctl = false;
+		wrmsrl_on_cpu(cpu, MSR_HWP_REQUEST, value);
+	}
+}
+
+static void intel_pstate_hwp_batch_begin(void)
+{
+	if (!hwp_active)
+		return;
+
+	mutex_lock(&intel_pstate_limits_lock);
+	hwp_batch = true;
+	mutex_unlock(&intel_pstate_limits_lock);
+}
+
+static void intel_pstate_hwp_batch_write(void *unused)
+{
+	struct cpudata *cpu = all_cpu_data[smp_processor_id()];
+	u64 value = READ_ONCE(cpu->hwp_req_cached);
+
+	if (cpu->hwp_pkg_ctl)
+		value |= HWP_PACKAGE_CONTROL(1);
+
+	wrmsrl(MSR_HWP_REQUEST, value);
+}
+
+/*
+ * If all of the online CPUs in a package are about to get the same HWP
+ * request, write it to the package-level request MSR once and make the CPUs
+ * use it.  The CPUs that already do that need not be written to at all.
+ *
+ * Any per-CPU update of the HWP Request MSR clears the package control bit,
+ * so dynamic HWP boost, which does that from the scheduler context, cannot
+ * be used along with this.
+ */
+static void intel_pstate_hwp_batch_pkg(void)
+{
+	unsigned int cpu, sibling;
+
+	for_each_cpu(cpu, &hwp_batch_cpus) {
+		const struct cpumask *pkg = topology_core_cpumask(cpu);
+		u64 value = READ_ONCE(all_cpu_data[cpu]->hwp_req_cached);
+		bool shared = cpumask_subset(pkg, &hwp_batch_cpus);
+
+		/* Handle every package once, from its first pending CPU. */
+		if (cpu != cpumask_first_and(pkg, &hwp_batch_cpus))
+			continue;
+
+		for_each_cpu(sibling, pkg) {
+			if (!shared)
+				break;
+
+			if (READ_ONCE(all_cpu_data[sibling]->hwp_req_cached) != value)
+				shared = false;
+		}
+
+		if (shared && wrmsrl_on_cpu(cpu, MSR_HWP_REQUEST_PKG, value))
+			shared = false;
+
+		for_each_cpu_and(sibling, pkg, &hwp_batch_cpus) {
+			struct cpudata *cpudata = all_cpu_data[sibling];
+
+			if (shared && cpudata->hwp_pkg_ctl)
+				cpumask_clear_cpu(sibling, &hwp_batch_cpus);
+
+			cpudata->hwp_pkg_ctl = shared;
+		}
+	}
+}
+
+static void intel_pstate_hwp_batch_end(void)
+{
+	if (!hwp_active)
+		return;
+
+	mutex_lock(&intel_pstate_limits_lock);
+
+	hwp_batch = false;
+
+	if (hwp_pkg_req && !hwp_boost) {
+		intel_pstate_hwp_batch_pkg();
+	} else {
+		unsigned int cpu;
+
+		/* Make the CPUs go back to using their own requests. */
+		for_each_cpu(cpu, &hwp_batch_cpus)
+			all_cpu_data[cpu]->hwp_pkg_ctl = false;
+	}
+
+	/*
+	 * The cached values are read on the target CPUs, so updates made after
+	 * dropping the lock are not lost.  Offline CPUs will restore theirs
+	 * from the cache when they come back online.
+	 */
+	on_each_cpu_mask(&hwp_batch_cpus, intel_pstate_hwp_batch_write, NULL, true);
+	cpumask_clear(&hwp_batch_cpus);
+
+	mutex_unlock(&intel_pstate_limits_lock);
 }
 
 static void intel_pstate_disable_hwp_interrupt(struct cpudata *cpudata);
@@ -1044,6 +1268,7 @@ static void intel_pstate_hwp_offline(struct cpudata *cpu)
 	if (boot_cpu_has(X86_FEATURE_HWP_EPP))
 		value |= HWP_ENERGY_PERF_PREFERENCE(HWP_EPP_POWERSAVE);
 
+	cpu->hwp_pkg_ctl = false;
 	wrmsrl_on_cpu(cpu->cpu, MSR_HWP_REQUEST, value);
 }
 
@@ -1074,6 +1299,7 @@ static void intel_pstate_hwp_enable(struct cpudata *cpudata);
 static void intel_pstate_hwp_reenable(struct cpudata *cpu)
 {
 	intel_pstate_hwp_enable(cpu);
+	cpu->hwp_pkg_ctl = false;
 	wrmsrl_on_cpu(cpu->cpu, MSR_HWP_REQUEST, READ_ONCE(cpu->hwp_req_cached));
 }
 
@@ -1121,8 +1347,12 @@ static void intel_pstate_update_policies(void)
 {
 	int cpu;
 
+	intel_pstate_hwp_batch_begin();
+
 	for_each_possible_cpu(cpu)
 		cpufreq_update_policy(cpu);
+
+	intel_pstate_hwp_batch_end();
 }
 
 static void __intel_pstate_update_max_freq(struct cpudata *cpudata,
@@ -1157,8 +1387,10 @@ static void intel_pstate_update_limits(unsigned int cpu)
 	if (global.turbo_disabled_mf != global.turbo_disabled) {
 		global.turbo_disabled_mf = global.turbo_disabled;
 		arch_set_max_freq_ratio(global.turbo_disabled);
+		intel_pstate_hwp_batch_begin();
 		for_each_possible_cpu(cpu)
 			intel_pstate_update_max_freq(cpu);
+		intel_pstate_hwp_batch_end();
 	} else {
 		cpufreq_update_policy(cpu);
 	}
@@ -1166,6 +1398,211 @@ static void intel_pstate_update_limits(unsigned int cpu)
 	mutex_unlock(&intel_pstate_driver_lock);
 }
 
+/*
+ * Uncore frequency following.
+ *
+ * If enabled, the uncore ratio limits of every die follow the P-states
+ * requested for its cores: the max limit moves between the min and max limits
+ * found when following was enabled, in proportion to the highest P-state
+ * request in the die, so the power budget is not spent on the uncore while
+ * the cores run slowly.  If the architecture tells that the most demanding
+ * core is stalled on memory (see arch_scale_freq_sensitivity()), the min
+ * limit is raised to the max one as well, so its memory accesses do not wait
+ * for the uncore to ramp up.
+ *
+ * That only works where intel_pstate selects the P-states, i.e. not in the
+ * active mode with HWP, and the MSR is updated on a CPU of the die from the
+ * scheduler context, at most every UNCORE_FOLLOW_INTERVAL_NS.  The request
+ * of a CPU that has not updated it for UNCORE_DEMAND_STALE_NS, most likely
+ * because it is idle, is not taken into account.  The uncore frequency driver
+ * must not be used at the same time.
+ */
+#define MSR_UNCORE_RATIO_LIMIT		0x620
+#define UNCORE_MAX_RATIO_MASK		GENMASK_ULL(6, 0)
+#define UNCORE_MIN_RATIO_MASK		GENMASK_ULL(14, 8)
+#define UNCORE_FOLLOW_INTERVAL_NS	(10 * NSEC_PER_MSEC)
+#define UNCORE_DEMAND_STALE_NS		(4 * UNCORE_FOLLOW_INTERVAL_NS)
+
+struct uncore_die {
+	raw_spinlock_t lock;
+	u64 last_update;
+	u64 orig;
+	u64 cur;
+	unsigned int min_ratio;
+	unsigned int max_ratio;
+	bool valid;
+};
+
+static struct uncore_die *uncore_dies;
+static bool uncore_follow __read_mostly;
+
+static bool intel_pstate_uncore_supported(void)
+{
+	u64 val;
+
+	return !rdmsrl_safe(MSR_UNCORE_RATIO_LIMIT, &val) &&
+	       (val & UNCORE_MAX_RATIO_MASK);
+}
+
+static bool intel_pstate_uncore_follow_allowed(void)
+{
+	/* With HWP in the active mode, the requested P-states are not known */
+	return !hwp_active || intel_pstate_driver != &intel_pstate;
+}
+
+/*
+ * Return the highest recent uncore_demand in the die of @cpu and whether the
+ * CPU that has it is memory bound.
+ */
+static unsigned int intel_pstate_uncore_die_demand(int cpu, u64 now,
+						    bool *mem_bound)
+{
+	unsigned int demand = 0, sibling;
+	int top = cpu;
+
+	for_each_cpu(sibling, topology_die_cpumask(cpu)) {
+		struct cpudata *cpudata = all_cpu_data[sibling];
+		unsigned int d;
+
+		if (!cpudata)
+			continue;
+
+		if (now - READ_ONCE(cpudata->uncore_demand_time) >
+		    UNCORE_DEMAND_STALE_NS)
+			continue;
+
+		d = READ_ONCE(cpudata->uncore_demand);
+		if (d > demand) {
+			demand = d;
+			top = sibling;
+		}
+	}
+
+#ifdef arch_scale_freq_sensitivity
+	*mem_bound = demand &&
+		     arch_scale_freq_sensitivity(top) < SCHED_CAPACITY_SCALE / 2;
+#else
+	*mem_bound = false;
+#endif
+	return demand;
+}
+
+static void intel_pstate_uncore_follow(struct cpudata *cpu, int pstate,
+				       bool local)
+{
+	struct uncore_die *die;
+	unsigned int demand, max_ratio, min_ratio;
+	bool mem_bound;
+	u64 now, val;
+
+	if (!READ_ONCE(uncore_follow))
+		return;
+
+	now = ktime_get_ns();
+	WRITE_ONCE(cpu->uncore_demand,
+		   div_u64((u64)pstate * SCHED_CAPACITY_SCALE,
+			   cpu->pstate.turbo_pstate));
+	WRITE_ONCE(cpu->uncore_demand_time, now);
+
+	/* Only write the MSR from a CPU of the die */
+	if (!local)
+		return;
+
+	die = &uncore_dies[topology_logical_die_id(cpu->cpu)];
+	if (!die->valid || !raw_spin_trylock(&die->lock))
+		return;
+
+	if (now - die->last_update < UNCORE_FOLLOW_INTERVAL_NS)
+		goto unlock;
+
+	die->last_update = now;
+
+	demand = min_t(unsigned int, SCHED_CAPACITY_SCALE,
+		       intel_pstate_uncore_die_demand(cpu->cpu, now,
+						      &mem_bound));
+	max_ratio = die->min_ratio +
+		    DIV_ROUND_UP((die->max_ratio - die->min_ratio) * demand,
+				 SCHED_CAPACITY_SCALE);
+	min_ratio = mem_bound ? max_ratio : die->min_ratio;
+
+	val = die->orig & ~(UNCORE_MAX_RATIO_MASK | UNCORE_MIN_RATIO_MASK);
+	val |= FIELD_PREP(UNCORE_MAX_RATIO_MASK, max_ratio) |
+	       FIELD_PREP(UNCORE_MIN_RATIO_MASK, min_ratio);
+	if (val != die->cur) {
+		die->cur = val;
+		wrmsrl(MSR_UNCORE_RATIO_LIMIT, val);
+	}
+
+unlock:
+	raw_spin_unlock(&die->lock);
+}
+
+/* Called with intel_pstate_driver_lock held */
+static int intel_pstate_uncore_follow_enable(void)
+{
+	int nr_dies = topology_max_packages() * topology_max_die_per_package();
+	unsigned int cpu;
+
+	if (!uncore_dies) {
+		uncore_dies = kcalloc(nr_dies, sizeof(*uncore_dies), GFP_KERNEL);
+		if (!uncore_dies)
+			return -ENOMEM;
+	}
+
+	cpus_read_lock();
+	for_each_online_cpu(cpu) {
+		int id = topology_logical_die_id(cpu);
+		struct uncore_die *die;
+		u64 val;
+
+		if (id < 0 || id >= nr_dies)
+			continue;
+
+		die = &uncore_dies[id];
+		if (die->valid || rdmsrl_on_cpu(cpu, MSR_UNCORE_RATIO_LIMIT, &val))
+			continue;
+
+		raw_spin_lock_init(&die->lock);
+		die->orig = val;
+		die->cur = val;
+		die->max_ratio = FIELD_GET(UNCORE_MAX_RATIO_MASK, val);
+		die->min_ratio = min_t(unsigned int, die->max_ratio,
+				       FIELD_GET(UNCORE_MIN_RATIO_MASK, val));
+		die->last_update = 0;
+		die->valid = die->max_ratio > 0;
+	}
+	cpus_read_unlock();
+
+	/* Publish the die data before the scheduler callbacks can use it */
+	smp_store_release(&uncore_follow, true);
+	return 0;
+}
+
+/* Called with intel_pstate_driver_lock held */
+static void intel_pstate_uncore_follow_disable(void)
+{
+	int nr_dies = topology_max_packages() * topology_max_die_per_package();
+	unsigned int cpu;
+
+	WRITE_ONCE(uncore_follow, false);
+	/* Wait for the scheduler callbacks that may still be updating the MSR */
+	synchronize_rcu();
+
+	cpus_read_lock();
+	for_each_online_cpu(cpu) {
+		int id = topology_logical_die_id(cpu);
+		struct uncore_die *die;
+
+		if (id < 0 || id >= nr_dies || !uncore_dies[id].valid)
+			continue;
+
+		die = &uncore_dies[id];
+		wrmsrl_on_cpu(cpu, MSR_UNCORE_RATIO_LIMIT, die->orig);
+		die->valid = false;
+	}
+	cpus_read_unlock();
+}
+
 /************************** sysfs begin ************************/
 #define show_one(file_name, object)					\
 	static ssize_t show_##file_name					\
@@ -1424,10 +1861,39 @@ static ssize_t store_min_perf_pct(struct kobject *a, struct kobj_attribute *b,
 	return count;
 }
 
+static ssize_t show_uncore_follow(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", uncore_follow);
+}
+
+static ssize_t store_uncore_follow(struct kobject *a,
+				   struct kobj_attribute *b,
+				   const char *buf, size_t count)
+{
+	bool input;
+	int ret;
+
+	ret = kstrtobool(buf, &input);
+	if (ret)
+		return ret;
+
+	mutex_lock(&intel_pstate_driver_lock);
+	if (input && !uncore_follow && !intel_pstate_uncore_follow_allowed())
+		ret = -EOPNOTSUPP;
+	else if (input && !uncore_follow)
+		ret = intel_pstate_uncore_follow_enable();
+	else if (!input && uncore_follow)
+		intel_pstate_uncore_follow_disable();
+	mutex_unlock(&intel_pstate_driver_lock);
+
+	return ret ?: count;
+}
+
 static ssize_t show_hwp_dynamic_boost(struct kobject *kobj,
 				struct kobj_attribute *attr, char *buf)
 {
-	return sprintf(buf, "%u\n", hwp_boost);
+	return sprintf(buf, "%u\n", hwp_boost_uclamp ? 2 : hwp_boost);
 }
 
 static ssize_t store_hwp_dynamic_boost(struct kobject *a,
@@ -1443,6 +1909,7 @@ static ssize_t store_hwp_dynamic_boost(struct kobject *a,
 
 	mutex_lock(&intel_pstate_driver_lock);
 	hwp_boost = !!input;
+	WRITE_ONCE(hwp_boost_uclamp, input == 2);
 	intel_pstate_update_policies();
 	mutex_unlock(&intel_pstate_driver_lock);
 
@@ -1475,6 +1942,26 @@ static ssize_t store_energy_efficiency(struct kobject *a, struct kobj_attribute
 	return count;
 }
 
+static ssize_t show_load_predictor(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%s\n", intel_pstate_predictors[load_predictor]);
+}
+
+static ssize_t store_load_predictor(struct kobject *a, struct kobj_attribute *b,
+				    const char *buf, size_t count)
+{
+	int ret;
+
+	ret = sysfs_match_string(intel_pstate_predictors, buf);
+	if (ret < 0)
+		return ret;
+
+	WRITE_ONCE(load_predictor, ret);
+
+	return count;
+}
+
 show_one(max_perf_pct, max_perf_pct);
 show_one(min_perf_pct, min_perf_pct);
 
@@ -1486,6 +1973,8 @@ define_one_global_ro(turbo_pct);
 define_one_global_ro(num_pstates);
 define_one_global_rw(hwp_dynamic_boost);
 define_one_global_rw(energy_efficiency);
+define_one_global_rw(load_predictor);
+define_one_global_rw(uncore_follow);
 
 static struct attribute *intel_pstate_attributes[] = {
 	&status.attr,
@@ -1525,6 +2014,19 @@ static void __init intel_pstate_sysfs_expose_params(void)
 		WARN_ON(rc);
 	}
 
+	/* The load predictors are not used with HWP */
+	if (!hwp_active) {
+		rc = sysfs_create_file(intel_pstate_kobject, &load_predictor.attr);
+		WARN_ON(rc);
+	}
+
+	/* Uncore following is of no use if HWP is going to be in charge */
+	if (intel_pstate_uncore_supported() &&
+	    (!hwp_active || default_driver != &intel_pstate)) {
+		rc = sysfs_create_file(intel_pstate_kobject, &uncore_follow.attr);
+		WARN_ON(rc);
+	}
+
 	/*
 	 * If per cpu limits are enforced there are no global limits, so
 	 * return without creating max/min_perf_pct attributes
@@ -1556,6 +2058,13 @@ static void __init intel_pstate_sysfs_remove(void)
 		sysfs_remove_file(intel_pstate_kobject, &turbo_pct.attr);
 	}
 
+	if (!hwp_active)
+		sysfs_remove_file(intel_pstate_kobject, &load_predictor.attr);
+
+	if (intel_pstate_uncore_supported() &&
+	    (!hwp_active || default_driver != &intel_pstate))
+		sysfs_remove_file(intel_pstate_kobject, &uncore_follow.attr);
+
 	if (!per_cpu_limits) {
 		sysfs_remove_file(intel_pstate_kobject, &max_perf_pct.attr);
 		sysfs_remove_file(intel_pstate_kobject, &min_perf_pct.attr);
@@ -2127,6 +2636,25 @@ static inline void intel_pstate_update_util_hwp_local(struct cpudata *cpu,
 {
 	cpu->sample.time = time;
 
+	/*
+	 * In the uclamp mode, boost right away for the I/O wakeups of tasks
+	 * that have asked for a performance floor, and treat the others like
+	 * any other update, so that background I/O does not raise the minimum.
+	 */
+	if (READ_ONCE(hwp_boost_uclamp)) {
+		unsigned int flags = cpu->sched_flags;
+
+		cpu->sched_flags = 0;
+		if ((flags & SCHED_CPUFREQ_IOWAIT) &&
+		    (flags & SCHED_CPUFREQ_IOWAIT_UCLAMP)) {
+			cpu->last_io_update = time;
+			intel_pstate_hwp_boost_up(cpu);
+		} else {
+			intel_pstate_hwp_boost_down(cpu);
+		}
+		return;
+	}
+
 	if (cpu->sched_flags & SCHED_CPUFREQ_IOWAIT) {
 		bool do_io = false;
 
@@ -2222,15 +2750,31 @@ static inline int32_t get_avg_pstate(struct cpudata *cpu)
 			  cpu->sample.core_avg_perf);
 }
 
+#define BUSY_EST_SHIFT	2
+
+static inline int32_t get_busy_estimate(struct cpudata *cpu, int32_t busy_frac)
+{
+	if (busy_frac >= cpu->busy_est)
+		cpu->busy_est = busy_frac;
+	else
+		cpu->busy_est -= (cpu->busy_est - busy_frac) >> BUSY_EST_SHIFT;
+
+	return cpu->busy_est;
+}
+
 static inline int32_t get_target_pstate(struct cpudata *cpu)
 {
 	struct sample *sample = &cpu->sample;
+	int predictor = READ_ONCE(load_predictor);
 	int32_t busy_frac;
 	int target, avg_pstate;
 
 	busy_frac = div_fp(sample->mperf << cpu->aperf_mperf_shift,
 			   sample->tsc);
 
+	if (predictor == PREDICTOR_ESTIMATE)
+		busy_frac = get_busy_estimate(cpu, busy_frac);
+
 	if (busy_frac < cpu->iowait_boost)
 		busy_frac = cpu->iowait_boost;
 
@@ -2243,6 +2787,10 @@ static inline int32_t get_target_pstate(struct cpudata *cpu)
 	if (target < cpu->pstate.min_pstate)
 		target = cpu->pstate.min_pstate;
 
+	/* The estimate already decays slowly, don't add to it */
+	if (predictor == PREDICTOR_ESTIMATE)
+		return target;
+
 	/*
 	 * If the average P-state during the previous cycle was higher than the
 	 * current target, add 50% of the difference to the target to reduce
@@ -2272,6 +2820,7 @@ static void intel_pstate_update_pstate(struct cpudata *cpu, int pstate)
 
 	cpu->pstate.current_pstate = pstate;
 	wrmsrl(MSR_IA32_PERF_CTL, pstate_funcs.get_val(cpu, pstate));
+	intel_pstate_uncore_follow(cpu, pstate, true);
 }
 
 static void intel_pstate_adjust_pstate(struct cpudata *cpu)
@@ -2284,6 +2833,9 @@ static void intel_pstate_adjust_pstate(struct cpudata *cpu)
 
 	target_pstate = get_target_pstate(cpu);
 	target_pstate = intel_pstate_prepare_request(cpu, target_pstate);
+	trace_intel_pstate_target_tp(cpu->cpu, fp_toint(cpu->sample.busy_scaled),
+				     from, target_pstate, cpu->min_perf_ratio,
+				     cpu->max_perf_ratio);
 	trace_cpu_frequency(target_pstate * cpu->pstate.scaling, cpu->cpu);
 	intel_pstate_update_pstate(cpu, target_pstate);
 
@@ -2659,6 +3211,12 @@ static int intel_cpufreq_cpu_offline(struct cpufreq_policy *policy)
 
 	pr_debug("CPU %d going offline\n", cpu->cpu);
 
+	/*
+	 * Do not let the batch updates write the package control bit for this
+	 * CPU until the package-level request is set up for it again.
+	 */
+	cpu->hwp_pkg_ctl = false;
+
 	if (cpu->suspended)
 		return 0;
 
@@ -2847,6 +3405,7 @@ static void intel_cpufreq_hwp_update(struct cpudata *cpu, u32 min, u32 max,
 		return;
 
 	WRITE_ONCE(cpu->hwp_req_cached, value);
+	cpu->hwp_pkg_ctl = false;
 	if (fast_switch)
 		wrmsrl(MSR_HWP_REQUEST, value);
 	else
@@ -2882,6 +3441,7 @@ static int intel_cpufreq_update_pstate(struct cpufreq_policy *policy,
 	}
 
 	cpu->pstate.current_pstate = target_pstate;
+	intel_pstate_uncore_follow(cpu, target_pstate, fast_switch);
 
 	intel_cpufreq_trace(cpu, fast_switch ? INTEL_PSTATE_TRACE_FAST_SWITCH :
 			    INTEL_PSTATE_TRACE_TARGET, old_pstate);
@@ -2979,6 +3539,7 @@ static void intel_cpufreq_adjust_perf(unsigned int cpunum,
 	intel_cpufreq_hwp_update(cpu, min_pstate, max_pstate, target_pstate, true);
 
 	cpu->pstate.current_pstate = target_pstate;
+	intel_pstate_uncore_follow(cpu, target_pstate, true);
 	intel_cpufreq_trace(cpu, INTEL_PSTATE_TRACE_FAST_SWITCH, old_pstate);
 }
 
@@ -3017,6 +3578,10 @@ static int intel_cpufreq_cpu_init(struct cpufreq_policy *policy)
 		intel_pstate_get_hwp_cap(cpu);
 
 		rdmsrl_on_cpu(cpu->cpu, MSR_HWP_REQUEST, &value);
+		/* The package control bit is only set on the way to the register. */
+		if (hwp_pkg_req)
+			value &= ~HWP_PACKAGE_CONTROL(1);
+
 		WRITE_ONCE(cpu->hwp_req_cached, value);
 
 		cpu->epp_cached = intel_pstate_get_epp(cpu, value);
@@ -3083,6 +3648,7 @@ static int intel_cpufreq_suspend(struct cpufreq_policy *policy)
 		 * written by it may not be suitable.
 		 */
 		value &= ~HWP_DESIRED_PERF(~0L);
+		cpu->hwp_pkg_ctl = false;
 		wrmsrl_on_cpu(cpu->cpu, MSR_HWP_REQUEST, value);
 		WRITE_ONCE(cpu->hwp_req_cached, value);
 	}
@@ -3105,12 +3671,14 @@ static struct cpufreq_driver intel_cpufreq = {
 	.name		= "intel_cpufreq",
 };
 
-static struct cpufreq_driver *default_driver;
-
 static void intel_pstate_driver_cleanup(void)
 {
 	unsigned int cpu;
 
+	/* The scheduler callbacks look at the cpudata of the other CPUs */
+	if (uncore_follow)
+		intel_pstate_uncore_follow_disable();
+
 	cpus_read_lock();
 	for_each_online_cpu(cpu) {
 		if (all_cpu_data[cpu]) {
@@ -3437,6 +4005,9 @@ static int __init intel_pstate_init(void)
 
 			pstate_funcs.get_cpu_scaling = hwp_get_cpu_scaling;
 
+			if (!boot_cpu_has(X86_FEATURE_HWP_PKG_REQ))
+				hwp_pkg_req = false;
+
 			goto hwp_cpu_matched;
 		}
 		pr_info("HWP not enabled\n");
@@ -3515,6 +4086,11 @@ static int __init intel_pstate_init(void)
 		pr_warn("Problematic setup: Hybrid processor with disabled HWP\n");
 	}
 
+	/* Without HWP, the profile is reflected in the EPB. */
+	if (profile_epp && (hwp_active || boot_cpu_has(X86_FEATURE_EPB)) &&
+	    platform_profile_register_notifier(&intel_pstate_profile_nb))
+		pr_info("Cannot follow the platform profile\n");
+
 	return 0;
 }
 device_initcall(intel_pstate_init);
@@ -3540,6 +4116,10 @@ static int __init intel_pstate_setup(char *str)
 		hwp_only = 1;
 	if (!strcmp(str, "per_cpu_perf_limits"))
 		per_cpu_limits = true;
+	if (!strcmp(str, "hwp_pkg_req"))
+		hwp_pkg_req = true;
+	if (!strcmp(str, "profile_epp"))
+		profile_epp = true;
 
 #ifdef CONFIG_ACPI
 	if (!strcmp(str, "support_acpi_ppc"))
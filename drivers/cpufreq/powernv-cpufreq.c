@@ -643,6 +643,7 @@ static inline int calc_global_pstate(unsigned int elapsed_time,
 static inline void  queue_gpstate_timer(struct global_pstate_info *gpstates)
 {
 	unsigned int timer_interval;
+	unsigned long expires;
 
 	/*
 	 * Setting up timer to fire after GPSTATE_TIMER_INTERVAL ms, But
@@ -651,12 +652,23 @@ static inline void  queue_gpstate_timer(struct global_pstate_info *gpstates)
 	 * seconds of ramp down time.
 	 */
 	if ((gpstates->elapsed_time + GPSTATE_TIMER_INTERVAL)
-	     > MAX_RAMP_DOWN_TIME)
+	     > MAX_RAMP_DOWN_TIME) {
 		timer_interval = MAX_RAMP_DOWN_TIME - gpstates->elapsed_time;
-	else
+		expires = jiffies + msecs_to_jiffies(timer_interval);
+	} else {
+		/*
+		 * The ramp is computed from the actual elapsed time, so the
+		 * intermediate steps can be rounded up to a full second.  All
+		 * policies use the same rounding (no per-CPU skew), which makes
+		 * the timers of all the cores of a chip expire together
+		 * instead of waking the chip up at a different time for each.
+		 */
 		timer_interval = GPSTATE_TIMER_INTERVAL;
+		expires = __round_jiffies_up(jiffies +
+					     msecs_to_jiffies(timer_interval), 0);
+	}
 
-	mod_timer(&gpstates->timer, jiffies + msecs_to_jiffies(timer_interval));
+	mod_timer(&gpstates->timer, expires);
 }
 
 /**
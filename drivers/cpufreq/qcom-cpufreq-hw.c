@@ -30,6 +30,13 @@
 
 #define MAX_FREQ_DOMAINS		4
 
+/*
+ * The end of throttling has to be polled for.  The interval is doubled up to
+ * the maximum while the throttled frequency stays the same.
+ */
+#define LMH_POLL_MIN_MS			10
+#define LMH_POLL_MAX_MS			160
+
 struct qcom_cpufreq_soc_data {
 	u32 reg_enable;
 	u32 reg_domain_state;
@@ -54,6 +61,8 @@ struct qcom_cpufreq_data {
 	char irq_name[15];
 	bool cancel_throttle;
 	struct delayed_work throttle_work;
+	unsigned int throttle_poll_ms;
+	unsigned long last_throttled_freq;
 	struct cpufreq_policy *policy;
 	struct clk_hw cpu_clk;
 
@@ -362,11 +371,21 @@ static void qcom_lmh_dcvs_notify(struct qcom_cpufreq_data *data)
 	 * If h/w throttled frequency is higher than what cpufreq has requested
 	 * for, then stop polling and switch back to interrupt mechanism.
 	 */
-	if (throttled_freq >= qcom_cpufreq_get_freq(cpu))
+	if (throttled_freq >= qcom_cpufreq_get_freq(cpu)) {
 		enable_irq(data->throttle_irq);
-	else
+	} else {
+		if (!data->throttle_poll_ms ||
+		    throttled_freq != data->last_throttled_freq)
+			data->throttle_poll_ms = LMH_POLL_MIN_MS;
+		else
+			data->throttle_poll_ms = min_t(unsigned int,
+						       2 * data->throttle_poll_ms,
+						       LMH_POLL_MAX_MS);
+
 		mod_delayed_work(system_highpri_wq, &data->throttle_work,
-				 msecs_to_jiffies(10));
+				 msecs_to_jiffies(data->throttle_poll_ms));
+	}
+	data->last_throttled_freq = throttled_freq;
 
 out:
 	mutex_unlock(&data->throttle_lock);
@@ -384,8 +403,9 @@ static irqreturn_t qcom_lmh_dcvs_handle_irq(int irq, void *data)
 {
 	struct qcom_cpufreq_data *c_data = data;
 
-	/* Disable interrupt and enable polling */
+	/* Disable interrupt and enable polling, starting at the fastest rate */
 	disable_irq_nosync(c_data->throttle_irq);
+	c_data->throttle_poll_ms = 0;
 	schedule_delayed_work(&c_data->throttle_work, 0);
 
 	if (qcom_cpufreq.soc_data->reg_intr_clr)
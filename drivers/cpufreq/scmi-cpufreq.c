@@ -20,17 +20,34 @@
 #include <linux/scmi_protocol.h>
 #include <linux/types.h>
 #include <linux/units.h>
+#include <linux/workqueue.h>
 
 struct scmi_data {
 	int domain_id;
 	int nr_opp;
 	struct device *cpu_dev;
 	cpumask_var_t opp_shared_cpus;
+	struct cpufreq_policy *policy;
+	/* Latest asynchronous request in kHz, 0 if none is pending */
+	unsigned int pending_freq;
+	struct work_struct set_work;
 };
 
 static struct scmi_protocol_handle *ph;
 static const struct scmi_perf_proto_ops *perf_ops;
 
+/*
+ * Without fastchannels every PERF_LEVEL_SET waits for the platform's
+ * response.  With async_set the slow path only records the request and a
+ * work item sends it, so the caller does not wait for the firmware, and the
+ * requests made while one is in flight are coalesced into the latest one.
+ * The work item sends the transition notifications, so policy->cur is only
+ * updated once the platform has accepted a request.  Errors are only logged.
+ */
+static bool async_set;
+module_param(async_set, bool, 0444);
+MODULE_PARM_DESC(async_set, "Send slow path performance level requests asynchronously");
+
 static unsigned int scmi_cpufreq_get_rate(unsigned int cpu)
 {
 	struct cpufreq_policy *policy = cpufreq_cpu_get_raw(cpu);
@@ -58,6 +75,44 @@ scmi_cpufreq_set_target(struct cpufreq_policy *policy, unsigned int index)
 	return perf_ops->freq_set(ph, priv->domain_id, freq * 1000, false);
 }
 
+static void scmi_cpufreq_set_work(struct work_struct *work)
+{
+	struct scmi_data *priv = container_of(work, struct scmi_data, set_work);
+	struct cpufreq_policy *policy = priv->policy;
+	struct cpufreq_freqs freqs = { .old = policy->cur, .flags = 0 };
+	int ret;
+
+	/* Nothing to do if the latest request is for the current frequency */
+	freqs.new = xchg(&priv->pending_freq, 0);
+	if (!freqs.new || freqs.new == freqs.old)
+		return;
+
+	cpufreq_freq_transition_begin(policy, &freqs);
+	ret = perf_ops->freq_set(ph, priv->domain_id, (u64)freqs.new * 1000,
+				 false);
+	cpufreq_freq_transition_end(policy, &freqs, ret);
+	if (ret)
+		dev_warn_ratelimited(priv->cpu_dev,
+				     "failed to set %u kHz: %d\n", freqs.new, ret);
+}
+
+/*
+ * Used as ->target() with async_set.  The target frequency has been resolved
+ * to one from the table by the cpufreq core already.
+ */
+static int scmi_cpufreq_set_target_async(struct cpufreq_policy *policy,
+					 unsigned int target_freq,
+					 unsigned int relation)
+{
+	struct scmi_data *priv = policy->driver_data;
+
+	/* A request that has not been sent yet is simply replaced */
+	if (!xchg(&priv->pending_freq, target_freq))
+		queue_work(system_highpri_wq, &priv->set_work);
+
+	return 0;
+}
+
 static unsigned int scmi_cpufreq_fast_switch(struct cpufreq_policy *policy,
 					     unsigned int target_freq)
 {
@@ -210,6 +265,8 @@ static int scmi_cpufreq_init(struct cpufreq_policy *policy)
 
 	priv->cpu_dev = cpu_dev;
 	priv->domain_id = perf_ops->device_domain_id(cpu_dev);
+	priv->policy = policy;
+	INIT_WORK(&priv->set_work, scmi_cpufreq_set_work);
 
 	policy->driver_data = priv;
 	policy->freq_table = freq_table;
@@ -244,6 +301,7 @@ static int scmi_cpufreq_exit(struct cpufreq_policy *policy)
 {
 	struct scmi_data *priv = policy->driver_data;
 
+	cancel_work_sync(&priv->set_work);
 	dev_pm_opp_free_cpufreq_table(priv->cpu_dev, &policy->freq_table);
 	dev_pm_opp_remove_all_dynamic(priv->cpu_dev);
 	free_cpumask_var(priv->opp_shared_cpus);
@@ -252,6 +310,16 @@ static int scmi_cpufreq_exit(struct cpufreq_policy *policy)
 	return 0;
 }
 
+static int scmi_cpufreq_suspend(struct cpufreq_policy *policy)
+{
+	struct scmi_data *priv = policy->driver_data;
+
+	/* The governor is stopped, send the last request before suspending */
+	flush_work(&priv->set_work);
+
+	return 0;
+}
+
 static void scmi_cpufreq_register_em(struct cpufreq_policy *policy)
 {
 	struct em_data_callback em_cb = EM_DATA_CB(scmi_get_cpu_power);
@@ -290,6 +358,7 @@ static struct cpufreq_driver scmi_cpufreq_driver = {
 	.get	= scmi_cpufreq_get_rate,
 	.init	= scmi_cpufreq_init,
 	.exit	= scmi_cpufreq_exit,
+	.suspend	= scmi_cpufreq_suspend,
 	.register_em	= scmi_cpufreq_register_em,
 };
 
@@ -314,6 +383,17 @@ static int scmi_cpufreq_probe(struct scmi_device *sdev)
 		devm_of_clk_add_hw_provider(dev, of_clk_hw_simple_get, NULL);
 #endif
 
+	/*
+	 * policy->cur only changes when a request has been sent, so requests
+	 * for it must still reach the driver to replace a pending one.
+	 */
+	if (async_set) {
+		scmi_cpufreq_driver.target = scmi_cpufreq_set_target_async;
+		scmi_cpufreq_driver.target_index = NULL;
+		scmi_cpufreq_driver.flags |= CPUFREQ_ASYNC_NOTIFICATION |
+					     CPUFREQ_NEED_UPDATE_LIMITS;
+	}
+
 	ret = cpufreq_register_driver(&scmi_cpufreq_driver);
 	if (ret) {
 		dev_err(dev, "%s: registering cpufreq failed, err: %d\n",
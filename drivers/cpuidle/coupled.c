@@ -82,6 +82,16 @@
  *    should ensure that the cpus all abort together if any cpu tries
  *    to abort once the function is called.  The function should return
  *    with interrupts still disabled.
+ *
+ * If the hardware (or firmware) can cope with the cpus entering a coupled
+ * state at different times and aborting the cluster transition when one of
+ * them wakes up, the driver may set CPUIDLE_FLAG_COUPLED_LAST_MAN for all of
+ * its coupled states instead.  The cpus then do not wait for each other or
+ * exchange IPIs.  Each of them calls the state's enter function on its own,
+ * and cpuidle_coupled_last_man() returns true during that call only for the
+ * last cpu of the coupled set to go idle, which should carry out the cluster
+ * transition, for the deepest state requested by all of the cpus.  The other
+ * cpus should only power down themselves.
  */
 
 /**
@@ -93,12 +103,14 @@
  * @online_count: count of cpus that are online
  * @refcnt: reference count of cpuidle devices that are using this struct
  * @prevent: flag to prevent coupled idle while a cpu is hotplugging
+ * @idle_count: count of cpus in last-man coupled states
  */
 struct cpuidle_coupled {
 	cpumask_t coupled_cpus;
 	int requested_state[NR_CPUS];
 	atomic_t ready_waiting_counts;
 	atomic_t abort_barrier;
+	atomic_t idle_count;
 	int online_count;
 	int refcnt;
 	int prevent;
@@ -186,14 +198,24 @@ bool cpuidle_state_is_coupled(struct cpuidle_driver *drv, int state)
  */
 int cpuidle_coupled_state_verify(struct cpuidle_driver *drv)
 {
-	int i;
+	int i, last_man = -1;
 
 	for (i = drv->state_count - 1; i >= 0; i--) {
-		if (cpuidle_state_is_coupled(drv, i) &&
-		    (drv->safe_state_index == i ||
-		     drv->safe_state_index < 0 ||
-		     drv->safe_state_index >= drv->state_count))
+		bool lm = drv->states[i].flags & CPUIDLE_FLAG_COUPLED_LAST_MAN;
+
+		if (!cpuidle_state_is_coupled(drv, i))
+			continue;
+
+		if (drv->safe_state_index == i ||
+		    drv->safe_state_index < 0 ||
+		    drv->safe_state_index >= drv->state_count)
 			return -EINVAL;
+
+		/* The two coupling protocols cannot be mixed. */
+		if (last_man >= 0 && last_man != lm)
+			return -EINVAL;
+
+		last_man = lm;
 	}
 
 	return 0;
@@ -448,6 +470,52 @@ static bool cpuidle_coupled_any_pokes_pending(struct cpuidle_coupled *coupled)
 	return ret;
 }
 
+/**
+ * cpuidle_enter_state_last_man - enter a coupled state without a rendezvous
+ * @dev: struct cpuidle_device for the current cpu
+ * @drv: struct cpuidle_driver for the platform
+ * @next_state: index of the requested state in drv->states
+ *
+ * Enter @next_state right away, unless this is the last cpu of the coupled set
+ * to go idle, in which case enter the deepest state requested by all of the
+ * cpus with cpuidle_coupled_last_man() returning true.
+ *
+ * Called with interrupts disabled, returns with interrupts enabled.
+ */
+static int cpuidle_enter_state_last_man(struct cpuidle_device *dev,
+		struct cpuidle_driver *drv, int next_state)
+{
+	struct cpuidle_coupled *coupled = dev->coupled;
+	int entered_state, state;
+
+	coupled->requested_state[dev->cpu] = next_state;
+
+	/*
+	 * The atomic_inc_return orders the write to requested_state before
+	 * the update of idle_count, matching the read barrier in
+	 * cpuidle_coupled_get_state.
+	 */
+	if (atomic_inc_return(&coupled->idle_count) == coupled->online_count) {
+		/* A cpu that has just woken up has cleared its request. */
+		state = cpuidle_coupled_get_state(dev, coupled);
+		if (state >= 0) {
+			dev->coupled_last_man = true;
+			next_state = state;
+		}
+	}
+
+	entered_state = cpuidle_enter_state(dev, drv, next_state);
+
+	dev->coupled_last_man = false;
+	coupled->requested_state[dev->cpu] = CPUIDLE_COUPLED_NOT_IDLE;
+	smp_mb__before_atomic();
+	atomic_dec(&coupled->idle_count);
+
+	local_irq_enable();
+
+	return entered_state;
+}
+
 /**
  * cpuidle_enter_state_coupled - attempt to enter a state with coupled cpus
  * @dev: struct cpuidle_device for the current cpu
@@ -491,6 +559,9 @@ int cpuidle_enter_state_coupled(struct cpuidle_device *dev,
 	/* Read barrier ensures online_count is read after prevent is cleared */
 	smp_rmb();
 
+	if (drv->states[next_state].flags & CPUIDLE_FLAG_COUPLED_LAST_MAN)
+		return cpuidle_enter_state_last_man(dev, drv, next_state);
+
 reset:
 	cpumask_clear_cpu(dev->cpu, &cpuidle_coupled_poked);
 
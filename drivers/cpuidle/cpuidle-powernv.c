@@ -13,14 +13,17 @@
 #include <linux/cpu.h>
 #include <linux/notifier.h>
 #include <linux/clockchips.h>
+#include <linux/delay.h>
 #include <linux/of.h>
 #include <linux/slab.h>
+#include <linux/workqueue.h>
 
 #include <asm/machdep.h>
 #include <asm/firmware.h>
 #include <asm/opal.h>
 #include <asm/runlatch.h>
 #include <asm/cpuidle.h>
+#include <asm/cputhreads.h>
 
 /*
  * Expose only those Hardware idle states via the cpuidle framework
@@ -46,6 +49,11 @@ static struct stop_psscr_table stop_psscr_table[CPUIDLE_STATE_MAX] __read_mostly
 static u64 default_snooze_timeout __read_mostly;
 static bool snooze_timeout_en __read_mostly;
 
+static bool calibrate_latency;
+module_param(calibrate_latency, bool, 0444);
+MODULE_PARM_DESC(calibrate_latency,
+		 "Measure the exit latency of the stop states on every chip at boot and use the worst if lower than the firmware value");
+
 static u64 get_snooze_timeout(struct cpuidle_device *dev,
 			      struct cpuidle_driver *drv,
 			      int index)
@@ -148,6 +156,226 @@ static int stop_loop(struct cpuidle_device *dev,
 	return index;
 }
 
+/*
+ * The firmware exit latencies of the stop states tend to be pessimistic.  With
+ * calibrate_latency set, measure them on the first online CPU of every chip as
+ * the time from sending an IPI to it to the IPI being handled, while it sits
+ * in the state under test with all of the other non-polling states disabled.
+ * The timebase is synchronized across the cores, so it can be read on both
+ * sides.
+ *
+ * The chips are measured in parallel, with the IPIs sent from a CPU in a core
+ * that is not measured, and the whole calibration is bounded by
+ * POWERNV_CALIBRATE_MAX_MS, so it only delays the boot by that much at most.
+ *
+ * The worst case of POWERNV_CALIBRATE_SAMPLES wakeups is kept per chip.  The
+ * states are shared by all of the CPUs, so the firmware value is only replaced
+ * by the worst of the per-chip values, and only if that is lower.  The target
+ * residencies are left alone.
+ */
+#define POWERNV_CALIBRATE_SAMPLES	16
+#define POWERNV_CALIBRATE_MAX_MS	2000
+
+struct powernv_calibrate {
+	u64 sent;
+	u64 latency_ns;
+	u64 usage;
+	u64 total;
+	int state;
+};
+
+struct powernv_calibrate_chip {
+	struct work_struct work;
+	unsigned long deadline;
+	int cpu;
+	u64 latency_ns[CPUIDLE_STATE_MAX];
+};
+
+static void powernv_calibrate_wakeup(void *info)
+{
+	struct cpuidle_device *dev = __this_cpu_read(cpuidle_devices);
+	struct cpuidle_driver *drv = &powernv_idle_driver;
+	struct powernv_calibrate *c = info;
+	int i;
+
+	c->latency_ns = tb_to_ns(mftb() - c->sent);
+
+	/*
+	 * The usage counts are only updated after the IPI has been handled, so
+	 * they cover all of the idle periods before the current one.
+	 */
+	c->usage = dev ? dev->states_usage[c->state].usage : 0;
+	c->total = 0;
+	for (i = 0; dev && i < drv->state_count; i++)
+		c->total += dev->states_usage[i].usage;
+}
+
+static u64 __init powernv_calibrate_state(int cpu, int index,
+					  unsigned long deadline)
+{
+	struct cpuidle_driver *drv = &powernv_idle_driver;
+	unsigned int sleep_us = 2 * drv->states[index].target_residency + 1000;
+	struct powernv_calibrate c = { .state = index };
+	u64 latency_ns = 0, usage = 0, total = 0, worst = 0;
+	int i, n = 0;
+
+	for (i = 0; i <= 4 * POWERNV_CALIBRATE_SAMPLES; i++) {
+		if (time_after(jiffies, deadline))
+			return 0;
+
+		/* Let the CPU settle in the state */
+		usleep_range(sleep_us, sleep_us + 100);
+
+		c.sent = mftb();
+		if (smp_call_function_single(cpu, powernv_calibrate_wakeup,
+					     &c, 1))
+			return 0;
+
+		/*
+		 * The previous sample is only valid if the CPU has exited
+		 * exactly one idle period since, from the state under test.
+		 */
+		if (i > 0 && c.total - total == 1 && c.usage - usage == 1) {
+			worst = max(worst, latency_ns);
+			if (++n == POWERNV_CALIBRATE_SAMPLES)
+				return worst;
+		}
+
+		latency_ns = c.latency_ns;
+		usage = c.usage;
+		total = c.total;
+	}
+
+	return 0;
+}
+
+static void __init powernv_calibrate_chip(struct work_struct *work)
+{
+	struct powernv_calibrate_chip *chip =
+			container_of(work, struct powernv_calibrate_chip, work);
+	struct cpuidle_driver *drv = &powernv_idle_driver;
+	u8 disable[CPUIDLE_STATE_MAX];
+	struct cpuidle_device *dev;
+	int i, j;
+
+	dev = per_cpu(cpuidle_devices, chip->cpu);
+	if (!dev)
+		return;
+
+	for (i = 0; i < drv->state_count; i++)
+		disable[i] = dev->states_usage[i].disable;
+
+	for (i = 0; i < drv->state_count; i++) {
+		if (drv->states[i].enter != stop_loop || disable[i])
+			continue;
+
+		for (j = 0; j < drv->state_count; j++) {
+			if (j == i || drv->states[j].flags & CPUIDLE_FLAG_POLLING)
+				dev->states_usage[j].disable = disable[j];
+			else
+				dev->states_usage[j].disable |=
+					CPUIDLE_STATE_DISABLED_BY_DRIVER;
+		}
+
+		chip->latency_ns[i] = powernv_calibrate_state(chip->cpu, i,
+							      chip->deadline);
+	}
+
+	for (i = 0; i < drv->state_count; i++)
+		dev->states_usage[i].disable = disable[i];
+}
+
+static void __init powernv_calibrate_stop_states(void)
+{
+	struct cpuidle_driver *drv = &powernv_idle_driver;
+	struct powernv_calibrate_chip *chips;
+	unsigned long deadline;
+	int cpu, sender = -1, nr_chips = 0, i, k;
+
+	cpus_read_lock();
+
+	chips = kcalloc(num_online_cpus(), sizeof(*chips), GFP_KERNEL);
+	if (!chips)
+		goto unlock;
+
+	for_each_online_cpu(cpu) {
+		for (k = 0; k < nr_chips; k++)
+			if (topology_physical_package_id(chips[k].cpu) ==
+			    topology_physical_package_id(cpu))
+				break;
+
+		if (k == nr_chips)
+			chips[nr_chips++].cpu = cpu;
+	}
+
+	/* The IPIs must come from outside of the measured cores. */
+	for_each_online_cpu(cpu) {
+		for (k = 0; k < nr_chips; k++)
+			if (cpu_first_thread_sibling(chips[k].cpu) ==
+			    cpu_first_thread_sibling(cpu))
+				break;
+
+		if (k == nr_chips) {
+			sender = cpu;
+			break;
+		}
+	}
+
+	if (sender < 0) {
+		pr_info("cpuidle-powernv: no CPU to calibrate the stop states from\n");
+		goto free;
+	}
+
+	deadline = jiffies + msecs_to_jiffies(POWERNV_CALIBRATE_MAX_MS);
+
+	/* The works sleep most of the time, so they run concurrently. */
+	for (k = 0; k < nr_chips; k++) {
+		chips[k].deadline = deadline;
+		INIT_WORK(&chips[k].work, powernv_calibrate_chip);
+		queue_work_on(sender, system_long_wq, &chips[k].work);
+	}
+
+	for (k = 0; k < nr_chips; k++)
+		flush_work(&chips[k].work);
+
+	for (i = 0; i < drv->state_count; i++) {
+		struct cpuidle_state *state = &drv->states[i];
+		u64 latency_ns = 0;
+
+		if (state->enter != stop_loop)
+			continue;
+
+		for (k = 0; k < nr_chips; k++) {
+			/* Do not trust the results if any chip has failed. */
+			if (!chips[k].latency_ns[i]) {
+				latency_ns = 0;
+				break;
+			}
+			latency_ns = max(latency_ns, chips[k].latency_ns[i]);
+		}
+
+		if (!latency_ns) {
+			pr_info("cpuidle-powernv: %s: could not be calibrated\n",
+				state->name);
+			continue;
+		}
+
+		pr_info("cpuidle-powernv: %s: exit latency %lluns, %lluns from firmware\n",
+			state->name, latency_ns, state->exit_latency_ns);
+
+		if (latency_ns < state->exit_latency_ns) {
+			state->exit_latency_ns = latency_ns;
+			state->exit_latency = DIV_ROUND_UP_ULL(latency_ns,
+							       NSEC_PER_USEC);
+		}
+	}
+
+free:
+	kfree(chips);
+unlock:
+	cpus_read_unlock();
+}
+
 /*
  * States for dedicated partition case.
  */
@@ -399,6 +627,10 @@ static int __init powernv_processor_idle_init(void)
 					   "cpuidle/powernv:dead", NULL,
 					   powernv_cpuidle_cpu_dead);
 	WARN_ON(retval < 0);
+
+	if (calibrate_latency)
+		powernv_calibrate_stop_states();
+
 	printk(KERN_DEBUG "powernv_idle_driver registered\n");
 	return 0;
 }
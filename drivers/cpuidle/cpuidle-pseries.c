@@ -22,6 +22,7 @@
 #include <asm/idle.h>
 #include <asm/plpar_wrappers.h>
 #include <asm/rtas.h>
+#include <asm/time.h>
 
 static struct cpuidle_driver pseries_idle_driver = {
 	.name             = "pseries_idle",
@@ -33,6 +34,47 @@ static struct cpuidle_state *cpuidle_state_table __read_mostly;
 static u64 snooze_timeout __read_mostly;
 static bool snooze_timeout_en __read_mostly;
 
+/*
+ * Timer wakeups from CEDE come late by the time it takes the hypervisor to
+ * dispatch the virtual processor again, which depends on the load of the
+ * partitions sharing the physical processors.  Track that delay per CPU as an
+ * EWMA in timebase ticks and snooze for at least as long before ceding, so
+ * polling never costs more CPU time than the wakeup from CEDE would cost in
+ * latency.  The snooze window is capped like the generic polling state.
+ */
+#define CEDE_DELAY_SHIFT	3
+
+static bool adaptive_snooze __read_mostly = true;
+module_param(adaptive_snooze, bool, 0644);
+MODULE_PARM_DESC(adaptive_snooze, "Extend the snooze window to the observed CEDE wakeup delay");
+
+static u64 snooze_timeout_max __read_mostly;
+static DEFINE_PER_CPU(u64, cede_delay);
+
+static __always_inline u64 get_snooze_timeout(void)
+{
+	u64 delay;
+
+	if (!READ_ONCE(adaptive_snooze))
+		return snooze_timeout;
+
+	delay = min(__this_cpu_read(cede_delay), snooze_timeout_max);
+	return max(delay, snooze_timeout);
+}
+
+static __always_inline void cede_record_delay(u64 expires)
+{
+	u64 now = get_tb(), avg;
+
+	/* Only timer wakeups tell how late the CPU was dispatched again. */
+	if (now < expires)
+		return;
+
+	avg = __this_cpu_read(cede_delay);
+	avg += ((now - expires) >> CEDE_DELAY_SHIFT) - (avg >> CEDE_DELAY_SHIFT);
+	__this_cpu_write(cede_delay, avg);
+}
+
 static __cpuidle
 int snooze_loop(struct cpuidle_device *dev, struct cpuidle_driver *drv,
 		int index)
@@ -43,7 +85,7 @@ int snooze_loop(struct cpuidle_device *dev, struct cpuidle_driver *drv,
 
 	pseries_idle_prolog();
 	raw_local_irq_enable();
-	snooze_exit_time = get_tb() + snooze_timeout;
+	snooze_exit_time = get_tb() + get_snooze_timeout();
 	dev->poll_time_limit = false;
 
 	while (!need_resched()) {
@@ -80,12 +122,18 @@ static __cpuidle void check_and_cede_processor(void)
 	 * were soft-disabled
 	 */
 	if (prep_irq_for_idle()) {
+		u64 dec = get_dec();
+		u64 expires = get_tb() + dec;
+
 		cede_processor();
 #ifdef CONFIG_TRACE_IRQFLAGS
 		/* Ensure that H_CEDE returns with IRQs on */
 		if (WARN_ON(!(mfmsr() & MSR_EE)))
 			__hard_irq_enable();
 #endif
+		/* A negative decrementer has already fired */
+		if (dec <= decrementer_max)
+			cede_record_delay(expires);
 	}
 }
 
@@ -443,6 +491,7 @@ static int __init pseries_idle_probe(void)
 		snooze_timeout_en = true;
 		snooze_timeout = cpuidle_state_table[1].target_residency *
 				 tb_ticks_per_usec;
+		snooze_timeout_max = TICK_USEC * tb_ticks_per_usec / 16;
 	}
 	return 0;
 }
@@ -113,37 +113,47 @@ static __cpuidle int __sbi_enter_domain_idle_state(struct cpuidle_device *dev,
 	struct sbi_cpuidle_data *data = this_cpu_ptr(&sbi_cpuidle_data);
 	u32 *states = data->states;
 	struct device *pd_dev = data->dev;
+	bool non_ret;
 	u32 state;
 	int ret;
 
-	ret = cpu_pm_enter();
-	if (ret)
-		return -1;
-
 	/* Do runtime PM to manage a hierarchical CPU toplogy. */
 	if (s2idle)
 		dev_pm_genpd_suspend(pd_dev);
 	else
 		pm_runtime_put_sync_suspend(pd_dev);
 
-	ct_cpuidle_enter();
-
 	if (sbi_is_domain_state_available())
 		state = sbi_get_domain_state();
 	else
 		state = states[idx];
 
+	/*
+	 * The CPU context is only lost if the composed state is non-retentive,
+	 * so skip the CPU PM notifiers otherwise, like for the CPU states that
+	 * are not part of the topology.
+	 */
+	non_ret = state & SBI_HSM_SUSP_NON_RET_BIT;
+	if (non_ret && cpu_pm_enter()) {
+		ret = -1;
+		goto out;
+	}
+
+	ct_cpuidle_enter();
+
 	ret = sbi_suspend(state) ? -1 : idx;
 
 	ct_cpuidle_exit();
 
+	if (non_ret)
+		cpu_pm_exit();
+
+out:
 	if (s2idle)
 		dev_pm_genpd_resume(pd_dev);
 	else
 		pm_runtime_get_sync(pd_dev);
 
-	cpu_pm_exit();
-
 	/* Clear the domain state to start fresh when back from idle. */
 	sbi_clear_domain_state();
 	return ret;
@@ -21,6 +21,7 @@
 #include <linux/cpuidle.h>
 #include <linux/ktime.h>
 #include <linux/hrtimer.h>
+#include <linux/jump_label.h>
 #include <linux/module.h>
 #include <linux/suspend.h>
 #include <linux/tick.h>
@@ -39,6 +40,7 @@ LIST_HEAD(cpuidle_detected_devices);
 static int enabled_devices;
 static int off __read_mostly;
 static int initialized __read_mostly;
+static bool adaptive_poll __read_mostly = true;
 
 int cpuidle_disabled(void)
 {
@@ -197,11 +199,146 @@ int cpuidle_enter_s2idle(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 	if (index > 0) {
 		enter_s2idle_proper(drv, dev, index);
 		local_irq_enable();
+		s2idle_note_state(index);
 	}
 	return index;
 }
 #endif /* CONFIG_SUSPEND */
 
+/*
+ * Min polling interval of 10usec is a guess. It is assuming that
+ * for most users, the time for a single ping-pong workload like
+ * perf bench pipe would generally complete within 10usec but
+ * this is hardware dependant. Actual time can be estimated with
+ *
+ * perf bench sched pipe -l 10000
+ *
+ * Run multiple times to avoid cpufreq effects.
+ */
+#define CPUIDLE_POLL_MIN 10000
+#define CPUIDLE_POLL_MAX (TICK_NSEC / 16)
+
+/**
+ * cpuidle_poll_adapt - adjust the polling budget after an idle period
+ * @dev: the cpuidle device
+ * @drv: the cpuidle driver tied with the cpu
+ * @index: the index of the idle state that has been entered
+ * @residency_ns: the time spent in that state
+ *
+ * If a poll has run out of time and the wakeup has come soon after it, in the
+ * state entered next, polling for a bit longer would have caught it, so double
+ * the budget (up to dev->poll_limit_ns).  If the wakeup has come much later,
+ * the poll has been a waste of energy, so halve the budget instead.  Wakeups
+ * during the poll leave the budget unchanged.
+ *
+ * Governors that manage dev->poll_limit_ns by themselves opt out of this.
+ */
+static void cpuidle_poll_adapt(struct cpuidle_device *dev,
+			       struct cpuidle_driver *drv, int index,
+			       u64 residency_ns)
+{
+	u64 budget;
+
+	if (!READ_ONCE(adaptive_poll) || cpuidle_curr_governor->owns_poll_limit) {
+		dev->poll_adaptive_ns = 0;
+		return;
+	}
+
+	if (drv->states[index].flags & CPUIDLE_FLAG_POLLING) {
+		dev->poll_timed_out = dev->poll_time_limit;
+		return;
+	}
+
+	if (!dev->poll_timed_out || !dev->poll_limit_ns)
+		return;
+
+	dev->poll_timed_out = false;
+
+	budget = dev->poll_adaptive_ns ?: dev->poll_limit_ns;
+	if (residency_ns <= budget)
+		budget = min(2 * budget, dev->poll_limit_ns);
+	else if (residency_ns > dev->poll_limit_ns)
+		budget = max_t(u64, budget / 2,
+			       min_t(u64, CPUIDLE_POLL_MIN, dev->poll_limit_ns));
+
+	dev->poll_adaptive_ns = budget;
+}
+
+/*
+ * With cpuidle.stats_sample=N (N > 1), the residency statistics of the idle
+ * states are only updated on one in N idle entries, with the result scaled by
+ * N, to make the idle path shorter.  The usage counts are always exact.
+ */
+static unsigned int stats_sample __read_mostly = 1;
+static DEFINE_STATIC_KEY_FALSE(cpuidle_sampled_stats);
+
+static inline unsigned int cpuidle_stats_weight(struct cpuidle_device *dev)
+{
+	if (!static_branch_unlikely(&cpuidle_sampled_stats))
+		return 1;
+
+	if (++dev->stats_skipped < stats_sample)
+		return 0;
+
+	dev->stats_skipped = 0;
+	return stats_sample;
+}
+
+/*
+ * Let the driver tell which state has actually been reached, possibly after a
+ * demotion by the hardware, so that the statistics and the governor are not
+ * misled.  Only shallower states are taken into account.
+ */
+static int cpuidle_achieved_state(struct cpuidle_device *dev,
+				  struct cpuidle_driver *drv, int index,
+				  u64 residency_ns)
+{
+	int achieved = drv->states[index].achieved(dev, drv, index, residency_ns);
+
+	if (achieved < 0 || achieved > index)
+		return index;
+
+	return achieved;
+}
+
+static void cpuidle_update_stats(struct cpuidle_device *dev,
+				 struct cpuidle_driver *drv, int index,
+				 s64 diff, unsigned int weight)
+{
+	s64 delay = drv->states[index].exit_latency_ns;
+	int i;
+
+	dev->states_usage[index].time_ns += diff * weight;
+
+	if (diff < drv->states[index].target_residency_ns) {
+		for (i = index - 1; i >= 0; i--) {
+			if (dev->states_usage[i].disable)
+				continue;
+
+			/* Shallower states are enabled, so update. */
+			dev->states_usage[index].above += weight;
+			trace_cpu_idle_miss(dev->cpu, index, false);
+			break;
+		}
+	} else if (diff > delay) {
+		for (i = index + 1; i < drv->state_count; i++) {
+			if (dev->states_usage[i].disable)
+				continue;
+
+			/*
+			 * Update if a deeper state would have been a
+			 * better match for the observed idle duration.
+			 */
+			if (diff - delay >= drv->states[i].target_residency_ns) {
+				dev->states_usage[index].below += weight;
+				trace_cpu_idle_miss(dev->cpu, index, true);
+			}
+
+			break;
+		}
+	}
+}
+
 /**
  * cpuidle_enter_state - enter the state and update stats
  * @dev: cpuidle device for this cpu
@@ -289,8 +426,8 @@ noinstr int cpuidle_enter_state(struct cpuidle_device *dev,
 		local_irq_enable();
 
 	if (entered_state >= 0) {
-		s64 diff, delay = drv->states[entered_state].exit_latency_ns;
-		int i;
+		unsigned int weight;
+		s64 diff;
 
 		/*
 		 * Update cpuidle counters
@@ -299,37 +436,20 @@ noinstr int cpuidle_enter_state(struct cpuidle_device *dev,
 		 */
 		diff = ktime_sub(time_end, time_start);
 
+		if (drv->states[entered_state].achieved)
+			entered_state = cpuidle_achieved_state(dev, drv,
+							       entered_state, diff);
+
 		dev->last_residency_ns = diff;
-		dev->states_usage[entered_state].time_ns += diff;
 		dev->states_usage[entered_state].usage++;
+		trace_cpuidle_exit_tp(dev, entered_state, diff);
 
-		if (diff < drv->states[entered_state].target_residency_ns) {
-			for (i = entered_state - 1; i >= 0; i--) {
-				if (dev->states_usage[i].disable)
-					continue;
+		cpuidle_telemetry_record(dev, drv, entered_state, time_start, diff);
+		cpuidle_poll_adapt(dev, drv, entered_state, diff);
 
-				/* Shallower states are enabled, so update. */
-				dev->states_usage[entered_state].above++;
-				trace_cpu_idle_miss(dev->cpu, entered_state, false);
-				break;
-			}
-		} else if (diff > delay) {
-			for (i = entered_state + 1; i < drv->state_count; i++) {
-				if (dev->states_usage[i].disable)
-					continue;
-
-				/*
-				 * Update if a deeper state would have been a
-				 * better match for the observed idle duration.
-				 */
-				if (diff - delay >= drv->states[i].target_residency_ns) {
-					dev->states_usage[entered_state].below++;
-					trace_cpu_idle_miss(dev->cpu, entered_state, true);
-				}
-
-				break;
-			}
-		}
+		weight = cpuidle_stats_weight(dev);
+		if (weight)
+			cpuidle_update_stats(dev, drv, entered_state, diff, weight);
 	} else {
 		dev->last_residency_ns = 0;
 		dev->states_usage[index].rejected++;
@@ -356,7 +476,10 @@ noinstr int cpuidle_enter_state(struct cpuidle_device *dev,
 int cpuidle_select(struct cpuidle_driver *drv, struct cpuidle_device *dev,
 		   bool *stop_tick)
 {
-	return cpuidle_curr_governor->select(drv, dev, stop_tick);
+	int index = cpuidle_curr_governor->select(drv, dev, stop_tick);
+
+	trace_cpuidle_select_tp(dev, index, *stop_tick);
+	return index;
 }
 
 /**
@@ -405,19 +528,6 @@ void cpuidle_reflect(struct cpuidle_device *dev, int index)
 		cpuidle_curr_governor->reflect(dev, index);
 }
 
-/*
- * Min polling interval of 10usec is a guess. It is assuming that
- * for most users, the time for a single ping-pong workload like
- * perf bench pipe would generally complete within 10usec but
- * this is hardware dependant. Actual time can be estimated with
- *
- * perf bench sched pipe -l 10000
- *
- * Run multiple times to avoid cpufreq effects.
- */
-#define CPUIDLE_POLL_MIN 10000
-#define CPUIDLE_POLL_MAX (TICK_NSEC / 16)
-
 /**
  * cpuidle_poll_time - return amount of time to poll for,
  * governors can override dev->poll_limit_ns if necessary
@@ -435,7 +545,7 @@ __cpuidle u64 cpuidle_poll_time(struct cpuidle_driver *drv,
 	BUILD_BUG_ON(CPUIDLE_POLL_MIN > CPUIDLE_POLL_MAX);
 
 	if (dev->poll_limit_ns)
-		return dev->poll_limit_ns;
+		goto out;
 
 	limit_ns = CPUIDLE_POLL_MAX;
 	for (i = 1; i < drv->state_count; i++) {
@@ -453,6 +563,11 @@ __cpuidle u64 cpuidle_poll_time(struct cpuidle_driver *drv,
 	}
 
 	dev->poll_limit_ns = limit_ns;
+	dev->poll_adaptive_ns = 0;
+
+out:
+	if (dev->poll_adaptive_ns && dev->poll_adaptive_ns < dev->poll_limit_ns)
+		return dev->poll_adaptive_ns;
 
 	return dev->poll_limit_ns;
 }
@@ -808,9 +923,14 @@ static int __init cpuidle_init(void)
 	if (cpuidle_disabled())
 		return -ENODEV;
 
+	if (stats_sample > 1)
+		static_branch_enable(&cpuidle_sampled_stats);
+
 	return cpuidle_add_interface();
 }
 
 module_param(off, int, 0444);
+module_param(adaptive_poll, bool, 0644);
+module_param(stats_sample, uint, 0444);
 module_param_string(governor, param_governor, CPUIDLE_NAME_LEN, 0444);
 core_initcall(cpuidle_init);
@@ -37,6 +37,17 @@ extern void cpuidle_remove_device_sysfs(struct cpuidle_device *device);
 extern int cpuidle_add_sysfs(struct cpuidle_device *dev);
 extern void cpuidle_remove_sysfs(struct cpuidle_device *dev);
 
+#ifdef CONFIG_CPU_IDLE_TELEMETRY
+void cpuidle_telemetry_record(struct cpuidle_device *dev,
+			      struct cpuidle_driver *drv, int index,
+			      ktime_t start, u64 residency_ns);
+#else
+static inline void cpuidle_telemetry_record(struct cpuidle_device *dev,
+					    struct cpuidle_driver *drv,
+					    int index, ktime_t start,
+					    u64 residency_ns) {}
+#endif
+
 #ifdef CONFIG_ARCH_NEEDS_CPU_IDLE_COUPLED
 bool cpuidle_state_is_coupled(struct cpuidle_driver *drv, int state);
 int cpuidle_coupled_state_verify(struct cpuidle_driver *drv);
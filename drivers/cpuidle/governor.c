@@ -110,10 +110,10 @@ s64 cpuidle_governor_latency_req(unsigned int cpu)
 {
 	struct device *device = get_cpu_device(cpu);
 	int device_req = dev_pm_qos_raw_resume_latency(device);
-	int global_req = cpu_latency_qos_limit();
+	int qos_req = cpu_latency_qos_limit_cpu(cpu);
 
-	if (device_req > global_req)
-		device_req = global_req;
+	if (device_req > qos_req)
+		device_req = qos_req;
 
 	return (s64)device_req * NSEC_PER_USEC;
 }
@@ -12,6 +12,7 @@
 
 #include <linux/kernel.h>
 #include <linux/cpuidle.h>
+#include <linux/cpuidle_haltpoll.h>
 #include <linux/time.h>
 #include <linux/ktime.h>
 #include <linux/hrtimer.h>
@@ -118,6 +119,8 @@ static void haltpoll_reflect(struct cpuidle_device *dev, int index)
 
 	if (index != 0)
 		adjust_poll_limit(dev, dev->last_residency_ns);
+
+	arch_haltpoll_update(dev->poll_limit_ns, dev->last_residency_ns);
 }
 
 /**
@@ -136,6 +139,7 @@ static int haltpoll_enable_device(struct cpuidle_driver *drv,
 static struct cpuidle_governor haltpoll_governor = {
 	.name =			"haltpoll",
 	.rating =		9,
+	.owns_poll_limit =	true,
 	.enable =		haltpoll_enable_device,
 	.select =		haltpoll_select,
 	.reflect =		haltpoll_reflect,
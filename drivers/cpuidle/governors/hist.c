@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Idle duration histogram CPU idle governor
+ */
+
+/**
+ * DOC: hist-description
+ *
+ * This governor is meant for kernels running with a periodic tick, where the
+ * time till the next timer event is not known in advance and the tick limits
+ * the CPU idle duration anyway.  It is a drop-in replacement for the ladder
+ * governor, which only ever moves one state up or down at a time and so takes
+ * many idle periods to reach the deep states on platforms with a lot of them.
+ *
+ * The governor keeps a histogram of the recent idle durations of every CPU.
+ * Its bins are aligned with the target residencies of the idle states: bin i
+ * spans from the target residency of idle state i up to, but not including,
+ * the target residency of idle state i + 1, and the last bin spans from the
+ * target residency of the deepest state to infinity.  The bins decay
+ * exponentially, so the histogram follows changes of the workload.
+ *
+ * The state to select is the deepest one for which more than a half of the
+ * recent idle periods would have been long enough to meet its target
+ * residency.  It is computed when the CPU wakes up (in ->reflect()), so the
+ * selection itself only needs to check it against the latency constraint and
+ * the disabled states, which is O(1) unless one of these rules it out.
+ */
+
+#include <linux/cpuidle.h>
+#include <linux/jiffies.h>
+#include <linux/kernel.h>
+#include <linux/percpu.h>
+#include <linux/tick.h>
+
+/*
+ * The histogram bins decay by 1/2^HIST_DECAY_SHIFT on every update, so the
+ * sum of them converges to HIST_PULSE.
+ */
+#define HIST_PULSE		1024
+#define HIST_DECAY_SHIFT	3
+
+/**
+ * struct hist_cpu - CPU data used by the histogram governor.
+ * @bins: Decaying idle duration counts per idle state bin.
+ * @candidate: Idle state to select if allowed by the constraints.
+ */
+struct hist_cpu {
+	unsigned int bins[CPUIDLE_STATE_MAX];
+	int candidate;
+};
+
+static DEFINE_PER_CPU(struct hist_cpu, hist_cpus);
+
+static int hist_first_idx(struct cpuidle_driver *drv)
+{
+	return drv->states[0].flags & CPUIDLE_FLAG_POLLING ? 1 : 0;
+}
+
+/**
+ * hist_select - Select an idle state for the given CPU.
+ * @drv: cpuidle driver containing state data.
+ * @dev: Target CPU.
+ * @stop_tick: Indication on whether or not to stop the scheduler tick.
+ */
+static int hist_select(struct cpuidle_driver *drv, struct cpuidle_device *dev,
+		       bool *stop_tick)
+{
+	struct hist_cpu *cpu_data = this_cpu_ptr(&hist_cpus);
+	s64 latency_req = cpuidle_governor_latency_req(dev->cpu);
+	int idx = min(cpu_data->candidate, drv->state_count - 1);
+
+	/* Fall back to a shallower state if the candidate cannot be used. */
+	while (idx > 0 && (dev->states_usage[idx].disable ||
+			   drv->states[idx].exit_latency_ns > latency_req))
+		idx--;
+
+	/*
+	 * The governor does not know when the next timer will trigger, so do
+	 * not let the CPU stay in a shallow state without the tick.
+	 */
+	if (drv->states[idx].target_residency_ns < TICK_NSEC)
+		*stop_tick = false;
+
+	return idx;
+}
+
+/**
+ * hist_reflect - Update the histogram after an idle period.
+ * @dev: Target CPU.
+ * @state: Entered state.
+ */
+static void hist_reflect(struct cpuidle_device *dev, int state)
+{
+	struct cpuidle_driver *drv = cpuidle_get_cpu_driver(dev);
+	struct hist_cpu *cpu_data = this_cpu_ptr(&hist_cpus);
+	unsigned int total = 0, sum = 0;
+	s64 measured_ns;
+	int i, idx_bin;
+
+	dev->last_state_idx = state;
+
+	if (!drv || state < 0)
+		return;
+
+	if (dev->poll_time_limit) {
+		/*
+		 * The polling state has been left because of its time limit,
+		 * so the CPU would have been idle longer, possibly much longer.
+		 * Count that as a long idle period, like menu and teo do, or
+		 * the histogram would never move away from polling.
+		 */
+		idx_bin = drv->state_count - 1;
+	} else {
+		/* The exit latency is part of the measured time, not idle time. */
+		measured_ns = dev->last_residency_ns -
+					drv->states[state].exit_latency_ns;
+
+		idx_bin = 0;
+		for (i = drv->state_count - 1; i > 0; i--) {
+			if (measured_ns >= drv->states[i].target_residency_ns) {
+				idx_bin = i;
+				break;
+			}
+		}
+	}
+
+	for (i = 0; i < drv->state_count; i++) {
+		cpu_data->bins[i] -= cpu_data->bins[i] >> HIST_DECAY_SHIFT;
+		if (i == idx_bin)
+			cpu_data->bins[i] += HIST_PULSE >> HIST_DECAY_SHIFT;
+
+		total += cpu_data->bins[i];
+	}
+
+	/*
+	 * Find the deepest state whose target residency would have been met in
+	 * more than a half of the recent idle periods.
+	 */
+	for (i = drv->state_count - 1; i > 0; i--) {
+		sum += cpu_data->bins[i];
+		if (2 * sum > total)
+			break;
+	}
+
+	cpu_data->candidate = i;
+}
+
+/**
+ * hist_enable_device - Initialize the governor's data for the target CPU.
+ * @drv: cpuidle driver.
+ * @dev: Target CPU.
+ */
+static int hist_enable_device(struct cpuidle_driver *drv,
+			      struct cpuidle_device *dev)
+{
+	struct hist_cpu *cpu_data = per_cpu_ptr(&hist_cpus, dev->cpu);
+
+	memset(cpu_data, 0, sizeof(*cpu_data));
+	/* Start from the shallowest "real" state until there is history. */
+	cpu_data->candidate = hist_first_idx(drv);
+
+	return 0;
+}
+
+static struct cpuidle_governor hist_governor = {
+	.name =		"hist",
+	.rating =	10,
+	.enable =	hist_enable_device,
+	.select =	hist_select,
+	.reflect =	hist_reflect,
+};
+
+static int __init hist_governor_init(void)
+{
+	/*
+	 * With the periodic tick, prefer this governor to the ladder one, which
+	 * is rated 25 in that case.
+	 */
+	if (!tick_nohz_enabled)
+		hist_governor.rating = 26;
+
+	return cpuidle_register_governor(&hist_governor);
+}
+
+postcore_initcall(hist_governor_init);
@@ -311,6 +311,8 @@ static int menu_select(struct cpuidle_driver *drv, struct cpuidle_device *dev,
 		data->bucket = which_bucket(KTIME_MAX, nr_iowaiters);
 	}
 
+	cpuidle_telemetry_predict(dev, predicted_ns, data->next_timer_ns);
+
 	if (unlikely(drv->state_count <= 1 || latency_req == 0) ||
 	    ((data->next_timer_ns < drv->states[1].target_residency_ns ||
 	      latency_req < drv->states[1].exit_latency_ns) &&
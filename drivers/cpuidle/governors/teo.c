@@ -130,9 +130,20 @@
  * util to the precomputed util threshold. If it's below, it defaults to the
  * TEO metrics mechanism. If it's above, the closest shallower idle state will
  * be selected instead, as long as is not a polling state.
+ *
+ * Interrupt timings:
+ *
+ * If CONFIG_CPU_IDLE_GOV_TEO_IRQ_TIMINGS is set, the governor also uses the
+ * prediction of the next device interrupt on the CPU provided by the IRQ
+ * timings code (based on the recent inter-arrival times of the interrupts
+ * handled by it).  If that interrupt is expected before the closest timer
+ * event and before the target residency of the selected state, a shallower
+ * state matching the predicted interrupt is selected and the tick is not
+ * stopped if the interrupt is expected within the tick period.
  */
 
 #include <linux/cpuidle.h>
+#include <linux/interrupt.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
 #include <linux/sched.h>
@@ -364,6 +375,25 @@ static int teo_find_shallower_state(struct cpuidle_driver *drv,
 	return state_idx;
 }
 
+#ifdef CONFIG_CPU_IDLE_GOV_TEO_IRQ_TIMINGS
+/* Return the time till the next device interrupt predicted for this CPU. */
+static s64 teo_irq_next_event_ns(void)
+{
+	u64 now = local_clock();
+	u64 next = irq_timings_next_event(now);
+
+	if (next == U64_MAX)
+		return KTIME_MAX;
+
+	return next > now ? next - now : 0;
+}
+#else
+static inline s64 teo_irq_next_event_ns(void)
+{
+	return KTIME_MAX;
+}
+#endif
+
 /**
  * teo_select - Selects the next idle state to enter.
  * @drv: cpuidle driver containing state data.
@@ -388,6 +418,7 @@ static int teo_select(struct cpuidle_driver *drv, struct cpuidle_device *dev,
 	bool alt_intercepts, alt_recent;
 	bool cpu_utilized;
 	s64 duration_ns;
+	s64 irq_ns;
 	int i;
 
 	if (dev->last_state_idx >= 0) {
@@ -601,6 +632,23 @@ static int teo_select(struct cpuidle_driver *drv, struct cpuidle_device *dev,
 			idx = i;
 	}
 
+	/*
+	 * If a device interrupt is expected to arrive before the closest timer
+	 * and before the target residency of the candidate state, a shallower
+	 * one matching the interrupt is likely to be a better choice.
+	 */
+	irq_ns = teo_irq_next_event_ns();
+	if (irq_ns < duration_ns) {
+		if (drv->states[idx].target_residency_ns > irq_ns) {
+			i = teo_find_shallower_state(drv, dev, idx, irq_ns, false);
+			if (teo_state_ok(i, drv))
+				idx = i;
+		}
+		duration_ns = irq_ns;
+	}
+
+	cpuidle_telemetry_predict(dev, duration_ns, cpu_data->sleep_length_ns);
+
 	/*
 	 * If the selected state's target residency is below the tick length
 	 * and intercepts occurring before the tick length are the majority of
@@ -689,6 +737,10 @@ static struct cpuidle_governor teo_governor = {
 
 static int __init teo_governor_init(void)
 {
+#ifdef CONFIG_CPU_IDLE_GOV_TEO_IRQ_TIMINGS
+	irq_timings_enable();
+#endif
+
 	return cpuidle_register_governor(&teo_governor);
 }
 
@@ -15,6 +15,7 @@
 #include <linux/capability.h>
 #include <linux/device.h>
 #include <linux/kobject.h>
+#include <linux/workqueue.h>
 
 #include "cpuidle.h"
 
@@ -460,33 +461,45 @@ static const struct kobj_type ktype_state_cpuidle = {
 	.release = cpuidle_state_sysfs_release,
 };
 
-static inline void cpuidle_free_state_kobj(struct cpuidle_device *device, int i)
+static void cpuidle_free_state_kobjs(struct cpuidle_device *device, int nr)
 {
-	cpuidle_remove_s2idle_attr_group(device->kobjs[i]);
-	kobject_put(&device->kobjs[i]->kobj);
-	wait_for_completion(&device->kobjs[i]->kobj_unregister);
-	kfree(device->kobjs[i]);
-	device->kobjs[i] = NULL;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		cpuidle_remove_s2idle_attr_group(&device->kobjs[i]);
+		kobject_put(&device->kobjs[i].kobj);
+	}
+
+	for (i = 0; i < nr; i++)
+		wait_for_completion(&device->kobjs[i].kobj_unregister);
+
+	kfree(device->kobjs);
+	device->kobjs = NULL;
+	device->nr_kobjs = 0;
 }
 
 /**
  * cpuidle_add_state_sysfs - adds cpuidle states sysfs attributes
  * @device: the target device
+ *
+ * The state objects of a device are allocated as one array, sized to the
+ * number of states of its driver.
  */
 static int cpuidle_add_state_sysfs(struct cpuidle_device *device)
 {
-	int i, ret = -ENOMEM;
+	int i, ret;
 	struct cpuidle_state_kobj *kobj;
 	struct cpuidle_device_kobj *kdev = device->kobj_dev;
 	struct cpuidle_driver *drv = cpuidle_get_cpu_driver(device);
 
+	device->kobjs = kcalloc(drv->state_count, sizeof(*device->kobjs),
+				GFP_KERNEL);
+	if (!device->kobjs)
+		return -ENOMEM;
+
 	/* state statistics */
 	for (i = 0; i < drv->state_count; i++) {
-		kobj = kzalloc(sizeof(struct cpuidle_state_kobj), GFP_KERNEL);
-		if (!kobj) {
-			ret = -ENOMEM;
-			goto error_state;
-		}
+		kobj = &device->kobjs[i];
 		kobj->state = &drv->states[i];
 		kobj->state_usage = &device->states_usage[i];
 		kobj->device = device;
@@ -496,19 +509,18 @@ static int cpuidle_add_state_sysfs(struct cpuidle_device *device)
 					   &kdev->kobj, "state%d", i);
 		if (ret) {
 			kobject_put(&kobj->kobj);
-			kfree(kobj);
+			wait_for_completion(&kobj->kobj_unregister);
 			goto error_state;
 		}
 		cpuidle_add_s2idle_attr_group(kobj);
 		kobject_uevent(&kobj->kobj, KOBJ_ADD);
-		device->kobjs[i] = kobj;
 	}
 
+	device->nr_kobjs = drv->state_count;
 	return 0;
 
 error_state:
-	for (i = i - 1; i >= 0; i--)
-		cpuidle_free_state_kobj(device, i);
+	cpuidle_free_state_kobjs(device, i);
 	return ret;
 }
 
@@ -518,11 +530,20 @@ static int cpuidle_add_state_sysfs(struct cpuidle_device *device)
  */
 static void cpuidle_remove_state_sysfs(struct cpuidle_device *device)
 {
-	struct cpuidle_driver *drv = cpuidle_get_cpu_driver(device);
-	int i;
+	if (device->kobjs)
+		cpuidle_free_state_kobjs(device, device->nr_kobjs);
+}
 
-	for (i = 0; i < drv->state_count; i++)
-		cpuidle_free_state_kobj(device, i);
+static void cpuidle_state_sysfs_workfn(struct work_struct *work)
+{
+	struct cpuidle_device *device = container_of(work, struct cpuidle_device,
+						     sysfs_work);
+	int ret;
+
+	ret = cpuidle_add_state_sysfs(device);
+	if (ret)
+		pr_warn("cpuidle: cpu%u: failed to add state attributes: %d\n",
+			device->cpu, ret);
 }
 
 #ifdef CONFIG_CPU_IDLE_MULTIPLE_DRIVERS
@@ -670,14 +691,20 @@ int cpuidle_add_device_sysfs(struct cpuidle_device *device)
 {
 	int ret;
 
-	ret = cpuidle_add_state_sysfs(device);
+	ret = cpuidle_add_driver_sysfs(device);
 	if (ret)
 		return ret;
 
-	ret = cpuidle_add_driver_sysfs(device);
-	if (ret)
-		cpuidle_remove_state_sysfs(device);
-	return ret;
+	/*
+	 * The stateN directories are only needed by user space, so add them
+	 * from a work item instead of under cpuidle_lock.  Creating them for
+	 * every CPU takes a while on big systems and it is done again every
+	 * time the devices are re-enabled with idle paused.
+	 */
+	INIT_WORK(&device->sysfs_work, cpuidle_state_sysfs_workfn);
+	queue_work(system_unbound_wq, &device->sysfs_work);
+
+	return 0;
 }
 
 /**
@@ -686,6 +713,7 @@ int cpuidle_add_device_sysfs(struct cpuidle_device *device)
  */
 void cpuidle_remove_device_sysfs(struct cpuidle_device *device)
 {
+	cancel_work_sync(&device->sysfs_work);
 	cpuidle_remove_driver_sysfs(device);
 	cpuidle_remove_state_sysfs(device);
 }
@@ -0,0 +1,175 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * telemetry.c - Per-CPU record of idle state selections and their outcomes.
+ *
+ * For every idle entry, the state that was entered, the duration predicted by
+ * the governor, the time till the next timer event and the measured residency
+ * are stored in a ring buffer owned by the given CPU.  The buffers are lockless
+ * (each of them has one writer) and can be memory-mapped by user space, see
+ * include/uapi/linux/cpuidle_telemetry.h for the layout.
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpuidle.h>
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/init.h>
+#include <linux/jump_label.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/moduleparam.h>
+#include <linux/percpu.h>
+#include <linux/vmalloc.h>
+#include <uapi/linux/cpuidle_telemetry.h>
+
+#include "cpuidle.h"
+
+#undef MODULE_PARAM_PREFIX
+#define MODULE_PARAM_PREFIX "cpuidle."
+
+struct cpuidle_telemetry_buf {
+	struct cpuidle_telemetry_header hdr;
+	struct cpuidle_telemetry_entry entries[] ____cacheline_aligned;
+};
+
+static unsigned int telemetry_entries = 1024;
+module_param(telemetry_entries, uint, 0444);
+
+static DEFINE_STATIC_KEY_FALSE(cpuidle_telemetry_key);
+static DEFINE_PER_CPU(struct cpuidle_telemetry_buf *, cpuidle_telemetry_bufs);
+
+static u32 cpuidle_telemetry_wakeup(struct cpuidle_device *dev,
+				     struct cpuidle_state *state, u64 residency_ns)
+{
+	if (state->flags & CPUIDLE_FLAG_POLLING)
+		return CPUIDLE_WAKEUP_POLL;
+
+	if (!dev->telemetry_sleep_length_ns)
+		return CPUIDLE_WAKEUP_UNKNOWN;
+
+	/* Allow for the exit latency in the measured residency. */
+	if (residency_ns + state->exit_latency_ns >= dev->telemetry_sleep_length_ns)
+		return CPUIDLE_WAKEUP_TIMER;
+
+	return CPUIDLE_WAKEUP_NON_TIMER;
+}
+
+/**
+ * cpuidle_telemetry_record - Record the outcome of an idle entry.
+ * @dev: cpuidle device of the local CPU.
+ * @drv: cpuidle driver of the local CPU.
+ * @index: Index of the idle state that has been entered.
+ * @start: Time of the idle entry.
+ * @residency_ns: Measured idle duration.
+ *
+ * Called by cpuidle_enter_state() on the local CPU with preemption disabled.
+ */
+void cpuidle_telemetry_record(struct cpuidle_device *dev,
+			      struct cpuidle_driver *drv, int index,
+			      ktime_t start, u64 residency_ns)
+{
+	struct cpuidle_telemetry_buf *buf;
+	struct cpuidle_telemetry_entry *e;
+	u64 head;
+
+	if (!static_branch_unlikely(&cpuidle_telemetry_key))
+		return;
+
+	buf = __this_cpu_read(cpuidle_telemetry_bufs);
+	if (!buf)
+		goto out;
+
+	head = buf->hdr.head;
+	e = &buf->entries[head & (buf->hdr.nr_entries - 1)];
+
+	WRITE_ONCE(e->seq, CPUIDLE_TELEMETRY_SEQ_BUSY);
+	smp_wmb();
+
+	e->time_ns = ktime_to_ns(start);
+	e->predicted_ns = dev->telemetry_predicted_ns;
+	e->sleep_length_ns = dev->telemetry_sleep_length_ns;
+	e->residency_ns = residency_ns;
+	e->state = index;
+	e->wakeup = cpuidle_telemetry_wakeup(dev, &drv->states[index], residency_ns);
+
+	smp_store_release(&e->seq, head);
+	smp_store_release(&buf->hdr.head, head + 1);
+
+out:
+	/* Make sure the governor's data for this entry is not used again. */
+	dev->telemetry_predicted_ns = 0;
+	dev->telemetry_sleep_length_ns = 0;
+}
+
+static int cpuidle_telemetry_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct cpuidle_telemetry_buf *buf = file->private_data;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	vm_flags_clear(vma, VM_MAYWRITE);
+
+	return remap_vmalloc_range(vma, buf, vma->vm_pgoff);
+}
+
+static int cpuidle_telemetry_open(struct inode *inode, struct file *file)
+{
+	file->private_data = inode->i_private;
+	return 0;
+}
+
+static const struct file_operations cpuidle_telemetry_fops = {
+	.owner = THIS_MODULE,
+	.open = cpuidle_telemetry_open,
+	.mmap = cpuidle_telemetry_mmap,
+	.llseek = noop_llseek,
+};
+
+static int __init cpuidle_telemetry_init(void)
+{
+	struct dentry *dir;
+	unsigned int cpu;
+	size_t size;
+
+	if (cpuidle_disabled() || !telemetry_entries)
+		return 0;
+
+	telemetry_entries = roundup_pow_of_two(telemetry_entries);
+	size = PAGE_ALIGN(struct_size_t(struct cpuidle_telemetry_buf, entries,
+					telemetry_entries));
+
+	dir = debugfs_create_dir("cpuidle_telemetry", NULL);
+
+	for_each_possible_cpu(cpu) {
+		struct cpuidle_telemetry_buf *buf;
+		char name[16];
+
+		buf = vmalloc_user(size);
+		if (!buf)
+			goto err;
+
+		buf->hdr.version = CPUIDLE_TELEMETRY_VERSION;
+		buf->hdr.nr_entries = telemetry_entries;
+		buf->hdr.entry_size = sizeof(struct cpuidle_telemetry_entry);
+		buf->hdr.header_size = offsetof(struct cpuidle_telemetry_buf, entries);
+		per_cpu(cpuidle_telemetry_bufs, cpu) = buf;
+
+		snprintf(name, sizeof(name), "cpu%u", cpu);
+		/* The file is never removed and the full proxy cannot mmap. */
+		debugfs_create_file_unsafe(name, 0400, dir, buf,
+					   &cpuidle_telemetry_fops);
+	}
+
+	static_branch_enable(&cpuidle_telemetry_key);
+	return 0;
+
+err:
+	debugfs_remove_recursive(dir);
+	for_each_possible_cpu(cpu) {
+		vfree(per_cpu(cpuidle_telemetry_bufs, cpu));
+		per_cpu(cpuidle_telemetry_bufs, cpu) = NULL;
+	}
+	return -ENOMEM;
+}
+late_initcall(cpuidle_telemetry_init);
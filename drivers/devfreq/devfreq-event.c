@@ -15,6 +15,7 @@
 #include <linux/export.h>
 #include <linux/slab.h>
 #include <linux/list.h>
+#include <linux/module.h>
 #include <linux/of.h>
 
 static struct class *devfreq_event_class;
@@ -25,6 +26,96 @@ static DEFINE_MUTEX(devfreq_event_list_lock);
 
 #define to_devfreq_event(DEV) container_of(DEV, struct devfreq_event_dev, dev)
 
+/*
+ * With sample_ms set, the counters of enabled devfreq-event devices are read
+ * and restarted in the background, and devfreq_event_get_event() returns the
+ * counts accumulated since its previous call without touching the hardware.
+ * Reading the counters more often than the devfreq polling interval also
+ * keeps narrow hardware counters from overflowing.
+ */
+static unsigned int sample_ms;
+module_param(sample_ms, uint, 0444);
+MODULE_PARM_DESC(sample_ms, "Read the event counters in the background every sample_ms (0 to read them on demand)");
+
+/*
+ * Number of consecutive devfreq_event_get_event() calls less than sample_ms
+ * apart after which the background sampling is given up on.
+ */
+#define SAMPLE_SHORT_POLLS	4
+
+/* Called with edev->lock held. */
+static void devfreq_event_sample(struct devfreq_event_dev *edev)
+{
+	struct devfreq_event_data edata = { };
+
+	if (edev->desc->ops->get_event(edev, &edata) >= 0) {
+		write_seqcount_begin(&edev->sample_seq);
+		edev->load_sum += edata.load_count;
+		edev->total_sum += edata.total_count;
+		write_seqcount_end(&edev->sample_seq);
+	}
+	edev->desc->ops->set_event(edev);
+}
+
+static void devfreq_event_sample_work(struct work_struct *work)
+{
+	struct devfreq_event_dev *edev = container_of(work,
+				struct devfreq_event_dev, sample_work.work);
+
+	mutex_lock(&edev->lock);
+	if (!edev->sampling)
+		goto out;
+
+	devfreq_event_sample(edev);
+
+	queue_delayed_work(system_freezable_power_efficient_wq,
+			   &edev->sample_work, msecs_to_jiffies(sample_ms));
+out:
+	mutex_unlock(&edev->lock);
+}
+
+/*
+ * The polling interval of the consumer is not known here, so tell it from the
+ * intervals between devfreq_event_get_event() calls.  Sampling in the
+ * background at most as often as the consumer polls only adds overhead, so go
+ * back to reading the counters on demand in that case.
+ */
+static void devfreq_event_check_polling(struct devfreq_event_dev *edev)
+{
+	unsigned long now = jiffies;
+
+	if (edev->last_get &&
+	    time_before(now, edev->last_get + msecs_to_jiffies(sample_ms)))
+		edev->short_polls++;
+	else
+		edev->short_polls = 0;
+
+	edev->last_get = now;
+
+	if (edev->short_polls < SAMPLE_SHORT_POLLS)
+		return;
+
+	dev_warn(&edev->dev,
+		 "sample_ms is not below the polling interval, reading the counters on demand\n");
+
+	mutex_lock(&edev->lock);
+	edev->sampling = false;
+	mutex_unlock(&edev->lock);
+}
+
+/* Called with edev->lock held when the device gets enabled. */
+static void devfreq_event_start_sampling(struct devfreq_event_dev *edev)
+{
+	if (!sample_ms || edev->desc->ops->set_event(edev) < 0)
+		return;
+
+	edev->sampling = true;
+	edev->last_get = 0;
+	edev->short_polls = 0;
+	queue_delayed_work(system_freezable_power_efficient_wq,
+			   &edev->sample_work, msecs_to_jiffies(sample_ms));
+}
+
 /**
  * devfreq_event_enable_edev() - Enable the devfreq-event dev and increase
  *				 the enable_count of devfreq-event dev.
@@ -48,6 +139,8 @@ int devfreq_event_enable_edev(struct devfreq_event_dev *edev)
 		if (ret < 0)
 			goto err;
 	}
+	if (edev->enable_count == 0)
+		devfreq_event_start_sampling(edev);
 	edev->enable_count++;
 err:
 	mutex_unlock(&edev->lock);
@@ -86,6 +179,9 @@ int devfreq_event_disable_edev(struct devfreq_event_dev *edev)
 		if (ret < 0)
 			goto err;
 	}
+	/* A pending sample_work sees this and does not requeue itself. */
+	if (edev->enable_count == 1)
+		edev->sampling = false;
 	edev->enable_count--;
 err:
 	mutex_unlock(&edev->lock);
@@ -138,6 +234,10 @@ int devfreq_event_set_event(struct devfreq_event_dev *edev)
 	if (!edev->desc->ops || !edev->desc->ops->set_event)
 		return -EINVAL;
 
+	/* The counters are restarted by the sampling. */
+	if (READ_ONCE(edev->sampling))
+		return 0;
+
 	if (!devfreq_event_is_enabled(edev))
 		return -EPERM;
 
@@ -155,11 +255,16 @@ EXPORT_SYMBOL_GPL(devfreq_event_set_event);
  * @edata	: the calculated data of devfreq-event device
  *
  * Note that this function get the calculated event data from devfreq-event dev
- * after stoping the progress of whole sequence of devfreq-event dev.
+ * after stoping the progress of whole sequence of devfreq-event dev. If the
+ * counters are sampled in the background, it returns the counts accumulated
+ * since its previous call instead, without any register access unless no
+ * sample has been taken since then.
  */
 int devfreq_event_get_event(struct devfreq_event_dev *edev,
 			    struct devfreq_event_data *edata)
 {
+	u64 load, total;
+	unsigned int seq;
 	int ret;
 
 	if (!edev || !edev->desc)
@@ -168,6 +273,39 @@ int devfreq_event_get_event(struct devfreq_event_dev *edev,
 	if (!edev->desc->ops || !edev->desc->ops->get_event)
 		return -EINVAL;
 
+	if (READ_ONCE(edev->sampling)) {
+		do {
+			seq = read_seqcount_begin(&edev->sample_seq);
+			load = edev->load_sum;
+			total = edev->total_sum;
+		} while (read_seqcount_retry(&edev->sample_seq, seq));
+
+		/*
+		 * If no sample has landed since the previous call, because
+		 * the deferrable work has been delayed or the polling is
+		 * faster than sample_ms, read the counters now instead of
+		 * reporting a zero time window, which the governors would
+		 * take for an unknown load.
+		 */
+		if (total == edev->total_last) {
+			mutex_lock(&edev->lock);
+			if (edev->sampling)
+				devfreq_event_sample(edev);
+			load = edev->load_sum;
+			total = edev->total_sum;
+			mutex_unlock(&edev->lock);
+		}
+
+		devfreq_event_check_polling(edev);
+
+		edata->load_count = load - edev->load_last;
+		edata->total_count = total - edev->total_last;
+		edev->load_last = load;
+		edev->total_last = total;
+
+		return 0;
+	}
+
 	if (!devfreq_event_is_enabled(edev))
 		return -EINVAL;
 
@@ -322,6 +460,8 @@ struct devfreq_event_dev *devfreq_event_add_edev(struct device *dev,
 		return ERR_PTR(-ENOMEM);
 
 	mutex_init(&edev->lock);
+	INIT_DEFERRABLE_WORK(&edev->sample_work, devfreq_event_sample_work);
+	seqcount_mutex_init(&edev->sample_seq, &edev->lock);
 	edev->desc = desc;
 	edev->enable_count = 0;
 	edev->dev.parent = dev;
@@ -358,6 +498,7 @@ int devfreq_event_remove_edev(struct devfreq_event_dev *edev)
 		return -EINVAL;
 
 	WARN_ON(edev->enable_count);
+	cancel_delayed_work_sync(&edev->sample_work);
 
 	mutex_lock(&devfreq_event_list_lock);
 	list_del(&edev->node);
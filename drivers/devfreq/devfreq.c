@@ -9,9 +9,12 @@
 
 #include <linux/kernel.h>
 #include <linux/kmod.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
 #include <linux/sched.h>
 #include <linux/debugfs.h>
 #include <linux/devfreq_cooling.h>
+#include <linux/energy_model.h>
 #include <linux/errno.h>
 #include <linux/err.h>
 #include <linux/init.h>
@@ -36,6 +39,10 @@
 #define IS_SUPPORTED_FLAG(f, name) ((f & DEVFREQ_GOV_FLAG_##name) ? true : false)
 #define IS_SUPPORTED_ATTR(f, name) ((f & DEVFREQ_GOV_ATTR_##name) ? true : false)
 
+/* Default load thresholds for DEVFREQ_TIMER_EVENT, in percent */
+#define DEVFREQ_EVENT_UP_THRESHOLD	90
+#define DEVFREQ_EVENT_DOWN_THRESHOLD	50
+
 static struct class *devfreq_class;
 static struct dentry *devfreq_debugfs;
 
@@ -55,6 +62,7 @@ static DEFINE_MUTEX(devfreq_list_lock);
 static const char timer_name[][DEVFREQ_NAME_LEN] = {
 	[DEVFREQ_TIMER_DEFERRABLE] = { "deferrable" },
 	[DEVFREQ_TIMER_DELAYED] = { "delayed" },
+	[DEVFREQ_TIMER_EVENT] = { "event" },
 };
 
 /**
@@ -241,6 +249,15 @@ int devfreq_update_status(struct devfreq *devfreq, unsigned long freq)
 	}
 
 	if (lev != prev_lev) {
+		ktime_t now = ktime_get();
+		s64 res = ktime_us_delta(now, devfreq->stats.state_entry);
+		int bucket = res > 0 ? ilog2(res) : 0;
+
+		bucket = min(bucket, DEVFREQ_RES_HIST_BUCKETS - 1);
+		devfreq->stats.res_hist[
+			(prev_lev * DEVFREQ_RES_HIST_BUCKETS) + bucket]++;
+		devfreq->stats.state_entry = now;
+
 		devfreq->stats.trans_table[
 			(prev_lev * devfreq->max_state) + lev]++;
 		devfreq->stats.total_trans++;
@@ -468,6 +485,78 @@ static void devfreq_monitor(struct work_struct *work)
 	trace_devfreq_monitor(devfreq);
 }
 
+/* Let the device know when to call devfreq_monitor_trigger() next time. */
+static void devfreq_set_thresholds(struct devfreq *devfreq)
+{
+	struct devfreq_dev_profile *profile = devfreq->profile;
+	unsigned int up = profile->up_threshold ?: DEVFREQ_EVENT_UP_THRESHOLD;
+	unsigned int down = profile->down_threshold ?: DEVFREQ_EVENT_DOWN_THRESHOLD;
+	int err;
+
+	if (!profile->set_thresholds)
+		return;
+
+	err = profile->set_thresholds(devfreq->dev.parent, up, down);
+	if (err)
+		dev_err(&devfreq->dev, "failed to set load thresholds (%d)\n",
+			err);
+}
+
+/**
+ * devfreq_monitor_event() - Evaluate the load of an event driven device.
+ * @work:	the work struct queued by devfreq_monitor_trigger().
+ *
+ * Like devfreq_monitor(), but the work is only requeued for the fallback
+ * polling, if any, and the load thresholds of the device are rearmed.
+ */
+static void devfreq_monitor_event(struct work_struct *work)
+{
+	int err;
+	struct devfreq *devfreq = container_of(work,
+					struct devfreq, work.work);
+
+	mutex_lock(&devfreq->lock);
+	if (devfreq->stop_polling)
+		goto out;
+
+	err = update_devfreq(devfreq);
+	if (err)
+		dev_err(&devfreq->dev, "dvfs failed with (%d) error\n", err);
+
+	devfreq_set_thresholds(devfreq);
+
+	if (devfreq->profile->polling_ms)
+		queue_delayed_work(devfreq_wq, &devfreq->work,
+				msecs_to_jiffies(devfreq->profile->polling_ms));
+out:
+	mutex_unlock(&devfreq->lock);
+
+	trace_devfreq_monitor(devfreq);
+}
+
+/**
+ * devfreq_monitor_trigger() - Request the load of a device to be evaluated
+ * @devfreq:	the devfreq instance.
+ *
+ * To be called by drivers using DEVFREQ_TIMER_EVENT, typically from the
+ * interrupt handler of their load counters, when the load has crossed one of
+ * the thresholds passed to the set_thresholds() callback.  It must be called
+ * from process context, like a threaded interrupt handler, and not after
+ * devfreq_remove_device().  Requests made while the monitoring is not running
+ * are ignored.
+ */
+void devfreq_monitor_trigger(struct devfreq *devfreq)
+{
+	if (devfreq->profile->timer != DEVFREQ_TIMER_EVENT)
+		return;
+
+	mutex_lock(&devfreq->lock);
+	if (devfreq->monitor_started && !devfreq->stop_polling)
+		mod_delayed_work(devfreq_wq, &devfreq->work, 0);
+	mutex_unlock(&devfreq->lock);
+}
+EXPORT_SYMBOL(devfreq_monitor_trigger);
+
 /**
  * devfreq_monitor_start() - Start load monitoring of devfreq instance
  * @devfreq:	the devfreq instance.
@@ -490,10 +579,20 @@ void devfreq_monitor_start(struct devfreq *devfreq)
 	case DEVFREQ_TIMER_DELAYED:
 		INIT_DELAYED_WORK(&devfreq->work, devfreq_monitor);
 		break;
+	case DEVFREQ_TIMER_EVENT:
+		INIT_DEFERRABLE_WORK(&devfreq->work, devfreq_monitor_event);
+		mutex_lock(&devfreq->lock);
+		devfreq_set_thresholds(devfreq);
+		mutex_unlock(&devfreq->lock);
+		break;
 	default:
 		return;
 	}
 
+	mutex_lock(&devfreq->lock);
+	devfreq->monitor_started = true;
+	mutex_unlock(&devfreq->lock);
+
 	if (devfreq->profile->polling_ms)
 		queue_delayed_work(devfreq_wq, &devfreq->work,
 			msecs_to_jiffies(devfreq->profile->polling_ms));
@@ -513,6 +612,10 @@ void devfreq_monitor_stop(struct devfreq *devfreq)
 	if (IS_SUPPORTED_FLAG(devfreq->governor->flags, IRQ_DRIVEN))
 		return;
 
+	mutex_lock(&devfreq->lock);
+	devfreq->monitor_started = false;
+	mutex_unlock(&devfreq->lock);
+
 	cancel_delayed_work_sync(&devfreq->work);
 }
 EXPORT_SYMBOL(devfreq_monitor_stop);
@@ -568,13 +671,17 @@ void devfreq_monitor_resume(struct devfreq *devfreq)
 	if (!devfreq->stop_polling)
 		goto out;
 
-	if (!delayed_work_pending(&devfreq->work) &&
+	/* The load counters may need to be rearmed after suspend. */
+	if (devfreq->profile->timer == DEVFREQ_TIMER_EVENT)
+		mod_delayed_work(devfreq_wq, &devfreq->work, 0);
+	else if (!delayed_work_pending(&devfreq->work) &&
 			devfreq->profile->polling_ms)
 		queue_delayed_work(devfreq_wq, &devfreq->work,
 			msecs_to_jiffies(devfreq->profile->polling_ms));
 
 out_update:
 	devfreq->stats.last_update = get_jiffies_64();
+	devfreq->stats.state_entry = ktime_get();
 	devfreq->stop_polling = false;
 
 	if (devfreq->profile->get_cur_freq &&
@@ -768,6 +875,23 @@ static void devfreq_dev_release(struct device *dev)
 	kfree(devfreq);
 }
 
+/*
+ * Most devfreq drivers don't register an Energy Model for their device, which
+ * leaves it out of EM based power budgeting, like DTPM. Register one from the
+ * OPP table if the firmware provides the power of the OPPs, either directly
+ * or through a dynamic power coefficient, and the driver hasn't done so.
+ */
+static void devfreq_register_em(struct devfreq *devfreq)
+{
+	struct device *dev = devfreq->dev.parent;
+
+	if (!devfreq->opp_table || em_pd_get(dev))
+		return;
+
+	if (!dev_pm_opp_of_register_em(dev, NULL))
+		devfreq->em_registered = true;
+}
+
 static void create_sysfs_files(struct devfreq *devfreq,
 				const struct devfreq_governor *gov);
 static void remove_sysfs_files(struct devfreq *devfreq,
@@ -830,6 +954,14 @@ struct devfreq *devfreq_add_device(struct device *dev,
 		goto err_dev;
 	}
 
+	if ((devfreq->profile->up_threshold ?: DEVFREQ_EVENT_UP_THRESHOLD) > 100 ||
+	    (devfreq->profile->down_threshold ?: DEVFREQ_EVENT_DOWN_THRESHOLD) >=
+	    (devfreq->profile->up_threshold ?: DEVFREQ_EVENT_UP_THRESHOLD)) {
+		mutex_unlock(&devfreq->lock);
+		err = -EINVAL;
+		goto err_dev;
+	}
+
 	if (!devfreq->profile->max_state || !devfreq->profile->freq_table) {
 		mutex_unlock(&devfreq->lock);
 		err = set_freq_table(devfreq);
@@ -893,8 +1025,19 @@ struct devfreq *devfreq_add_device(struct device *dev,
 		goto err_devfreq;
 	}
 
+	devfreq->stats.res_hist = devm_kcalloc(&devfreq->dev,
+			array_size(devfreq->max_state, DEVFREQ_RES_HIST_BUCKETS),
+			sizeof(*devfreq->stats.res_hist),
+			GFP_KERNEL);
+	if (!devfreq->stats.res_hist) {
+		mutex_unlock(&devfreq->lock);
+		err = -ENOMEM;
+		goto err_devfreq;
+	}
+
 	devfreq->stats.total_trans = 0;
 	devfreq->stats.last_update = get_jiffies_64();
+	devfreq->stats.state_entry = ktime_get();
 
 	srcu_init_notifier_head(&devfreq->transition_notifier_list);
 
@@ -947,6 +1090,8 @@ struct devfreq *devfreq_add_device(struct device *dev,
 
 	mutex_unlock(&devfreq_list_lock);
 
+	devfreq_register_em(devfreq);
+
 	if (devfreq->profile->is_cooling_device) {
 		devfreq->cdev = devfreq_cooling_em_register(devfreq, NULL);
 		if (IS_ERR(devfreq->cdev))
@@ -980,6 +1125,9 @@ int devfreq_remove_device(struct devfreq *devfreq)
 
 	devfreq_cooling_unregister(devfreq->cdev);
 
+	if (devfreq->em_registered)
+		em_dev_unregister_perf_domain(devfreq->dev.parent);
+
 	if (devfreq->governor) {
 		devfreq->governor->event_handler(devfreq,
 						 DEVFREQ_GOV_STOP, NULL);
@@ -1758,14 +1906,87 @@ static ssize_t trans_stat_store(struct device *dev,
 	memset(df->stats.trans_table, 0, array3_size(sizeof(unsigned int),
 					df->max_state,
 					df->max_state));
+	memset(df->stats.res_hist, 0, array3_size(sizeof(u32),
+					df->max_state,
+					DEVFREQ_RES_HIST_BUCKETS));
 	df->stats.total_trans = 0;
 	df->stats.last_update = get_jiffies_64();
+	df->stats.state_entry = ktime_get();
 	mutex_unlock(&df->lock);
 
 	return count;
 }
 static DEVICE_ATTR_RW(trans_stat);
 
+/*
+ * Binary snapshot of the statistics, in native byte order, meant for being
+ * collected without parsing trans_stat, whose size grows with the square of
+ * the number of states:
+ *
+ *	u32 number of states
+ *	u32 number of histogram buckets (DEVFREQ_RES_HIST_BUCKETS)
+ *
+ * followed by, for each state in ascending order of the frequency table:
+ *
+ *	u64 frequency
+ *	u64 time in state (msecs)
+ *	u32 histogram of the residencies in the state: bucket i counts the
+ *	    residencies from 2^i to 2^(i+1) - 1 usecs, with the first bucket
+ *	    also counting the shorter ones and the last bucket the longer ones.
+ *
+ * The statistics are reset together with trans_stat.
+ */
+struct devfreq_trans_hist_state {
+	u64 freq;
+	u64 time;
+	u32 hist[DEVFREQ_RES_HIST_BUCKETS];
+} __packed;
+
+static ssize_t trans_hist_read(struct file *filp, struct kobject *kobj,
+			       struct bin_attribute *attr, char *buf,
+			       loff_t off, size_t count)
+{
+	struct devfreq *df = to_devfreq(kobj_to_dev(kobj));
+	struct devfreq_trans_hist_state *states;
+	unsigned int max_state;
+	u32 *hdr;
+	size_t size;
+	ssize_t ret;
+	int i;
+
+	if (!df->profile)
+		return -EINVAL;
+	max_state = df->max_state;
+
+	size = 2 * sizeof(u32) + array_size(max_state, sizeof(*states));
+	hdr = kzalloc(size, GFP_KERNEL);
+	if (!hdr)
+		return -ENOMEM;
+
+	hdr[0] = max_state;
+	hdr[1] = DEVFREQ_RES_HIST_BUCKETS;
+	states = (struct devfreq_trans_hist_state *)&hdr[2];
+
+	mutex_lock(&df->lock);
+	if (!df->stop_polling)
+		devfreq_update_status(df, df->previous_freq);
+
+	for (i = 0; i < max_state; i++) {
+		states[i].freq = df->freq_table[i];
+		states[i].time = jiffies64_to_msecs(df->stats.time_in_state[i]);
+		memcpy(states[i].hist,
+		       &df->stats.res_hist[i * DEVFREQ_RES_HIST_BUCKETS],
+		       sizeof(states[i].hist));
+	}
+	mutex_unlock(&df->lock);
+
+	ret = memory_read_from_buffer(buf, count, &off, hdr, size);
+	kfree(hdr);
+
+	return ret;
+}
+static BIN_ATTR_RO(trans_hist, 0);
+
 static struct attribute *devfreq_attrs[] = {
 	&dev_attr_name.attr,
 	&dev_attr_governor.attr,
@@ -1778,7 +1999,17 @@ static struct attribute *devfreq_attrs[] = {
 	&dev_attr_trans_stat.attr,
 	NULL,
 };
-ATTRIBUTE_GROUPS(devfreq);
+
+static struct bin_attribute *devfreq_bin_attrs[] = {
+	&bin_attr_trans_hist,
+	NULL,
+};
+
+static const struct attribute_group devfreq_group = {
+	.attrs = devfreq_attrs,
+	.bin_attrs = devfreq_bin_attrs,
+};
+__ATTRIBUTE_GROUPS(devfreq);
 
 static ssize_t polling_interval_show(struct device *dev,
 				     struct device_attribute *attr, char *buf)
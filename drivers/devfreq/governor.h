@@ -56,6 +56,8 @@
  * @cur_freq:	the current frequency of the cpu.
  * @min_freq:	the min frequency of the cpu.
  * @max_freq:	the max frequency of the cpu.
+ * @devfreq:	the devfreq device following the cpu.
+ * @opp_nb:	notifier block for the changes of the cpu opp table.
  *
  * This structure stores the required cpu_data of a cpu.
  * This is auto-populated by the governor.
@@ -70,6 +72,18 @@ struct devfreq_cpu_data {
 	unsigned int cur_freq;
 	unsigned int min_freq;
 	unsigned int max_freq;
+
+	struct devfreq *devfreq;
+	struct notifier_block opp_nb;
+
+	/*
+	 * Frequencies of the devfreq device required by the frequencies of the
+	 * cpufreq policy, 0 if there is no required OPP for one, resolved when
+	 * the governor starts and whenever the OPPs change.
+	 */
+	unsigned int nr_map;
+	unsigned int *cpu_freq_map;	/* kHz */
+	unsigned long *dev_freq_map;	/* Hz */
 };
 
 /**
@@ -117,6 +131,10 @@ int devfreq_update_target(struct devfreq *devfreq, unsigned long freq);
 void devfreq_get_freq_range(struct devfreq *devfreq, unsigned long *min_freq,
 			    unsigned long *max_freq);
 
+int devfreq_simple_ondemand_target(struct devfreq *df,
+				   const struct devfreq_simple_ondemand_data *data,
+				   unsigned long *freq);
+
 static inline int devfreq_update_stats(struct devfreq *df)
 {
 	if (!df->profile->get_dev_status)
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ *  linux/drivers/devfreq/governor_bw_ondemand.c
+ *
+ *  Load based frequency selection bounded from below by the bandwidth
+ *  requested from the device through the interconnect framework.
+ */
+
+#include <linux/errno.h>
+#include <linux/interconnect-provider.h>
+#include <linux/module.h>
+#include <linux/devfreq.h>
+#include <linux/pm_opp.h>
+#include "governor.h"
+
+/* Frequency of the lowest OPP serving the requests aggregated at @node. */
+static unsigned long bw_ondemand_bw_freq(struct devfreq *df,
+					 struct devfreq_bw_ondemand_data *data)
+{
+	struct dev_pm_opp *opp;
+	unsigned long freq;
+	unsigned int bw;
+
+	if (!data || !data->node)
+		return 0;
+
+	bw = max(READ_ONCE(data->node->avg_bw), READ_ONCE(data->node->peak_bw));
+	if (!bw)
+		return 0;
+
+	opp = dev_pm_opp_find_bw_ceil(df->dev.parent, &bw, data->bw_index);
+	if (IS_ERR(opp))
+		return PTR_ERR(opp) == -ERANGE ? DEVFREQ_MAX_FREQ : 0;
+
+	freq = dev_pm_opp_get_freq(opp);
+	dev_pm_opp_put(opp);
+
+	return freq;
+}
+
+static int devfreq_bw_ondemand_func(struct devfreq *df, unsigned long *freq)
+{
+	struct devfreq_bw_ondemand_data *data = df->data;
+	int err;
+
+	err = devfreq_simple_ondemand_target(df, data ? &data->ondemand : NULL,
+					     freq);
+	if (err)
+		return err;
+
+	*freq = max(*freq, bw_ondemand_bw_freq(df, data));
+
+	return 0;
+}
+
+static int devfreq_bw_ondemand_handler(struct devfreq *devfreq,
+				unsigned int event, void *data)
+{
+	switch (event) {
+	case DEVFREQ_GOV_START:
+		devfreq_monitor_start(devfreq);
+		break;
+
+	case DEVFREQ_GOV_STOP:
+		devfreq_monitor_stop(devfreq);
+		break;
+
+	case DEVFREQ_GOV_UPDATE_INTERVAL:
+		devfreq_update_interval(devfreq, (unsigned int *)data);
+		break;
+
+	case DEVFREQ_GOV_SUSPEND:
+		devfreq_monitor_suspend(devfreq);
+		break;
+
+	case DEVFREQ_GOV_RESUME:
+		devfreq_monitor_resume(devfreq);
+		break;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static struct devfreq_governor devfreq_bw_ondemand = {
+	.name = DEVFREQ_GOV_BW_ONDEMAND,
+	.attrs = DEVFREQ_GOV_ATTR_POLLING_INTERVAL
+		| DEVFREQ_GOV_ATTR_TIMER,
+	.get_target_freq = devfreq_bw_ondemand_func,
+	.event_handler = devfreq_bw_ondemand_handler,
+};
+
+static int __init devfreq_bw_ondemand_init(void)
+{
+	return devfreq_add_governor(&devfreq_bw_ondemand);
+}
+subsys_initcall(devfreq_bw_ondemand_init);
+
+static void __exit devfreq_bw_ondemand_exit(void)
+{
+	int ret;
+
+	ret = devfreq_remove_governor(&devfreq_bw_ondemand);
+	if (ret)
+		pr_err("%s: failed remove governor %d\n", __func__, ret);
+}
+module_exit(devfreq_bw_ondemand_exit);
+MODULE_DESCRIPTION("DEVFREQ Bandwidth Ondemand governor");
+MODULE_LICENSE("GPL");
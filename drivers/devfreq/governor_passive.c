@@ -17,6 +17,14 @@
 #include <linux/units.h>
 #include "governor.h"
 
+/*
+ * Updates of the devices following cpufreq policies are deferred to this
+ * ordered workqueue, so that they are not carried out from the cpufreq
+ * transition notifier and a burst of transitions of one or several policies
+ * results in a single update of every device, in the order of registration.
+ */
+static struct workqueue_struct *devfreq_passive_wq;
+
 static struct devfreq_cpu_data *
 get_parent_cpu_data(struct devfreq_passive_data *p_data,
 		    struct cpufreq_policy *policy)
@@ -43,10 +51,21 @@ static void delete_parent_cpu_data(struct devfreq_passive_data *p_data)
 		if (parent_cpu_data->opp_table)
 			dev_pm_opp_put_opp_table(parent_cpu_data->opp_table);
 
+		kfree(parent_cpu_data->cpu_freq_map);
+		kfree(parent_cpu_data->dev_freq_map);
 		kfree(parent_cpu_data);
 	}
 }
 
+static void free_cpu_freq_map(struct devfreq_cpu_data *parent_cpu_data)
+{
+	kfree(parent_cpu_data->cpu_freq_map);
+	kfree(parent_cpu_data->dev_freq_map);
+	parent_cpu_data->cpu_freq_map = NULL;
+	parent_cpu_data->dev_freq_map = NULL;
+	parent_cpu_data->nr_map = 0;
+}
+
 static unsigned long get_target_freq_by_required_opp(struct device *p_dev,
 						struct opp_table *p_opp_table,
 						struct opp_table *opp_table,
@@ -74,6 +93,162 @@ static unsigned long get_target_freq_by_required_opp(struct device *p_dev,
 	return target_freq;
 }
 
+/*
+ * Resolve the required OPPs of all of the frequencies of @policy upfront, so
+ * that following a frequency change of the policy only takes a table lookup.
+ * Without the map everything still works, just through the OPP lookups.
+ */
+static void build_cpu_freq_map(struct devfreq *devfreq,
+			       struct devfreq_cpu_data *parent_cpu_data,
+			       struct cpufreq_policy *policy)
+{
+	struct cpufreq_frequency_table *pos;
+	unsigned long freq;
+	unsigned int n = 0;
+
+	if (!devfreq->opp_table || !policy->freq_table)
+		return;
+
+	cpufreq_for_each_valid_entry(pos, policy->freq_table)
+		n++;
+
+	parent_cpu_data->cpu_freq_map = kcalloc(n, sizeof(unsigned int),
+						GFP_KERNEL);
+	parent_cpu_data->dev_freq_map = kcalloc(n, sizeof(unsigned long),
+						GFP_KERNEL);
+	if (!parent_cpu_data->cpu_freq_map || !parent_cpu_data->dev_freq_map) {
+		free_cpu_freq_map(parent_cpu_data);
+		return;
+	}
+
+	n = 0;
+	cpufreq_for_each_valid_entry(pos, policy->freq_table) {
+		freq = pos->frequency * HZ_PER_KHZ;
+		parent_cpu_data->cpu_freq_map[n] = pos->frequency;
+		parent_cpu_data->dev_freq_map[n] =
+			get_target_freq_by_required_opp(parent_cpu_data->dev,
+							parent_cpu_data->opp_table,
+							devfreq->opp_table, &freq);
+		n++;
+	}
+	parent_cpu_data->nr_map = n;
+}
+
+/*
+ * The maps are only valid as long as the OPPs of the CPUs and of the device
+ * stay the same, so they are rebuilt whenever any of those OPPs are added,
+ * removed, enabled or disabled.  The maps of the CPUs whose changes cannot be
+ * followed are not built at all.  Called with devfreq->lock held.
+ */
+static void rebuild_cpu_freq_maps(struct devfreq *devfreq)
+{
+	struct devfreq_passive_data *p_data =
+				(struct devfreq_passive_data *)devfreq->data;
+	struct devfreq_cpu_data *parent_cpu_data;
+	struct cpufreq_policy *policy;
+
+	lockdep_assert_held(&devfreq->lock);
+
+	list_for_each_entry(parent_cpu_data, &p_data->cpu_data_list, node) {
+		free_cpu_freq_map(parent_cpu_data);
+
+		if (!p_data->opp_nb.notifier_call ||
+		    !parent_cpu_data->opp_nb.notifier_call)
+			continue;
+
+		policy = cpufreq_cpu_get(parent_cpu_data->first_cpu);
+		if (!policy)
+			continue;
+
+		build_cpu_freq_map(devfreq, parent_cpu_data, policy);
+		cpufreq_cpu_put(policy);
+	}
+}
+
+static int passive_opp_event(struct devfreq *devfreq, unsigned long event)
+{
+	if (event == OPP_EVENT_ADJUST_VOLTAGE)
+		return NOTIFY_DONE;
+
+	mutex_lock(&devfreq->lock);
+	rebuild_cpu_freq_maps(devfreq);
+	mutex_unlock(&devfreq->lock);
+
+	return NOTIFY_OK;
+}
+
+static int cpu_opp_notifier_call(struct notifier_block *nb,
+				 unsigned long event, void *ptr)
+{
+	struct devfreq_cpu_data *parent_cpu_data =
+			container_of(nb, struct devfreq_cpu_data, opp_nb);
+
+	return passive_opp_event(parent_cpu_data->devfreq, event);
+}
+
+static int dev_opp_notifier_call(struct notifier_block *nb,
+				 unsigned long event, void *ptr)
+{
+	struct devfreq_passive_data *p_data =
+			container_of(nb, struct devfreq_passive_data, opp_nb);
+
+	return passive_opp_event(p_data->this, event);
+}
+
+static void register_opp_notifiers(struct devfreq *devfreq)
+{
+	struct devfreq_passive_data *p_data =
+				(struct devfreq_passive_data *)devfreq->data;
+	struct devfreq_cpu_data *parent_cpu_data;
+
+	p_data->opp_nb.notifier_call = dev_opp_notifier_call;
+	if (dev_pm_opp_register_notifier(devfreq->dev.parent, &p_data->opp_nb))
+		p_data->opp_nb.notifier_call = NULL;
+
+	list_for_each_entry(parent_cpu_data, &p_data->cpu_data_list, node) {
+		parent_cpu_data->devfreq = devfreq;
+		parent_cpu_data->opp_nb.notifier_call = cpu_opp_notifier_call;
+		if (dev_pm_opp_register_notifier(parent_cpu_data->dev,
+						 &parent_cpu_data->opp_nb))
+			parent_cpu_data->opp_nb.notifier_call = NULL;
+	}
+}
+
+static void unregister_opp_notifiers(struct devfreq *devfreq)
+{
+	struct devfreq_passive_data *p_data =
+				(struct devfreq_passive_data *)devfreq->data;
+	struct devfreq_cpu_data *parent_cpu_data;
+
+	list_for_each_entry(parent_cpu_data, &p_data->cpu_data_list, node) {
+		if (!parent_cpu_data->opp_nb.notifier_call)
+			continue;
+
+		dev_pm_opp_unregister_notifier(parent_cpu_data->dev,
+					       &parent_cpu_data->opp_nb);
+		parent_cpu_data->opp_nb.notifier_call = NULL;
+	}
+
+	if (p_data->opp_nb.notifier_call) {
+		dev_pm_opp_unregister_notifier(devfreq->dev.parent,
+					       &p_data->opp_nb);
+		p_data->opp_nb.notifier_call = NULL;
+	}
+}
+
+/* Return the index of @cpu_freq in the map of @parent_cpu_data or -1. */
+static int lookup_cpu_freq_map(struct devfreq_cpu_data *parent_cpu_data,
+			       unsigned int cpu_freq)
+{
+	int i;
+
+	for (i = 0; i < parent_cpu_data->nr_map; i++)
+		if (parent_cpu_data->cpu_freq_map[i] == cpu_freq)
+			return i;
+
+	return -1;
+}
+
 static int get_target_freq_with_cpufreq(struct devfreq *devfreq,
 					unsigned long *target_freq)
 {
@@ -84,7 +259,7 @@ static int get_target_freq_with_cpufreq(struct devfreq *devfreq,
 	unsigned long cpu, cpu_cur, cpu_min, cpu_max, cpu_percent;
 	unsigned long dev_min, dev_max;
 	unsigned long freq = 0;
-	int ret = 0;
+	int ret = 0, idx;
 
 	for_each_online_cpu(cpu) {
 		policy = cpufreq_cpu_get(cpu);
@@ -100,10 +275,16 @@ static int get_target_freq_with_cpufreq(struct devfreq *devfreq,
 		}
 
 		/* Get target freq via required opps */
-		cpu_cur = parent_cpu_data->cur_freq * HZ_PER_KHZ;
-		freq = get_target_freq_by_required_opp(parent_cpu_data->dev,
-					parent_cpu_data->opp_table,
-					devfreq->opp_table, &cpu_cur);
+		cpu_cur = READ_ONCE(parent_cpu_data->cur_freq);
+		idx = lookup_cpu_freq_map(parent_cpu_data, cpu_cur);
+		if (idx >= 0) {
+			freq = parent_cpu_data->dev_freq_map[idx];
+		} else {
+			cpu_cur *= HZ_PER_KHZ;
+			freq = get_target_freq_by_required_opp(parent_cpu_data->dev,
+						parent_cpu_data->opp_table,
+						devfreq->opp_table, &cpu_cur);
+		}
 		if (freq) {
 			*target_freq = max(freq, *target_freq);
 			cpufreq_cpu_put(policy);
@@ -115,7 +296,7 @@ static int get_target_freq_with_cpufreq(struct devfreq *devfreq,
 
 		cpu_min = parent_cpu_data->min_freq;
 		cpu_max = parent_cpu_data->max_freq;
-		cpu_cur = parent_cpu_data->cur_freq;
+		cpu_cur = READ_ONCE(parent_cpu_data->cur_freq);
 
 		cpu_percent = ((cpu_cur - cpu_min) * 100) / (cpu_max - cpu_min);
 		freq = dev_min + mult_frac(dev_max - dev_min, cpu_percent, 100);
@@ -198,16 +379,27 @@ static int devfreq_passive_get_target_freq(struct devfreq *devfreq,
 	return ret;
 }
 
+static void cpufreq_passive_work(struct work_struct *work)
+{
+	struct devfreq_passive_data *p_data =
+			container_of(work, struct devfreq_passive_data, work);
+	struct devfreq *devfreq = (struct devfreq *)p_data->this;
+	int ret;
+
+	mutex_lock(&devfreq->lock);
+	ret = devfreq_update_target(devfreq, 0L);
+	mutex_unlock(&devfreq->lock);
+	if (ret)
+		dev_err(&devfreq->dev, "failed to update the frequency.\n");
+}
+
 static int cpufreq_passive_notifier_call(struct notifier_block *nb,
 					 unsigned long event, void *ptr)
 {
 	struct devfreq_passive_data *p_data =
 			container_of(nb, struct devfreq_passive_data, nb);
-	struct devfreq *devfreq = (struct devfreq *)p_data->this;
 	struct devfreq_cpu_data *parent_cpu_data;
 	struct cpufreq_freqs *freqs = ptr;
-	unsigned int cur_freq;
-	int ret;
 
 	if (event != CPUFREQ_POSTCHANGE || !freqs)
 		return 0;
@@ -216,17 +408,9 @@ static int cpufreq_passive_notifier_call(struct notifier_block *nb,
 	if (!parent_cpu_data || parent_cpu_data->cur_freq == freqs->new)
 		return 0;
 
-	cur_freq = parent_cpu_data->cur_freq;
-	parent_cpu_data->cur_freq = freqs->new;
-
-	mutex_lock(&devfreq->lock);
-	ret = devfreq_update_target(devfreq, freqs->new);
-	mutex_unlock(&devfreq->lock);
-	if (ret) {
-		parent_cpu_data->cur_freq = cur_freq;
-		dev_err(&devfreq->dev, "failed to update the frequency.\n");
-		return ret;
-	}
+	/* The work picks up the latest frequencies of all the policies. */
+	WRITE_ONCE(parent_cpu_data->cur_freq, freqs->new);
+	queue_work(devfreq_passive_wq, &p_data->work);
 
 	return 0;
 }
@@ -242,8 +426,11 @@ static int cpufreq_passive_unregister_notifier(struct devfreq *devfreq)
 					CPUFREQ_TRANSITION_NOTIFIER);
 		if (ret < 0)
 			return ret;
+
+		cancel_work_sync(&p_data->work);
 	}
 
+	unregister_opp_notifiers(devfreq);
 	delete_parent_cpu_data(p_data);
 
 	return 0;
@@ -263,6 +450,7 @@ static int cpufreq_passive_register_notifier(struct devfreq *devfreq)
 
 	p_data->cpu_data_list
 		= (struct list_head)LIST_HEAD_INIT(p_data->cpu_data_list);
+	INIT_WORK(&p_data->work, cpufreq_passive_work);
 
 	p_data->nb.notifier_call = cpufreq_passive_notifier_call;
 	ret = cpufreq_register_notifier(&p_data->nb, CPUFREQ_TRANSITION_NOTIFIER);
@@ -317,7 +505,11 @@ static int cpufreq_passive_register_notifier(struct devfreq *devfreq)
 		cpufreq_cpu_put(policy);
 	}
 
+	/* Build the maps after that, so that no OPP changes can be missed. */
+	register_opp_notifiers(devfreq);
+
 	mutex_lock(&devfreq->lock);
+	rebuild_cpu_freq_maps(devfreq);
 	ret = devfreq_update_target(devfreq, 0L);
 	mutex_unlock(&devfreq->lock);
 	if (ret)
@@ -431,7 +623,18 @@ static struct devfreq_governor devfreq_passive = {
 
 static int __init devfreq_passive_init(void)
 {
-	return devfreq_add_governor(&devfreq_passive);
+	int ret;
+
+	devfreq_passive_wq = alloc_ordered_workqueue("devfreq_passive_wq",
+						     WQ_FREEZABLE);
+	if (!devfreq_passive_wq)
+		return -ENOMEM;
+
+	ret = devfreq_add_governor(&devfreq_passive);
+	if (ret)
+		destroy_workqueue(devfreq_passive_wq);
+
+	return ret;
 }
 subsys_initcall(devfreq_passive_init);
 
@@ -442,6 +645,8 @@ static void __exit devfreq_passive_exit(void)
 	ret = devfreq_remove_governor(&devfreq_passive);
 	if (ret)
 		pr_err("%s: failed remove governor %d\n", __func__, ret);
+
+	destroy_workqueue(devfreq_passive_wq);
 }
 module_exit(devfreq_passive_exit);
 
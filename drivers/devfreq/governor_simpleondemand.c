@@ -14,16 +14,26 @@
 
 /* Default constants for DevFreq-Simple-Ondemand (DFSO) */
 #define DFSO_UPTHRESHOLD	(90)
-#define DFSO_DOWNDIFFERENCTIAL	(5)
-static int devfreq_simple_ondemand_func(struct devfreq *df,
-					unsigned long *freq)
+#define DFSO_DOWNDIFFERENTIAL	(5)
+
+/**
+ * devfreq_simple_ondemand_target() - Compute the frequency for the recent load
+ * @df:		the devfreq instance.
+ * @data:	the thresholds to use, or NULL for the defaults.
+ * @freq:	the new frequency, on success.
+ *
+ * Helper for the governors basing their decisions on the load of the device
+ * the same way as Simple-Ondemand does.
+ */
+int devfreq_simple_ondemand_target(struct devfreq *df,
+				   const struct devfreq_simple_ondemand_data *data,
+				   unsigned long *freq)
 {
 	int err;
 	struct devfreq_dev_status *stat;
 	unsigned long long a, b;
 	unsigned int dfso_upthreshold = DFSO_UPTHRESHOLD;
-	unsigned int dfso_downdifferential = DFSO_DOWNDIFFERENCTIAL;
-	struct devfreq_simple_ondemand_data *data = df->data;
+	unsigned int dfso_downdifferential = DFSO_DOWNDIFFERENTIAL;
 
 	err = devfreq_update_stats(df);
 	if (err)
@@ -83,6 +93,13 @@ static int devfreq_simple_ondemand_func(struct devfreq *df,
 
 	return 0;
 }
+EXPORT_SYMBOL_GPL(devfreq_simple_ondemand_target);
+
+static int devfreq_simple_ondemand_func(struct devfreq *df,
+					unsigned long *freq)
+{
+	return devfreq_simple_ondemand_target(df, df->data, freq);
+}
 
 static int devfreq_simple_ondemand_handler(struct devfreq *devfreq,
 				unsigned int event, void *data)
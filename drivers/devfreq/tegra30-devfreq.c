@@ -57,6 +57,12 @@
 #define ACTMON_BELOW_WMARK_WINDOW				3
 #define ACTMON_BOOST_FREQ_STEP					16000
 
+/*
+ * Weight of the newest change of the average count in the deviation
+ * estimate, as 2 ^ -ACTMON_AVG_DEV_SHIFT.
+ */
+#define ACTMON_AVG_DEV_SHIFT					2
+
 /*
  * ACTMON_AVERAGE_WINDOW_LOG2: default value for @DEV_CTRL_K_VAL, which
  * translates to 2 ^ (K_VAL + 1). ex: 2 ^ (6 + 1) = 128
@@ -160,6 +166,13 @@ struct tegra_devfreq_device {
 	/* Average event count sampled in the last interrupt */
 	u32 avg_count;
 
+	/*
+	 * Running average of how much avg_count has changed between
+	 * interrupts, used to adapt the average watermark band and the
+	 * boost step to the recent variability of the load.
+	 */
+	u32 avg_dev;
+
 	/*
 	 * Extra frequency to increase the target by due to consecutive
 	 * watermark breaches.
@@ -248,6 +261,27 @@ static unsigned long do_percent(unsigned long long val, unsigned int pct)
 	return min_t(u64, val, U32_MAX);
 }
 
+static void tegra_devfreq_update_avg_dev(struct tegra_devfreq_device *dev,
+					 u32 avg_count)
+{
+	u32 delta = abs_diff(avg_count, dev->avg_count);
+
+	dev->avg_dev -= dev->avg_dev >> ACTMON_AVG_DEV_SHIFT;
+	dev->avg_dev += delta >> ACTMON_AVG_DEV_SHIFT;
+}
+
+/*
+ * The boost grows by at least the typical recent change of the load per
+ * consecutive upper watermark breach, so bursty load gets there faster.
+ */
+static unsigned long tegra_devfreq_boost_step(struct tegra_devfreq *tegra,
+					      struct tegra_devfreq_device *dev)
+{
+	unsigned long step = dev->avg_dev / tegra->devfreq->profile->polling_ms;
+
+	return max_t(unsigned long, step, ACTMON_BOOST_FREQ_STEP);
+}
+
 static void tegra_devfreq_update_avg_wmark(struct tegra_devfreq *tegra,
 					   struct tegra_devfreq_device *dev)
 {
@@ -255,6 +289,12 @@ static void tegra_devfreq_update_avg_wmark(struct tegra_devfreq *tegra,
 	u32 band = avg_band_freq * tegra->devfreq->profile->polling_ms;
 	u32 avg;
 
+	/*
+	 * Don't interrupt on every swing of an oscillating load: keep the
+	 * average watermarks at least one typical change away.
+	 */
+	band = max(band, dev->avg_dev);
+
 	avg = min(dev->avg_count, U32_MAX - band);
 	device_writel(dev, avg + band, ACTMON_DEV_AVG_UPPER_WMARK);
 
@@ -277,9 +317,11 @@ static void tegra_devfreq_update_wmark(struct tegra_devfreq *tegra,
 static void actmon_isr_device(struct tegra_devfreq *tegra,
 			      struct tegra_devfreq_device *dev)
 {
-	u32 intr_status, dev_ctrl;
+	u32 intr_status, dev_ctrl, avg_count;
 
-	dev->avg_count = device_readl(dev, ACTMON_DEV_AVG_COUNT);
+	avg_count = device_readl(dev, ACTMON_DEV_AVG_COUNT);
+	tegra_devfreq_update_avg_dev(dev, avg_count);
+	dev->avg_count = avg_count;
 	tegra_devfreq_update_avg_wmark(tegra, dev);
 
 	intr_status = device_readl(dev, ACTMON_DEV_INTR_STATUS);
@@ -291,7 +333,7 @@ static void actmon_isr_device(struct tegra_devfreq *tegra,
 		 */
 		dev->boost_freq = do_percent(dev->boost_freq,
 					     dev->config->boost_up_coeff);
-		dev->boost_freq += ACTMON_BOOST_FREQ_STEP;
+		dev->boost_freq += tegra_devfreq_boost_step(tegra, dev);
 
 		dev_ctrl |= ACTMON_DEV_CTRL_CONSECUTIVE_BELOW_WMARK_EN;
 
@@ -501,6 +543,7 @@ static void tegra_actmon_configure_device(struct tegra_devfreq *tegra,
 
 	/* reset boosting on governor's restart */
 	dev->boost_freq = 0;
+	dev->avg_dev = 0;
 
 	dev->target_freq = tegra->cur_freq;
 
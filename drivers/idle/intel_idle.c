@@ -57,6 +57,7 @@
 #include <asm/mwait.h>
 #include <asm/msr.h>
 #include <asm/fpu/api.h>
+#include <asm/tsc.h>
 
 #define INTEL_IDLE_VERSION "0.5.1"
 
@@ -69,6 +70,7 @@ static int max_cstate = CPUIDLE_STATE_MAX - 1;
 static unsigned int disabled_states_mask __read_mostly;
 static unsigned int preferred_states_mask __read_mostly;
 static bool force_irq_on __read_mostly;
+static bool hw_residency __read_mostly;
 
 static struct cpuidle_device __percpu *intel_idle_cpuidle_devices;
 
@@ -226,6 +228,50 @@ static __cpuidle int intel_idle_s2idle(struct cpuidle_device *dev,
 	return 0;
 }
 
+static DEFINE_PER_CPU(u64, intel_idle_cc6_residency);
+
+static bool intel_idle_state_needs_cc6(struct cpuidle_state *state)
+{
+	return MWAIT_HINT2CSTATE(flg2MWAIT(state->flags)) >= 2;
+}
+
+/**
+ * intel_idle_achieved - Check if the processor has demoted an idle state.
+ * @dev: cpuidle device of the target CPU.
+ * @drv: cpuidle driver (assumed to point to intel_idle_driver).
+ * @index: Index of the idle state that has been requested.
+ * @residency_ns: Duration of the idle period.
+ *
+ * The core C6 residency counter only advances while the core is in CC6, so if
+ * it has advanced by much less than @residency_ns over an idle period in a
+ * state requesting CC6 or deeper, the processor has demoted the request (or
+ * the SMT sibling has been busy).  Return the deepest enabled state that does
+ * not require CC6 in that case.
+ */
+static int intel_idle_achieved(struct cpuidle_device *dev,
+			       struct cpuidle_driver *drv, int index,
+			       u64 residency_ns)
+{
+	u64 cc6, prev;
+	int i;
+
+	rdmsrl(MSR_CORE_C6_RESIDENCY, cc6);
+	prev = __this_cpu_read(intel_idle_cc6_residency);
+	__this_cpu_write(intel_idle_cc6_residency, cc6);
+
+	/* The counter runs at the TSC frequency. */
+	if (mul_u64_u32_div(cc6 - prev, NSEC_PER_MSEC, tsc_khz) >= residency_ns / 2)
+		return index;
+
+	for (i = index - 1; i > 0; i--) {
+		if (!dev->states_usage[i].disable &&
+		    !intel_idle_state_needs_cc6(&drv->states[i]))
+			return i;
+	}
+
+	return index;
+}
+
 /*
  * States are indexed by the cstate number,
  * which is also the index into the MWAIT hint array.
@@ -1950,6 +1996,23 @@ static void __init intel_idle_init_cstates_icpu(struct cpuidle_driver *drv)
 	}
 }
 
+static void __init intel_idle_init_hw_residency(struct cpuidle_driver *drv)
+{
+	u64 val;
+	int i;
+
+	if (!boot_cpu_has(X86_FEATURE_CONSTANT_TSC) || !tsc_khz ||
+	    rdmsrl_safe(MSR_CORE_C6_RESIDENCY, &val)) {
+		pr_info("Core C6 residency counter not usable\n");
+		return;
+	}
+
+	for (i = 1; i < drv->state_count; i++) {
+		if (intel_idle_state_needs_cc6(&drv->states[i]))
+			drv->states[i].achieved = intel_idle_achieved;
+	}
+}
+
 /**
  * intel_idle_cpuidle_driver_init - Create the list of available idle states.
  * @drv: cpuidle driver structure to initialize.
@@ -1967,6 +2030,9 @@ static void __init intel_idle_cpuidle_driver_init(struct cpuidle_driver *drv)
 		intel_idle_init_cstates_icpu(drv);
 	else
 		intel_idle_init_cstates_acpi(drv);
+
+	if (hw_residency)
+		intel_idle_init_hw_residency(drv);
 }
 
 static void auto_demotion_disable(void)
@@ -2176,3 +2242,9 @@ MODULE_PARM_DESC(preferred_cstates, "Mask of preferred idle states");
  * 'CPUIDLE_FLAG_INIT_XSTATE' and 'CPUIDLE_FLAG_IBRS' flags.
  */
 module_param(force_irq_on, bool, 0444);
+/*
+ * Check the core C6 residency counter after idle periods in C-states
+ * requesting CC6 or deeper to report hardware demotions to cpuidle.
+ */
+module_param(hw_residency, bool, 0444);
+MODULE_PARM_DESC(hw_residency, "Detect C-state demotions with residency counters");
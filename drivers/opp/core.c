@@ -37,34 +37,23 @@ static bool opp_tables_busy;
 /* OPP ID allocator */
 static DEFINE_XARRAY_ALLOC1(opp_configs);
 
-static bool _find_opp_dev(const struct device *dev, struct opp_table *opp_table)
-{
-	struct opp_device *opp_dev;
-	bool found = false;
-
-	mutex_lock(&opp_table->lock);
-	list_for_each_entry(opp_dev, &opp_table->dev_list, node)
-		if (opp_dev->dev == dev) {
-			found = true;
-			break;
-		}
-
-	mutex_unlock(&opp_table->lock);
-	return found;
-}
-
+/*
+ * Every device points to its OPP table via dev->power.opp_table, which is set
+ * once the table is on the opp_tables list and cleared when the device is
+ * removed from it.  The tables are freed after an RCU grace period, so the
+ * pointer can be followed without holding opp_table_lock.
+ */
 static struct opp_table *_find_opp_table_unlocked(struct device *dev)
 {
 	struct opp_table *opp_table;
 
-	list_for_each_entry(opp_table, &opp_tables, node) {
-		if (_find_opp_dev(dev, opp_table)) {
-			_get_opp_table_kref(opp_table);
-			return opp_table;
-		}
-	}
+	rcu_read_lock();
+	opp_table = rcu_dereference(dev->power.opp_table);
+	if (opp_table && !kref_get_unless_zero(&opp_table->kref))
+		opp_table = NULL;
+	rcu_read_unlock();
 
-	return ERR_PTR(-ENODEV);
+	return opp_table ?: ERR_PTR(-ENODEV);
 }
 
 /**
@@ -87,11 +76,7 @@ struct opp_table *_find_opp_table(struct device *dev)
 		return ERR_PTR(-EINVAL);
 	}
 
-	mutex_lock(&opp_table_lock);
-	opp_table = _find_opp_table_unlocked(dev);
-	mutex_unlock(&opp_table_lock);
-
-	return opp_table;
+	return _find_opp_table_unlocked(dev);
 }
 
 /*
@@ -493,6 +478,107 @@ static bool _compare_floor(struct dev_pm_opp **opp, struct dev_pm_opp *temp_opp,
 	return false;
 }
 
+/* Must be called with opp_table->lock held after changing the opp_list. */
+static void _opp_table_update_freq_index(struct opp_table *opp_table)
+{
+	struct opp_freq_index *index = NULL, *old;
+	struct dev_pm_opp *opp;
+	unsigned int count = 0;
+
+	lockdep_assert_held(&opp_table->lock);
+
+	list_for_each_entry(opp, &opp_table->opp_list, node)
+		count++;
+
+	/* Lookups fall back to walking the list if there is no index. */
+	if (count && opp_table->clk_count)
+		index = kmalloc(struct_size(index, entries, count), GFP_KERNEL);
+
+	if (index) {
+		index->count = 0;
+		list_for_each_entry(opp, &opp_table->opp_list, node) {
+			index->entries[index->count].freq = opp->rates[0];
+			index->entries[index->count].opp = opp;
+			index->count++;
+		}
+	}
+
+	old = rcu_replace_pointer(opp_table->freq_index, index,
+				  lockdep_is_held(&opp_table->lock));
+	if (old)
+		kfree_rcu(old, rcu);
+}
+
+/*
+ * Look up an OPP by its first frequency using a binary search in the
+ * opp_freq_index of the table, without taking the table's lock.
+ *
+ * Return: A referenced OPP or an error pointer on success, NULL if the index
+ * cannot be used and the opp_list needs to be walked instead.
+ */
+static struct dev_pm_opp *_opp_table_find_freq_fast(struct opp_table *opp_table,
+		unsigned long *freq, bool available,
+		bool (*compare)(struct dev_pm_opp **opp, struct dev_pm_opp *temp_opp,
+				unsigned long opp_key, unsigned long key))
+{
+	struct dev_pm_opp *opp = ERR_PTR(-ERANGE);
+	struct opp_freq_index *index;
+	unsigned int lo = 0, hi, i;
+
+	rcu_read_lock();
+
+	index = rcu_dereference(opp_table->freq_index);
+	if (!index) {
+		opp = NULL;
+		goto unlock;
+	}
+
+	/* Find the first entry with a frequency that is not below *freq. */
+	hi = index->count;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (index->entries[mid].freq < *freq)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (compare == _compare_floor) {
+		/* The last entry with a frequency not above *freq. */
+		for (i = lo; i < index->count && index->entries[i].freq == *freq; i++)
+			;
+
+		while (i--) {
+			if (READ_ONCE(index->entries[i].opp->available) == available) {
+				opp = index->entries[i].opp;
+				break;
+			}
+		}
+	} else {
+		for (i = lo; i < index->count; i++) {
+			struct dev_pm_opp *temp_opp = index->entries[i].opp;
+
+			if (READ_ONCE(temp_opp->available) == available &&
+			    compare(&opp, temp_opp, index->entries[i].freq, *freq))
+				break;
+		}
+	}
+
+	if (!IS_ERR(opp)) {
+		/* The OPP is being removed, let the slow path deal with it. */
+		if (!kref_get_unless_zero(&opp->kref))
+			opp = NULL;
+		else
+			*freq = opp->rates[0];
+	}
+
+unlock:
+	rcu_read_unlock();
+
+	return opp;
+}
+
 /* Generic key finding helpers */
 static struct dev_pm_opp *_opp_table_find_key(struct opp_table *opp_table,
 		unsigned long *key, int index, bool available,
@@ -507,6 +593,15 @@ static struct dev_pm_opp *_opp_table_find_key(struct opp_table *opp_table,
 	if (assert && !assert(opp_table))
 		return ERR_PTR(-EINVAL);
 
+	if (read == _read_freq && !index) {
+		opp = _opp_table_find_freq_fast(opp_table, key, available,
+						compare);
+		if (opp)
+			return opp;
+
+		opp = ERR_PTR(-ERANGE);
+	}
+
 	mutex_lock(&opp_table->lock);
 
 	list_for_each_entry(temp_opp, &opp_table->opp_list, node) {
@@ -1156,15 +1251,96 @@ static int _disable_opp_table(struct device *dev, struct opp_table *opp_table)
 
 	ret = _set_required_opps(dev, opp_table, NULL, false);
 
+	/* The time spent disabled is not accounted to any OPP */
+	opp_debug_stats_reset(opp_table);
 	opp_table->enabled = false;
 	return ret;
 }
 
+/* Configure the resources needed before raising the frequency to @opp. */
+static int _set_opp_resources_up(struct device *dev, struct opp_table *opp_table,
+				 struct dev_pm_opp *old_opp, struct dev_pm_opp *opp)
+{
+	int ret;
+
+	ret = _set_required_opps(dev, opp_table, opp, true);
+	if (ret) {
+		dev_err(dev, "Failed to set required opps: %d\n", ret);
+		return ret;
+	}
+
+	ret = _set_opp_bw(opp_table, opp, dev);
+	if (ret) {
+		dev_err(dev, "Failed to set bw: %d\n", ret);
+		return ret;
+	}
+
+	if (opp_table->config_regulators) {
+		ret = opp_table->config_regulators(dev, old_opp, opp,
+						   opp_table->regulators,
+						   opp_table->regulator_count);
+		if (ret) {
+			dev_err(dev, "Failed to set regulator voltages: %d\n",
+				ret);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+/* Configure the resources that can be reduced after lowering the frequency. */
+static int _set_opp_resources_down(struct device *dev, struct opp_table *opp_table,
+				   struct dev_pm_opp *old_opp, struct dev_pm_opp *opp)
+{
+	int ret;
+
+	if (opp_table->config_regulators) {
+		ret = opp_table->config_regulators(dev, old_opp, opp,
+						   opp_table->regulators,
+						   opp_table->regulator_count);
+		if (ret) {
+			dev_err(dev, "Failed to set regulator voltages: %d\n",
+				ret);
+			return ret;
+		}
+	}
+
+	ret = _set_opp_bw(opp_table, opp, dev);
+	if (ret) {
+		dev_err(dev, "Failed to set bw: %d\n", ret);
+		return ret;
+	}
+
+	ret = _set_required_opps(dev, opp_table, opp, false);
+	if (ret) {
+		dev_err(dev, "Failed to set required opps: %d\n", ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+static void _set_opp_commit(struct opp_table *opp_table,
+			    struct dev_pm_opp *old_opp, struct dev_pm_opp *opp)
+{
+	opp_table->enabled = true;
+	dev_pm_opp_put(old_opp);
+
+	/* Make sure current_opp doesn't get freed */
+	dev_pm_opp_get(opp);
+	opp_table->current_opp = opp;
+}
+
 static int _set_opp(struct device *dev, struct opp_table *opp_table,
 		    struct dev_pm_opp *opp, void *clk_data, bool forced)
 {
 	struct dev_pm_opp *old_opp;
 	int scaling_down, ret;
+	ktime_t start;
+
+	/* Set by dev_pm_opp_set_rate() on success. */
+	opp_table->current_rate_req = 0;
 
 	if (unlikely(!opp))
 		return _disable_opp_table(dev, opp_table);
@@ -1181,6 +1357,8 @@ static int _set_opp(struct device *dev, struct opp_table *opp_table,
 		return 0;
 	}
 
+	start = opp_debug_stats_start();
+
 	dev_dbg(dev, "%s: switching OPP: Freq %lu -> %lu Hz, Level %u -> %u, Bw %u -> %u\n",
 		__func__, old_opp->rates[0], opp->rates[0], old_opp->level,
 		opp->level, old_opp->bandwidth ? old_opp->bandwidth[0].peak : 0,
@@ -1192,28 +1370,9 @@ static int _set_opp(struct device *dev, struct opp_table *opp_table,
 
 	/* Scaling up? Configure required OPPs before frequency */
 	if (!scaling_down) {
-		ret = _set_required_opps(dev, opp_table, opp, true);
-		if (ret) {
-			dev_err(dev, "Failed to set required opps: %d\n", ret);
-			return ret;
-		}
-
-		ret = _set_opp_bw(opp_table, opp, dev);
-		if (ret) {
-			dev_err(dev, "Failed to set bw: %d\n", ret);
+		ret = _set_opp_resources_up(dev, opp_table, old_opp, opp);
+		if (ret)
 			return ret;
-		}
-
-		if (opp_table->config_regulators) {
-			ret = opp_table->config_regulators(dev, old_opp, opp,
-							   opp_table->regulators,
-							   opp_table->regulator_count);
-			if (ret) {
-				dev_err(dev, "Failed to set regulator voltages: %d\n",
-					ret);
-				return ret;
-			}
-		}
 	}
 
 	if (opp_table->config_clks) {
@@ -1224,38 +1383,26 @@ static int _set_opp(struct device *dev, struct opp_table *opp_table,
 
 	/* Scaling down? Configure required OPPs after frequency */
 	if (scaling_down) {
-		if (opp_table->config_regulators) {
-			ret = opp_table->config_regulators(dev, old_opp, opp,
-							   opp_table->regulators,
-							   opp_table->regulator_count);
-			if (ret) {
-				dev_err(dev, "Failed to set regulator voltages: %d\n",
-					ret);
-				return ret;
-			}
-		}
-
-		ret = _set_opp_bw(opp_table, opp, dev);
-		if (ret) {
-			dev_err(dev, "Failed to set bw: %d\n", ret);
-			return ret;
-		}
-
-		ret = _set_required_opps(dev, opp_table, opp, false);
-		if (ret) {
-			dev_err(dev, "Failed to set required opps: %d\n", ret);
+		ret = _set_opp_resources_down(dev, opp_table, old_opp, opp);
+		if (ret)
 			return ret;
-		}
 	}
 
-	opp_table->enabled = true;
-	dev_pm_opp_put(old_opp);
+	/* Account before _set_opp_commit() drops the reference to old_opp */
+	opp_debug_stats_update(opp_table, old_opp, opp, start);
+	_set_opp_commit(opp_table, old_opp, opp);
 
-	/* Make sure current_opp doesn't get freed */
-	dev_pm_opp_get(opp);
-	opp_table->current_opp = opp;
+	return 0;
+}
 
-	return ret;
+static bool _opp_table_rate_is_current(struct opp_table *opp_table,
+				       unsigned long target_freq)
+{
+	struct dev_pm_opp *opp = opp_table->current_opp;
+
+	return opp && opp_table->enabled &&
+	       opp_table->current_rate_req == target_freq &&
+	       READ_ONCE(opp->available);
 }
 
 /**
@@ -1284,6 +1431,18 @@ int dev_pm_opp_set_rate(struct device *dev, unsigned long target_freq)
 	}
 
 	if (target_freq) {
+		/*
+		 * Nothing to do if the frequency requested last time is being
+		 * requested again and it has been set successfully, which is
+		 * common with governors.  Skip rounding the frequency and
+		 * looking up the OPP for it then, as they would lead to the
+		 * current OPP anyway (as long as it is available).
+		 */
+		if (_opp_table_rate_is_current(opp_table, target_freq)) {
+			ret = 0;
+			goto put_opp_table;
+		}
+
 		/*
 		 * For IO devices which require an OPP on some platforms/SoCs
 		 * while just needing to scale the clock on some others
@@ -1327,8 +1486,12 @@ int dev_pm_opp_set_rate(struct device *dev, unsigned long target_freq)
 
 	ret = _set_opp(dev, opp_table, opp, &target_freq, forced);
 
-	if (target_freq)
+	if (target_freq) {
+		if (!ret)
+			opp_table->current_rate_req = target_freq;
+
 		dev_pm_opp_put(opp);
+	}
 
 put_opp_table:
 	dev_pm_opp_put_opp_table(opp_table);
@@ -1368,12 +1531,16 @@ EXPORT_SYMBOL_GPL(dev_pm_opp_set_opp);
 static void _remove_opp_dev(struct opp_device *opp_dev,
 			    struct opp_table *opp_table)
 {
+	/* The device may have been moved to another table since. */
+	if (rcu_access_pointer(opp_dev->dev->power.opp_table) == opp_table)
+		RCU_INIT_POINTER(opp_dev->dev->power.opp_table, NULL);
+
 	opp_debug_unregister(opp_dev, opp_table);
 	list_del(&opp_dev->node);
 	kfree(opp_dev);
 }
 
-struct opp_device *_add_opp_dev(const struct device *dev,
+struct opp_device *_add_opp_dev(struct device *dev,
 				struct opp_table *opp_table)
 {
 	struct opp_device *opp_dev;
@@ -1565,6 +1732,9 @@ struct opp_table *_add_opp_table_indexed(struct device *dev, int index,
 			list_add(&opp_table->node, &opp_tables);
 	}
 
+	if (!IS_ERR(opp_table))
+		_opp_dev_publish(dev, opp_table);
+
 	opp_tables_busy = false;
 
 unlock:
@@ -1610,13 +1780,16 @@ static void _opp_table_kref_release(struct kref *kref)
 	}
 
 	WARN_ON(!list_empty(&opp_table->opp_list));
+	kfree(rcu_dereference_protected(opp_table->freq_index, true));
 
 	list_for_each_entry_safe(opp_dev, temp, &opp_table->dev_list, node)
 		_remove_opp_dev(opp_dev, opp_table);
 
 	mutex_destroy(&opp_table->genpd_virt_dev_lock);
 	mutex_destroy(&opp_table->lock);
-	kfree(opp_table);
+
+	/* Lock-free lookups may still be looking at it. */
+	kfree_rcu(opp_table, rcu_head);
 }
 
 void dev_pm_opp_put_opp_table(struct opp_table *opp_table)
@@ -1637,6 +1810,7 @@ static void _opp_kref_release(struct kref *kref)
 	struct opp_table *opp_table = opp->opp_table;
 
 	list_del(&opp->node);
+	_opp_table_update_freq_index(opp_table);
 	mutex_unlock(&opp_table->lock);
 
 	/*
@@ -1646,7 +1820,9 @@ static void _opp_kref_release(struct kref *kref)
 	blocking_notifier_call_chain(&opp_table->head, OPP_EVENT_REMOVE, opp);
 	_of_clear_opp(opp_table, opp);
 	opp_debug_remove_one(opp);
-	kfree(opp);
+
+	/* Lock-free lookups may still be looking at it. */
+	kfree_rcu(opp, rcu_head);
 }
 
 void dev_pm_opp_get(struct dev_pm_opp *opp)
@@ -1975,12 +2151,13 @@ int _opp_add(struct device *dev, struct dev_pm_opp *new_opp,
 		return ret;
 	}
 
-	list_add(&new_opp->node, head);
-	mutex_unlock(&opp_table->lock);
-
 	new_opp->opp_table = opp_table;
 	kref_init(&new_opp->kref);
 
+	list_add(&new_opp->node, head);
+	_opp_table_update_freq_index(opp_table);
+	mutex_unlock(&opp_table->lock);
+
 	opp_debug_create_one(new_opp, opp_table);
 
 	if (!_opp_supported_by_regulators(new_opp, opp_table)) {
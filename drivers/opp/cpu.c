@@ -182,6 +182,8 @@ int dev_pm_opp_set_sharing_cpus(struct device *cpu_dev,
 			continue;
 		}
 
+		_opp_dev_publish(dev, opp_table);
+
 		/* Mark opp-table as multiple CPUs are sharing it now */
 		opp_table->shared_opp = OPP_TABLE_ACCESS_SHARED;
 	}
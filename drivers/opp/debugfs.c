@@ -12,6 +12,7 @@
 #include <linux/err.h>
 #include <linux/of.h>
 #include <linux/init.h>
+#include <linux/ktime.h>
 #include <linux/limits.h>
 #include <linux/slab.h>
 
@@ -19,6 +20,12 @@
 
 static struct dentry *rootdir;
 
+/*
+ * Per-OPP residency and transition statistics, collected by _set_opp() while
+ * /sys/kernel/debug/opp/stats is set.
+ */
+static bool opp_stats_enabled;
+
 static void opp_set_dev_name(const struct device *dev, char *name)
 {
 	if (dev->parent)
@@ -124,6 +131,84 @@ static void opp_debug_create_supplies(struct dev_pm_opp *opp,
 	}
 }
 
+ktime_t opp_debug_stats_start(void)
+{
+	return READ_ONCE(opp_stats_enabled) ? ktime_get() : 0;
+}
+
+/**
+ * opp_debug_stats_update - account a switch from @old_opp to @opp
+ * @opp_table: the OPP table of both OPPs
+ * @old_opp: the OPP used until now
+ * @opp: the new current OPP
+ * @start: return value of opp_debug_stats_start() before the switch
+ *
+ * Switches made with the statistics disabled forget the time of the last
+ * switch, so that the time spent at @old_opp is only accounted when it is
+ * known.
+ */
+void opp_debug_stats_update(struct opp_table *opp_table,
+			    struct dev_pm_opp *old_opp, struct dev_pm_opp *opp,
+			    ktime_t start)
+{
+	ktime_t now, stamp;
+	u64 latency;
+
+	if (!start) {
+		WRITE_ONCE(opp_table->stats_stamp, 0);
+		return;
+	}
+
+	now = ktime_get();
+	stamp = opp_table->stats_stamp;
+	if (stamp && old_opp != opp)
+		WRITE_ONCE(old_opp->time_ns,
+			   old_opp->time_ns + ktime_to_ns(ktime_sub(now, stamp)));
+
+	latency = ktime_to_ns(ktime_sub(now, start));
+	WRITE_ONCE(opp->latency_ns, opp->latency_ns + latency);
+	if (latency > opp->max_latency_ns)
+		WRITE_ONCE(opp->max_latency_ns, latency);
+	WRITE_ONCE(opp->transitions, opp->transitions + 1);
+
+	/* A forced switch to the same OPP keeps accumulating from @stamp */
+	if (!stamp || old_opp != opp)
+		WRITE_ONCE(opp_table->stats_stamp, now);
+}
+
+/* Stop accounting time to the current OPP, as the table is being disabled */
+void opp_debug_stats_reset(struct opp_table *opp_table)
+{
+	WRITE_ONCE(opp_table->stats_stamp, 0);
+}
+
+/* Include the time spent at the current OPP since the last switch */
+static int opp_time_get(void *data, u64 *val)
+{
+	struct dev_pm_opp *opp = data;
+	struct opp_table *opp_table = opp->opp_table;
+	ktime_t stamp = READ_ONCE(opp_table->stats_stamp);
+
+	*val = READ_ONCE(opp->time_ns);
+	if (stamp && READ_ONCE(opp_table->current_opp) == opp &&
+	    READ_ONCE(opp_stats_enabled))
+		*val += ktime_to_ns(ktime_sub(ktime_get(), stamp));
+
+	return 0;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(opp_time_fops, opp_time_get, NULL, "%llu\n");
+
+static void opp_debug_create_stats(struct dev_pm_opp *opp, struct dentry *pdentry)
+{
+	debugfs_create_file_unsafe("time_ns", S_IRUGO, pdentry, opp,
+				   &opp_time_fops);
+	debugfs_create_u64("transitions", S_IRUGO, pdentry, &opp->transitions);
+	debugfs_create_u64("transition_latency_ns", S_IRUGO, pdentry,
+			   &opp->latency_ns);
+	debugfs_create_u64("transition_latency_max_ns", S_IRUGO, pdentry,
+			   &opp->max_latency_ns);
+}
+
 void opp_debug_create_one(struct dev_pm_opp *opp, struct opp_table *opp_table)
 {
 	struct dentry *pdentry = opp_table->dentry;
@@ -162,6 +247,7 @@ void opp_debug_create_one(struct dev_pm_opp *opp, struct opp_table *opp_table)
 	opp_debug_create_clks(opp, opp_table, d);
 	opp_debug_create_supplies(opp, opp_table, d);
 	opp_debug_create_bw(opp, opp_table, d);
+	opp_debug_create_stats(opp, d);
 
 	opp->dentry = d;
 }
@@ -273,6 +359,8 @@ static int __init opp_debug_init(void)
 {
 	/* Create /sys/kernel/debug/opp directory */
 	rootdir = debugfs_create_dir("opp", NULL);
+	debugfs_create_bool("stats", S_IRUGO | S_IWUSR, rootdir,
+			    &opp_stats_enabled);
 
 	return 0;
 }
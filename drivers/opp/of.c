@@ -534,13 +534,33 @@ int dev_pm_opp_of_find_icc_paths(struct device *dev,
 }
 EXPORT_SYMBOL_GPL(dev_pm_opp_of_find_icc_paths);
 
+/*
+ * Number of u32 cells in @prop, or a negative error code if it doesn't hold an
+ * array of them, like of_property_count_u32_elems() but for a property that
+ * has already been looked up.
+ */
+static int _prop_count_u32(const struct property *prop)
+{
+	if (!prop->value)
+		return -ENODATA;
+
+	if (prop->length % sizeof(u32))
+		return -EINVAL;
+
+	return prop->length / sizeof(u32);
+}
+
 static bool _opp_is_supported(struct device *dev, struct opp_table *opp_table,
 			      struct device_node *np)
 {
 	unsigned int levels = opp_table->supported_hw_count;
-	int count, versions, ret, i, j;
+	struct property *prop;
+	int count, versions, i, j;
+	const __be32 *cells;
 	u32 val;
 
+	prop = of_find_property(np, "opp-supported-hw", NULL);
+
 	if (!opp_table->supported_hw) {
 		/*
 		 * In the case that no supported_hw has been set by the
@@ -548,13 +568,10 @@ static bool _opp_is_supported(struct device *dev, struct opp_table *opp_table,
 		 * an OPP then the OPP should not be enabled as there is
 		 * no way to see if the hardware supports it.
 		 */
-		if (of_property_present(np, "opp-supported-hw"))
-			return false;
-		else
-			return true;
+		return !prop;
 	}
 
-	count = of_property_count_u32_elems(np, "opp-supported-hw");
+	count = prop ? _prop_count_u32(prop) : -EINVAL;
 	if (count <= 0 || count % levels) {
 		dev_err(dev, "%s: Invalid opp-supported-hw property (%d)\n",
 			__func__, count);
@@ -562,19 +579,14 @@ static bool _opp_is_supported(struct device *dev, struct opp_table *opp_table,
 	}
 
 	versions = count / levels;
+	cells = prop->value;
 
 	/* All levels in at least one of the versions should match */
 	for (i = 0; i < versions; i++) {
 		bool supported = true;
 
 		for (j = 0; j < levels; j++) {
-			ret = of_property_read_u32_index(np, "opp-supported-hw",
-							 i * levels + j, &val);
-			if (ret) {
-				dev_warn(dev, "%s: failed to read opp-supported-hw property at index %d: %d\n",
-					 __func__, i * levels + j, ret);
-				return false;
-			}
+			val = be32_to_cpup(cells + i * levels + j);
 
 			/* Check if the level is supported */
 			if (!(val & opp_table->supported_hw[j])) {
@@ -596,7 +608,8 @@ static u32 *_parse_named_prop(struct dev_pm_opp *opp, struct device *dev,
 {
 	struct property *prop = NULL;
 	char name[NAME_MAX];
-	int count, ret;
+	const __be32 *cells;
+	int count, i;
 	u32 *out;
 
 	/* Search for "opp-<prop_type>-<name>" */
@@ -614,7 +627,7 @@ static u32 *_parse_named_prop(struct dev_pm_opp *opp, struct device *dev,
 			return NULL;
 	}
 
-	count = of_property_count_u32_elems(opp->np, name);
+	count = _prop_count_u32(prop);
 	if (count < 0) {
 		dev_err(dev, "%s: Invalid %s property (%d)\n", __func__, name,
 			count);
@@ -640,12 +653,8 @@ static u32 *_parse_named_prop(struct dev_pm_opp *opp, struct device *dev,
 	if (!out)
 		return ERR_PTR(-EINVAL);
 
-	ret = of_property_read_u32_array(opp->np, name, out, count);
-	if (ret) {
-		dev_err(dev, "%s: error parsing %s: %d\n", __func__, name, ret);
-		kfree(out);
-		return ERR_PTR(-EINVAL);
-	}
+	for (i = 0, cells = prop->value; i < count; i++)
+		out[i] = be32_to_cpup(cells + i);
 
 	if (triplet)
 		*triplet = count != opp_table->regulator_count;
@@ -759,8 +768,8 @@ static int _read_rate(struct dev_pm_opp *new_opp, struct opp_table *opp_table,
 		      struct device_node *np)
 {
 	struct property *prop;
-	int i, count, ret;
-	u64 *rates;
+	const __be32 *cells;
+	int i, count;
 
 	prop = of_find_property(np, "opp-hz", NULL);
 	if (!prop)
@@ -773,30 +782,27 @@ static int _read_rate(struct dev_pm_opp *new_opp, struct opp_table *opp_table,
 		return -EINVAL;
 	}
 
-	rates = kmalloc_array(count, sizeof(*rates), GFP_KERNEL);
-	if (!rates)
-		return -ENOMEM;
+	cells = prop->value;
+	if (!cells) {
+		pr_err("%s: Error parsing opp-hz: %d\n", __func__, -ENODATA);
+		return -ENODATA;
+	}
 
-	ret = of_property_read_u64_array(np, "opp-hz", rates, count);
-	if (ret) {
-		pr_err("%s: Error parsing opp-hz: %d\n", __func__, ret);
-	} else {
-		/*
-		 * Rate is defined as an unsigned long in clk API, and so
-		 * casting explicitly to its type. Must be fixed once rate is 64
-		 * bit guaranteed in clk API.
-		 */
-		for (i = 0; i < count; i++) {
-			new_opp->rates[i] = (unsigned long)rates[i];
+	/*
+	 * Rate is defined as an unsigned long in clk API, and so casting
+	 * explicitly to its type. Must be fixed once rate is 64 bit guaranteed
+	 * in clk API.
+	 */
+	for (i = 0; i < count; i++) {
+		u64 rate = of_read_number(cells + 2 * i, 2);
 
-			/* This will happen for frequencies > 4.29 GHz */
-			WARN_ON(new_opp->rates[i] != rates[i]);
-		}
-	}
+		new_opp->rates[i] = (unsigned long)rate;
 
-	kfree(rates);
+		/* This will happen for frequencies > 4.29 GHz */
+		WARN_ON(new_opp->rates[i] != rate);
+	}
 
-	return ret;
+	return 0;
 }
 
 static int _read_bw(struct dev_pm_opp *new_opp, struct opp_table *opp_table,
@@ -804,8 +810,8 @@ static int _read_bw(struct dev_pm_opp *new_opp, struct opp_table *opp_table,
 {
 	const char *name = peak ? "opp-peak-kBps" : "opp-avg-kBps";
 	struct property *prop;
-	int i, count, ret;
-	u32 *bw;
+	const __be32 *cells;
+	int i, count;
 
 	prop = of_find_property(np, name, NULL);
 	if (!prop)
@@ -818,26 +824,22 @@ static int _read_bw(struct dev_pm_opp *new_opp, struct opp_table *opp_table,
 		return -EINVAL;
 	}
 
-	bw = kmalloc_array(count, sizeof(*bw), GFP_KERNEL);
-	if (!bw)
-		return -ENOMEM;
-
-	ret = of_property_read_u32_array(np, name, bw, count);
-	if (ret) {
-		pr_err("%s: Error parsing %s: %d\n", __func__, name, ret);
-		goto out;
+	cells = prop->value;
+	if (!cells) {
+		pr_err("%s: Error parsing %s: %d\n", __func__, name, -ENODATA);
+		return -ENODATA;
 	}
 
 	for (i = 0; i < count; i++) {
+		u32 bw = be32_to_cpup(cells + i);
+
 		if (peak)
-			new_opp->bandwidth[i].peak = kBps_to_icc(bw[i]);
+			new_opp->bandwidth[i].peak = kBps_to_icc(bw);
 		else
-			new_opp->bandwidth[i].avg = kBps_to_icc(bw[i]);
+			new_opp->bandwidth[i].avg = kBps_to_icc(bw);
 	}
 
-out:
-	kfree(bw);
-	return ret;
+	return 0;
 }
 
 static int _read_opp_key(struct dev_pm_opp *new_opp,
@@ -15,6 +15,7 @@
 #include <linux/interconnect.h>
 #include <linux/kernel.h>
 #include <linux/kref.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/limits.h>
 #include <linux/pm_opp.h>
@@ -73,6 +74,7 @@ struct opp_config_data {
  *		IMPORTANT: the opp nodes should be maintained in increasing
  *		order.
  * @kref:	for reference count of the OPP.
+ * @rcu_head:	for freeing the OPP after a grace period (see opp_freq_index).
  * @available:	true/false - marks if this OPP as available or not
  * @dynamic:	not-created from static DT entries.
  * @turbo:	true if turbo (boost) OPP
@@ -88,12 +90,17 @@ struct opp_config_data {
  * @opp_table:	points back to the opp_table struct this opp belongs to
  * @np:		OPP's device node.
  * @dentry:	debugfs dentry pointer (per opp)
+ * @time_ns:	Time spent at this OPP up to the last switch away from it.
+ * @transitions: Number of switches to this OPP.
+ * @latency_ns:	Total time spent in _set_opp() switching to this OPP.
+ * @max_latency_ns: Longest switch to this OPP.
  *
  * This structure stores the OPP information for a given device.
  */
 struct dev_pm_opp {
 	struct list_head node;
 	struct kref kref;
+	struct rcu_head rcu_head;
 
 	bool available;
 	bool dynamic;
@@ -116,6 +123,10 @@ struct dev_pm_opp {
 #ifdef CONFIG_DEBUG_FS
 	struct dentry *dentry;
 	const char *of_name;
+	u64 time_ns;
+	u64 transitions;
+	u64 latency_ns;
+	u64 max_latency_ns;
 #endif
 };
 
@@ -130,13 +141,32 @@ struct dev_pm_opp {
  */
 struct opp_device {
 	struct list_head node;
-	const struct device *dev;
+	struct device *dev;
 
 #ifdef CONFIG_DEBUG_FS
 	struct dentry *dentry;
 #endif
 };
 
+/**
+ * struct opp_freq_index - RCU-published array of the OPPs of a table
+ * @rcu:	for freeing the array after a grace period.
+ * @count:	number of entries.
+ * @entries:	OPPs in the order of the table's opp_list, along with their
+ *		first frequency, which is non-decreasing in that order.
+ *
+ * The OPPs pointed to are only freed after a grace period too, so the array
+ * can be searched under rcu_read_lock() without holding the table's lock.
+ */
+struct opp_freq_index {
+	struct rcu_head rcu;
+	unsigned int count;
+	struct {
+		unsigned long freq;
+		struct dev_pm_opp *opp;
+	} entries[];
+};
+
 enum opp_table_access {
 	OPP_TABLE_ACCESS_UNKNOWN = 0,
 	OPP_TABLE_ACCESS_EXCLUSIVE = 1,
@@ -151,13 +181,17 @@ enum opp_table_access {
  * @head:	notifier head to notify the OPP availability changes.
  * @dev_list:	list of devices that share these OPPs
  * @opp_list:	table of opps
+ * @freq_index:	lock-free lookup array of the opps, rebuilt on changes.
  * @kref:	for reference count of the table.
+ * @rcu_head:	for freeing the table after lock-free lookups are done with it.
  * @lock:	mutex protecting the opp_list and dev_list.
  * @np:		struct device_node pointer for opp's DT node.
  * @clock_latency_ns_max: Max clock latency in nanoseconds.
  * @parsed_static_opps: Count of devices for which OPPs are initialized from DT.
  * @shared_opp: OPP is shared between multiple devices.
  * @rate_clk_single: Currently configured frequency for single clk.
+ * @current_rate_req: Frequency passed to dev_pm_opp_set_rate() to set
+ *		@current_opp, or 0 if @current_opp has been set differently.
  * @current_opp: Currently configured OPP for the table.
  * @suspend_opp: Pointer to OPP to be used during device suspend.
  * @genpd_virt_dev_lock: Mutex protecting the genpd virtual device pointers.
@@ -184,6 +218,8 @@ enum opp_table_access {
  * @set_required_opps: Helper responsible to set required OPPs.
  * @dentry:	debugfs dentry pointer of the real device directory (not links).
  * @dentry_name: Name of the real dentry.
+ * @stats_stamp: Time of the last switch to @current_opp while the OPP
+ *		statistics were enabled, 0 if unknown.
  *
  * @voltage_tolerance_v1: In percentage, for v1 bindings only.
  *
@@ -197,7 +233,9 @@ struct opp_table {
 	struct blocking_notifier_head head;
 	struct list_head dev_list;
 	struct list_head opp_list;
+	struct opp_freq_index __rcu *freq_index;
 	struct kref kref;
+	struct rcu_head rcu_head;
 	struct mutex lock;
 
 	struct device_node *np;
@@ -209,6 +247,7 @@ struct opp_table {
 	unsigned int parsed_static_opps;
 	enum opp_table_access shared_opp;
 	unsigned long rate_clk_single;
+	unsigned long current_rate_req;
 	struct dev_pm_opp *current_opp;
 	struct dev_pm_opp *suspend_opp;
 
@@ -237,6 +276,7 @@ struct opp_table {
 #ifdef CONFIG_DEBUG_FS
 	struct dentry *dentry;
 	char dentry_name[NAME_MAX];
+	ktime_t stats_stamp;
 #endif
 };
 
@@ -246,7 +286,7 @@ bool _opp_remove_all_static(struct opp_table *opp_table);
 void _get_opp_table_kref(struct opp_table *opp_table);
 int _get_opp_count(struct opp_table *opp_table);
 struct opp_table *_find_opp_table(struct device *dev);
-struct opp_device *_add_opp_dev(const struct device *dev, struct opp_table *opp_table);
+struct opp_device *_add_opp_dev(struct device *dev, struct opp_table *opp_table);
 struct dev_pm_opp *_opp_allocate(struct opp_table *opp_table);
 void _opp_free(struct dev_pm_opp *opp);
 int _opp_compare_key(struct opp_table *opp_table, struct dev_pm_opp *opp1, struct dev_pm_opp *opp2);
@@ -258,6 +298,13 @@ void _put_opp_list_kref(struct opp_table *opp_table);
 void _required_opps_available(struct dev_pm_opp *opp, int count);
 void _update_set_required_opps(struct opp_table *opp_table);
 
+/* Make @opp_table visible to lookups for @dev, see _find_opp_table(). */
+static inline void _opp_dev_publish(struct device *dev,
+				    struct opp_table *opp_table)
+{
+	rcu_assign_pointer(dev->power.opp_table, opp_table);
+}
+
 static inline bool lazy_linking_pending(struct opp_table *opp_table)
 {
 	return unlikely(!list_empty(&opp_table->lazy));
@@ -280,6 +327,11 @@ void opp_debug_remove_one(struct dev_pm_opp *opp);
 void opp_debug_create_one(struct dev_pm_opp *opp, struct opp_table *opp_table);
 void opp_debug_register(struct opp_device *opp_dev, struct opp_table *opp_table);
 void opp_debug_unregister(struct opp_device *opp_dev, struct opp_table *opp_table);
+ktime_t opp_debug_stats_start(void);
+void opp_debug_stats_update(struct opp_table *opp_table,
+			    struct dev_pm_opp *old_opp, struct dev_pm_opp *opp,
+			    ktime_t start);
+void opp_debug_stats_reset(struct opp_table *opp_table);
 #else
 static inline void opp_debug_remove_one(struct dev_pm_opp *opp) {}
 
@@ -292,6 +344,15 @@ static inline void opp_debug_register(struct opp_device *opp_dev,
 static inline void opp_debug_unregister(struct opp_device *opp_dev,
 					struct opp_table *opp_table)
 { }
+
+static inline ktime_t opp_debug_stats_start(void) { return 0; }
+
+static inline void opp_debug_stats_update(struct opp_table *opp_table,
+					  struct dev_pm_opp *old_opp,
+					  struct dev_pm_opp *opp, ktime_t start)
+{ }
+
+static inline void opp_debug_stats_reset(struct opp_table *opp_table) { }
 #endif		/* DEBUG_FS */
 
 #endif		/* __DRIVER_OPP_H__ */
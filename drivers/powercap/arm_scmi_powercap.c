@@ -6,10 +6,12 @@
  */
 
 #include <linux/device.h>
+#include <linux/ktime.h>
 #include <linux/math.h>
 #include <linux/limits.h>
 #include <linux/list.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/powercap.h>
 #include <linux/scmi_protocol.h>
 #include <linux/slab.h>
@@ -19,6 +21,16 @@
 
 static const struct scmi_powercap_proto_ops *powercap_ops;
 
+/*
+ * Don't wait for the delayed response of asynchronous CAP set commands, so
+ * that a control loop setting the caps of many zones has them applied by the
+ * platform in parallel instead of one after another.
+ */
+static bool async_cap_set;
+module_param(async_cap_set, bool, 0644);
+MODULE_PARM_DESC(async_cap_set,
+		 "Return from CAP set before the platform has applied it");
+
 struct scmi_powercap_zone {
 	bool registered;
 	bool invalid;
@@ -29,6 +41,15 @@ struct scmi_powercap_zone {
 	struct scmi_powercap_zone *spzones;
 	struct powercap_zone zone;
 	struct list_head node;
+	/*
+	 * Last power measurement, the time at which it was read from the
+	 * platform and the time until which it is known not to change, if any
+	 */
+	struct mutex meas_lock;
+	ktime_t meas_read;
+	ktime_t meas_expire;
+	u32 meas_power;
+	u32 meas_pai;
 };
 
 struct scmi_powercap_root {
@@ -57,13 +78,44 @@ static int scmi_powercap_get_power_uw(struct powercap_zone *pz,
 {
 	struct scmi_powercap_zone *spz = to_scmi_powercap_zone(pz);
 	u32 avg_power, pai;
-	int ret;
+	ktime_t now;
+	int ret = 0;
 
 	if (!spz->info->powercap_monitoring)
 		return -EINVAL;
 
-	ret = powercap_ops->measurements_get(spz->ph, spz->info->id, &avg_power,
-					     &pai);
+	/*
+	 * The platform only updates the average at the end of each PAI, so
+	 * don't ask it again for a value that cannot have changed yet.
+	 *
+	 * The PAI boundaries are not known upfront, though.  A new value under
+	 * the same PAI means that an interval has ended between the previous
+	 * read and this one, so the next one cannot end before one PAI after
+	 * the previous read.  The value is only kept until then, which is only
+	 * in the future if the previous read was less than a PAI ago.
+	 * Otherwise, for example right after the PAI has changed, the platform
+	 * is asked on every read.
+	 */
+	mutex_lock(&spz->meas_lock);
+	now = ktime_get();
+	if (!ktime_before(now, spz->meas_expire)) {
+		ret = powercap_ops->measurements_get(spz->ph, spz->info->id,
+						     &avg_power, &pai);
+		if (!ret) {
+			if (spz->meas_pai && pai == spz->meas_pai &&
+			    avg_power != spz->meas_power)
+				spz->meas_expire = ktime_add_us(spz->meas_read,
+								pai);
+			else
+				spz->meas_expire = 0;
+
+			spz->meas_read = now;
+			spz->meas_power = avg_power;
+			spz->meas_pai = pai;
+		}
+	}
+	avg_power = spz->meas_power;
+	mutex_unlock(&spz->meas_lock);
 	if (ret)
 		return ret;
 
@@ -130,7 +182,8 @@ static int scmi_powercap_set_power_limit_uw(struct powercap_zone *pz, int cid,
 
 	scmi_powercap_normalize_cap(spz, power_uw, &norm_power);
 
-	return powercap_ops->cap_set(spz->ph, spz->info->id, norm_power, false);
+	return powercap_ops->cap_set(spz->ph, spz->info->id, norm_power,
+				     READ_ONCE(async_cap_set));
 }
 
 static int scmi_powercap_get_power_limit_uw(struct powercap_zone *pz, int cid,
@@ -173,13 +226,24 @@ static int scmi_powercap_set_time_window_us(struct powercap_zone *pz, int cid,
 {
 	struct scmi_powercap_zone *spz = to_scmi_powercap_zone(pz);
 	u32 norm_pai;
+	int ret;
 
 	if (!spz->info->powercap_pai_config)
 		return -EINVAL;
 
 	scmi_powercap_normalize_time(spz, time_window_us, &norm_pai);
 
-	return powercap_ops->pai_set(spz->ph, spz->info->id, norm_pai);
+	/*
+	 * Drop the last measurement once the new PAI is in place, so that it
+	 * cannot be replaced with one taken under the old PAI in the meantime.
+	 */
+	mutex_lock(&spz->meas_lock);
+	ret = powercap_ops->pai_set(spz->ph, spz->info->id, norm_pai);
+	spz->meas_expire = 0;
+	spz->meas_pai = 0;
+	mutex_unlock(&spz->meas_lock);
+
+	return ret;
 }
 
 static int scmi_powercap_get_time_window_us(struct powercap_zone *pz, int cid,
@@ -468,6 +532,7 @@ static int scmi_powercap_probe(struct scmi_device *sdev)
 		spz->dev = dev;
 		spz->ph = ph;
 		spz->spzones = pr->spzones;
+		mutex_init(&spz->meas_lock);
 		INIT_LIST_HEAD(&spz->node);
 		INIT_LIST_HEAD(&pr->registered_zones[i]);
 
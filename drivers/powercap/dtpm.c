@@ -34,6 +34,11 @@ static const char *constraint_name[] = {
 };
 
 static DEFINE_MUTEX(dtpm_lock);
+/*
+ * Serializes the updates of the power numbers and weights, which modify the
+ * ancestors of the node in question and so can race with each other.
+ */
+static DEFINE_MUTEX(dtpm_power_lock);
 static struct powercap_control_type *pct;
 static struct dtpm *root;
 
@@ -84,19 +89,24 @@ static int get_power_uw(struct powercap_zone *pcz, u64 *power_uw)
 	return __get_power_uw(to_dtpm(pcz), power_uw);
 }
 
+/*
+ * The weight of a node only depends on its own and its parent's power_max,
+ * so when the power numbers of a node change, only the weights of the
+ * children of its ancestors need to be updated.
+ */
 static void __dtpm_rebalance_weight(struct dtpm *dtpm)
 {
-	struct dtpm *child;
-
-	list_for_each_entry(child, &dtpm->children, sibling) {
+	struct dtpm *parent, *child;
 
-		pr_debug("Setting weight '%d' for '%s'\n",
-			 child->weight, child->zone.name);
+	for (parent = dtpm->parent; parent; parent = parent->parent) {
+		list_for_each_entry(child, &parent->children, sibling) {
 
-		child->weight = DIV64_U64_ROUND_CLOSEST(
-			child->power_max * 1024, dtpm->power_max);
+			pr_debug("Setting weight '%d' for '%s'\n",
+				 child->weight, child->zone.name);
 
-		__dtpm_rebalance_weight(child);
+			child->weight = DIV64_U64_ROUND_CLOSEST(
+				child->power_max * 1024, parent->power_max);
+		}
 	}
 }
 
@@ -137,6 +147,8 @@ int dtpm_update_power(struct dtpm *dtpm)
 {
 	int ret;
 
+	mutex_lock(&dtpm_power_lock);
+
 	__dtpm_sub_power(dtpm);
 
 	ret = dtpm->ops->update_power_uw(dtpm);
@@ -149,8 +161,9 @@ int dtpm_update_power(struct dtpm *dtpm)
 
 	__dtpm_add_power(dtpm);
 
-	if (root)
-		__dtpm_rebalance_weight(root);
+	__dtpm_rebalance_weight(dtpm);
+
+	mutex_unlock(&dtpm_power_lock);
 
 	return ret;
 }
@@ -177,7 +190,9 @@ int dtpm_release_zone(struct powercap_zone *pcz)
 	if (parent)
 		list_del(&dtpm->sibling);
 
+	mutex_lock(&dtpm_power_lock);
 	__dtpm_sub_power(dtpm);
+	mutex_unlock(&dtpm_power_lock);
 
 	if (dtpm->ops)
 		dtpm->ops->release(dtpm);
@@ -268,19 +283,33 @@ static int set_power_limit_uw(struct powercap_zone *pcz,
 			      int cid, u64 power_limit)
 {
 	struct dtpm *dtpm = to_dtpm(pcz);
+	struct dtpm *parent;
+	u64 old_limit;
 	int ret;
 
+	mutex_lock(&dtpm_power_lock);
+
 	/*
 	 * Don't allow values outside of the power range previously
 	 * set when initializing the power numbers.
 	 */
 	power_limit = clamp_val(power_limit, dtpm->power_min, dtpm->power_max);
+	old_limit = dtpm->power_limit;
 
 	ret = __set_power_limit_uw(dtpm, cid, power_limit);
 
+	/*
+	 * The limit of a parent is the sum of the limits of its children,
+	 * fix it up along the path to the root instead of recomputing it.
+	 */
+	for (parent = dtpm->parent; parent; parent = parent->parent)
+		parent->power_limit += dtpm->power_limit - old_limit;
+
 	pr_debug("%s: power limit: %llu uW, power max: %llu uW\n",
 		 dtpm->zone.name, dtpm->power_limit, dtpm->power_max);
 
+	mutex_unlock(&dtpm_power_lock);
+
 	return ret;
 }
 
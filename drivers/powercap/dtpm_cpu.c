@@ -13,6 +13,16 @@
  *
  * The CPU hotplug is supported and the power numbers will be updated
  * if a CPU is hot plugged / unplugged.
+ *
+ * By default, the power limit is turned into the highest OPP at which all
+ * the CPUs of the performance domain fit in the limit when fully busy. With
+ * the util_aware parameter set, the power of every OPP is instead estimated
+ * from the current utilization of the CPUs, which allows higher OPPs when
+ * some of the CPUs are not fully busy, and idle is injected on the CPUs if
+ * even the lowest OPP does not fit in the limit.  Frequency capping is
+ * preferred over idle injection down to the lowest OPP as it lowers the
+ * voltage too.  The estimation is only done when the limit is set, so this
+ * is meant for closed-loop controllers updating the limit periodically.
  */
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 
@@ -21,28 +31,117 @@
 #include <linux/cpuhotplug.h>
 #include <linux/dtpm.h>
 #include <linux/energy_model.h>
+#include <linux/idle_inject.h>
+#include <linux/moduleparam.h>
 #include <linux/of.h>
 #include <linux/pm_qos.h>
 #include <linux/slab.h>
 #include <linux/units.h>
 
+/* Period of the idle injection cycles, in usecs */
+#define DTPM_CPU_IDLE_PERIOD	10000
+/* Maximum share of idle time injected, in percent */
+#define DTPM_CPU_IDLE_MAX	50
+
 struct dtpm_cpu {
 	struct dtpm dtpm;
 	struct freq_qos_request qos_req;
+	struct idle_inject_device *ii_dev;
 	int cpu;
 };
 
 static DEFINE_PER_CPU(struct dtpm_cpu *, dtpm_per_cpu);
 
+static bool util_aware;
+module_param(util_aware, bool, 0444);
+MODULE_PARM_DESC(util_aware,
+		 "Distribute the power limit using the utilization of the CPUs");
+
 static struct dtpm_cpu *to_dtpm_cpu(struct dtpm *dtpm)
 {
 	return container_of(dtpm, struct dtpm_cpu, dtpm);
 }
 
+static void set_pd_idle(struct dtpm_cpu *dtpm_cpu, unsigned int idle_us)
+{
+	if (!IS_ENABLED(CONFIG_IDLE_INJECT) || !dtpm_cpu->ii_dev)
+		return;
+
+	if (!idle_us) {
+		idle_inject_stop(dtpm_cpu->ii_dev);
+		return;
+	}
+
+	idle_inject_set_duration(dtpm_cpu->ii_dev,
+				 DTPM_CPU_IDLE_PERIOD - idle_us, idle_us);
+	idle_inject_start(dtpm_cpu->ii_dev);
+}
+
+/*
+ * Power of the online CPUs in @cpus at the performance state @ps, in uW,
+ * assuming that they are busy in proportion of their current utilization.
+ */
+static u64 estimate_pd_power_uw(struct cpumask *cpus, struct em_perf_state *ps,
+				unsigned long max_freq)
+{
+	unsigned long cap, sum_busy = 0;
+	int cpu;
+
+	cap = mult_frac(arch_scale_cpu_capacity(cpumask_first(cpus)),
+			ps->frequency, max_freq);
+	if (!cap)
+		return 0;
+
+	for_each_cpu(cpu, cpus)
+		sum_busy += min(sched_cpu_util(cpu), cap);
+
+	return div_u64((u64)ps->power * MICROWATT_PER_MILLIWATT * sum_busy, cap);
+}
+
+static u64 set_pd_power_limit_util(struct dtpm_cpu *dtpm_cpu,
+				   struct em_perf_domain *pd,
+				   struct cpumask *cpus, u64 power_limit)
+{
+	struct em_perf_state *table;
+	unsigned long freq, max_freq;
+	unsigned int idle_us = 0;
+	u64 power = 0;
+	int i;
+
+	rcu_read_lock();
+	table = em_perf_state_from_pd(pd);
+	max_freq = table[pd->nr_perf_states - 1].frequency;
+
+	for (i = pd->nr_perf_states - 1; i > 0; i--) {
+		power = estimate_pd_power_uw(cpus, &table[i], max_freq);
+		if (power <= power_limit)
+			break;
+	}
+
+	/* Inject idle if even the lowest OPP does not fit in the budget */
+	if (!i) {
+		power = estimate_pd_power_uw(cpus, &table[0], max_freq);
+		if (power > power_limit)
+			idle_us = DTPM_CPU_IDLE_PERIOD -
+				div64_u64(DTPM_CPU_IDLE_PERIOD * power_limit, power);
+		idle_us = min(idle_us,
+			      DTPM_CPU_IDLE_PERIOD * DTPM_CPU_IDLE_MAX / 100);
+	}
+
+	freq = table[i].frequency;
+	rcu_read_unlock();
+
+	freq_qos_update_request(&dtpm_cpu->qos_req, freq);
+	set_pd_idle(dtpm_cpu, idle_us);
+
+	return power_limit;
+}
+
 static u64 set_pd_power_limit(struct dtpm *dtpm, u64 power_limit)
 {
 	struct dtpm_cpu *dtpm_cpu = to_dtpm_cpu(dtpm);
 	struct em_perf_domain *pd = em_cpu_get(dtpm_cpu->cpu);
+	struct em_perf_state *table;
 	struct cpumask cpus;
 	unsigned long freq;
 	u64 power;
@@ -51,20 +150,28 @@ static u64 set_pd_power_limit(struct dtpm *dtpm, u64 power_limit)
 	cpumask_and(&cpus, cpu_online_mask, to_cpumask(pd->cpus));
 	nr_cpus = cpumask_weight(&cpus);
 
+	if (util_aware && nr_cpus)
+		return set_pd_power_limit_util(dtpm_cpu, pd, &cpus, power_limit);
+
+	set_pd_idle(dtpm_cpu, 0);
+
+	rcu_read_lock();
+	table = em_perf_state_from_pd(pd);
+
 	for (i = 0; i < pd->nr_perf_states; i++) {
 
-		power = pd->table[i].power * nr_cpus;
+		power = table[i].power * nr_cpus;
 
 		if (power > power_limit)
 			break;
 	}
 
-	freq = pd->table[i - 1].frequency;
+	freq = table[i - 1].frequency;
+	power_limit = table[i - 1].power * nr_cpus;
+	rcu_read_unlock();
 
 	freq_qos_update_request(&dtpm_cpu->qos_req, freq);
 
-	power_limit = pd->table[i - 1].power * nr_cpus;
-
 	return power_limit;
 }
 
@@ -88,9 +195,11 @@ static u64 scale_pd_power_uw(struct cpumask *pd_mask, u64 power)
 static u64 get_pd_power_uw(struct dtpm *dtpm)
 {
 	struct dtpm_cpu *dtpm_cpu = to_dtpm_cpu(dtpm);
+	struct em_perf_state *table;
 	struct em_perf_domain *pd;
 	struct cpumask *pd_mask;
 	unsigned long freq;
+	u64 power = 0;
 	int i;
 
 	pd = em_cpu_get(dtpm_cpu->cpu);
@@ -99,36 +208,51 @@ static u64 get_pd_power_uw(struct dtpm *dtpm)
 
 	freq = cpufreq_quick_get(dtpm_cpu->cpu);
 
+	rcu_read_lock();
+	table = em_perf_state_from_pd(pd);
+
 	for (i = 0; i < pd->nr_perf_states; i++) {
 
-		if (pd->table[i].frequency < freq)
+		if (table[i].frequency < freq)
 			continue;
 
-		return scale_pd_power_uw(pd_mask, pd->table[i].power *
-					 MICROWATT_PER_MILLIWATT);
+		power = table[i].power * MICROWATT_PER_MILLIWATT;
+		break;
 	}
+	rcu_read_unlock();
 
-	return 0;
+	return power ? scale_pd_power_uw(pd_mask, power) : 0;
 }
 
 static int update_pd_power_uw(struct dtpm *dtpm)
 {
 	struct dtpm_cpu *dtpm_cpu = to_dtpm_cpu(dtpm);
 	struct em_perf_domain *em = em_cpu_get(dtpm_cpu->cpu);
+	struct em_perf_state *table;
 	struct cpumask cpus;
 	int nr_cpus;
 
 	cpumask_and(&cpus, cpu_online_mask, to_cpumask(em->cpus));
 	nr_cpus = cpumask_weight(&cpus);
 
-	dtpm->power_min = em->table[0].power;
+	rcu_read_lock();
+	table = em_perf_state_from_pd(em);
+
+	dtpm->power_min = table[0].power;
 	dtpm->power_min *= MICROWATT_PER_MILLIWATT;
 	dtpm->power_min *= nr_cpus;
 
-	dtpm->power_max = em->table[em->nr_perf_states - 1].power;
+	dtpm->power_max = table[em->nr_perf_states - 1].power;
 	dtpm->power_max *= MICROWATT_PER_MILLIWATT;
 	dtpm->power_max *= nr_cpus;
 
+	rcu_read_unlock();
+
+	/* Idle injection allows going below the lowest OPP */
+	if (util_aware && dtpm_cpu->ii_dev)
+		dtpm->power_min = div_u64(dtpm->power_min *
+					  (100 - DTPM_CPU_IDLE_MAX), 100);
+
 	return 0;
 }
 
@@ -140,6 +264,9 @@ static void pd_release(struct dtpm *dtpm)
 	if (freq_qos_request_active(&dtpm_cpu->qos_req))
 		freq_qos_remove_request(&dtpm_cpu->qos_req);
 
+	if (IS_ENABLED(CONFIG_IDLE_INJECT) && dtpm_cpu->ii_dev)
+		idle_inject_unregister(dtpm_cpu->ii_dev);
+
 	policy = cpufreq_cpu_get(dtpm_cpu->cpu);
 	if (policy) {
 		for_each_cpu(dtpm_cpu->cpu, policy->related_cpus)
@@ -184,6 +311,7 @@ static int __dtpm_cpu_setup(int cpu, struct dtpm *parent)
 	struct cpufreq_policy *policy;
 	struct em_perf_domain *pd;
 	char name[CPUFREQ_NAME_LEN];
+	unsigned long max_freq;
 	int ret = -ENOMEM;
 
 	dtpm_cpu = per_cpu(dtpm_per_cpu, cpu);
@@ -210,13 +338,20 @@ static int __dtpm_cpu_setup(int cpu, struct dtpm *parent)
 
 	snprintf(name, sizeof(name), "cpu%d-cpufreq", dtpm_cpu->cpu);
 
+	/* Idle injection is optional, only used with util_aware */
+	if (IS_ENABLED(CONFIG_IDLE_INJECT) && util_aware)
+		dtpm_cpu->ii_dev = idle_inject_register(policy->related_cpus);
+
 	ret = dtpm_register(name, &dtpm_cpu->dtpm, parent);
 	if (ret)
 		goto out_kfree_dtpm_cpu;
 
+	rcu_read_lock();
+	max_freq = em_perf_state_from_pd(pd)[pd->nr_perf_states - 1].frequency;
+	rcu_read_unlock();
+
 	ret = freq_qos_add_request(&policy->constraints,
-				   &dtpm_cpu->qos_req, FREQ_QOS_MAX,
-				   pd->table[pd->nr_perf_states - 1].frequency);
+				   &dtpm_cpu->qos_req, FREQ_QOS_MAX, max_freq);
 	if (ret)
 		goto out_dtpm_unregister;
 
@@ -229,6 +364,8 @@ static int __dtpm_cpu_setup(int cpu, struct dtpm *parent)
 out_kfree_dtpm_cpu:
 	for_each_cpu(cpu, policy->related_cpus)
 		per_cpu(dtpm_per_cpu, cpu) = NULL;
+	if (IS_ENABLED(CONFIG_IDLE_INJECT) && dtpm_cpu && dtpm_cpu->ii_dev)
+		idle_inject_unregister(dtpm_cpu->ii_dev);
 	kfree(dtpm_cpu);
 
 	return ret;
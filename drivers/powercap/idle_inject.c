@@ -28,6 +28,10 @@
  * The timer interrupt handler will wake up the idle injection kthreads for
  * all of the CPUs in the cpumask provided by the user.
  *
+ * Alternatively, in the staggered mode, the timer fires once for every online
+ * CPU in the cpumask during the cycle and wakes up the kthread of one CPU at a
+ * time, so that the idle periods of the CPUs are evenly spread over the cycle.
+ *
  * Idle injection is stopped synchronously and no leftover idle injection
  * kthread activity after its completion is guaranteed.
  *
@@ -65,6 +69,10 @@ struct idle_inject_thread {
  * @latency_us: max allowed latency
  * @update: Optional callback deciding whether or not to skip idle
  *		injection in the given cycle.
+ * @mode: synchronous or staggered injection
+ * @slot: index of the next CPU to inject idle on, in the staggered mode
+ * @slot_cpu: CPU idle was last injected on in the cycle, in the staggered mode
+ * @skip: skip the current cycle, in the staggered mode
  * @cpumask: mask of CPUs affected by idle injection
  *
  * This structure is used to define per instance idle inject device data. Each
@@ -86,6 +94,10 @@ struct idle_inject_device {
 	unsigned int run_duration_us;
 	unsigned int latency_us;
 	bool (*update)(void);
+	enum idle_inject_mode mode;
+	unsigned int slot;
+	int slot_cpu;
+	bool skip;
 	unsigned long cpumask[];
 };
 
@@ -111,6 +123,48 @@ static void idle_inject_wakeup(struct idle_inject_device *ii_dev)
 	}
 }
 
+/**
+ * idle_inject_staggered - inject idle on the next CPU of the cycle
+ * @ii_dev: target idle injection device
+ * @period_ns: duration of the whole cycle
+ *
+ * Wake up the idle injection task of the next online CPU in the cycle, the
+ * update() callback being invoked at the beginning of every cycle.
+ *
+ * Return: the time until the next CPU is due, in nanoseconds.
+ */
+static u64 idle_inject_staggered(struct idle_inject_device *ii_dev,
+				 u64 period_ns)
+{
+	unsigned int nr_cpus = cpumask_weight_and(to_cpumask(ii_dev->cpumask),
+						  cpu_online_mask);
+	struct idle_inject_thread *iit;
+	int cpu;
+
+	if (!nr_cpus)
+		return period_ns;
+
+	if (!ii_dev->slot) {
+		ii_dev->slot_cpu = -1;
+		ii_dev->skip = ii_dev->update && !ii_dev->update();
+	}
+
+	cpu = cpumask_next_and(ii_dev->slot_cpu, to_cpumask(ii_dev->cpumask),
+			       cpu_online_mask);
+	if (cpu < nr_cpu_ids && !ii_dev->skip) {
+		iit = per_cpu_ptr(&idle_inject_thread, cpu);
+		iit->should_run = 1;
+		wake_up_process(iit->tsk);
+	}
+	ii_dev->slot_cpu = cpu;
+
+	/* Start over if the CPUs are exhausted, e.g. due to CPU hotplug */
+	if (++ii_dev->slot >= nr_cpus || cpu >= nr_cpu_ids)
+		ii_dev->slot = 0;
+
+	return div_u64(period_ns, nr_cpus);
+}
+
 /**
  * idle_inject_timer_fn - idle injection timer function
  * @timer: idle injection hrtimer
@@ -126,14 +180,19 @@ static enum hrtimer_restart idle_inject_timer_fn(struct hrtimer *timer)
 	unsigned int duration_us;
 	struct idle_inject_device *ii_dev =
 		container_of(timer, struct idle_inject_device, timer);
-
-	if (!ii_dev->update || (ii_dev->update && ii_dev->update()))
-		idle_inject_wakeup(ii_dev);
+	u64 duration_ns;
 
 	duration_us = READ_ONCE(ii_dev->run_duration_us);
 	duration_us += READ_ONCE(ii_dev->idle_duration_us);
+	duration_ns = (u64)duration_us * NSEC_PER_USEC;
 
-	hrtimer_forward_now(timer, ns_to_ktime(duration_us * NSEC_PER_USEC));
+	if (ii_dev->mode == IDLE_INJECT_STAGGERED) {
+		duration_ns = idle_inject_staggered(ii_dev, duration_ns);
+	} else if (!ii_dev->update || (ii_dev->update && ii_dev->update())) {
+		idle_inject_wakeup(ii_dev);
+	}
+
+	hrtimer_forward_now(timer, ns_to_ktime(duration_ns));
 
 	return HRTIMER_RESTART;
 }
@@ -208,13 +267,28 @@ void idle_inject_set_latency(struct idle_inject_device *ii_dev,
 }
 EXPORT_SYMBOL_NS_GPL(idle_inject_set_latency, IDLE_INJECT);
 
+/**
+ * idle_inject_set_mode - select synchronous or staggered idle injection
+ * @ii_dev: idle injection control device structure
+ * @mode: new injection mode
+ *
+ * Must not be called while idle injection is in progress on @ii_dev.
+ */
+void idle_inject_set_mode(struct idle_inject_device *ii_dev,
+			  enum idle_inject_mode mode)
+{
+	ii_dev->mode = mode;
+}
+EXPORT_SYMBOL_NS_GPL(idle_inject_set_mode, IDLE_INJECT);
+
 /**
  * idle_inject_start - start idle injections
  * @ii_dev: idle injection control device structure
  *
  * The function starts idle injection by first waking up all of the idle
  * injection kthreads associated with @ii_dev to let them inject CPU idle time
- * sets up a timer to start the next idle injection period.
+ * sets up a timer to start the next idle injection period.  In the staggered
+ * mode, the kthreads are woken up one at a time by the timer instead.
  *
  * Return: -EINVAL if the CPU idle or CPU run time is not set or 0 on success.
  */
@@ -229,6 +303,13 @@ int idle_inject_start(struct idle_inject_device *ii_dev)
 	pr_debug("Starting injecting idle cycles on CPUs '%*pbl'\n",
 		 cpumask_pr_args(to_cpumask(ii_dev->cpumask)));
 
+	/* The timer handles all of the CPUs, starting right away */
+	if (ii_dev->mode == IDLE_INJECT_STAGGERED) {
+		ii_dev->slot = 0;
+		hrtimer_start(&ii_dev->timer, 0, HRTIMER_MODE_REL);
+		return 0;
+	}
+
 	idle_inject_wakeup(ii_dev);
 
 	hrtimer_start(&ii_dev->timer,
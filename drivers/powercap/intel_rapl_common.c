@@ -12,6 +12,7 @@
 #include <linux/device.h>
 #include <linux/slab.h>
 #include <linux/log2.h>
+#include <linux/math64.h>
 #include <linux/bitmap.h>
 #include <linux/delay.h>
 #include <linux/sysfs.h>
@@ -253,6 +254,7 @@ static int rapl_read_data_raw(struct rapl_domain *rd,
 static int rapl_write_data_raw(struct rapl_domain *rd,
 			       enum rapl_primitives prim,
 			       unsigned long long value);
+static int rapl_read_energy(struct rapl_domain *rd, bool xlate, u64 *data);
 static int rapl_read_pl_data(struct rapl_domain *rd, int pl,
 			      enum pl_prims pl_prim,
 			      bool xlate, u64 *data);
@@ -265,6 +267,25 @@ static void package_power_limit_irq_save(struct rapl_package *rp);
 
 static LIST_HEAD(rapl_packages);	/* guarded by CPU hotplug lock */
 
+/*
+ * With energy_cache_ms set, the energy counters of every package are read
+ * periodically by a work running on the lead CPU of the package, which does
+ * not need IPIs for that, and energy_uj returns the cached values, extended to
+ * 64 bits so that they do not wrap.  If the cached values are older than two
+ * periods, e.g. because the work has been delayed, they are refreshed by the
+ * reader.  The period has to be short enough for the 32-bit hardware counters
+ * not to wrap twice in between, so the work is not deferrable: an idle package
+ * keeps consuming energy and the counters must still be sampled in time.
+ */
+#define ENERGY_CACHE_MAX_MS	10000
+
+static unsigned int energy_cache_ms;
+module_param(energy_cache_ms, uint, 0444);
+MODULE_PARM_DESC(energy_cache_ms,
+		 "Period of the cached energy counter updates in ms (0 = disabled)");
+
+static void rapl_energy_refresh(struct rapl_package *rp);
+
 static const char *const rapl_domain_names[] = {
 	"package",
 	"core",
@@ -285,7 +306,23 @@ static int get_energy_counter(struct powercap_zone *power_zone,
 	cpus_read_lock();
 	rd = power_zone_to_rapl_domain(power_zone);
 
-	if (!rapl_read_data_raw(rd, ENERGY_COUNTER, true, &energy_now)) {
+	if (energy_cache_ms) {
+		struct rapl_package *rp = rd->rp;
+
+		mutex_lock(&rp->energy_lock);
+		if (time_after(jiffies, rp->energy_stamp +
+			       2 * msecs_to_jiffies(energy_cache_ms)))
+			rapl_energy_refresh(rp);
+
+		*energy_raw = mul_u64_u32_div(rd->energy_total, rd->energy_unit,
+					      ENERGY_UNIT_SCALE);
+		mutex_unlock(&rp->energy_lock);
+		cpus_read_unlock();
+
+		return 0;
+	}
+
+	if (!rapl_read_energy(rd, true, &energy_now)) {
 		*energy_raw = energy_now;
 		cpus_read_unlock();
 
@@ -300,7 +337,11 @@ static int get_max_energy_counter(struct powercap_zone *pcd_dev, u64 *energy)
 {
 	struct rapl_domain *rd = power_zone_to_rapl_domain(pcd_dev);
 
-	*energy = rapl_unit_xlate(rd, ENERGY_UNIT, ENERGY_STATUS_MASK, 0);
+	/* The cached counters do not wrap */
+	if (energy_cache_ms)
+		*energy = U64_MAX;
+	else
+		*energy = rapl_unit_xlate(rd, ENERGY_UNIT, ENERGY_STATUS_MASK, 0);
 	return 0;
 }
 
@@ -842,6 +883,25 @@ static int rapl_read_data_raw(struct rapl_domain *rd,
 	return 0;
 }
 
+/*
+ * Energy counters are read much more often than any other primitive, so let
+ * the interface read them directly instead of through the primitive info.
+ */
+static int rapl_read_energy(struct rapl_domain *rd, bool xlate, u64 *data)
+{
+	struct rapl_if_priv *priv = rd->rp->priv;
+	u64 value;
+
+	if (!priv->read_energy)
+		return rapl_read_data_raw(rd, ENERGY_COUNTER, xlate, data);
+
+	if (priv->read_energy(rd, &value))
+		return -EIO;
+
+	*data = xlate ? rapl_unit_xlate(rd, ENERGY_UNIT, value, 0) : value;
+	return 0;
+}
+
 /* Similar use of primitive info in the read counterpart */
 static int rapl_write_data_raw(struct rapl_domain *rd,
 			       enum rapl_primitives prim,
@@ -1498,11 +1558,169 @@ static int rapl_detect_domains(struct rapl_package *rp)
 	return 0;
 }
 
+/* Called with rp->energy_lock held, or before the package is visible. */
+static void rapl_energy_refresh(struct rapl_package *rp)
+{
+	struct rapl_domain *rd;
+	u64 val;
+
+	for (rd = rp->domains; rd < rp->domains + rp->nr_domains; rd++) {
+		if (rapl_read_energy(rd, false, &val))
+			continue;
+
+		rd->energy_total += (val - rd->energy_last) & ENERGY_STATUS_MASK;
+		rd->energy_last = val;
+	}
+
+	rp->energy_stamp = jiffies;
+}
+
+static void rapl_energy_queue(struct rapl_package *rp)
+{
+	unsigned long delay = msecs_to_jiffies(energy_cache_ms);
+
+	if (rp->lead_cpu >= 0)
+		queue_delayed_work_on(rp->lead_cpu, system_wq,
+				      &rp->energy_work, delay);
+	else
+		queue_delayed_work(system_wq, &rp->energy_work, delay);
+}
+
+static void rapl_energy_work_fn(struct work_struct *work)
+{
+	struct rapl_package *rp = container_of(to_delayed_work(work),
+					       struct rapl_package, energy_work);
+
+	mutex_lock(&rp->energy_lock);
+	rapl_energy_refresh(rp);
+	mutex_unlock(&rp->energy_lock);
+
+	rapl_energy_queue(rp);
+}
+
+static void rapl_energy_cache_init(struct rapl_package *rp)
+{
+	struct rapl_domain *rd;
+	u64 val;
+
+	mutex_init(&rp->energy_lock);
+	INIT_DELAYED_WORK(&rp->energy_work, rapl_energy_work_fn);
+
+	if (!energy_cache_ms)
+		return;
+
+	/* Start counting from zero */
+	for (rd = rp->domains; rd < rp->domains + rp->nr_domains; rd++)
+		if (!rapl_read_energy(rd, false, &val))
+			rd->energy_last = val;
+
+	rp->energy_stamp = jiffies;
+	rapl_energy_queue(rp);
+}
+
+/*
+ * Binary interface for updating many power limits at once, in the
+ * "power_limits" file of the powercap control type, meant for closed-loop
+ * power capping from user space.  Every write contains an array of
+ * struct rapl_pl_update records, in native byte order:
+ *
+ *	u32 package id (the logical die id, as in the name of the package zone)
+ *	u32 domain (enum rapl_domain_type)
+ *	u32 power limit (0 = PL1, 1 = PL2, 2 = PL4)
+ *	u32 reserved, must be 0
+ *	u64 power limit in micro-watts
+ *
+ * The records are applied in order, and the first failing one aborts the
+ * write with an error, leaving the earlier ones applied.
+ */
+struct rapl_pl_update {
+	u32 package;
+	u32 domain;
+	u32 pl;
+	u32 reserved;
+	u64 power_uw;
+};
+
+static struct rapl_domain *rapl_pl_update_domain(struct device *dev,
+						 const struct rapl_pl_update *u)
+{
+	struct rapl_package *rp;
+	struct rapl_domain *rd;
+
+	list_for_each_entry(rp, &rapl_packages, plist) {
+		if (&rp->priv->control_type->dev != dev || rp->id != u->package)
+			continue;
+
+		for (rd = rp->domains; rd < rp->domains + rp->nr_domains; rd++)
+			if (rd->id == u->domain)
+				return rd;
+	}
+
+	return NULL;
+}
+
+static ssize_t power_limits_write(struct file *filp, struct kobject *kobj,
+				  struct bin_attribute *attr, char *buf,
+				  loff_t off, size_t count)
+{
+	const struct rapl_pl_update *u = (const struct rapl_pl_update *)buf;
+	struct device *dev = kobj_to_dev(kobj);
+	struct rapl_package *last_rp = NULL;
+	size_t i, n = count / sizeof(*u);
+	int ret = 0;
+
+	if (off || !n || count % sizeof(*u))
+		return -EINVAL;
+
+	cpus_read_lock();
+	for (i = 0; i < n; i++, u++) {
+		static const int pls[] = { POWER_LIMIT1, POWER_LIMIT2, POWER_LIMIT4 };
+		struct rapl_domain *rd;
+
+		if (u->reserved || u->pl >= ARRAY_SIZE(pls)) {
+			ret = -EINVAL;
+			break;
+		}
+
+		rd = rapl_pl_update_domain(dev, u);
+		if (!rd) {
+			ret = -ENODEV;
+			break;
+		}
+
+		ret = rapl_write_pl_data(rd, pls[u->pl], PL_LIMIT, u->power_uw);
+		if (ret)
+			break;
+
+		if (rd->rp != last_rp) {
+			package_power_limit_irq_save(rd->rp);
+			last_rp = rd->rp;
+		}
+	}
+	cpus_read_unlock();
+
+	return ret ? ret : count;
+}
+static BIN_ATTR_WO(power_limits, 0);
+
+/* Whether other packages than @rp use the control type of @rp. */
+static bool rapl_control_type_in_use(struct rapl_package *rp)
+{
+	struct rapl_package *pos;
+
+	list_for_each_entry(pos, &rapl_packages, plist)
+		if (pos != rp && pos->priv->control_type == rp->priv->control_type)
+			return true;
+
+	return false;
+}
+
 /* called from CPU hotplug notifier, hotplug lock held */
 void rapl_remove_package(struct rapl_package *rp)
 {
 	struct rapl_domain *rd, *rd_package = NULL;
 
+	cancel_delayed_work_sync(&rp->energy_work);
 	package_power_limit_irq_restore(rp);
 
 	for (rd = rp->domains; rd < rp->domains + rp->nr_domains; rd++) {
@@ -1525,6 +1743,9 @@ void rapl_remove_package(struct rapl_package *rp)
 	/* do parent zone last */
 	powercap_unregister_zone(rp->priv->control_type,
 				 &rd_package->power_zone);
+	if (!rapl_control_type_in_use(rp))
+		sysfs_remove_bin_file(&rp->priv->control_type->dev.kobj,
+				      &bin_attr_power_limits);
 	list_del(&rp->plist);
 	kfree(rp);
 }
@@ -1586,13 +1807,22 @@ struct rapl_package *rapl_add_package(int id, struct rapl_if_priv *priv, bool id
 		ret = -ENODEV;
 		goto err_free_package;
 	}
+
+	rapl_energy_cache_init(rp);
+
 	ret = rapl_package_register_powercap(rp);
 	if (!ret) {
 		INIT_LIST_HEAD(&rp->plist);
+		if (!rapl_control_type_in_use(rp) &&
+		    sysfs_create_bin_file(&priv->control_type->dev.kobj,
+					  &bin_attr_power_limits))
+			pr_warn("%s: failed to create power_limits\n", rp->name);
 		list_add(&rp->plist, &rapl_packages);
 		return rp;
 	}
 
+	cancel_delayed_work_sync(&rp->energy_work);
+
 err_free_package:
 	kfree(rp->domains);
 	kfree(rp);
@@ -1665,6 +1895,8 @@ static int __init rapl_init(void)
 	const struct x86_cpu_id *id;
 	int ret;
 
+	energy_cache_ms = min(energy_cache_ms, ENERGY_CACHE_MAX_MS);
+
 	id = x86_match_cpu(rapl_ids);
 	if (id) {
 		defaults_msr = (struct rapl_defaults *)id->driver_data;
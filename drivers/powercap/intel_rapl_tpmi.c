@@ -84,6 +84,18 @@ static int tpmi_rapl_write_raw(int id, struct reg_action *ra)
 	return 0;
 }
 
+/* The energy counter is the low 32 bits of the Energy Status register */
+static int tpmi_rapl_read_energy(struct rapl_domain *rd, u64 *raw)
+{
+	void __iomem *mmio = rd->regs[RAPL_DOMAIN_REG_STATUS].mmio;
+
+	if (!mmio)
+		return -EINVAL;
+
+	*raw = lower_32_bits(readq(mmio));
+	return 0;
+}
+
 static struct tpmi_rapl_package *trp_alloc(int pkg_id)
 {
 	struct tpmi_rapl_package *trp;
@@ -269,6 +281,7 @@ static int intel_rapl_tpmi_probe(struct auxiliary_device *auxdev,
 	trp->priv.type = RAPL_IF_TPMI;
 	trp->priv.read_raw = tpmi_rapl_read_raw;
 	trp->priv.write_raw = tpmi_rapl_write_raw;
+	trp->priv.read_energy = tpmi_rapl_read_energy;
 	trp->priv.control_type = tpmi_control_type;
 
 	/* RAPL TPMI I/F is per physical package */
@@ -467,11 +467,142 @@ static ssize_t enabled_store(struct device *dev,
 
 static DEVICE_ATTR_RW(enabled);
 
+/*
+ * Binary snapshot of all of the zones of a control type, in the "zones" file
+ * of the control type, so that telemetry can read the energy, power and power
+ * limits of every zone with one read() instead of one open() and read() per
+ * zone and attribute.  See include/uapi/linux/powercap.h for the format.
+ *
+ * The zones are read while the file is read, so a snapshot that spans more
+ * than one read() is not taken at a single point in time.
+ */
+struct powercap_snapshot_ctx {
+	struct powercap_zone **zones;
+	int nr_zones;
+	int max_zones;
+};
+
+static void powercap_zone_snapshot(struct powercap_zone *power_zone,
+				   struct powercap_zone_snapshot *rec)
+{
+	int i;
+
+	memset(rec, 0, sizeof(*rec));
+	strscpy(rec->name, dev_name(&power_zone->dev), sizeof(rec->name));
+	rec->nr_constraints = power_zone->const_id_cnt;
+
+	if (power_zone->ops->get_energy_uj &&
+	    !power_zone->ops->get_energy_uj(power_zone, &rec->energy_uj))
+		rec->valid |= POWERCAP_SNAPSHOT_ENERGY;
+
+	if (power_zone->ops->get_power_uw &&
+	    !power_zone->ops->get_power_uw(power_zone, &rec->power_uw))
+		rec->valid |= POWERCAP_SNAPSHOT_POWER;
+
+	for (i = 0; i < min(power_zone->const_id_cnt,
+			    POWERCAP_SNAPSHOT_CONSTRAINTS); i++) {
+		const struct powercap_zone_constraint_ops *ops =
+						power_zone->constraints[i].ops;
+
+		if (!ops->get_power_limit_uw(power_zone, i,
+					     &rec->power_limit_uw[i]))
+			rec->valid |= POWERCAP_SNAPSHOT_LIMIT(i);
+	}
+}
+
+/* Take a reference on every zone, parents before their children */
+static int powercap_collect_zone(struct device *dev, void *data)
+{
+	struct powercap_snapshot_ctx *ctx = data;
+
+	/* A zone registered after the size check is left out */
+	if (ctx->nr_zones == ctx->max_zones)
+		return -EFBIG;
+
+	ctx->zones[ctx->nr_zones++] = to_powercap_zone(get_device(dev));
+
+	return device_for_each_child(dev, ctx, powercap_collect_zone);
+}
+
+static ssize_t zones_read(struct file *filp, struct kobject *kobj,
+			  struct bin_attribute *attr, char *buf,
+			  loff_t off, size_t count)
+{
+	struct powercap_control_type *control_type =
+					to_powercap_control_type(kobj_to_dev(kobj));
+	struct powercap_zone_snapshot rec;
+	struct powercap_snapshot_ctx ctx = {
+		.max_zones = PAGE_SIZE / sizeof(rec),
+	};
+	size_t copied = 0;
+	loff_t pos, start, end;
+	int i;
+
+	mutex_lock(&control_type->lock);
+	i = control_type->nr_zones;
+	mutex_unlock(&control_type->lock);
+
+	if (i > ctx.max_zones)
+		return -EFBIG;
+
+	ctx.zones = kcalloc(ctx.max_zones, sizeof(*ctx.zones), GFP_KERNEL);
+	if (!ctx.zones)
+		return -ENOMEM;
+
+	/*
+	 * The zones are pinned rather than read under control_type->lock,
+	 * because the drivers take their own locks (and cpus_read_lock())
+	 * to read them and also unregister zones with those held.  A zone
+	 * unregistered after this is still read, the device stays around
+	 * until it is released below.
+	 */
+	device_for_each_child(&control_type->dev, &ctx, powercap_collect_zone);
+
+	for (i = 0; i < ctx.nr_zones; i++) {
+		pos = (loff_t)i * sizeof(rec);
+
+		/* Only read the zones whose records are part of this read() */
+		if (pos + sizeof(rec) > off && pos < off + count) {
+			powercap_zone_snapshot(ctx.zones[i], &rec);
+
+			start = max(pos, off);
+			end = min_t(loff_t, pos + sizeof(rec), off + count);
+			memcpy(buf + (start - off),
+			       (char *)&rec + (start - pos), end - start);
+			copied += end - start;
+		}
+		put_device(&ctx.zones[i]->dev);
+	}
+
+	kfree(ctx.zones);
+
+	return copied;
+}
+static BIN_ATTR(zones, S_IRUSR, zones_read, NULL, PAGE_SIZE);
+
+/* The snapshot of the zones is only provided by control types */
+static umode_t powercap_bin_attr_visible(struct kobject *kobj,
+					 struct bin_attribute *attr, int n)
+{
+	return kobj_to_dev(kobj)->parent ? 0 : attr->attr.mode;
+}
+
 static struct attribute *powercap_attrs[] = {
 	&dev_attr_enabled.attr,
 	NULL,
 };
-ATTRIBUTE_GROUPS(powercap);
+
+static struct bin_attribute *powercap_bin_attrs[] = {
+	&bin_attr_zones,
+	NULL,
+};
+
+static const struct attribute_group powercap_group = {
+	.attrs = powercap_attrs,
+	.bin_attrs = powercap_bin_attrs,
+	.is_bin_visible = powercap_bin_attr_visible,
+};
+__ATTRIBUTE_GROUPS(powercap);
 
 static struct class powercap_class = {
 	.name = "powercap",
@@ -16,18 +16,23 @@
  * at boot.
  *
  * This file provides functionality to process HFI updates and relay these
- * updates to userspace.
+ * updates to userspace. Optionally, the performance capabilities are also used
+ * as the asym-packing priorities of the CPUs, so that the scheduler prefers the
+ * CPUs that can currently deliver the most performance.
  */
 
 #define pr_fmt(fmt)  "intel-hfi: " fmt
 
+#include <linux/bitfield.h>
 #include <linux/bitops.h>
 #include <linux/cpufeature.h>
 #include <linux/cpumask.h>
 #include <linux/gfp.h>
+#include <linux/intel_hfi.h>
 #include <linux/io.h>
 #include <linux/kernel.h>
 #include <linux/math.h>
+#include <linux/moduleparam.h>
 #include <linux/mutex.h>
 #include <linux/percpu-defs.h>
 #include <linux/printk.h>
@@ -39,6 +44,7 @@
 #include <linux/workqueue.h>
 
 #include <asm/msr.h>
+#include <asm/topology.h>
 
 #include "intel_hfi.h"
 #include "thermal_interrupt.h"
@@ -107,6 +113,8 @@ struct hfi_hdr {
  * @cpus:		CPUs represented in this HFI table instance
  * @hw_table:		Pointer to the HFI table of this instance
  * @update_work:	Delayed work to process HFI updates
+ * @next_urgent:	Earliest time, in jiffies, at which an urgent update may
+ *			be processed
  * @table_lock:		Lock to protect acceses to the table of this instance
  * @event_lock:		Lock to process HFI interrupts
  *
@@ -122,6 +130,7 @@ struct hfi_instance {
 	cpumask_var_t		cpus;
 	void			*hw_table;
 	struct delayed_work	update_work;
+	unsigned long		next_urgent;
 	raw_spinlock_t		table_lock;
 	raw_spinlock_t		event_lock;
 };
@@ -155,6 +164,16 @@ struct hfi_cpu_info {
 
 static DEFINE_PER_CPU(struct hfi_cpu_info, hfi_cpu_info) = { .index = -1 };
 
+/*
+ * Last capabilities reported for each CPU, packed in a single word so that
+ * they can be read locklessly when checking the urgency of an update.
+ */
+#define HFI_CAPS_VALID		BIT(31)
+#define HFI_CAPS_PERF		GENMASK(25, 16)
+#define HFI_CAPS_EFF		GENMASK(9, 0)
+
+static DEFINE_PER_CPU(u32, hfi_cpu_caps);
+
 static int max_hfi_instances;
 static struct hfi_instance *hfi_instances;
 
@@ -163,8 +182,62 @@ static DEFINE_MUTEX(hfi_instance_lock);
 
 static struct workqueue_struct *hfi_updates_wq;
 #define HFI_UPDATE_INTERVAL		HZ
+#define HFI_URGENT_INTERVAL		msecs_to_jiffies(10)
 #define HFI_MAX_THERM_NOTIFY_COUNT	16
 
+static unsigned int hfi_urgent_threshold = 10;
+module_param_named(urgent_threshold, hfi_urgent_threshold, uint, 0644);
+MODULE_PARM_DESC(urgent_threshold,
+		 "Change of performance capability, in percent, processed without delay (0: never)");
+
+static bool hfi_itmt;
+module_param_named(itmt, hfi_itmt, bool, 0444);
+MODULE_PARM_DESC(itmt, "Use HFI performance capabilities as ITMT priorities");
+
+static void hfi_itmt_work_fn(struct work_struct *work)
+{
+	sched_set_itmt_support();
+}
+
+static DECLARE_WORK(hfi_itmt_work, hfi_itmt_work_fn);
+
+/**
+ * intel_hfi_sets_itmt_prio() - Check if the HFI provides the ITMT priorities
+ *
+ * Return: true if the asym-packing priorities of the CPUs are set from the
+ * HFI performance capabilities, in which case other sources of them must not
+ * override them.
+ */
+bool intel_hfi_sets_itmt_prio(void)
+{
+	return hfi_itmt && hfi_instances;
+}
+
+static void hfi_set_itmt_prio(struct thermal_genl_cpu_caps *cpu_caps,
+			      int cpu_count)
+{
+	static bool itmt_scheduled;
+	int i, min_prio = INT_MAX, max_prio = 0;
+
+	for (i = 0; i < cpu_count; i++) {
+		int prio = cpu_caps[i].performance;
+
+		sched_set_itmt_core_prio(prio, cpu_caps[i].cpu);
+
+		min_prio = min(min_prio, prio);
+		max_prio = max(max_prio, prio);
+	}
+
+	/*
+	 * As in intel_pstate, ITMT support cannot be enabled while holding
+	 * hfi_instance_lock, which is acquired under the CPU hotplug lock.
+	 */
+	if (!itmt_scheduled && max_prio > min_prio) {
+		itmt_scheduled = true;
+		schedule_work(&hfi_itmt_work);
+	}
+}
+
 static void get_hfi_caps(struct hfi_instance *hfi_instance,
 			 struct thermal_genl_cpu_caps *cpu_caps)
 {
@@ -186,6 +259,10 @@ static void get_hfi_caps(struct hfi_instance *hfi_instance,
 		cpu_caps[i].performance = caps->perf_cap << 2;
 		cpu_caps[i].efficiency = caps->ee_cap << 2;
 
+		WRITE_ONCE(per_cpu(hfi_cpu_caps, cpu), HFI_CAPS_VALID |
+			   FIELD_PREP(HFI_CAPS_PERF, cpu_caps[i].performance) |
+			   FIELD_PREP(HFI_CAPS_EFF, cpu_caps[i].efficiency));
+
 		++i;
 	}
 	raw_spin_unlock_irq(&hfi_instance->table_lock);
@@ -214,6 +291,9 @@ static void update_capabilities(struct hfi_instance *hfi_instance)
 
 	get_hfi_caps(hfi_instance, cpu_caps);
 
+	if (hfi_itmt)
+		hfi_set_itmt_prio(cpu_caps, cpu_count);
+
 	if (cpu_count < HFI_MAX_THERM_NOTIFY_COUNT)
 		goto last_cmd;
 
@@ -243,15 +323,60 @@ static void hfi_update_work_fn(struct work_struct *work)
 	hfi_instance = container_of(to_delayed_work(work), struct hfi_instance,
 				    update_work);
 
+	WRITE_ONCE(hfi_instance->next_urgent, jiffies + HFI_URGENT_INTERVAL);
+
 	update_capabilities(hfi_instance);
 }
 
+/*
+ * Check if the performance capability of any CPU in the hardware table moved
+ * by hfi_urgent_threshold percent or more from the one last reported for it.
+ * Comparing with the local copy instead would let a series of small updates,
+ * each of them below the threshold, add up to an arbitrarily large change
+ * without ever being treated as urgent. Called with the table_lock held.
+ */
+static bool hfi_update_is_urgent(struct hfi_instance *hfi_instance)
+{
+	unsigned int threshold = READ_ONCE(hfi_urgent_threshold);
+	size_t data_offset = hfi_instance->data - hfi_instance->local_table;
+	int cpu;
+
+	if (!threshold)
+		return false;
+
+	for_each_cpu(cpu, hfi_instance->cpus) {
+		u32 val = READ_ONCE(per_cpu(hfi_cpu_caps, cpu));
+		struct hfi_cpu_data *new;
+		int old_perf_cap;
+		s16 index;
+
+		/* Nothing has been reported yet, the regular update will do. */
+		if (!(val & HFI_CAPS_VALID))
+			continue;
+
+		/* The reported capabilities are scaled to [0, 1023]. */
+		old_perf_cap = FIELD_GET(HFI_CAPS_PERF, val) >> 2;
+
+		index = per_cpu(hfi_cpu_info, cpu).index;
+		new = hfi_instance->hw_table + data_offset +
+		      index * hfi_features.cpu_stride;
+
+		/* Capabilities are 8-bit values. */
+		if (abs(new->perf_cap - old_perf_cap) * 100 >= threshold * 255)
+			return true;
+	}
+
+	return false;
+}
+
 void intel_hfi_process_event(__u64 pkg_therm_status_msr_val)
 {
 	struct hfi_instance *hfi_instance;
 	int cpu = smp_processor_id();
 	struct hfi_cpu_info *info;
 	u64 new_timestamp, msr, hfi;
+	unsigned long next;
+	bool urgent;
 
 	if (!pkg_therm_status_msr_val)
 		return;
@@ -301,6 +426,8 @@ void intel_hfi_process_event(__u64 pkg_therm_status_msr_val)
 
 	raw_spin_lock(&hfi_instance->table_lock);
 
+	urgent = hfi_update_is_urgent(hfi_instance);
+
 	/*
 	 * Copy the updated table into our local copy. This includes the new
 	 * timestamp.
@@ -317,8 +444,20 @@ void intel_hfi_process_event(__u64 pkg_therm_status_msr_val)
 	raw_spin_unlock(&hfi_instance->table_lock);
 	raw_spin_unlock(&hfi_instance->event_lock);
 
-	queue_delayed_work(hfi_updates_wq, &hfi_instance->update_work,
-			   HFI_UPDATE_INTERVAL);
+	if (!urgent) {
+		queue_delayed_work(hfi_updates_wq, &hfi_instance->update_work,
+				   HFI_UPDATE_INTERVAL);
+		return;
+	}
+
+	/*
+	 * Large changes of capabilities, typically thermal-induced throttling,
+	 * need to be reflected in task placement quickly. Process them right
+	 * away, but not more often than every HFI_URGENT_INTERVAL.
+	 */
+	next = READ_ONCE(hfi_instance->next_urgent);
+	mod_delayed_work(hfi_updates_wq, &hfi_instance->update_work,
+			 time_after(next, jiffies) ? next - jiffies : 0);
 }
 
 static void init_hfi_cpu_index(struct hfi_cpu_info *info)
@@ -397,6 +536,16 @@ void intel_hfi_online(unsigned int cpu)
 	mutex_lock(&hfi_instance_lock);
 	if (hfi_instance->hdr) {
 		cpumask_set_cpu(cpu, hfi_instance->cpus);
+
+		/* Do not wait for the next update to set the priority of @cpu. */
+		if (hfi_itmt) {
+			struct hfi_cpu_data *caps;
+
+			raw_spin_lock_irq(&hfi_instance->table_lock);
+			caps = hfi_instance->data + info->index * hfi_features.cpu_stride;
+			sched_set_itmt_core_prio(caps->perf_cap << 2, cpu);
+			raw_spin_unlock_irq(&hfi_instance->table_lock);
+		}
 		goto unlock;
 	}
 
@@ -484,6 +633,7 @@ void intel_hfi_offline(unsigned int cpu)
 
 	mutex_lock(&hfi_instance_lock);
 	cpumask_clear_cpu(cpu, hfi_instance->cpus);
+	WRITE_ONCE(per_cpu(hfi_cpu_caps, cpu), 0);
 	mutex_unlock(&hfi_instance_lock);
 }
 
@@ -559,7 +709,8 @@ void __init intel_hfi_init(void)
 			goto err_nomem;
 	}
 
-	hfi_updates_wq = create_singlethread_workqueue("hfi-updates");
+	hfi_updates_wq = alloc_ordered_workqueue("hfi-updates",
+						 WQ_MEM_RECLAIM | WQ_HIGHPRI);
 	if (!hfi_updates_wq)
 		goto err_nomem;
 
@@ -48,6 +48,11 @@
  * idle ratio. Similar to frequency modulation.
  */
 #define DEFAULT_DURATION_JIFFIES (6)
+/* Gains of the package power controller, in percent of idle ratio per
+ * percent of power error: proportional 1/2, integral 1/4 per window.
+ */
+#define POWER_KP_DIV (2)
+#define POWER_KI_DIV (4)
 
 static unsigned int target_mwait;
 static struct dentry *debug_dir;
@@ -65,6 +70,10 @@ struct powerclamp_data {
 	unsigned int guard;
 	unsigned int window_size_now;
 	unsigned int target_ratio;
+	unsigned int power_ratio;
+	int power_err;
+	u64 energy_last;
+	ktime_t energy_stamp;
 	bool clamping;
 };
 
@@ -79,6 +88,16 @@ static unsigned int duration;
 static unsigned int pkg_cstate_ratio_cur;
 static unsigned int window_size;
 
+/* log2 of the RAPL energy counter increments per Joule, 0 if not available */
+static unsigned int rapl_energy_unit;
+
+static unsigned int target_power;
+module_param(target_power, uint, 0644);
+MODULE_PARM_DESC(target_power, "package power to maintain while clamping in mW\n"
+	"\tthe idle ratio is adjusted based on the RAPL package energy\n"
+	"\tcounter, the cooling device state being its upper limit.\n"
+	"\t0 to control the package C-state residency instead, default.");
+
 static int duration_set(const char *arg, const struct kernel_param *kp)
 {
 	int ret = 0;
@@ -340,6 +359,18 @@ static void find_target_mwait(void)
 
 }
 
+static void find_rapl_energy_unit(void)
+{
+	u64 val;
+
+	if (rdmsrl_safe(MSR_PKG_ENERGY_STATUS, &val) ||
+	    rdmsrl_safe(MSR_RAPL_POWER_UNIT, &val))
+		return;
+
+	/* energy status units, bits 12:8 */
+	rapl_energy_unit = (val >> 8) & 0x1f;
+}
+
 struct pkg_cstate_info {
 	bool skip;
 	int msr_index;
@@ -456,6 +487,61 @@ static void adjust_compensation(int target_ratio, unsigned int win)
 	}
 }
 
+/*
+ * Package power control is only possible when the whole package is clamped,
+ * which is when poll_pkg_cstate_enable is set too.
+ */
+static bool powerclamp_power_mode(void)
+{
+	return READ_ONCE(target_power) && rapl_energy_unit &&
+		poll_pkg_cstate_enable;
+}
+
+/*
+ * PI controller, in the velocity form, computing the idle ratio needed to
+ * bring the package power measured over the last window to target_power.
+ * The ratio is kept within the cooling device state, so the integral term
+ * can't wind up.
+ */
+static void powerclamp_adjust_power(void)
+{
+	unsigned int target = READ_ONCE(target_power);
+	ktime_t now = ktime_get();
+	u64 energy, power;
+	s64 delta_us;
+	int err, ratio;
+
+	if (rdmsrl_safe(MSR_PKG_ENERGY_STATUS, &energy))
+		return;
+
+	delta_us = ktime_us_delta(now, powerclamp_data.energy_stamp);
+	if (!powerclamp_data.energy_stamp || delta_us <= 0) {
+		powerclamp_data.power_ratio = powerclamp_data.target_ratio;
+		powerclamp_data.power_err = 0;
+		goto update;
+	}
+
+	/* The counter is 32 bits wide, in 1 / 2^rapl_energy_unit Joules */
+	power = (u32)(energy - powerclamp_data.energy_last);
+	power = (power * USEC_PER_SEC) >> rapl_energy_unit;
+	power = div64_u64(power * MSEC_PER_SEC, delta_us);
+
+	err = clamp_t(s64, div_s64(((s64)power - target) * 100, target),
+		      -100, 100);
+
+	ratio = powerclamp_data.power_ratio;
+	ratio += (err - powerclamp_data.power_err) / POWER_KP_DIV;
+	ratio += err / POWER_KI_DIV;
+
+	powerclamp_data.power_ratio = clamp_t(int, ratio, 0,
+					      powerclamp_data.target_ratio);
+	powerclamp_data.power_err = err;
+
+update:
+	powerclamp_data.energy_last = energy;
+	powerclamp_data.energy_stamp = now;
+}
+
 static bool powerclamp_adjust_controls(unsigned int target_ratio,
 				unsigned int guard, unsigned int win)
 {
@@ -503,6 +589,18 @@ static unsigned int get_run_time(void)
 	powerclamp_data.guard = 1 + powerclamp_data.target_ratio / 20;
 	powerclamp_data.window_size_now = window_size;
 
+	/*
+	 * in the power mode, the controller output is the injected ratio,
+	 * it already accounts for what the HW actually achieves.
+	 */
+	if (powerclamp_power_mode()) {
+		powerclamp_data.power_ratio = min(powerclamp_data.power_ratio,
+						  powerclamp_data.target_ratio);
+		compensated_ratio = max(powerclamp_data.power_ratio, 1U);
+
+		return duration * 100 / compensated_ratio - duration;
+	}
+
 	/*
 	 * systems may have different ability to enter package level
 	 * c-states, thus we need to compensate the injected idle ratio
@@ -574,9 +672,15 @@ static bool idle_inject_update(void)
 
 	if (!(powerclamp_data.count % powerclamp_data.window_size_now)) {
 
-		should_skip = powerclamp_adjust_controls(powerclamp_data.target_ratio,
-							 powerclamp_data.guard,
-							 powerclamp_data.window_size_now);
+		if (powerclamp_power_mode()) {
+			powerclamp_adjust_power();
+			should_skip = !powerclamp_data.power_ratio;
+		} else {
+			powerclamp_data.energy_stamp = 0;
+			should_skip = powerclamp_adjust_controls(powerclamp_data.target_ratio,
+								 powerclamp_data.guard,
+								 powerclamp_data.window_size_now);
+		}
 		update = true;
 	}
 
@@ -656,6 +760,10 @@ static int start_power_clamp(void)
 
 	ret = powerclamp_idle_injection_register();
 	if (!ret) {
+		/* start from the full ratio, the controller backs off from it */
+		powerclamp_data.power_ratio = powerclamp_data.target_ratio;
+		powerclamp_data.energy_stamp = 0;
+
 		trigger_idle_injection();
 		if (poll_pkg_cstate_enable)
 			schedule_delayed_work(&poll_pkg_cstate_work, 0);
@@ -762,6 +870,9 @@ static int __init powerclamp_probe(void)
 	/* find the deepest mwait value */
 	find_target_mwait();
 
+	/* package energy is optional, only needed to control the power */
+	find_rapl_energy_unit();
+
 	return 0;
 }
 
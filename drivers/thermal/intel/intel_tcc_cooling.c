@@ -6,9 +6,12 @@
  */
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
 #include <linux/device.h>
 #include <linux/intel_tcc.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/thermal.h>
 #include <asm/cpu_device_id.h>
 
@@ -17,6 +20,53 @@
 
 static struct thermal_cooling_device *tcc_cdev;
 
+/*
+ * The TCC offset is a package scope setting. The last value written to all of
+ * the packages is cached, so that the governors can update the state as often
+ * as they want without touching the MSRs when it doesn't change.
+ */
+static DEFINE_MUTEX(tcc_lock);
+static int tcc_offset = -1;
+static cpumask_var_t tcc_cpus;
+static unsigned long *tcc_pkgs;
+
+struct tcc_update {
+	int offset;
+	atomic_t err;
+};
+
+static void tcc_set_offset_local(void *info)
+{
+	struct tcc_update *update = info;
+	int err;
+
+	err = intel_tcc_set_offset(-1, update->offset);
+	if (err)
+		atomic_set(&update->err, err);
+}
+
+/* Program all of the packages at once, one IPI to a CPU in each of them. */
+static int tcc_set_offset_all(int offset)
+{
+	struct tcc_update update = { .offset = offset, };
+	int cpu;
+
+	cpus_read_lock();
+
+	cpumask_clear(tcc_cpus);
+	bitmap_zero(tcc_pkgs, topology_max_packages());
+	for_each_online_cpu(cpu) {
+		if (!__test_and_set_bit(topology_logical_package_id(cpu), tcc_pkgs))
+			cpumask_set_cpu(cpu, tcc_cpus);
+	}
+
+	on_each_cpu_mask(tcc_cpus, tcc_set_offset_local, &update, true);
+
+	cpus_read_unlock();
+
+	return atomic_read(&update.err);
+}
+
 static int tcc_get_max_state(struct thermal_cooling_device *cdev, unsigned long
 			     *state)
 {
@@ -27,8 +77,14 @@ static int tcc_get_max_state(struct thermal_cooling_device *cdev, unsigned long
 static int tcc_get_cur_state(struct thermal_cooling_device *cdev, unsigned long
 			     *state)
 {
-	int offset = intel_tcc_get_offset(-1);
+	int offset;
+
+	mutex_lock(&tcc_lock);
+	offset = tcc_offset;
+	mutex_unlock(&tcc_lock);
 
+	if (offset < 0)
+		offset = intel_tcc_get_offset(-1);
 	if (offset < 0)
 		return offset;
 
@@ -39,7 +95,24 @@ static int tcc_get_cur_state(struct thermal_cooling_device *cdev, unsigned long
 static int tcc_set_cur_state(struct thermal_cooling_device *cdev, unsigned long
 			     state)
 {
-	return intel_tcc_set_offset(-1, (int)state);
+	int ret = 0;
+
+	if (state > 0x3f)
+		return -EINVAL;
+
+	mutex_lock(&tcc_lock);
+
+	if (tcc_offset == state)
+		goto unlock;
+
+	ret = tcc_set_offset_all(state);
+	/* The packages may be out of sync after a failure, don't trust them */
+	tcc_offset = ret ? -1 : state;
+
+unlock:
+	mutex_unlock(&tcc_lock);
+
+	return ret;
 }
 
 static const struct thermal_cooling_device_ops tcc_cooling_ops = {
@@ -99,14 +172,29 @@ static int __init tcc_cooling_init(void)
 
 	pr_info("Programmable TCC Offset detected\n");
 
+	if (!zalloc_cpumask_var(&tcc_cpus, GFP_KERNEL))
+		return -ENOMEM;
+
+	tcc_pkgs = bitmap_zalloc(topology_max_packages(), GFP_KERNEL);
+	if (!tcc_pkgs) {
+		ret = -ENOMEM;
+		goto free_cpus;
+	}
+
 	tcc_cdev =
 	    thermal_cooling_device_register("TCC Offset", NULL,
 					    &tcc_cooling_ops);
 	if (IS_ERR(tcc_cdev)) {
 		ret = PTR_ERR(tcc_cdev);
-		return ret;
+		goto free_pkgs;
 	}
 	return 0;
+
+free_pkgs:
+	bitmap_free(tcc_pkgs);
+free_cpus:
+	free_cpumask_var(tcc_cpus);
+	return ret;
 }
 
 module_init(tcc_cooling_init)
@@ -114,6 +202,8 @@ module_init(tcc_cooling_init)
 static void __exit tcc_cooling_exit(void)
 {
 	thermal_cooling_device_unregister(tcc_cdev);
+	bitmap_free(tcc_pkgs);
+	free_cpumask_var(tcc_cpus);
 }
 
 module_exit(tcc_cooling_exit)
@@ -18,7 +18,10 @@
 #include <linux/notifier.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
 #include <linux/percpu.h>
+#include <linux/slab.h>
 #include <linux/export.h>
 #include <linux/types.h>
 #include <linux/init.h>
@@ -122,6 +125,78 @@ EXPORT_SYMBOL_GPL(platform_thermal_package_rate_control);
 
 static DEFINE_PER_CPU(struct thermal_state, thermal_state);
 
+#define THERM_EVENT_RING_SIZE	64	/* Must be a power of 2 */
+#define THERM_HIST_BUCKETS	16
+
+/**
+ * struct therm_throt_event - Throttling transition, as exported to user space
+ * @time_ns:	CLOCK_MONOTONIC time of the transition
+ * @level:	CORE_LEVEL or PACKAGE_LEVEL
+ * @event:	THERMAL_THROTTLING_EVENT or POWER_LIMIT_EVENT
+ * @active:	1 when throttling starts, 0 when it ends
+ * @reserved:	Always 0
+ */
+struct therm_throt_event {
+	u64	time_ns;
+	u8	level;
+	u8	event;
+	u8	active;
+	u8	reserved[5];
+} __packed;
+
+/**
+ * struct therm_throt_log - Log of the throttling transitions seen by a CPU
+ * @head:	Number of transitions recorded so far
+ * @events:	The last THERM_EVENT_RING_SIZE transitions
+ * @start_ns:	Start time of the ongoing throttling, per level and event
+ * @hist:	Throttling durations, per level and event. Bucket 0 counts the
+ *		durations below 1 ms, bucket n the ones in [2^(n-1), 2^n) ms,
+ *		the last one also counting all of the longer ones.
+ *
+ * Only written from the thermal interrupt of the CPU it belongs to and read
+ * locklessly through sysfs, so it can be left running at no cost.
+ */
+struct therm_throt_log {
+	unsigned int			head;
+	struct therm_throt_event	events[THERM_EVENT_RING_SIZE];
+	u64				start_ns[2][2];
+	u32				hist[2][2][THERM_HIST_BUCKETS];
+};
+
+static DEFINE_PER_CPU(struct therm_throt_log, therm_throt_log);
+
+static void therm_throt_log_event(int level, int event, bool active)
+{
+	struct therm_throt_log *log = this_cpu_ptr(&therm_throt_log);
+	struct therm_throt_event *e;
+	u64 now = ktime_get_ns();
+	unsigned int bucket;
+	u64 ms;
+
+	e = &log->events[log->head & (THERM_EVENT_RING_SIZE - 1)];
+	e->time_ns = now;
+	e->level = level;
+	e->event = event;
+	e->active = active;
+
+	/* Publish the entry before the head that makes it visible. */
+	smp_store_release(&log->head, log->head + 1);
+
+	if (active) {
+		log->start_ns[level][event] = now;
+		return;
+	}
+
+	if (!log->start_ns[level][event])
+		return;
+
+	ms = div_u64(now - log->start_ns[level][event], NSEC_PER_MSEC);
+	bucket = ms ? min_t(unsigned int, ilog2(ms) + 1, THERM_HIST_BUCKETS - 1) : 0;
+	WRITE_ONCE(log->hist[level][event][bucket],
+		   log->hist[level][event][bucket] + 1);
+	log->start_ns[level][event] = 0;
+}
+
 static atomic_t therm_throt_en	= ATOMIC_INIT(0);
 
 static u32 lvtthmr_init __read_mostly;
@@ -177,6 +252,85 @@ define_therm_throt_device_one_ro(core_throttle_total_time_ms);
 define_therm_throt_device_show_func(package_throttle, total_time_ms);
 define_therm_throt_device_one_ro(package_throttle_total_time_ms);
 
+/*
+ * The events file starts with a u32 count of the transitions recorded since
+ * boot and a u32 number of entries, followed by that many struct
+ * therm_throt_event, oldest first.
+ */
+#define THERM_EVENTS_SIZE	(2 * sizeof(u32) + \
+				 THERM_EVENT_RING_SIZE * sizeof(struct therm_throt_event))
+
+static ssize_t events_read(struct file *filp, struct kobject *kobj,
+			   struct bin_attribute *attr, char *buf,
+			   loff_t off, size_t count)
+{
+	unsigned int cpu = kobj_to_dev(kobj)->id;
+	struct therm_throt_log *log = &per_cpu(therm_throt_log, cpu);
+	unsigned int head, tail, first, nr, i;
+	struct therm_throt_event *events;
+	u32 *hdr;
+	ssize_t ret;
+	void *snap;
+
+	snap = kzalloc(THERM_EVENTS_SIZE, GFP_KERNEL);
+	if (!snap)
+		return -ENOMEM;
+
+	hdr = snap;
+	events = snap + 2 * sizeof(u32);
+
+	head = smp_load_acquire(&log->head);
+	first = head > THERM_EVENT_RING_SIZE ? head - THERM_EVENT_RING_SIZE : 0;
+	for (i = first; i != head; i++)
+		events[i - first] = log->events[i & (THERM_EVENT_RING_SIZE - 1)];
+
+	/*
+	 * Drop the entries that may have been overwritten while copying,
+	 * including the one that may be being written right now.
+	 */
+	smp_rmb();
+	tail = READ_ONCE(log->head) + 1;
+	nr = head - first;
+	if (tail - first > THERM_EVENT_RING_SIZE) {
+		unsigned int lost = min(tail - first - THERM_EVENT_RING_SIZE, nr);
+
+		memmove(events, events + lost, (nr - lost) * sizeof(*events));
+		nr -= lost;
+	}
+
+	hdr[0] = head;
+	hdr[1] = nr;
+
+	ret = memory_read_from_buffer(buf, count, &off, snap,
+				      2 * sizeof(u32) + nr * sizeof(*events));
+	kfree(snap);
+
+	return ret;
+}
+static BIN_ATTR_RO(events, THERM_EVENTS_SIZE);
+
+/*
+ * The duration_hist file is an array of u32 [level][event][bucket] counts,
+ * see struct therm_throt_log.
+ */
+static ssize_t duration_hist_read(struct file *filp, struct kobject *kobj,
+				  struct bin_attribute *attr, char *buf,
+				  loff_t off, size_t count)
+{
+	unsigned int cpu = kobj_to_dev(kobj)->id;
+	struct therm_throt_log *log = &per_cpu(therm_throt_log, cpu);
+	u32 hist[2][2][THERM_HIST_BUCKETS];
+	int i, j, k;
+
+	for (i = 0; i < 2; i++)
+		for (j = 0; j < 2; j++)
+			for (k = 0; k < THERM_HIST_BUCKETS; k++)
+				hist[i][j][k] = READ_ONCE(log->hist[i][j][k]);
+
+	return memory_read_from_buffer(buf, count, &off, hist, sizeof(hist));
+}
+static BIN_ATTR_RO(duration_hist, sizeof_field(struct therm_throt_log, hist));
+
 static struct attribute *thermal_throttle_attrs[] = {
 	&dev_attr_core_throttle_count.attr,
 	&dev_attr_core_throttle_max_time_ms.attr,
@@ -184,9 +338,16 @@ static struct attribute *thermal_throttle_attrs[] = {
 	NULL
 };
 
+static struct bin_attribute *thermal_throttle_bin_attrs[] = {
+	&bin_attr_events,
+	&bin_attr_duration_hist,
+	NULL
+};
+
 static const struct attribute_group thermal_attr_group = {
-	.attrs	= thermal_throttle_attrs,
-	.name	= "thermal_throttle"
+	.attrs		= thermal_throttle_attrs,
+	.bin_attrs	= thermal_throttle_bin_attrs,
+	.name		= "thermal_throttle"
 };
 #endif /* CONFIG_SYSFS */
 
@@ -399,6 +560,9 @@ static void therm_throt_process(bool new_event, int event, int level)
 	old_event = state->new_event;
 	state->new_event = new_event;
 
+	if (new_event != old_event)
+		therm_throt_log_event(level, event, new_event);
+
 	if (new_event)
 		state->count++;
 
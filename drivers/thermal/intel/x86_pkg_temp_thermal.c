@@ -39,6 +39,23 @@ module_param(notify_delay_ms, int, 0644);
 MODULE_PARM_DESC(notify_delay_ms,
 	"User space notification delay in milli seconds.");
 
+/*
+* Adaptive mode: instead of being set to the trip points, the two thresholds
+* are placed around the current package temperature and moved along with it,
+* the thermal zone being updated on every crossing. The distance to them
+* (band) is doubled when crossings come faster than notify_delay_ms and
+* halved when they get four times slower, to bound the interrupt rate.
+*/
+static bool adaptive;
+module_param(adaptive, bool, 0444);
+MODULE_PARM_DESC(adaptive,
+	"Track the temperature with the thresholds, trip points are handled in software.");
+
+/* Adaptive threshold band, in degrees Celsius */
+#define PKG_TEMP_BAND_MIN	1
+#define PKG_TEMP_BAND_INIT	2
+#define PKG_TEMP_BAND_MAX	16
+
 /* Number of trip points in thermal zone. Currently it can't
 * be more than 2. MSR can allow setting and getting notifications
 * for only 2 thresholds. This define enforces this, if there
@@ -49,6 +66,10 @@ MODULE_PARM_DESC(notify_delay_ms,
 struct zone_device {
 	int				cpu;
 	bool				work_scheduled;
+	unsigned int			band;
+	unsigned long			last_intr;
+	/* Adaptive mode trip points, in degrees below TjMax, 0 if disabled */
+	u8				trip_offset[MAX_NUMBER_OF_TRIPS];
 	u32				msr_pkg_therm_low;
 	u32				msr_pkg_therm_high;
 	struct delayed_work		work;
@@ -136,6 +157,15 @@ sys_set_trip_temp(struct thermal_zone_device *tzd, int trip, int temp)
 	if (trip >= MAX_NUMBER_OF_TRIPS || val < 0 || val > 0x7f)
 		return -EINVAL;
 
+	/*
+	 * The thresholds track the temperature, the core checks the trips, but
+	 * the thresholds must not go past them, see pkg_thres_track().
+	 */
+	if (adaptive) {
+		WRITE_ONCE(zonedev->trip_offset[trip], temp ? val : 0);
+		return 0;
+	}
+
 	ret = rdmsr_on_cpu(zonedev->cpu, MSR_IA32_PACKAGE_THERM_INTERRUPT,
 			   &l, &h);
 	if (ret < 0)
@@ -205,6 +235,57 @@ static inline void disable_pkg_thres_interrupt(void)
 	wrmsr(MSR_IA32_PACKAGE_THERM_INTERRUPT, l, h);
 }
 
+/*
+ * Place the thresholds band degrees above and below the current temperature
+ * of the local package, but not beyond the nearest trip points, so crossing
+ * a trip point always raises an interrupt, and enable their interrupts.
+ */
+static void pkg_thres_track(struct zone_device *zonedev)
+{
+	u32 l, h, offset, high, low;
+	int i;
+
+	/* Digital readout, in degrees below TjMax */
+	rdmsr(MSR_IA32_PACKAGE_THERM_STATUS, l, h);
+	offset = (l >> 16) & 0x7f;
+
+	/* A threshold value of 0 is invalid */
+	high = offset > zonedev->band ? offset - zonedev->band : 1;
+	low = min(offset + zonedev->band, 0x7fU);
+
+	for (i = 0; i < MAX_NUMBER_OF_TRIPS; i++) {
+		u32 trip = READ_ONCE(zonedev->trip_offset[i]);
+
+		if (!trip)
+			continue;
+
+		/* Offsets grow as the temperature goes down */
+		if (trip < offset)
+			high = max(high, trip);
+		else
+			low = min(low, min(trip + 1, 0x7fU));
+	}
+
+	rdmsr(MSR_IA32_PACKAGE_THERM_INTERRUPT, l, h);
+	l &= ~(THERM_MASK_THRESHOLD0 | THERM_MASK_THRESHOLD1);
+	l |= high << THERM_SHIFT_THRESHOLD0 | low << THERM_SHIFT_THRESHOLD1;
+	l |= THERM_INT_THRESHOLD0_ENABLE | THERM_INT_THRESHOLD1_ENABLE;
+	wrmsr(MSR_IA32_PACKAGE_THERM_INTERRUPT, l, h);
+}
+
+/* Widen the band on interrupt storms, narrow it back when things settle */
+static void pkg_thres_adapt(struct zone_device *zonedev)
+{
+	unsigned long delay = msecs_to_jiffies(notify_delay_ms);
+
+	if (time_before(jiffies, zonedev->last_intr + delay))
+		zonedev->band = min(zonedev->band * 2, PKG_TEMP_BAND_MAX);
+	else if (time_after(jiffies, zonedev->last_intr + 4 * delay))
+		zonedev->band = max(zonedev->band / 2, PKG_TEMP_BAND_MIN);
+
+	zonedev->last_intr = jiffies;
+}
+
 static void pkg_temp_thermal_threshold_work_fn(struct work_struct *work)
 {
 	struct thermal_zone_device *tzone = NULL;
@@ -226,7 +307,10 @@ static void pkg_temp_thermal_threshold_work_fn(struct work_struct *work)
 	thermal_clear_package_intr_status(PACKAGE_LEVEL, THERM_LOG_THRESHOLD0 | THERM_LOG_THRESHOLD1);
 	tzone = zonedev->tzone;
 
-	enable_pkg_thres_interrupt();
+	if (adaptive)
+		pkg_thres_track(zonedev);
+	else
+		enable_pkg_thres_interrupt();
 	raw_spin_unlock_irq(&pkg_temp_lock);
 
 	/*
@@ -243,6 +327,10 @@ static void pkg_thermal_schedule_work(int cpu, struct delayed_work *work)
 {
 	unsigned long ms = msecs_to_jiffies(notify_delay_ms);
 
+	/* The band already limits the rate of adaptive updates */
+	if (adaptive)
+		ms = 0;
+
 	schedule_delayed_work_on(cpu, work, ms);
 }
 
@@ -260,6 +348,8 @@ static int pkg_thermal_notify(u64 msr_val)
 	/* Work is per package, so scheduling it once is enough. */
 	zonedev = pkg_temp_thermal_get_dev(cpu);
 	if (zonedev && !zonedev->work_scheduled) {
+		if (adaptive)
+			pkg_thres_adapt(zonedev);
 		zonedev->work_scheduled = true;
 		pkg_thermal_schedule_work(zonedev->cpu, &zonedev->work);
 	}
@@ -360,9 +450,22 @@ static int pkg_temp_thermal_device_add(unsigned int cpu)
 	rdmsr(MSR_IA32_PACKAGE_THERM_INTERRUPT, zonedev->msr_pkg_therm_low,
 	      zonedev->msr_pkg_therm_high);
 
+	zonedev->trip_offset[0] = (zonedev->msr_pkg_therm_low &
+				   THERM_MASK_THRESHOLD0) >> THERM_SHIFT_THRESHOLD0;
+	if (thres_count == MAX_NUMBER_OF_TRIPS)
+		zonedev->trip_offset[1] = (zonedev->msr_pkg_therm_low &
+					   THERM_MASK_THRESHOLD1) >> THERM_SHIFT_THRESHOLD1;
+
 	cpumask_set_cpu(cpu, &zonedev->cpumask);
+	zonedev->band = PKG_TEMP_BAND_INIT;
+	zonedev->last_intr = jiffies;
 	raw_spin_lock_irq(&pkg_temp_lock);
 	zones[id] = zonedev;
+	/* Let the work place the thresholds for the first time */
+	if (adaptive) {
+		zonedev->work_scheduled = true;
+		pkg_thermal_schedule_work(cpu, &zonedev->work);
+	}
 	raw_spin_unlock_irq(&pkg_temp_lock);
 
 	return 0;
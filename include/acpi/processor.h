@@ -77,15 +77,16 @@ struct acpi_processor_cx {
 };
 
 struct acpi_lpi_state {
+	/* Fields used on idle entry go first to share a cache line. */
+	u64 address;
+	u32 arch_flags;
+	u8 index;
+	u8 entry_method;
 	u32 min_residency;
 	u32 wake_latency; /* worst case */
 	u32 flags;
-	u32 arch_flags;
 	u32 res_cnt_freq;
 	u32 enable_parent_state;
-	u64 address;
-	u8 index;
-	u8 entry_method;
 	char desc[ACPI_CX_DESC_LEN];
 };
 
@@ -280,6 +281,9 @@ int acpi_processor_ffh_cstate_probe(unsigned int cpu,
 				    struct acpi_processor_cx *cx,
 				    struct acpi_power_register *reg);
 void acpi_processor_ffh_cstate_enter(struct acpi_processor_cx *cstate);
+bool acpi_processor_ffh_cstate_has_residency(struct acpi_processor_cx *cx);
+bool acpi_processor_ffh_cstate_reached(struct acpi_processor_cx *cx,
+				       u64 residency_ns);
 #else
 static inline void acpi_processor_power_init_bm_check(struct
 						      acpi_processor_flags
@@ -300,6 +304,15 @@ static inline void acpi_processor_ffh_cstate_enter(struct acpi_processor_cx
 {
 	return;
 }
+static inline bool acpi_processor_ffh_cstate_has_residency(struct acpi_processor_cx *cx)
+{
+	return false;
+}
+static inline bool acpi_processor_ffh_cstate_reached(struct acpi_processor_cx *cx,
+						     u64 residency_ns)
+{
+	return true;
+}
 #endif
 
 static inline int call_on_cpu(int cpu, long (*fn)(void *), void *arg,
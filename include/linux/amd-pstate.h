@@ -10,13 +10,23 @@
 #ifndef _LINUX_AMD_PSTATE_H
 #define _LINUX_AMD_PSTATE_H
 
+#include <linux/bits.h>
+#include <linux/math64.h>
+#include <linux/minmax.h>
 #include <linux/pm_qos.h>
 
+#include <asm/msr.h>
+
 #define AMD_CPPC_EPP_PERFORMANCE		0x00
 #define AMD_CPPC_EPP_BALANCE_PERFORMANCE	0x80
 #define AMD_CPPC_EPP_BALANCE_POWERSAVE		0xBF
 #define AMD_CPPC_EPP_POWERSAVE			0xFF
 
+#define MSR_AMD64_FREQ_SENSITIVITY_ACTUAL	0xc0010080
+#define MSR_AMD64_FREQ_SENSITIVITY_REFERENCE	0xc0010081
+#define AMD_FREQ_SENSITIVITY_CLASS_SHIFT	56
+#define AMD_FREQ_SENSITIVITY_MAX		1000
+
 /*********************************************************************
  *                        AMD P-state INTERFACE                       *
  *********************************************************************/
@@ -32,6 +42,64 @@ struct amd_aperf_mperf {
 	u64 tsc;
 };
 
+/**
+ * struct amd_freq_sensitivity
+ * @actual: last value of the frequency sensitivity actual counter
+ * @reference: last value of the frequency sensitivity reference counter
+ */
+struct amd_freq_sensitivity {
+	u64 actual;
+	u64 reference;
+};
+
+/**
+ * amd_freq_sensitivity_present - check for the frequency sensitivity counters
+ */
+static inline bool amd_freq_sensitivity_present(void)
+{
+	u64 val;
+
+	if (rdmsrl_safe(MSR_AMD64_FREQ_SENSITIVITY_ACTUAL, &val))
+		return false;
+
+	return val >> AMD_FREQ_SENSITIVITY_CLASS_SHIFT;
+}
+
+/**
+ * amd_freq_sensitivity_update - frequency sensitivity since the last update
+ * @fs: counter values of the last update
+ * @actual: current value of the actual counter
+ * @reference: current value of the reference counter
+ *
+ * The sensitivity is how much of a frequency change turns into a change of
+ * the performance of the workload, from 0 for a workload that only waits
+ * for memory, to AMD_FREQ_SENSITIVITY_MAX for one that is fully CPU bound.
+ *
+ * Return: the sensitivity, or -EAGAIN if it cannot be computed because the
+ * counters wrapped around or did not advance.
+ */
+static inline int amd_freq_sensitivity_update(struct amd_freq_sensitivity *fs,
+					      u64 actual, u64 reference)
+{
+	u64 d_actual, d_reference;
+	int ret = -EAGAIN;
+
+	/* The top byte of the counters is the class code */
+	actual &= GENMASK_ULL(AMD_FREQ_SENSITIVITY_CLASS_SHIFT - 1, 0);
+	reference &= GENMASK_ULL(AMD_FREQ_SENSITIVITY_CLASS_SHIFT - 1, 0);
+
+	if (actual >= fs->actual && reference > fs->reference) {
+		d_actual = actual - fs->actual;
+		d_reference = reference - fs->reference;
+		d_actual = min(d_actual, d_reference);
+		ret = div64_u64(AMD_FREQ_SENSITIVITY_MAX * d_actual, d_reference);
+	}
+
+	fs->actual = actual;
+	fs->reference = reference;
+	return ret;
+}
+
 /**
  * struct amd_cpudata - private CPU data for AMD P-State
  * @cpu: CPU number
@@ -56,6 +124,10 @@ struct amd_aperf_mperf {
  * @epp_cached: Cached CPPC energy-performance preference value
  * @policy: Cpufreq policy value
  * @cppc_cap1_cached Cached MSR_AMD_CPPC_CAP1 register value
+ * @sens: Frequency sensitivity counters sampled from the scheduler
+ * @sens_last: Last frequency sensitivity computed from @sens
+ * @sens_jiffies: Time when @sens was last sampled
+ * @sens_user: Frequency sensitivity counters sampled through sysfs
  *
  * The amd_cpudata is key private data for each CPU thread in AMD P-State, and
  * represents all the attributes and goals that AMD P-State requests at runtime.
@@ -88,6 +160,11 @@ struct amd_cpudata {
 	u32	policy;
 	u64	cppc_cap1_cached;
 	bool	suspended;
+
+	struct amd_freq_sensitivity sens;
+	int	sens_last;
+	unsigned long sens_jiffies;
+	struct amd_freq_sensitivity sens_user;
 };
 
 /*
@@ -305,6 +305,9 @@ struct cgroup_base_stat {
 #ifdef CONFIG_SCHED_CORE
 	u64 forceidle_sum;
 #endif
+#ifdef CONFIG_ENERGY_MODEL
+	u64 energy;		/* Energy Model estimate, in nJ */
+#endif
 };
 
 /*
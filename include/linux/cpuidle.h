@@ -15,6 +15,7 @@
 #include <linux/list.h>
 #include <linux/hrtimer.h>
 #include <linux/context_tracking.h>
+#include <linux/workqueue.h>
 
 #define CPUIDLE_STATE_MAX	10
 #define CPUIDLE_NAME_LEN	16
@@ -74,6 +75,16 @@ struct cpuidle_state {
 	int (*enter_s2idle)(struct cpuidle_device *dev,
 			    struct cpuidle_driver *drv,
 			    int index);
+
+	/*
+	 * Optional.  Called after ->enter has returned @index, with interrupts
+	 * enabled, to return the index of the (possibly shallower) state the
+	 * CPU has actually been in for @residency_ns, for example according
+	 * to hardware residency counters.
+	 */
+	int (*achieved)(struct cpuidle_device *dev,
+			struct cpuidle_driver *drv,
+			int index, u64 residency_ns);
 };
 
 /* Idle State Flags */
@@ -85,6 +96,7 @@ struct cpuidle_state {
 #define CPUIDLE_FLAG_OFF		BIT(4) /* disable this state by default */
 #define CPUIDLE_FLAG_TLB_FLUSHED	BIT(5) /* idle-state flushes TLBs */
 #define CPUIDLE_FLAG_RCU_IDLE		BIT(6) /* idle-state takes care of RCU */
+#define CPUIDLE_FLAG_COUPLED_LAST_MAN	BIT(7) /* coupled state entered by last cpu */
 
 struct cpuidle_device_kobj;
 struct cpuidle_state_kobj;
@@ -94,15 +106,20 @@ struct cpuidle_device {
 	unsigned int		registered:1;
 	unsigned int		enabled:1;
 	unsigned int		poll_time_limit:1;
+	unsigned int		poll_timed_out:1;
 	unsigned int		cpu;
 	ktime_t			next_hrtimer;
 
 	int			last_state_idx;
+	unsigned int		stats_skipped;
 	u64			last_residency_ns;
 	u64			poll_limit_ns;
+	u64			poll_adaptive_ns;
 	u64			forced_idle_latency_limit_ns;
 	struct cpuidle_state_usage	states_usage[CPUIDLE_STATE_MAX];
-	struct cpuidle_state_kobj *kobjs[CPUIDLE_STATE_MAX];
+	struct cpuidle_state_kobj *kobjs;
+	unsigned int		nr_kobjs;
+	struct work_struct	sysfs_work;
 	struct cpuidle_driver_kobj *kobj_driver;
 	struct cpuidle_device_kobj *kobj_dev;
 	struct list_head 	device_list;
@@ -110,9 +127,27 @@ struct cpuidle_device {
 #ifdef CONFIG_ARCH_NEEDS_CPU_IDLE_COUPLED
 	cpumask_t		coupled_cpus;
 	struct cpuidle_coupled	*coupled;
+	bool			coupled_last_man;
+#endif
+#ifdef CONFIG_CPU_IDLE_TELEMETRY
+	u64			telemetry_predicted_ns;
+	u64			telemetry_sleep_length_ns;
 #endif
 };
 
+/*
+ * Tell the telemetry code what the governor expects for the upcoming idle
+ * entry on @dev: the predicted idle duration and the time till the next timer.
+ */
+static inline void cpuidle_telemetry_predict(struct cpuidle_device *dev,
+					     u64 predicted_ns, u64 sleep_length_ns)
+{
+#ifdef CONFIG_CPU_IDLE_TELEMETRY
+	dev->telemetry_predicted_ns = predicted_ns;
+	dev->telemetry_sleep_length_ns = sleep_length_ns;
+#endif
+}
+
 DECLARE_PER_CPU(struct cpuidle_device *, cpuidle_devices);
 DECLARE_PER_CPU(struct cpuidle_device, cpuidle_dev);
 
@@ -269,10 +304,20 @@ extern void default_idle_call(void);
 
 #ifdef CONFIG_ARCH_NEEDS_CPU_IDLE_COUPLED
 void cpuidle_coupled_parallel_barrier(struct cpuidle_device *dev, atomic_t *a);
+
+static inline bool cpuidle_coupled_last_man(struct cpuidle_device *dev)
+{
+	return dev->coupled_last_man;
+}
 #else
 static inline void cpuidle_coupled_parallel_barrier(struct cpuidle_device *dev, atomic_t *a)
 {
 }
+
+static inline bool cpuidle_coupled_last_man(struct cpuidle_device *dev)
+{
+	return false;
+}
 #endif
 
 #if defined(CONFIG_CPU_IDLE) && defined(CONFIG_ARCH_HAS_CPU_RELAX)
@@ -289,6 +334,7 @@ struct cpuidle_governor {
 	char			name[CPUIDLE_NAME_LEN];
 	struct list_head 	governor_list;
 	unsigned int		rating;
+	bool			owns_poll_limit;
 
 	int  (*enable)		(struct cpuidle_driver *drv,
 					struct cpuidle_device *dev);
@@ -12,5 +12,9 @@ static inline void arch_haltpoll_enable(unsigned int cpu)
 static inline void arch_haltpoll_disable(unsigned int cpu)
 {
 }
+
+static inline void arch_haltpoll_update(u64 poll_ns, u64 block_ns)
+{
+}
 #endif
 #endif
@@ -10,6 +10,8 @@
 #define __LINUX_DEVFREQ_EVENT_H__
 
 #include <linux/device.h>
+#include <linux/seqlock.h>
+#include <linux/workqueue.h>
 
 /**
  * struct devfreq_event_dev - the devfreq-event device
@@ -20,6 +22,16 @@
  * @lock	: a mutex to protect accessing devfreq-event.
  * @enable_count: the number of enable function have been called.
  * @desc	: the description for devfreq-event device.
+ * @sampling	: the counters are read in the background by @sample_work.
+ * @sample_work	: the work reading the counters every sample_ms.
+ * @sample_seq	: protects @load_sum and @total_sum for lock-free readers.
+ * @load_sum	: sum of the load counts read by @sample_work.
+ * @total_sum	: sum of the total counts read by @sample_work.
+ * @load_last	: @load_sum at the previous devfreq_event_get_event().
+ * @total_last	: @total_sum at the previous devfreq_event_get_event().
+ * @last_get	: time (jiffies) of the previous devfreq_event_get_event().
+ * @short_polls	: consecutive devfreq_event_get_event() calls less than
+ *		  sample_ms apart.
  *
  * This structure contains devfreq-event device information.
  */
@@ -31,6 +43,16 @@ struct devfreq_event_dev {
 	u32 enable_count;
 
 	const struct devfreq_event_desc *desc;
+
+	bool sampling;
+	struct delayed_work sample_work;
+	seqcount_mutex_t sample_seq;
+	u64 load_sum;
+	u64 total_sum;
+	u64 load_last;
+	u64 total_last;
+	unsigned long last_get;
+	unsigned int short_polls;
 };
 
 /**
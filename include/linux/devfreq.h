@@ -21,6 +21,7 @@
 #define DEVFREQ_GOV_POWERSAVE		"powersave"
 #define DEVFREQ_GOV_USERSPACE		"userspace"
 #define DEVFREQ_GOV_PASSIVE		"passive"
+#define DEVFREQ_GOV_BW_ONDEMAND		"bw_ondemand"
 
 /* DEVFREQ notifier interface */
 #define DEVFREQ_TRANSITION_NOTIFIER	(0)
@@ -33,6 +34,7 @@
 enum devfreq_timer {
 	DEVFREQ_TIMER_DEFERRABLE = 0,
 	DEVFREQ_TIMER_DELAYED,
+	DEVFREQ_TIMER_EVENT,
 	DEVFREQ_TIMER_NUM,
 };
 
@@ -77,7 +79,17 @@ struct devfreq_dev_status {
  * @initial_freq:	The operating frequency when devfreq_add_device() is
  *			called.
  * @polling_ms:		The polling interval in ms. 0 disables polling.
- * @timer:		Timer type is either deferrable or delayed timer.
+ *			With the event timer, this is the interval of the
+ *			fallback polling, if any.
+ * @timer:		Timer type is either deferrable or delayed timer, or
+ *			the event timer, with which the load is evaluated when
+ *			the driver calls devfreq_monitor_trigger(), typically
+ *			when its load counters cross the thresholds below.
+ * @up_threshold:	Load (busy_time / total_time, in percent) above which
+ *			the device should trigger an update with the event
+ *			timer.  0 means the default (90).
+ * @down_threshold:	Load below which the device should trigger an update
+ *			with the event timer.  0 means the default (50).
  * @target:		The device should set its operating frequency at
  *			freq or lowest-upper-than-freq value. If freq is
  *			higher than any operable frequency, set maximum.
@@ -97,6 +109,10 @@ struct devfreq_dev_status {
  *			from devfreq_remove_device() call. If the user
  *			has registered devfreq->nb at a notifier-head,
  *			this is the time to unregister it.
+ * @set_thresholds:	Optional callback called with the event timer after
+ *			every evaluation of the load, to (re)arm the load
+ *			counters of the device with @up_threshold and
+ *			@down_threshold relative to the current frequency.
  * @freq_table:		Optional list of frequencies to support statistics
  *			and freq_table must be generated in ascending order.
  * @max_state:		The size of freq_table.
@@ -108,12 +124,16 @@ struct devfreq_dev_profile {
 	unsigned long initial_freq;
 	unsigned int polling_ms;
 	enum devfreq_timer timer;
+	unsigned int up_threshold;
+	unsigned int down_threshold;
 
 	int (*target)(struct device *dev, unsigned long *freq, u32 flags);
 	int (*get_dev_status)(struct device *dev,
 			      struct devfreq_dev_status *stat);
 	int (*get_cur_freq)(struct device *dev, unsigned long *freq);
 	void (*exit)(struct device *dev);
+	int (*set_thresholds)(struct device *dev, unsigned int up,
+			      unsigned int down);
 
 	unsigned long *freq_table;
 	unsigned int max_state;
@@ -121,18 +141,26 @@ struct devfreq_dev_profile {
 	bool is_cooling_device;
 };
 
+/* Number of log2(usecs) buckets of the residency histogram of each state */
+#define DEVFREQ_RES_HIST_BUCKETS	20
+
 /**
  * struct devfreq_stats - Statistics of devfreq device behavior
  * @total_trans:	Number of devfreq transitions.
  * @trans_table:	Statistics of devfreq transitions.
  * @time_in_state:	Statistics of devfreq states.
+ * @res_hist:		Histogram of the residencies in every state, with
+ *			DEVFREQ_RES_HIST_BUCKETS entries per state.
  * @last_update:	The last time stats were updated.
+ * @state_entry:	The time the current state was entered.
  */
 struct devfreq_stats {
 	unsigned int total_trans;
 	unsigned int *trans_table;
 	u64 *time_in_state;
+	u32 *res_hist;
 	u64 last_update;
+	ktime_t state_entry;
 };
 
 /**
@@ -160,12 +188,15 @@ struct devfreq_stats {
  * @scaling_min_freq:	Limit minimum frequency requested by OPP interface
  * @scaling_max_freq:	Limit maximum frequency requested by OPP interface
  * @stop_polling:	 devfreq polling status of a device.
+ * @monitor_started:	 the load monitoring work has been set up by
+ *			 devfreq_monitor_start() and not stopped yet.
  * @suspend_freq:	 frequency of a device set during suspend phase.
  * @resume_freq:	 frequency of a device set in resume phase.
  * @suspend_count:	 suspend requests counter for a device.
  * @stats:	Statistics of devfreq device behavior
  * @transition_notifier_list: list head of DEVFREQ_TRANSITION_NOTIFIER notifier
  * @cdev:	Cooling device pointer if the devfreq has cooling property
+ * @em_registered: The devfreq core has registered the Energy Model of dev.parent
  * @nb_min:		Notifier block for DEV_PM_QOS_MIN_FREQUENCY
  * @nb_max:		Notifier block for DEV_PM_QOS_MAX_FREQUENCY
  *
@@ -202,6 +233,7 @@ struct devfreq {
 	unsigned long scaling_min_freq;
 	unsigned long scaling_max_freq;
 	bool stop_polling;
+	bool monitor_started;
 
 	unsigned long suspend_freq;
 	unsigned long resume_freq;
@@ -214,6 +246,7 @@ struct devfreq {
 
 	/* Pointer to the cooling device if used for thermal mitigation */
 	struct thermal_cooling_device *cdev;
+	bool em_registered;
 
 	struct notifier_block nb_min;
 	struct notifier_block nb_max;
@@ -246,6 +279,9 @@ void devfreq_resume(void);
 /* update_devfreq() - Reevaluate the device and configure frequency */
 int update_devfreq(struct devfreq *devfreq);
 
+/* Supposed to be called by drivers using DEVFREQ_TIMER_EVENT */
+void devfreq_monitor_trigger(struct devfreq *devfreq);
+
 /* Helper functions for devfreq user device driver with OPP. */
 struct dev_pm_opp *devfreq_recommended_opp(struct device *dev,
 				unsigned long *freq, u32 flags);
@@ -294,6 +330,31 @@ struct devfreq_simple_ondemand_data {
 	unsigned int downdifferential;
 };
 
+struct icc_node;
+
+/**
+ * struct devfreq_bw_ondemand_data - ``void *data`` fed to struct devfreq
+ *	and devfreq_add_device
+ * @ondemand:		Thresholds for the load based frequency selection,
+ *			used as by the Simple-Ondemand governor.
+ * @node:		Interconnect node whose aggregated bandwidth requests
+ *			(in kBps) the device has to be able to serve.
+ * @bw_index:		Index of the bandwidth values of the OPPs to compare
+ *			the requests of @node with, see
+ *			dev_pm_opp_find_bw_ceil().
+ *
+ * The frequency chosen based on the load of the device is never lower than
+ * the frequency of the lowest OPP providing the bandwidth requested from
+ * @node.  If the interconnect provider wants the votes to apply right away,
+ * it can call update_devfreq() (or devfreq_monitor_trigger() with the event
+ * timer) from its set() callback.
+ */
+struct devfreq_bw_ondemand_data {
+	struct devfreq_simple_ondemand_data ondemand;
+	struct icc_node *node;
+	int bw_index;
+};
+
 enum devfreq_parent_dev_type {
 	DEVFREQ_PARENT_DEV,
 	CPUFREQ_PARENT_DEV,
@@ -315,6 +376,7 @@ enum devfreq_parent_dev_type {
  * @nb:			the notifier block for DEVFREQ_TRANSITION_NOTIFIER or
  *			CPUFREQ_TRANSITION_NOTIFIER list.
  * @cpu_data_list:	the list of cpu frequency data for all cpufreq_policy.
+ * @work:		the work updating the device after cpufreq transitions.
  *
  * The devfreq_passive_data have to set the devfreq instance of parent
  * device with governors except for the passive governor. But, don't need to
@@ -334,7 +396,9 @@ struct devfreq_passive_data {
 	/* For passive governor's internal use. Don't need to set them */
 	struct devfreq *this;
 	struct notifier_block nb;
+	struct notifier_block opp_nb;
 	struct list_head cpu_data_list;
+	struct work_struct work;
 };
 
 #if !defined(CONFIG_PM_DEVFREQ)
@@ -377,6 +441,8 @@ static inline int devfreq_resume_device(struct devfreq *devfreq)
 static inline void devfreq_suspend(void) {}
 static inline void devfreq_resume(void) {}
 
+static inline void devfreq_monitor_trigger(struct devfreq *devfreq) {}
+
 static inline struct dev_pm_opp *devfreq_recommended_opp(struct device *dev,
 					unsigned long *freq, u32 flags)
 {
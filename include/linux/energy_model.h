@@ -36,11 +36,21 @@ struct em_perf_state {
  */
 #define EM_PERF_STATE_INEFFICIENT BIT(0)
 
+#define EM_PERF_IDX_BUCKETS_SHIFT	6
+#define EM_PERF_IDX_BUCKETS		(1 << EM_PERF_IDX_BUCKETS_SHIFT)
+
 /**
  * struct em_perf_domain - Performance domain
- * @table:		List of performance states, in ascending order
+ * @table:		List of performance states, in ascending order,
+ *			protected by RCU (see em_perf_state_from_pd())
  * @nr_perf_states:	Number of performance states
  * @flags:		See "em_perf_domain flags"
+ * @idx_base:		Frequency of the lowest performance state
+ * @idx_shift:		Log2 of the frequency range covered by an @idx bucket
+ * @idx:		Index of the first performance state with a frequency
+ *			at or above the lower bound of each frequency bucket,
+ *			used for speeding up em_pd_get_efficient_state()
+ * @dbg_info:		Data of the per-state debugfs files
  * @cpus:		Cpumask covering the CPUs of the domain. It's here
  *			for performance reasons to avoid potential cache
  *			misses during energy calculations in the scheduler
@@ -53,9 +63,15 @@ struct em_perf_state {
  * field is unused.
  */
 struct em_perf_domain {
-	struct em_perf_state *table;
+	struct em_perf_state __rcu *table;
 	int nr_perf_states;
 	unsigned long flags;
+	unsigned long idx_base;
+	unsigned int idx_shift;
+	u16 idx[EM_PERF_IDX_BUCKETS];
+#ifdef CONFIG_DEBUG_FS
+	struct em_dbg_info *dbg_info;
+#endif
 	unsigned long cpus[];
 };
 
@@ -172,6 +188,22 @@ int em_dev_register_perf_domain(struct device *dev, unsigned int nr_states,
 				struct em_data_callback *cb, cpumask_t *span,
 				bool microwatts);
 void em_dev_unregister_perf_domain(struct device *dev);
+int em_dev_update_power(struct device *dev, const unsigned long *power);
+
+/**
+ * em_perf_state_from_pd() - Get the performance state table of a domain
+ * @pd : Performance domain to get the table for
+ *
+ * The table may be replaced by em_dev_update_power() at any time, so this
+ * must be called in an RCU read-side critical section and the returned table
+ * must not be accessed outside of it.
+ *
+ * Return: The table of performance states of @pd.
+ */
+static inline struct em_perf_state *em_perf_state_from_pd(struct em_perf_domain *pd)
+{
+	return rcu_dereference(pd->table);
+}
 
 /**
  * em_pd_get_efficient_state() - Get an efficient performance state from the EM
@@ -188,11 +220,18 @@ static inline
 struct em_perf_state *em_pd_get_efficient_state(struct em_perf_domain *pd,
 						unsigned long freq)
 {
+	struct em_perf_state *table = em_perf_state_from_pd(pd);
 	struct em_perf_state *ps;
+	unsigned long bucket = 0;
 	int i;
 
-	for (i = 0; i < pd->nr_perf_states; i++) {
-		ps = &pd->table[i];
+	/* Skip the states that are known to be below @freq. */
+	if (freq > pd->idx_base)
+		bucket = min_t(unsigned long, (freq - pd->idx_base) >> pd->idx_shift,
+			       EM_PERF_IDX_BUCKETS - 1);
+
+	for (i = pd->idx[bucket]; i < pd->nr_perf_states; i++) {
+		ps = &table[i];
 		if (ps->frequency >= freq) {
 			if (pd->flags & EM_PERF_DOMAIN_SKIP_INEFFICIENCIES &&
 			    ps->flags & EM_PERF_STATE_INEFFICIENT)
@@ -216,6 +255,7 @@ struct em_perf_state *em_pd_get_efficient_state(struct em_perf_domain *pd,
  * This function must be used only for CPU devices. There is no validation,
  * i.e. if the EM is a CPU type and has cpumask allocated. It is called from
  * the scheduler code quite frequently and that is why there is not checks.
+ * It must be called in an RCU read-side critical section.
  *
  * Return: the sum of the energy consumed by the CPUs of the domain assuming
  * a capacity state satisfying the max utilization of the domain.
@@ -241,7 +281,7 @@ static inline unsigned long em_cpu_energy(struct em_perf_domain *pd,
 	 */
 	cpu = cpumask_first(to_cpumask(pd->cpus));
 	scale_cpu = arch_scale_cpu_capacity(cpu);
-	ps = &pd->table[pd->nr_perf_states - 1];
+	ps = &em_perf_state_from_pd(pd)[pd->nr_perf_states - 1];
 
 	max_util = map_util_perf(max_util);
 	max_util = min(max_util, allowed_cpu_cap);
@@ -326,6 +366,11 @@ int em_dev_register_perf_domain(struct device *dev, unsigned int nr_states,
 static inline void em_dev_unregister_perf_domain(struct device *dev)
 {
 }
+static inline int em_dev_update_power(struct device *dev,
+				      const unsigned long *power)
+{
+	return -EINVAL;
+}
 static inline struct em_perf_domain *em_cpu_get(int cpu)
 {
 	return NULL;
@@ -11,6 +11,19 @@
 /* private idle injection device structure */
 struct idle_inject_device;
 
+/**
+ * enum idle_inject_mode - how the CPUs of an idle injection device are idled
+ * @IDLE_INJECT_SYNC: all of the CPUs are idled at the same time, which gives
+ *		      the deepest package idle states.
+ * @IDLE_INJECT_STAGGERED: the idle periods of the CPUs are spread evenly
+ *			   over the cycle, so that the other CPUs can keep
+ *			   serving requests while one of them is idled.
+ */
+enum idle_inject_mode {
+	IDLE_INJECT_SYNC,
+	IDLE_INJECT_STAGGERED,
+};
+
 struct idle_inject_device *idle_inject_register(struct cpumask *cpumask);
 
 struct idle_inject_device *idle_inject_register_full(struct cpumask *cpumask,
@@ -33,4 +46,7 @@ void idle_inject_get_duration(struct idle_inject_device *ii_dev,
 void idle_inject_set_latency(struct idle_inject_device *ii_dev,
 			     unsigned int latency_us);
 
+void idle_inject_set_mode(struct idle_inject_device *ii_dev,
+			  enum idle_inject_mode mode);
+
 #endif /* __IDLE_INJECT_H__ */
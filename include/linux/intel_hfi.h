@@ -0,0 +1,17 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ *  Interface of the Intel Hardware Feedback Interface (HFI) driver
+ */
+
+#ifndef _LINUX_INTEL_HFI_H
+#define _LINUX_INTEL_HFI_H
+
+#include <linux/types.h>
+
+#if defined(CONFIG_INTEL_HFI_THERMAL)
+bool intel_hfi_sets_itmt_prio(void);
+#else
+static inline bool intel_hfi_sets_itmt_prio(void) { return false; }
+#endif /* CONFIG_INTEL_HFI_THERMAL */
+
+#endif /* _LINUX_INTEL_HFI_H */
@@ -11,8 +11,10 @@
 #define __INTEL_RAPL_H__
 
 #include <linux/types.h>
+#include <linux/mutex.h>
 #include <linux/powercap.h>
 #include <linux/cpuhotplug.h>
+#include <linux/workqueue.h>
 
 enum rapl_if_type {
 	RAPL_IF_MSR,	/* RAPL I/F using MSR registers */
@@ -118,6 +120,8 @@ struct rapl_domain {
 	unsigned int power_unit;
 	unsigned int energy_unit;
 	unsigned int time_unit;
+	u64 energy_last;	/* last raw energy counter, for caching */
+	u64 energy_total;	/* raw energy counter extended to 64 bits */
 	struct rapl_package *rp;
 };
 
@@ -142,6 +146,9 @@ struct reg_action {
  *				registers.
  * @write_raw:			Callback for writing RAPL interface specific
  *				registers.
+ * @read_energy:		Optional. Callback for reading the raw energy
+ *				counter of a domain without going through
+ *				@read_raw and the primitive info.
  * @defaults:			internal pointer to interface default settings
  * @rpi:			internal pointer to interface primitive info
  */
@@ -154,6 +161,7 @@ struct rapl_if_priv {
 	int limits[RAPL_DOMAIN_MAX];
 	int (*read_raw)(int id, struct reg_action *ra);
 	int (*write_raw)(int id, struct reg_action *ra);
+	int (*read_energy)(struct rapl_domain *rd, u64 *raw);
 	void *defaults;
 	void *rpi;
 };
@@ -176,6 +184,10 @@ struct rapl_package {
 	struct cpumask cpumask;
 	char name[PACKAGE_DOMAIN_NAME_LENGTH];
 	struct rapl_if_priv *priv;
+	/* Energy counter caching, see energy_cache_ms */
+	struct delayed_work energy_work;
+	struct mutex energy_lock;
+	unsigned long energy_stamp;	/* jiffies of the last refresh */
 };
 
 struct rapl_package *rapl_find_package_domain(int id, struct rapl_if_priv *priv, bool id_is_cpu);
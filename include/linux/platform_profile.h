@@ -10,6 +10,9 @@
 #define _PLATFORM_PROFILE_H_
 
 #include <linux/bitops.h>
+#include <linux/errno.h>
+
+struct notifier_block;
 
 /*
  * If more options are added please update profile_names array in
@@ -38,4 +41,19 @@ int platform_profile_register(struct platform_profile_handler *pprof);
 int platform_profile_remove(void);
 void platform_profile_notify(void);
 
+#if IS_REACHABLE(CONFIG_ACPI_PLATFORM_PROFILE)
+int platform_profile_register_notifier(struct notifier_block *nb);
+int platform_profile_unregister_notifier(struct notifier_block *nb);
+#else
+static inline int platform_profile_register_notifier(struct notifier_block *nb)
+{
+	return -ENODEV;
+}
+
+static inline int platform_profile_unregister_notifier(struct notifier_block *nb)
+{
+	return -ENODEV;
+}
+#endif
+
 #endif  /*_PLATFORM_PROFILE_H_*/
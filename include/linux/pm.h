@@ -645,6 +645,10 @@ struct pm_subsys_data {
 #define DPM_FLAG_SMART_SUSPEND		BIT(2)
 #define DPM_FLAG_MAY_SKIP_RESUME	BIT(3)
 
+struct pm_runtime_adaptive;
+struct pm_runtime_hist;
+struct opp_table;
+
 struct dev_pm_info {
 	pm_message_t		power_state;
 	unsigned int		can_wakeup:1;
@@ -662,12 +666,18 @@ struct dev_pm_info {
 #ifdef CONFIG_PM_SLEEP
 	struct list_head	entry;
 	struct completion	completion;
+	bool			work_in_progress;	/* Owned by the PM core */
 	struct wakeup_source	*wakeup;
 	bool			wakeup_path:1;
 	bool			syscore:1;
 	bool			no_pm_callbacks:1;	/* Owned by the PM core */
 	unsigned int		must_resume:1;	/* Owned by the PM core */
 	unsigned int		may_skip_resume:1;	/* Set by subsystems */
+#ifdef CONFIG_PM_SLEEP_DEBUG
+	unsigned int		dpm_seq;	/* Owned by the PM core */
+	ktime_t			dpm_start;
+	ktime_t			dpm_end;
+#endif
 #else
 	unsigned int		should_wakeup:1;
 #endif
@@ -688,6 +698,7 @@ struct dev_pm_info {
 	bool			ignore_children:1;
 	unsigned int		no_callbacks:1;
 	unsigned int		irq_safe:1;
+	unsigned int		parallel_suppliers:1;
 	unsigned int		use_autosuspend:1;
 	unsigned int		timer_autosuspends:1;
 	unsigned int		memalloc_noio:1;
@@ -697,6 +708,12 @@ struct dev_pm_info {
 	enum rpm_status		last_status;
 	int			runtime_error;
 	int			autosuspend_delay;
+	int			adaptive_delay;
+	struct pm_runtime_adaptive	*adaptive;
+#ifdef CONFIG_PM_ADVANCED_DEBUG
+	struct pm_runtime_hist __percpu	*hist;
+	u64			hist_suspended_at;
+#endif
 	u64			last_busy;
 	u64			active_time;
 	u64			suspended_time;
@@ -705,6 +722,10 @@ struct dev_pm_info {
 	struct pm_subsys_data	*subsys_data;  /* Owned by the subsystem. */
 	void (*set_latency_tolerance)(struct device *, s32);
 	struct dev_pm_qos	*qos;
+	s32			subtree_resume_latency;	/* Including descendants */
+#ifdef CONFIG_PM_OPP
+	struct opp_table __rcu	*opp_table;	/* Owned by the OPP core */
+#endif
 };
 
 extern int dev_pm_get_subsys_data(struct device *dev);
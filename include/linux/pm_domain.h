@@ -8,6 +8,7 @@
 #ifndef _LINUX_PM_DOMAIN_H
 #define _LINUX_PM_DOMAIN_H
 
+#include <linux/atomic.h>
 #include <linux/device.h>
 #include <linux/ktime.h>
 #include <linux/mutex.h>
@@ -84,6 +85,7 @@ enum genpd_notication {
 
 struct dev_power_governor {
 	bool (*power_down_ok)(struct dev_pm_domain *domain);
+	void (*power_on)(struct dev_pm_domain *domain);
 	bool (*suspend_ok)(struct device *dev);
 };
 
@@ -99,8 +101,18 @@ struct genpd_governor_data {
 	ktime_t next_hrtimer;
 	bool cached_power_down_ok;
 	bool cached_power_down_state_idx;
+	s64 dev_constraint_ns;		/* Min device constraint, or -1 */
+	atomic64_t dev_next_wakeup;	/* Lower bound of device wakeups */
+	bool dev_next_wakeup_stale;	/* dev_next_wakeup needs a rescan */
+	ktime_t off_time;		/* When the domain was last powered off */
+	unsigned int short_intercepts;	/* Wakeups before any state paid off */
+	bool off_pending;		/* Power off outcome not recorded yet */
+	bool forced_idle;		/* All CPUs in forced idle at power off */
 };
 
+/* Number of log2(usecs) buckets of the power on/off latency histograms */
+#define GENPD_LAT_HIST_BUCKETS	16
+
 struct genpd_power_state {
 	s64 power_off_latency_ns;
 	s64 power_on_latency_ns;
@@ -109,6 +121,10 @@ struct genpd_power_state {
 	u64 rejected;
 	struct fwnode_handle *fwnode;
 	u64 idle_time;
+	unsigned int hits;
+	unsigned int intercepts;
+	u32 power_off_hist[GENPD_LAT_HIST_BUCKETS];
+	u32 power_on_hist[GENPD_LAT_HIST_BUCKETS];
 	void *data;
 };
 
@@ -158,6 +174,8 @@ struct generic_pm_domain {
 	unsigned int state_idx; /* state that genpd will go to when off */
 	u64 on_time;
 	u64 accounting_time;
+	u64 busy_count;	/* Power off refused as users are still on */
+	u64 vetoed_count; /* Power off refused by the governor */
 	const struct genpd_lock_ops *lock_ops;
 	union {
 		struct mutex mlock;
@@ -183,6 +201,10 @@ struct gpd_link {
 	/* Sub-domain's per-master domain performance state */
 	unsigned int performance_state;
 	unsigned int prev_performance_state;
+	/* Used to power on the parent concurrently with the other parents */
+	struct work_struct power_on_work;
+	unsigned int power_on_depth;
+	int power_on_ret;
 };
 
 struct gpd_timing_data {
@@ -237,11 +259,15 @@ int dev_pm_genpd_remove_notifier(struct device *dev);
 void dev_pm_genpd_set_next_wakeup(struct device *dev, ktime_t next);
 ktime_t dev_pm_genpd_get_next_hrtimer(struct device *dev);
 void dev_pm_genpd_synced_poweroff(struct device *dev);
+int pm_genpd_power_on_batch(struct generic_pm_domain **genpds, unsigned int nr);
+void pm_genpd_power_off_batch(struct generic_pm_domain **genpds,
+			      unsigned int nr);
 
 extern struct dev_power_governor simple_qos_governor;
 extern struct dev_power_governor pm_domain_always_on_gov;
 #ifdef CONFIG_CPU_IDLE
 extern struct dev_power_governor pm_domain_cpu_gov;
+extern struct dev_power_governor pm_domain_cpu_teo_gov;
 #endif
 #else
 
@@ -305,6 +331,16 @@ static inline ktime_t dev_pm_genpd_get_next_hrtimer(struct device *dev)
 static inline void dev_pm_genpd_synced_poweroff(struct device *dev)
 { }
 
+static inline int pm_genpd_power_on_batch(struct generic_pm_domain **genpds,
+					  unsigned int nr)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline void pm_genpd_power_off_batch(struct generic_pm_domain **genpds,
+					    unsigned int nr)
+{ }
+
 #define simple_qos_governor		(*(struct dev_power_governor *)(NULL))
 #define pm_domain_always_on_gov		(*(struct dev_power_governor *)(NULL))
 #endif
@@ -15,6 +15,8 @@
 #include <linux/plist.h>
 #include <linux/notifier.h>
 #include <linux/device.h>
+#include <linux/workqueue.h>
+#include <uapi/linux/pm_qos.h>
 
 enum pm_qos_flags_status {
 	PM_QOS_FLAGS_UNDEFINED = -1,
@@ -87,6 +89,9 @@ struct freq_constraints {
 	struct blocking_notifier_head min_freq_notifiers;
 	struct pm_qos_constraints max_freq;
 	struct blocking_notifier_head max_freq_notifiers;
+	unsigned long notify_pending;	/* Lists with changes not notified */
+	unsigned int notify_delay_ms;	/* Notification coalescing window */
+	struct delayed_work notify_work;
 };
 
 struct freq_qos_request {
@@ -145,18 +150,24 @@ bool pm_qos_update_flags(struct pm_qos_flags *pqf,
 
 #ifdef CONFIG_CPU_IDLE
 s32 cpu_latency_qos_limit(void);
+s32 cpu_latency_qos_limit_cpu(int cpu);
 bool cpu_latency_qos_request_active(struct pm_qos_request *req);
 void cpu_latency_qos_add_request(struct pm_qos_request *req, s32 value);
+void cpu_latency_qos_add_cpu_request(struct pm_qos_request *req, int cpu,
+				     s32 value);
 void cpu_latency_qos_update_request(struct pm_qos_request *req, s32 new_value);
 void cpu_latency_qos_remove_request(struct pm_qos_request *req);
 #else
 static inline s32 cpu_latency_qos_limit(void) { return INT_MAX; }
+static inline s32 cpu_latency_qos_limit_cpu(int cpu) { return INT_MAX; }
 static inline bool cpu_latency_qos_request_active(struct pm_qos_request *req)
 {
 	return false;
 }
 static inline void cpu_latency_qos_add_request(struct pm_qos_request *req,
 					       s32 value) {}
+static inline void cpu_latency_qos_add_cpu_request(struct pm_qos_request *req,
+						   int cpu, s32 value) {}
 static inline void cpu_latency_qos_update_request(struct pm_qos_request *req,
 						  s32 new_value) {}
 static inline void cpu_latency_qos_remove_request(struct pm_qos_request *req) {}
@@ -208,6 +219,15 @@ static inline s32 dev_pm_qos_raw_resume_latency(struct device *dev)
 		PM_QOS_RESUME_LATENCY_NO_CONSTRAINT :
 		pm_qos_read_value(&dev->power.qos->resume_latency);
 }
+
+/*
+ * Smallest resume latency constraint of @dev and all of its descendants,
+ * maintained incrementally as the constraints change.
+ */
+static inline s32 dev_pm_qos_subtree_resume_latency(struct device *dev)
+{
+	return READ_ONCE(dev->power.subtree_resume_latency);
+}
 #else
 static inline enum pm_qos_flags_status __dev_pm_qos_flags(struct device *dev,
 							  s32 mask)
@@ -289,6 +309,10 @@ static inline s32 dev_pm_qos_raw_resume_latency(struct device *dev)
 {
 	return PM_QOS_RESUME_LATENCY_NO_CONSTRAINT;
 }
+static inline s32 dev_pm_qos_subtree_resume_latency(struct device *dev)
+{
+	return PM_QOS_RESUME_LATENCY_NO_CONSTRAINT;
+}
 #endif
 
 static inline int freq_qos_request_active(struct freq_qos_request *req)
@@ -297,6 +321,8 @@ static inline int freq_qos_request_active(struct freq_qos_request *req)
 }
 
 void freq_constraints_init(struct freq_constraints *qos);
+void freq_qos_set_notify_delay(struct freq_constraints *qos,
+			       unsigned int delay_ms);
 
 s32 freq_qos_read_value(struct freq_constraints *qos,
 			enum freq_qos_req_type type);
@@ -305,6 +331,8 @@ int freq_qos_add_request(struct freq_constraints *qos,
 			 struct freq_qos_request *req,
 			 enum freq_qos_req_type type, s32 value);
 int freq_qos_update_request(struct freq_qos_request *req, s32 new_value);
+int freq_qos_update_requests(struct freq_qos_request **reqs,
+			     const s32 *new_values, unsigned int nr);
 int freq_qos_remove_request(struct freq_qos_request *req);
 int freq_qos_apply(struct freq_qos_request *req,
 		   enum pm_qos_req_action action, s32 value);
@@ -82,8 +82,12 @@ extern void pm_runtime_allow(struct device *dev);
 extern void pm_runtime_forbid(struct device *dev);
 extern void pm_runtime_no_callbacks(struct device *dev);
 extern void pm_runtime_irq_safe(struct device *dev);
+extern void pm_runtime_parallel_suppliers(struct device *dev, bool enable);
+extern int pm_runtime_get_sync_batch(struct device **devs, unsigned int nr);
+extern void pm_runtime_put_batch(struct device **devs, unsigned int nr);
 extern void __pm_runtime_use_autosuspend(struct device *dev, bool use);
 extern void pm_runtime_set_autosuspend_delay(struct device *dev, int delay);
+extern int pm_runtime_set_adaptive_autosuspend(struct device *dev, bool enable);
 extern u64 pm_runtime_autosuspend_expiration(struct device *dev);
 extern void pm_runtime_set_memalloc_noio(struct device *dev, bool enable);
 extern void pm_runtime_get_suppliers(struct device *dev);
@@ -300,12 +304,20 @@ static inline bool pm_runtime_enabled(struct device *dev) { return false; }
 
 static inline void pm_runtime_no_callbacks(struct device *dev) {}
 static inline void pm_runtime_irq_safe(struct device *dev) {}
+static inline void pm_runtime_parallel_suppliers(struct device *dev,
+						 bool enable) {}
+static inline int pm_runtime_get_sync_batch(struct device **devs,
+					    unsigned int nr) { return 0; }
+static inline void pm_runtime_put_batch(struct device **devs,
+					unsigned int nr) {}
 static inline bool pm_runtime_is_irq_safe(struct device *dev) { return false; }
 
 static inline bool pm_runtime_has_no_callbacks(struct device *dev) { return false; }
 static inline void pm_runtime_mark_last_busy(struct device *dev) {}
 static inline void __pm_runtime_use_autosuspend(struct device *dev,
 						bool use) {}
+static inline int pm_runtime_set_adaptive_autosuspend(struct device *dev,
+						      bool enable) { return -ENOSYS; }
 static inline void pm_runtime_set_autosuspend_delay(struct device *dev,
 						int delay) {}
 static inline u64 pm_runtime_autosuspend_expiration(
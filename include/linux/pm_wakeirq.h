@@ -9,6 +9,7 @@
 extern int dev_pm_set_wake_irq(struct device *dev, int irq);
 extern int dev_pm_set_dedicated_wake_irq(struct device *dev, int irq);
 extern int dev_pm_set_dedicated_wake_irq_reverse(struct device *dev, int irq);
+extern int dev_pm_set_dedicated_wake_irq_async(struct device *dev, int irq);
 extern void dev_pm_clear_wake_irq(struct device *dev);
 
 #else	/* !CONFIG_PM */
@@ -28,6 +29,11 @@ static inline int dev_pm_set_dedicated_wake_irq_reverse(struct device *dev, int
 	return 0;
 }
 
+static inline int dev_pm_set_dedicated_wake_irq_async(struct device *dev, int irq)
+{
+	return 0;
+}
+
 static inline void dev_pm_clear_wake_irq(struct device *dev)
 {
 }
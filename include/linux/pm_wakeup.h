@@ -23,6 +23,8 @@ struct wake_irq;
  * @name: Name of the wakeup source
  * @id: Wakeup source id
  * @entry: Wakeup source list entry
+ * @active_node: Entry in the list of active wakeup sources
+ * @active_cpu: CPU whose list of active wakeup sources @active_node is on
  * @lock: Wakeup source lock
  * @wakeirq: Optional device specific wakeirq
  * @timer: Wakeup timer list
@@ -44,6 +46,8 @@ struct wakeup_source {
 	const char 		*name;
 	int			id;
 	struct list_head	entry;
+	struct hlist_node	active_node;
+	int			active_cpu;
 	spinlock_t		lock;
 	struct wake_irq		*wakeirq;
 	struct timer_list	timer;
@@ -9,6 +9,7 @@
 
 #include <linux/device.h>
 #include <linux/idr.h>
+#include <uapi/linux/powercap.h>
 
 /*
  * A power cap class device can contain multiple powercap control_types.
@@ -9,6 +9,10 @@
  */
 
 #define SCHED_CPUFREQ_IOWAIT	(1U << 0)
+/* With SCHED_CPUFREQ_IOWAIT: the waking task has a non-zero uclamp min */
+#define SCHED_CPUFREQ_IOWAIT_UCLAMP	(1U << 1)
+/* The cgroup frequency limits of the CPU have changed */
+#define SCHED_CPUFREQ_CGROUP_LIMITS	(1U << 2)
 
 #ifdef CONFIG_CPU_FREQ
 struct cpufreq_policy;
@@ -180,4 +180,12 @@ static inline void prev_cputime_init(struct prev_cputime *prev)
 extern unsigned long long
 task_sched_runtime(struct task_struct *task);
 
+#ifdef CONFIG_ENERGY_MODEL
+extern u64 sched_energy_estimate(u64 delta_ns);
+extern bool sched_energy_available(void);
+#else
+static inline u64 sched_energy_estimate(u64 delta_ns) { return 0; }
+static inline bool sched_energy_available(void) { return false; }
+#endif
+
 #endif /* _LINUX_SCHED_CPUTIME_H */
@@ -51,6 +51,25 @@ enum suspend_stat_step {
 	SUSPEND_RESUME
 };
 
+enum suspend_stat_phase {
+	SUSPEND_PHASE_FREEZE,
+	SUSPEND_PHASE_PREPARE,
+	SUSPEND_PHASE_SUSPEND,
+	SUSPEND_PHASE_SUSPEND_LATE,
+	SUSPEND_PHASE_SUSPEND_NOIRQ,
+	SUSPEND_PHASE_PLATFORM_SUSPEND,
+	SUSPEND_PHASE_PLATFORM_RESUME,
+	SUSPEND_PHASE_RESUME_NOIRQ,
+	SUSPEND_PHASE_RESUME_EARLY,
+	SUSPEND_PHASE_RESUME,
+	SUSPEND_PHASE_COMPLETE,
+	SUSPEND_PHASE_THAW,
+	SUSPEND_PHASE_NR
+};
+
+/* Bucket i > 0 counts durations from 4^(i-1) ms to 4^i ms, the last is open */
+#define SUSPEND_PHASE_HIST_NR	8
+
 struct suspend_stats {
 	int	success;
 	int	fail;
@@ -71,7 +90,14 @@ struct suspend_stats {
 	u64	last_hw_sleep;
 	u64	total_hw_sleep;
 	u64	max_hw_sleep;
+	u64	last_lpi_residency;
+	u64	last_lpi_cpu_residency;
+	int	lpi_residency_misses;
+	int	s2idle_spurious;
 	enum suspend_stat_step	failed_steps[REC_FAILED_NUM];
+	u64	phase_last_us[SUSPEND_PHASE_NR];
+	u64	phase_max_us[SUSPEND_PHASE_NR];
+	unsigned int	phase_hist[SUSPEND_PHASE_NR][SUSPEND_PHASE_HIST_NR];
 };
 
 extern struct suspend_stats suspend_stats;
@@ -314,6 +340,7 @@ extern bool pm_suspend_default_s2idle(void);
 extern void __init pm_states_init(void);
 extern void s2idle_set_ops(const struct platform_s2idle_ops *ops);
 extern void s2idle_wake(void);
+extern void s2idle_note_state(int index);
 
 /**
  * arch_suspend_disable_irqs - disable IRQs for suspend
@@ -355,6 +382,7 @@ static inline bool idle_should_enter_s2idle(void) { return false; }
 static inline void __init pm_states_init(void) {}
 static inline void s2idle_set_ops(const struct platform_s2idle_ops *ops) {}
 static inline void s2idle_wake(void) {}
+static inline void s2idle_note_state(int index) {}
 #endif /* !CONFIG_SUSPEND */
 
 /* struct pbe is used for creating lists of pages that should be restored
@@ -500,6 +528,8 @@ extern int unregister_pm_notifier(struct notifier_block *nb);
 extern void ksys_sync_helper(void);
 extern void pm_report_hw_sleep_time(u64 t);
 extern void pm_report_max_hw_sleep(u64 t);
+extern void pm_report_lpi_residency(u64 sys_us, u64 cpu_us);
+extern void pm_report_phase_time(enum suspend_stat_phase phase, ktime_t start);
 
 #define pm_notifier(fn, pri) {				\
 	static struct notifier_block fn##_nb =			\
@@ -523,6 +553,7 @@ extern void pm_system_irq_wakeup(unsigned int irq_number);
 extern unsigned int pm_wakeup_irq(void);
 extern bool pm_get_wakeup_count(unsigned int *count, bool block);
 extern bool pm_save_wakeup_count(unsigned int count);
+extern bool pm_wait_wakeup_count(unsigned int count, long timeout);
 extern void pm_wakep_autosleep_enabled(bool set);
 extern void pm_print_active_wakeup_sources(void);
 
@@ -543,6 +574,9 @@ static inline int unregister_pm_notifier(struct notifier_block *nb)
 
 static inline void pm_report_hw_sleep_time(u64 t) {};
 static inline void pm_report_max_hw_sleep(u64 t) {};
+static inline void pm_report_lpi_residency(u64 sys_us, u64 cpu_us) {};
+static inline void pm_report_phase_time(enum suspend_stat_phase phase,
+					ktime_t start) {};
 
 static inline void ksys_sync_helper(void) {}
 
@@ -559,6 +593,15 @@ static inline void unlock_system_sleep(unsigned int flags) {}
 
 #endif /* !CONFIG_PM_SLEEP */
 
+#ifdef CONFIG_PM_TEST_SUSPEND
+/* kernel/power/suspend_test.c */
+extern void suspend_bench_report_dev(enum suspend_stat_phase phase,
+				     const char *name, u64 us);
+#else
+static inline void suspend_bench_report_dev(enum suspend_stat_phase phase,
+					    const char *name, u64 us) {}
+#endif
+
 #ifdef CONFIG_PM_SLEEP_DEBUG
 extern bool pm_print_times_enabled;
 extern bool pm_debug_messages_on;
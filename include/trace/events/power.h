@@ -551,6 +551,48 @@ TRACE_EVENT(guest_halt_poll_ns,
 	trace_guest_halt_poll_ns(true, new, old)
 #define trace_guest_halt_poll_ns_shrink(new, old) \
 	trace_guest_halt_poll_ns(false, new, old)
+
+/*
+ * Following tracepoints are not exported in tracefs.  They are for BPF
+ * programs (raw tracepoints) and modules that want to follow the DVFS and
+ * idle decisions at a low cost: the arguments are passed as they are, with
+ * no record formatting and no trace buffer writes, and the limits and the
+ * other state that the decisions depend on can be read through the policy
+ * and device pointers.
+ *
+ * Postfixed with _tp to make them easily identifiable in the code.
+ */
+DECLARE_TRACE(sugov_next_freq_tp,
+	TP_PROTO(struct cpufreq_policy *policy, unsigned int cpu,
+		 unsigned long util, unsigned long max, unsigned int freq),
+	TP_ARGS(policy, cpu, util, max, freq));
+
+DECLARE_TRACE(sugov_adjust_perf_tp,
+	TP_PROTO(unsigned int cpu, unsigned long min_util, unsigned long util,
+		 unsigned long max),
+	TP_ARGS(cpu, min_util, util, max));
+
+DECLARE_TRACE(intel_pstate_target_tp,
+	TP_PROTO(unsigned int cpu, int busy_pct, int from, int target,
+		 int min_pstate, int max_pstate),
+	TP_ARGS(cpu, busy_pct, from, target, min_pstate, max_pstate));
+
+DECLARE_TRACE(amd_pstate_update_tp,
+	TP_PROTO(unsigned int cpu, unsigned long min_perf,
+		 unsigned long des_perf, unsigned long max_perf,
+		 bool fast_switch),
+	TP_ARGS(cpu, min_perf, des_perf, max_perf, fast_switch));
+
+struct cpuidle_device;
+
+DECLARE_TRACE(cpuidle_select_tp,
+	TP_PROTO(struct cpuidle_device *dev, int index, bool stop_tick),
+	TP_ARGS(dev, index, stop_tick));
+
+DECLARE_TRACE(cpuidle_exit_tp,
+	TP_PROTO(struct cpuidle_device *dev, int index, s64 residency_ns),
+	TP_ARGS(dev, index, residency_ns));
+
 #endif /* _TRACE_POWER_H */
 
 /* This part must be outside protection */
@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_LINUX_CPUFREQ_USERSPACE_H
+#define _UAPI_LINUX_CPUFREQ_USERSPACE_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/**
+ * struct cpufreq_userspace_target - Frequency to set for a cpufreq policy
+ * @cpu: Any CPU of the policy.
+ * @freq: Target frequency in kHz, like a write to scaling_setspeed.
+ */
+struct cpufreq_userspace_target {
+	__u32 cpu;
+	__u32 freq;
+};
+
+/**
+ * struct cpufreq_userspace_targets - Batch of targets for /dev/cpufreq_userspace
+ * @nr: Number of entries in the array pointed to by @targets.
+ * @flags: Must be 0.
+ * @targets: User space pointer to an array of struct cpufreq_userspace_target.
+ *
+ * The targets are applied in order.  The ioctl returns the number of targets
+ * that have been applied before the first failure, or an error code if none of
+ * them could be applied.
+ */
+struct cpufreq_userspace_targets {
+	__u32 nr;
+	__u32 flags;
+	__u64 targets;
+};
+
+#define CPUFREQ_USERSPACE_SET_SPEEDS	_IOW(0xBA, 0x00, struct cpufreq_userspace_targets)
+
+#endif /* _UAPI_LINUX_CPUFREQ_USERSPACE_H */
@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * Layout of the per-CPU cpuidle telemetry buffers.
+ *
+ * Each buffer starts with struct cpuidle_telemetry_header, followed by
+ * nr_entries (a power of two) records of type struct cpuidle_telemetry_entry,
+ * and can be mapped read-only from debugfs (cpuidle_telemetry/cpuN).
+ *
+ * The buffers are written by the CPUs they belong to only.  The head field of
+ * the header is the number of records written so far, so record number n is
+ * stored at index n % nr_entries.  The seq field of a record is set to the
+ * record's number after all of the other fields have been written and it is
+ * set to CPUIDLE_TELEMETRY_SEQ_BUSY while they are being updated, so readers
+ * need to check it before and after copying the record.
+ */
+
+#ifndef _UAPI_LINUX_CPUIDLE_TELEMETRY_H
+#define _UAPI_LINUX_CPUIDLE_TELEMETRY_H
+
+#include <linux/types.h>
+
+#define CPUIDLE_TELEMETRY_VERSION	1
+#define CPUIDLE_TELEMETRY_SEQ_BUSY	(~(__u64)0)
+
+enum cpuidle_telemetry_wakeup {
+	CPUIDLE_WAKEUP_UNKNOWN,		/* The governor did not tell */
+	CPUIDLE_WAKEUP_TIMER,		/* At or after the next timer event */
+	CPUIDLE_WAKEUP_NON_TIMER,	/* Before the next timer event */
+	CPUIDLE_WAKEUP_POLL,		/* A polling state was left */
+};
+
+struct cpuidle_telemetry_header {
+	__u32 version;
+	__u32 nr_entries;
+	__u32 entry_size;
+	__u32 header_size;
+	__u64 head;
+};
+
+struct cpuidle_telemetry_entry {
+	__u64 seq;
+	__u64 time_ns;		/* Local clock at idle entry */
+	__u64 predicted_ns;	/* Idle duration predicted by the governor */
+	__u64 sleep_length_ns;	/* Time till the next timer event */
+	__u64 residency_ns;	/* Measured idle duration */
+	__s32 state;		/* Idle state that was entered */
+	__u32 wakeup;		/* enum cpuidle_telemetry_wakeup */
+};
+
+#endif /* _UAPI_LINUX_CPUIDLE_TELEMETRY_H */
@@ -0,0 +1,24 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_LINUX_PM_QOS_H
+#define _UAPI_LINUX_PM_QOS_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/**
+ * struct cpu_latency_qos_cpus - CPUs a /dev/cpu_dma_latency request applies to
+ * @size: Size of the CPU mask pointed to by @mask in bytes.
+ * @reserved: Must be 0.
+ * @mask: User space pointer to a CPU mask in the sched_setaffinity() format.
+ *
+ * An empty mask makes the request apply to all CPUs again.
+ */
+struct cpu_latency_qos_cpus {
+	__u32 size;
+	__u32 reserved;
+	__u64 mask;
+};
+
+#define CPU_LATENCY_QOS_SET_CPUS	_IOW(0xB9, 0x00, struct cpu_latency_qos_cpus)
+
+#endif /* _UAPI_LINUX_PM_QOS_H */
@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_LINUX_POWERCAP_H
+#define _UAPI_LINUX_POWERCAP_H
+
+#include <linux/types.h>
+
+/*
+ * Binary snapshot of all of the zones of a powercap control type, read from
+ * /sys/class/powercap/<control type>/zones.  The file contains one
+ * struct powercap_zone_snapshot per zone, in native byte order, in the order
+ * of a depth-first walk of the zone tree.  It is limited to one page, so it
+ * can always be read with a single read() from offset 0.
+ */
+
+/* Number of constraints whose power limits are included in a record */
+#define POWERCAP_SNAPSHOT_CONSTRAINTS	4
+
+/* Bits of powercap_zone_snapshot.valid */
+#define POWERCAP_SNAPSHOT_ENERGY	(1U << 0)
+#define POWERCAP_SNAPSHOT_POWER		(1U << 1)
+#define POWERCAP_SNAPSHOT_LIMIT(i)	(1U << (2 + (i)))
+
+/**
+ * struct powercap_zone_snapshot - Snapshot of one power zone.
+ * @name: Name of the zone device, e.g. "intel-rapl:0:1".
+ * @valid: POWERCAP_SNAPSHOT_* bits of the fields below that are valid.
+ * @nr_constraints: Number of constraints of the zone.
+ * @energy_uj: Energy counter (micro-joules).
+ * @power_uw: Power (micro-watts).
+ * @power_limit_uw: Power limits of the first POWERCAP_SNAPSHOT_CONSTRAINTS
+ *	constraints (micro-watts).
+ */
+struct powercap_zone_snapshot {
+	char name[32];
+	__u32 valid;
+	__u32 nr_constraints;
+	__u64 energy_uj;
+	__u64 power_uw;
+	__u64 power_limit_uw[POWERCAP_SNAPSHOT_CONSTRAINTS];
+};
+
+#endif /* _UAPI_LINUX_POWERCAP_H */
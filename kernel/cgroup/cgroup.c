@@ -3842,6 +3842,13 @@ static ssize_t cgroup_pressure_write(struct kernfs_open_file *of,
 		return -ENOENT;
 
 	psi = cgroup_psi(cgrp);
+
+	/* The accounting is shared with an ancestor, see psi_max_depth */
+	if (cgroup_parent(cgrp) && psi == cgroup_psi(cgroup_parent(cgrp))) {
+		cgroup_kn_unlock(of->kn);
+		return -EOPNOTSUPP;
+	}
+
 	if (psi->enabled != enable) {
 		int i;
 
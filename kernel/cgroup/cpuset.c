@@ -40,6 +40,7 @@
 #include <linux/security.h>
 #include <linux/spinlock.h>
 #include <linux/oom.h>
+#include <linux/pm_qos.h>
 #include <linux/sched/isolation.h>
 #include <linux/cgroup.h>
 #include <linux/wait.h>
@@ -183,6 +184,13 @@ struct cpuset {
 
 	/* Handle for cpuset.cpus.partition */
 	struct cgroup_file partition_file;
+
+	/*
+	 * Exit latency limit (usecs) for the idle states of effective_cpus,
+	 * or -1 if not set, and the per-CPU latency QoS requests imposing it.
+	 */
+	s32 idle_latency_us;
+	struct pm_qos_request __percpu *idle_latency_reqs;
 };
 
 /*
@@ -1205,6 +1213,36 @@ void rebuild_sched_domains(void)
 	cpus_read_unlock();
 }
 
+/*
+ * cpuset_update_idle_latency - Apply the idle latency limit of a cpuset.
+ * @cs: the cpuset whose limit or effective_cpus have changed
+ *
+ * Make the CPU latency QoS requests of @cs cover its current effective_cpus.
+ * Called with cpuset_mutex held.
+ */
+static void cpuset_update_idle_latency(struct cpuset *cs)
+{
+	int cpu;
+
+	if (!cs->idle_latency_reqs)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct pm_qos_request *req = per_cpu_ptr(cs->idle_latency_reqs, cpu);
+		bool active = cpu_latency_qos_request_active(req);
+
+		if (cs->idle_latency_us < 0 ||
+		    !cpumask_test_cpu(cpu, cs->effective_cpus)) {
+			if (active)
+				cpu_latency_qos_remove_request(req);
+		} else if (active) {
+			cpu_latency_qos_update_request(req, cs->idle_latency_us);
+		} else {
+			cpu_latency_qos_add_cpu_request(req, cpu, cs->idle_latency_us);
+		}
+	}
+}
+
 /**
  * update_tasks_cpumask - Update the cpumasks of tasks in the cpuset.
  * @cs: the cpuset in which each task's cpus_allowed mask needs to be changed
@@ -1222,6 +1260,8 @@ static void update_tasks_cpumask(struct cpuset *cs, struct cpumask *new_cpus)
 	struct task_struct *task;
 	bool top_cs = cs == &top_cpuset;
 
+	cpuset_update_idle_latency(cs);
+
 	css_task_iter_start(&cs->css, 0, &it);
 	while ((task = css_task_iter_next(&it))) {
 		const struct cpumask *possible_mask = task_cpu_possible_mask(task);
@@ -3049,6 +3089,56 @@ static ssize_t sched_partition_write(struct kernfs_open_file *of, char *buf,
 	return retval ?: nbytes;
 }
 
+static int cpuset_idle_latency_show(struct seq_file *seq, void *v)
+{
+	struct cpuset *cs = css_cs(seq_css(seq));
+	s32 val = READ_ONCE(cs->idle_latency_us);
+
+	if (val < 0)
+		seq_puts(seq, "max\n");
+	else
+		seq_printf(seq, "%d\n", val);
+
+	return 0;
+}
+
+static ssize_t cpuset_idle_latency_write(struct kernfs_open_file *of,
+					 char *buf, size_t nbytes, loff_t off)
+{
+	struct cpuset *cs = css_cs(of_css(of));
+	int retval = -ENODEV;
+	s32 val;
+
+	buf = strstrip(buf);
+	if (!strcmp(buf, "max"))
+		val = -1;
+	else if (kstrtos32(buf, 0, &val) || val < 0)
+		return -EINVAL;
+
+	css_get(&cs->css);
+	cpus_read_lock();
+	mutex_lock(&cpuset_mutex);
+	if (!is_cpuset_online(cs))
+		goto out_unlock;
+
+	if (!cs->idle_latency_reqs) {
+		cs->idle_latency_reqs = alloc_percpu(struct pm_qos_request);
+		if (!cs->idle_latency_reqs) {
+			retval = -ENOMEM;
+			goto out_unlock;
+		}
+	}
+
+	WRITE_ONCE(cs->idle_latency_us, val);
+	cpuset_update_idle_latency(cs);
+	retval = 0;
+out_unlock:
+	mutex_unlock(&cpuset_mutex);
+	cpus_read_unlock();
+	css_put(&cs->css);
+	return retval ?: nbytes;
+}
+
 /*
  * for the common functions, 'private' gives the type of file
  */
@@ -3206,6 +3296,13 @@ static struct cftype dfl_files[] = {
 		.flags = CFTYPE_DEBUG,
 	},
 
+	{
+		.name = "cpus.idle_latency_us",
+		.seq_show = cpuset_idle_latency_show,
+		.write = cpuset_idle_latency_write,
+		.flags = CFTYPE_NOT_ON_ROOT,
+	},
+
 	{ }	/* terminate */
 };
 
@@ -3241,6 +3338,7 @@ cpuset_css_alloc(struct cgroup_subsys_state *parent_css)
 	nodes_clear(cs->effective_mems);
 	fmeter_init(&cs->fmeter);
 	cs->relax_domain_level = -1;
+	cs->idle_latency_us = -1;
 
 	/* Set CS_MEMORY_MIGRATE for default hierarchy */
 	if (cgroup_subsys_on_dfl(cpuset_cgrp_subsys))
@@ -3356,6 +3454,9 @@ static void cpuset_css_offline(struct cgroup_subsys_state *css)
 		parent->child_ecpus_count--;
 	}
 
+	cs->idle_latency_us = -1;
+	cpuset_update_idle_latency(cs);
+
 	cpuset_dec();
 	clear_bit(CS_ONLINE, &cs->flags);
 
@@ -3367,6 +3468,7 @@ static void cpuset_css_free(struct cgroup_subsys_state *css)
 {
 	struct cpuset *cs = css_cs(css);
 
+	free_percpu(cs->idle_latency_reqs);
 	free_cpuset(cs);
 }
 
@@ -327,6 +327,9 @@ static void cgroup_base_stat_add(struct cgroup_base_stat *dst_bstat,
 #ifdef CONFIG_SCHED_CORE
 	dst_bstat->forceidle_sum += src_bstat->forceidle_sum;
 #endif
+#ifdef CONFIG_ENERGY_MODEL
+	dst_bstat->energy += src_bstat->energy;
+#endif
 }
 
 static void cgroup_base_stat_sub(struct cgroup_base_stat *dst_bstat,
@@ -338,6 +341,9 @@ static void cgroup_base_stat_sub(struct cgroup_base_stat *dst_bstat,
 #ifdef CONFIG_SCHED_CORE
 	dst_bstat->forceidle_sum -= src_bstat->forceidle_sum;
 #endif
+#ifdef CONFIG_ENERGY_MODEL
+	dst_bstat->energy -= src_bstat->energy;
+#endif
 }
 
 static void cgroup_base_stat_flush(struct cgroup *cgrp, int cpu)
@@ -405,6 +411,9 @@ void __cgroup_account_cputime(struct cgroup *cgrp, u64 delta_exec)
 
 	rstatc = cgroup_base_stat_cputime_account_begin(cgrp, &flags);
 	rstatc->bstat.cputime.sum_exec_runtime += delta_exec;
+#ifdef CONFIG_ENERGY_MODEL
+	rstatc->bstat.energy += sched_energy_estimate(delta_exec);
+#endif
 	cgroup_base_stat_cputime_account_end(cgrp, rstatc, flags);
 }
 
@@ -485,6 +494,9 @@ void cgroup_base_stat_cputime_show(struct seq_file *seq)
 #ifdef CONFIG_SCHED_CORE
 	u64 forceidle_time;
 #endif
+#ifdef CONFIG_ENERGY_MODEL
+	u64 energy = 0;
+#endif
 
 	if (cgroup_parent(cgrp)) {
 		cgroup_rstat_flush_hold(cgrp);
@@ -493,6 +505,9 @@ void cgroup_base_stat_cputime_show(struct seq_file *seq)
 			       &utime, &stime);
 #ifdef CONFIG_SCHED_CORE
 		forceidle_time = cgrp->bstat.forceidle_sum;
+#endif
+#ifdef CONFIG_ENERGY_MODEL
+		energy = cgrp->bstat.energy;
 #endif
 		cgroup_rstat_flush_release();
 	} else {
@@ -520,6 +535,12 @@ void cgroup_base_stat_cputime_show(struct seq_file *seq)
 #ifdef CONFIG_SCHED_CORE
 	seq_printf(seq, "core_sched.force_idle_usec %llu\n", forceidle_time);
 #endif
+
+#ifdef CONFIG_ENERGY_MODEL
+	/* The EM does not cover the whole system, so not for the root */
+	if (cgroup_parent(cgrp) && sched_energy_available())
+		seq_printf(seq, "energy_uj %llu\n", div_u64(energy, 1000));
+#endif
 }
 
 /* Add bpf kfuncs for cgroup_rstat_updated() and cgroup_rstat_flush() */
@@ -8,6 +8,8 @@
  */
 
 #include <linux/device.h>
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
 #include <linux/mutex.h>
 #include <linux/pm_wakeup.h>
 
@@ -24,18 +26,85 @@ static struct workqueue_struct *autosleep_wq;
 static DEFINE_MUTEX(autosleep_lock);
 static struct wakeup_source *autosleep_ws;
 
+/*
+ * Predictive backoff.
+ *
+ * Periodic wakeup sources may leave the system idle for less time than it
+ * takes to suspend and resume it, in which case every attempt is wasted.  To
+ * avoid that, keep running averages of the time between the last wakeup
+ * source going away and the next wakeup event (the idle interval) and of the
+ * time spent suspending and resuming (which CLOCK_MONOTONIC does not count
+ * the sleep in), and if the former is below the latter, hold off the attempt
+ * for the expected cost of it to see whether or not another event arrives.
+ */
+static bool backoff = true;
+module_param(backoff, bool, 0644);
+MODULE_PARM_DESC(backoff, "Hold off suspend when the expected idle time is too short");
+
+#define AUTOSLEEP_EWMA_SHIFT	2
+#define AUTOSLEEP_MAX_HOLDOFF	(10 * NSEC_PER_SEC)
+
+static u64 autosleep_interval;	/* Average idle interval in ns */
+static u64 autosleep_cost;	/* Average suspend + resume time in ns */
+
+static void autosleep_ewma(u64 *avg, u64 sample)
+{
+	if (*avg)
+		*avg += (sample >> AUTOSLEEP_EWMA_SHIFT) -
+			(*avg >> AUTOSLEEP_EWMA_SHIFT);
+	else
+		*avg = sample;
+}
+
+static void autosleep_note_event(ktime_t idle_start)
+{
+	autosleep_ewma(&autosleep_interval,
+		       ktime_to_ns(ktime_sub(ktime_get_boottime(), idle_start)));
+}
+
+/*
+ * Wait for the expected cost of a suspend attempt if the idle interval is
+ * expected to be shorter than that.  Return true if a wakeup event has
+ * occurred in the meantime, so the attempt would have been futile.  The wait
+ * ends when the event is registered, so the idle interval can be sampled at
+ * the time it actually ended.
+ */
+static bool autosleep_hold_off(unsigned int initial_count)
+{
+	u64 holdoff;
+
+	if (!READ_ONCE(backoff) || !autosleep_cost ||
+	    autosleep_interval >= autosleep_cost)
+		return false;
+
+	holdoff = min_t(u64, autosleep_cost, AUTOSLEEP_MAX_HOLDOFF);
+
+	return pm_wait_wakeup_count(initial_count,
+				    nsecs_to_jiffies(holdoff) ?: 1);
+}
+
 static void try_to_suspend(struct work_struct *work)
 {
 	unsigned int initial_count, final_count;
+	ktime_t idle_start, start;
+	int error;
 
 	if (!pm_get_wakeup_count(&initial_count, true))
 		goto out;
 
+	idle_start = ktime_get_boottime();
+
+	if (autosleep_hold_off(initial_count)) {
+		autosleep_note_event(idle_start);
+		goto out;
+	}
+
 	mutex_lock(&autosleep_lock);
 
 	if (!pm_save_wakeup_count(initial_count) ||
 		system_state != SYSTEM_RUNNING) {
 		mutex_unlock(&autosleep_lock);
+		autosleep_note_event(idle_start);
 		goto out;
 	}
 
@@ -43,13 +112,26 @@ static void try_to_suspend(struct work_struct *work)
 		mutex_unlock(&autosleep_lock);
 		return;
 	}
+
+	start = ktime_get();
+
 	if (autosleep_state >= PM_SUSPEND_MAX)
-		hibernate();
+		error = hibernate();
 	else
-		pm_suspend(autosleep_state);
+		error = pm_suspend(autosleep_state);
+
+	/*
+	 * Aborted attempts do not go through the whole cycle, so only use the
+	 * successful ones for the cost estimate.
+	 */
+	if (!error)
+		autosleep_ewma(&autosleep_cost,
+			       ktime_to_ns(ktime_sub(ktime_get(), start)));
 
 	mutex_unlock(&autosleep_lock);
 
+	autosleep_note_event(idle_start);
+
 	if (!pm_get_wakeup_count(&final_count, false))
 		goto out;
 
@@ -16,6 +16,7 @@
 #include <linux/energy_model.h>
 #include <linux/sched/topology.h>
 #include <linux/slab.h>
+#include <linux/string.h>
 
 /*
  * Mutex serializing the registrations of performance domains and letting
@@ -23,6 +24,9 @@
  */
 static DEFINE_MUTEX(em_pd_mutex);
 
+#define em_table_protected(pd)	\
+	rcu_dereference_protected((pd)->table, lockdep_is_held(&em_pd_mutex))
+
 static bool _is_cpu_device(struct device *dev)
 {
 	return (dev->bus == &cpu_subsys);
@@ -31,21 +35,144 @@ static bool _is_cpu_device(struct device *dev)
 #ifdef CONFIG_DEBUG_FS
 static struct dentry *rootdir;
 
-static void em_debug_create_ps(struct em_perf_state *ps, struct dentry *pd)
+static int __em_dev_update_power(struct device *dev, const unsigned long *power);
+
+struct em_dbg_info {
+	struct em_perf_domain *pd;
+	int ps_id;
+};
+
+/* The table may be replaced at run time, so it cannot be pointed to. */
+#define DEFINE_EM_DBG_SHOW(name, fname)					\
+static int em_debug_##fname##_show(struct seq_file *s, void *unused)	\
+{									\
+	struct em_dbg_info *em_dbg = s->private;			\
+	unsigned long val;						\
+									\
+	rcu_read_lock();						\
+	val = em_perf_state_from_pd(em_dbg->pd)[em_dbg->ps_id].name;	\
+	rcu_read_unlock();						\
+									\
+	seq_printf(s, "%lu\n", val);					\
+	return 0;							\
+}									\
+DEFINE_SHOW_ATTRIBUTE(em_debug_##fname)
+
+DEFINE_EM_DBG_SHOW(frequency, frequency);
+DEFINE_EM_DBG_SHOW(power, power);
+DEFINE_EM_DBG_SHOW(cost, cost);
+DEFINE_EM_DBG_SHOW(flags, inefficiency);
+
+static void em_debug_create_ps(struct em_dbg_info *em_dbg, struct dentry *pd)
 {
 	struct dentry *d;
 	char name[24];
 
-	snprintf(name, sizeof(name), "ps:%lu", ps->frequency);
+	snprintf(name, sizeof(name), "ps:%lu",
+		 em_table_protected(em_dbg->pd)[em_dbg->ps_id].frequency);
 
 	/* Create per-ps directory */
 	d = debugfs_create_dir(name, pd);
-	debugfs_create_ulong("frequency", 0444, d, &ps->frequency);
-	debugfs_create_ulong("power", 0444, d, &ps->power);
-	debugfs_create_ulong("cost", 0444, d, &ps->cost);
-	debugfs_create_ulong("inefficient", 0444, d, &ps->flags);
+	debugfs_create_file("frequency", 0444, d, em_dbg,
+			    &em_debug_frequency_fops);
+	debugfs_create_file("power", 0444, d, em_dbg, &em_debug_power_fops);
+	debugfs_create_file("cost", 0444, d, em_dbg, &em_debug_cost_fops);
+	debugfs_create_file("inefficient", 0444, d, em_dbg,
+			    &em_debug_inefficiency_fops);
 }
 
+/*
+ * The "power_table" file shows the frequency, power and cost of each state
+ * and accepts a list of new power values, one for each state, so that the EM
+ * can be calibrated by comparing it with the energy consumption measured by
+ * user space (for example, via the powercap energy counters) and updated
+ * accordingly.
+ */
+static int em_debug_power_table_show(struct seq_file *s, void *unused)
+{
+	struct device *dev = s->private;
+	struct em_perf_domain *pd = dev->em_pd;
+	struct em_perf_state *table;
+	int i;
+
+	rcu_read_lock();
+	table = em_perf_state_from_pd(pd);
+	for (i = 0; i < pd->nr_perf_states; i++)
+		seq_printf(s, "%lu %lu %lu\n", table[i].frequency,
+			   table[i].power, table[i].cost);
+	rcu_read_unlock();
+
+	return 0;
+}
+
+static int em_debug_power_table_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, em_debug_power_table_show, inode->i_private);
+}
+
+static ssize_t em_debug_power_table_write(struct file *file,
+					  const char __user *user_buf,
+					  size_t count, loff_t *ppos)
+{
+	struct device *dev = file_inode(file)->i_private;
+	int nr_states = dev->em_pd->nr_perf_states;
+	unsigned long *power;
+	char *buf, *cur, *tok;
+	int i = 0, ret;
+
+	buf = memdup_user_nul(user_buf, count);
+	if (IS_ERR(buf))
+		return PTR_ERR(buf);
+
+	power = kcalloc(nr_states, sizeof(*power), GFP_KERNEL);
+	if (!power) {
+		ret = -ENOMEM;
+		goto free_buf;
+	}
+
+	cur = buf;
+	while ((tok = strsep(&cur, " \t\n")) != NULL) {
+		if (!*tok)
+			continue;
+
+		if (i == nr_states || kstrtoul(tok, 0, &power[i++])) {
+			ret = -EINVAL;
+			goto free_power;
+		}
+	}
+
+	if (i != nr_states) {
+		ret = -EINVAL;
+		goto free_power;
+	}
+
+	/*
+	 * Unregistering the EM removes this file under em_pd_mutex, which
+	 * waits for this function to return, so do not block on it.
+	 */
+	if (!mutex_trylock(&em_pd_mutex)) {
+		ret = -EBUSY;
+		goto free_power;
+	}
+
+	ret = __em_dev_update_power(dev, power);
+	mutex_unlock(&em_pd_mutex);
+
+free_power:
+	kfree(power);
+free_buf:
+	kfree(buf);
+	return ret ? ret : count;
+}
+
+static const struct file_operations em_debug_power_table_fops = {
+	.open		= em_debug_power_table_open,
+	.read		= seq_read,
+	.write		= em_debug_power_table_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int em_debug_cpus_show(struct seq_file *s, void *unused)
 {
 	seq_printf(s, "%*pbl\n", cpumask_pr_args(to_cpumask(s->private)));
@@ -66,6 +193,7 @@ DEFINE_SHOW_ATTRIBUTE(em_debug_flags);
 
 static void em_debug_create_pd(struct device *dev)
 {
+	struct em_dbg_info *em_dbg;
 	struct dentry *d;
 	int i;
 
@@ -79,15 +207,32 @@ static void em_debug_create_pd(struct device *dev)
 	debugfs_create_file("flags", 0444, d, dev->em_pd,
 			    &em_debug_flags_fops);
 
+	if (!em_is_artificial(dev->em_pd))
+		debugfs_create_file("power_table", 0644, d, dev,
+				    &em_debug_power_table_fops);
+
+	em_dbg = kcalloc(dev->em_pd->nr_perf_states, sizeof(*em_dbg),
+			 GFP_KERNEL);
+	if (!em_dbg)
+		return;
+
+	dev->em_pd->dbg_info = em_dbg;
+
 	/* Create a sub-directory for each performance state */
-	for (i = 0; i < dev->em_pd->nr_perf_states; i++)
-		em_debug_create_ps(&dev->em_pd->table[i], d);
+	for (i = 0; i < dev->em_pd->nr_perf_states; i++) {
+		em_dbg[i].pd = dev->em_pd;
+		em_dbg[i].ps_id = i;
+		em_debug_create_ps(&em_dbg[i], d);
+	}
 
 }
 
 static void em_debug_remove_pd(struct device *dev)
 {
 	debugfs_lookup_and_remove(dev_name(dev), rootdir);
+
+	kfree(dev->em_pd->dbg_info);
+	dev->em_pd->dbg_info = NULL;
 }
 
 static int __init em_debug_init(void)
@@ -103,14 +248,75 @@ static void em_debug_create_pd(struct device *dev) {}
 static void em_debug_remove_pd(struct device *dev) {}
 #endif
 
+static void em_create_perf_idx(struct em_perf_domain *pd,
+			       struct em_perf_state *table)
+{
+	unsigned long lower, range;
+	int b, i = 0, bits;
+
+	pd->idx_base = table[0].frequency;
+	range = table[pd->nr_perf_states - 1].frequency - pd->idx_base;
+	bits = fls_long(range);
+	pd->idx_shift = bits > EM_PERF_IDX_BUCKETS_SHIFT ?
+			bits - EM_PERF_IDX_BUCKETS_SHIFT : 0;
+
+	for (b = 0; b < EM_PERF_IDX_BUCKETS; b++) {
+		lower = pd->idx_base + ((unsigned long)b << pd->idx_shift);
+
+		while (i < pd->nr_perf_states - 1 && table[i].frequency < lower)
+			i++;
+
+		pd->idx[b] = i;
+	}
+}
+
+/* Compute the cost of each performance state and find inefficient ones. */
+static int em_compute_costs(struct device *dev, struct em_perf_state *table,
+			    int nr_states, struct em_data_callback *cb,
+			    unsigned long flags)
+{
+	unsigned long prev_cost = ULONG_MAX;
+	u64 fmax;
+	int i, ret;
+
+	fmax = (u64) table[nr_states - 1].frequency;
+	for (i = nr_states - 1; i >= 0; i--) {
+		unsigned long power_res, cost;
+
+		if (flags & EM_PERF_DOMAIN_ARTIFICIAL) {
+			ret = cb->get_cost(dev, table[i].frequency, &cost);
+			if (ret || !cost || cost > EM_MAX_POWER) {
+				dev_err(dev, "EM: invalid cost %lu %d\n",
+					cost, ret);
+				return -EINVAL;
+			}
+		} else {
+			power_res = table[i].power;
+			cost = div64_u64(fmax * power_res, table[i].frequency);
+		}
+
+		table[i].cost = cost;
+
+		if (table[i].cost >= prev_cost) {
+			table[i].flags = EM_PERF_STATE_INEFFICIENT;
+			dev_dbg(dev, "EM: OPP:%lu is inefficient\n",
+				table[i].frequency);
+		} else {
+			table[i].flags = 0;
+			prev_cost = table[i].cost;
+		}
+	}
+
+	return 0;
+}
+
 static int em_create_perf_table(struct device *dev, struct em_perf_domain *pd,
 				int nr_states, struct em_data_callback *cb,
 				unsigned long flags)
 {
-	unsigned long power, freq, prev_freq = 0, prev_cost = ULONG_MAX;
+	unsigned long power, freq, prev_freq = 0;
 	struct em_perf_state *table;
 	int i, ret;
-	u64 fmax;
 
 	table = kcalloc(nr_states, sizeof(*table), GFP_KERNEL);
 	if (!table)
@@ -154,37 +360,14 @@ static int em_create_perf_table(struct device *dev, struct em_perf_domain *pd,
 		table[i].frequency = prev_freq = freq;
 	}
 
-	/* Compute the cost of each performance state. */
-	fmax = (u64) table[nr_states - 1].frequency;
-	for (i = nr_states - 1; i >= 0; i--) {
-		unsigned long power_res, cost;
+	if (em_compute_costs(dev, table, nr_states, cb, flags))
+		goto free_ps_table;
 
-		if (flags & EM_PERF_DOMAIN_ARTIFICIAL) {
-			ret = cb->get_cost(dev, table[i].frequency, &cost);
-			if (ret || !cost || cost > EM_MAX_POWER) {
-				dev_err(dev, "EM: invalid cost %lu %d\n",
-					cost, ret);
-				goto free_ps_table;
-			}
-		} else {
-			power_res = table[i].power;
-			cost = div64_u64(fmax * power_res, table[i].frequency);
-		}
-
-		table[i].cost = cost;
-
-		if (table[i].cost >= prev_cost) {
-			table[i].flags = EM_PERF_STATE_INEFFICIENT;
-			dev_dbg(dev, "EM: OPP:%lu is inefficient\n",
-				table[i].frequency);
-		} else {
-			prev_cost = table[i].cost;
-		}
-	}
-
-	pd->table = table;
+	RCU_INIT_POINTER(pd->table, table);
 	pd->nr_perf_states = nr_states;
 
+	em_create_perf_idx(pd, table);
+
 	return 0;
 
 free_ps_table:
@@ -254,7 +437,7 @@ static void em_cpufreq_update_efficiencies(struct device *dev)
 		return;
 	}
 
-	table = pd->table;
+	table = em_table_protected(pd);
 
 	for (i = 0; i < pd->nr_perf_states; i++) {
 		if (!(table[i].flags & EM_PERF_STATE_INEFFICIENT))
@@ -430,9 +613,75 @@ void em_dev_unregister_perf_domain(struct device *dev)
 	mutex_lock(&em_pd_mutex);
 	em_debug_remove_pd(dev);
 
-	kfree(dev->em_pd->table);
+	kfree(em_table_protected(dev->em_pd));
 	kfree(dev->em_pd);
 	dev->em_pd = NULL;
 	mutex_unlock(&em_pd_mutex);
 }
 EXPORT_SYMBOL_GPL(em_dev_unregister_perf_domain);
+
+static int __em_dev_update_power(struct device *dev, const unsigned long *power)
+{
+	struct em_perf_state *old, *table;
+	struct em_perf_domain *pd = dev->em_pd;
+	int i;
+
+	if (!pd || em_is_artificial(pd))
+		return -EINVAL;
+
+	old = em_table_protected(pd);
+	table = kmemdup(old, sizeof(*table) * pd->nr_perf_states, GFP_KERNEL);
+	if (!table)
+		return -ENOMEM;
+
+	for (i = 0; i < pd->nr_perf_states; i++) {
+		if (!power[i] || power[i] > EM_MAX_POWER) {
+			dev_err(dev, "EM: invalid power: %lu\n", power[i]);
+			kfree(table);
+			return -EINVAL;
+		}
+
+		table[i].power = power[i];
+	}
+
+	em_compute_costs(dev, table, pd->nr_perf_states, NULL, pd->flags);
+
+	rcu_assign_pointer(pd->table, table);
+	synchronize_rcu();
+	kfree(old);
+
+	return 0;
+}
+
+/**
+ * em_dev_update_power() - Update the power values of an Energy Model (EM)
+ * @dev		: Device for which the EM is registered
+ * @power	: New power values, one for each performance state, in the
+ *		same order and scale as the ones provided at registration
+ *
+ * Replace the table of performance states of the EM of @dev with a new one
+ * containing the same frequencies and the given power values, for example
+ * measured at run time, and recompute the costs and efficiencies of all
+ * states.  The new table is published with RCU, so users of the EM that
+ * access it via em_perf_state_from_pd() pick it up without locking.
+ *
+ * The EMs with artificial power values cannot be updated.  The inefficient
+ * frequencies marked in the cpufreq frequency table at registration time are
+ * not updated.
+ *
+ * Return 0 on success
+ */
+int em_dev_update_power(struct device *dev, const unsigned long *power)
+{
+	int ret;
+
+	if (IS_ERR_OR_NULL(dev) || !power)
+		return -EINVAL;
+
+	mutex_lock(&em_pd_mutex);
+	ret = __em_dev_update_power(dev, power);
+	mutex_unlock(&em_pd_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(em_dev_update_power);
@@ -29,9 +29,12 @@
 #include <linux/gfp.h>
 #include <linux/syscore_ops.h>
 #include <linux/ctype.h>
+#include <linux/debugfs.h>
 #include <linux/ktime.h>
+#include <linux/moduleparam.h>
 #include <linux/security.h>
 #include <linux/secretmem.h>
+#include <linux/seq_file.h>
 #include <trace/events/power.h>
 
 #include "power.h"
@@ -42,10 +45,15 @@ static int noresume;
 static int nohibernate;
 static int resume_wait;
 static unsigned int resume_delay;
+static bool prestage;
 static char resume_file[256] = CONFIG_PM_STD_PARTITION;
 dev_t swsusp_resume_device;
 sector_t swsusp_resume_block;
 __visible int in_suspend __nosavedata;
+struct hib_bench hib_bench __nosavedata;
+
+static char hibernate_compressor[CRYPTO_MAX_ALG_NAME] = CONFIG_HIBERNATION_DEF_COMP;
+char hib_comp_algo[CRYPTO_MAX_ALG_NAME];
 
 enum {
 	HIBERNATION_INVALID,
@@ -370,6 +378,7 @@ static int create_image(int platform_mode)
 int hibernation_snapshot(int platform_mode)
 {
 	pm_message_t msg;
+	ktime_t start;
 	int error;
 
 	pm_suspend_clear_flags();
@@ -377,10 +386,15 @@ int hibernation_snapshot(int platform_mode)
 	if (error)
 		goto Close;
 
+	hib_bench.prealloc_ns = 0;
+	hib_bench.snapshot_ns = 0;
+
 	/* Preallocate image memory before shutting down devices. */
+	start = ktime_get();
 	error = hibernate_preallocate_memory();
 	if (error)
 		goto Close;
+	hib_bench.prealloc_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
 
 	error = freeze_kernel_threads();
 	if (error)
@@ -407,10 +421,19 @@ int hibernation_snapshot(int platform_mode)
 
 	error = dpm_suspend(PMSG_FREEZE);
 
-	if (error || hibernation_test(TEST_DEVICES))
+	if (error || hibernation_test(TEST_DEVICES)) {
 		platform_recover(platform_mode);
-	else
+	} else {
+		/*
+		 * Timekeeping is suspended around the atomic copy, so use the
+		 * clock that has the time spent in there added to it.
+		 */
+		start = ktime_get_boottime();
 		error = create_image(platform_mode);
+		if (in_suspend)
+			hib_bench.snapshot_ns =
+				ktime_to_ns(ktime_sub(ktime_get_boottime(), start));
+	}
 
 	/*
 	 * In the case that we call create_image() above, the control
@@ -727,6 +750,21 @@ int hibernate(void)
 	}
 
 	sleep_flags = lock_system_sleep();
+
+	if (!nocompress) {
+		kernel_param_lock(THIS_MODULE);
+		strscpy(hib_comp_algo, hibernate_compressor,
+			sizeof(hib_comp_algo));
+		kernel_param_unlock(THIS_MODULE);
+
+		if (!crypto_has_comp(hib_comp_algo, 0, 0)) {
+			pr_err("%s compression is not available\n",
+			       hib_comp_algo);
+			error = -EOPNOTSUPP;
+			goto Unlock;
+		}
+	}
+
 	/* The snapshot device should not be opened while we're running */
 	if (!hibernate_acquire()) {
 		error = -EBUSY;
@@ -741,6 +779,9 @@ int hibernate(void)
 
 	ksys_sync_helper();
 
+	if (prestage)
+		hibernate_prestage_memory();
+
 	error = freeze_processes();
 	if (error)
 		goto Exit;
@@ -1253,6 +1294,29 @@ static ssize_t image_size_store(struct kobject *kobj, struct kobj_attribute *att
 
 power_attr(image_size);
 
+static ssize_t image_size_auto_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", image_size_auto);
+}
+
+static ssize_t image_size_auto_store(struct kobject *kobj,
+				     struct kobj_attribute *attr,
+				     const char *buf, size_t n)
+{
+	bool val;
+	int error;
+
+	error = kstrtobool(buf, &val);
+	if (error)
+		return error;
+
+	image_size_auto = val;
+	return n;
+}
+
+power_attr(image_size_auto);
+
 static ssize_t reserved_size_show(struct kobject *kobj,
 				  struct kobj_attribute *attr, char *buf)
 {
@@ -1275,12 +1339,36 @@ static ssize_t reserved_size_store(struct kobject *kobj,
 
 power_attr(reserved_size);
 
+static ssize_t compression_threads_show(struct kobject *kobj,
+					struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", hibernate_compression_threads);
+}
+
+static ssize_t compression_threads_store(struct kobject *kobj,
+					 struct kobj_attribute *attr,
+					 const char *buf, size_t n)
+{
+	unsigned int nr_threads;
+
+	if (sscanf(buf, "%u", &nr_threads) == 1) {
+		WRITE_ONCE(hibernate_compression_threads, nr_threads);
+		return n;
+	}
+
+	return -EINVAL;
+}
+
+power_attr(compression_threads);
+
 static struct attribute *g[] = {
 	&disk_attr.attr,
 	&resume_offset_attr.attr,
 	&resume_attr.attr,
 	&image_size_attr.attr,
+	&image_size_auto_attr.attr,
 	&reserved_size_attr.attr,
+	&compression_threads_attr.attr,
 	NULL,
 };
 
@@ -1297,6 +1385,75 @@ static int __init pm_disk_init(void)
 
 core_initcall(pm_disk_init);
 
+#ifdef CONFIG_DEBUG_FS
+/* Bytes per microsecond is MB/s. */
+static u64 hib_bench_mbps(u64 bytes, u64 ns)
+{
+	return ns ? div64_u64(bytes * NSEC_PER_USEC, ns) : 0;
+}
+
+static void hib_bench_show_pass(struct seq_file *s, const char *name,
+				const struct hib_bench_pass *b)
+{
+	u64 bytes = (u64)b->pages * PAGE_SIZE;
+	unsigned int thr;
+
+	if (!b->pages)
+		return;
+
+	seq_printf(s, "%s: %u pages in %llu us (%llu MB/s), %s\n", name,
+		   b->pages, div_u64(b->ns, NSEC_PER_USEC),
+		   hib_bench_mbps(bytes, b->ns),
+		   b->comp_alg[0] ? b->comp_alg : "uncompressed");
+	seq_printf(s, "  io: %u bios, submit %llu us, device wait %llu us\n",
+		   b->bios, div_u64(b->submit_ns, NSEC_PER_USEC),
+		   div_u64(b->wait_ns, NSEC_PER_USEC));
+
+	if (!b->nr_threads)
+		return;
+
+	seq_printf(s, "  %6s %8s %10s %10s %10s %8s %10s %8s\n", "thread",
+		   "chunks", "unc_kb", "cmp_kb", "comp_us", "MB/s", "crc_us",
+		   "MB/s");
+	for (thr = 0; thr < b->nr_threads; thr++) {
+		const struct hib_bench_thread *t = &b->thread[thr];
+
+		seq_printf(s, "  %6u %8u %10llu %10llu %10llu %8llu %10llu %8llu\n",
+			   thr, t->chunks, t->unc_bytes >> 10, t->cmp_bytes >> 10,
+			   div_u64(t->ns, NSEC_PER_USEC),
+			   hib_bench_mbps(t->unc_bytes, t->ns),
+			   div_u64(t->crc_ns, NSEC_PER_USEC),
+			   hib_bench_mbps(t->unc_bytes, t->crc_ns));
+	}
+}
+
+/*
+ * The figures of the last hibernation, or of the last image load after a
+ * resume from it.  With the "test_resume" mode both are available without
+ * a power cycle.
+ */
+static int hibernate_bench_show(struct seq_file *s, void *unused)
+{
+	seq_printf(s, "prealloc: %llu us\n",
+		   div_u64(hib_bench.prealloc_ns, NSEC_PER_USEC));
+	seq_printf(s, "snapshot: %llu us\n",
+		   div_u64(hib_bench.snapshot_ns, NSEC_PER_USEC));
+	hib_bench_show_pass(s, "save", &hib_bench.save);
+	hib_bench_show_pass(s, "load", &hib_bench.load);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(hibernate_bench);
+
+static int __init hibernate_bench_debugfs_init(void)
+{
+	debugfs_create_file("hibernate_bench", 0444, NULL, NULL,
+			    &hibernate_bench_fops);
+	return 0;
+}
+
+late_initcall(hibernate_bench_debugfs_init);
+#endif /* CONFIG_DEBUG_FS */
+
 
 static int __init resume_setup(char *str)
 {
@@ -1357,6 +1514,16 @@ static int __init resumedelay_setup(char *str)
 	return 1;
 }
 
+static int __init compression_threads_setup(char *str)
+{
+	int rc = kstrtouint(str, 0, &hibernate_compression_threads);
+
+	if (rc)
+		pr_warn("hibernate_compression_threads: bad option string '%s'\n",
+			str);
+	return 1;
+}
+
 static int __init nohibernate_setup(char *str)
 {
 	noresume = 1;
@@ -1364,6 +1531,41 @@ static int __init nohibernate_setup(char *str)
 	return 1;
 }
 
+static int hibernate_compressor_param_set(const char *val,
+					  const struct kernel_param *kp)
+{
+	char buf[CRYPTO_MAX_ALG_NAME];
+
+	if (strscpy(buf, val, sizeof(buf)) < 0)
+		return -EINVAL;
+
+	strscpy(hibernate_compressor, strim(buf), sizeof(hibernate_compressor));
+	return 0;
+}
+
+static const struct kernel_param_ops hibernate_compressor_param_ops = {
+	.set	= hibernate_compressor_param_set,
+	.get	= param_get_string,
+};
+
+static struct kparam_string hibernate_compressor_param_string = {
+	.maxlen	= sizeof(hibernate_compressor),
+	.string	= hibernate_compressor,
+};
+
+module_param_cb(compressor, &hibernate_compressor_param_ops,
+		&hibernate_compressor_param_string, 0644);
+MODULE_PARM_DESC(compressor,
+		 "Compression algorithm to be used with hibernation");
+
+module_param_named(io_depth, hibernate_io_depth, uint, 0644);
+MODULE_PARM_DESC(io_depth,
+		 "Maximum number of image I/O requests in flight (0 - no limit)");
+
+module_param(prestage, bool, 0644);
+MODULE_PARM_DESC(prestage,
+		 "Reclaim memory for the image before freezing tasks");
+
 __setup("noresume", noresume_setup);
 __setup("resume_offset=", resume_offset_setup);
 __setup("resume=", resume_setup);
@@ -1371,3 +1573,4 @@ __setup("hibernate=", hibernate_setup);
 __setup("resumewait", resumewait_setup);
 __setup("resumedelay=", resumedelay_setup);
 __setup("nohibernate", nohibernate_setup);
+__setup("hibernate_compression_threads=", compression_threads_setup);
@@ -115,6 +115,7 @@ void pm_report_hw_sleep_time(u64 t)
 {
 	suspend_stats.last_hw_sleep = t;
 	suspend_stats.total_hw_sleep += t;
+	s2idle_history_hw_sleep(t);
 }
 EXPORT_SYMBOL_GPL(pm_report_hw_sleep_time);
 
@@ -124,6 +125,46 @@ void pm_report_max_hw_sleep(u64 t)
 }
 EXPORT_SYMBOL_GPL(pm_report_max_hw_sleep);
 
+/**
+ * pm_report_lpi_residency - Report the low-power idle residency of a suspend.
+ * @sys_us: Growth of the system residency counter, U64_MAX if not available.
+ * @cpu_us: Growth of the CPU residency counter, U64_MAX if not available.
+ *
+ * A suspend in which the system residency counter, or the CPU one if there is
+ * no system counter, has not grown at all is counted as a residency miss.
+ */
+void pm_report_lpi_residency(u64 sys_us, u64 cpu_us)
+{
+	u64 t = sys_us != U64_MAX ? sys_us : cpu_us;
+
+	suspend_stats.last_lpi_residency = sys_us != U64_MAX ? sys_us : 0;
+	suspend_stats.last_lpi_cpu_residency = cpu_us != U64_MAX ? cpu_us : 0;
+	if (!t)
+		suspend_stats.lpi_residency_misses++;
+}
+EXPORT_SYMBOL_GPL(pm_report_lpi_residency);
+
+/* Called by the suspend code at the end of every phase that started at @start */
+void pm_report_phase_time(enum suspend_stat_phase phase, ktime_t start)
+{
+	u64 us = ktime_us_delta(ktime_get(), start);
+	unsigned int i;
+	u64 limit;
+
+	suspend_bench_report_phase(phase, us);
+
+	suspend_stats.phase_last_us[phase] = us;
+	if (us > suspend_stats.phase_max_us[phase])
+		suspend_stats.phase_max_us[phase] = us;
+
+	for (i = 0, limit = USEC_PER_MSEC; i < SUSPEND_PHASE_HIST_NR - 1;
+	     i++, limit *= 4)
+		if (us < limit)
+			break;
+
+	suspend_stats.phase_hist[phase][i]++;
+}
+
 int pm_notifier_call_chain_robust(unsigned long val_up, unsigned long val_down)
 {
 	int ret;
@@ -274,7 +315,7 @@ power_attr(sync_on_suspend);
 #ifdef CONFIG_PM_SLEEP_DEBUG
 int pm_test_level = TEST_NONE;
 
-static const char * const pm_tests[__TEST_AFTER_LAST] = {
+const char * const pm_tests[__TEST_AFTER_LAST] = {
 	[TEST_NONE] = "none",
 	[TEST_CORE] = "core",
 	[TEST_CPUS] = "processors",
@@ -376,6 +417,10 @@ suspend_attr(failed_resume_noirq, "%d\n");
 suspend_attr(last_hw_sleep, "%llu\n");
 suspend_attr(total_hw_sleep, "%llu\n");
 suspend_attr(max_hw_sleep, "%llu\n");
+suspend_attr(last_lpi_residency, "%llu\n");
+suspend_attr(last_lpi_cpu_residency, "%llu\n");
+suspend_attr(lpi_residency_misses, "%d\n");
+suspend_attr(s2idle_spurious, "%d\n");
 
 static ssize_t last_failed_dev_show(struct kobject *kobj,
 		struct kobj_attribute *attr, char *buf)
@@ -421,6 +466,56 @@ static ssize_t last_failed_step_show(struct kobject *kobj,
 }
 static struct kobj_attribute last_failed_step = __ATTR_RO(last_failed_step);
 
+const char * const suspend_phase_names[SUSPEND_PHASE_NR] = {
+	[SUSPEND_PHASE_FREEZE] = "freeze",
+	[SUSPEND_PHASE_PREPARE] = "prepare",
+	[SUSPEND_PHASE_SUSPEND] = "suspend",
+	[SUSPEND_PHASE_SUSPEND_LATE] = "suspend_late",
+	[SUSPEND_PHASE_SUSPEND_NOIRQ] = "suspend_noirq",
+	[SUSPEND_PHASE_PLATFORM_SUSPEND] = "platform_suspend",
+	[SUSPEND_PHASE_PLATFORM_RESUME] = "platform_resume",
+	[SUSPEND_PHASE_RESUME_NOIRQ] = "resume_noirq",
+	[SUSPEND_PHASE_RESUME_EARLY] = "resume_early",
+	[SUSPEND_PHASE_RESUME] = "resume",
+	[SUSPEND_PHASE_COMPLETE] = "complete",
+	[SUSPEND_PHASE_THAW] = "thaw",
+};
+
+static ssize_t phase_times_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	enum suspend_stat_phase phase;
+	ssize_t len;
+	int i;
+
+	len = sysfs_emit(buf, "%-16s %10s %10s %7s %7s %7s %7s %7s %7s %7s %7s\n",
+			 "phase", "last_us", "max_us", "<1ms", "<4ms", "<16ms",
+			 "<64ms", "<256ms", "<1s", "<4s", ">=4s");
+
+	for (phase = 0; phase < SUSPEND_PHASE_NR; phase++) {
+		len += sysfs_emit_at(buf, len, "%-16s %10llu %10llu",
+				     suspend_phase_names[phase],
+				     suspend_stats.phase_last_us[phase],
+				     suspend_stats.phase_max_us[phase]);
+		for (i = 0; i < SUSPEND_PHASE_HIST_NR; i++)
+			len += sysfs_emit_at(buf, len, " %7u",
+					     suspend_stats.phase_hist[phase][i]);
+		len += sysfs_emit_at(buf, len, "\n");
+	}
+
+	return len;
+}
+static struct kobj_attribute phase_times = __ATTR_RO(phase_times);
+
+#ifdef CONFIG_SUSPEND
+static ssize_t s2idle_history_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return s2idle_history_emit(buf);
+}
+static struct kobj_attribute s2idle_history = __ATTR_RO(s2idle_history);
+#endif
+
 static struct attribute *suspend_attrs[] = {
 	&success.attr,
 	&fail.attr,
@@ -438,6 +533,14 @@ static struct attribute *suspend_attrs[] = {
 	&last_hw_sleep.attr,
 	&total_hw_sleep.attr,
 	&max_hw_sleep.attr,
+	&last_lpi_residency.attr,
+	&last_lpi_cpu_residency.attr,
+	&lpi_residency_misses.attr,
+	&s2idle_spurious.attr,
+	&phase_times.attr,
+#ifdef CONFIG_SUSPEND
+	&s2idle_history.attr,
+#endif
 	NULL,
 };
 
@@ -445,7 +548,10 @@ static umode_t suspend_attr_is_visible(struct kobject *kobj, struct attribute *a
 {
 	if (attr != &last_hw_sleep.attr &&
 	    attr != &total_hw_sleep.attr &&
-	    attr != &max_hw_sleep.attr)
+	    attr != &max_hw_sleep.attr &&
+	    attr != &last_lpi_residency.attr &&
+	    attr != &last_lpi_cpu_residency.attr &&
+	    attr != &lpi_residency_misses.attr)
 		return 0444;
 
 #ifdef CONFIG_ACPI
@@ -6,6 +6,7 @@
 #include <linux/compiler.h>
 #include <linux/cpu.h>
 #include <linux/cpuidle.h>
+#include <linux/crypto.h>
 
 struct swsusp_info {
 	struct new_utsname	uts;
@@ -93,14 +94,21 @@ static struct kobj_attribute _name##_attr = {	\
 
 /* Preferred image size in bytes (default 500 MB) */
 extern unsigned long image_size;
+/* Pick image_size from the figures of the last hibernation */
+extern bool image_size_auto;
 /* Size of memory reserved for drivers (default SPARE_PAGES x PAGE_SIZE) */
 extern unsigned long reserved_size;
+/* Number of image compression threads (default 0, scale with CPUs) */
+extern unsigned int hibernate_compression_threads;
+/* Maximum number of image I/O requests in flight (default 0, no limit) */
+extern unsigned int hibernate_io_depth;
 extern int in_suspend;
 extern dev_t swsusp_resume_device;
 extern sector_t swsusp_resume_block;
 
 extern int create_basic_memory_bitmaps(void);
 extern void free_basic_memory_bitmaps(void);
+extern void hibernate_prestage_memory(void);
 extern int hibernate_preallocate_memory(void);
 
 extern void clear_or_poison_free_pages(void);
@@ -166,6 +174,45 @@ extern int swsusp_swap_in_use(void);
 #define SF_NOCOMPRESS_MODE	2
 #define SF_CRC32_MODE	        4
 #define SF_HW_SIG		8
+#define SF_COMP_ALG		16
+
+/* Name of the crypto API compressor used for the image */
+extern char hib_comp_algo[CRYPTO_MAX_ALG_NAME];
+
+/*
+ * Per-stage measurements of the last image creation, save and load.  They are
+ * kept in __nosavedata, so the figures of the load are still there after the
+ * image has been restored.
+ */
+#define HIB_BENCH_THREADS	32
+
+struct hib_bench_thread {
+	u64 ns;			/* compressing or decompressing */
+	u64 crc_ns;
+	u64 unc_bytes;
+	u64 cmp_bytes;
+	unsigned int chunks;
+};
+
+struct hib_bench_pass {
+	u64 ns;			/* moving the image data */
+	unsigned int pages;
+	u64 submit_ns;		/* in submit_bio() */
+	u64 wait_ns;		/* waiting for the device */
+	unsigned int bios;
+	char comp_alg[CRYPTO_MAX_ALG_NAME];	/* empty if not compressed */
+	unsigned int nr_threads;
+	struct hib_bench_thread thread[HIB_BENCH_THREADS];
+};
+
+struct hib_bench {
+	u64 prealloc_ns;	/* hibernate_preallocate_memory() */
+	u64 snapshot_ns;	/* create_image(), including the atomic copy */
+	struct hib_bench_pass save;
+	struct hib_bench_pass load;
+};
+
+extern struct hib_bench hib_bench;
 
 /* kernel/power/hibernate.c */
 int swsusp_check(bool snapshot_test);
@@ -188,6 +235,8 @@ extern const char *pm_states[];
 extern const char *mem_sleep_states[];
 
 extern int suspend_devices_and_enter(suspend_state_t state);
+extern void s2idle_history_hw_sleep(u64 t);
+extern ssize_t s2idle_history_emit(char *buf);
 #else /* !CONFIG_SUSPEND */
 #define mem_sleep_current	PM_SUSPEND_ON
 
@@ -195,21 +244,26 @@ static inline int suspend_devices_and_enter(suspend_state_t state)
 {
 	return -ENOSYS;
 }
+static inline void s2idle_history_hw_sleep(u64 t) {}
 #endif /* !CONFIG_SUSPEND */
 
 #ifdef CONFIG_PM_TEST_SUSPEND
 /* kernel/power/suspend_test.c */
 extern void suspend_test_start(void);
 extern void suspend_test_finish(const char *label);
+extern void suspend_bench_report_phase(enum suspend_stat_phase phase, u64 us);
 #else /* !CONFIG_PM_TEST_SUSPEND */
 static inline void suspend_test_start(void) {}
 static inline void suspend_test_finish(const char *label) {}
+static inline void suspend_bench_report_phase(enum suspend_stat_phase phase,
+					      u64 us) {}
 #endif /* !CONFIG_PM_TEST_SUSPEND */
 
 #ifdef CONFIG_PM_SLEEP
 /* kernel/power/main.c */
 extern int pm_notifier_call_chain_robust(unsigned long val_up, unsigned long val_down);
 extern int pm_notifier_call_chain(unsigned long val);
+extern const char * const suspend_phase_names[SUSPEND_PHASE_NR];
 void pm_restrict_gfp_mask(void);
 void pm_restore_gfp_mask(void);
 #else
@@ -244,6 +298,7 @@ enum {
 
 #ifdef CONFIG_PM_SLEEP_DEBUG
 extern int pm_test_level;
+extern const char * const pm_tests[__TEST_AFTER_LAST];
 #else
 #define pm_test_level	(TEST_NONE)
 #endif
@@ -10,8 +10,12 @@
 #include <linux/oom.h>
 #include <linux/suspend.h>
 #include <linux/module.h>
+#include <linux/sched/deadline.h>
 #include <linux/sched/debug.h>
+#include <linux/sched/rt.h>
+#include <linux/sched/stat.h>
 #include <linux/sched/task.h>
+#include <linux/slab.h>
 #include <linux/syscalls.h>
 #include <linux/freezer.h>
 #include <linux/delay.h>
@@ -25,13 +29,75 @@
  */
 unsigned int __read_mostly freeze_timeout_msecs = 20 * MSEC_PER_SEC;
 
+/*
+ * Tasks found not frozen yet by the last full scan, so that the retries only
+ * need to look at them instead of walking all of the threads again.
+ */
+struct freeze_todo {
+	struct task_struct **tasks;
+	unsigned int nr;
+	unsigned int size;
+	bool overflow;
+};
+
+static void freeze_todo_release(struct freeze_todo *t)
+{
+	while (t->nr)
+		put_task_struct(t->tasks[--t->nr]);
+
+	t->overflow = false;
+}
+
+static unsigned int freeze_scan_all(struct freeze_todo *t)
+{
+	struct task_struct *g, *p;
+	unsigned int todo = 0;
+
+	freeze_todo_release(t);
+
+	read_lock(&tasklist_lock);
+	for_each_process_thread(g, p) {
+		if (p == current || !freeze_task(p))
+			continue;
+
+		todo++;
+		if (t->nr < t->size)
+			t->tasks[t->nr++] = get_task_struct(p);
+		else
+			t->overflow = true;
+	}
+	read_unlock(&tasklist_lock);
+
+	return todo;
+}
+
+static unsigned int freeze_scan_todo(struct freeze_todo *t)
+{
+	unsigned int i, nr = 0;
+
+	for (i = 0; i < t->nr; i++) {
+		struct task_struct *p = t->tasks[i];
+
+		/* Exited tasks are PF_NOFREEZE, so they are dropped here too. */
+		if (freeze_task(p))
+			t->tasks[nr++] = p;
+		else
+			put_task_struct(p);
+	}
+	t->nr = nr;
+
+	return nr;
+}
+
 static int try_to_freeze_tasks(bool user_only)
 {
 	const char *what = user_only ? "user space processes" :
 					"remaining freezable tasks";
+	struct freeze_todo t = {};
 	struct task_struct *g, *p;
 	unsigned long end_time;
 	unsigned int todo;
+	bool full = true;
 	bool wq_busy = false;
 	ktime_t start, end, elapsed;
 	unsigned int elapsed_msecs;
@@ -47,16 +113,26 @@ static int try_to_freeze_tasks(bool user_only)
 	if (!user_only)
 		freeze_workqueues_begin();
 
-	while (true) {
-		todo = 0;
-		read_lock(&tasklist_lock);
-		for_each_process_thread(g, p) {
-			if (p == current || !freeze_task(p))
-				continue;
+	/* Leave room for the tasks created while freezing. */
+	t.size = READ_ONCE(nr_threads) + 64;
+	t.tasks = kvmalloc_array(t.size, sizeof(*t.tasks),
+				 GFP_KERNEL | __GFP_NOWARN);
+	if (!t.tasks)
+		t.size = 0;
 
-			todo++;
+	while (true) {
+		if (full) {
+			todo = freeze_scan_all(&t);
+		} else {
+			todo = freeze_scan_todo(&t);
+			/*
+			 * Tasks may have been created since the last full
+			 * scan, so confirm that it is done with another one.
+			 */
+			if (!todo)
+				todo = freeze_scan_all(&t);
 		}
-		read_unlock(&tasklist_lock);
+		full = t.overflow;
 
 		if (!user_only) {
 			wq_busy = freeze_workqueues_busy();
@@ -81,6 +157,9 @@ static int try_to_freeze_tasks(bool user_only)
 			sleep_usecs *= 2;
 	}
 
+	freeze_todo_release(&t);
+	kvfree(t.tasks);
+
 	end = ktime_get_boottime();
 	elapsed = ktime_sub(end, start);
 	elapsed_msecs = ktime_to_ms(elapsed);
@@ -176,6 +255,11 @@ int freeze_kernel_threads(void)
 	return error;
 }
 
+static bool thaw_task_first(struct task_struct *p)
+{
+	return dl_task(p) || rt_task(p) || task_nice(p) < 0;
+}
+
 void thaw_processes(void)
 {
 	struct task_struct *g, *p;
@@ -197,6 +281,15 @@ void thaw_processes(void)
 	cpuset_wait_for_hotplug();
 
 	read_lock(&tasklist_lock);
+	/*
+	 * Wake up the latency-sensitive tasks first, so that they get on the
+	 * runqueues before the rest of them.
+	 */
+	for_each_process_thread(g, p) {
+		if (thaw_task_first(p))
+			__thaw_task(p);
+	}
+	/* Thawing a task that is not frozen is a no-op. */
 	for_each_process_thread(g, p) {
 		/* No other threads should have PF_SUSPEND_TASK set */
 		WARN_ON((p != curr) && (p->flags & PF_SUSPEND_TASK));
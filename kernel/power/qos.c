@@ -22,12 +22,15 @@
 
 #include <linux/pm_qos.h>
 #include <linux/sched.h>
+#include <linux/sched/idle.h>
 #include <linux/spinlock.h>
 #include <linux/slab.h>
 #include <linux/time.h>
 #include <linux/fs.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
+#include <linux/mutex.h>
+#include <linux/cpumask.h>
 #include <linux/string.h>
 #include <linux/platform_device.h>
 #include <linux/init.h>
@@ -78,25 +81,10 @@ static void pm_qos_set_value(struct pm_qos_constraints *c, s32 value)
 	WRITE_ONCE(c->target_value, value);
 }
 
-/**
- * pm_qos_update_target - Update a list of PM QoS constraint requests.
- * @c: List of PM QoS requests.
- * @node: Target list entry.
- * @action: Action to carry out (add, update or remove).
- * @value: New request value for the target list entry.
- *
- * Update the given list of PM QoS constraint requests, @c, by carrying an
- * @action involving the @node list entry and @value on it.
- *
- * The recognized values of @action are PM_QOS_ADD_REQ (store @value in @node
- * and add it to the list), PM_QOS_UPDATE_REQ (remove @node from the list, store
- * @value in it and add it to the list again), and PM_QOS_REMOVE_REQ (remove
- * @node from the list, ignore @value).
- *
- * Return: 1 if the aggregate constraint value has changed, 0  otherwise.
- */
-int pm_qos_update_target(struct pm_qos_constraints *c, struct plist_node *node,
-			 enum pm_qos_req_action action, int value)
+/* Update the list of requests without invoking the notifiers. */
+static int __pm_qos_update_target(struct pm_qos_constraints *c,
+				  struct plist_node *node,
+				  enum pm_qos_req_action action, int value)
 {
 	int prev_value, curr_value, new_value;
 	unsigned long flags;
@@ -136,13 +124,36 @@ int pm_qos_update_target(struct pm_qos_constraints *c, struct plist_node *node,
 
 	trace_pm_qos_update_target(action, prev_value, curr_value);
 
-	if (prev_value == curr_value)
-		return 0;
+	return prev_value != curr_value;
+}
 
-	if (c->notifiers)
-		blocking_notifier_call_chain(c->notifiers, curr_value, NULL);
+/**
+ * pm_qos_update_target - Update a list of PM QoS constraint requests.
+ * @c: List of PM QoS requests.
+ * @node: Target list entry.
+ * @action: Action to carry out (add, update or remove).
+ * @value: New request value for the target list entry.
+ *
+ * Update the given list of PM QoS constraint requests, @c, by carrying an
+ * @action involving the @node list entry and @value on it.
+ *
+ * The recognized values of @action are PM_QOS_ADD_REQ (store @value in @node
+ * and add it to the list), PM_QOS_UPDATE_REQ (remove @node from the list, store
+ * @value in it and add it to the list again), and PM_QOS_REMOVE_REQ (remove
+ * @node from the list, ignore @value).
+ *
+ * Return: 1 if the aggregate constraint value has changed, 0  otherwise.
+ */
+int pm_qos_update_target(struct pm_qos_constraints *c, struct plist_node *node,
+			 enum pm_qos_req_action action, int value)
+{
+	int ret = __pm_qos_update_target(c, node, action, value);
+
+	if (ret && c->notifiers)
+		blocking_notifier_call_chain(c->notifiers, pm_qos_read_value(c),
+					     NULL);
 
-	return 1;
+	return ret;
 }
 
 /**
@@ -220,6 +231,25 @@ static struct pm_qos_constraints cpu_latency_constraints = {
 	.type = PM_QOS_MIN,
 };
 
+/*
+ * Per-CPU CPU latency QoS requests, in addition to the global ones above.
+ *
+ * The effective limit for every CPU, taking both the global and the per-CPU
+ * requests into account, is kept in a read-mostly per-CPU variable, so the
+ * idle loop can read it without touching any cache lines written by the other
+ * CPUs.  It is only updated when the aggregate value of the global or of the
+ * given CPU's requests changes, under cpu_latency_qos_limit_lock.
+ */
+struct cpu_latency_qos_cpu {
+	struct pm_qos_constraints constraints;
+	int cpu;
+};
+
+static DEFINE_PER_CPU(struct cpu_latency_qos_cpu, cpu_latency_cpu_constraints);
+static DEFINE_PER_CPU_READ_MOSTLY(s32, cpu_latency_qos_cpu_limit) =
+	PM_QOS_CPU_LATENCY_DEFAULT_VALUE;
+static DEFINE_RAW_SPINLOCK(cpu_latency_qos_limit_lock);
+
 static inline bool cpu_latency_qos_value_invalid(s32 value)
 {
 	return value < 0 && value != PM_QOS_DEFAULT_VALUE;
@@ -233,25 +263,75 @@ s32 cpu_latency_qos_limit(void)
 	return pm_qos_read_value(&cpu_latency_constraints);
 }
 
+/**
+ * cpu_latency_qos_limit_cpu - Return current CPU latency QoS limit for a CPU.
+ * @cpu: Target CPU.
+ *
+ * Return the smaller of the system-wide CPU latency QoS limit and the limit
+ * resulting from the per-CPU requests for @cpu.
+ */
+s32 cpu_latency_qos_limit_cpu(int cpu)
+{
+	return READ_ONCE(per_cpu(cpu_latency_qos_cpu_limit, cpu));
+}
+
+static bool cpu_latency_qos_cpu_request(struct pm_qos_request *req)
+{
+	return req->qos && req->qos != &cpu_latency_constraints;
+}
+
 /**
  * cpu_latency_qos_request_active - Check the given PM QoS request.
  * @req: PM QoS request to check.
  *
- * Return: 'true' if @req has been added to the CPU latency QoS list, 'false'
- * otherwise.
+ * Return: 'true' if @req has been added to the CPU latency QoS list, or to the
+ * list of one of the CPUs, 'false' otherwise.
  */
 bool cpu_latency_qos_request_active(struct pm_qos_request *req)
 {
-	return req->qos == &cpu_latency_constraints;
+	return req->qos == &cpu_latency_constraints ||
+		cpu_latency_qos_cpu_request(req);
 }
 EXPORT_SYMBOL_GPL(cpu_latency_qos_request_active);
 
+static void cpu_latency_qos_update_limit(int cpu)
+{
+	struct cpu_latency_qos_cpu *qc = per_cpu_ptr(&cpu_latency_cpu_constraints, cpu);
+	s32 value = pm_qos_read_value(&cpu_latency_constraints);
+
+	if (qc->constraints.type)
+		value = min(value, pm_qos_read_value(&qc->constraints));
+
+	WRITE_ONCE(per_cpu(cpu_latency_qos_cpu_limit, cpu), value);
+}
+
 static void cpu_latency_qos_apply(struct pm_qos_request *req,
 				  enum pm_qos_req_action action, s32 value)
 {
-	int ret = pm_qos_update_target(req->qos, &req->node, action, value);
-	if (ret > 0)
+	struct cpu_latency_qos_cpu *qc;
+	unsigned long flags;
+	int ret, cpu;
+
+	ret = pm_qos_update_target(req->qos, &req->node, action, value);
+	if (ret <= 0)
+		return;
+
+	raw_spin_lock_irqsave(&cpu_latency_qos_limit_lock, flags);
+
+	if (!cpu_latency_qos_cpu_request(req)) {
+		for_each_possible_cpu(cpu)
+			cpu_latency_qos_update_limit(cpu);
+
+		raw_spin_unlock_irqrestore(&cpu_latency_qos_limit_lock, flags);
 		wake_up_all_idle_cpus();
+		return;
+	}
+
+	qc = container_of(req->qos, struct cpu_latency_qos_cpu, constraints);
+	cpu_latency_qos_update_limit(qc->cpu);
+
+	raw_spin_unlock_irqrestore(&cpu_latency_qos_limit_lock, flags);
+	wake_up_if_idle(qc->cpu);
 }
 
 /**
@@ -283,6 +363,36 @@ void cpu_latency_qos_add_request(struct pm_qos_request *req, s32 value)
 }
 EXPORT_SYMBOL_GPL(cpu_latency_qos_add_request);
 
+/**
+ * cpu_latency_qos_add_cpu_request - Add new CPU latency QoS request for a CPU.
+ * @req: Pointer to a preallocated handle.
+ * @cpu: CPU the request applies to.
+ * @value: Requested constraint value.
+ *
+ * Like cpu_latency_qos_add_request(), but the request only affects the idle
+ * states of @cpu.  It can be updated and removed with
+ * cpu_latency_qos_update_request() and cpu_latency_qos_remove_request(),
+ * respectively.
+ */
+void cpu_latency_qos_add_cpu_request(struct pm_qos_request *req, int cpu,
+				     s32 value)
+{
+	if (!req || cpu_latency_qos_value_invalid(value) ||
+	    WARN_ON_ONCE(!cpu_possible(cpu)))
+		return;
+
+	if (cpu_latency_qos_request_active(req)) {
+		WARN(1, KERN_ERR "%s called for already added request\n", __func__);
+		return;
+	}
+
+	trace_pm_qos_add_request(value);
+
+	req->qos = &per_cpu_ptr(&cpu_latency_cpu_constraints, cpu)->constraints;
+	cpu_latency_qos_apply(req, PM_QOS_ADD_REQ, value);
+}
+EXPORT_SYMBOL_GPL(cpu_latency_qos_add_cpu_request);
+
 /**
  * cpu_latency_qos_update_request - Modify existing CPU latency QoS request.
  * @req : QoS request to update.
@@ -337,28 +447,63 @@ EXPORT_SYMBOL_GPL(cpu_latency_qos_remove_request);
 
 /* User space interface to the CPU latency QoS via misc device. */
 
+/*
+ * A file handle either holds one request in the system-wide list or, after
+ * CPU_LATENCY_QOS_SET_CPUS, one request per CPU in the mask set with it.
+ */
+struct cpu_latency_qos_file {
+	struct mutex lock;
+	s32 value;
+	struct pm_qos_request req;
+	struct pm_qos_request *cpu_reqs;
+	cpumask_var_t cpus;
+};
+
 static int cpu_latency_qos_open(struct inode *inode, struct file *filp)
 {
-	struct pm_qos_request *req;
+	struct cpu_latency_qos_file *qf;
 
-	req = kzalloc(sizeof(*req), GFP_KERNEL);
-	if (!req)
+	qf = kzalloc(sizeof(*qf), GFP_KERNEL);
+	if (!qf)
+		return -ENOMEM;
+
+	if (!zalloc_cpumask_var(&qf->cpus, GFP_KERNEL)) {
+		kfree(qf);
 		return -ENOMEM;
+	}
 
-	cpu_latency_qos_add_request(req, PM_QOS_DEFAULT_VALUE);
-	filp->private_data = req;
+	mutex_init(&qf->lock);
+	qf->value = PM_QOS_DEFAULT_VALUE;
+	cpu_latency_qos_add_request(&qf->req, PM_QOS_DEFAULT_VALUE);
+	filp->private_data = qf;
 
 	return 0;
 }
 
+static void cpu_latency_qos_remove_cpu_reqs(struct pm_qos_request *reqs,
+					    const struct cpumask *cpus)
+{
+	int cpu, i = 0;
+
+	for_each_cpu(cpu, cpus)
+		cpu_latency_qos_remove_request(&reqs[i++]);
+
+	kfree(reqs);
+}
+
 static int cpu_latency_qos_release(struct inode *inode, struct file *filp)
 {
-	struct pm_qos_request *req = filp->private_data;
+	struct cpu_latency_qos_file *qf = filp->private_data;
 
 	filp->private_data = NULL;
 
-	cpu_latency_qos_remove_request(req);
-	kfree(req);
+	if (cpu_latency_qos_request_active(&qf->req))
+		cpu_latency_qos_remove_request(&qf->req);
+	else
+		cpu_latency_qos_remove_cpu_reqs(qf->cpu_reqs, qf->cpus);
+
+	free_cpumask_var(qf->cpus);
+	kfree(qf);
 
 	return 0;
 }
@@ -366,16 +511,28 @@ static int cpu_latency_qos_release(struct inode *inode, struct file *filp)
 static ssize_t cpu_latency_qos_read(struct file *filp, char __user *buf,
 				    size_t count, loff_t *f_pos)
 {
-	struct pm_qos_request *req = filp->private_data;
+	struct cpu_latency_qos_file *qf = filp->private_data;
 	unsigned long flags;
 	s32 value;
+	int cpu;
 
-	if (!req || !cpu_latency_qos_request_active(req))
+	if (!qf)
 		return -EINVAL;
 
-	spin_lock_irqsave(&pm_qos_lock, flags);
-	value = pm_qos_get_value(&cpu_latency_constraints);
-	spin_unlock_irqrestore(&pm_qos_lock, flags);
+	mutex_lock(&qf->lock);
+
+	if (cpu_latency_qos_request_active(&qf->req)) {
+		spin_lock_irqsave(&pm_qos_lock, flags);
+		value = pm_qos_get_value(&cpu_latency_constraints);
+		spin_unlock_irqrestore(&pm_qos_lock, flags);
+	} else {
+		/* The tightest limit that applies to one of the CPUs */
+		value = S32_MAX;
+		for_each_cpu(cpu, qf->cpus)
+			value = min(value, cpu_latency_qos_limit_cpu(cpu));
+	}
+
+	mutex_unlock(&qf->lock);
 
 	return simple_read_from_buffer(buf, count, f_pos, &value, sizeof(s32));
 }
@@ -383,7 +540,9 @@ static ssize_t cpu_latency_qos_read(struct file *filp, char __user *buf,
 static ssize_t cpu_latency_qos_write(struct file *filp, const char __user *buf,
 				     size_t count, loff_t *f_pos)
 {
+	struct cpu_latency_qos_file *qf = filp->private_data;
 	s32 value;
+	int cpu, i = 0;
 
 	if (count == sizeof(s32)) {
 		if (copy_from_user(&value, buf, sizeof(s32)))
@@ -396,14 +555,102 @@ static ssize_t cpu_latency_qos_write(struct file *filp, const char __user *buf,
 			return ret;
 	}
 
-	cpu_latency_qos_update_request(filp->private_data, value);
+	mutex_lock(&qf->lock);
+
+	if (!cpu_latency_qos_value_invalid(value))
+		qf->value = value;
+
+	if (cpu_latency_qos_request_active(&qf->req)) {
+		cpu_latency_qos_update_request(&qf->req, value);
+	} else {
+		for_each_cpu(cpu, qf->cpus)
+			cpu_latency_qos_update_request(&qf->cpu_reqs[i++], value);
+	}
+
+	mutex_unlock(&qf->lock);
 
 	return count;
 }
 
+static int cpu_latency_qos_set_cpus(struct cpu_latency_qos_file *qf,
+				    struct cpu_latency_qos_cpus __user *arg)
+{
+	struct pm_qos_request *reqs = NULL, *old_reqs;
+	struct cpu_latency_qos_cpus qc;
+	cpumask_var_t cpus;
+	unsigned int len;
+	int cpu, i = 0, ret = 0;
+
+	if (copy_from_user(&qc, arg, sizeof(qc)))
+		return -EFAULT;
+
+	if (qc.reserved)
+		return -EINVAL;
+
+	if (!zalloc_cpumask_var(&cpus, GFP_KERNEL))
+		return -ENOMEM;
+
+	len = min_t(unsigned int, qc.size, cpumask_size());
+	if (copy_from_user(cpumask_bits(cpus), u64_to_user_ptr(qc.mask), len)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	cpumask_and(cpus, cpus, cpu_possible_mask);
+
+	if (!cpumask_empty(cpus)) {
+		reqs = kcalloc(cpumask_weight(cpus), sizeof(*reqs), GFP_KERNEL);
+		if (!reqs) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	mutex_lock(&qf->lock);
+
+	/* Add the new requests first, so the constraint never goes away. */
+	if (reqs) {
+		for_each_cpu(cpu, cpus)
+			cpu_latency_qos_add_cpu_request(&reqs[i++], cpu,
+							qf->value);
+	} else if (!cpu_latency_qos_request_active(&qf->req)) {
+		cpu_latency_qos_add_request(&qf->req, qf->value);
+	}
+
+	old_reqs = qf->cpu_reqs;
+	if (old_reqs)
+		cpu_latency_qos_remove_cpu_reqs(old_reqs, qf->cpus);
+	else if (reqs)
+		cpu_latency_qos_remove_request(&qf->req);
+
+	qf->cpu_reqs = reqs;
+	cpumask_copy(qf->cpus, cpus);
+
+	mutex_unlock(&qf->lock);
+
+out:
+	free_cpumask_var(cpus);
+	return ret;
+}
+
+static long cpu_latency_qos_ioctl(struct file *filp, unsigned int cmd,
+				  unsigned long arg)
+{
+	struct cpu_latency_qos_file *qf = filp->private_data;
+
+	switch (cmd) {
+	case CPU_LATENCY_QOS_SET_CPUS:
+		return cpu_latency_qos_set_cpus(qf, (void __user *)arg);
+	default:
+		return -ENOTTY;
+	}
+}
+
 static const struct file_operations cpu_latency_qos_fops = {
 	.write = cpu_latency_qos_write,
 	.read = cpu_latency_qos_read,
+	.unlocked_ioctl = cpu_latency_qos_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
 	.open = cpu_latency_qos_open,
 	.release = cpu_latency_qos_release,
 	.llseek = noop_llseek,
@@ -415,6 +662,25 @@ static struct miscdevice cpu_latency_qos_miscdev = {
 	.fops = &cpu_latency_qos_fops,
 };
 
+static int __init cpu_latency_qos_cpu_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct cpu_latency_qos_cpu *qc = per_cpu_ptr(&cpu_latency_cpu_constraints, cpu);
+
+		plist_head_init(&qc->constraints.list);
+		qc->constraints.target_value = PM_QOS_CPU_LATENCY_DEFAULT_VALUE;
+		qc->constraints.default_value = PM_QOS_CPU_LATENCY_DEFAULT_VALUE;
+		qc->constraints.no_constraint_value = PM_QOS_CPU_LATENCY_DEFAULT_VALUE;
+		qc->constraints.type = PM_QOS_MIN;
+		qc->cpu = cpu;
+	}
+
+	return 0;
+}
+core_initcall(cpu_latency_qos_cpu_init);
+
 static int __init cpu_latency_qos_init(void)
 {
 	int ret;
@@ -436,6 +702,54 @@ static inline bool freq_qos_value_invalid(s32 value)
 	return value < 0 && value != PM_QOS_DEFAULT_VALUE;
 }
 
+static struct pm_qos_constraints *freq_qos_constraints(struct freq_constraints *qos,
+							enum freq_qos_req_type type)
+{
+	return type == FREQ_QOS_MIN ? &qos->min_freq : &qos->max_freq;
+}
+
+/* Invoke the notifiers for the lists that have changed since the last time. */
+static void freq_qos_notify(struct freq_constraints *qos)
+{
+	enum freq_qos_req_type type;
+
+	for (type = FREQ_QOS_MIN; type <= FREQ_QOS_MAX; type++) {
+		struct pm_qos_constraints *c = freq_qos_constraints(qos, type);
+
+		if (test_and_clear_bit(type, &qos->notify_pending))
+			blocking_notifier_call_chain(c->notifiers,
+						     pm_qos_read_value(c), NULL);
+	}
+}
+
+static void freq_qos_notify_work_fn(struct work_struct *work)
+{
+	struct freq_constraints *qos = container_of(to_delayed_work(work),
+						    struct freq_constraints,
+						    notify_work);
+
+	freq_qos_notify(qos);
+}
+
+/*
+ * Record a change of the @type list of @qos and notify it, either right away
+ * or, if a coalescing window has been set, when the window ends.  In the
+ * latter case, all of the changes made within the window are notified once.
+ */
+static void freq_qos_changed(struct freq_constraints *qos,
+			     enum freq_qos_req_type type, bool defer)
+{
+	unsigned int delay_ms = READ_ONCE(qos->notify_delay_ms);
+
+	set_bit(type, &qos->notify_pending);
+
+	if (delay_ms)
+		queue_delayed_work(system_wq, &qos->notify_work,
+				   msecs_to_jiffies(delay_ms));
+	else if (!defer)
+		freq_qos_notify(qos);
+}
+
 /**
  * freq_constraints_init - Initialize frequency QoS constraints.
  * @qos: Frequency QoS constraints to initialize.
@@ -461,7 +775,40 @@ void freq_constraints_init(struct freq_constraints *qos)
 	c->type = PM_QOS_MIN;
 	c->notifiers = &qos->max_freq_notifiers;
 	BLOCKING_INIT_NOTIFIER_HEAD(c->notifiers);
+
+	qos->notify_pending = 0;
+	qos->notify_delay_ms = 0;
+	INIT_DELAYED_WORK(&qos->notify_work, freq_qos_notify_work_fn);
+}
+
+/**
+ * freq_qos_set_notify_delay - Set the notification window for frequency QoS.
+ * @qos: Frequency QoS constraints to update.
+ * @delay_ms: Length of the window in milliseconds, or 0.
+ *
+ * If @delay_ms is not 0, the notifiers of @qos are not invoked synchronously
+ * when the effective constraint changes, but from a work item running
+ * @delay_ms after the first change, so bursts of updates result in one
+ * notification.  Passing 0 restores synchronous notification, in which case
+ * any pending notifications are delivered before returning.
+ *
+ * Before freeing @qos, this needs to be called with @delay_ms equal to 0, when
+ * there are no more concurrent updates of its requests.
+ */
+void freq_qos_set_notify_delay(struct freq_constraints *qos,
+			       unsigned int delay_ms)
+{
+	if (IS_ERR_OR_NULL(qos))
+		return;
+
+	WRITE_ONCE(qos->notify_delay_ms, delay_ms);
+	if (delay_ms)
+		return;
+
+	cancel_delayed_work_sync(&qos->notify_work);
+	freq_qos_notify(qos);
 }
+EXPORT_SYMBOL_GPL(freq_qos_set_notify_delay);
 
 /**
  * freq_qos_read_value - Get frequency QoS constraint for a given list.
@@ -492,35 +839,46 @@ s32 freq_qos_read_value(struct freq_constraints *qos,
 	return ret;
 }
 
-/**
- * freq_qos_apply - Add/modify/remove frequency QoS request.
- * @req: Constraint request to apply.
- * @action: Action to perform (add/update/remove).
- * @value: Value to assign to the QoS request.
- *
- * This is only meant to be called from inside pm_qos, not drivers.
+/*
+ * Apply a frequency QoS request.  With @defer set, the notifiers are left to
+ * the caller, unless a coalescing window has been set.
  */
-int freq_qos_apply(struct freq_qos_request *req,
-			  enum pm_qos_req_action action, s32 value)
+static int __freq_qos_apply(struct freq_qos_request *req,
+			    enum pm_qos_req_action action, s32 value,
+			    bool defer)
 {
 	int ret;
 
 	switch(req->type) {
 	case FREQ_QOS_MIN:
-		ret = pm_qos_update_target(&req->qos->min_freq, &req->pnode,
-					   action, value);
-		break;
 	case FREQ_QOS_MAX:
-		ret = pm_qos_update_target(&req->qos->max_freq, &req->pnode,
-					   action, value);
+		ret = __pm_qos_update_target(freq_qos_constraints(req->qos, req->type),
+					     &req->pnode, action, value);
 		break;
 	default:
-		ret = -EINVAL;
+		return -EINVAL;
 	}
 
+	if (ret > 0)
+		freq_qos_changed(req->qos, req->type, defer);
+
 	return ret;
 }
 
+/**
+ * freq_qos_apply - Add/modify/remove frequency QoS request.
+ * @req: Constraint request to apply.
+ * @action: Action to perform (add/update/remove).
+ * @value: Value to assign to the QoS request.
+ *
+ * This is only meant to be called from inside pm_qos, not drivers.
+ */
+int freq_qos_apply(struct freq_qos_request *req,
+			  enum pm_qos_req_action action, s32 value)
+{
+	return __freq_qos_apply(req, action, value, false);
+}
+
 /**
  * freq_qos_add_request - Insert new frequency QoS request into a given list.
  * @qos: Constraints to update.
@@ -587,6 +945,57 @@ int freq_qos_update_request(struct freq_qos_request *req, s32 new_value)
 }
 EXPORT_SYMBOL_GPL(freq_qos_update_request);
 
+/**
+ * freq_qos_update_requests - Modify a set of frequency QoS requests.
+ * @reqs: Requests to modify.
+ * @new_values: New request values, one for each entry in @reqs.
+ * @nr: Number of entries in @reqs.
+ *
+ * Like freq_qos_update_request() called for every entry in @reqs, except that
+ * the notifiers of every frequency QoS list with a changed effective constraint
+ * value are invoked once, after all of the requests have been updated.
+ *
+ * Return 1 if any effective constraint value has changed, 0 if none of them
+ * has changed, or a negative error code if any of the requests could not be
+ * updated, in which case the remaining ones are still updated.
+ */
+int freq_qos_update_requests(struct freq_qos_request **reqs,
+			     const s32 *new_values, unsigned int nr)
+{
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i < nr; i++) {
+		struct freq_qos_request *req = reqs[i];
+		int err;
+
+		if (!req || freq_qos_value_invalid(new_values[i]) ||
+		    WARN(!freq_qos_request_active(req),
+			 "%s() called for unknown object\n", __func__)) {
+			ret = -EINVAL;
+			continue;
+		}
+
+		if (req->pnode.prio == new_values[i])
+			continue;
+
+		err = __freq_qos_apply(req, PM_QOS_UPDATE_REQ, new_values[i], true);
+		if (err < 0)
+			ret = err;
+		else if (err > 0 && !ret)
+			ret = 1;
+	}
+
+	for (i = 0; i < nr; i++) {
+		if (reqs[i] && freq_qos_request_active(reqs[i]) &&
+		    !READ_ONCE(reqs[i]->qos->notify_delay_ms))
+			freq_qos_notify(reqs[i]->qos);
+	}
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(freq_qos_update_requests);
+
 /**
  * freq_qos_remove_request - Remove frequency QoS request from its list.
  * @req: Request to remove.
@@ -31,6 +31,7 @@
 #include <linux/compiler.h>
 #include <linux/ktime.h>
 #include <linux/set_memory.h>
+#include <linux/workqueue.h>
 
 #include <linux/uaccess.h>
 #include <asm/mmu_context.h>
@@ -139,6 +140,17 @@ void __init hibernate_image_size_init(void)
 	image_size = ((totalram_pages() * 2) / 5) * PAGE_SIZE;
 }
 
+/*
+ * If set, the image size is chosen before every hibernation from the figures
+ * of the previous one instead of image_size, which is only used as a fallback
+ * (tunable via /sys/power/image_size_auto).
+ */
+bool image_size_auto;
+
+/* Time it took to reclaim hib_reclaimed pages the last time that happened. */
+static u64 hib_reclaim_ns;
+static unsigned long hib_reclaimed;
+
 /*
  * List of PBEs needed for restoring the pages that were allocated before
  * the suspend and included in the suspend image, but have also been
@@ -222,15 +234,20 @@ unsigned long get_safe_page(gfp_t gfp_mask)
 	return (unsigned long)__get_safe_page(gfp_mask);
 }
 
+static void mark_image_page(struct page *page)
+{
+	swsusp_set_page_forbidden(page);
+	swsusp_set_page_free(page);
+}
+
 static struct page *alloc_image_page(gfp_t gfp_mask)
 {
 	struct page *page;
 
 	page = alloc_page(gfp_mask);
-	if (page) {
-		swsusp_set_page_forbidden(page);
-		swsusp_set_page_free(page);
-	}
+	if (page)
+		mark_image_page(page);
+
 	return page;
 }
 
@@ -583,15 +600,19 @@ static void free_zone_bm_rtree(struct mem_zone_bm_rtree *zone,
 		free_image_page(node->data, clear_nosave_free);
 }
 
+static void memory_bm_position_init(struct memory_bitmap *bm,
+				    struct bm_position *pos)
+{
+	pos->zone = list_entry(bm->zones.next, struct mem_zone_bm_rtree, list);
+	pos->node = list_entry(pos->zone->leaves.next, struct rtree_node, list);
+	pos->node_pfn = 0;
+	pos->cur_pfn = BM_END_OF_MAP;
+	pos->node_bit = 0;
+}
+
 static void memory_bm_position_reset(struct memory_bitmap *bm)
 {
-	bm->cur.zone = list_entry(bm->zones.next, struct mem_zone_bm_rtree,
-				  list);
-	bm->cur.node = list_entry(bm->cur.zone->leaves.next,
-				  struct rtree_node, list);
-	bm->cur.node_pfn = 0;
-	bm->cur.cur_pfn = BM_END_OF_MAP;
-	bm->cur.node_bit = 0;
+	memory_bm_position_init(bm, &bm->cur);
 }
 
 static void memory_bm_free(struct memory_bitmap *bm, int clear_nosave_free);
@@ -735,22 +756,26 @@ static void memory_bm_free(struct memory_bitmap *bm, int clear_nosave_free)
 }
 
 /**
- * memory_bm_find_bit - Find the bit for a given PFN in a memory bitmap.
+ * __memory_bm_find_bit - Find the bit for a given PFN in a memory bitmap.
  *
  * Find the bit in memory bitmap @bm that corresponds to the given PFN.
- * The cur.zone, cur.block and cur.node_pfn members of @bm are updated.
+ * The zone, node and node_pfn members of @cur are updated.
  *
  * Walk the radix tree to find the page containing the bit that represents @pfn
  * and return the position of the bit in @addr and @bit_nr.
+ *
+ * Using a position other than the one embedded in @bm allows the bitmap to be
+ * looked up by multiple threads at a time.
  */
-static int memory_bm_find_bit(struct memory_bitmap *bm, unsigned long pfn,
-			      void **addr, unsigned int *bit_nr)
+static int __memory_bm_find_bit(struct memory_bitmap *bm,
+				struct bm_position *cur, unsigned long pfn,
+				void **addr, unsigned int *bit_nr)
 {
 	struct mem_zone_bm_rtree *curr, *zone;
 	struct rtree_node *node;
 	int i, block_nr;
 
-	zone = bm->cur.zone;
+	zone = cur->zone;
 
 	if (pfn >= zone->start_pfn && pfn < zone->end_pfn)
 		goto zone_found;
@@ -779,9 +804,9 @@ static int memory_bm_find_bit(struct memory_bitmap *bm, unsigned long pfn,
 	 * pfn falls into the current node then we do not need to walk
 	 * the tree.
 	 */
-	node = bm->cur.node;
-	if (zone == bm->cur.zone &&
-	    ((pfn - zone->start_pfn) & ~BM_BLOCK_MASK) == bm->cur.node_pfn)
+	node = cur->node;
+	if (zone == cur->zone &&
+	    ((pfn - zone->start_pfn) & ~BM_BLOCK_MASK) == cur->node_pfn)
 		goto node_found;
 
 	node      = zone->rtree;
@@ -798,10 +823,10 @@ static int memory_bm_find_bit(struct memory_bitmap *bm, unsigned long pfn,
 
 node_found:
 	/* Update last position */
-	bm->cur.zone = zone;
-	bm->cur.node = node;
-	bm->cur.node_pfn = (pfn - zone->start_pfn) & ~BM_BLOCK_MASK;
-	bm->cur.cur_pfn = pfn;
+	cur->zone = zone;
+	cur->node = node;
+	cur->node_pfn = (pfn - zone->start_pfn) & ~BM_BLOCK_MASK;
+	cur->cur_pfn = pfn;
 
 	/* Set return values */
 	*addr = node->data;
@@ -810,28 +835,21 @@ static int memory_bm_find_bit(struct memory_bitmap *bm, unsigned long pfn,
 	return 0;
 }
 
-static void memory_bm_set_bit(struct memory_bitmap *bm, unsigned long pfn)
+static int memory_bm_find_bit(struct memory_bitmap *bm, unsigned long pfn,
+			      void **addr, unsigned int *bit_nr)
 {
-	void *addr;
-	unsigned int bit;
-	int error;
-
-	error = memory_bm_find_bit(bm, pfn, &addr, &bit);
-	BUG_ON(error);
-	set_bit(bit, addr);
+	return __memory_bm_find_bit(bm, &bm->cur, pfn, addr, bit_nr);
 }
 
-static int mem_bm_set_bit_check(struct memory_bitmap *bm, unsigned long pfn)
+static void memory_bm_set_bit(struct memory_bitmap *bm, unsigned long pfn)
 {
 	void *addr;
 	unsigned int bit;
 	int error;
 
 	error = memory_bm_find_bit(bm, pfn, &addr, &bit);
-	if (!error)
-		set_bit(bit, addr);
-
-	return error;
+	BUG_ON(error);
+	set_bit(bit, addr);
 }
 
 static void memory_bm_clear_bit(struct memory_bitmap *bm, unsigned long pfn)
@@ -946,6 +964,119 @@ static unsigned long memory_bm_next_pfn(struct memory_bitmap *bm)
 	return BM_END_OF_MAP;
 }
 
+/**
+ * memory_bm_next_run - Find the next run of set bits in a memory bitmap.
+ * @bm: Memory bitmap.
+ * @end_pfn: Return location for the PFN following the last one in the run.
+ *
+ * Starting from the last returned position, find the next set bit in @bm and
+ * the first clear one after it in the same bitmap block.  Return the PFN
+ * represented by the set bit or BM_END_OF_MAP if no more bits are set.
+ *
+ * Runs do not span bitmap blocks, so a range of set bits may be returned in
+ * multiple pieces.  As for memory_bm_next_pfn(), memory_bm_position_reset() is
+ * required to be run before the first call to this function.
+ */
+static unsigned long memory_bm_next_run(struct memory_bitmap *bm,
+					unsigned long *end_pfn)
+{
+	unsigned long bits, pfn, pages;
+	int bit, end;
+
+	do {
+		pages	  = bm->cur.zone->end_pfn - bm->cur.zone->start_pfn;
+		bits      = min(pages - bm->cur.node_pfn, BM_BITS_PER_BLOCK);
+		bit	  = find_next_bit(bm->cur.node->data, bits,
+					  bm->cur.node_bit);
+		if (bit < bits) {
+			end = find_next_zero_bit(bm->cur.node->data, bits,
+						 bit + 1);
+			pfn = bm->cur.zone->start_pfn + bm->cur.node_pfn + bit;
+			*end_pfn = pfn + end - bit;
+			bm->cur.node_bit = end;
+			bm->cur.cur_pfn = *end_pfn - 1;
+			return pfn;
+		}
+	} while (rtree_next_node(bm));
+
+	bm->cur.cur_pfn = BM_END_OF_MAP;
+	return BM_END_OF_MAP;
+}
+
+/*
+ * Set or clear @nr bits starting at @bit in @addr.  The words that are only
+ * partially covered are updated atomically, as they may be shared with bits
+ * updated by someone else, and the remaining ones are simply stored.
+ */
+static void bm_assign_bits(unsigned long *addr, unsigned long bit,
+			   unsigned long nr, bool value)
+{
+	unsigned long *p = addr + BIT_WORD(bit);
+	unsigned long mask;
+
+	while (nr) {
+		unsigned long offset = bit % BITS_PER_LONG;
+		unsigned long len = min(nr, BITS_PER_LONG - offset);
+
+		if (len == BITS_PER_LONG) {
+			WRITE_ONCE(*p, value ? ~0UL : 0UL);
+		} else {
+			mask = GENMASK(offset + len - 1, offset);
+			if (value)
+				set_mask_bits(p, 0UL, mask);
+			else
+				set_mask_bits(p, mask, 0UL);
+		}
+		bit += len;
+		nr -= len;
+		p++;
+	}
+}
+
+/**
+ * __memory_bm_assign_range - Set or clear a range of bits in a memory bitmap.
+ * @bm: Memory bitmap.
+ * @pos: Position to use for looking up @bm.
+ * @start_pfn: First PFN of the range.
+ * @end_pfn: PFN following the last one in the range.
+ * @value: Whether to set or to clear the bits.
+ *
+ * The parts of the range that are not covered by @bm are skipped.  Work at
+ * the bitmap block and word granularity instead of looking up every PFN.
+ */
+static void __memory_bm_assign_range(struct memory_bitmap *bm,
+				     struct bm_position *pos,
+				     unsigned long start_pfn,
+				     unsigned long end_pfn, bool value)
+{
+	struct mem_zone_bm_rtree *zone;
+
+	list_for_each_entry(zone, &bm->zones, list) {
+		unsigned long pfn = max(start_pfn, zone->start_pfn);
+		unsigned long end = min(end_pfn, zone->end_pfn);
+
+		while (pfn < end) {
+			unsigned int bit;
+			unsigned long nr;
+			void *addr;
+			int error;
+
+			error = __memory_bm_find_bit(bm, pos, pfn, &addr, &bit);
+			BUG_ON(error);
+			nr = min_t(unsigned long, end - pfn,
+				   BM_BITS_PER_BLOCK - bit);
+			bm_assign_bits(addr, bit, nr, value);
+			pfn += nr;
+		}
+	}
+}
+
+static void memory_bm_set_range(struct memory_bitmap *bm,
+				unsigned long start_pfn, unsigned long end_pfn)
+{
+	__memory_bm_assign_range(bm, &bm->cur, start_pfn, end_pfn, true);
+}
+
 /*
  * This structure represents a range of page frames the contents of which
  * should not be saved during hibernation.
@@ -1073,6 +1204,72 @@ static void swsusp_unset_page_forbidden(struct page *page)
 		memory_bm_clear_bit(forbidden_pages_map, page_to_pfn(page));
 }
 
+/*
+ * Private positions in free_pages_map and forbidden_pages_map used for
+ * scanning a zone, so that multiple zones can be scanned in parallel.
+ */
+struct zone_scan {
+	struct bm_position free;
+	struct bm_position forbidden;
+};
+
+static void zone_scan_init(struct zone_scan *scan)
+{
+	if (free_pages_map)
+		memory_bm_position_init(free_pages_map, &scan->free);
+	if (forbidden_pages_map)
+		memory_bm_position_init(forbidden_pages_map, &scan->forbidden);
+}
+
+static bool scan_test_bit(struct memory_bitmap *bm, struct bm_position *pos,
+			  unsigned long pfn)
+{
+	void *addr;
+	unsigned int bit;
+	int error;
+
+	if (!bm)
+		return false;
+
+	error = __memory_bm_find_bit(bm, pos, pfn, &addr, &bit);
+	BUG_ON(error);
+	return test_bit(bit, addr);
+}
+
+static bool scan_page_is_free(struct zone_scan *scan, unsigned long pfn)
+{
+	return scan_test_bit(free_pages_map, &scan->free, pfn);
+}
+
+static bool scan_page_is_forbidden(struct zone_scan *scan, unsigned long pfn)
+{
+	return scan_test_bit(forbidden_pages_map, &scan->forbidden, pfn);
+}
+
+static void scan_set_free_range(struct zone_scan *scan, unsigned long start_pfn,
+				unsigned long end_pfn)
+{
+	if (free_pages_map)
+		__memory_bm_assign_range(free_pages_map, &scan->free,
+					 start_pfn, end_pfn, true);
+}
+
+static void scan_assign_page_free(struct zone_scan *scan, unsigned long pfn,
+				  bool free)
+{
+	void *addr;
+	unsigned int bit;
+	int error;
+
+	if (!free_pages_map)
+		return;
+
+	error = __memory_bm_find_bit(free_pages_map, &scan->free, pfn, &addr,
+				     &bit);
+	BUG_ON(error);
+	assign_bit(bit, addr, free);
+}
+
 /**
  * mark_nosave_pages - Mark pages that should not be saved.
  * @bm: Memory bitmap.
@@ -1088,23 +1285,30 @@ static void mark_nosave_pages(struct memory_bitmap *bm)
 		return;
 
 	list_for_each_entry(region, &nosave_regions, list) {
-		unsigned long pfn;
+		unsigned long pfn, end;
 
 		pr_debug("Marking nosave pages: [mem %#010llx-%#010llx]\n",
 			 (unsigned long long) region->start_pfn << PAGE_SHIFT,
 			 ((unsigned long long) region->end_pfn << PAGE_SHIFT)
 				- 1);
 
-		for (pfn = region->start_pfn; pfn < region->end_pfn; pfn++)
-			if (pfn_valid(pfn)) {
-				/*
-				 * It is safe to ignore the result of
-				 * mem_bm_set_bit_check() here, since we won't
-				 * touch the PFNs for which the error is
-				 * returned anyway.
-				 */
-				mem_bm_set_bit_check(bm, pfn);
+		/*
+		 * Mark the runs of valid PFNs in the region.  The PFNs not
+		 * covered by the bitmap are skipped, which is fine, since we
+		 * won't touch them anyway.
+		 */
+		for (pfn = region->start_pfn; pfn < region->end_pfn; pfn = end) {
+			if (!pfn_valid(pfn)) {
+				end = pfn + 1;
+				continue;
 			}
+
+			for (end = pfn + 1; end < region->end_pfn; end++)
+				if (!pfn_valid(end))
+					break;
+
+			memory_bm_set_range(bm, pfn, end);
+		}
 	}
 }
 
@@ -1243,7 +1447,7 @@ unsigned int snapshot_additional_pages(struct zone *zone)
  */
 #define WD_PAGE_COUNT	(128*1024)
 
-static void mark_free_pages(struct zone *zone)
+static void mark_free_pages(struct zone *zone, struct zone_scan *scan)
 {
 	unsigned long pfn, max_zone_pfn, page_count = WD_PAGE_COUNT;
 	unsigned long flags;
@@ -1268,28 +1472,27 @@ static void mark_free_pages(struct zone *zone)
 			if (page_zone(page) != zone)
 				continue;
 
-			if (!swsusp_page_is_forbidden(page))
-				swsusp_unset_page_free(page);
+			if (!scan_page_is_forbidden(scan, pfn))
+				scan_assign_page_free(scan, pfn, false);
 		}
 
 	for_each_migratetype_order(order, t) {
 		list_for_each_entry(page,
 				&zone->free_area[order].free_list[t], buddy_list) {
-			unsigned long i;
-
 			pfn = page_to_pfn(page);
-			for (i = 0; i < (1UL << order); i++) {
-				if (!--page_count) {
-					touch_nmi_watchdog();
-					page_count = WD_PAGE_COUNT;
-				}
-				swsusp_set_page_free(pfn_to_page(pfn + i));
+			if (page_count <= (1UL << order)) {
+				touch_nmi_watchdog();
+				page_count = WD_PAGE_COUNT;
 			}
+			page_count -= 1UL << order;
+			scan_set_free_range(scan, pfn, pfn + (1UL << order));
 		}
 	}
 	spin_unlock_irqrestore(&zone->lock, flags);
 }
 
+static unsigned int count_zone_pages(struct zone *zone);
+
 #ifdef CONFIG_HIGHMEM
 /**
  * count_free_highmem_pages - Compute the total number of free highmem pages.
@@ -1316,7 +1519,8 @@ static unsigned int count_free_highmem_pages(void)
  * We should save the page if it isn't Nosave or NosaveFree, or Reserved,
  * and it isn't part of a free chunk of pages.
  */
-static struct page *saveable_highmem_page(struct zone *zone, unsigned long pfn)
+static struct page *saveable_highmem_page(struct zone *zone, unsigned long pfn,
+					  struct zone_scan *scan)
 {
 	struct page *page;
 
@@ -1329,7 +1533,7 @@ static struct page *saveable_highmem_page(struct zone *zone, unsigned long pfn)
 
 	BUG_ON(!PageHighMem(page));
 
-	if (swsusp_page_is_forbidden(page) ||  swsusp_page_is_free(page))
+	if (scan_page_is_forbidden(scan, pfn) || scan_page_is_free(scan, pfn))
 		return NULL;
 
 	if (PageReserved(page) || PageOffline(page))
@@ -1349,22 +1553,15 @@ static unsigned int count_highmem_pages(void)
 	struct zone *zone;
 	unsigned int n = 0;
 
-	for_each_populated_zone(zone) {
-		unsigned long pfn, max_zone_pfn;
-
-		if (!is_highmem(zone))
-			continue;
+	for_each_populated_zone(zone)
+		if (is_highmem(zone))
+			n += count_zone_pages(zone);
 
-		mark_free_pages(zone);
-		max_zone_pfn = zone_end_pfn(zone);
-		for (pfn = zone->zone_start_pfn; pfn < max_zone_pfn; pfn++)
-			if (saveable_highmem_page(zone, pfn))
-				n++;
-	}
 	return n;
 }
 #else
-static inline void *saveable_highmem_page(struct zone *z, unsigned long p)
+static inline void *saveable_highmem_page(struct zone *z, unsigned long p,
+					  struct zone_scan *scan)
 {
 	return NULL;
 }
@@ -1380,7 +1577,8 @@ static inline void *saveable_highmem_page(struct zone *z, unsigned long p)
  * of pages statically defined as 'unsaveable', and it isn't part of
  * a free chunk of pages.
  */
-static struct page *saveable_page(struct zone *zone, unsigned long pfn)
+static struct page *saveable_page(struct zone *zone, unsigned long pfn,
+				   struct zone_scan *scan)
 {
 	struct page *page;
 
@@ -1393,7 +1591,7 @@ static struct page *saveable_page(struct zone *zone, unsigned long pfn)
 
 	BUG_ON(PageHighMem(page));
 
-	if (swsusp_page_is_forbidden(page) || swsusp_page_is_free(page))
+	if (scan_page_is_forbidden(scan, pfn) || scan_page_is_free(scan, pfn))
 		return NULL;
 
 	if (PageOffline(page))
@@ -1415,19 +1613,77 @@ static struct page *saveable_page(struct zone *zone, unsigned long pfn)
 static unsigned int count_data_pages(void)
 {
 	struct zone *zone;
-	unsigned long pfn, max_zone_pfn;
 	unsigned int n = 0;
 
+	for_each_populated_zone(zone)
+		if (!is_highmem(zone))
+			n += count_zone_pages(zone);
+
+	return n;
+}
+
+struct zone_count_work {
+	struct work_struct work;
+	struct zone *zone;
+	unsigned int count;
+};
+
+static void zone_count_workfn(struct work_struct *work)
+{
+	struct zone_count_work *zcw;
+
+	zcw = container_of(work, struct zone_count_work, work);
+	zcw->count = count_zone_pages(zcw->zone);
+}
+
+/**
+ * count_saveable_pages - Compute the numbers of saveable pages in parallel.
+ * @nr_highmem: Return location for the number of saveable highmem pages.
+ *
+ * Do the same as count_data_pages() and count_highmem_pages(), but scan all
+ * of the zones in parallel, each of them on its own node.  This can only be
+ * used before the nonboot CPUs are taken offline.
+ *
+ * Return the number of saveable non-highmem pages.
+ */
+static unsigned long count_saveable_pages(unsigned long *nr_highmem)
+{
+	struct zone_count_work *works;
+	unsigned int nr_zones = 0, i;
+	unsigned long n = 0;
+	struct zone *zone;
+
+	for_each_populated_zone(zone)
+		nr_zones++;
+
+	works = kcalloc(nr_zones, sizeof(*works), GFP_KERNEL);
+	if (!works) {
+		*nr_highmem = count_highmem_pages();
+		return count_data_pages();
+	}
+
+	i = 0;
 	for_each_populated_zone(zone) {
-		if (is_highmem(zone))
-			continue;
+		if (i >= nr_zones)
+			break;
 
-		mark_free_pages(zone);
-		max_zone_pfn = zone_end_pfn(zone);
-		for (pfn = zone->zone_start_pfn; pfn < max_zone_pfn; pfn++)
-			if (saveable_page(zone, pfn))
-				n++;
+		INIT_WORK(&works[i].work, zone_count_workfn);
+		works[i].zone = zone;
+		queue_work_node(zone_to_nid(zone), system_unbound_wq,
+				&works[i].work);
+		i++;
+	}
+
+	*nr_highmem = 0;
+	while (i--) {
+		flush_work(&works[i].work);
+		if (is_highmem(works[i].zone))
+			*nr_highmem += works[i].count;
+		else
+			n += works[i].count;
 	}
+
+	kfree(works);
 	return n;
 }
 
@@ -1435,15 +1691,30 @@ static unsigned int count_data_pages(void)
  * This is needed, because copy_page and memcpy are not usable for copying
  * task structs. Returns true if the page was filled with only zeros,
  * otherwise false.
+ *
+ * The page is processed eight words at a time with independent loads, so the
+ * copy and the zero check are not serialized on a single accumulator.  Vector
+ * registers cannot be used here, as the FPU state is part of what is being
+ * saved.
  */
+#define COPY_PAGE_STRIDE	8
+
 static inline bool do_copy_page(long *dst, long *src)
 {
 	long z = 0;
 	int n;
 
-	for (n = PAGE_SIZE / sizeof(long); n; n--) {
-		z |= *src;
-		*dst++ = *src++;
+	BUILD_BUG_ON((PAGE_SIZE / sizeof(long)) % COPY_PAGE_STRIDE);
+
+	for (n = PAGE_SIZE / sizeof(long); n; n -= COPY_PAGE_STRIDE) {
+		long a0 = src[0], a1 = src[1], a2 = src[2], a3 = src[3];
+		long a4 = src[4], a5 = src[5], a6 = src[6], a7 = src[7];
+
+		z |= (a0 | a1 | a2 | a3) | (a4 | a5 | a6 | a7);
+		dst[0] = a0; dst[1] = a1; dst[2] = a2; dst[3] = a3;
+		dst[4] = a4; dst[5] = a5; dst[6] = a6; dst[7] = a7;
+		src += COPY_PAGE_STRIDE;
+		dst += COPY_PAGE_STRIDE;
 	}
 	return !z;
 }
@@ -1472,10 +1743,12 @@ static bool safe_copy_page(void *dst, struct page *s_page)
 }
 
 #ifdef CONFIG_HIGHMEM
-static inline struct page *page_is_saveable(struct zone *zone, unsigned long pfn)
+static inline struct page *page_is_saveable(struct zone *zone, unsigned long pfn,
+					    struct zone_scan *scan)
 {
 	return is_highmem(zone) ?
-		saveable_highmem_page(zone, pfn) : saveable_page(zone, pfn);
+		saveable_highmem_page(zone, pfn, scan) :
+		saveable_page(zone, pfn, scan);
 }
 
 static bool copy_data_page(unsigned long dst_pfn, unsigned long src_pfn)
@@ -1509,7 +1782,7 @@ static bool copy_data_page(unsigned long dst_pfn, unsigned long src_pfn)
 	return zeros_only;
 }
 #else
-#define page_is_saveable(zone, pfn)	saveable_page(zone, pfn)
+#define page_is_saveable(zone, pfn, scan)	saveable_page(zone, pfn, scan)
 
 static inline int copy_data_page(unsigned long dst_pfn, unsigned long src_pfn)
 {
@@ -1518,6 +1791,26 @@ static inline int copy_data_page(unsigned long dst_pfn, unsigned long src_pfn)
 }
 #endif /* CONFIG_HIGHMEM */
 
+/**
+ * count_zone_pages - Mark free pages and count saveable pages in a zone.
+ * @zone: Zone to scan.
+ */
+static unsigned int count_zone_pages(struct zone *zone)
+{
+	unsigned long pfn, max_zone_pfn;
+	struct zone_scan scan;
+	unsigned int n = 0;
+
+	zone_scan_init(&scan);
+	mark_free_pages(zone, &scan);
+	max_zone_pfn = zone_end_pfn(zone);
+	for (pfn = zone->zone_start_pfn; pfn < max_zone_pfn; pfn++)
+		if (page_is_saveable(zone, pfn, &scan))
+			n++;
+
+	return n;
+}
+
 /*
  * Copy data pages will copy all pages into pages pulled from the copy_bm.
  * If a page was entirely filled with zeros it will be marked in the zero_bm.
@@ -1529,16 +1822,18 @@ static unsigned long copy_data_pages(struct memory_bitmap *copy_bm,
 			    struct memory_bitmap *zero_bm)
 {
 	unsigned long copied_pages = 0;
+	struct zone_scan scan;
 	struct zone *zone;
 	unsigned long pfn, copy_pfn;
 
+	zone_scan_init(&scan);
 	for_each_populated_zone(zone) {
 		unsigned long max_zone_pfn;
 
-		mark_free_pages(zone);
+		mark_free_pages(zone, &scan);
 		max_zone_pfn = zone_end_pfn(zone);
 		for (pfn = zone->zone_start_pfn; pfn < max_zone_pfn; pfn++)
-			if (page_is_saveable(zone, pfn))
+			if (page_is_saveable(zone, pfn, &scan))
 				memory_bm_set_bit(orig_bm, pfn);
 	}
 	memory_bm_position_reset(orig_bm);
@@ -1645,30 +1940,46 @@ void swsusp_free(void)
 
 #define GFP_IMAGE	(GFP_KERNEL | __GFP_NOWARN)
 
+/* Number of pages to allocate at a time when preallocating the image. */
+#define PREALLOC_BATCH	64
+
 /**
  * preallocate_image_pages - Allocate a number of pages for hibernation image.
  * @nr_pages: Number of page frames to allocate.
  * @mask: GFP flags to use for the allocation.
  *
+ * The pages are taken from the bulk allocator in batches, which only falls
+ * back to a regular (possibly reclaiming) allocation of a single page when
+ * the per-CPU lists are empty.
+ *
  * Return value: Number of page frames actually allocated
  */
 static unsigned long preallocate_image_pages(unsigned long nr_pages, gfp_t mask)
 {
+	struct page *pages[PREALLOC_BATCH];
 	unsigned long nr_alloc = 0;
 
 	while (nr_pages > 0) {
-		struct page *page;
+		unsigned long nr = min_t(unsigned long, nr_pages, PREALLOC_BATCH);
+		unsigned long i;
 
-		page = alloc_image_page(mask);
-		if (!page)
+		memset(pages, 0, nr * sizeof(*pages));
+		nr = alloc_pages_bulk_array(mask, nr, pages);
+		if (!nr)
 			break;
-		memory_bm_set_bit(&copy_bm, page_to_pfn(page));
-		if (PageHighMem(page))
-			alloc_highmem++;
-		else
-			alloc_normal++;
-		nr_pages--;
-		nr_alloc++;
+
+		for (i = 0; i < nr; i++) {
+			struct page *page = pages[i];
+
+			mark_image_page(page);
+			memory_bm_set_bit(&copy_bm, page_to_pfn(page));
+			if (PageHighMem(page))
+				alloc_highmem++;
+			else
+				alloc_normal++;
+		}
+		nr_pages -= nr;
+		nr_alloc += nr;
 	}
 
 	return nr_alloc;
@@ -1730,9 +2041,9 @@ static inline unsigned long preallocate_highmem_fraction(unsigned long nr_pages,
  */
 static unsigned long free_unnecessary_pages(void)
 {
-	unsigned long save, to_free_normal, to_free_highmem, free;
+	unsigned long save, save_highmem, to_free_normal, to_free_highmem, free;
 
-	save = count_data_pages();
+	save = count_saveable_pages(&save_highmem);
 	if (alloc_normal >= save) {
 		to_free_normal = alloc_normal - save;
 		save = 0;
@@ -1740,7 +2051,7 @@ static unsigned long free_unnecessary_pages(void)
 		to_free_normal = 0;
 		save -= alloc_normal;
 	}
-	save += count_highmem_pages();
+	save += save_highmem;
 	if (alloc_highmem >= save) {
 		to_free_highmem = alloc_highmem - save;
 	} else {
@@ -1807,6 +2118,130 @@ static unsigned long minimum_image_size(unsigned long saveable)
 	return saveable <= size ? 0 : saveable - size;
 }
 
+static unsigned long hib_shrink_memory(unsigned long nr_pages)
+{
+	u64 start = ktime_get_ns();
+	unsigned long freed;
+
+	freed = shrink_all_memory(nr_pages);
+	if (freed) {
+		hib_reclaim_ns = ktime_get_ns() - start;
+		hib_reclaimed = freed;
+	}
+
+	return freed;
+}
+
+/**
+ * image_size_auto_pages - Compute the image size from the last hibernation.
+ * @saveable: Number of saveable pages in the system.
+ *
+ * Every page left in memory has to be saved and loaded, at the cost per page
+ * (compression included) seen in the last save and load.  Every page that is
+ * reclaimed instead costs the reclaim, at the last measured rate, and reading
+ * it back after resume, one uncompressed page at the device speed seen in the
+ * last load (which is optimistic for random reads, but not every dropped page
+ * is going to be used again).  Anonymous pages have to be written to swap as
+ * well.  All of the costs are linear in the number of pages, so the total time
+ * is the shortest if all of the pages of the kinds that are cheaper to drop
+ * than to keep are reclaimed, and none of the others.
+ *
+ * Return 0 if there are no figures to base the estimate on yet, including the
+ * reclaim rate, which is only measured once memory has had to be reclaimed.
+ */
+static unsigned long image_size_auto_pages(unsigned long saveable)
+{
+	const struct hib_bench_pass *save = &hib_bench.save;
+	const struct hib_bench_pass *load = &hib_bench.load;
+	unsigned long size = saveable, pages;
+	u64 keep, reclaim, refault, disk_bytes = 0;
+	unsigned int thr;
+
+	if (!save->pages || !load->pages || !hib_reclaimed)
+		return 0;
+
+	keep = div_u64(save->ns, save->pages) + div_u64(load->ns, load->pages);
+	reclaim = div64_u64(hib_reclaim_ns, hib_reclaimed);
+
+	for (thr = 0; thr < load->nr_threads; thr++)
+		disk_bytes += load->thread[thr].cmp_bytes;
+	if (!disk_bytes)
+		disk_bytes = (u64)load->pages * PAGE_SIZE;
+	refault = div64_u64(load->wait_ns * PAGE_SIZE, disk_bytes);
+
+	if (reclaim + refault < keep) {
+		pages = global_node_page_state(NR_ACTIVE_FILE) +
+			global_node_page_state(NR_INACTIVE_FILE);
+		size -= min(size, pages);
+	}
+	if (reclaim + 2 * refault < keep) {
+		pages = global_node_page_state(NR_ACTIVE_ANON) +
+			global_node_page_state(NR_INACTIVE_ANON);
+		size -= min(size, pages);
+	}
+
+	pr_debug("Auto image size: %lu of %lu pages (keep %llu ns, drop %llu ns)\n",
+		 size, saveable, keep, reclaim + refault);
+
+	return max(size, 1UL);
+}
+
+/* Return the preferred number of image pages. */
+static unsigned long image_size_pages(unsigned long saveable)
+{
+	unsigned long size;
+
+	if (image_size_auto) {
+		size = image_size_auto_pages(saveable);
+		if (size)
+			return size;
+	}
+
+	return DIV_ROUND_UP(image_size, PAGE_SIZE);
+}
+
+/**
+ * hibernate_prestage_memory - Reclaim memory before freezing tasks.
+ *
+ * Make the memory management subsystem free roughly as many page frames as
+ * hibernate_preallocate_memory() is going to need to shrink the image to
+ * image_size, but while user space is still running, so that less of that
+ * work is left for the time when the system is not available.  Pages that are
+ * dirtied or faulted in again are taken care of after freezing, as usual, so
+ * this only affects how long preallocation takes.
+ *
+ * The image bitmaps do not exist yet and an exact count would need a locked
+ * walk over all of the zones, so the number of saveable pages is estimated
+ * from the global counters of used pages.
+ */
+void hibernate_prestage_memory(void)
+{
+	unsigned long saveable, free, size;
+	ktime_t start, stop;
+
+	start = ktime_get();
+
+	saveable = totalram_pages();
+	free = global_zone_page_state(NR_FREE_PAGES);
+	if (saveable <= free)
+		return;
+
+	saveable -= free;
+	size = image_size_pages(saveable);
+	if (saveable <= size)
+		return;
+
+	size = max(size, minimum_image_size(saveable));
+	if (saveable <= size)
+		return;
+
+	pr_info("Pre-staging the image, reclaiming %lu pages\n", saveable - size);
+	size = hib_shrink_memory(saveable - size);
+
+	stop = ktime_get();
+	swsusp_show_speed(start, stop, size, "Pre-staged");
+}
+
 /**
  * hibernate_preallocate_memory - Preallocate memory for hibernation image.
  *
@@ -1863,8 +2298,7 @@ int hibernate_preallocate_memory(void)
 	nr_zero_pages = 0;
 
 	/* Count the number of saveable data pages. */
-	save_highmem = count_highmem_pages();
-	saveable = count_data_pages();
+	saveable = count_saveable_pages(&save_highmem);
 
 	/*
 	 * Compute the total number of page frames we can use (count) and the
@@ -1889,7 +2323,7 @@ int hibernate_preallocate_memory(void)
 	max_size = (count - (size + PAGES_FOR_IO)) / 2
 			- 2 * DIV_ROUND_UP(reserved_size, PAGE_SIZE);
 	/* Compute the desired number of image pages specified by image_size. */
-	size = DIV_ROUND_UP(image_size, PAGE_SIZE);
+	size = image_size_pages(saveable);
 	if (size > max_size)
 		size = max_size;
 	/*
@@ -1923,7 +2357,7 @@ int hibernate_preallocate_memory(void)
 	 * NOTE: If this is not done, performance will be hurt badly in some
 	 * test cases.
 	 */
-	shrink_all_memory(saveable - size);
+	hib_shrink_memory(saveable - size);
 
 	/*
 	 * The number of saveable pages in memory was too high, so apply some
@@ -2291,13 +2725,13 @@ int snapshot_read_next(struct snapshot_handle *handle)
 static void duplicate_memory_bitmap(struct memory_bitmap *dst,
 				    struct memory_bitmap *src)
 {
-	unsigned long pfn;
+	unsigned long pfn, end_pfn;
 
 	memory_bm_position_reset(src);
-	pfn = memory_bm_next_pfn(src);
+	pfn = memory_bm_next_run(src, &end_pfn);
 	while (pfn != BM_END_OF_MAP) {
-		memory_bm_set_bit(dst, pfn);
-		pfn = memory_bm_next_pfn(src);
+		memory_bm_set_range(dst, pfn, end_pfn);
+		pfn = memory_bm_next_run(src, &end_pfn);
 	}
 }
 
@@ -2309,14 +2743,20 @@ static void duplicate_memory_bitmap(struct memory_bitmap *dst,
  */
 static void mark_unsafe_pages(struct memory_bitmap *bm)
 {
-	unsigned long pfn;
+	unsigned long pfn, end_pfn;
+	struct bm_position pos;
 
-	/* Clear the "free"/"unsafe" bit for all PFNs */
+	/*
+	 * Clear the "free"/"unsafe" bit for all PFNs, using a separate position
+	 * for that to avoid disturbing the iteration.
+	 */
 	memory_bm_position_reset(free_pages_map);
-	pfn = memory_bm_next_pfn(free_pages_map);
+	memory_bm_position_init(free_pages_map, &pos);
+	pfn = memory_bm_next_run(free_pages_map, &end_pfn);
 	while (pfn != BM_END_OF_MAP) {
-		memory_bm_clear_current(free_pages_map);
-		pfn = memory_bm_next_pfn(free_pages_map);
+		__memory_bm_assign_range(free_pages_map, &pos, pfn, end_pfn,
+					 false);
+		pfn = memory_bm_next_run(free_pages_map, &end_pfn);
 	}
 
 	/* Mark pages that correspond to the "original" PFNs as "unsafe" */
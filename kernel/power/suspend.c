@@ -87,14 +87,110 @@ static void s2idle_begin(void)
 	s2idle_state = S2IDLE_STATE_NONE;
 }
 
+/*
+ * History of the last suspend-to-idle cycles, that is of the s2idle_enter()
+ * calls that have actually idled the CPUs, for diagnosing the residency and
+ * the wakeup sources of long suspend-to-idle periods.
+ */
+#define S2IDLE_HISTORY_SIZE	16
+
+struct s2idle_cycle {
+	u64 duration_us;	/* Time in s2idle_enter(), suspended time included */
+	u64 hw_sleep_us;	/* As reported by the platform, 0 if not */
+	unsigned int wake_irq;	/* pm_wakeup_irq() at the end of the cycle */
+	int min_state;		/* Shallowest cpuidle state entered by any CPU */
+	int max_state;		/* Deepest cpuidle state entered by any CPU */
+};
+
+static struct s2idle_cycle s2idle_history[S2IDLE_HISTORY_SIZE];
+static unsigned int s2idle_cycles;	/* Protected by s2idle_lock */
+static atomic_t s2idle_min_state, s2idle_max_state;
+
+/**
+ * s2idle_note_state - Record the idle state entered by a CPU in s2idle.
+ * @index: Index of the cpuidle state of the CPU that has been entered.
+ */
+void s2idle_note_state(int index)
+{
+	int old;
+
+	if (index < 0)
+		return;
+
+	old = atomic_read(&s2idle_min_state);
+	while (index < old && !atomic_try_cmpxchg(&s2idle_min_state, &old, index))
+		;
+
+	old = atomic_read(&s2idle_max_state);
+	while (index > old && !atomic_try_cmpxchg(&s2idle_max_state, &old, index))
+		;
+}
+
+static void s2idle_history_record(ktime_t start)
+{
+	struct s2idle_cycle *c = &s2idle_history[s2idle_cycles % S2IDLE_HISTORY_SIZE];
+	int min_state = atomic_read(&s2idle_min_state);
+
+	c->duration_us = ktime_us_delta(ktime_get_boottime(), start);
+	c->hw_sleep_us = 0;
+	c->wake_irq = pm_wakeup_irq();
+	c->min_state = min_state == INT_MAX ? -1 : min_state;
+	c->max_state = atomic_read(&s2idle_max_state);
+	s2idle_cycles++;
+}
+
+/* The platform reports the hardware sleep time after the last cycle. */
+void s2idle_history_hw_sleep(u64 t)
+{
+	unsigned long flags;
+
+	/* This may be called with interrupts off, by the platform code. */
+	raw_spin_lock_irqsave(&s2idle_lock, flags);
+	if (s2idle_cycles)
+		s2idle_history[(s2idle_cycles - 1) % S2IDLE_HISTORY_SIZE].hw_sleep_us = t;
+	raw_spin_unlock_irqrestore(&s2idle_lock, flags);
+}
+
+ssize_t s2idle_history_emit(char *buf)
+{
+	unsigned int i, first;
+	ssize_t len;
+
+	len = sysfs_emit(buf, "%-10s %12s %12s %8s %9s %9s\n", "cycle",
+			 "duration_us", "hw_sleep_us", "wake_irq", "min_state",
+			 "max_state");
+
+	raw_spin_lock_irq(&s2idle_lock);
+
+	first = s2idle_cycles > S2IDLE_HISTORY_SIZE ?
+		s2idle_cycles - S2IDLE_HISTORY_SIZE : 0;
+	for (i = first; i < s2idle_cycles; i++) {
+		struct s2idle_cycle *c = &s2idle_history[i % S2IDLE_HISTORY_SIZE];
+
+		len += sysfs_emit_at(buf, len, "%-10u %12llu %12llu %8u %9d %9d\n",
+				     i, c->duration_us, c->hw_sleep_us,
+				     c->wake_irq, c->min_state, c->max_state);
+	}
+
+	raw_spin_unlock_irq(&s2idle_lock);
+
+	return len;
+}
+
 static void s2idle_enter(void)
 {
+	ktime_t start;
+
 	trace_suspend_resume(TPS("machine_suspend"), PM_SUSPEND_TO_IDLE, true);
 
 	raw_spin_lock_irq(&s2idle_lock);
 	if (pm_wakeup_pending())
 		goto out;
 
+	atomic_set(&s2idle_min_state, INT_MAX);
+	atomic_set(&s2idle_max_state, -1);
+	start = ktime_get_boottime();
+
 	s2idle_state = S2IDLE_STATE_ENTER;
 	raw_spin_unlock_irq(&s2idle_lock);
 
@@ -110,6 +206,8 @@ static void s2idle_enter(void)
 
 	raw_spin_lock_irq(&s2idle_lock);
 
+	s2idle_history_record(start);
+
  out:
 	s2idle_state = S2IDLE_STATE_NONE;
 	raw_spin_unlock_irq(&s2idle_lock);
@@ -119,6 +217,8 @@ static void s2idle_enter(void)
 
 static void s2idle_loop(void)
 {
+	bool woken = false;
+
 	pm_pr_dbg("suspend-to-idle\n");
 
 	/*
@@ -138,10 +238,15 @@ static void s2idle_loop(void)
 			break;
 		}
 
+		/* The platform has found the last wakeup to be spurious. */
+		if (woken)
+			suspend_stats.s2idle_spurious++;
+
 		if (s2idle_ops && s2idle_ops->check)
 			s2idle_ops->check();
 
 		s2idle_enter();
+		woken = true;
 	}
 
 	pm_pr_dbg("resume from suspend-to-idle\n");
@@ -350,6 +455,7 @@ static int suspend_test(int level)
  */
 static int suspend_prepare(suspend_state_t state)
 {
+	ktime_t start;
 	int error;
 
 	if (!sleep_state_supported(state))
@@ -362,10 +468,13 @@ static int suspend_prepare(suspend_state_t state)
 		goto Restore;
 
 	trace_suspend_resume(TPS("freeze_processes"), 0, true);
+	start = ktime_get();
 	error = suspend_freeze_processes();
 	trace_suspend_resume(TPS("freeze_processes"), 0, false);
-	if (!error)
+	if (!error) {
+		pm_report_phase_time(SUSPEND_PHASE_FREEZE, start);
 		return 0;
+	}
 
 	suspend_stats.failed_freeze++;
 	dpm_save_failed_step(SUSPEND_FREEZE);
@@ -396,6 +505,8 @@ void __weak arch_suspend_enable_irqs(void)
  */
 static int suspend_enter(suspend_state_t state, bool *wakeup)
 {
+	bool entered = false;
+	ktime_t start;
 	int error;
 
 	error = platform_suspend_prepare(state);
@@ -416,6 +527,7 @@ static int suspend_enter(suspend_state_t state, bool *wakeup)
 		pr_err("noirq suspend of devices failed\n");
 		goto Platform_early_resume;
 	}
+	start = ktime_get();
 	error = platform_suspend_prepare_noirq(state);
 	if (error)
 		goto Platform_wake;
@@ -424,7 +536,10 @@ static int suspend_enter(suspend_state_t state, bool *wakeup)
 		goto Platform_wake;
 
 	if (state == PM_SUSPEND_TO_IDLE) {
+		pm_report_phase_time(SUSPEND_PHASE_PLATFORM_SUSPEND, start);
 		s2idle_loop();
+		start = ktime_get();
+		entered = true;
 		goto Platform_wake;
 	}
 
@@ -437,6 +552,13 @@ static int suspend_enter(suspend_state_t state, bool *wakeup)
 
 	system_state = SYSTEM_SUSPEND;
 
+	/*
+	 * Timekeeping is suspended between syscore_suspend() and
+	 * syscore_resume(), so the platform phases are timed outside of that
+	 * window.
+	 */
+	pm_report_phase_time(SUSPEND_PHASE_PLATFORM_SUSPEND, start);
+
 	error = syscore_suspend();
 	if (!error) {
 		*wakeup = pm_wakeup_pending();
@@ -444,12 +566,14 @@ static int suspend_enter(suspend_state_t state, bool *wakeup)
 			trace_suspend_resume(TPS("machine_suspend"),
 				state, true);
 			error = suspend_ops->enter(state);
+			entered = true;
 			trace_suspend_resume(TPS("machine_suspend"),
 				state, false);
 		} else if (*wakeup) {
 			error = -EBUSY;
 		}
 		syscore_resume();
+		start = ktime_get();
 	}
 
 	system_state = SYSTEM_RUNNING;
@@ -462,6 +586,8 @@ static int suspend_enter(suspend_state_t state, bool *wakeup)
 
  Platform_wake:
 	platform_resume_noirq(state);
+	if (entered)
+		pm_report_phase_time(SUSPEND_PHASE_PLATFORM_RESUME, start);
 	dpm_resume_noirq(PMSG_RESUME);
 
  Platform_early_resume:
@@ -537,7 +663,10 @@ int suspend_devices_and_enter(suspend_state_t state)
  */
 static void suspend_finish(void)
 {
+	ktime_t start = ktime_get();
+
 	suspend_thaw_processes();
+	pm_report_phase_time(SUSPEND_PHASE_THAW, start);
 	pm_notifier_call_chain(PM_POST_SUSPEND);
 	pm_restore_console();
 }
@@ -5,8 +5,16 @@
  * Copyright (c) 2009 Pavel Machek <pavel@ucw.cz>
  */
 
+#include <linux/debugfs.h>
 #include <linux/init.h>
+#include <linux/mutex.h>
 #include <linux/rtc.h>
+#include <linux/sched/signal.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
 
 #include "power.h"
 
@@ -125,7 +133,7 @@ static void __init test_wakealarm(struct rtc_device *rtc, suspend_state_t state)
 	rtc_set_alarm(rtc, &alm);
 }
 
-static int __init has_wakealarm(struct device *dev, const void *data)
+static int has_wakealarm(struct device *dev, const void *data)
 {
 	struct rtc_device *candidate = to_rtc_device(dev);
 
@@ -217,3 +225,418 @@ static int __init test_suspend(void)
 	return 0;
 }
 late_initcall(test_suspend);
+
+/*
+ * Suspend benchmark.
+ *
+ * Unlike the boot time test, this can be run at any time and as often as
+ * needed.  It carries out a number of back to back suspend/resume cycles of
+ * one state, each ended by an RTC wakealarm, and records the duration of every
+ * phase of every cycle along with the per-device callback times the PM core
+ * collects for the critical path.  The level set in /sys/power/pm_test
+ * applies, in which case the cycles end at the test point instead.
+ *
+ * It lives in debugfs under "suspend_bench": "state", "cycles" and
+ * "wakeup_secs" configure it, writing 1 to "run" carries it out and returns
+ * when it is done, and "results" has the distributions of the last run.
+ */
+
+#define SUSPEND_BENCH_MAX_CYCLES	10000
+#define SUSPEND_BENCH_DEVS		64
+#define SUSPEND_BENCH_DEV_MIN_US	100
+#define SUSPEND_BENCH_NAME_LEN		40
+/* All of the phases and the duration of the whole cycle */
+#define SUSPEND_BENCH_ROW		(SUSPEND_PHASE_NR + 1)
+#define SUSPEND_BENCH_NONE		U64_MAX
+
+struct suspend_bench_dev {
+	char name[SUSPEND_BENCH_NAME_LEN];
+	enum suspend_stat_phase phase;
+	unsigned int count;
+	u64 min_us;
+	u64 max_us;
+	u64 total_us;
+};
+
+static DEFINE_MUTEX(suspend_bench_mutex);
+static suspend_state_t suspend_bench_state = PM_SUSPEND_TO_IDLE;
+static u32 suspend_bench_cycles = 10;
+static u32 suspend_bench_wakeup_secs = 5;
+
+/* Results of the last run, protected by suspend_bench_mutex. */
+static u64 *suspend_bench_us;
+static struct suspend_bench_dev *suspend_bench_devs;
+static unsigned int suspend_bench_nr_devs;
+static unsigned int suspend_bench_done;
+static unsigned int suspend_bench_failed;
+static int suspend_bench_error;
+static suspend_state_t suspend_bench_ran_state;
+static int suspend_bench_ran_test;
+
+/* Row of the cycle in progress, the hooks below do nothing without one. */
+static u64 *suspend_bench_cur;
+
+void suspend_bench_report_phase(enum suspend_stat_phase phase, u64 us)
+{
+	u64 *row = READ_ONCE(suspend_bench_cur);
+
+	if (!row)
+		return;
+
+	if (row[phase] == SUSPEND_BENCH_NONE)
+		row[phase] = us;
+	else
+		row[phase] += us;
+}
+
+/*
+ * Called by the PM core for every device at the end of a phase, under
+ * dpm_list_mtx.  Only the slowest devices are kept once the table is full.
+ */
+void suspend_bench_report_dev(enum suspend_stat_phase phase, const char *name,
+			      u64 us)
+{
+	struct suspend_bench_dev *d, *fastest = NULL;
+	unsigned int i;
+
+	if (!READ_ONCE(suspend_bench_cur) || us < SUSPEND_BENCH_DEV_MIN_US)
+		return;
+
+	for (i = 0; i < suspend_bench_nr_devs; i++) {
+		d = &suspend_bench_devs[i];
+		if (d->phase == phase &&
+		    !strncmp(d->name, name, SUSPEND_BENCH_NAME_LEN - 1))
+			goto account;
+
+		if (!fastest || d->max_us < fastest->max_us)
+			fastest = d;
+	}
+
+	if (suspend_bench_nr_devs < SUSPEND_BENCH_DEVS)
+		d = &suspend_bench_devs[suspend_bench_nr_devs++];
+	else if (us > fastest->max_us)
+		d = fastest;
+	else
+		return;
+
+	strscpy(d->name, name, sizeof(d->name));
+	d->phase = phase;
+	d->count = 0;
+	d->min_us = U64_MAX;
+	d->max_us = 0;
+	d->total_us = 0;
+
+account:
+	d->count++;
+	d->min_us = min(d->min_us, us);
+	d->max_us = max(d->max_us, us);
+	d->total_us += us;
+}
+
+static int suspend_bench_set_alarm(struct rtc_device *rtc, bool enabled)
+{
+	struct rtc_wkalrm alm;
+	time64_t now;
+	int error;
+
+	error = rtc_read_time(rtc, &alm.time);
+	if (error)
+		return error;
+	now = rtc_tm_to_time64(&alm.time);
+
+	memset(&alm, 0, sizeof(alm));
+	rtc_time64_to_tm(now + suspend_bench_wakeup_secs, &alm.time);
+	alm.enabled = enabled;
+
+	return rtc_set_alarm(rtc, &alm);
+}
+
+static int suspend_bench_run(void)
+{
+	suspend_state_t state = suspend_bench_state;
+	u32 cycles = suspend_bench_cycles;
+	int test = pm_test_level;
+	struct rtc_device *rtc = NULL;
+	struct suspend_bench_dev *devs;
+	struct device *dev;
+	unsigned int i, j;
+	int error = 0;
+	u64 *us;
+
+	if (!cycles || cycles > SUSPEND_BENCH_MAX_CYCLES ||
+	    !suspend_bench_wakeup_secs)
+		return -EINVAL;
+
+	if (!pm_states[state])
+		return -ENODEV;
+
+	/* Only the test levels end a cycle without a wakeup source. */
+	if (test == TEST_NONE) {
+		dev = class_find_device(rtc_class, NULL, NULL, has_wakealarm);
+		if (dev) {
+			rtc = rtc_class_open(dev_name(dev));
+			put_device(dev);
+		}
+		if (!rtc) {
+			pr_info("PM: no wakealarm-capable RTC for the benchmark\n");
+			return -ENODEV;
+		}
+	}
+
+	us = kvmalloc_array(cycles, SUSPEND_BENCH_ROW * sizeof(*us), GFP_KERNEL);
+	devs = kcalloc(SUSPEND_BENCH_DEVS, sizeof(*devs), GFP_KERNEL);
+	if (!us || !devs) {
+		kvfree(us);
+		kfree(devs);
+		error = -ENOMEM;
+		goto out;
+	}
+
+	kvfree(suspend_bench_us);
+	kfree(suspend_bench_devs);
+	suspend_bench_us = us;
+	suspend_bench_devs = devs;
+	suspend_bench_nr_devs = 0;
+	suspend_bench_done = 0;
+	suspend_bench_failed = 0;
+	suspend_bench_error = 0;
+	suspend_bench_ran_state = state;
+	suspend_bench_ran_test = test;
+
+	pr_info("PM: benchmarking %u '%s' suspend cycles\n", cycles,
+		pm_labels[state]);
+
+	for (i = 0; i < cycles; i++) {
+		u64 *row = &us[i * SUSPEND_BENCH_ROW];
+		ktime_t start;
+		int ret;
+
+		for (j = 0; j < SUSPEND_BENCH_ROW; j++)
+			row[j] = SUSPEND_BENCH_NONE;
+
+		if (rtc) {
+			error = suspend_bench_set_alarm(rtc, true);
+			if (error)
+				break;
+		}
+
+		WRITE_ONCE(suspend_bench_cur, row);
+		start = ktime_get();
+		ret = pm_suspend(state);
+		row[SUSPEND_PHASE_NR] = ktime_us_delta(ktime_get(), start);
+		WRITE_ONCE(suspend_bench_cur, NULL);
+
+		suspend_bench_done++;
+		if (ret) {
+			suspend_bench_failed++;
+			suspend_bench_error = ret;
+		}
+
+		if (fatal_signal_pending(current)) {
+			error = -EINTR;
+			break;
+		}
+	}
+
+	pr_info("PM: suspend benchmark done, %u of %u cycles failed\n",
+		suspend_bench_failed, suspend_bench_done);
+
+out:
+	if (rtc) {
+		/* Cope with RTCs that don't disable the alarm after it fired. */
+		suspend_bench_set_alarm(rtc, false);
+		rtc_class_close(rtc);
+	}
+	return error;
+}
+
+static int suspend_bench_cmp_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int suspend_bench_cmp_dev(const void *a, const void *b)
+{
+	const struct suspend_bench_dev *x = a, *y = b;
+
+	return (x->max_us < y->max_us) - (x->max_us > y->max_us);
+}
+
+static void suspend_bench_show_phase(struct seq_file *s, const char *name,
+				     unsigned int col, u64 *v)
+{
+	unsigned int i, n = 0;
+	u64 total = 0;
+
+	for (i = 0; i < suspend_bench_done; i++) {
+		u64 t = suspend_bench_us[i * SUSPEND_BENCH_ROW + col];
+
+		if (t == SUSPEND_BENCH_NONE)
+			continue;
+
+		v[n++] = t;
+		total += t;
+	}
+	if (!n)
+		return;
+
+	sort(v, n, sizeof(*v), suspend_bench_cmp_u64, NULL);
+
+	seq_printf(s, "%-16s %6u %10llu %10llu %10llu %10llu %10llu %10llu\n",
+		   name, n, v[0], v[n * 50 / 100], v[n * 90 / 100],
+		   v[n * 99 / 100], v[n - 1], div_u64(total, n));
+}
+
+static int suspend_bench_results_show(struct seq_file *s, void *unused)
+{
+	enum suspend_stat_phase phase;
+	unsigned int i;
+	u64 *v;
+
+	if (mutex_lock_interruptible(&suspend_bench_mutex))
+		return -EINTR;
+
+	if (!suspend_bench_us || !suspend_bench_done)
+		goto out;
+
+	v = kvmalloc_array(suspend_bench_done, sizeof(*v), GFP_KERNEL);
+	if (!v) {
+		mutex_unlock(&suspend_bench_mutex);
+		return -ENOMEM;
+	}
+
+	seq_printf(s, "state: %s\npm_test: %s\ncycles: %u\nfailed: %u\n"
+		   "last_error: %d\n\n", pm_labels[suspend_bench_ran_state],
+		   pm_tests[suspend_bench_ran_test], suspend_bench_done,
+		   suspend_bench_failed, suspend_bench_error);
+
+	seq_printf(s, "%-16s %6s %10s %10s %10s %10s %10s %10s\n", "phase",
+		   "runs", "min_us", "p50_us", "p90_us", "p99_us", "max_us",
+		   "avg_us");
+	for (phase = 0; phase < SUSPEND_PHASE_NR; phase++)
+		suspend_bench_show_phase(s, suspend_phase_names[phase], phase, v);
+	suspend_bench_show_phase(s, "total", SUSPEND_PHASE_NR, v);
+
+	kvfree(v);
+
+	if (!suspend_bench_nr_devs)
+		goto out;
+
+	sort(suspend_bench_devs, suspend_bench_nr_devs,
+	     sizeof(*suspend_bench_devs), suspend_bench_cmp_dev, NULL);
+
+	seq_printf(s, "\n%-16s %6s %10s %10s %10s  %s\n", "phase", "runs",
+		   "min_us", "max_us", "avg_us", "device");
+	for (i = 0; i < suspend_bench_nr_devs; i++) {
+		struct suspend_bench_dev *d = &suspend_bench_devs[i];
+
+		seq_printf(s, "%-16s %6u %10llu %10llu %10llu  %s\n",
+			   suspend_phase_names[d->phase], d->count, d->min_us,
+			   d->max_us, div_u64(d->total_us, d->count), d->name);
+	}
+
+out:
+	mutex_unlock(&suspend_bench_mutex);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(suspend_bench_results);
+
+static int suspend_bench_state_show(struct seq_file *s, void *unused)
+{
+	suspend_state_t state;
+
+	for (state = PM_SUSPEND_MIN; state < PM_SUSPEND_MAX; state++) {
+		bool cur = state == READ_ONCE(suspend_bench_state);
+
+		if (pm_states[state])
+			seq_printf(s, "%s%s%s ", cur ? "[" : "",
+				   pm_labels[state], cur ? "]" : "");
+	}
+	seq_putc(s, '\n');
+
+	return 0;
+}
+
+static int suspend_bench_state_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, suspend_bench_state_show, NULL);
+}
+
+static ssize_t suspend_bench_state_write(struct file *file,
+					 const char __user *ubuf, size_t len,
+					 loff_t *ppos)
+{
+	suspend_state_t state;
+	char buf[16];
+
+	if (len >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, len))
+		return -EFAULT;
+	buf[len] = '\0';
+
+	for (state = PM_SUSPEND_MIN; state < PM_SUSPEND_MAX; state++) {
+		if (!pm_states[state] || !sysfs_streq(buf, pm_labels[state]))
+			continue;
+
+		if (mutex_lock_interruptible(&suspend_bench_mutex))
+			return -EINTR;
+		WRITE_ONCE(suspend_bench_state, state);
+		mutex_unlock(&suspend_bench_mutex);
+		return len;
+	}
+
+	return -EINVAL;
+}
+
+static const struct file_operations suspend_bench_state_fops = {
+	.open		= suspend_bench_state_open,
+	.read		= seq_read,
+	.write		= suspend_bench_state_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static ssize_t suspend_bench_run_write(struct file *file,
+				       const char __user *ubuf, size_t len,
+				       loff_t *ppos)
+{
+	bool run;
+	int error;
+
+	error = kstrtobool_from_user(ubuf, len, &run);
+	if (error)
+		return error;
+	if (!run)
+		return len;
+
+	if (mutex_lock_interruptible(&suspend_bench_mutex))
+		return -EINTR;
+	error = suspend_bench_run();
+	mutex_unlock(&suspend_bench_mutex);
+
+	return error ?: len;
+}
+
+static const struct file_operations suspend_bench_run_fops = {
+	.write		= suspend_bench_run_write,
+	.llseek		= noop_llseek,
+};
+
+static int __init suspend_bench_debugfs_init(void)
+{
+	struct dentry *dir = debugfs_create_dir("suspend_bench", NULL);
+
+	debugfs_create_file("state", 0644, dir, NULL,
+			    &suspend_bench_state_fops);
+	debugfs_create_u32("cycles", 0644, dir, &suspend_bench_cycles);
+	debugfs_create_u32("wakeup_secs", 0644, dir,
+			   &suspend_bench_wakeup_secs);
+	debugfs_create_file("run", 0200, dir, NULL, &suspend_bench_run_fops);
+	debugfs_create_file("results", 0444, dir, NULL,
+			    &suspend_bench_results_fops);
+	return 0;
+}
+late_initcall(suspend_bench_debugfs_init);
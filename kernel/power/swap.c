@@ -23,13 +23,13 @@
 #include <linux/swapops.h>
 #include <linux/pm.h>
 #include <linux/slab.h>
-#include <linux/lzo.h>
 #include <linux/vmalloc.h>
 #include <linux/cpumask.h>
 #include <linux/atomic.h>
 #include <linux/kthread.h>
 #include <linux/crc32.h>
 #include <linux/ktime.h>
+#include <crypto/hash.h>
 
 #include "power.h"
 
@@ -104,8 +104,12 @@ struct swap_map_handle {
 };
 
 struct swsusp_header {
-	char reserved[PAGE_SIZE - 20 - sizeof(sector_t) - sizeof(int) -
-	              sizeof(u32) - sizeof(u32)];
+	char reserved[PAGE_SIZE - 20 - sizeof(u64) - sizeof(u32) -
+	              CRYPTO_MAX_ALG_NAME - sizeof(sector_t) -
+	              sizeof(int) - sizeof(u32) - sizeof(u32)];
+	u64	save_ns;	/* Time it took to save the image data */
+	u32	save_pages;
+	char	comp_alg[CRYPTO_MAX_ALG_NAME];	/* Valid with SF_COMP_ALG */
 	u32	hw_sig;
 	u32	crc32;
 	sector_t image;
@@ -224,30 +228,82 @@ int swsusp_swap_in_use(void)
 static unsigned short root_swap = 0xffff;
 static struct block_device *hib_resume_bdev;
 
+/* Maximum number of pages to merge into one bio. */
+#define HIB_BIO_MAX_PAGES	BIO_MAX_VECS
+
+/*
+ * Maximum number of bios in flight for one batch, 0 means no limit other than
+ * the amount of memory available for the pages under I/O.
+ */
+unsigned int hibernate_io_depth;
+
 struct hib_bio_batch {
 	atomic_t		count;
 	wait_queue_head_t	wait;
 	blk_status_t		error;
 	struct blk_plug		plug;
+	struct bio		*bio;	/* Being filled, not submitted yet */
 };
 
+/* Image I/O pass that is being measured, if any. */
+static struct hib_bench_pass *hib_bench_io;
+
+static void hib_bench_start(struct hib_bench_pass *b)
+{
+	memset(b, 0, sizeof(*b));
+	hib_bench_io = b;
+}
+
+static void hib_bench_comp_alg(void)
+{
+	if (hib_bench_io)
+		strscpy(hib_bench_io->comp_alg, hib_comp_algo,
+			sizeof(hib_bench_io->comp_alg));
+}
+
+static void hib_bench_pass_done(ktime_t start, ktime_t stop,
+				unsigned int nr_pages)
+{
+	if (!hib_bench_io)
+		return;
+
+	hib_bench_io->ns = ktime_to_ns(ktime_sub(stop, start));
+	hib_bench_io->pages = nr_pages;
+}
+
+static void hib_bench_thread_done(unsigned int thr,
+				  const struct hib_bench_thread *t)
+{
+	if (!hib_bench_io || thr >= HIB_BENCH_THREADS)
+		return;
+
+	hib_bench_io->thread[thr] = *t;
+	hib_bench_io->nr_threads = max(hib_bench_io->nr_threads, thr + 1);
+}
+
 static void hib_init_batch(struct hib_bio_batch *hb)
 {
 	atomic_set(&hb->count, 0);
 	init_waitqueue_head(&hb->wait);
 	hb->error = BLK_STS_OK;
+	hb->bio = NULL;
 	blk_start_plug(&hb->plug);
 }
 
+static int hib_wait_io(struct hib_bio_batch *hb);
+
 static void hib_finish_batch(struct hib_bio_batch *hb)
 {
+	/* Don't let the caller free pages that may still be under I/O. */
+	hib_wait_io(hb);
 	blk_finish_plug(&hb->plug);
 }
 
 static void hib_end_io(struct bio *bio)
 {
 	struct hib_bio_batch *hb = bio->bi_private;
-	struct page *page = bio_first_page_all(bio);
+	struct bvec_iter_all iter_all;
+	struct bio_vec *bvec;
 
 	if (bio->bi_status) {
 		pr_alert("Read-error on swap-device (%u:%u:%Lu)\n",
@@ -255,29 +311,81 @@ static void hib_end_io(struct bio *bio)
 			 (unsigned long long)bio->bi_iter.bi_sector);
 	}
 
-	if (bio_data_dir(bio) == WRITE)
-		put_page(page);
-	else if (clean_pages_on_read)
-		flush_icache_range((unsigned long)page_address(page),
-				   (unsigned long)page_address(page) + PAGE_SIZE);
+	bio_for_each_segment_all(bvec, bio, iter_all) {
+		struct page *page = bvec->bv_page;
+
+		if (bio_data_dir(bio) == WRITE)
+			put_page(page);
+		else if (clean_pages_on_read)
+			flush_icache_range((unsigned long)page_address(page),
+					   (unsigned long)page_address(page) + PAGE_SIZE);
+	}
 
 	if (bio->bi_status && !hb->error)
 		hb->error = bio->bi_status;
-	if (atomic_dec_and_test(&hb->count))
-		wake_up(&hb->wait);
+	/* Wake up both hib_wait_io() and hib_submit_batch_bio() waiters. */
+	atomic_dec(&hb->count);
+	wake_up(&hb->wait);
 
 	bio_put(bio);
 }
 
+/**
+ * hib_submit_batch_bio - Submit the bio being filled for a batch.
+ * @hb: Batch to submit the bio for.
+ *
+ * If the number of bios in flight is limited, wait for some of them to
+ * complete first.
+ */
+static void hib_submit_batch_bio(struct hib_bio_batch *hb)
+{
+	unsigned int depth = READ_ONCE(hibernate_io_depth);
+	struct bio *bio = hb->bio;
+	u64 start, now;
+
+	if (!bio)
+		return;
+
+	hb->bio = NULL;
+	start = ktime_get_ns();
+	if (depth)
+		wait_event(hb->wait, atomic_read(&hb->count) < depth);
+	now = ktime_get_ns();
+
+	atomic_inc(&hb->count);
+	submit_bio(bio);
+
+	if (hib_bench_io) {
+		hib_bench_io->wait_ns += now - start;
+		hib_bench_io->submit_ns += ktime_get_ns() - now;
+		hib_bench_io->bios++;
+	}
+}
+
 static int hib_submit_io(blk_opf_t opf, pgoff_t page_off, void *addr,
 			 struct hib_bio_batch *hb)
 {
+	sector_t sector = page_off * (PAGE_SIZE >> 9);
 	struct page *page = virt_to_page(addr);
 	struct bio *bio;
 	int error = 0;
 
-	bio = bio_alloc(hib_resume_bdev, 1, opf, GFP_NOIO | __GFP_HIGH);
-	bio->bi_iter.bi_sector = page_off * (PAGE_SIZE >> 9);
+	/*
+	 * Swap pages are mostly allocated in order, so try to merge the page
+	 * into the bio being filled before starting a new one.
+	 */
+	if (hb && hb->bio) {
+		bio = hb->bio;
+		if (bio->bi_opf == opf && bio_end_sector(bio) == sector &&
+		    bio_add_page(bio, page, PAGE_SIZE, 0) == PAGE_SIZE)
+			return 0;
+
+		hib_submit_batch_bio(hb);
+	}
+
+	bio = bio_alloc(hib_resume_bdev, hb ? HIB_BIO_MAX_PAGES : 1, opf,
+			GFP_NOIO | __GFP_HIGH);
+	bio->bi_iter.bi_sector = sector;
 
 	if (bio_add_page(bio, page, PAGE_SIZE, 0) < PAGE_SIZE) {
 		pr_err("Adding page to bio failed at %llu\n",
@@ -289,11 +397,17 @@ static int hib_submit_io(blk_opf_t opf, pgoff_t page_off, void *addr,
 	if (hb) {
 		bio->bi_end_io = hib_end_io;
 		bio->bi_private = hb;
-		atomic_inc(&hb->count);
-		submit_bio(bio);
+		hb->bio = bio;
 	} else {
+		u64 start = ktime_get_ns();
+
 		error = submit_bio_wait(bio);
 		bio_put(bio);
+
+		if (hib_bench_io) {
+			hib_bench_io->wait_ns += ktime_get_ns() - start;
+			hib_bench_io->bios++;
+		}
 	}
 
 	return error;
@@ -301,11 +415,18 @@ static int hib_submit_io(blk_opf_t opf, pgoff_t page_off, void *addr,
 
 static int hib_wait_io(struct hib_bio_batch *hb)
 {
+	u64 start;
+
+	hib_submit_batch_bio(hb);
 	/*
 	 * We are relying on the behavior of blk_plug that a thread with
 	 * a plug will flush the plug list before sleeping.
 	 */
+	start = ktime_get_ns();
 	wait_event(hb->wait, atomic_read(&hb->count) == 0);
+	if (hib_bench_io)
+		hib_bench_io->wait_ns += ktime_get_ns() - start;
+
 	return blk_status_to_errno(hb->error);
 }
 
@@ -326,9 +447,16 @@ static int mark_swapfiles(struct swap_map_handle *handle, unsigned int flags)
 			swsusp_header->hw_sig = swsusp_hardware_signature;
 			flags |= SF_HW_SIG;
 		}
+		if (!(flags & SF_NOCOMPRESS_MODE)) {
+			strscpy(swsusp_header->comp_alg, hib_comp_algo,
+				sizeof(swsusp_header->comp_alg));
+			flags |= SF_COMP_ALG;
+		}
 		swsusp_header->flags = flags;
 		if (flags & SF_CRC32_MODE)
 			swsusp_header->crc32 = handle->crc32;
+		swsusp_header->save_ns = hib_bench.save.ns;
+		swsusp_header->save_pages = hib_bench.save.pages;
 		error = hib_submit_io(REQ_OP_WRITE | REQ_SYNC,
 				      swsusp_resume_block, swsusp_header, NULL);
 	} else {
@@ -514,23 +642,39 @@ static int swap_writer_finish(struct swap_map_handle *handle,
 }
 
 /* We need to remember how much compressed data we need to read. */
-#define LZO_HEADER	sizeof(size_t)
+#define CMP_HEADER	sizeof(size_t)
 
 /* Number of pages/bytes we'll compress at one time. */
-#define LZO_UNC_PAGES	32
-#define LZO_UNC_SIZE	(LZO_UNC_PAGES * PAGE_SIZE)
+#define UNC_PAGES	32
+#define UNC_SIZE	(UNC_PAGES * PAGE_SIZE)
+
+/*
+ * Worst case compressed size of @x bytes of data.  This covers LZO, which is
+ * the worst of the supported algorithms (LZ4 and zstd need less than that).
+ */
+#define bytes_worst_compress(x)	((x) + ((x) / 16) + 64 + 3 + 2)
 
 /* Number of pages/bytes we need for compressed data (worst case). */
-#define LZO_CMP_PAGES	DIV_ROUND_UP(lzo1x_worst_compress(LZO_UNC_SIZE) + \
-			             LZO_HEADER, PAGE_SIZE)
-#define LZO_CMP_SIZE	(LZO_CMP_PAGES * PAGE_SIZE)
+#define CMP_PAGES	DIV_ROUND_UP(bytes_worst_compress(UNC_SIZE) + \
+			             CMP_HEADER, PAGE_SIZE)
+#define CMP_SIZE	(CMP_PAGES * PAGE_SIZE)
 
-/* Maximum number of threads for compression/decompression. */
-#define LZO_THREADS	3
+/*
+ * Maximum number of threads for compression/decompression used by default.
+ * Each of them needs about 300 KB of buffers.
+ */
+#define CMP_THREADS	16
+
+/*
+ * Number of compression/decompression threads requested by the user.  If 0,
+ * it is derived from the number of online CPUs, but capped at CMP_THREADS to
+ * limit the memory footprint.
+ */
+unsigned int hibernate_compression_threads;
 
 /* Minimum/maximum number of pages for read buffering. */
-#define LZO_MIN_RD_PAGES	1024
-#define LZO_MAX_RD_PAGES	8192
+#define CMP_MIN_RD_PAGES	1024
+#define CMP_MAX_RD_PAGES	8192
 
 
 /**
@@ -578,53 +722,106 @@ static int save_image(struct swap_map_handle *handle,
 	if (!ret)
 		pr_info("Image saving done\n");
 	swsusp_show_speed(start, stop, nr_to_write, "Wrote");
+	hib_bench_pass_done(start, stop, nr_to_write);
 	return ret;
 }
 
 /*
- * Structure used for CRC32.
+ * The CRC32 of the image is computed by the compression and decompression
+ * threads, each over its own chunk with a zero seed, and the results are
+ * combined in image order with crc32_le_combine().  The crypto API is used
+ * so that an accelerated implementation is picked when there is one.
  */
-struct crc_data {
-	struct task_struct *thr;                  /* thread */
-	atomic_t ready;                           /* ready to start flag */
-	atomic_t stop;                            /* ready to stop flag */
-	unsigned run_threads;                     /* nr current threads */
-	wait_queue_head_t go;                     /* start crc update */
-	wait_queue_head_t done;                   /* crc update done */
-	u32 *crc32;                               /* points to handle's crc32 */
-	size_t *unc_len[LZO_THREADS];             /* uncompressed lengths */
-	unsigned char *unc[LZO_THREADS];          /* uncompressed data */
-};
+static struct crypto_shash *hib_crc32_alloc(void)
+{
+	struct crypto_shash *tfm;
 
-/*
- * CRC32 update function that runs in its own thread.
- */
-static int crc32_threadfn(void *data)
+	tfm = crypto_alloc_shash("crc32", 0, 0);
+	if (IS_ERR(tfm)) {
+		pr_debug("Using the library CRC32\n");
+		return NULL;
+	}
+
+	return tfm;
+}
+
+static u32 hib_crc32(struct crypto_shash *tfm, const void *buf, size_t len)
 {
-	struct crc_data *d = data;
-	unsigned i;
+	__le32 crc;
 
-	while (1) {
-		wait_event(d->go, atomic_read(&d->ready) ||
-		                  kthread_should_stop());
-		if (kthread_should_stop()) {
-			d->thr = NULL;
-			atomic_set(&d->stop, 1);
-			wake_up(&d->done);
-			break;
-		}
-		atomic_set(&d->ready, 0);
+	if (tfm) {
+		SHASH_DESC_ON_STACK(desc, tfm);
 
-		for (i = 0; i < d->run_threads; i++)
-			*d->crc32 = crc32_le(*d->crc32,
-			                     d->unc[i], *d->unc_len[i]);
-		atomic_set(&d->stop, 1);
-		wake_up(&d->done);
+		desc->tfm = tfm;
+		if (!crypto_shash_digest(desc, buf, len, (u8 *)&crc))
+			return le32_to_cpu(crc);
 	}
+
+	return crc32_le(0, buf, len);
+}
+
+/**
+ * hib_nr_threads - Get the number of image compression/decompression threads.
+ */
+static unsigned int hib_nr_threads(void)
+{
+	unsigned int nr_threads = READ_ONCE(hibernate_compression_threads);
+
+	if (!nr_threads)
+		return clamp_val(num_online_cpus() - 1, 1, CMP_THREADS);
+
+	return clamp_val(nr_threads, 1, num_online_cpus());
+}
+
+/**
+ * hib_thread_cpu - Pick a CPU to run compression/decompression thread on.
+ * @thr: Thread number.
+ * @nr_threads: Total number of threads.
+ *
+ * Spread the threads evenly over the online CPUs, so that they end up on all
+ * of the NUMA nodes in the system and their buffers can be allocated from
+ * local memory.
+ */
+static unsigned int hib_thread_cpu(unsigned int thr, unsigned int nr_threads)
+{
+	unsigned int cpu;
+
+	cpu = cpumask_nth(thr * num_online_cpus() / nr_threads,
+			  cpu_online_mask);
+	if (cpu >= nr_cpu_ids)
+		cpu = raw_smp_processor_id();
+
+	return cpu;
+}
+
+/**
+ * hib_thread_start - Start a compression/decompression thread.
+ * @thr: Location to store the new thread's task pointer in.
+ * @threadfn: Thread function.
+ * @data: Thread data, allocated on the node of @cpu.
+ * @cpu: CPU whose node the thread should be run on.
+ * @name: Thread name prefix.
+ * @nr: Thread number.
+ */
+static int hib_thread_start(struct task_struct **thr,
+			    int (*threadfn)(void *data), void *data,
+			    unsigned int cpu, const char *name, unsigned int nr)
+{
+	int node = cpu_to_node(cpu);
+	struct task_struct *t;
+
+	t = kthread_create_on_node(threadfn, data, node, "%s/%u", name, nr);
+	if (IS_ERR(t))
+		return PTR_ERR(t);
+
+	set_cpus_allowed_ptr(t, cpumask_of_node(node));
+	*thr = t;
+	wake_up_process(t);
 	return 0;
 }
+
 /*
- * Structure used for LZO data compression.
+ * Structure used for data compression.
  */
 struct cmp_data {
 	struct task_struct *thr;                  /* thread */
@@ -635,17 +832,22 @@ struct cmp_data {
 	wait_queue_head_t done;                   /* compression done */
 	size_t unc_len;                           /* uncompressed length */
 	size_t cmp_len;                           /* compressed length */
-	unsigned char unc[LZO_UNC_SIZE];          /* uncompressed buffer */
-	unsigned char cmp[LZO_CMP_SIZE];          /* compressed buffer */
-	unsigned char wrk[LZO1X_1_MEM_COMPRESS];  /* compression workspace */
+	unsigned char unc[UNC_SIZE];              /* uncompressed buffer */
+	unsigned char cmp[CMP_SIZE];              /* compressed buffer */
+	struct crypto_comp *cc;                   /* crypto compressor stream */
+	struct crypto_shash *crc;                 /* CRC32, NULL for library */
+	u32 crc32;                                /* CRC32 of unc, seed 0 */
+	struct hib_bench_thread bench;            /* time spent and bytes */
 };
 
 /*
  * Compression function that runs in its own thread.
  */
-static int lzo_compress_threadfn(void *data)
+static int compress_threadfn(void *data)
 {
 	struct cmp_data *d = data;
+	unsigned int cmp_len;
+	u64 start, crc_start;
 
 	while (1) {
 		wait_event(d->go, atomic_read(&d->ready) ||
@@ -659,9 +861,19 @@ static int lzo_compress_threadfn(void *data)
 		}
 		atomic_set(&d->ready, 0);
 
-		d->ret = lzo1x_1_compress(d->unc, d->unc_len,
-		                          d->cmp + LZO_HEADER, &d->cmp_len,
-		                          d->wrk);
+		cmp_len = CMP_SIZE - CMP_HEADER;
+		start = ktime_get_ns();
+		d->ret = crypto_comp_compress(d->cc, d->unc, d->unc_len,
+		                              d->cmp + CMP_HEADER, &cmp_len);
+		d->cmp_len = cmp_len;
+		crc_start = ktime_get_ns();
+		d->crc32 = hib_crc32(d->crc, d->unc, d->unc_len);
+
+		d->bench.ns += crc_start - start;
+		d->bench.crc_ns += ktime_get_ns() - crc_start;
+		d->bench.unc_bytes += d->unc_len;
+		d->bench.cmp_bytes += cmp_len;
+		d->bench.chunks++;
 		atomic_set(&d->stop, 1);
 		wake_up(&d->done);
 	}
@@ -669,97 +881,134 @@ static int lzo_compress_threadfn(void *data)
 }
 
 /**
- * save_image_lzo - Save the suspend image data compressed with LZO.
+ * compress_next_chunk - Hand the next chunk of the image to a thread.
+ * @d: Compression thread data, the thread must be idle.
+ * @snapshot: Image to read data from.
+ * @nr_pages: Number of pages read so far, for the progress messages.
+ * @m: Number of pages between two progress messages.
+ *
+ * Returns 1 if the thread has been started, 0 at the end of the image and a
+ * negative error code on failure.
+ */
+static int compress_next_chunk(struct cmp_data *d,
+			       struct snapshot_handle *snapshot,
+			       unsigned int *nr_pages, unsigned int m)
+{
+	size_t off;
+	int ret;
+
+	for (off = 0; off < UNC_SIZE; off += PAGE_SIZE) {
+		ret = snapshot_read_next(snapshot);
+		if (ret < 0)
+			return ret;
+
+		if (!ret)
+			break;
+
+		memcpy(d->unc + off, data_of(*snapshot), PAGE_SIZE);
+
+		if (!(*nr_pages % m))
+			pr_info("Image saving progress: %3u%%\n",
+				*nr_pages / m * 10);
+		(*nr_pages)++;
+	}
+	if (!off)
+		return 0;
+
+	d->unc_len = off;
+
+	atomic_set(&d->ready, 1);
+	wake_up(&d->go);
+	return 1;
+}
+
+/**
+ * save_compressed_image - Save the suspend image data after compression.
  * @handle: Swap map handle to use for saving the image.
  * @snapshot: Image to read data from.
  * @nr_to_write: Number of pages to save.
+ *
+ * The chunks of the image are handed to the compression threads in turn and
+ * their output is written in the same order.  A thread gets its next chunk
+ * as soon as its previous output has been written, so the other threads keep
+ * compressing while that happens.
  */
-static int save_image_lzo(struct swap_map_handle *handle,
+static int save_compressed_image(struct swap_map_handle *handle,
                           struct snapshot_handle *snapshot,
                           unsigned int nr_to_write)
 {
 	unsigned int m;
 	int ret = 0;
-	int nr_pages;
+	unsigned int nr_pages;
 	int err2;
 	struct hib_bio_batch hb;
 	ktime_t start;
 	ktime_t stop;
 	size_t off;
-	unsigned thr, run_threads, nr_threads;
+	unsigned thr, pending, nr_threads;
+	bool eof = false;
 	unsigned char *page = NULL;
-	struct cmp_data *data = NULL;
-	struct crc_data *crc = NULL;
+	struct cmp_data **data = NULL;
+	struct crypto_shash *crc = NULL;
 
 	hib_init_batch(&hb);
+	hib_bench_comp_alg();
 
-	/*
-	 * We'll limit the number of threads for compression to limit memory
-	 * footprint.
-	 */
-	nr_threads = num_online_cpus() - 1;
-	nr_threads = clamp_val(nr_threads, 1, LZO_THREADS);
+	nr_threads = hib_nr_threads();
 
 	page = (void *)__get_free_page(GFP_NOIO | __GFP_HIGH);
 	if (!page) {
-		pr_err("Failed to allocate LZO page\n");
+		pr_err("Failed to allocate %s page\n", hib_comp_algo);
 		ret = -ENOMEM;
 		goto out_clean;
 	}
 
-	data = vzalloc(array_size(nr_threads, sizeof(*data)));
+	data = kcalloc(nr_threads, sizeof(*data), GFP_KERNEL);
 	if (!data) {
-		pr_err("Failed to allocate LZO data\n");
+		pr_err("Failed to allocate %s data\n", hib_comp_algo);
 		ret = -ENOMEM;
 		goto out_clean;
 	}
 
-	crc = kzalloc(sizeof(*crc), GFP_KERNEL);
-	if (!crc) {
-		pr_err("Failed to allocate crc\n");
-		ret = -ENOMEM;
-		goto out_clean;
-	}
+	crc = hib_crc32_alloc();
 
 	/*
-	 * Start the compression threads.
+	 * Start the compression threads, each with its buffers allocated on
+	 * the node it is going to run on.
 	 */
 	for (thr = 0; thr < nr_threads; thr++) {
-		init_waitqueue_head(&data[thr].go);
-		init_waitqueue_head(&data[thr].done);
-
-		data[thr].thr = kthread_run(lzo_compress_threadfn,
-		                            &data[thr],
-		                            "image_compress/%u", thr);
-		if (IS_ERR(data[thr].thr)) {
-			data[thr].thr = NULL;
-			pr_err("Cannot start compression threads\n");
+		unsigned int cpu = hib_thread_cpu(thr, nr_threads);
+
+		data[thr] = vzalloc_node(sizeof(*data[thr]), cpu_to_node(cpu));
+		if (!data[thr]) {
+			pr_err("Failed to allocate %s data\n", hib_comp_algo);
 			ret = -ENOMEM;
 			goto out_clean;
 		}
-	}
 
-	/*
-	 * Start the CRC32 thread.
-	 */
-	init_waitqueue_head(&crc->go);
-	init_waitqueue_head(&crc->done);
+		data[thr]->cc = crypto_alloc_comp(hib_comp_algo, 0, 0);
+		if (IS_ERR(data[thr]->cc)) {
+			ret = PTR_ERR(data[thr]->cc);
+			pr_err("Could not allocate %s stream: %d\n",
+			       hib_comp_algo, ret);
+			data[thr]->cc = NULL;
+			goto out_clean;
+		}
 
-	handle->crc32 = 0;
-	crc->crc32 = &handle->crc32;
-	for (thr = 0; thr < nr_threads; thr++) {
-		crc->unc[thr] = data[thr].unc;
-		crc->unc_len[thr] = &data[thr].unc_len;
-	}
+		data[thr]->crc = crc;
+		init_waitqueue_head(&data[thr]->go);
+		init_waitqueue_head(&data[thr]->done);
 
-	crc->thr = kthread_run(crc32_threadfn, crc, "image_crc32");
-	if (IS_ERR(crc->thr)) {
-		crc->thr = NULL;
-		pr_err("Cannot start CRC32 thread\n");
-		ret = -ENOMEM;
-		goto out_clean;
+		if (hib_thread_start(&data[thr]->thr, compress_threadfn,
+				     data[thr], cpu, "image_compress", thr)) {
+			pr_err("Cannot start compression threads\n");
+			ret = -ENOMEM;
+			goto out_clean;
+		}
 	}
 
+	handle->crc32 = 0;
+
 	/*
 	 * Adjust the number of required free pages after all allocations have
 	 * been done. We don't want to run out of pages when writing.
@@ -774,83 +1023,72 @@ static int save_image_lzo(struct swap_map_handle *handle,
 		m = 1;
 	nr_pages = 0;
 	start = ktime_get();
-	for (;;) {
-		for (thr = 0; thr < nr_threads; thr++) {
-			for (off = 0; off < LZO_UNC_SIZE; off += PAGE_SIZE) {
-				ret = snapshot_read_next(snapshot);
-				if (ret < 0)
-					goto out_finish;
 
-				if (!ret)
-					break;
+	for (pending = 0, thr = 0; !eof && thr < nr_threads; thr++) {
+		ret = compress_next_chunk(data[thr], snapshot, &nr_pages, m);
+		if (ret < 0)
+			goto out_finish;
 
-				memcpy(data[thr].unc + off,
-				       data_of(*snapshot), PAGE_SIZE);
+		if (ret)
+			pending++;
+		else
+			eof = true;
+	}
+	ret = 0;
 
-				if (!(nr_pages % m))
-					pr_info("Image saving progress: %3d%%\n",
-						nr_pages / m * 10);
-				nr_pages++;
-			}
-			if (!off)
-				break;
+	for (thr = 0; pending; thr = (thr + 1) % nr_threads) {
+		struct cmp_data *d = data[thr];
 
-			data[thr].unc_len = off;
+		wait_event(d->done, atomic_read(&d->stop));
+		atomic_set(&d->stop, 0);
+		pending--;
 
-			atomic_set(&data[thr].ready, 1);
-			wake_up(&data[thr].go);
-		}
+		ret = d->ret;
 
-		if (!thr)
-			break;
+		if (ret < 0) {
+			pr_err("%s compression failed\n", hib_comp_algo);
+			goto out_finish;
+		}
 
-		crc->run_threads = thr;
-		atomic_set(&crc->ready, 1);
-		wake_up(&crc->go);
+		if (unlikely(!d->cmp_len ||
+		             d->cmp_len > bytes_worst_compress(d->unc_len))) {
+			pr_err("Invalid %s compressed length\n", hib_comp_algo);
+			ret = -1;
+			goto out_finish;
+		}
 
-		for (run_threads = thr, thr = 0; thr < run_threads; thr++) {
-			wait_event(data[thr].done,
-			           atomic_read(&data[thr].stop));
-			atomic_set(&data[thr].stop, 0);
+		handle->crc32 = crc32_le_combine(handle->crc32, d->crc32,
+						 d->unc_len);
 
-			ret = data[thr].ret;
+		*(size_t *)d->cmp = d->cmp_len;
 
-			if (ret < 0) {
-				pr_err("LZO compression failed\n");
-				goto out_finish;
-			}
+		/*
+		 * Given we are writing one page at a time to disk, we copy
+		 * that much from the buffer, although the last bit will likely
+		 * be smaller than full page. This is OK - we saved the length
+		 * of the compressed data, so any garbage at the end will be
+		 * discarded when we read it.
+		 */
+		for (off = 0; off < CMP_HEADER + d->cmp_len; off += PAGE_SIZE) {
+			memcpy(page, d->cmp + off, PAGE_SIZE);
 
-			if (unlikely(!data[thr].cmp_len ||
-			             data[thr].cmp_len >
-			             lzo1x_worst_compress(data[thr].unc_len))) {
-				pr_err("Invalid LZO compressed length\n");
-				ret = -1;
+			ret = swap_write_page(handle, page, &hb);
+			if (ret)
 				goto out_finish;
-			}
-
-			*(size_t *)data[thr].cmp = data[thr].cmp_len;
+		}
 
-			/*
-			 * Given we are writing one page at a time to disk, we
-			 * copy that much from the buffer, although the last
-			 * bit will likely be smaller than full page. This is
-			 * OK - we saved the length of the compressed data, so
-			 * any garbage at the end will be discarded when we
-			 * read it.
-			 */
-			for (off = 0;
-			     off < LZO_HEADER + data[thr].cmp_len;
-			     off += PAGE_SIZE) {
-				memcpy(page, data[thr].cmp + off, PAGE_SIZE);
+		if (eof)
+			continue;
 
-				ret = swap_write_page(handle, page, &hb);
-				if (ret)
-					goto out_finish;
-			}
-		}
+		ret = compress_next_chunk(d, snapshot, &nr_pages, m);
+		if (ret < 0)
+			goto out_finish;
 
-		wait_event(crc->done, atomic_read(&crc->stop));
-		atomic_set(&crc->stop, 0);
+		if (ret)
+			pending++;
+		else
+			eof = true;
+		ret = 0;
 	}
 
 out_finish:
@@ -861,19 +1099,21 @@ static int save_image_lzo(struct swap_map_handle *handle,
 	if (!ret)
 		pr_info("Image saving done\n");
 	swsusp_show_speed(start, stop, nr_to_write, "Wrote");
+	hib_bench_pass_done(start, stop, nr_to_write);
 out_clean:
 	hib_finish_batch(&hb);
-	if (crc) {
-		if (crc->thr)
-			kthread_stop(crc->thr);
-		kfree(crc);
-	}
 	if (data) {
-		for (thr = 0; thr < nr_threads; thr++)
-			if (data[thr].thr)
-				kthread_stop(data[thr].thr);
-		vfree(data);
+		for (thr = 0; thr < nr_threads && data[thr]; thr++) {
+			if (data[thr]->thr)
+				kthread_stop(data[thr]->thr);
+			hib_bench_thread_done(thr, &data[thr]->bench);
+			if (data[thr]->cc)
+				crypto_free_comp(data[thr]->cc);
+			vfree(data[thr]);
+		}
+		kfree(data);
 	}
+	crypto_free_shash(crc);
 	if (page) free_page((unsigned long)page);
 
 	return ret;
@@ -915,6 +1155,8 @@ int swsusp_write(unsigned int flags)
 	unsigned long pages;
 	int error;
 
+	hib_bench_start(&hib_bench.save);
+
 	pages = snapshot_get_image_size();
 	error = get_swap_writer(&handle);
 	if (error) {
@@ -941,10 +1183,11 @@ int swsusp_write(unsigned int flags)
 	if (!error) {
 		error = (flags & SF_NOCOMPRESS_MODE) ?
 			save_image(&handle, &snapshot, pages - 1) :
-			save_image_lzo(&handle, &snapshot, pages - 1);
+			save_compressed_image(&handle, &snapshot, pages - 1);
 	}
 out_finish:
 	error = swap_writer_finish(&handle, flags, error);
+	hib_bench_io = NULL;
 	return error;
 }
 
@@ -979,6 +1222,15 @@ static int get_swap_reader(struct swap_map_handle *handle,
 	if (!swsusp_header->image) /* how can this happen? */
 		return -EINVAL;
 
+	/*
+	 * Pass on how long saving the image took, unless this is the kernel
+	 * that has saved it, for the image_size_auto estimate.
+	 */
+	if (!hib_bench.save.pages) {
+		hib_bench.save.ns = swsusp_header->save_ns;
+		hib_bench.save.pages = swsusp_header->save_pages;
+	}
+
 	handle->cur = NULL;
 	last = handle->maps = NULL;
 	offset = swsusp_header->image;
@@ -1104,11 +1356,12 @@ static int load_image(struct swap_map_handle *handle,
 			ret = -ENODATA;
 	}
 	swsusp_show_speed(start, stop, nr_to_read, "Read");
+	hib_bench_pass_done(start, stop, nr_to_read);
 	return ret;
 }
 
 /*
- * Structure used for LZO data decompression.
+ * Structure used for data decompression.
  */
 struct dec_data {
 	struct task_struct *thr;                  /* thread */
@@ -1119,16 +1372,22 @@ struct dec_data {
 	wait_queue_head_t done;                   /* decompression done */
 	size_t unc_len;                           /* uncompressed length */
 	size_t cmp_len;                           /* compressed length */
-	unsigned char unc[LZO_UNC_SIZE];          /* uncompressed buffer */
-	unsigned char cmp[LZO_CMP_SIZE];          /* compressed buffer */
+	unsigned char unc[UNC_SIZE];              /* uncompressed buffer */
+	unsigned char cmp[CMP_SIZE];              /* compressed buffer */
+	struct crypto_comp *cc;                   /* crypto compressor stream */
+	struct crypto_shash *crc;                 /* CRC32, NULL for library */
+	u32 crc32;                                /* CRC32 of unc, seed 0 */
+	struct hib_bench_thread bench;            /* time spent and bytes */
 };
 
 /*
  * Decompression function that runs in its own thread.
  */
-static int lzo_decompress_threadfn(void *data)
+static int decompress_threadfn(void *data)
 {
 	struct dec_data *d = data;
+	unsigned int unc_len;
+	u64 start, crc_start;
 
 	while (1) {
 		wait_event(d->go, atomic_read(&d->ready) ||
@@ -1142,9 +1401,20 @@ static int lzo_decompress_threadfn(void *data)
 		}
 		atomic_set(&d->ready, 0);
 
-		d->unc_len = LZO_UNC_SIZE;
-		d->ret = lzo1x_decompress_safe(d->cmp + LZO_HEADER, d->cmp_len,
-		                               d->unc, &d->unc_len);
+		unc_len = UNC_SIZE;
+		start = ktime_get_ns();
+		d->ret = crypto_comp_decompress(d->cc, d->cmp + CMP_HEADER,
+		                                d->cmp_len, d->unc, &unc_len);
+		d->unc_len = unc_len;
+		crc_start = ktime_get_ns();
+		if (!d->ret && d->unc_len <= UNC_SIZE)
+			d->crc32 = hib_crc32(d->crc, d->unc, d->unc_len);
+
+		d->bench.ns += crc_start - start;
+		d->bench.crc_ns += ktime_get_ns() - crc_start;
+		d->bench.unc_bytes += unc_len;
+		d->bench.cmp_bytes += d->cmp_len;
+		d->bench.chunks++;
 		if (clean_pages_on_decompress)
 			flush_icache_range((unsigned long)d->unc,
 					   (unsigned long)d->unc + d->unc_len);
@@ -1156,12 +1426,12 @@ static int lzo_decompress_threadfn(void *data)
 }
 
 /**
- * load_image_lzo - Load compressed image data and decompress them with LZO.
+ * load_compressed_image - Load compressed image data and decompress it.
  * @handle: Swap map handle to use for loading data.
  * @snapshot: Image to copy uncompressed data into.
  * @nr_to_read: Number of pages to load.
  */
-static int load_image_lzo(struct swap_map_handle *handle,
+static int load_compressed_image(struct swap_map_handle *handle,
                           struct snapshot_handle *snapshot,
                           unsigned int nr_to_read)
 {
@@ -1178,80 +1448,79 @@ static int load_image_lzo(struct swap_map_handle *handle,
 	         have = 0, want, need, asked = 0;
 	unsigned long read_pages = 0;
 	unsigned char **page = NULL;
-	struct dec_data *data = NULL;
-	struct crc_data *crc = NULL;
+	struct dec_data **data = NULL;
+	struct crypto_shash *crc = NULL;
 
 	hib_init_batch(&hb);
 
 	/*
-	 * We'll limit the number of threads for decompression to limit memory
-	 * footprint.
+	 * Use the algorithm the image has been compressed with.  Images that
+	 * don't record it have been compressed with LZO.
 	 */
-	nr_threads = num_online_cpus() - 1;
-	nr_threads = clamp_val(nr_threads, 1, LZO_THREADS);
+	if (swsusp_header->flags & SF_COMP_ALG)
+		strscpy(hib_comp_algo, swsusp_header->comp_alg,
+			sizeof(hib_comp_algo));
+	else
+		strscpy(hib_comp_algo, "lzo", sizeof(hib_comp_algo));
+	hib_bench_comp_alg();
 
-	page = vmalloc(array_size(LZO_MAX_RD_PAGES, sizeof(*page)));
+	nr_threads = hib_nr_threads();
+
+	page = vmalloc(array_size(CMP_MAX_RD_PAGES, sizeof(*page)));
 	if (!page) {
-		pr_err("Failed to allocate LZO page\n");
+		pr_err("Failed to allocate %s page\n", hib_comp_algo);
 		ret = -ENOMEM;
 		goto out_clean;
 	}
 
-	data = vzalloc(array_size(nr_threads, sizeof(*data)));
+	data = kcalloc(nr_threads, sizeof(*data), GFP_KERNEL);
 	if (!data) {
-		pr_err("Failed to allocate LZO data\n");
+		pr_err("Failed to allocate %s data\n", hib_comp_algo);
 		ret = -ENOMEM;
 		goto out_clean;
 	}
 
-	crc = kzalloc(sizeof(*crc), GFP_KERNEL);
-	if (!crc) {
-		pr_err("Failed to allocate crc\n");
-		ret = -ENOMEM;
-		goto out_clean;
-	}
+	crc = hib_crc32_alloc();
 
 	clean_pages_on_decompress = true;
 
 	/*
-	 * Start the decompression threads.
+	 * Start the decompression threads, each with its buffers allocated on
+	 * the node it is going to run on.
 	 */
 	for (thr = 0; thr < nr_threads; thr++) {
-		init_waitqueue_head(&data[thr].go);
-		init_waitqueue_head(&data[thr].done);
-
-		data[thr].thr = kthread_run(lzo_decompress_threadfn,
-		                            &data[thr],
-		                            "image_decompress/%u", thr);
-		if (IS_ERR(data[thr].thr)) {
-			data[thr].thr = NULL;
-			pr_err("Cannot start decompression threads\n");
+		unsigned int cpu = hib_thread_cpu(thr, nr_threads);
+
+		data[thr] = vzalloc_node(sizeof(*data[thr]), cpu_to_node(cpu));
+		if (!data[thr]) {
+			pr_err("Failed to allocate %s data\n", hib_comp_algo);
 			ret = -ENOMEM;
 			goto out_clean;
 		}
-	}
 
-	/*
-	 * Start the CRC32 thread.
-	 */
-	init_waitqueue_head(&crc->go);
-	init_waitqueue_head(&crc->done);
+		data[thr]->cc = crypto_alloc_comp(hib_comp_algo, 0, 0);
+		if (IS_ERR(data[thr]->cc)) {
+			ret = PTR_ERR(data[thr]->cc);
+			pr_err("Could not allocate %s stream: %d\n",
+			       hib_comp_algo, ret);
+			data[thr]->cc = NULL;
+			goto out_clean;
+		}
 
-	handle->crc32 = 0;
-	crc->crc32 = &handle->crc32;
-	for (thr = 0; thr < nr_threads; thr++) {
-		crc->unc[thr] = data[thr].unc;
-		crc->unc_len[thr] = &data[thr].unc_len;
-	}
+		data[thr]->crc = crc;
+		init_waitqueue_head(&data[thr]->go);
+		init_waitqueue_head(&data[thr]->done);
 
-	crc->thr = kthread_run(crc32_threadfn, crc, "image_crc32");
-	if (IS_ERR(crc->thr)) {
-		crc->thr = NULL;
-		pr_err("Cannot start CRC32 thread\n");
-		ret = -ENOMEM;
-		goto out_clean;
+		if (hib_thread_start(&data[thr]->thr, decompress_threadfn,
+				     data[thr], cpu, "image_decompress", thr)) {
+			pr_err("Cannot start decompression threads\n");
+			ret = -ENOMEM;
+			goto out_clean;
+		}
 	}
 
+	handle->crc32 = 0;
+
 	/*
 	 * Set the number of pages for read buffering.
 	 * This is complete guesswork, because we'll only know the real
@@ -1261,18 +1530,18 @@ static int load_image_lzo(struct swap_map_handle *handle,
 	 */
 	if (low_free_pages() > snapshot_get_image_size())
 		read_pages = (low_free_pages() - snapshot_get_image_size()) / 2;
-	read_pages = clamp_val(read_pages, LZO_MIN_RD_PAGES, LZO_MAX_RD_PAGES);
+	read_pages = clamp_val(read_pages, CMP_MIN_RD_PAGES, CMP_MAX_RD_PAGES);
 
 	for (i = 0; i < read_pages; i++) {
-		page[i] = (void *)__get_free_page(i < LZO_CMP_PAGES ?
+		page[i] = (void *)__get_free_page(i < CMP_PAGES ?
 						  GFP_NOIO | __GFP_HIGH :
 						  GFP_NOIO | __GFP_NOWARN |
 						  __GFP_NORETRY);
 
 		if (!page[i]) {
-			if (i < LZO_CMP_PAGES) {
+			if (i < CMP_PAGES) {
 				ring_size = i;
-				pr_err("Failed to allocate LZO pages\n");
+				pr_err("Failed to allocate %s pages\n", hib_comp_algo);
 				ret = -ENOMEM;
 				goto out_clean;
 			} else {
@@ -1333,23 +1602,17 @@ static int load_image_lzo(struct swap_map_handle *handle,
 				eof = 2;
 		}
 
-		if (crc->run_threads) {
-			wait_event(crc->done, atomic_read(&crc->stop));
-			atomic_set(&crc->stop, 0);
-			crc->run_threads = 0;
-		}
-
 		for (thr = 0; have && thr < nr_threads; thr++) {
-			data[thr].cmp_len = *(size_t *)page[pg];
-			if (unlikely(!data[thr].cmp_len ||
-			             data[thr].cmp_len >
-			             lzo1x_worst_compress(LZO_UNC_SIZE))) {
-				pr_err("Invalid LZO compressed length\n");
+			data[thr]->cmp_len = *(size_t *)page[pg];
+			if (unlikely(!data[thr]->cmp_len ||
+			             data[thr]->cmp_len >
+			             bytes_worst_compress(UNC_SIZE))) {
+				pr_err("Invalid %s compressed length\n", hib_comp_algo);
 				ret = -1;
 				goto out_finish;
 			}
 
-			need = DIV_ROUND_UP(data[thr].cmp_len + LZO_HEADER,
+			need = DIV_ROUND_UP(data[thr]->cmp_len + CMP_HEADER,
 			                    PAGE_SIZE);
 			if (need > have) {
 				if (eof > 1) {
@@ -1360,9 +1623,9 @@ static int load_image_lzo(struct swap_map_handle *handle,
 			}
 
 			for (off = 0;
-			     off < LZO_HEADER + data[thr].cmp_len;
+			     off < CMP_HEADER + data[thr]->cmp_len;
 			     off += PAGE_SIZE) {
-				memcpy(data[thr].cmp + off,
+				memcpy(data[thr]->cmp + off,
 				       page[pg], PAGE_SIZE);
 				have--;
 				want++;
@@ -1370,14 +1633,14 @@ static int load_image_lzo(struct swap_map_handle *handle,
 					pg = 0;
 			}
 
-			atomic_set(&data[thr].ready, 1);
-			wake_up(&data[thr].go);
+			atomic_set(&data[thr]->ready, 1);
+			wake_up(&data[thr]->go);
 		}
 
 		/*
 		 * Wait for more data while we are decompressing.
 		 */
-		if (have < LZO_CMP_PAGES && asked) {
+		if (have < CMP_PAGES && asked) {
 			ret = hib_wait_io(&hb);
 			if (ret)
 				goto out_finish;
@@ -1388,29 +1651,33 @@ static int load_image_lzo(struct swap_map_handle *handle,
 		}
 
 		for (run_threads = thr, thr = 0; thr < run_threads; thr++) {
-			wait_event(data[thr].done,
-			           atomic_read(&data[thr].stop));
-			atomic_set(&data[thr].stop, 0);
+			wait_event(data[thr]->done,
+			           atomic_read(&data[thr]->stop));
+			atomic_set(&data[thr]->stop, 0);
 
-			ret = data[thr].ret;
+			ret = data[thr]->ret;
 
 			if (ret < 0) {
-				pr_err("LZO decompression failed\n");
+				pr_err("%s decompression failed\n", hib_comp_algo);
 				goto out_finish;
 			}
 
-			if (unlikely(!data[thr].unc_len ||
-			             data[thr].unc_len > LZO_UNC_SIZE ||
-			             data[thr].unc_len & (PAGE_SIZE - 1))) {
-				pr_err("Invalid LZO uncompressed length\n");
+			if (unlikely(!data[thr]->unc_len ||
+			             data[thr]->unc_len > UNC_SIZE ||
+			             data[thr]->unc_len & (PAGE_SIZE - 1))) {
+				pr_err("Invalid %s uncompressed length\n", hib_comp_algo);
 				ret = -1;
 				goto out_finish;
 			}
 
+			handle->crc32 = crc32_le_combine(handle->crc32,
+							 data[thr]->crc32,
+							 data[thr]->unc_len);
+
 			for (off = 0;
-			     off < data[thr].unc_len; off += PAGE_SIZE) {
+			     off < data[thr]->unc_len; off += PAGE_SIZE) {
 				memcpy(data_of(*snapshot),
-				       data[thr].unc + off, PAGE_SIZE);
+				       data[thr]->unc + off, PAGE_SIZE);
 
 				if (!(nr_pages % m))
 					pr_info("Image loading progress: %3d%%\n",
@@ -1418,25 +1685,13 @@ static int load_image_lzo(struct swap_map_handle *handle,
 				nr_pages++;
 
 				ret = snapshot_write_next(snapshot);
-				if (ret <= 0) {
-					crc->run_threads = thr + 1;
-					atomic_set(&crc->ready, 1);
-					wake_up(&crc->go);
+				if (ret <= 0)
 					goto out_finish;
-				}
 			}
 		}
-
-		crc->run_threads = thr;
-		atomic_set(&crc->ready, 1);
-		wake_up(&crc->go);
 	}
 
 out_finish:
-	if (crc->run_threads) {
-		wait_event(crc->done, atomic_read(&crc->stop));
-		atomic_set(&crc->stop, 0);
-	}
 	stop = ktime_get();
 	if (!ret) {
 		pr_info("Image loading done\n");
@@ -1453,21 +1708,23 @@ static int load_image_lzo(struct swap_map_handle *handle,
 		}
 	}
 	swsusp_show_speed(start, stop, nr_to_read, "Read");
+	hib_bench_pass_done(start, stop, nr_to_read);
 out_clean:
 	hib_finish_batch(&hb);
 	for (i = 0; i < ring_size; i++)
 		free_page((unsigned long)page[i]);
-	if (crc) {
-		if (crc->thr)
-			kthread_stop(crc->thr);
-		kfree(crc);
-	}
 	if (data) {
-		for (thr = 0; thr < nr_threads; thr++)
-			if (data[thr].thr)
-				kthread_stop(data[thr].thr);
-		vfree(data);
+		for (thr = 0; thr < nr_threads && data[thr]; thr++) {
+			if (data[thr]->thr)
+				kthread_stop(data[thr]->thr);
+			hib_bench_thread_done(thr, &data[thr]->bench);
+			if (data[thr]->cc)
+				crypto_free_comp(data[thr]->cc);
+			vfree(data[thr]);
+		}
+		kfree(data);
 	}
+	crypto_free_shash(crc);
 	vfree(page);
 
 	return ret;
@@ -1494,14 +1751,16 @@ int swsusp_read(unsigned int *flags_p)
 	error = get_swap_reader(&handle, flags_p);
 	if (error)
 		goto end;
+	hib_bench_start(&hib_bench.load);
 	if (!error)
 		error = swap_read_page(&handle, header, NULL);
 	if (!error) {
 		error = (*flags_p & SF_NOCOMPRESS_MODE) ?
 			load_image(&handle, &snapshot, header->pages - 1) :
-			load_image_lzo(&handle, &snapshot, header->pages - 1);
+			load_compressed_image(&handle, &snapshot, header->pages - 1);
 	}
 	swap_reader_finish(&handle);
+	hib_bench_io = NULL;
 end:
 	if (!error)
 		pr_debug("Image successfully loaded\n");
@@ -21,6 +21,7 @@
 #include <linux/console.h>
 #include <linux/cpu.h>
 #include <linux/freezer.h>
+#include <linux/uio.h>
 
 #include <linux/uaccess.h>
 
@@ -131,34 +132,48 @@ static int snapshot_release(struct inode *inode, struct file *filp)
 	return 0;
 }
 
-static ssize_t snapshot_read(struct file *filp, char __user *buf,
-                             size_t count, loff_t *offp)
+/*
+ * Copy as much of the image as fits into the caller's buffer in one go,
+ * so that user space need not issue a separate read() for every page.
+ * Going through ->read_iter() also lets the image be spliced into a pipe
+ * (and from there to a socket or a file) via copy_splice_read().
+ */
+static ssize_t snapshot_read_iter(struct kiocb *iocb, struct iov_iter *to)
 {
-	loff_t pg_offp = *offp & ~PAGE_MASK;
-	struct snapshot_data *data;
+	struct snapshot_data *data = iocb->ki_filp->private_data;
 	unsigned int sleep_flags;
-	ssize_t res;
+	ssize_t res = 0;
 
 	sleep_flags = lock_system_sleep();
 
-	data = filp->private_data;
 	if (!data->ready) {
 		res = -ENODATA;
 		goto Unlock;
 	}
-	if (!pg_offp) { /* on page boundary? */
-		res = snapshot_read_next(&data->handle);
-		if (res <= 0)
-			goto Unlock;
-	} else {
-		res = PAGE_SIZE - pg_offp;
+	while (iov_iter_count(to)) {
+		loff_t pg_offp = iocb->ki_pos & ~PAGE_MASK;
+		size_t copied;
+
+		if (!pg_offp) { /* on page boundary? */
+			int ret = snapshot_read_next(&data->handle);
+
+			if (ret <= 0) {
+				if (!res)
+					res = ret;
+				break;
+			}
+		}
+		copied = copy_to_iter(data_of(data->handle) + pg_offp,
+				      PAGE_SIZE - pg_offp, to);
+		if (!copied) {
+			if (!res)
+				res = -EFAULT;
+			break;
+		}
+		iocb->ki_pos += copied;
+		res += copied;
 	}
 
-	res = simple_read_from_buffer(buf, count, &pg_offp,
-			data_of(data->handle), res);
-	if (res > 0)
-		*offp += res;
-
  Unlock:
 	unlock_system_sleep(sleep_flags);
 
@@ -443,8 +458,9 @@ snapshot_compat_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 static const struct file_operations snapshot_fops = {
 	.open = snapshot_open,
 	.release = snapshot_release,
-	.read = snapshot_read,
+	.read_iter = snapshot_read_iter,
 	.write = snapshot_write,
+	.splice_read = copy_splice_read,
 	.llseek = no_llseek,
 	.unlocked_ioctl = snapshot_ioctl,
 #ifdef CONFIG_COMPAT
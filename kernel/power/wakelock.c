@@ -14,10 +14,11 @@
 #include <linux/ctype.h>
 #include <linux/device.h>
 #include <linux/err.h>
+#include <linux/hashtable.h>
 #include <linux/hrtimer.h>
 #include <linux/list.h>
-#include <linux/rbtree.h>
 #include <linux/slab.h>
+#include <linux/stringhash.h>
 #include <linux/workqueue.h>
 
 #include "power.h"
@@ -26,25 +27,26 @@ static DEFINE_MUTEX(wakelocks_lock);
 
 struct wakelock {
 	char			*name;
-	struct rb_node		node;
+	struct hlist_node	node;
 	struct wakeup_source	*ws;
 #ifdef CONFIG_PM_WAKELOCKS_GC
 	struct list_head	lru;
 #endif
 };
 
-static struct rb_root wakelocks_tree = RB_ROOT;
+#define WL_HASH_BITS	8
+
+static DEFINE_HASHTABLE(wakelocks_hash, WL_HASH_BITS);
 
 ssize_t pm_show_wakelocks(char *buf, bool show_active)
 {
-	struct rb_node *node;
 	struct wakelock *wl;
 	int len = 0;
+	int bkt;
 
 	mutex_lock(&wakelocks_lock);
 
-	for (node = rb_first(&wakelocks_tree); node; node = rb_next(node)) {
-		wl = rb_entry(node, struct wakelock, node);
+	hash_for_each(wakelocks_hash, bkt, wl, node) {
 		if (wl->ws->active == show_active)
 			len += sysfs_emit_at(buf, len, "%s ", wl->name);
 	}
@@ -81,15 +83,19 @@ static inline void decrement_wakelocks_number(void) {}
 #ifdef CONFIG_PM_WAKELOCKS_GC
 #define WL_GC_COUNT_MAX	100
 #define WL_GC_TIME_SEC	300
+#define WL_GC_BATCH	32
 
 static void __wakelocks_gc(struct work_struct *work);
 static LIST_HEAD(wakelocks_lru_list);
 static DECLARE_WORK(wakelock_work, __wakelocks_gc);
 static unsigned int wakelocks_gc_count;
+static unsigned int wakelocks_lru_len;
+static unsigned int wakelocks_gc_todo;
 
 static inline void wakelocks_lru_add(struct wakelock *wl)
 {
 	list_add(&wl->lru, &wakelocks_lru_list);
+	wakelocks_lru_len++;
 }
 
 static inline void wakelocks_lru_most_recent(struct wakelock *wl)
@@ -97,37 +103,61 @@ static inline void wakelocks_lru_most_recent(struct wakelock *wl)
 	list_move(&wl->lru, &wakelocks_lru_list);
 }
 
+/*
+ * Each garbage collection pass looks at every wakelock at most once, starting
+ * from the least recently used one, but it is carried out in batches of up to
+ * WL_GC_BATCH wakelocks, so wakelocks_lock is not held for too long when there
+ * are many of them.  Active wakelocks are moved to the head of the LRU list
+ * so that subsequent batches do not start from them.
+ */
 static void __wakelocks_gc(struct work_struct *work)
 {
-	struct wakelock *wl, *aux;
+	unsigned int budget = WL_GC_BATCH;
 	ktime_t now;
 
 	mutex_lock(&wakelocks_lock);
 
+	if (!wakelocks_gc_todo)
+		wakelocks_gc_todo = wakelocks_lru_len;
+
 	now = ktime_get();
-	list_for_each_entry_safe_reverse(wl, aux, &wakelocks_lru_list, lru) {
+	while (wakelocks_gc_todo && budget) {
+		struct wakelock *wl;
 		u64 idle_time_ns;
 		bool active;
 
+		wl = list_last_entry(&wakelocks_lru_list, struct wakelock, lru);
+
 		spin_lock_irq(&wl->ws->lock);
 		idle_time_ns = ktime_to_ns(ktime_sub(now, wl->ws->last_time));
 		active = wl->ws->active;
 		spin_unlock_irq(&wl->ws->lock);
 
-		if (idle_time_ns < ((u64)WL_GC_TIME_SEC * NSEC_PER_SEC))
+		if (idle_time_ns < ((u64)WL_GC_TIME_SEC * NSEC_PER_SEC)) {
+			wakelocks_gc_todo = 0;
 			break;
+		}
 
 		if (!active) {
 			wakeup_source_unregister(wl->ws);
-			rb_erase(&wl->node, &wakelocks_tree);
+			hash_del(&wl->node);
 			list_del(&wl->lru);
+			wakelocks_lru_len--;
 			kfree(wl->name);
 			kfree(wl);
 			decrement_wakelocks_number();
+		} else {
+			wakelocks_lru_most_recent(wl);
 		}
+
+		wakelocks_gc_todo--;
+		budget--;
 	}
 	wakelocks_gc_count = 0;
 
+	if (wakelocks_gc_todo)
+		schedule_work(&wakelock_work);
+
 	mutex_unlock(&wakelocks_lock);
 }
 
@@ -147,27 +177,13 @@ static inline void wakelocks_gc(void) {}
 static struct wakelock *wakelock_lookup_add(const char *name, size_t len,
 					    bool add_if_not_found)
 {
-	struct rb_node **node = &wakelocks_tree.rb_node;
-	struct rb_node *parent = *node;
+	unsigned int hash = full_name_hash(NULL, name, len);
 	struct wakelock *wl;
 
-	while (*node) {
-		int diff;
-
-		parent = *node;
-		wl = rb_entry(*node, struct wakelock, node);
-		diff = strncmp(name, wl->name, len);
-		if (diff == 0) {
-			if (wl->name[len])
-				diff = -1;
-			else
-				return wl;
-		}
-		if (diff < 0)
-			node = &(*node)->rb_left;
-		else
-			node = &(*node)->rb_right;
-	}
+	hash_for_each_possible(wakelocks_hash, wl, node, hash)
+		if (!strncmp(name, wl->name, len) && !wl->name[len])
+			return wl;
+
 	if (!add_if_not_found)
 		return ERR_PTR(-EINVAL);
 
@@ -193,45 +209,46 @@ static struct wakelock *wakelock_lookup_add(const char *name, size_t len,
 	}
 	wl->ws->last_time = ktime_get();
 
-	rb_link_node(&wl->node, parent, node);
-	rb_insert_color(&wl->node, &wakelocks_tree);
+	hash_add(wakelocks_hash, &wl->node, hash);
 	wakelocks_lru_add(wl);
 	increment_wakelocks_number();
 	return wl;
 }
 
-int pm_wake_lock(const char *buf)
+static int __pm_wake_lock(const char *buf, size_t size)
 {
-	const char *str = buf;
+	const char *str = buf, *end = buf + size;
 	struct wakelock *wl;
 	u64 timeout_ns = 0;
 	size_t len;
-	int ret = 0;
 
-	if (!capable(CAP_BLOCK_SUSPEND))
-		return -EPERM;
-
-	while (*str && !isspace(*str))
+	while (str < end && !isspace(*str))
 		str++;
 
 	len = str - buf;
 	if (!len)
 		return -EINVAL;
 
-	if (*str && *str != '\n') {
+	if (str < end) {
 		/* Find out if there's a valid timeout string appended. */
-		ret = kstrtou64(skip_spaces(str), 10, &timeout_ns);
-		if (ret)
+		char timeout[24];
+
+		while (str < end && isspace(*str))
+			str++;
+
+		if (end - str >= sizeof(timeout))
 			return -EINVAL;
-	}
 
-	mutex_lock(&wakelocks_lock);
+		memcpy(timeout, str, end - str);
+		timeout[end - str] = '\0';
+		if (kstrtou64(timeout, 10, &timeout_ns))
+			return -EINVAL;
+	}
 
 	wl = wakelock_lookup_add(buf, len, true);
-	if (IS_ERR(wl)) {
-		ret = PTR_ERR(wl);
-		goto out;
-	}
+	if (IS_ERR(wl))
+		return PTR_ERR(wl);
+
 	if (timeout_ns) {
 		u64 timeout_ms = timeout_ns + NSEC_PER_MSEC - 1;
 
@@ -242,44 +259,61 @@ int pm_wake_lock(const char *buf)
 	}
 
 	wakelocks_lru_most_recent(wl);
-
- out:
-	mutex_unlock(&wakelocks_lock);
-	return ret;
+	return 0;
 }
 
-int pm_wake_unlock(const char *buf)
+static int __pm_wake_unlock(const char *buf, size_t len)
 {
 	struct wakelock *wl;
-	size_t len;
-	int ret = 0;
-
-	if (!capable(CAP_BLOCK_SUSPEND))
-		return -EPERM;
 
-	len = strlen(buf);
 	if (!len)
 		return -EINVAL;
 
-	if (buf[len-1] == '\n')
-		len--;
-
-	if (!len)
-		return -EINVAL;
-
-	mutex_lock(&wakelocks_lock);
-
 	wl = wakelock_lookup_add(buf, len, false);
-	if (IS_ERR(wl)) {
-		ret = PTR_ERR(wl);
-		goto out;
-	}
+	if (IS_ERR(wl))
+		return PTR_ERR(wl);
+
 	__pm_relax(wl->ws);
 
 	wakelocks_lru_most_recent(wl);
 	wakelocks_gc();
+	return 0;
+}
+
+/*
+ * Carry out a batch of requests, one per line, under wakelocks_lock, stopping
+ * at the first one that fails.
+ */
+static int pm_wake_batch(const char *buf,
+			 int (*fn)(const char *buf, size_t len))
+{
+	int ret;
+
+	if (!capable(CAP_BLOCK_SUSPEND))
+		return -EPERM;
+
+	mutex_lock(&wakelocks_lock);
+
+	do {
+		const char *eol = strchrnul(buf, '\n');
+
+		ret = fn(buf, eol - buf);
+		if (ret || !*eol)
+			break;
+
+		buf = eol + 1;
+	} while (*buf);
 
- out:
 	mutex_unlock(&wakelocks_lock);
 	return ret;
 }
+
+int pm_wake_lock(const char *buf)
+{
+	return pm_wake_batch(buf, __pm_wake_lock);
+}
+
+int pm_wake_unlock(const char *buf)
+{
+	return pm_wake_batch(buf, __pm_wake_unlock);
+}
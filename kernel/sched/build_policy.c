@@ -20,6 +20,7 @@
 #include <linux/sched/rt.h>
 
 #include <linux/cpuidle.h>
+#include <linux/energy_model.h>
 #include <linux/jiffies.h>
 #include <linux/livepatch.h>
 #include <linux/psi.h>
@@ -2047,6 +2047,13 @@ static void __init init_uclamp(void)
 		root_task_group.uclamp[clamp_id] = uc_max;
 #endif
 	}
+
+#ifdef CONFIG_UCLAMP_TASK_GROUP
+	root_task_group.freq_req[UCLAMP_MAX] = UINT_MAX;
+	root_task_group.freq[UCLAMP_MAX] = UINT_MAX;
+	for_each_possible_cpu(cpu)
+		cpu_rq(cpu)->cgroup_freq[UCLAMP_MAX] = UINT_MAX;
+#endif
 }
 
 #else /* CONFIG_UCLAMP_TASK */
@@ -5175,12 +5182,49 @@ static inline void kmap_local_sched_in(void)
  * prepare_task_switch sets up locking and calls architecture specific
  * hooks.
  */
+#ifdef CONFIG_UCLAMP_TASK_GROUP
+DEFINE_STATIC_KEY_FALSE(sched_cgroup_freq_used);
+
+/*
+ * Make the frequency limits of the task group of @next those of @rq, and let
+ * cpufreq know only if they have actually changed, so that switching between
+ * tasks of groups with the same limits costs two loads and two compares.
+ *
+ * The idle task leaves the limits of the last task in place, as schedutil
+ * ignores the limits of idle CPUs anyway, so that idle periods do not count
+ * as limit changes.
+ */
+static inline void cgroup_freq_switch(struct rq *rq, struct task_struct *next)
+{
+	struct task_group *tg;
+	unsigned int min, max;
+
+	if (!cgroup_freq_used() || is_idle_task(next))
+		return;
+
+	tg = task_group(next);
+	min = READ_ONCE(tg->freq[UCLAMP_MIN]);
+	max = READ_ONCE(tg->freq[UCLAMP_MAX]);
+
+	if (min == rq->cgroup_freq[UCLAMP_MIN] &&
+	    max == rq->cgroup_freq[UCLAMP_MAX])
+		return;
+
+	WRITE_ONCE(rq->cgroup_freq[UCLAMP_MIN], min);
+	WRITE_ONCE(rq->cgroup_freq[UCLAMP_MAX], max);
+	cpufreq_update_util(rq, SCHED_CPUFREQ_CGROUP_LIMITS);
+}
+#else
+static inline void cgroup_freq_switch(struct rq *rq, struct task_struct *next) { }
+#endif
+
 static inline void
 prepare_task_switch(struct rq *rq, struct task_struct *prev,
 		    struct task_struct *next)
 {
 	kcov_prepare_switch(prev);
 	sched_info_switch(rq, prev, next);
+	cgroup_freq_switch(rq, next);
 	perf_event_task_sched_out(prev, next);
 	rseq_preempt(prev);
 	fire_sched_out_preempt_notifiers(prev, next);
@@ -5647,6 +5691,8 @@ void scheduler_tick(void)
 	if (housekeeping_cpu(cpu, HK_TYPE_TICK))
 		arch_scale_freq_tick();
 
+	sched_energy_update_power(cpu);
+
 	sched_clock_tick();
 
 	rq_lock(rq, &rf);
@@ -10352,7 +10398,10 @@ static inline void alloc_uclamp_sched_group(struct task_group *tg,
 		uclamp_se_set(&tg->uclamp_req[clamp_id],
 			      uclamp_none(clamp_id), false);
 		tg->uclamp[clamp_id] = parent->uclamp[clamp_id];
+		tg->freq[clamp_id] = parent->freq[clamp_id];
 	}
+	tg->freq_req[UCLAMP_MIN] = 0;
+	tg->freq_req[UCLAMP_MAX] = UINT_MAX;
 #endif
 }
 
@@ -10797,6 +10846,99 @@ static int cpu_uclamp_max_show(struct seq_file *sf, void *v)
 	cpu_uclamp_print(sf, UCLAMP_MAX);
 	return 0;
 }
+
+static void cpu_freq_update_eff(struct cgroup_subsys_state *css)
+{
+	struct cgroup_subsys_state *top_css = css;
+	unsigned int eff[UCLAMP_CNT];
+	enum uclamp_id clamp_id;
+
+	lockdep_assert_held(&uclamp_mutex);
+	SCHED_WARN_ON(!rcu_read_lock_held());
+
+	css_for_each_descendant_pre(css, top_css) {
+		struct task_group *tg = css_tg(css);
+
+		/* Cap the requested limits with the parent's effective ones */
+		for_each_clamp_id(clamp_id) {
+			eff[clamp_id] = tg->freq_req[clamp_id];
+			if (tg->parent)
+				eff[clamp_id] = min(eff[clamp_id],
+						    tg->parent->freq[clamp_id]);
+		}
+		eff[UCLAMP_MIN] = min(eff[UCLAMP_MIN], eff[UCLAMP_MAX]);
+
+		for_each_clamp_id(clamp_id)
+			WRITE_ONCE(tg->freq[clamp_id], eff[clamp_id]);
+	}
+}
+
+/*
+ * The frequency limits of a task group are applied by schedutil to the
+ * policies of the CPUs running its tasks, from the next context switch on.
+ */
+static ssize_t cpu_freq_write(struct kernfs_open_file *of, char *buf,
+			      size_t nbytes, loff_t off,
+			      enum uclamp_id clamp_id)
+{
+	unsigned int freq;
+
+	buf = strim(buf);
+	if (clamp_id == UCLAMP_MAX && !strcmp(buf, "max"))
+		freq = UINT_MAX;
+	else if (kstrtouint(buf, 0, &freq))
+		return -EINVAL;
+
+	static_branch_enable(&sched_cgroup_freq_used);
+
+	mutex_lock(&uclamp_mutex);
+	rcu_read_lock();
+
+	css_tg(of_css(of))->freq_req[clamp_id] = freq;
+	cpu_freq_update_eff(of_css(of));
+
+	rcu_read_unlock();
+	mutex_unlock(&uclamp_mutex);
+
+	return nbytes;
+}
+
+static ssize_t cpu_freq_min_write(struct kernfs_open_file *of,
+				  char *buf, size_t nbytes,
+				  loff_t off)
+{
+	return cpu_freq_write(of, buf, nbytes, off, UCLAMP_MIN);
+}
+
+static ssize_t cpu_freq_max_write(struct kernfs_open_file *of,
+				  char *buf, size_t nbytes,
+				  loff_t off)
+{
+	return cpu_freq_write(of, buf, nbytes, off, UCLAMP_MAX);
+}
+
+static inline void cpu_freq_print(struct seq_file *sf,
+				  enum uclamp_id clamp_id)
+{
+	unsigned int freq = READ_ONCE(css_tg(seq_css(sf))->freq_req[clamp_id]);
+
+	if (freq == UINT_MAX)
+		seq_puts(sf, "max\n");
+	else
+		seq_printf(sf, "%u\n", freq);
+}
+
+static int cpu_freq_min_show(struct seq_file *sf, void *v)
+{
+	cpu_freq_print(sf, UCLAMP_MIN);
+	return 0;
+}
+
+static int cpu_freq_max_show(struct seq_file *sf, void *v)
+{
+	cpu_freq_print(sf, UCLAMP_MAX);
+	return 0;
+}
 #endif /* CONFIG_UCLAMP_TASK_GROUP */
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
@@ -11269,6 +11411,18 @@ static struct cftype cpu_legacy_files[] = {
 		.seq_show = cpu_uclamp_max_show,
 		.write = cpu_uclamp_max_write,
 	},
+	{
+		.name = "freq.min",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = cpu_freq_min_show,
+		.write = cpu_freq_min_write,
+	},
+	{
+		.name = "freq.max",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = cpu_freq_max_show,
+		.write = cpu_freq_max_write,
+	},
 #endif
 	{ }	/* Terminate */
 };
@@ -11485,6 +11639,18 @@ static struct cftype cpu_files[] = {
 		.seq_show = cpu_uclamp_max_show,
 		.write = cpu_uclamp_max_write,
 	},
+	{
+		.name = "freq.min",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = cpu_freq_min_show,
+		.write = cpu_freq_min_write,
+	},
+	{
+		.name = "freq.max",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = cpu_freq_max_show,
+		.write = cpu_freq_max_write,
+	},
 #endif
 	{ }	/* terminate */
 };
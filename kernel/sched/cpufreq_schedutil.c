@@ -8,9 +8,16 @@
 
 #define IOWAIT_BOOST_MIN	(SCHED_CAPACITY_SCALE / 8)
 
+/* Shared policies with at least this many CPUs use a cached max utilization. */
+#define SUGOV_MAX_UTIL_CACHE_CPUS	8
+
 struct sugov_tunables {
 	struct gov_attr_set	attr_set;
 	unsigned int		rate_limit_us;
+	unsigned int		up_rate_limit_us;
+	unsigned int		down_rate_limit_us;
+	unsigned int		hysteresis_pct;
+	bool			freq_sensitivity;
 };
 
 struct sugov_policy {
@@ -22,6 +29,8 @@ struct sugov_policy {
 	raw_spinlock_t		update_lock;
 	u64			last_freq_update_time;
 	s64			freq_update_delay_ns;
+	s64			up_rate_delay_ns;
+	s64			down_rate_delay_ns;
 	unsigned int		next_freq;
 	unsigned int		cached_raw_freq;
 
@@ -30,11 +39,17 @@ struct sugov_policy {
 	struct			kthread_work work;
 	struct			mutex work_lock;
 	struct			kthread_worker worker;
+	struct kthread_worker	*kworker;	/* &worker or the node's one */
 	struct task_struct	*thread;
 	bool			work_in_progress;
 
 	bool			limits_changed;
 	bool			need_freq_update;
+
+	/* The next fields are only used by wide shared policies: */
+	bool			max_util_cached;
+	unsigned long		max_util;
+	unsigned int		max_util_cpu;
 };
 
 struct sugov_cpu {
@@ -48,6 +63,7 @@ struct sugov_cpu {
 
 	unsigned long		util;
 	unsigned long		bw_dl;
+	unsigned long		uclamp_min;
 
 	/* The field below is for single-CPU policies only: */
 #ifdef CONFIG_NO_HZ_COMMON
@@ -92,13 +108,35 @@ static bool sugov_should_update_freq(struct sugov_policy *sg_policy, u64 time)
 	return delta_ns >= sg_policy->freq_update_delay_ns;
 }
 
+/*
+ * The rate limit checked by sugov_should_update_freq() is the smaller one of
+ * the scale-up and scale-down rate limits, so check the one that applies to
+ * the direction of the change now that it is known.
+ */
+static bool sugov_up_down_rate_limit(struct sugov_policy *sg_policy, u64 time,
+				     bool up)
+{
+	s64 delta_ns = time - sg_policy->last_freq_update_time;
+
+	if (up)
+		return delta_ns < sg_policy->up_rate_delay_ns;
+
+	return delta_ns < sg_policy->down_rate_delay_ns;
+}
+
 static bool sugov_update_next_freq(struct sugov_policy *sg_policy, u64 time,
 				   unsigned int next_freq)
 {
-	if (sg_policy->need_freq_update)
+	if (sg_policy->need_freq_update) {
 		sg_policy->need_freq_update = cpufreq_driver_test_flags(CPUFREQ_NEED_UPDATE_LIMITS);
-	else if (sg_policy->next_freq == next_freq)
+	} else if (sg_policy->next_freq == next_freq) {
+		return false;
+	} else if (sugov_up_down_rate_limit(sg_policy, time,
+					    next_freq > sg_policy->next_freq)) {
+		/* Make get_next_freq() resolve the raw frequency next time. */
+		sg_policy->cached_raw_freq = 0;
 		return false;
+	}
 
 	sg_policy->next_freq = next_freq;
 	sg_policy->last_freq_update_time = time;
@@ -114,6 +152,39 @@ static void sugov_deferred_update(struct sugov_policy *sg_policy)
 	}
 }
 
+/*
+ * Clamp @freq to the cgroup frequency limits of the CPUs of the policy. The
+ * least restrictive ones win, so a shared policy is only capped when all of
+ * its CPUs run tasks of capped groups.
+ */
+static unsigned int sugov_cgroup_freq_clamp(struct sugov_policy *sg_policy,
+					    unsigned int freq)
+{
+	unsigned int lo = 0, hi = 0;
+	bool busy = false;
+	unsigned int cpu;
+
+	if (!cgroup_freq_used())
+		return freq;
+
+	/*
+	 * Idle CPUs do not need any particular frequency, so only the limits
+	 * of the groups running on the busy ones count.
+	 */
+	for_each_cpu(cpu, sg_policy->policy->cpus) {
+		struct rq *rq = cpu_rq(cpu);
+
+		if (idle_cpu(cpu))
+			continue;
+
+		lo = max(lo, cgroup_freq_rq_get(rq, UCLAMP_MIN));
+		hi = max(hi, cgroup_freq_rq_get(rq, UCLAMP_MAX));
+		busy = true;
+	}
+
+	return busy ? clamp(freq, lo, hi) : freq;
+}
+
 /**
  * get_next_freq - Compute a new frequency for a given cpufreq policy.
  * @sg_policy: schedutil policy object to compute the new frequency for.
@@ -132,9 +203,15 @@ static void sugov_deferred_update(struct sugov_policy *sg_policy)
  *
  * Take C = 1.25 for the frequency tipping point at (util / max) = 0.8.
  *
+ * The result is clamped to the frequency limits of the cgroups running on the
+ * CPUs of the policy, if any.
+ *
  * The lowest driver-supported frequency which is equal or greater than the raw
  * next_freq (as calculated above) is returned, subject to policy min/max and
  * cpufreq driver limitations.
+ *
+ * If the raw next_freq is below the current one by less than hysteresis_pct
+ * percent of it, the current frequency is retained.
  */
 static unsigned int get_next_freq(struct sugov_policy *sg_policy,
 				  unsigned long util, unsigned long max)
@@ -142,13 +219,21 @@ static unsigned int get_next_freq(struct sugov_policy *sg_policy,
 	struct cpufreq_policy *policy = sg_policy->policy;
 	unsigned int freq = arch_scale_freq_invariant() ?
 				policy->cpuinfo.max_freq : policy->cur;
+	unsigned int hysteresis_pct;
 
 	util = map_util_perf(util);
 	freq = map_util_freq(util, freq, max);
+	freq = sugov_cgroup_freq_clamp(sg_policy, freq);
 
 	if (freq == sg_policy->cached_raw_freq && !sg_policy->need_freq_update)
 		return sg_policy->next_freq;
 
+	hysteresis_pct = READ_ONCE(sg_policy->tunables->hysteresis_pct);
+	if (hysteresis_pct && !sg_policy->need_freq_update &&
+	    freq < sg_policy->next_freq &&
+	    (u64)freq * 100 > (u64)sg_policy->next_freq * (100 - hysteresis_pct))
+		return sg_policy->next_freq;
+
 	sg_policy->cached_raw_freq = freq;
 	return cpufreq_driver_resolve_freq(policy, freq);
 }
@@ -159,8 +244,21 @@ static void sugov_get_util(struct sugov_cpu *sg_cpu)
 	struct rq *rq = cpu_rq(sg_cpu->cpu);
 
 	sg_cpu->bw_dl = cpu_bw_dl(rq);
+	sg_cpu->uclamp_min = uclamp_rq_get(rq, UCLAMP_MIN);
 	sg_cpu->util = effective_cpu_util(sg_cpu->cpu, util,
 					  FREQUENCY_UTIL, NULL);
+
+	/*
+	 * Running a CPU that is stalled on memory faster makes it stall more
+	 * rather than finish earlier, so only ask for the part of the
+	 * utilization that scales with the frequency.  The DL bandwidth is
+	 * still guaranteed.
+	 */
+	if (READ_ONCE(sg_cpu->sg_policy->tunables->freq_sensitivity)) {
+		util = sg_cpu->util * arch_scale_freq_sensitivity(sg_cpu->cpu);
+		util >>= SCHED_CAPACITY_SHIFT;
+		sg_cpu->util = max(util, sg_cpu->bw_dl);
+	}
 }
 
 /**
@@ -310,6 +408,27 @@ static inline void ignore_dl_rate_limit(struct sugov_cpu *sg_cpu)
 		sg_cpu->sg_policy->limits_changed = true;
 }
 
+/*
+ * Likewise, let a task with a raised utilization floor get it immediately
+ * instead of waiting for the rate limit to expire.  Only increases are taken
+ * into account, so this cannot cause more than one extra update per rate
+ * limit period.
+ */
+static inline void ignore_uclamp_rate_limit(struct sugov_cpu *sg_cpu)
+{
+	if (uclamp_is_used() &&
+	    uclamp_rq_get(cpu_rq(sg_cpu->cpu), UCLAMP_MIN) > sg_cpu->uclamp_min)
+		sg_cpu->sg_policy->limits_changed = true;
+}
+
+/* New cgroup frequency limits are applied right away, like policy limits. */
+static inline void ignore_cgroup_rate_limit(struct sugov_cpu *sg_cpu,
+					    unsigned int flags)
+{
+	if (flags & SCHED_CPUFREQ_CGROUP_LIMITS)
+		sg_cpu->sg_policy->limits_changed = true;
+}
+
 static inline bool sugov_update_single_common(struct sugov_cpu *sg_cpu,
 					      u64 time, unsigned long max_cap,
 					      unsigned int flags)
@@ -318,6 +437,8 @@ static inline bool sugov_update_single_common(struct sugov_cpu *sg_cpu,
 	sg_cpu->last_update = time;
 
 	ignore_dl_rate_limit(sg_cpu);
+	ignore_uclamp_rate_limit(sg_cpu);
+	ignore_cgroup_rate_limit(sg_cpu, flags);
 
 	if (!sugov_should_update_freq(sg_cpu->sg_policy, time))
 		return false;
@@ -347,9 +468,11 @@ static void sugov_update_single_freq(struct update_util_data *hook, u64 time,
 	 * Do not reduce the frequency if the CPU has not been idle
 	 * recently, as the reduction is likely to be premature then.
 	 *
-	 * Except when the rq is capped by uclamp_max.
+	 * Except when the rq is capped by uclamp_max or by a cgroup frequency
+	 * limit.
 	 */
 	if (!uclamp_rq_is_capped(cpu_rq(sg_cpu->cpu)) &&
+	    cgroup_freq_rq_get(cpu_rq(sg_cpu->cpu), UCLAMP_MAX) == UINT_MAX &&
 	    sugov_cpu_is_busy(sg_cpu) && next_f < sg_policy->next_freq) {
 		next_f = sg_policy->next_freq;
 
@@ -357,6 +480,9 @@ static void sugov_update_single_freq(struct update_util_data *hook, u64 time,
 		sg_policy->cached_raw_freq = cached_freq;
 	}
 
+	trace_sugov_next_freq_tp(sg_policy->policy, sg_cpu->cpu, sg_cpu->util,
+				 max_cap, next_f);
+
 	if (!sugov_update_next_freq(sg_policy, time, next_f))
 		return;
 
@@ -379,14 +505,16 @@ static void sugov_update_single_perf(struct update_util_data *hook, u64 time,
 {
 	struct sugov_cpu *sg_cpu = container_of(hook, struct sugov_cpu, update_util);
 	unsigned long prev_util = sg_cpu->util;
-	unsigned long max_cap;
+	unsigned long max_cap, min_util;
 
 	/*
 	 * Fall back to the "frequency" path if frequency invariance is not
 	 * supported, because the direct mapping between the utilization and
-	 * the performance levels depends on the frequency invariance.
+	 * the performance levels depends on the frequency invariance.  Also
+	 * do that if cgroup frequency limits are used, as they are applied to
+	 * frequencies.
 	 */
-	if (!arch_scale_freq_invariant()) {
+	if (!arch_scale_freq_invariant() || cgroup_freq_used()) {
 		sugov_update_single_freq(hook, time, flags);
 		return;
 	}
@@ -406,31 +534,113 @@ static void sugov_update_single_perf(struct update_util_data *hook, u64 time,
 	    sugov_cpu_is_busy(sg_cpu) && sg_cpu->util < prev_util)
 		sg_cpu->util = prev_util;
 
-	cpufreq_driver_adjust_perf(sg_cpu->cpu, map_util_perf(sg_cpu->bw_dl),
+	/*
+	 * Apply the rate limit for the direction of the change and keep the
+	 * utilization that was used last time if the update is rejected.
+	 */
+	if (sg_cpu->util != prev_util &&
+	    sugov_up_down_rate_limit(sg_cpu->sg_policy, time,
+				     sg_cpu->util > prev_util)) {
+		sg_cpu->util = prev_util;
+		return;
+	}
+
+	/*
+	 * Pass the utilization floor of the runnable tasks as the minimum, so
+	 * that the hardware does not go below it while autonomously adjusting
+	 * the performance between the updates.
+	 */
+	min_util = max(sg_cpu->bw_dl, sg_cpu->uclamp_min);
+
+	trace_sugov_adjust_perf_tp(sg_cpu->cpu, min_util, sg_cpu->util, max_cap);
+
+	cpufreq_driver_adjust_perf(sg_cpu->cpu, map_util_perf(min_util),
 				   map_util_perf(sg_cpu->util), max_cap);
 
 	sg_cpu->sg_policy->last_freq_update_time = time;
 }
 
-static unsigned int sugov_next_freq_shared(struct sugov_cpu *sg_cpu, u64 time)
+/*
+ * Compute the maximum utilization across the policy.  The utilization of
+ * @done, if any, is up to date already, so do not compute it (and apply the IO
+ * boost to it) again.
+ */
+static unsigned long sugov_max_util_shared(struct sugov_policy *sg_policy,
+					   u64 time, unsigned long max_cap,
+					   struct sugov_cpu *done)
 {
-	struct sugov_policy *sg_policy = sg_cpu->sg_policy;
 	struct cpufreq_policy *policy = sg_policy->policy;
-	unsigned long util = 0, max_cap;
+	unsigned long util = 0;
 	unsigned int j;
 
-	max_cap = arch_scale_cpu_capacity(sg_cpu->cpu);
+	sg_policy->max_util_cpu = cpumask_first(policy->cpus);
 
 	for_each_cpu(j, policy->cpus) {
 		struct sugov_cpu *j_sg_cpu = &per_cpu(sugov_cpu, j);
 
-		sugov_get_util(j_sg_cpu);
-		sugov_iowait_apply(j_sg_cpu, time, max_cap);
+		if (j_sg_cpu != done) {
+			sugov_get_util(j_sg_cpu);
+			sugov_iowait_apply(j_sg_cpu, time, max_cap);
+		}
+
+		if (j_sg_cpu->util > util) {
+			util = j_sg_cpu->util;
+			sg_policy->max_util_cpu = j;
+		}
+	}
+
+	sg_policy->max_util = util;
+	return util;
+}
+
+/*
+ * For wide policies, avoid scanning all of the CPUs on every update by
+ * maintaining the maximum utilization across the policy along with the CPU
+ * that contributed it.  Only the utilization of the CPU being updated needs
+ * to be computed, unless that is the CPU holding the maximum and its
+ * utilization has dropped, or the maximum has not been refreshed by its CPU
+ * for more than a tick (i.e. it may be stale, because that CPU is idle).
+ */
+static unsigned long sugov_max_util_cached(struct sugov_cpu *sg_cpu, u64 time,
+					   unsigned long max_cap)
+{
+	struct sugov_policy *sg_policy = sg_cpu->sg_policy;
+	struct sugov_cpu *max_sg_cpu;
+
+	sugov_get_util(sg_cpu);
+	sugov_iowait_apply(sg_cpu, time, max_cap);
 
-		util = max(j_sg_cpu->util, util);
+	if (sg_cpu->util >= sg_policy->max_util) {
+		sg_policy->max_util = sg_cpu->util;
+		sg_policy->max_util_cpu = sg_cpu->cpu;
+		return sg_policy->max_util;
 	}
 
-	return get_next_freq(sg_policy, util, max_cap);
+	max_sg_cpu = &per_cpu(sugov_cpu, sg_policy->max_util_cpu);
+	if (max_sg_cpu == sg_cpu || time - max_sg_cpu->last_update > TICK_NSEC)
+		return sugov_max_util_shared(sg_policy, time, max_cap, sg_cpu);
+
+	return sg_policy->max_util;
+}
+
+static unsigned int sugov_next_freq_shared(struct sugov_cpu *sg_cpu, u64 time)
+{
+	struct sugov_policy *sg_policy = sg_cpu->sg_policy;
+	unsigned long util, max_cap;
+	unsigned int freq;
+
+	max_cap = arch_scale_cpu_capacity(sg_cpu->cpu);
+
+	if (sg_policy->max_util_cached)
+		util = sugov_max_util_cached(sg_cpu, time, max_cap);
+	else
+		util = sugov_max_util_shared(sg_policy, time, max_cap, NULL);
+
+	freq = get_next_freq(sg_policy, util, max_cap);
+	trace_sugov_next_freq_tp(sg_policy->policy, sg_cpu->cpu, util, max_cap,
+				 freq);
+
+	return freq;
 }
 
 static void
@@ -446,6 +656,8 @@ sugov_update_shared(struct update_util_data *hook, u64 time, unsigned int flags)
 	sg_cpu->last_update = time;
 
 	ignore_dl_rate_limit(sg_cpu);
+	ignore_uclamp_rate_limit(sg_cpu);
+	ignore_cgroup_rate_limit(sg_cpu, flags);
 
 	if (sugov_should_update_freq(sg_policy, time)) {
 		next_f = sugov_next_freq_shared(sg_cpu, time);
@@ -494,7 +706,7 @@ static void sugov_irq_work(struct irq_work *irq_work)
 
 	sg_policy = container_of(irq_work, struct sugov_policy, irq_work);
 
-	kthread_queue_work(&sg_policy->worker, &sg_policy->work);
+	kthread_queue_work(sg_policy->kworker, &sg_policy->work);
 }
 
 /************************** sysfs interface ************************/
@@ -507,6 +719,16 @@ static inline struct sugov_tunables *to_sugov_tunables(struct gov_attr_set *attr
 	return container_of(attr_set, struct sugov_tunables, attr_set);
 }
 
+static void sugov_update_rate_limits(struct sugov_policy *sg_policy)
+{
+	struct sugov_tunables *tunables = sg_policy->tunables;
+
+	sg_policy->up_rate_delay_ns = tunables->up_rate_limit_us * NSEC_PER_USEC;
+	sg_policy->down_rate_delay_ns = tunables->down_rate_limit_us * NSEC_PER_USEC;
+	sg_policy->freq_update_delay_ns = min(sg_policy->up_rate_delay_ns,
+					      sg_policy->down_rate_delay_ns);
+}
+
 static ssize_t rate_limit_us_show(struct gov_attr_set *attr_set, char *buf)
 {
 	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
@@ -525,17 +747,104 @@ rate_limit_us_store(struct gov_attr_set *attr_set, const char *buf, size_t count
 		return -EINVAL;
 
 	tunables->rate_limit_us = rate_limit_us;
+	tunables->up_rate_limit_us = rate_limit_us;
+	tunables->down_rate_limit_us = rate_limit_us;
 
 	list_for_each_entry(sg_policy, &attr_set->policy_list, tunables_hook)
-		sg_policy->freq_update_delay_ns = rate_limit_us * NSEC_PER_USEC;
+		sugov_update_rate_limits(sg_policy);
 
 	return count;
 }
 
 static struct governor_attr rate_limit_us = __ATTR_RW(rate_limit_us);
 
+#define sugov_rate_limit_attr(_name)					\
+static ssize_t _name##_show(struct gov_attr_set *attr_set, char *buf)	\
+{									\
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);	\
+									\
+	return sprintf(buf, "%u\n", tunables->_name);			\
+}									\
+									\
+static ssize_t _name##_store(struct gov_attr_set *attr_set,		\
+			     const char *buf, size_t count)		\
+{									\
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);	\
+	struct sugov_policy *sg_policy;					\
+	unsigned int val;						\
+									\
+	if (kstrtouint(buf, 10, &val))					\
+		return -EINVAL;						\
+									\
+	tunables->_name = val;						\
+									\
+	list_for_each_entry(sg_policy, &attr_set->policy_list, tunables_hook) \
+		sugov_update_rate_limits(sg_policy);			\
+									\
+	return count;							\
+}									\
+									\
+static struct governor_attr _name = __ATTR_RW(_name)
+
+sugov_rate_limit_attr(up_rate_limit_us);
+sugov_rate_limit_attr(down_rate_limit_us);
+
+static ssize_t hysteresis_pct_show(struct gov_attr_set *attr_set, char *buf)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+
+	return sprintf(buf, "%u\n", tunables->hysteresis_pct);
+}
+
+static ssize_t
+hysteresis_pct_store(struct gov_attr_set *attr_set, const char *buf, size_t count)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+	unsigned int hysteresis_pct;
+
+	if (kstrtouint(buf, 10, &hysteresis_pct) || hysteresis_pct >= 100)
+		return -EINVAL;
+
+	WRITE_ONCE(tunables->hysteresis_pct, hysteresis_pct);
+
+	return count;
+}
+
+static struct governor_attr hysteresis_pct = __ATTR_RW(hysteresis_pct);
+
+static ssize_t freq_sensitivity_show(struct gov_attr_set *attr_set, char *buf)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+
+	return sprintf(buf, "%u\n", tunables->freq_sensitivity);
+}
+
+static ssize_t
+freq_sensitivity_store(struct gov_attr_set *attr_set, const char *buf, size_t count)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+	bool freq_sensitivity;
+
+	if (kstrtobool(buf, &freq_sensitivity))
+		return -EINVAL;
+
+	/* Only sample the sensitivity while a policy is using it */
+	if (freq_sensitivity != tunables->freq_sensitivity)
+		arch_set_freq_sensitivity(freq_sensitivity);
+
+	WRITE_ONCE(tunables->freq_sensitivity, freq_sensitivity);
+
+	return count;
+}
+
+static struct governor_attr freq_sensitivity = __ATTR_RW(freq_sensitivity);
+
 static struct attribute *sugov_attrs[] = {
 	&rate_limit_us.attr,
+	&up_rate_limit_us.attr,
+	&down_rate_limit_us.attr,
+	&hysteresis_pct.attr,
+	&freq_sensitivity.attr,
 	NULL
 };
 ATTRIBUTE_GROUPS(sugov);
@@ -543,8 +852,12 @@ ATTRIBUTE_GROUPS(sugov);
 static void sugov_tunables_free(struct kobject *kobj)
 {
 	struct gov_attr_set *attr_set = to_gov_attr_set(kobj);
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
 
-	kfree(to_sugov_tunables(attr_set));
+	if (tunables->freq_sensitivity)
+		arch_set_freq_sensitivity(false);
+
+	kfree(tunables);
 }
 
 static const struct kobj_type sugov_tunables_ktype = {
@@ -575,65 +888,168 @@ static void sugov_policy_free(struct sugov_policy *sg_policy)
 	kfree(sg_policy);
 }
 
-static int sugov_kthread_create(struct sugov_policy *sg_policy)
+static const struct sched_attr sugov_thread_attr = {
+	.size		= sizeof(struct sched_attr),
+	.sched_policy	= SCHED_DEADLINE,
+	.sched_flags	= SCHED_FLAG_SUGOV,
+	.sched_nice	= 0,
+	.sched_priority	= 0,
+	/*
+	 * Fake (unused) bandwidth; workaround to "fix"
+	 * priority inheritance.
+	 */
+	.sched_runtime	=  1000000,
+	.sched_deadline = 10000000,
+	.sched_period	= 10000000,
+};
+
+static struct task_struct *sugov_thread_create(struct kthread_worker *worker,
+					       const struct cpumask *cpus,
+					       const char *name, int id)
 {
 	struct task_struct *thread;
-	struct sched_attr attr = {
-		.size		= sizeof(struct sched_attr),
-		.sched_policy	= SCHED_DEADLINE,
-		.sched_flags	= SCHED_FLAG_SUGOV,
-		.sched_nice	= 0,
-		.sched_priority	= 0,
-		/*
-		 * Fake (unused) bandwidth; workaround to "fix"
-		 * priority inheritance.
-		 */
-		.sched_runtime	=  1000000,
-		.sched_deadline = 10000000,
-		.sched_period	= 10000000,
-	};
-	struct cpufreq_policy *policy = sg_policy->policy;
 	int ret;
 
-	/* kthread only required for slow path */
-	if (policy->fast_switch_enabled)
-		return 0;
-
-	kthread_init_work(&sg_policy->work, sugov_work);
-	kthread_init_worker(&sg_policy->worker);
-	thread = kthread_create(kthread_worker_fn, &sg_policy->worker,
-				"sugov:%d",
-				cpumask_first(policy->related_cpus));
+	thread = kthread_create(kthread_worker_fn, worker, name, id);
 	if (IS_ERR(thread)) {
 		pr_err("failed to create sugov thread: %ld\n", PTR_ERR(thread));
-		return PTR_ERR(thread);
+		return thread;
 	}
 
-	ret = sched_setattr_nocheck(thread, &attr);
+	ret = sched_setattr_nocheck(thread, &sugov_thread_attr);
 	if (ret) {
 		kthread_stop(thread);
 		pr_warn("%s: failed to set SCHED_DEADLINE\n", __func__);
-		return ret;
+		return ERR_PTR(ret);
+	}
+
+	kthread_bind_mask(thread, cpus);
+	wake_up_process(thread);
+
+	return thread;
+}
+
+/*
+ * Single-CPU policies without fast switching share one worker thread per NUMA
+ * node instead of having a thread each.  Pending requests for all of those
+ * policies are then carried out in one wakeup of the worker and every policy
+ * still has at most one request in flight (see sugov_deferred_update()).
+ */
+struct sugov_node_worker {
+	struct kthread_worker	worker;
+	struct task_struct	*thread;
+	unsigned int		users;
+};
+
+static struct sugov_node_worker *sugov_node_workers[MAX_NUMNODES];
+static DEFINE_MUTEX(sugov_node_workers_lock);
+
+static struct kthread_worker *sugov_node_worker_get(int node)
+{
+	struct sugov_node_worker *nw;
+	struct task_struct *thread;
+
+	mutex_lock(&sugov_node_workers_lock);
+
+	nw = sugov_node_workers[node];
+	if (nw) {
+		nw->users++;
+		goto out;
+	}
+
+	nw = kzalloc_node(sizeof(*nw), GFP_KERNEL, node);
+	if (!nw)
+		goto out;
+
+	kthread_init_worker(&nw->worker);
+	thread = sugov_thread_create(&nw->worker, cpumask_of_node(node),
+				     "sugov_node:%d", node);
+	if (IS_ERR(thread)) {
+		kfree(nw);
+		nw = NULL;
+		goto out;
+	}
+
+	nw->thread = thread;
+	nw->users = 1;
+	sugov_node_workers[node] = nw;
+
+out:
+	mutex_unlock(&sugov_node_workers_lock);
+
+	return nw ? &nw->worker : NULL;
+}
+
+static void sugov_node_worker_put(int node)
+{
+	struct sugov_node_worker *nw;
+
+	mutex_lock(&sugov_node_workers_lock);
+
+	nw = sugov_node_workers[node];
+	if (!--nw->users) {
+		sugov_node_workers[node] = NULL;
+		kthread_flush_worker(&nw->worker);
+		kthread_stop(nw->thread);
+		kfree(nw);
+	}
+
+	mutex_unlock(&sugov_node_workers_lock);
+}
+
+static bool sugov_use_node_worker(struct cpufreq_policy *policy)
+{
+	return cpumask_weight(policy->related_cpus) == 1;
+}
+
+static int sugov_kthread_create(struct sugov_policy *sg_policy)
+{
+	struct cpufreq_policy *policy = sg_policy->policy;
+	struct task_struct *thread;
+
+	/* kthread only required for slow path */
+	if (policy->fast_switch_enabled)
+		return 0;
+
+	kthread_init_work(&sg_policy->work, sugov_work);
+
+	if (sugov_use_node_worker(policy)) {
+		sg_policy->kworker = sugov_node_worker_get(cpu_to_node(policy->cpu));
+		if (!sg_policy->kworker)
+			return -ENOMEM;
+	} else {
+		kthread_init_worker(&sg_policy->worker);
+		thread = sugov_thread_create(&sg_policy->worker,
+					     policy->related_cpus, "sugov:%d",
+					     cpumask_first(policy->related_cpus));
+		if (IS_ERR(thread))
+			return PTR_ERR(thread);
+
+		sg_policy->thread = thread;
+		sg_policy->kworker = &sg_policy->worker;
 	}
 
-	sg_policy->thread = thread;
-	kthread_bind_mask(thread, policy->related_cpus);
 	init_irq_work(&sg_policy->irq_work, sugov_irq_work);
 	mutex_init(&sg_policy->work_lock);
 
-	wake_up_process(thread);
-
 	return 0;
 }
 
 static void sugov_kthread_stop(struct sugov_policy *sg_policy)
 {
+	struct cpufreq_policy *policy = sg_policy->policy;
+
 	/* kthread only required for slow path */
-	if (sg_policy->policy->fast_switch_enabled)
+	if (policy->fast_switch_enabled)
 		return;
 
-	kthread_flush_worker(&sg_policy->worker);
-	kthread_stop(sg_policy->thread);
+	if (sugov_use_node_worker(policy)) {
+		kthread_flush_work(&sg_policy->work);
+		sugov_node_worker_put(cpu_to_node(policy->cpu));
+	} else {
+		kthread_flush_worker(&sg_policy->worker);
+		kthread_stop(sg_policy->thread);
+	}
 	mutex_destroy(&sg_policy->work_lock);
 }
 
@@ -699,6 +1115,8 @@ static int sugov_init(struct cpufreq_policy *policy)
 	}
 
 	tunables->rate_limit_us = cpufreq_policy_transition_delay_us(policy);
+	tunables->up_rate_limit_us = tunables->rate_limit_us;
+	tunables->down_rate_limit_us = tunables->rate_limit_us;
 
 	policy->governor_data = sg_policy;
 	sg_policy->tunables = tunables;
@@ -758,14 +1176,17 @@ static int sugov_start(struct cpufreq_policy *policy)
 	void (*uu)(struct update_util_data *data, u64 time, unsigned int flags);
 	unsigned int cpu;
 
-	sg_policy->freq_update_delay_ns	= sg_policy->tunables->rate_limit_us * NSEC_PER_USEC;
+	sugov_update_rate_limits(sg_policy);
 	sg_policy->last_freq_update_time	= 0;
 	sg_policy->next_freq			= 0;
 	sg_policy->work_in_progress		= false;
 	sg_policy->limits_changed		= false;
 	sg_policy->cached_raw_freq		= 0;
+	sg_policy->max_util			= 0;
+	sg_policy->max_util_cpu			= cpumask_first(policy->cpus);
 
 	sg_policy->need_freq_update = cpufreq_driver_test_flags(CPUFREQ_NEED_UPDATE_LIMITS);
+	sg_policy->max_util_cached = cpumask_weight(policy->cpus) >= SUGOV_MAX_UTIL_CACHE_CPUS;
 
 	for_each_cpu(cpu, policy->cpus) {
 		struct sugov_cpu *sg_cpu = &per_cpu(sugov_cpu, cpu);
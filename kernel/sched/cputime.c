@@ -1100,3 +1100,96 @@ void kcpustat_cpu_fetch(struct kernel_cpustat *dst, int cpu)
 EXPORT_SYMBOL_GPL(kcpustat_cpu_fetch);
 
 #endif /* CONFIG_VIRT_CPU_ACCOUNTING_GEN */
+
+#ifdef CONFIG_ENERGY_MODEL
+/*
+ * Power of the Energy Model performance state the current frequency of a CPU
+ * maps to, and the frequency invariance scale it has been looked up for.  The
+ * power is 0 if the EM of the CPU is not in micro-Watts.
+ */
+struct sched_energy_power {
+	unsigned long scale;
+	unsigned long power;
+};
+
+static DEFINE_PER_CPU(struct sched_energy_power, sched_energy_power);
+
+static bool sched_energy_em_usable(struct em_perf_domain *pd)
+{
+	return pd && pd->flags & EM_PERF_DOMAIN_MICROWATTS &&
+	       !em_is_artificial(pd);
+}
+
+/**
+ * sched_energy_update_power - Refresh the power used for the energy estimates
+ * @cpu: the local CPU
+ *
+ * Called from the tick, after the frequency invariance scale of @cpu has been
+ * updated.  Once the power is known, the Energy Model is only looked up again
+ * if the scale has changed, so the estimates lag frequency changes by one tick
+ * at most.  Without frequency invariance the highest performance state is
+ * used.
+ */
+void sched_energy_update_power(int cpu)
+{
+	struct sched_energy_power *ep = per_cpu_ptr(&sched_energy_power, cpu);
+	unsigned long scale = arch_scale_freq_capacity(cpu);
+	struct em_perf_domain *pd = em_cpu_get(cpu);
+	struct em_perf_state *table;
+	unsigned long freq, power = 0;
+
+	/* Keep looking until the EM shows up, it may be registered late. */
+	if (scale == ep->scale && ep->power)
+		return;
+
+	if (sched_energy_em_usable(pd)) {
+		rcu_read_lock();
+		table = em_perf_state_from_pd(pd);
+		freq = table[pd->nr_perf_states - 1].frequency;
+		freq = (freq * scale) >> SCHED_CAPACITY_SHIFT;
+		power = em_pd_get_efficient_state(pd, freq)->power;
+		rcu_read_unlock();
+	}
+
+	ep->scale = scale;
+	WRITE_ONCE(ep->power, power);
+}
+
+/**
+ * sched_energy_estimate - Estimate the energy used by running on this CPU
+ * @delta_ns: time spent running
+ *
+ * The power is the one cached by sched_energy_update_power(), so estimating
+ * the energy reads no hardware counters and does not look up the Energy Model
+ * on every runtime update.
+ *
+ * Must be called with preemption disabled.
+ *
+ * Return: the energy in nJ, or 0 if the CPU has no Energy Model in
+ * micro-Watts.
+ */
+u64 sched_energy_estimate(u64 delta_ns)
+{
+	unsigned long power = READ_ONCE(this_cpu_ptr(&sched_energy_power)->power);
+
+	/* uW * ns = fJ, 10^6 of which make a nJ */
+	return div_u64((u64)power * delta_ns, 1000000);
+}
+
+/**
+ * sched_energy_available - Check if the energy of the CPUs can be estimated
+ *
+ * Return: true if at least one CPU has an Energy Model in micro-Watts.
+ */
+bool sched_energy_available(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		if (sched_energy_em_usable(em_cpu_get(cpu)))
+			return true;
+	}
+
+	return false;
+}
+#endif /* CONFIG_ENERGY_MODEL */
@@ -99,6 +99,18 @@ static int __init setup_sched_thermal_decay_shift(char *str)
 }
 __setup("sched_thermal_decay_shift=", setup_sched_thermal_decay_shift);
 
+#ifdef CONFIG_SCHED_THERMAL_PRESSURE
+/*
+ * When set, task placement uses the PELT average of the thermal pressure,
+ * extrapolated along its trend by sysctl_sched_thermal_forecast PELT periods,
+ * instead of the instantaneous capped capacity.
+ *
+ * (default: off, 8 periods)
+ */
+static unsigned int sysctl_sched_thermal_filter;
+static unsigned int sysctl_sched_thermal_forecast = 8;
+#endif
+
 #ifdef CONFIG_SMP
 /*
  * For asym packing, by default the lower numbered CPU has higher priority.
@@ -172,6 +184,26 @@ static struct ctl_table sched_fair_sysctls[] = {
 		.extra1		= SYSCTL_ZERO,
 	},
 #endif /* CONFIG_NUMA_BALANCING */
+#ifdef CONFIG_SCHED_THERMAL_PRESSURE
+	{
+		.procname	= "sched_thermal_filter",
+		.data		= &sysctl_sched_thermal_filter,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= SYSCTL_ONE,
+	},
+	{
+		.procname	= "sched_thermal_forecast_periods",
+		.data		= &sysctl_sched_thermal_forecast,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= SYSCTL_ONE_HUNDRED,
+	},
+#endif
 	{}
 };
 
@@ -4721,6 +4753,30 @@ static inline void util_est_update(struct cfs_rq *cfs_rq,
 	trace_sched_util_est_se_tp(&p->se);
 }
 
+/*
+ * Thermal pressure seen by task placement. Unless the filter is enabled this
+ * is the instantaneous capped capacity. Otherwise it is the PELT average of
+ * the thermal pressure moved along its trend, so that a short throttling
+ * step doesn't bounce tasks between CPUs but sustained throttling is
+ * anticipated.
+ */
+static unsigned long cpu_thermal_pressure(int cpu)
+{
+#ifdef CONFIG_SCHED_THERMAL_PRESSURE
+	if (READ_ONCE(sysctl_sched_thermal_filter)) {
+		struct rq *rq = cpu_rq(cpu);
+		long pressure = thermal_load_avg(rq);
+
+		pressure += READ_ONCE(rq->thermal_trend) *
+			    (long)READ_ONCE(sysctl_sched_thermal_forecast) /
+			    (1L << THERMAL_TREND_FRAC_SHIFT);
+
+		return clamp_t(long, pressure, 0, capacity_orig_of(cpu));
+	}
+#endif
+	return arch_scale_thermal_pressure(cpu);
+}
+
 static inline int util_fits_cpu(unsigned long util,
 				unsigned long uclamp_min,
 				unsigned long uclamp_max,
@@ -4759,7 +4815,7 @@ static inline int util_fits_cpu(unsigned long util,
 	 * goal is to cap the task. So it's okay if it's getting less.
 	 */
 	capacity_orig = capacity_orig_of(cpu);
-	capacity_orig_thermal = capacity_orig - arch_scale_thermal_pressure(cpu);
+	capacity_orig_thermal = capacity_orig - cpu_thermal_pressure(cpu);
 
 	/*
 	 * We want to force a task to fit a cpu as implied by uclamp_max.
@@ -6471,8 +6527,14 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	 * utilization updates, so do it here explicitly with the IOWAIT flag
 	 * passed.
 	 */
-	if (p->in_iowait)
-		cpufreq_update_util(rq, SCHED_CPUFREQ_IOWAIT);
+	if (p->in_iowait) {
+		unsigned int flags = SCHED_CPUFREQ_IOWAIT;
+
+		if (uclamp_is_used() && uclamp_eff_value(p, UCLAMP_MIN))
+			flags |= SCHED_CPUFREQ_IOWAIT_UCLAMP;
+
+		cpufreq_update_util(rq, flags);
+	}
 
 	for_each_sched_entity(se) {
 		if (se->on_rq)
@@ -7509,12 +7571,20 @@ static unsigned long cpu_util_without(int cpu, struct task_struct *p)
  *                  placement. Given by eenv_task_busy_time().
  * @pd_busy_time:   Utilization of the whole perf domain without the task
  *                  contribution. Given by eenv_pd_busy_time().
+ * @pd_max_util:    Highest frequency-selection utilization of the perf domain
+ *                  CPUs without the task contribution, on @pd_max_cpu.
+ * @pd_max_cpu:     CPU with @pd_max_util.
+ * @pd_next_util:   Highest such utilization of the other CPUs of the domain.
+ *                  The three are given by eenv_pd_busy_time() too.
  * @cpu_cap:        Maximum CPU capacity for the perf domain.
  * @pd_cap:         Entire perf domain capacity. (pd->nr_cpus * cpu_cap).
  */
 struct energy_env {
 	unsigned long task_busy_time;
 	unsigned long pd_busy_time;
+	unsigned long pd_max_util;
+	unsigned long pd_next_util;
+	int pd_max_cpu;
 	unsigned long cpu_cap;
 	unsigned long pd_cap;
 };
@@ -7559,6 +7629,11 @@ static inline void eenv_task_busy_time(struct energy_env *eenv,
  *
  * Set @eenv busy time for the PD that spans @pd_cpus. This busy time can't
  * exceed @eenv->pd_cap.
+ *
+ * The utilization that selects the PD frequency, without the task either, is
+ * collected in the same pass. Placing @p on a CPU only changes the
+ * utilization of that CPU, so eenv_pd_max_util() can then evaluate any
+ * candidate without walking the PD again.
  */
 static inline void eenv_pd_busy_time(struct energy_env *eenv,
 				     struct cpumask *pd_cpus,
@@ -7567,10 +7642,32 @@ static inline void eenv_pd_busy_time(struct energy_env *eenv,
 	unsigned long busy_time = 0;
 	int cpu;
 
+	eenv->pd_max_util = 0;
+	eenv->pd_next_util = 0;
+	eenv->pd_max_cpu = -1;
+
 	for_each_cpu(cpu, pd_cpus) {
 		unsigned long util = cpu_util(cpu, p, -1, 0);
+		unsigned long eff_util;
 
 		busy_time += effective_cpu_util(cpu, util, ENERGY_UTIL, NULL);
+
+		/*
+		 * Performance domain frequency: utilization clamping
+		 * must be considered since it affects the selection
+		 * of the performance domain frequency.
+		 * NOTE: in case RT tasks are running, by default the
+		 * FREQUENCY_UTIL's utilization can be max OPP.
+		 */
+		util = cpu_util(cpu, p, -1, 1);
+		eff_util = effective_cpu_util(cpu, util, FREQUENCY_UTIL, NULL);
+		if (eenv->pd_max_cpu < 0 || eff_util > eenv->pd_max_util) {
+			eenv->pd_next_util = eenv->pd_max_util;
+			eenv->pd_max_util = eff_util;
+			eenv->pd_max_cpu = cpu;
+		} else {
+			eenv->pd_next_util = max(eenv->pd_next_util, eff_util);
+		}
 	}
 
 	eenv->pd_busy_time = min(eenv->pd_cap, busy_time);
@@ -7578,31 +7675,26 @@ static inline void eenv_pd_busy_time(struct energy_env *eenv,
 
 /*
  * Compute the maximum utilization for compute_energy() when the task @p
- * is placed on the cpu @dst_cpu.
+ * is placed on the cpu @dst_cpu, from the PD utilization collected by
+ * eenv_pd_busy_time().
  *
  * Returns the maximum utilization among @eenv->cpus. This utilization can't
  * exceed @eenv->cpu_cap.
  */
 static inline unsigned long
-eenv_pd_max_util(struct energy_env *eenv, struct cpumask *pd_cpus,
-		 struct task_struct *p, int dst_cpu)
+eenv_pd_max_util(struct energy_env *eenv, struct task_struct *p, int dst_cpu)
 {
-	unsigned long max_util = 0;
-	int cpu;
+	unsigned long max_util = eenv->pd_max_util;
 
-	for_each_cpu(cpu, pd_cpus) {
-		struct task_struct *tsk = (cpu == dst_cpu) ? p : NULL;
-		unsigned long util = cpu_util(cpu, p, dst_cpu, 1);
+	if (dst_cpu >= 0) {
+		unsigned long util = cpu_util(dst_cpu, p, dst_cpu, 1);
 		unsigned long eff_util;
 
-		/*
-		 * Performance domain frequency: utilization clamping
-		 * must be considered since it affects the selection
-		 * of the performance domain frequency.
-		 * NOTE: in case RT tasks are running, by default the
-		 * FREQUENCY_UTIL's utilization can be max OPP.
-		 */
-		eff_util = effective_cpu_util(cpu, util, FREQUENCY_UTIL, tsk);
+		/* The other CPUs are not affected by the placement of @p */
+		if (dst_cpu == eenv->pd_max_cpu)
+			max_util = eenv->pd_next_util;
+
+		eff_util = effective_cpu_util(dst_cpu, util, FREQUENCY_UTIL, p);
 		max_util = max(max_util, eff_util);
 	}
 
@@ -7616,9 +7708,9 @@ eenv_pd_max_util(struct energy_env *eenv, struct cpumask *pd_cpus,
  */
 static inline unsigned long
 compute_energy(struct energy_env *eenv, struct perf_domain *pd,
-	       struct cpumask *pd_cpus, struct task_struct *p, int dst_cpu)
+	       struct task_struct *p, int dst_cpu)
 {
-	unsigned long max_util = eenv_pd_max_util(eenv, pd_cpus, p, dst_cpu);
+	unsigned long max_util = eenv_pd_max_util(eenv, p, dst_cpu);
 	unsigned long busy_time = eenv->pd_busy_time;
 
 	if (dst_cpu >= 0)
@@ -7722,7 +7814,7 @@ static int find_energy_efficient_cpu(struct task_struct *p, int prev_cpu)
 		/* Account thermal pressure for the energy estimation */
 		cpu = cpumask_first(cpus);
 		cpu_thermal_cap = arch_scale_cpu_capacity(cpu);
-		cpu_thermal_cap -= arch_scale_thermal_pressure(cpu);
+		cpu_thermal_cap -= cpu_thermal_pressure(cpu);
 
 		eenv.cpu_cap = cpu_thermal_cap;
 		eenv.pd_cap = 0;
@@ -7791,12 +7883,11 @@ static int find_energy_efficient_cpu(struct task_struct *p, int prev_cpu)
 
 		eenv_pd_busy_time(&eenv, cpus, p);
 		/* Compute the 'base' energy of the pd, without @p */
-		base_energy = compute_energy(&eenv, pd, cpus, p, -1);
+		base_energy = compute_energy(&eenv, pd, p, -1);
 
 		/* Evaluate the energy impact of using prev_cpu. */
 		if (prev_spare_cap > 0) {
-			prev_delta = compute_energy(&eenv, pd, cpus, p,
-						    prev_cpu);
+			prev_delta = compute_energy(&eenv, pd, p, prev_cpu);
 			/* CPU utilization has changed */
 			if (prev_delta < base_energy)
 				goto unlock;
@@ -7819,7 +7910,7 @@ static int find_energy_efficient_cpu(struct task_struct *p, int prev_cpu)
 			    (cpu_thermal_cap <= best_thermal_cap))
 				continue;
 
-			cur_delta = compute_energy(&eenv, pd, cpus, p,
+			cur_delta = compute_energy(&eenv, pd, p,
 						   max_spare_cap_cpu);
 			/* CPU utilization has changed */
 			if (cur_delta < base_energy)
@@ -89,3 +89,10 @@ SCHED_FEAT(UTIL_EST_FASTUP, true)
 SCHED_FEAT(LATENCY_WARN, false)
 
 SCHED_FEAT(HZ_BW, true)
+
+/*
+ * Keep the tick running on idle entry, although the cpuidle governor
+ * asked for it to be stopped, after a few idle periods in a row ended
+ * before the next tick would have occurred anyway.
+ */
+SCHED_FEAT(IDLE_TICK_HYSTERESIS, false)
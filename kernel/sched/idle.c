@@ -134,6 +134,41 @@ static int call_cpuidle(struct cpuidle_driver *drv, struct cpuidle_device *dev,
 	return cpuidle_enter(drv, dev, next_state);
 }
 
+/*
+ * Stopping the tick only pays off if the CPU stays idle past the next tick.
+ * Count the idle periods in a row with a stopped tick that ended earlier
+ * than that and, with IDLE_TICK_HYSTERESIS, keep the tick running once there
+ * have been IDLE_TICK_CHURN of them.  Every idle period that lasts at least
+ * half a tick with the tick kept running that way brings the CPU closer to
+ * stopping the tick again.
+ */
+#define IDLE_TICK_CHURN		3
+
+static DEFINE_PER_CPU(unsigned int, idle_tick_churn);
+
+static bool idle_tick_keep(bool stop_tick)
+{
+	if (!sched_feat(IDLE_TICK_HYSTERESIS) || !stop_tick ||
+	    tick_nohz_tick_stopped())
+		return false;
+
+	return __this_cpu_read(idle_tick_churn) >= IDLE_TICK_CHURN;
+}
+
+static void idle_tick_update(struct cpuidle_device *dev, bool stopped,
+			     bool kept)
+{
+	unsigned int churn = __this_cpu_read(idle_tick_churn);
+
+	if (stopped)
+		churn = dev->last_residency_ns < TICK_NSEC ?
+			min(churn + 1, IDLE_TICK_CHURN) : 0;
+	else if (kept && churn && dev->last_residency_ns >= TICK_NSEC / 2)
+		churn--;
+
+	__this_cpu_write(idle_tick_churn, churn);
+}
+
 /**
  * cpuidle_idle_call - the main idle function
  *
@@ -200,19 +235,24 @@ static void cpuidle_idle_call(void)
 		next_state = cpuidle_find_deepest_state(drv, dev, max_latency_ns);
 		call_cpuidle(drv, dev, next_state);
 	} else {
-		bool stop_tick = true;
+		bool stop_tick = true, keep_tick, stopped;
 
 		/*
 		 * Ask the cpuidle framework to choose a convenient idle state.
 		 */
 		next_state = cpuidle_select(drv, dev, &stop_tick);
 
-		if (stop_tick || tick_nohz_tick_stopped())
+		keep_tick = idle_tick_keep(stop_tick);
+		stopped = stop_tick && !keep_tick && !tick_nohz_tick_stopped();
+
+		if ((stop_tick && !keep_tick) || tick_nohz_tick_stopped())
 			tick_nohz_idle_stop_tick();
 		else
 			tick_nohz_idle_retain_tick();
 
 		entered_state = call_cpuidle(drv, dev, next_state);
+		if (entered_state >= 0)
+			idle_tick_update(dev, stopped, keep_tick);
 		/*
 		 * Give the governor an opportunity to reflect on the outcome
 		 */
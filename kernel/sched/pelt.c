@@ -400,13 +400,46 @@ int update_dl_rq_load_avg(u64 now, struct rq *rq, int running)
  *			capped capacity a cpu due to a thermal event.
  */
 
+/*
+ * The trend of the thermal pressure is an exponential moving average of the
+ * change of avg_thermal.load_avg per PELT period, so a single step of the
+ * capped capacity doesn't move it much while sustained throttling does.  It
+ * is kept with THERMAL_TREND_FRAC_SHIFT fractional bits, so that it decays
+ * all the way to zero when the pressure stops changing.
+ */
+#define THERMAL_TREND_SHIFT	3
+
+static void update_thermal_trend(struct rq *rq, unsigned long prev,
+				 u64 prev_update)
+{
+	long delta = (long)rq->avg_thermal.load_avg - (long)prev;
+	long trend = rq->thermal_trend;
+	u64 periods;
+
+	/*
+	 * An update may span several periods, depending on HZ and on how long
+	 * the CPU has been idle.  Little is left of the old average after eight
+	 * half-lives, so more periods need not be told apart.
+	 */
+	periods = (rq->avg_thermal.last_update_time - prev_update) >> 20;
+	periods = clamp_t(u64, periods, 1, 8 * LOAD_AVG_PERIOD);
+
+	delta = delta * (1L << THERMAL_TREND_FRAC_SHIFT) / (long)periods;
+	trend += (delta - trend) / (1 << THERMAL_TREND_SHIFT);
+	WRITE_ONCE(rq->thermal_trend, trend);
+}
+
 int update_thermal_load_avg(u64 now, struct rq *rq, u64 capacity)
 {
+	unsigned long prev = rq->avg_thermal.load_avg;
+	u64 prev_update = rq->avg_thermal.last_update_time;
+
 	if (___update_load_sum(now, &rq->avg_thermal,
 			       capacity,
 			       capacity,
 			       capacity)) {
 		___update_load_avg(&rq->avg_thermal, 1);
+		update_thermal_trend(rq, prev, prev_update);
 		trace_pelt_thermal_tp(rq);
 		return 1;
 	}
@@ -8,6 +8,9 @@ int update_rt_rq_load_avg(u64 now, struct rq *rq, int running);
 int update_dl_rq_load_avg(u64 now, struct rq *rq, int running);
 
 #ifdef CONFIG_SCHED_THERMAL_PRESSURE
+/* Fractional bits of rq->thermal_trend, the pressure change per PELT period */
+#define THERMAL_TREND_FRAC_SHIFT	10
+
 int update_thermal_load_avg(u64 now, struct rq *rq, u64 capacity);
 
 static inline u64 thermal_load_avg(struct rq *rq)
@@ -153,6 +153,19 @@ static int __init setup_psi(char *str)
 }
 __setup("psi=", setup_psi);
 
+/*
+ * Cgroups deeper than psi_max_depth levels below the root share the pressure
+ * accounting of their ancestor at that depth, so task state changes update at
+ * most psi_max_depth + 1 groups.  Their pressure files show the pressure of
+ * that ancestor.
+ */
+static unsigned int psi_max_depth __read_mostly = UINT_MAX;
+static int __init setup_psi_max_depth(char *str)
+{
+	return kstrtouint(str, 0, &psi_max_depth) == 0;
+}
+__setup("psi_max_depth=", setup_psi_max_depth);
+
 /* Running averages - we need to be higher-res than loadavg */
 #define PSI_FREQ	(2*HZ+1)	/* 2 sec intervals */
 #define EXP_10s		1677		/* 1/exp(2s/10s) as fixed-point */
@@ -1102,6 +1115,11 @@ int psi_cgroup_alloc(struct cgroup *cgroup)
 	if (!static_branch_likely(&psi_cgroups_enabled))
 		return 0;
 
+	if (cgroup->level > psi_max_depth) {
+		cgroup->psi = cgroup_psi(cgroup_parent(cgroup));
+		return 0;
+	}
+
 	cgroup->psi = kzalloc(sizeof(struct psi_group), GFP_KERNEL);
 	if (!cgroup->psi)
 		return -ENOMEM;
@@ -1121,6 +1139,10 @@ void psi_cgroup_free(struct cgroup *cgroup)
 	if (!static_branch_likely(&psi_cgroups_enabled))
 		return;
 
+	/* Shared with an ancestor, see psi_max_depth */
+	if (cgroup->level > psi_max_depth)
+		return;
+
 	cancel_delayed_work_sync(&cgroup->psi->avgs_work);
 	free_percpu(cgroup->psi->pcpu);
 	/* All triggers must be removed by now */
@@ -410,6 +410,10 @@ struct task_group {
 	struct uclamp_se	uclamp_req[UCLAMP_CNT];
 	/* Effective clamp values used for a task group */
 	struct uclamp_se	uclamp[UCLAMP_CNT];
+	/* The frequency limits [kHz] requested from user-space */
+	unsigned int		freq_req[UCLAMP_CNT];
+	/* Effective frequency limits [kHz] used for a task group */
+	unsigned int		freq[UCLAMP_CNT];
 #endif
 
 };
@@ -993,6 +997,10 @@ struct rq {
 	struct uclamp_rq	uclamp[UCLAMP_CNT] ____cacheline_aligned;
 	unsigned int		uclamp_flags;
 #define UCLAMP_FLAG_IDLE 0x01
+#endif
+#ifdef CONFIG_UCLAMP_TASK_GROUP
+	/* Frequency limits [kHz] of the task group of the current task */
+	unsigned int		cgroup_freq[UCLAMP_CNT];
 #endif
 
 	struct cfs_rq		cfs;
@@ -1075,6 +1083,7 @@ struct rq {
 #endif
 #ifdef CONFIG_SCHED_THERMAL_PRESSURE
 	struct sched_avg	avg_thermal;
+	long			thermal_trend;	/* Fixed point, see pelt.h */
 #endif
 	u64			idle_stamp;
 	u64			avg_idle;
@@ -2613,6 +2622,24 @@ unsigned long arch_scale_freq_capacity(int cpu)
 }
 #endif
 
+#ifndef arch_scale_freq_sensitivity
+/**
+ * arch_scale_freq_sensitivity - get the frequency sensitivity of a given CPU.
+ * @cpu: the CPU in question.
+ *
+ * Return: the part of a frequency change that turns into a change of the
+ * throughput of @cpu, normalized against SCHED_CAPACITY_SCALE.  It is lower
+ * when @cpu is stalled on memory, so running it faster gains little.
+ */
+static __always_inline
+unsigned long arch_scale_freq_sensitivity(int cpu)
+{
+	return SCHED_CAPACITY_SCALE;
+}
+
+static inline void arch_set_freq_sensitivity(bool enable) { }
+#endif
+
 #ifdef CONFIG_SCHED_DEBUG
 /*
  * In double_lock_balance()/double_rq_lock(), we use raw_spin_rq_lock() to
@@ -3180,6 +3207,40 @@ static inline bool uclamp_rq_is_idle(struct rq *rq)
 }
 #endif /* CONFIG_UCLAMP_TASK */
 
+#ifdef CONFIG_UCLAMP_TASK_GROUP
+DECLARE_STATIC_KEY_FALSE(sched_cgroup_freq_used);
+
+static inline bool cgroup_freq_used(void)
+{
+	return static_branch_unlikely(&sched_cgroup_freq_used);
+}
+
+/*
+ * Frequency limits [kHz] of the task group currently running on @rq, as
+ * applied by schedutil. They are only maintained once user-space has set
+ * the limits of a task group.
+ */
+static inline unsigned int cgroup_freq_rq_get(struct rq *rq,
+					      enum uclamp_id clamp_id)
+{
+	if (!cgroup_freq_used())
+		return clamp_id == UCLAMP_MIN ? 0 : UINT_MAX;
+
+	return READ_ONCE(rq->cgroup_freq[clamp_id]);
+}
+#else
+static inline bool cgroup_freq_used(void)
+{
+	return false;
+}
+
+static inline unsigned int cgroup_freq_rq_get(struct rq *rq,
+					      enum uclamp_id clamp_id)
+{
+	return clamp_id == UCLAMP_MIN ? 0 : UINT_MAX;
+}
+#endif /* CONFIG_UCLAMP_TASK_GROUP */
+
 #ifdef CONFIG_HAVE_SCHED_AVG_IRQ
 static inline unsigned long cpu_util_irq(struct rq *rq)
 {
@@ -3226,6 +3287,12 @@ static inline bool sched_energy_enabled(void) { return false; }
 
 #endif /* CONFIG_ENERGY_MODEL && CONFIG_CPU_FREQ_GOV_SCHEDUTIL */
 
+#ifdef CONFIG_ENERGY_MODEL
+extern void sched_energy_update_power(int cpu);
+#else
+static inline void sched_energy_update_power(int cpu) { }
+#endif
+
 #ifdef CONFIG_MEMBARRIER
 /*
  * The scheduler provides memory barriers required by membarrier between:
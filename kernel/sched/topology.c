@@ -354,26 +354,30 @@ static void sched_energy_set(bool has_eas)
  *
  * The complexity of the Energy Model is defined as:
  *
- *              C = nr_pd * (nr_cpus + nr_ps)
+ *              C = nr_cpus + nr_ps
  *
  * with parameters defined as:
- *  - nr_pd:    the number of performance domains
  *  - nr_cpus:  the number of CPUs
  *  - nr_ps:    the sum of the number of performance states of all performance
  *              domains (for example, on a system with 2 performance domains,
  *              with 10 performance states each, nr_ps = 2 * 10 = 20).
  *
+ * find_energy_efficient_cpu() walks the CPUs of every performance domain once
+ * and evaluates the EM of every domain for at most three utilization
+ * landscapes, so its cost grows linearly with both.
+ *
  * It is generally not a good idea to use such a model in the wake-up path on
  * very complex platforms because of the associated scheduling overheads. The
- * arbitrary constraint below prevents that. It makes EAS usable up to 16 CPUs
- * with per-CPU DVFS and less than 8 performance states each, for example.
+ * arbitrary constraint below prevents that. It makes EAS usable up to 256 CPUs
+ * with per-CPU DVFS and 7 performance states each, or 128 CPUs in 8 clusters
+ * with 32 performance states each, for example.
  */
 #define EM_MAX_COMPLEXITY 2048
 
 extern struct cpufreq_governor schedutil_gov;
 static bool build_perf_domains(const struct cpumask *cpu_map)
 {
-	int i, nr_pd = 0, nr_ps = 0, nr_cpus = cpumask_weight(cpu_map);
+	int i, nr_ps = 0, nr_cpus = cpumask_weight(cpu_map);
 	struct perf_domain *pd = NULL, *tmp;
 	int cpu = cpumask_first(cpu_map);
 	struct root_domain *rd = cpu_rq(cpu)->rd;
@@ -432,16 +436,12 @@ static bool build_perf_domains(const struct cpumask *cpu_map)
 		tmp->next = pd;
 		pd = tmp;
 
-		/*
-		 * Count performance domains and performance states for the
-		 * complexity check.
-		 */
-		nr_pd++;
+		/* Count performance states for the complexity check. */
 		nr_ps += em_pd_nr_perf_states(pd->em_pd);
 	}
 
 	/* Bail out if the Energy Model complexity is too high. */
-	if (nr_pd * (nr_ps + nr_cpus) > EM_MAX_COMPLEXITY) {
+	if (nr_ps + nr_cpus > EM_MAX_COMPLEXITY) {
 		WARN(1, "rd %*pbl: Failed to start EAS, EM complexity is too high\n",
 						cpumask_pr_args(cpu_map));
 		goto free;
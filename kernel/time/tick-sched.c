@@ -771,6 +771,57 @@ u64 get_cpu_iowait_time_us(int cpu, u64 *last_update_time)
 }
 EXPORT_SYMBOL_GPL(get_cpu_iowait_time_us);
 
+/**
+ * get_cpu_idle_time_us_at - get the total idle time of a CPU at a given time
+ * @cpu: CPU number to query
+ * @now: current time as returned by ktime_get()
+ * @add_iowait: include the iowait time in the result
+ *
+ * Return the cumulative idle time (since boot) for a given CPU, in
+ * microseconds, optionally including its cumulative iowait time, as of @now.
+ * Both are read in one go and the current time is not read, so this can be
+ * used for sampling the idle time of many CPUs against a single timestamp.
+ * The same caveats as for get_cpu_idle_time_us() apply.
+ *
+ * This function returns -1 if NOHZ is not enabled.
+ */
+u64 get_cpu_idle_time_us_at(int cpu, ktime_t now, bool add_iowait)
+{
+	struct tick_sched *ts = &per_cpu(tick_cpu_sched, cpu);
+	bool iowait = nr_iowait_cpu(cpu);
+	ktime_t idle, iowait_time;
+	unsigned int seq;
+
+	if (!tick_nohz_active)
+		return -1;
+
+	do {
+		seq = read_seqcount_begin(&ts->idle_sleeptime_seq);
+
+		idle = ts->idle_sleeptime;
+		iowait_time = ts->iowait_sleeptime;
+
+		/*
+		 * @now may have been read before the CPU entered idle, in
+		 * which case there is no idle time to add yet.
+		 */
+		if (ts->idle_active && ktime_after(now, ts->idle_entrytime)) {
+			ktime_t delta = ktime_sub(now, ts->idle_entrytime);
+
+			if (iowait)
+				iowait_time = ktime_add(iowait_time, delta);
+			else
+				idle = ktime_add(idle, delta);
+		}
+	} while (read_seqcount_retry(&ts->idle_sleeptime_seq, seq));
+
+	if (add_iowait)
+		idle = ktime_add(idle, iowait_time);
+
+	return ktime_to_us(idle);
+}
+EXPORT_SYMBOL_GPL(get_cpu_idle_time_us_at);
+
 static void tick_nohz_restart(struct tick_sched *ts, ktime_t now)
 {
 	hrtimer_cancel(&ts->sched_timer);
@@ -19,3 +19,9 @@ EXPORT_TRACEPOINT_SYMBOL_GPL(cpu_idle);
 EXPORT_TRACEPOINT_SYMBOL_GPL(cpu_frequency);
 EXPORT_TRACEPOINT_SYMBOL_GPL(powernv_throttle);
 
+EXPORT_TRACEPOINT_SYMBOL_GPL(sugov_next_freq_tp);
+EXPORT_TRACEPOINT_SYMBOL_GPL(sugov_adjust_perf_tp);
+EXPORT_TRACEPOINT_SYMBOL_GPL(intel_pstate_target_tp);
+EXPORT_TRACEPOINT_SYMBOL_GPL(amd_pstate_update_tp);
+EXPORT_TRACEPOINT_SYMBOL_GPL(cpuidle_select_tp);
+EXPORT_TRACEPOINT_SYMBOL_GPL(cpuidle_exit_tp);
@@ -13,4 +13,5 @@
 		} }							\
 
 
+unsigned int calculate_timespace(long load, struct config *config);
 void start_benchmark(struct config *config);
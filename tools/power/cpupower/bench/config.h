@@ -14,6 +14,15 @@
 #define PRIORITY_HIGH	 sched_get_priority_max(SCHEDULER)
 #define PRIORITY_LOW	 sched_get_priority_min(SCHEDULER)
 
+/* APERF/MPERF sampling interval of the reaction benchmark in µs */
+#define REACTION_SAMPLE_US	50
+
+/* maximum number of cpus the reaction benchmark can run on */
+#define REACTION_MAX_CPUS	1024
+
+/* maximum number of RAPL zones the workload benchmark reads */
+#define WORKLOAD_MAX_ZONES	16
+
 /* enable further debug messages */
 #ifdef DEBUG
 #define dprintf printf
@@ -14,6 +14,8 @@
 #include "config.h"
 #include "system.h"
 #include "benchmark.h"
+#include "reaction.h"
+#include "workload.h"
 
 static struct option long_options[] = {
 	{"output",	1,	0,	'o'},
@@ -28,6 +30,12 @@ static struct option long_options[] = {
 	{"rounds",	1,	0,	'r'},
 	{"load-step",	1,	0,	'x'},
 	{"sleep-step",	1,	0,	'y'},
+	{"reaction",	0,	0,	'R'},
+	{"cpus",	1,	0,	'm'},
+	{"target",	1,	0,	't'},
+	{"workload",	1,	0,	'w'},
+	{"rate",	1,	0,	'a'},
+	{"requests",	1,	0,	'q'},
 	{"help",	0,	0,	'h'},
 	{0, 0, 0, 0}
 };
@@ -51,6 +59,12 @@ void usage()
 	printf(" -r, --rounds<int>\t\t\tload/sleep rounds\n");
 	printf(" -f, --file=<configfile>\t\tconfig file to use\n");
 	printf(" -o, --output=<dir>\t\t\toutput path. Filename will be OUTPUTPATH/benchmark_TIMESTAMP.log\n");
+	printf(" -R, --reaction\t\t\t\tmeasure governor reaction times instead\n");
+	printf(" -m, --cpus=<cpu list>\t\t\tCPUs to run the reaction benchmark on\n");
+	printf(" -t, --target=<percent>\t\t\treaction target, in %% of the maximum frequency\n");
+	printf(" -w, --workload=<poisson|trace>\trun a request/response workload instead\n");
+	printf(" -a, --rate=<int>\t\t\tpoisson arrival rate in requests/s\n");
+	printf(" -q, --requests=<int>\t\t\tnumber of requests\n");
 	printf(" -v, --verbose\t\t\t\tverbose output on/off\n");
 	printf(" -h, --help\t\t\t\tPrint this help screen\n");
 	exit(1);
@@ -72,7 +86,7 @@ int main(int argc, char **argv)
 		return EXIT_FAILURE;
 
 	while (1) {
-		c = getopt_long (argc, argv, "hg:o:s:l:vc:p:f:n:r:x:y:",
+		c = getopt_long (argc, argv, "hg:o:s:l:vc:p:f:n:r:x:y:Rm:t:w:a:q:",
 				long_options, &option_index);
 		if (c == -1)
 			break;
@@ -134,6 +148,31 @@ int main(int argc, char **argv)
 			sscanf(optarg, "%li", &config->sleep_step);
 			dprintf("user sleep_step -> %s\n", optarg);
 			break;
+		case 'R':
+			config->reaction = 1;
+			dprintf("reaction benchmark enabled\n");
+			break;
+		case 'm':
+			strncpy(config->cpus, optarg, sizeof(config->cpus) - 1);
+			dprintf("user cpus -> %s\n", optarg);
+			break;
+		case 't':
+			sscanf(optarg, "%u", &config->target);
+			dprintf("user target -> %s\n", optarg);
+			break;
+		case 'w':
+			strncpy(config->workload, optarg,
+				sizeof(config->workload) - 1);
+			dprintf("user workload -> %s\n", optarg);
+			break;
+		case 'a':
+			sscanf(optarg, "%u", &config->rate);
+			dprintf("user rate -> %s\n", optarg);
+			break;
+		case 'q':
+			sscanf(optarg, "%u", &config->requests);
+			dprintf("user requests -> %s\n", optarg);
+			break;
 		case 'f':
 			if (prepare_config(optarg, config))
 				return EXIT_FAILURE;
@@ -177,7 +216,12 @@ int main(int argc, char **argv)
 
 	prepare_user(config);
 	prepare_system(config);
-	start_benchmark(config);
+	if (config->workload[0])
+		start_workload_benchmark(config);
+	else if (config->reaction)
+		start_reaction_benchmark(config);
+	else
+		start_benchmark(config);
 
 	if (config->output != stdout)
 		fclose(config->output);
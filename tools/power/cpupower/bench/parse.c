@@ -133,6 +133,12 @@ struct config *prepare_default_config()
 	config->prio = SCHED_HIGH;
 	config->verbose = 0;
 	strncpy(config->governor, "ondemand", sizeof(config->governor));
+	config->reaction = 0;
+	strncpy(config->cpus, "0", sizeof(config->cpus));
+	config->target = 90;
+	config->workload[0] = '\0';
+	config->rate = 100;
+	config->requests = 1000;
 
 	config->output = stdout;
 
@@ -213,6 +219,28 @@ int prepare_config(const char *path, struct config *config)
 			config->governor[sizeof(config->governor) - 1] = '\0';
 		}
 
+		else if (strcmp("reaction", opt) == 0)
+			sscanf(val, "%u", &config->reaction);
+
+		else if (strcmp("cpus", opt) == 0) {
+			strncpy(config->cpus, val, sizeof(config->cpus));
+			config->cpus[sizeof(config->cpus) - 1] = '\0';
+		}
+
+		else if (strcmp("target", opt) == 0)
+			sscanf(val, "%u", &config->target);
+
+		else if (strcmp("workload", opt) == 0) {
+			strncpy(config->workload, val, sizeof(config->workload));
+			config->workload[sizeof(config->workload) - 1] = '\0';
+		}
+
+		else if (strcmp("rate", opt) == 0)
+			sscanf(val, "%u", &config->rate);
+
+		else if (strcmp("requests", opt) == 0)
+			sscanf(val, "%u", &config->requests);
+
 		else if (strcmp("priority", opt) == 0) {
 			if (string_to_prio(val) != SCHED_ERR)
 				config->prio = string_to_prio(val);
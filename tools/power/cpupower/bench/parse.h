@@ -25,6 +25,16 @@ struct config
 		SCHED_LOW
 	} prio;
 
+	unsigned int reaction;	/* run the reaction time benchmark */
+	char cpus[64];		/* cpus to run the reaction benchmark on */
+	unsigned int target;	/* reaction target in % of the maximum
+				 * APERF/MPERF ratio */
+
+	char workload[64];	/* "poisson" or a trace file to run the
+				 * request/response benchmark with */
+	unsigned int rate;	/* poisson arrival rate in requests/s */
+	unsigned int requests;	/* number of requests */
+
 	unsigned int verbose;	/* verbose output */
 	FILE *output;		/* logfile */
 	char *output_filename;	/* logfile name, must be freed at the end
@@ -0,0 +1,337 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*  cpufreq-bench CPUFreq microbenchmark
+ *
+ *  Governor reaction time benchmark
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include <cpufreq.h>
+
+#include "config.h"
+#include "system.h"
+#include "reaction.h"
+
+#define MSR_IA32_MPERF	0xe7
+#define MSR_IA32_APERF	0xe8
+
+struct reaction_thread {
+	pthread_t thread;
+	unsigned int cpu;
+	unsigned int policy;	/* first CPU of the policy of this CPU */
+	int msr_fd;
+	double max_ratio;	/* APERF/MPERF ratio with "performance" */
+	long *latency;		/* time to target frequency of every cycle */
+	unsigned int count;
+	unsigned int misses;	/* cycles in which the target was not reached */
+	struct config *config;
+};
+
+static pthread_barrier_t reaction_barrier;
+
+/**
+ * parses a cpu list like "0-3,8"
+ *
+ * @param list cpu list string
+ * @param cpus array to store the cpu numbers in
+ * @param max size of the array
+ *
+ * @retval number of cpus on success
+ * @retval -1 when the list is malformed or too long
+ **/
+
+static int parse_cpu_list(const char *list, unsigned int *cpus, int max)
+{
+	unsigned int first, last;
+	const char *str = list;
+	int n = 0, len;
+
+	while (*str) {
+		if (sscanf(str, "%u%n", &first, &len) < 1)
+			return -1;
+		str += len;
+		last = first;
+
+		if (*str == '-') {
+			str++;
+			if (sscanf(str, "%u%n", &last, &len) < 1 ||
+			    last < first)
+				return -1;
+			str += len;
+		}
+
+		for (; first <= last; first++) {
+			if (n == max)
+				return -1;
+			cpus[n++] = first;
+		}
+
+		if (*str == ',')
+			str++;
+		else if (*str)
+			return -1;
+	}
+
+	return n;
+}
+
+static int read_aperf_mperf(int fd, uint64_t *aperf, uint64_t *mperf)
+{
+	if (pread(fd, aperf, sizeof(*aperf), MSR_IA32_APERF) != sizeof(*aperf) ||
+	    pread(fd, mperf, sizeof(*mperf), MSR_IA32_MPERF) != sizeof(*mperf))
+		return -1;
+
+	return 0;
+}
+
+/**
+ * keeps the cpu busy for the given time, sampling the APERF/MPERF ratio
+ * every REACTION_SAMPLE_US
+ *
+ * @param t thread data
+ * @param load load time in µs
+ * @param target ratio at which to stop the clock, 0 to only track the
+ *	  maximum ratio
+ *
+ * @retval time in µs until the target ratio was reached
+ * @retval -1 when it was not reached or the MSRs could not be read
+ **/
+
+static long reaction_load(struct reaction_thread *t, long load, double target)
+{
+	uint64_t aperf, mperf, last_aperf, last_mperf;
+	long long start, now, last;
+	long reached = -1;
+
+	if (read_aperf_mperf(t->msr_fd, &last_aperf, &last_mperf))
+		return -1;
+
+	start = last = get_time();
+	do {
+		now = get_time();
+		if (now - last < REACTION_SAMPLE_US)
+			continue;
+
+		if (read_aperf_mperf(t->msr_fd, &aperf, &mperf))
+			return -1;
+
+		if (mperf != last_mperf) {
+			double ratio = (double)(aperf - last_aperf) /
+				       (mperf - last_mperf);
+
+			if (ratio > t->max_ratio && !target)
+				t->max_ratio = ratio;
+
+			if (target && reached < 0 && ratio >= target)
+				reached = now - start;
+		}
+
+		last = now;
+		last_aperf = aperf;
+		last_mperf = mperf;
+	} while (now - start < load);
+
+	return reached;
+}
+
+static void *reaction_thread_fn(void *data)
+{
+	struct reaction_thread *t = data;
+	struct config *config = t->config;
+	double target = t->max_ratio * config->target / 100;
+	unsigned int cycle;
+
+	set_cpu_affinity(t->cpu);
+
+	for (cycle = 0; cycle < config->cycles; cycle++) {
+		long latency;
+
+		pthread_barrier_wait(&reaction_barrier);
+		usleep(config->sleep);
+		/* start the load on all of the cpus at the same time */
+		pthread_barrier_wait(&reaction_barrier);
+
+		latency = reaction_load(t, config->load, target);
+		if (latency < 0) {
+			t->misses++;
+			latency = config->load;
+		}
+		t->latency[t->count++] = latency;
+	}
+
+	return NULL;
+}
+
+static int compare_long(const void *a, const void *b)
+{
+	long x = *(const long *)a, y = *(const long *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* permille-th value of a sorted array */
+static long percentile(const long *v, unsigned int n, unsigned int permille)
+{
+	unsigned long idx = (unsigned long)n * permille / 1000;
+
+	return v[idx < n ? idx : n - 1];
+}
+
+static void report(struct config *config, const char *name, long *v,
+		   unsigned int n, unsigned int misses)
+{
+	qsort(v, n, sizeof(*v), compare_long);
+
+	fprintf(config->output, "%s %s %u %u %li %li %li\n",
+		config->governor, name, n, misses,
+		percentile(v, n, 500), percentile(v, n, 990),
+		percentile(v, n, 999));
+}
+
+/**
+ * reaction time benchmark
+ * runs synchronized sleep/load cycles on all of the configured cpus and
+ * measures how long it takes the configured governor to bring every cpu
+ * to the target percentage of the APERF/MPERF ratio seen with the
+ * performance governor
+ *
+ * @param config config values for the benchmark
+ *
+ * @retval 0 on success
+ * @retval -1 when failed
+ **/
+
+int start_reaction_benchmark(struct config *config)
+{
+	unsigned int cpus[REACTION_MAX_CPUS];
+	struct reaction_thread *threads;
+	long *all;
+	unsigned int total = 0, misses = 0;
+	int nr_cpus, i, ret = -1;
+
+	nr_cpus = parse_cpu_list(config->cpus, cpus, REACTION_MAX_CPUS);
+	if (nr_cpus <= 0) {
+		fprintf(stderr, "error: invalid cpu list %s\n", config->cpus);
+		return -1;
+	}
+
+	threads = calloc(nr_cpus, sizeof(*threads));
+	all = calloc((size_t)nr_cpus * config->cycles, sizeof(*all));
+	if (!threads || !all) {
+		perror("calloc");
+		goto out;
+	}
+
+	for (i = 0; i < nr_cpus; i++)
+		threads[i].msr_fd = -1;
+
+	for (i = 0; i < nr_cpus; i++) {
+		struct reaction_thread *t = &threads[i];
+		struct cpufreq_affected_cpus *related;
+		char path[32];
+
+		t->cpu = cpus[i];
+		t->config = config;
+
+		snprintf(path, sizeof(path), "/dev/cpu/%u/msr", t->cpu);
+		t->msr_fd = open(path, O_RDONLY);
+		if (t->msr_fd < 0) {
+			perror("open");
+			fprintf(stderr, "error: unable to read MSRs of cpu %u\n",
+				t->cpu);
+			goto out_close;
+		}
+
+		t->latency = all + (size_t)i * config->cycles;
+
+		related = cpufreq_get_related_cpus(t->cpu);
+		t->policy = related ? related->cpu : t->cpu;
+		if (related)
+			cpufreq_put_related_cpus(related);
+	}
+
+	/* find the maximum ratio with the performance governor first */
+	for (i = 0; i < nr_cpus; i++) {
+		if (set_cpufreq_governor("performance", cpus[i]) != 0)
+			goto out_close;
+	}
+
+	for (i = 0; i < nr_cpus; i++) {
+		set_cpu_affinity(cpus[i]);
+		reaction_load(&threads[i], config->load, 0);
+
+		if (config->verbose)
+			printf("cpu %u (policy %u): maximum ratio %.3f\n",
+			       threads[i].cpu, threads[i].policy,
+			       threads[i].max_ratio);
+
+		if (threads[i].max_ratio == 0) {
+			fprintf(stderr, "error: no APERF/MPERF on cpu %u\n",
+				threads[i].cpu);
+			goto out_close;
+		}
+	}
+
+	for (i = 0; i < nr_cpus; i++) {
+		if (set_cpufreq_governor(config->governor, cpus[i]) != 0)
+			goto out_close;
+	}
+
+	if (pthread_barrier_init(&reaction_barrier, NULL, nr_cpus)) {
+		perror("pthread_barrier_init");
+		goto out_close;
+	}
+
+	for (i = 0; i < nr_cpus; i++) {
+		if (pthread_create(&threads[i].thread, NULL,
+				   reaction_thread_fn, &threads[i])) {
+			perror("pthread_create");
+			/*
+			 * The threads that have been started would wait for
+			 * the missing ones at the barrier forever.
+			 */
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for (i = 0; i < nr_cpus; i++)
+		pthread_join(threads[i].thread, NULL);
+
+	pthread_barrier_destroy(&reaction_barrier);
+
+	fprintf(config->output,
+		"#governor cpu(policy) cycles misses p50 p99 p999\n");
+
+	for (i = 0; i < nr_cpus; i++) {
+		char name[32];
+
+		snprintf(name, sizeof(name), "%u(%u)", threads[i].cpu,
+			 threads[i].policy);
+		/* the per-cpu arrays are consecutive parts of the combined one */
+		report(config, name, threads[i].latency, threads[i].count,
+		       threads[i].misses);
+		total += threads[i].count;
+		misses += threads[i].misses;
+	}
+
+	if (nr_cpus > 1)
+		report(config, "all", all, total, misses);
+
+	fflush(config->output);
+	ret = 0;
+
+out_close:
+	for (i = 0; i < nr_cpus; i++) {
+		if (threads[i].msr_fd >= 0)
+			close(threads[i].msr_fd);
+	}
+out:
+	free(all);
+	free(threads);
+	return ret;
+}
@@ -0,0 +1,7 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*  cpufreq-bench CPUFreq microbenchmark
+ *
+ *  Governor reaction time benchmark
+ */
+
+int start_reaction_benchmark(struct config *config);
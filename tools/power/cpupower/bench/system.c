@@ -64,7 +64,7 @@ int set_cpufreq_governor(char *governor, unsigned int cpu)
 }
 
 /**
- * sets cpu affinity for the process
+ * sets cpu affinity for the calling thread
  *
  * @param cpu cpu# to which the affinity should be set
  *
@@ -81,7 +81,7 @@ int set_cpu_affinity(unsigned int cpu)
 
 	dprintf("set affinity to cpu #%u\n", cpu);
 
-	if (sched_setaffinity(getpid(), sizeof(cpu_set_t), &cpuset) < 0) {
+	if (sched_setaffinity(0, sizeof(cpu_set_t), &cpuset) < 0) {
 		perror("sched_setaffinity");
 		fprintf(stderr, "warning: unable to set cpu affinity\n");
 		return -1;
@@ -0,0 +1,297 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*  cpufreq-bench CPUFreq microbenchmark
+ *
+ *  Request/response workload benchmark
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <dirent.h>
+
+#include "config.h"
+#include "system.h"
+#include "benchmark.h"
+#include "workload.h"
+
+#define POWERCAP_PATH	"/sys/class/powercap"
+
+struct request {
+	long long arrival;	/* µs since the start of the run */
+	long load;		/* work in µs with the performance governor */
+};
+
+static int read_ull(const char *dir, const char *name, unsigned long long *val)
+{
+	char path[256];
+	FILE *f;
+	int ret;
+
+	snprintf(path, sizeof(path), "%s/%s/%s", POWERCAP_PATH, dir, name);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+
+	ret = fscanf(f, "%llu", val) == 1 ? 0 : -1;
+	fclose(f);
+	return ret;
+}
+
+/**
+ * sums up the energy counters of the package level RAPL zones
+ *
+ * @param energy energy in µJ, one counter per zone
+ * @param range wraparound values of the counters, if not NULL
+ * @param max size of the arrays
+ *
+ * @retval number of zones
+ **/
+
+static int read_rapl(unsigned long long *energy,
+		     unsigned long long *range, int max)
+{
+	struct dirent *ent;
+	DIR *dir;
+	int n = 0;
+
+	dir = opendir(POWERCAP_PATH);
+	if (!dir)
+		return 0;
+
+	/* sort order does not matter as long as it's stable between calls */
+	while ((ent = readdir(dir)) && n < max) {
+		if (strncmp(ent->d_name, "intel-rapl:", 11) ||
+		    strchr(ent->d_name + 11, ':'))
+			continue;
+
+		if (read_ull(ent->d_name, "energy_uj", &energy[n]))
+			continue;
+
+		if (range && read_ull(ent->d_name, "max_energy_range_uj",
+				      &range[n]))
+			range[n] = 0;
+		n++;
+	}
+
+	closedir(dir);
+	return n;
+}
+
+/**
+ * generates the requests from a poisson arrival process or a trace file
+ *
+ * A trace file has one request per line, with the time since the previous
+ * request in µs and optionally the work of the request in µs, which defaults
+ * to the configured load time.
+ *
+ * @param config config values for the benchmark
+ * @param nr number of requests generated
+ *
+ * @retval requests on success
+ * @retval NULL when failed
+ **/
+
+static struct request *prepare_requests(struct config *config,
+					unsigned int *nr)
+{
+	struct request *req;
+	long long arrival = 0;
+	unsigned int i;
+
+	req = calloc(config->requests, sizeof(*req));
+	if (!req) {
+		perror("calloc");
+		return NULL;
+	}
+
+	if (!strcmp(config->workload, "poisson")) {
+		double mean = 1000000.0 / config->rate;
+
+		srand48(getpid());
+		for (i = 0; i < config->requests; i++) {
+			arrival += (long long)(-mean * log(1.0 - drand48()));
+			req[i].arrival = arrival;
+			req[i].load = config->load;
+		}
+	} else {
+		char *line = NULL;
+		size_t len = 0;
+		FILE *trace;
+
+		trace = fopen(config->workload, "r");
+		if (!trace) {
+			perror("fopen");
+			fprintf(stderr, "error: unable to read trace %s\n",
+				config->workload);
+			free(req);
+			return NULL;
+		}
+
+		i = 0;
+		while (i < config->requests &&
+		       getline(&line, &len, trace) != -1) {
+			long delay, load = config->load;
+
+			if (line[0] == '#' || sscanf(line, "%li %li",
+						     &delay, &load) < 1)
+				continue;
+
+			arrival += delay;
+			req[i].arrival = arrival;
+			req[i].load = load;
+			i++;
+		}
+
+		free(line);
+		fclose(trace);
+		config->requests = i;
+	}
+
+	*nr = config->requests;
+	return req;
+}
+
+static int compare_ll(const void *a, const void *b)
+{
+	long long x = *(const long long *)a, y = *(const long long *)b;
+
+	return (x > y) - (x < y);
+}
+
+static long long percentile(const long long *v, unsigned int n,
+			    unsigned int permille)
+{
+	unsigned long idx = (unsigned long)n * permille / 1000;
+
+	return v[idx < n ? idx : n - 1];
+}
+
+/**
+ * serves the requests one after another as they arrive and reports the
+ * latency percentiles and the energy used
+ *
+ * @param config config values for the benchmark
+ * @param governor cpufreq governor to use
+ * @param req requests
+ * @param nr number of requests
+ * @param calculations rounds of calculation per configured load time
+ *
+ * @retval 0 on success
+ * @retval -1 when failed
+ **/
+
+static int run_workload(struct config *config, char *governor,
+			struct request *req, unsigned int nr,
+			unsigned int calculations)
+{
+	unsigned long long start_uj[WORKLOAD_MAX_ZONES], end_uj[WORKLOAD_MAX_ZONES];
+	unsigned long long range[WORKLOAD_MAX_ZONES];
+	long long *latency, start, now;
+	double energy = 0;
+	unsigned int i;
+	int zones;
+
+	if (set_cpufreq_governor(governor, config->cpu) != 0)
+		return -1;
+
+	latency = calloc(nr, sizeof(*latency));
+	if (!latency) {
+		perror("calloc");
+		return -1;
+	}
+
+	zones = read_rapl(start_uj, range, WORKLOAD_MAX_ZONES);
+	start = get_time();
+
+	for (i = 0; i < nr; i++) {
+		unsigned int rounds;
+
+		now = get_time() - start;
+		if (now < req[i].arrival)
+			usleep(req[i].arrival - now);
+
+		rounds = (unsigned int)((long long)calculations * req[i].load /
+					config->load);
+		ROUNDS(rounds);
+
+		/* includes the time spent waiting for the previous requests */
+		latency[i] = get_time() - start - req[i].arrival;
+	}
+
+	if (read_rapl(end_uj, NULL, WORKLOAD_MAX_ZONES) != zones)
+		zones = 0;
+
+	for (i = 0; i < (unsigned int)zones; i++) {
+		unsigned long long delta = end_uj[i] - start_uj[i];
+
+		if (end_uj[i] < start_uj[i])
+			delta += range[i];
+		energy += delta / 1000000.0;
+	}
+
+	qsort(latency, nr, sizeof(*latency), compare_ll);
+
+	fprintf(config->output, "%s %u %lli %lli %lli ", governor, nr,
+		percentile(latency, nr, 500), percentile(latency, nr, 990),
+		percentile(latency, nr, 999));
+	if (zones)
+		fprintf(config->output, "%.3f\n", energy);
+	else
+		fprintf(config->output, "-\n");
+	fflush(config->output);
+
+	free(latency);
+	return 0;
+}
+
+/**
+ * request/response workload benchmark
+ * calibrates the work of a request with the performance governor, then
+ * serves the same sequence of requests with the performance governor and
+ * with the configured one
+ *
+ * @param config config values for the benchmark
+ *
+ * @retval 0 on success
+ * @retval -1 when failed
+ **/
+
+int start_workload_benchmark(struct config *config)
+{
+	unsigned int calculations, nr;
+	struct request *req;
+	int ret = -1;
+
+	if (config->load <= 0 || !config->rate || !config->requests) {
+		fprintf(stderr, "error: load, rate and requests must be set\n");
+		return -1;
+	}
+
+	req = prepare_requests(config, &nr);
+	if (!req)
+		return -1;
+
+	if (!nr) {
+		fprintf(stderr, "error: no requests in %s\n", config->workload);
+		goto out;
+	}
+
+	if (set_cpufreq_governor("performance", config->cpu) != 0)
+		goto out;
+
+	calculations = calculate_timespace(config->load, config);
+
+	fprintf(config->output,
+		"#governor requests p50 p99 p999 energy(J)\n");
+
+	if (run_workload(config, "performance", req, nr, calculations) ||
+	    run_workload(config, config->governor, req, nr, calculations))
+		goto out;
+
+	ret = 0;
+out:
+	free(req);
+	return ret;
+}
@@ -0,0 +1,7 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*  cpufreq-bench CPUFreq microbenchmark
+ *
+ *  Request/response workload benchmark
+ */
+
+int start_workload_benchmark(struct config *config);
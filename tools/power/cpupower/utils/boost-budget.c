@@ -0,0 +1,329 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Keep turbo for the chosen CPUs when a package gets close to its long term
+ * power limit (PL1) by turning off boost for the other cpufreq policies of
+ * that package, and turn it back on once the package power has dropped.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <getopt.h>
+
+#include <cpufreq.h>
+#include <powercap.h>
+
+#include "helpers/helpers.h"
+
+#define POWERCAP_SYSFS	"/sys/devices/virtual/powercap"
+#define POLICY_SYSFS	"/sys/devices/system/cpu/cpufreq/policy%u/boost"
+#define MAX_PACKAGES	16
+
+static struct option budget_opts[] = {
+	{"threshold",	required_argument,	NULL, 't'},
+	{"hysteresis",	required_argument,	NULL, 'y'},
+	{"interval",	required_argument,	NULL, 'i'},
+	{ },
+};
+
+struct budget_package {
+	struct powercap_zone *zone;
+	int id;
+	uint64_t limit_uw;	/* PL1 */
+	uint64_t range;
+	uint64_t last;
+	int limited;		/* boost is off for the unprotected policies */
+};
+
+struct budget_policy {
+	unsigned int cpu;	/* first CPU, policyN */
+	int pkg;
+	int protected;		/* has one of the chosen CPUs */
+	int saved;		/* boost setting before starting */
+};
+
+static struct budget_package packages[MAX_PACKAGES];
+static int nr_packages;
+static volatile sig_atomic_t stop;
+
+static int read_zone_file(struct powercap_zone *zone, const char *name,
+			  char *buf, size_t len)
+{
+	char path[SYSFS_PATH_MAX + 64];
+	FILE *f;
+	int ret = 0;
+
+	snprintf(path, sizeof(path), POWERCAP_SYSFS "/%s/%s", zone->sys_name,
+		 name);
+	f = fopen(path, "r");
+	if (!f)
+		return -errno;
+
+	if (!fgets(buf, len, f))
+		ret = -EIO;
+	else
+		buf[strcspn(buf, "\n")] = '\0';
+
+	fclose(f);
+	return ret;
+}
+
+static int add_package(struct powercap_zone *zone)
+{
+	struct budget_package *p = &packages[nr_packages];
+	char buf[64];
+	int id;
+
+	if (nr_packages >= MAX_PACKAGES || !zone->has_energy_uj ||
+	    sscanf(zone->name, "package-%d", &id) != 1)
+		return 0;
+
+	/* Constraint 0 of the RAPL package zones is the long term one */
+	if (read_zone_file(zone, "constraint_0_name", buf, sizeof(buf)) ||
+	    strcmp(buf, "long_term") ||
+	    read_zone_file(zone, "constraint_0_power_limit_uw", buf,
+			   sizeof(buf)))
+		return 0;
+
+	p->limit_uw = strtoull(buf, NULL, 10);
+	if (!p->limit_uw || powercap_get_energy_uj(zone, &p->last))
+		return 0;
+
+	if (powercap_get_max_energy_range_uj(zone, &p->range))
+		p->range = 0;
+
+	p->zone = zone;
+	p->id = id;
+	nr_packages++;
+	return 0;
+}
+
+static int get_boost(unsigned int cpu)
+{
+	char path[64];
+	FILE *f;
+	int val;
+
+	snprintf(path, sizeof(path), POLICY_SYSFS, cpu);
+	f = fopen(path, "r");
+	if (!f)
+		return -errno;
+
+	if (fscanf(f, "%d", &val) != 1)
+		val = -EIO;
+
+	fclose(f);
+	return val;
+}
+
+static int set_boost(unsigned int cpu, int val)
+{
+	char path[64];
+	FILE *f;
+	int ret;
+
+	snprintf(path, sizeof(path), POLICY_SYSFS, cpu);
+	f = fopen(path, "w");
+	if (!f)
+		return -errno;
+
+	ret = fprintf(f, "%d", val) < 0 ? -EIO : 0;
+	if (fclose(f) && !ret)
+		ret = -errno;
+	return ret;
+}
+
+static int is_protected(unsigned int cpu)
+{
+	struct cpufreq_affected_cpus *cpus, *first;
+	int ret = 0;
+
+	first = cpufreq_get_related_cpus(cpu);
+	for (cpus = first; cpus; cpus = cpus->next)
+		if (bitmask_isbitset(cpus_chosen, cpus->cpu))
+			ret = 1;
+
+	if (first)
+		cpufreq_put_related_cpus(first);
+	return ret;
+}
+
+/* core_info is sorted by package and core, not indexed by CPU */
+static int cpu_package(struct cpupower_topology *top, unsigned int nr_cpus,
+		       unsigned int cpu)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_cpus; i++)
+		if (top->core_info[i].cpu == (int)cpu)
+			return top->core_info[i].pkg;
+
+	return -1;
+}
+
+static void set_package_boost(struct budget_policy *pol, int nr, int pkg,
+			      int limited)
+{
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		if (pol[i].pkg != pkg || pol[i].protected || !pol[i].saved)
+			continue;
+
+		if (set_boost(pol[i].cpu, !limited))
+			printf(_("Could not set boost of policy%u\n"),
+			       pol[i].cpu);
+	}
+}
+
+static void budget_signal(int sig)
+{
+	stop = 1;
+}
+
+static unsigned long long now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+int cmd_boost_budget(int argc, char **argv)
+{
+	unsigned int threshold = 95, hysteresis = 10, interval_ms = 100;
+	struct cpupower_topology cpu_top;
+	struct budget_policy *pol;
+	struct powercap_zone *root;
+	struct sigaction sa = { .sa_handler = budget_signal, };
+	unsigned long long last_us, t;
+	unsigned int cpu, nr_cpus;
+	int i, nr = 0, ret;
+
+	while ((ret = getopt_long(argc, argv, "t:y:i:", budget_opts,
+				  NULL)) != -1) {
+		switch (ret) {
+		case 't':
+			threshold = atoi(optarg);
+			break;
+		case 'y':
+			hysteresis = atoi(optarg);
+			break;
+		case 'i':
+			interval_ms = atoi(optarg);
+			break;
+		default:
+			printf(_("invalid or unknown argument\n"));
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (!threshold || threshold > 100 || hysteresis >= threshold ||
+	    !interval_ms) {
+		printf(_("invalid or unknown argument\n"));
+		exit(EXIT_FAILURE);
+	}
+
+	/* The chosen CPUs keep boost, there is no default */
+	if (bitmask_isallclear(cpus_chosen)) {
+		printf(_("Choose the CPUs that keep boost with -c\n"));
+		exit(EXIT_FAILURE);
+	}
+
+	root = powercap_init_zones();
+	if (root)
+		powercap_walk_zones(root, add_package);
+	if (!nr_packages) {
+		printf(_("No package power limits found\n"));
+		return EXIT_FAILURE;
+	}
+
+	if (get_cpu_topology(&cpu_top) < 0) {
+		printf(_("Cannot read the CPU topology\n"));
+		return EXIT_FAILURE;
+	}
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	pol = calloc(nr_cpus, sizeof(*pol));
+	if (!pol) {
+		cpu_topology_release(cpu_top);
+		return EXIT_FAILURE;
+	}
+
+	/* Policies are named after their first CPU */
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		int boost = get_boost(cpu);
+
+		if (boost < 0)
+			continue;
+
+		pol[nr].cpu = cpu;
+		pol[nr].pkg = cpu_package(&cpu_top, nr_cpus, cpu);
+		pol[nr].protected = is_protected(cpu);
+		pol[nr].saved = boost;
+		nr++;
+	}
+	cpu_topology_release(cpu_top);
+
+	if (!nr) {
+		printf(_("No per-policy boost control\n"));
+		free(pol);
+		return EXIT_FAILURE;
+	}
+
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	last_us = now_us();
+	while (!stop) {
+		usleep(interval_ms * 1000);
+		t = now_us();
+
+		for (i = 0; i < nr_packages; i++) {
+			struct budget_package *p = &packages[i];
+			uint64_t energy, delta, power_uw;
+
+			if (powercap_get_energy_uj(p->zone, &energy))
+				continue;
+
+			if (energy >= p->last)
+				delta = energy - p->last;
+			else
+				delta = p->range > p->last ?
+					p->range - p->last + energy : 0;
+			p->last = energy;
+
+			power_uw = t > last_us ? delta * 1000000 / (t - last_us) : 0;
+
+			if (!p->limited &&
+			    power_uw * 100 >= p->limit_uw * threshold) {
+				p->limited = 1;
+				set_package_boost(pol, nr, p->id, 1);
+				printf(_("package-%d: %.1fW of %.1fW, boost off\n"),
+				       p->id, power_uw / 1000000.0,
+				       p->limit_uw / 1000000.0);
+			} else if (p->limited && power_uw * 100 <
+				   p->limit_uw * (threshold - hysteresis)) {
+				p->limited = 0;
+				set_package_boost(pol, nr, p->id, 0);
+				printf(_("package-%d: %.1fW of %.1fW, boost on\n"),
+				       p->id, power_uw / 1000000.0,
+				       p->limit_uw / 1000000.0);
+			}
+			fflush(stdout);
+		}
+		last_us = t;
+	}
+
+	/* Restore the original settings */
+	for (i = 0; i < nr; i++)
+		if (!pol[i].protected)
+			set_boost(pol[i].cpu, pol[i].saved);
+
+	free(pol);
+	return EXIT_SUCCESS;
+}
@@ -11,6 +11,7 @@
 #include <limits.h>
 #include <string.h>
 #include <ctype.h>
+#include <pthread.h>
 
 #include <getopt.h>
 
@@ -19,6 +20,7 @@
 #include "helpers/helpers.h"
 
 #define NORM_FREQ_LEN 32
+#define MAX_SET_THREADS 32
 
 static struct option set_opts[] = {
 	{"min",		required_argument,	NULL, 'd'},
@@ -144,6 +146,7 @@ static unsigned long string_to_frequency(const char *str)
 static int do_new_policy(unsigned int cpu, struct cpufreq_policy *new_pol)
 {
 	struct cpufreq_policy *cur_pol = cpufreq_get_policy(cpu);
+	struct cpufreq_policy pol = *new_pol;
 	int ret;
 
 	if (!cur_pol) {
@@ -151,16 +154,17 @@ static int do_new_policy(unsigned int cpu, struct cpufreq_policy *new_pol)
 		return -EINVAL;
 	}
 
-	if (!new_pol->min)
-		new_pol->min = cur_pol->min;
+	/* new_pol is shared by all CPUs, fill in the gaps in a copy */
+	if (!pol.min)
+		pol.min = cur_pol->min;
 
-	if (!new_pol->max)
-		new_pol->max = cur_pol->max;
+	if (!pol.max)
+		pol.max = cur_pol->max;
 
-	if (!new_pol->governor)
-		new_pol->governor = cur_pol->governor;
+	if (!pol.governor)
+		pol.governor = cur_pol->governor;
 
-	ret = cpufreq_set_policy(cpu, new_pol);
+	ret = cpufreq_set_policy(cpu, &pol);
 
 	cpufreq_put_policy(cur_pol);
 
@@ -193,6 +197,61 @@ static int do_one_cpu(unsigned int cpu, struct cpufreq_policy *new_pol,
 	}
 }
 
+struct set_job {
+	struct cpufreq_policy *new_pol;
+	unsigned long freq;
+	unsigned int pc;
+	unsigned int *cpus;	/* one CPU per policy */
+	int *ret;
+	unsigned int nr;
+	unsigned int next;
+};
+
+static void *set_worker(void *data)
+{
+	struct set_job *job = data;
+	unsigned int i;
+
+	while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) <
+	       job->nr)
+		job->ret[i] = do_one_cpu(job->cpus[i], job->new_pol, job->freq,
+					 job->pc);
+
+	return NULL;
+}
+
+/*
+ * Apply the settings to all policies of the job in parallel.  The sysfs
+ * writes block until the driver has reprogrammed the hardware, so doing them
+ * one after another is slow on systems with many policies.  Returns the error
+ * of the first policy that failed, if any.
+ */
+static int do_policies(struct set_job *job)
+{
+	pthread_t threads[MAX_SET_THREADS];
+	unsigned int nr_threads, i, j;
+
+	nr_threads = job->nr > 1 ? job->nr - 1 : 0;
+	if (nr_threads > MAX_SET_THREADS)
+		nr_threads = MAX_SET_THREADS;
+
+	for (i = 0; i < nr_threads; i++)
+		if (pthread_create(&threads[i], NULL, set_worker, job))
+			break;
+
+	/* This thread does its share, so failing to create threads is fine */
+	set_worker(job);
+
+	for (j = 0; j < i; j++)
+		pthread_join(threads[j], NULL);
+
+	for (i = 0; i < job->nr; i++)
+		if (job->ret[i])
+			return job->ret[i];
+
+	return 0;
+}
+
 int cmd_freq_set(int argc, char **argv)
 {
 	extern char *optarg;
@@ -202,6 +261,8 @@ int cmd_freq_set(int argc, char **argv)
 	unsigned long freq = 0;
 	char gov[20];
 	unsigned int cpu;
+	struct bitmask *handled;
+	struct set_job job = { };
 
 	struct cpufreq_policy new_pol = {
 		.min = 0,
@@ -317,22 +378,56 @@ int cmd_freq_set(int argc, char **argv)
 
 	get_cpustate();
 
-	/* loop over CPUs */
+	handled = bitmask_alloc(cpus_chosen->size);
+	job.cpus = calloc(cpus_chosen->size, sizeof(*job.cpus));
+	job.ret = calloc(cpus_chosen->size, sizeof(*job.ret));
+	if (!handled || !job.cpus || !job.ret) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	/*
+	 * loop over CPUs and collect one of them per policy, the settings of
+	 * a policy are shared by all of its CPUs
+	 */
 	for (cpu = bitmask_first(cpus_chosen);
 	     cpu <= bitmask_last(cpus_chosen); cpu++) {
+		struct cpufreq_affected_cpus *cpus, *c;
 
 		if (!bitmask_isbitset(cpus_chosen, cpu) ||
 		    cpupower_is_cpu_online(cpu) != 1)
 			continue;
 
 		printf(_("Setting cpu: %d\n"), cpu);
-		ret = do_one_cpu(cpu, &new_pol, freq, policychange);
-		if (ret) {
-			print_error();
-			return ret;
-		}
+		if (bitmask_isbitset(handled, cpu))
+			continue;
+
+		job.cpus[job.nr++] = cpu;
+		bitmask_setbit(handled, cpu);
+
+		cpus = cpufreq_get_related_cpus(cpu);
+		for (c = cpus; c; c = c->next)
+			bitmask_setbit(handled, c->cpu);
+		if (cpus)
+			cpufreq_put_related_cpus(cpus);
 	}
 
+	job.new_pol = &new_pol;
+	job.freq = freq;
+	job.pc = policychange;
+
+	ret = do_policies(&job);
+	if (ret)
+		print_error();
+
+out:
+	free(job.ret);
+	free(job.cpus);
+	if (handled)
+		bitmask_free(handled);
+	if (ret)
+		return ret;
+
 	print_offline_cpus();
 
 	return 0;
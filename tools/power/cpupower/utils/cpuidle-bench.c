@@ -0,0 +1,494 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Measure the wakeup latency of idle CPUs with different cpuidle governors
+ * and sets of enabled idle states.
+ *
+ * Needs root, because it switches the cpuidle governor and the enabled idle
+ * states of the chosen CPUs, and restores them when done.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <linux/futex.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+
+#include <cpuidle.h>
+
+#include "helpers/helpers.h"
+
+#define CPUIDLE_GOVERNOR	"/sys/devices/system/cpu/cpuidle/current_governor"
+#define MAX_STATES		64
+#define MAX_LIST		16
+
+enum bench_mode { MODE_FUTEX, MODE_PIPE, MODE_TIMER, MODE_MAX };
+
+static const char * const mode_names[MODE_MAX] = {
+	[MODE_FUTEX]	= "futex",
+	[MODE_PIPE]	= "pipe",
+	[MODE_TIMER]	= "timer",
+};
+
+static struct option bench_opts[] = {
+	{"target",	required_argument,	NULL, 't'},
+	{"waker",	required_argument,	NULL, 'w'},
+	{"gaps",	required_argument,	NULL, 'g'},
+	{"iterations",	required_argument,	NULL, 'n'},
+	{"modes",	required_argument,	NULL, 'm'},
+	{"governors",	required_argument,	NULL, 'G'},
+	{"masks",	required_argument,	NULL, 'M'},
+	{ },
+};
+
+static unsigned int target_cpu = 1, waker_cpu;
+static unsigned int iterations = 1000;
+static unsigned long gaps[MAX_LIST] = { 10, 100, 1000, 10000 };
+static unsigned int nr_gaps = 4;
+static unsigned int modes = (1 << MODE_FUTEX) | (1 << MODE_TIMER);
+
+/*
+ * State shared by the waker and the sleeper.  The sleeper sets armed right
+ * before going to sleep, the waker wakes it up gap us later and the sleeper
+ * stores the time since the wakeup was triggered in latency[] and sets done.
+ * Either side sets error if the pipe fails, so that the other one stops.
+ */
+struct pingpong {
+	enum bench_mode mode;
+	unsigned long gap;
+	int futex;
+	int pipe[2];
+	volatile int armed;
+	volatile int done;
+	volatile int error;
+	volatile long long t0;
+	long long *latency;
+};
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleep_until_ns(long long t)
+{
+	struct timespec ts = {
+		.tv_sec = t / 1000000000LL,
+		.tv_nsec = t % 1000000000LL,
+	};
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+	       EINTR)
+		;
+}
+
+/* Pin the calling thread, not the whole process, to cpu */
+static int bind_cpu(unsigned int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set);
+}
+
+static void *sleeper_fn(void *data)
+{
+	struct pingpong *pp = data;
+	unsigned int i;
+	char c;
+
+	bind_cpu(target_cpu);
+	/* Timer slack would be counted as wakeup latency */
+	prctl(PR_SET_TIMERSLACK, 1);
+
+	for (i = 0; i < iterations; i++) {
+		long long deadline;
+
+		switch (pp->mode) {
+		case MODE_TIMER:
+			deadline = now_ns() + pp->gap * 1000;
+			sleep_until_ns(deadline);
+			pp->latency[i] = now_ns() - deadline;
+			break;
+		case MODE_FUTEX:
+			__atomic_store_n(&pp->futex, 0, __ATOMIC_SEQ_CST);
+			pp->armed = 1;
+			while (!__atomic_load_n(&pp->futex, __ATOMIC_SEQ_CST))
+				syscall(__NR_futex, &pp->futex, FUTEX_WAIT, 0,
+					NULL, NULL, 0);
+			pp->latency[i] = now_ns() - pp->t0;
+			break;
+		case MODE_PIPE:
+			pp->armed = 1;
+			if (read(pp->pipe[0], &c, 1) != 1) {
+				pp->error = 1;
+				return NULL;
+			}
+			pp->latency[i] = now_ns() - pp->t0;
+			break;
+		default:
+			break;
+		}
+
+		pp->armed = 0;
+		__atomic_store_n(&pp->done, i + 1, __ATOMIC_SEQ_CST);
+	}
+
+	return NULL;
+}
+
+/* Wake up the sleeper gap us after it went to sleep, iterations times */
+static int waker(struct pingpong *pp)
+{
+	unsigned int i;
+	char c = 0;
+
+	for (i = 0; i < iterations; i++) {
+		while (!pp->armed && !pp->error)
+			;
+		if (pp->error)
+			return -EIO;
+
+		sleep_until_ns(now_ns() + pp->gap * 1000);
+
+		pp->t0 = now_ns();
+		if (pp->mode == MODE_FUTEX) {
+			__atomic_store_n(&pp->futex, 1, __ATOMIC_SEQ_CST);
+			syscall(__NR_futex, &pp->futex, FUTEX_WAKE, 1,
+				NULL, NULL, 0);
+		} else if (write(pp->pipe[1], &c, 1) != 1) {
+			/* Make the read of the sleeper fail too */
+			pp->error = 1;
+			close(pp->pipe[1]);
+			pp->pipe[1] = -1;
+			return -EIO;
+		}
+
+		while (__atomic_load_n(&pp->done, __ATOMIC_SEQ_CST) <= (int)i &&
+		       !pp->error)
+			;
+		if (pp->error)
+			return -EIO;
+	}
+
+	return 0;
+}
+
+static int compare_ll(const void *a, const void *b)
+{
+	long long x = *(const long long *)a, y = *(const long long *)b;
+
+	return (x > y) - (x < y);
+}
+
+static double percentile_us(const long long *v, unsigned int n,
+			    unsigned int permille)
+{
+	unsigned long idx = (unsigned long)n * permille / 1000;
+
+	return v[idx < n ? idx : n - 1] / 1000.0;
+}
+
+static void read_residency(unsigned int nr_states, unsigned long *usage,
+			   unsigned long long *time)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_states; i++) {
+		usage[i] = cpuidle_state_usage(target_cpu, i);
+		time[i] = cpuidle_state_time(target_cpu, i);
+	}
+}
+
+static int run_one(enum bench_mode mode, unsigned long gap,
+		   unsigned int nr_states)
+{
+	unsigned long usage[2][MAX_STATES];
+	unsigned long long time[2][MAX_STATES];
+	struct pingpong pp = { .mode = mode, .gap = gap, .pipe = { -1, -1 }, };
+	pthread_t sleeper;
+	unsigned int i;
+	int ret = 0;
+
+	pp.latency = calloc(iterations, sizeof(*pp.latency));
+	if (!pp.latency)
+		return -ENOMEM;
+
+	if (mode == MODE_PIPE && pipe(pp.pipe)) {
+		ret = -errno;
+		goto out;
+	}
+
+	read_residency(nr_states, usage[0], time[0]);
+
+	if (pthread_create(&sleeper, NULL, sleeper_fn, &pp)) {
+		ret = -EAGAIN;
+		goto out;
+	}
+	if (mode != MODE_TIMER)
+		ret = waker(&pp);
+	pthread_join(sleeper, NULL);
+	if (ret || pp.error) {
+		ret = -EIO;
+		goto out;
+	}
+
+	read_residency(nr_states, usage[1], time[1]);
+
+	qsort(pp.latency, iterations, sizeof(*pp.latency), compare_ll);
+	printf(_("  %-5s gap %6luus: p50 %8.1fus p90 %8.1fus p99 %8.1fus "
+		 "max %8.1fus\n"), mode_names[mode], gap,
+	       percentile_us(pp.latency, iterations, 500),
+	       percentile_us(pp.latency, iterations, 900),
+	       percentile_us(pp.latency, iterations, 990),
+	       pp.latency[iterations - 1] / 1000.0);
+
+	for (i = 0; i < nr_states; i++) {
+		char *name;
+
+		if (usage[1][i] == usage[0][i])
+			continue;
+
+		name = cpuidle_state_name(target_cpu, i);
+		printf(_("        %-8s %8lu entries %10lluus\n"),
+		       name ? name : "?", usage[1][i] - usage[0][i],
+		       time[1][i] - time[0][i]);
+		free(name);
+	}
+
+out:
+	if (pp.pipe[0] >= 0)
+		close(pp.pipe[0]);
+	if (pp.pipe[1] >= 0)
+		close(pp.pipe[1]);
+	free(pp.latency);
+	return ret;
+}
+
+static int set_governor(const char *governor)
+{
+	FILE *f;
+	int ret;
+
+	f = fopen(CPUIDLE_GOVERNOR, "w");
+	if (!f)
+		return -errno;
+
+	ret = fprintf(f, "%s", governor) < 0 ? -EIO : 0;
+	if (fclose(f) && !ret)
+		ret = -errno;
+	return ret;
+}
+
+/* Disable the idle states in mask on all of the chosen CPUs */
+static void set_state_mask(unsigned long long mask)
+{
+	unsigned int cpu, i, nr;
+	int disable;
+
+	for (cpu = bitmask_first(cpus_chosen);
+	     cpu <= bitmask_last(cpus_chosen); cpu++) {
+		if (!bitmask_isbitset(cpus_chosen, cpu) ||
+		    cpupower_is_cpu_online(cpu) != 1)
+			continue;
+
+		nr = cpuidle_state_count(cpu);
+		for (i = 0; i < nr && i < MAX_STATES; i++) {
+			disable = !!(mask & (1ULL << i));
+			if (cpuidle_state_disable(cpu, i, disable))
+				printf(_("Idlestate %u not %s on CPU %u\n"), i,
+				       disable ? "disabled" : "enabled", cpu);
+		}
+	}
+}
+
+static unsigned long long get_state_mask(unsigned int cpu)
+{
+	unsigned long long mask = 0;
+	unsigned int i, nr;
+
+	nr = cpuidle_state_count(cpu);
+	for (i = 0; i < nr && i < MAX_STATES; i++)
+		if (cpuidle_is_state_disabled(cpu, i) == 1)
+			mask |= 1ULL << i;
+
+	return mask;
+}
+
+static void run_config(unsigned int nr_states)
+{
+	unsigned int mode, gap, i;
+	char *governor, *name;
+
+	governor = cpuidle_get_governor();
+	printf(_("Governor %s, enabled states:"), governor ? governor : "?");
+	free(governor);
+
+	for (i = 0; i < nr_states; i++) {
+		if (cpuidle_is_state_disabled(target_cpu, i) == 1)
+			continue;
+		name = cpuidle_state_name(target_cpu, i);
+		printf(" %s", name ? name : "?");
+		free(name);
+	}
+	printf("\n");
+
+	for (mode = 0; mode < MODE_MAX; mode++) {
+		if (!(modes & (1 << mode)))
+			continue;
+
+		for (gap = 0; gap < nr_gaps; gap++) {
+			if (run_one(mode, gaps[gap], nr_states))
+				printf(_("  %s gap %luus: failed\n"),
+				       mode_names[mode], gaps[gap]);
+		}
+	}
+}
+
+static unsigned int parse_list(char *str, unsigned long *vals, int base)
+{
+	unsigned int n = 0;
+	char *tok, *end;
+
+	for (tok = strtok(str, ","); tok; tok = strtok(NULL, ",")) {
+		if (n == MAX_LIST)
+			break;
+		vals[n] = strtoul(tok, &end, base);
+		if (*end != '\0') {
+			printf(_("Bad value: %s\n"), tok);
+			exit(EXIT_FAILURE);
+		}
+		n++;
+	}
+
+	return n;
+}
+
+int cmd_idle_bench(int argc, char **argv)
+{
+	unsigned long masks[MAX_LIST], *saved_masks;
+	char *governors = NULL, *governor, *saved_governor;
+	unsigned int nr_masks = 0, nr_states, cpu, i;
+	char *tok;
+	int ret;
+
+	while ((ret = getopt_long(argc, argv, "t:w:g:n:m:G:M:", bench_opts,
+				  NULL)) != -1) {
+		switch (ret) {
+		case 't':
+			target_cpu = atoi(optarg);
+			break;
+		case 'w':
+			waker_cpu = atoi(optarg);
+			break;
+		case 'g':
+			nr_gaps = parse_list(optarg, gaps, 10);
+			break;
+		case 'n':
+			iterations = atoi(optarg);
+			break;
+		case 'm':
+			modes = 0;
+			for (tok = strtok(optarg, ","); tok;
+			     tok = strtok(NULL, ",")) {
+				for (i = 0; i < MODE_MAX; i++)
+					if (!strcmp(tok, mode_names[i]))
+						break;
+				if (i == MODE_MAX) {
+					printf(_("Bad mode: %s\n"), tok);
+					exit(EXIT_FAILURE);
+				}
+				modes |= 1 << i;
+			}
+			break;
+		case 'G':
+			governors = optarg;
+			break;
+		case 'M':
+			nr_masks = parse_list(optarg, masks, 16);
+			break;
+		default:
+			printf(_("invalid or unknown argument\n"));
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (!iterations || !nr_gaps || !modes || target_cpu == waker_cpu ||
+	    cpupower_is_cpu_online(target_cpu) != 1 ||
+	    cpupower_is_cpu_online(waker_cpu) != 1) {
+		printf(_("invalid or unknown argument\n"));
+		exit(EXIT_FAILURE);
+	}
+
+	nr_states = cpuidle_state_count(target_cpu);
+	if (nr_states > MAX_STATES)
+		nr_states = MAX_STATES;
+
+	/* State masks are applied to the chosen CPUs, all of them by default */
+	if (bitmask_isallclear(cpus_chosen))
+		bitmask_setall(cpus_chosen);
+
+	saved_governor = cpuidle_get_governor();
+	saved_masks = calloc(bitmask_last(cpus_chosen) + 1,
+			     sizeof(*saved_masks));
+	if (!saved_masks)
+		return EXIT_FAILURE;
+
+	for (cpu = bitmask_first(cpus_chosen);
+	     cpu <= bitmask_last(cpus_chosen); cpu++)
+		if (bitmask_isbitset(cpus_chosen, cpu) &&
+		    cpupower_is_cpu_online(cpu) == 1)
+			saved_masks[cpu] = get_state_mask(cpu);
+
+	bind_cpu(waker_cpu);
+
+	governor = governors ? strtok(governors, ",") : NULL;
+	do {
+		if (governor && set_governor(governor)) {
+			printf(_("Cannot switch to the %s governor\n"),
+			       governor);
+			continue;
+		}
+
+		if (!nr_masks)
+			run_config(nr_states);
+
+		for (i = 0; i < nr_masks; i++) {
+			set_state_mask(masks[i]);
+			run_config(nr_states);
+		}
+	} while (governor && (governor = strtok(NULL, ",")));
+
+	/* Restore the original configuration */
+	if (nr_masks) {
+		for (cpu = bitmask_first(cpus_chosen);
+		     cpu <= bitmask_last(cpus_chosen); cpu++) {
+			if (!bitmask_isbitset(cpus_chosen, cpu) ||
+			    cpupower_is_cpu_online(cpu) != 1)
+				continue;
+			for (i = 0; i < MAX_STATES &&
+			     i < cpuidle_state_count(cpu); i++)
+				if (cpuidle_state_disable(cpu, i,
+					!!(saved_masks[cpu] & (1ULL << i))))
+					printf(_("Cannot restore idlestate %u on CPU %u\n"),
+					       i, cpu);
+		}
+	}
+	if (governors && saved_governor && set_governor(saved_governor))
+		printf(_("Cannot switch back to the %s governor\n"),
+		       saved_governor);
+
+	free(saved_governor);
+	free(saved_masks);
+	return EXIT_SUCCESS;
+}
@@ -54,7 +54,9 @@ static struct cmd_struct commands[] = {
 	{ "frequency-set",	cmd_freq_set,	1	},
 	{ "idle-info",		cmd_idle_info,	0	},
 	{ "idle-set",		cmd_idle_set,	1	},
+	{ "idle-bench",		cmd_idle_bench,	1	},
 	{ "powercap-info",	cmd_cap_info,	0	},
+	{ "boost-budget",	cmd_boost_budget, 1	},
 	{ "set",		cmd_set,	1	},
 	{ "info",		cmd_info,	0	},
 	{ "monitor",		cmd_monitor,	0	},
@@ -33,6 +33,10 @@
 #endif
 /* Internationalization ****************************/
 
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(a)	(sizeof(a) / sizeof((a)[0]))
+#endif
+
 extern int run_as_root;
 extern int base_cpu;
 extern struct bitmask *cpus_chosen;
@@ -112,6 +116,14 @@ extern struct cpupower_cpu_info cpupower_cpu_info;
 extern int read_msr(int cpu, unsigned int idx, unsigned long long *val);
 extern int write_msr(int cpu, unsigned int idx, unsigned long long val);
 
+struct msr_perf;
+extern struct msr_perf *msr_perf_open(const unsigned int *msrs, int nr,
+				      int cpus);
+extern int msr_perf_update(struct msr_perf *p, int cpu);
+extern int msr_perf_get(struct msr_perf *p, int cpu, unsigned int msr,
+			unsigned long long *val);
+extern void msr_perf_close(struct msr_perf *p);
+
 extern int cpupower_intel_set_perf_bias(unsigned int cpu, unsigned int val);
 extern int cpupower_intel_get_perf_bias(unsigned int cpu);
 extern unsigned long long msr_intel_get_turbo_ratio(unsigned int cpu);
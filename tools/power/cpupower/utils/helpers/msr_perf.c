@@ -0,0 +1,298 @@
+// SPDX-License-Identifier: GPL-2.0
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+
+#include "helpers/helpers.h"
+
+/*
+ * Read counters that are exposed both as MSRs and through perf_event PMUs
+ * ("msr", "cstate_core" and "cstate_pkg") with perf instead of the msr
+ * driver.  All of the counters of one PMU on one CPU are opened in a group,
+ * so updating them takes a single read() per group instead of an open(),
+ * lseek() and read() per counter, and it does not need root if
+ * perf_event_paranoid allows CPU-wide events.
+ */
+
+#define PERF_DEVICES	"/sys/bus/event_source/devices"
+#define MSR_PERF_MAX	8
+
+static const struct {
+	unsigned int msr;
+	const char *pmu;
+	const char *event;
+} msr_perf_events[] = {
+	{ 0x10,  "msr",		"tsc" },
+	{ 0xE7,  "msr",		"mperf" },
+	{ 0xE8,  "msr",		"aperf" },
+	{ 0x3FC, "cstate_core",	"c3-residency" },
+	{ 0x3FD, "cstate_core",	"c6-residency" },
+	{ 0x3FE, "cstate_core",	"c7-residency" },
+	{ 0x60D, "cstate_pkg",	"c2-residency" },
+	{ 0x3F8, "cstate_pkg",	"c3-residency" },
+	{ 0x3F9, "cstate_pkg",	"c6-residency" },
+	{ 0x3FA, "cstate_pkg",	"c7-residency" },
+	{ 0x630, "cstate_pkg",	"c8-residency" },
+	{ 0x631, "cstate_pkg",	"c9-residency" },
+	{ 0x632, "cstate_pkg",	"c10-residency" },
+};
+
+struct msr_perf_group {
+	const char *pmu;
+	int nr;
+	unsigned int msr[MSR_PERF_MAX];
+	int *fd;		/* nr file descriptors per CPU */
+};
+
+struct msr_perf {
+	int cpus;
+	int nr_groups;
+	struct msr_perf_group group[MSR_PERF_MAX];
+	unsigned int msr[MSR_PERF_MAX];
+	unsigned long long *val;	/* nr_msrs values per CPU */
+	int *is_valid;
+	int nr_msrs;
+};
+
+static int read_sysfs_ull(const char *path, const char *fmt,
+			  unsigned long long *val)
+{
+	FILE *f;
+	int ret;
+
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+
+	ret = fscanf(f, fmt, val) == 1 ? 0 : -1;
+	fclose(f);
+	return ret;
+}
+
+static int perf_event_attr_init(struct perf_event_attr *attr,
+				const char *pmu, const char *event)
+{
+	unsigned long long type, config;
+	char path[128];
+
+	snprintf(path, sizeof(path), PERF_DEVICES "/%s/type", pmu);
+	if (read_sysfs_ull(path, "%llu", &type))
+		return -1;
+
+	snprintf(path, sizeof(path), PERF_DEVICES "/%s/events/%s", pmu, event);
+	if (read_sysfs_ull(path, "event=%llx", &config))
+		return -1;
+
+	memset(attr, 0, sizeof(*attr));
+	attr->size = sizeof(*attr);
+	attr->type = type;
+	attr->config = config;
+	attr->read_format = PERF_FORMAT_GROUP;
+
+	return 0;
+}
+
+static int msr_perf_event(unsigned int msr)
+{
+	int i;
+
+	for (i = 0; i < (int)ARRAY_SIZE(msr_perf_events); i++)
+		if (msr_perf_events[i].msr == msr)
+			return i;
+
+	return -1;
+}
+
+/* Open the events of a group on a CPU, all or none of them */
+static int perf_group_open(struct msr_perf_group *g, int cpu)
+{
+	int *fd = &g->fd[cpu * g->nr];
+	struct perf_event_attr attr;
+	int i;
+
+	for (i = 0; i < g->nr; i++) {
+		const char *event = msr_perf_events[msr_perf_event(g->msr[i])].event;
+
+		if (perf_event_attr_init(&attr, g->pmu, event))
+			goto err;
+
+		fd[i] = syscall(__NR_perf_event_open, &attr, -1, cpu,
+				i ? fd[0] : -1, 0);
+		if (fd[i] < 0)
+			goto err;
+	}
+
+	return 0;
+
+ err:
+	while (i--) {
+		close(fd[i]);
+		fd[i] = -1;
+	}
+	return -1;
+}
+
+void msr_perf_close(struct msr_perf *p)
+{
+	int i, j;
+
+	if (!p)
+		return;
+
+	for (i = 0; i < p->nr_groups; i++) {
+		struct msr_perf_group *g = &p->group[i];
+
+		if (!g->fd)
+			continue;
+
+		for (j = 0; j < p->cpus * g->nr; j++)
+			if (g->fd[j] >= 0)
+				close(g->fd[j]);
+		free(g->fd);
+	}
+
+	free(p->val);
+	free(p->is_valid);
+	free(p);
+}
+
+/*
+ * msr_perf_open
+ *
+ * Open perf events for the given MSRs on all cpus.  Returns NULL if any of
+ * them is not supported by perf or cannot be opened on any CPU, in which case
+ * the MSRs have to be read with read_msr().
+ */
+struct msr_perf *msr_perf_open(const unsigned int *msrs, int nr, int cpus)
+{
+	struct msr_perf *p;
+	int i, j, k;
+
+	if (nr > MSR_PERF_MAX)
+		return NULL;
+
+	p = calloc(1, sizeof(*p));
+	if (!p)
+		return NULL;
+
+	p->cpus = cpus;
+	p->nr_msrs = nr;
+	memcpy(p->msr, msrs, nr * sizeof(*msrs));
+
+	for (i = 0; i < nr; i++) {
+		struct msr_perf_group *g = NULL;
+
+		j = msr_perf_event(msrs[i]);
+		if (j < 0)
+			goto err;
+
+		for (k = 0; k < p->nr_groups; k++)
+			if (!strcmp(p->group[k].pmu, msr_perf_events[j].pmu))
+				g = &p->group[k];
+
+		if (!g) {
+			g = &p->group[p->nr_groups++];
+			g->pmu = msr_perf_events[j].pmu;
+		}
+
+		g->msr[g->nr++] = msrs[i];
+	}
+
+	p->val = calloc((size_t)cpus * nr, sizeof(*p->val));
+	p->is_valid = calloc(cpus, sizeof(*p->is_valid));
+	if (!p->val || !p->is_valid)
+		goto err;
+
+	for (i = 0; i < p->nr_groups; i++) {
+		struct msr_perf_group *g = &p->group[i];
+
+		g->fd = malloc((size_t)cpus * g->nr * sizeof(*g->fd));
+		if (!g->fd)
+			goto err;
+
+		for (j = 0; j < cpus * g->nr; j++)
+			g->fd[j] = -1;
+
+		/* Offline CPUs are skipped, like with read_msr() */
+		for (j = 0, k = 0; j < cpus; j++) {
+			if (perf_group_open(g, j)) {
+				dprint("Cannot open %s events on cpu %d\n",
+				       g->pmu, j);
+			} else {
+				k++;
+			}
+		}
+
+		if (!k)
+			goto err;
+	}
+
+	return p;
+
+ err:
+	msr_perf_close(p);
+	return NULL;
+}
+
+/*
+ * msr_perf_update
+ *
+ * Read all of the counters of the given CPU, one read() per PMU.
+ * Returns 0 on success and -1 on failure.
+ */
+int msr_perf_update(struct msr_perf *p, int cpu)
+{
+	unsigned long long buf[1 + MSR_PERF_MAX];
+	int i, j, k;
+
+	p->is_valid[cpu] = 0;
+
+	for (i = 0; i < p->nr_groups; i++) {
+		struct msr_perf_group *g = &p->group[i];
+		ssize_t len = (1 + g->nr) * sizeof(buf[0]);
+
+		if (g->fd[cpu * g->nr] < 0 ||
+		    read(g->fd[cpu * g->nr], buf, len) != len ||
+		    buf[0] != (unsigned long long)g->nr)
+			return -1;
+
+		for (j = 0; j < g->nr; j++)
+			for (k = 0; k < p->nr_msrs; k++)
+				if (p->msr[k] == g->msr[j])
+					p->val[cpu * p->nr_msrs + k] = buf[1 + j];
+	}
+
+	p->is_valid[cpu] = 1;
+	return 0;
+}
+
+/*
+ * msr_perf_get
+ *
+ * Get the value of the given MSR on the given CPU as of the last
+ * msr_perf_update() for that CPU.  Returns 0 on success and -1 on failure.
+ */
+int msr_perf_get(struct msr_perf *p, int cpu, unsigned int msr,
+		 unsigned long long *val)
+{
+	int i;
+
+	if (!p->is_valid[cpu])
+		return -1;
+
+	for (i = 0; i < p->nr_msrs; i++) {
+		if (p->msr[i] == msr) {
+			*val = p->val[cpu * p->nr_msrs + i];
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+#endif
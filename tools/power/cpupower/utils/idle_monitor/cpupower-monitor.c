@@ -12,6 +12,7 @@
 #include <string.h>
 #include <time.h>
 #include <signal.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <libgen.h>
@@ -41,6 +42,12 @@ static char *show_monitors_param;
 static struct cpupower_topology cpu_top;
 static unsigned int wake_cpus;
 
+/* Continuous output of samples for collection by other programs (-f) */
+enum stream_format_e { STREAM_NONE, STREAM_CSV, STREAM_JSON };
+static int stream_format;
+static unsigned int stream_period_ms;
+static unsigned long stream_count;
+
 /* ToDo: Document this in the manpage */
 static char range_abbr[RANGE_MAX] = { 'T', 'C', 'P', 'M', };
 
@@ -136,6 +143,14 @@ void print_header(int topology_depth)
 	printf("\n");
 }
 
+static int skip_cpu(int cpu)
+{
+	/* Be careful CPUs may got resorted for pkg value do not just use cpu */
+	if (!bitmask_isbitset(cpus_chosen, cpu_top.core_info[cpu].cpu))
+		return 1;
+	return !cpu_top.core_info[cpu].is_online &&
+		cpu_top.core_info[cpu].pkg == -1;
+}
 
 void print_results(int topology_depth, int cpu)
 {
@@ -145,11 +160,7 @@ void print_results(int topology_depth, int cpu)
 	unsigned long long result;
 	cstate_t s;
 
-	/* Be careful CPUs may got resorted for pkg value do not just use cpu */
-	if (!bitmask_isbitset(cpus_chosen, cpu_top.core_info[cpu].cpu))
-		return;
-	if (!cpu_top.core_info[cpu].is_online &&
-	    cpu_top.core_info[cpu].pkg == -1)
+	if (skip_cpu(cpu))
 		return;
 
 	if (topology_depth > 2)
@@ -349,12 +360,135 @@ int do_interval_measure(int i)
 	return 0;
 }
 
+/* Format the value of a state, leave buf empty if it cannot be read */
+static void stream_value(cstate_t *s, int cpu, char *buf, size_t len)
+{
+	unsigned long long result;
+	double percent;
+
+	buf[0] = '\0';
+	if (s->get_count_percent) {
+		if (!s->get_count_percent(s->id, &percent, cpu))
+			snprintf(buf, len, "%.2f", percent);
+	} else if (s->get_count) {
+		if (!s->get_count(s->id, &result, cpu))
+			snprintf(buf, len, "%llu", result);
+	}
+}
+
+static void stream_header(void)
+{
+	unsigned int mon;
+	int state;
+
+	if (stream_format != STREAM_CSV)
+		return;
+
+	printf("time_us,pkg,core,cpu");
+	for (mon = 0; mon < avail_monitors; mon++)
+		for (state = 0; state < monitors[mon]->hw_states_num; state++)
+			printf(",%s.%s", monitors[mon]->name,
+			       monitors[mon]->hw_states[state].name);
+	printf("\n");
+}
+
+static void stream_sample(long long time_us)
+{
+	unsigned int mon;
+	int cpu, state;
+	char buf[32];
+
+	for (cpu = 0; cpu < cpu_count; cpu++) {
+		struct cpuid_core_info *info = &cpu_top.core_info[cpu];
+
+		if (skip_cpu(cpu))
+			continue;
+
+		if (stream_format == STREAM_CSV)
+			printf("%lld,%d,%d,%d", time_us, info->pkg, info->core,
+			       info->cpu);
+		else
+			printf("{\"time_us\":%lld,\"pkg\":%d,\"core\":%d,"
+			       "\"cpu\":%d", time_us, info->pkg, info->core,
+			       info->cpu);
+
+		for (mon = 0; mon < avail_monitors; mon++) {
+			if (stream_format == STREAM_JSON)
+				printf(",\"%s\":{", monitors[mon]->name);
+
+			for (state = 0; state < monitors[mon]->hw_states_num;
+			     state++) {
+				cstate_t *s = &monitors[mon]->hw_states[state];
+
+				stream_value(s, info->cpu, buf, sizeof(buf));
+				if (stream_format == STREAM_CSV)
+					printf(",%s", buf);
+				else
+					printf("%s\"%s\":%s", state ? "," : "",
+					       s->name, buf[0] ? buf : "null");
+			}
+
+			if (stream_format == STREAM_JSON)
+				printf("}");
+		}
+
+		printf(stream_format == STREAM_JSON ? "}\n" : "\n");
+	}
+}
+
+/*
+ * Emit a sample every stream_period_ms, stream_count times or until killed.
+ * The monitors are registered once and only restarted after every sample
+ * has been printed.
+ */
+static int do_stream(void)
+{
+	struct timespec next, now;
+	unsigned long n;
+	unsigned int num;
+	int cpu;
+
+	stream_header();
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for (num = 0; num < avail_monitors; num++)
+		monitors[num]->start();
+
+	for (n = 0; !stream_count || n < stream_count; n++) {
+		next.tv_sec += stream_period_ms / 1000;
+		next.tv_nsec += (stream_period_ms % 1000) * 1000000L;
+		if (next.tv_nsec >= 1000000000L) {
+			next.tv_sec++;
+			next.tv_nsec -= 1000000000L;
+		}
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+				       NULL) == EINTR)
+			;
+
+		if (wake_cpus)
+			for (cpu = 0; cpu < cpu_count; cpu++)
+				bind_cpu(cpu);
+
+		for (num = 0; num < avail_monitors; num++)
+			monitors[num]->stop();
+
+		clock_gettime(CLOCK_REALTIME, &now);
+		stream_sample(now.tv_sec * 1000000LL + now.tv_nsec / 1000);
+		fflush(stdout);
+
+		for (num = 0; num < avail_monitors; num++)
+			monitors[num]->start();
+	}
+
+	return 0;
+}
+
 static void cmdline(int argc, char *argv[])
 {
 	int opt;
 	progname = basename(argv[0]);
 
-	while ((opt = getopt(argc, argv, "+lci:m:")) != -1) {
+	while ((opt = getopt(argc, argv, "+lci:m:f:s:n:")) != -1) {
 		switch (opt) {
 		case 'l':
 			if (mode)
@@ -376,12 +510,35 @@ static void cmdline(int argc, char *argv[])
 		case 'c':
 			wake_cpus = 1;
 			break;
+		case 'f':
+			if (!strcmp(optarg, "csv"))
+				stream_format = STREAM_CSV;
+			else if (!strcmp(optarg, "json"))
+				stream_format = STREAM_JSON;
+			else
+				print_wrong_arg_exit();
+			break;
+		case 's':
+			stream_period_ms = atoi(optarg);
+			if (!stream_period_ms)
+				print_wrong_arg_exit();
+			break;
+		case 'n':
+			stream_count = strtoul(optarg, NULL, 10);
+			break;
 		default:
 			print_wrong_arg_exit();
 		}
 	}
 	if (!mode)
 		mode = show_all;
+
+	/* -s and -n only make sense with -f, which cannot be used with -l */
+	if ((!stream_format && (stream_period_ms || stream_count)) ||
+	    (stream_format && mode == list))
+		print_wrong_arg_exit();
+	if (!stream_period_ms)
+		stream_period_ms = interval * 1000;
 }
 
 int cmd_monitor(int argc, char **argv)
@@ -440,6 +597,13 @@ int cmd_monitor(int argc, char **argv)
 	/*
 	 * if any params left, it must be a command to fork
 	 */
+	if (stream_format) {
+		if (argc - optind)
+			print_wrong_arg_exit();
+		do_stream();
+		goto out;
+	}
+
 	if (argc - optind)
 		fork_it(argv + optind);
 	else
@@ -459,6 +623,7 @@ int cmd_monitor(int argc, char **argv)
 			print_results(1, cpu);
 	}
 
+out:
 	for (num = 0; num < avail_monitors; num++) {
 		if (monitors[num]->unregister)
 			monitors[num]->unregister();
@@ -58,6 +58,13 @@ static unsigned long long *previous_count[HSW_EXT_CSTATE_COUNT];
 static unsigned long long *current_count[HSW_EXT_CSTATE_COUNT];
 /* valid flag for all CPUs. If a MSR read failed it will be zero */
 static int *is_valid;
+static struct msr_perf *perf;
+static const unsigned int hsw_ext_msrs[] = {
+	MSR_PKG_C8_RESIDENCY,
+	MSR_PKG_C9_RESIDENCY,
+	MSR_PKG_C10_RESIDENCY,
+	MSR_TSC,
+};
 
 static int hsw_ext_get_count(enum intel_hsw_ext_id id, unsigned long long *val,
 			unsigned int cpu)
@@ -80,6 +87,8 @@ static int hsw_ext_get_count(enum intel_hsw_ext_id id, unsigned long long *val,
 	default:
 		return -1;
 	}
+	if (perf)
+		return msr_perf_get(perf, cpu, msr, val);
 	if (read_msr(cpu, msr, val))
 		return -1;
 	return 0;
@@ -115,6 +124,11 @@ static int hsw_ext_start(void)
 	int num, cpu;
 	unsigned long long val;
 
+	if (perf) {
+		for (cpu = 0; cpu < cpu_count; cpu++)
+			msr_perf_update(perf, cpu);
+	}
+
 	for (num = 0; num < HSW_EXT_CSTATE_COUNT; num++) {
 		for (cpu = 0; cpu < cpu_count; cpu++) {
 			hsw_ext_get_count(num, &val, cpu);
@@ -130,6 +144,11 @@ static int hsw_ext_stop(void)
 	unsigned long long val;
 	int num, cpu;
 
+	if (perf) {
+		for (cpu = 0; cpu < cpu_count; cpu++)
+			msr_perf_update(perf, cpu);
+	}
+
 	hsw_ext_get_count(TSC, &tsc_at_measure_end, base_cpu);
 
 	for (num = 0; num < HSW_EXT_CSTATE_COUNT; num++) {
@@ -165,6 +184,11 @@ static struct cpuidle_monitor *hsw_ext_register(void)
 		current_count[num]  = calloc(cpu_count,
 					sizeof(unsigned long long));
 	}
+	perf = msr_perf_open(hsw_ext_msrs, ARRAY_SIZE(hsw_ext_msrs),
+			     cpu_count);
+	if (perf)
+		intel_hsw_ext_monitor.flags.needs_root = 0;
+
 	intel_hsw_ext_monitor.name_len = strlen(intel_hsw_ext_monitor.name);
 	return &intel_hsw_ext_monitor;
 }
@@ -177,6 +201,7 @@ void hsw_ext_unregister(void)
 		free(previous_count[num]);
 		free(current_count[num]);
 	}
+	msr_perf_close(perf);
 }
 
 struct cpuidle_monitor intel_hsw_ext_monitor = {
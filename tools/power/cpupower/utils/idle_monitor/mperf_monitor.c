@@ -80,11 +80,19 @@ static unsigned long long *aperf_current_count;
 /* valid flag for all CPUs. If a MSR read failed it will be zero */
 static int *is_valid;
 
-static int mperf_get_tsc(unsigned long long *tsc)
+/* Counters read through perf, if available */
+static struct msr_perf *perf;
+static const unsigned int mperf_msrs[] = { MSR_APERF, MSR_MPERF, MSR_TSC };
+
+static int mperf_get_tsc(int cpu, unsigned long long *tsc)
 {
 	int ret;
 
-	ret = read_msr(base_cpu, MSR_TSC, tsc);
+	/* There is no need to use the same TSC for all CPUs with perf */
+	if (perf)
+		ret = msr_perf_get(perf, cpu, MSR_TSC, tsc);
+	else
+		ret = read_msr(base_cpu, MSR_TSC, tsc);
 	if (ret)
 		dprint("Reading TSC MSR failed, returning %llu\n", *tsc);
 	return ret;
@@ -121,6 +129,12 @@ static int get_aperf_mperf(int cpu, unsigned long long *aval,
 		return 0;
 	}
 
+	if (perf) {
+		ret  = msr_perf_get(perf, cpu, MSR_APERF, aval);
+		ret |= msr_perf_get(perf, cpu, MSR_MPERF, mval);
+		return ret;
+	}
+
 	ret  = read_msr(cpu, MSR_APERF, aval);
 	ret |= read_msr(cpu, MSR_MPERF, mval);
 
@@ -229,7 +243,9 @@ static int mperf_start(void)
 	clock_gettime(CLOCK_REALTIME, &time_start);
 
 	for (cpu = 0; cpu < cpu_count; cpu++) {
-		mperf_get_tsc(&tsc_at_measure_start[cpu]);
+		if (perf)
+			msr_perf_update(perf, cpu);
+		mperf_get_tsc(cpu, &tsc_at_measure_start[cpu]);
 		mperf_init_stats(cpu);
 	}
 
@@ -241,8 +257,10 @@ static int mperf_stop(void)
 	int cpu;
 
 	for (cpu = 0; cpu < cpu_count; cpu++) {
+		if (perf)
+			msr_perf_update(perf, cpu);
 		mperf_measure_stats(cpu);
-		mperf_get_tsc(&tsc_at_measure_end[cpu]);
+		mperf_get_tsc(cpu, &tsc_at_measure_end[cpu]);
 	}
 
 	clock_gettime(CLOCK_REALTIME, &time_end);
@@ -338,7 +356,17 @@ struct cpuidle_monitor *mperf_register(void)
 	if (init_maxfreq_mode())
 		return NULL;
 
-	if (cpupower_cpu_info.vendor == X86_VENDOR_AMD)
+	/*
+	 * A group of perf events is read atomically, so there is no need to
+	 * schedule on the CPU whose counters are read then.  RDPRU is cheaper
+	 * still, so keep using it where available.
+	 */
+	if (!(cpupower_cpu_info.caps & CPUPOWER_CAP_AMD_RDPRU))
+		perf = msr_perf_open(mperf_msrs, ARRAY_SIZE(mperf_msrs),
+				     cpu_count);
+	if (perf)
+		mperf_monitor.flags.needs_root = 0;
+	else if (cpupower_cpu_info.vendor == X86_VENDOR_AMD)
 		mperf_monitor.flags.per_cpu_schedule = 1;
 
 	/* Free this at program termination */
@@ -362,6 +390,7 @@ void mperf_unregister(void)
 	free(tsc_at_measure_start);
 	free(tsc_at_measure_end);
 	free(is_valid);
+	msr_perf_close(perf);
 }
 
 struct cpuidle_monitor mperf_monitor = {
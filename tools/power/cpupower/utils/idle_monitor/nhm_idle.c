@@ -67,6 +67,14 @@ static unsigned long long *previous_count[NHM_CSTATE_COUNT];
 static unsigned long long *current_count[NHM_CSTATE_COUNT];
 /* valid flag for all CPUs. If a MSR read failed it will be zero */
 static int *is_valid;
+static struct msr_perf *perf;
+static const unsigned int nhm_msrs[] = {
+	MSR_CORE_C3_RESIDENCY,
+	MSR_CORE_C6_RESIDENCY,
+	MSR_PKG_C3_RESIDENCY,
+	MSR_PKG_C6_RESIDENCY,
+	MSR_TSC,
+};
 
 static int nhm_get_count(enum intel_nhm_id id, unsigned long long *val,
 			unsigned int cpu)
@@ -92,6 +100,8 @@ static int nhm_get_count(enum intel_nhm_id id, unsigned long long *val,
 	default:
 		return -1;
 	}
+	if (perf)
+		return msr_perf_get(perf, cpu, msr, val);
 	if (read_msr(cpu, msr, val))
 		return -1;
 
@@ -128,6 +138,11 @@ static int nhm_start(void)
 	int num, cpu;
 	unsigned long long dbg, val;
 
+	if (perf) {
+		for (cpu = 0; cpu < cpu_count; cpu++)
+			msr_perf_update(perf, cpu);
+	}
+
 	nhm_get_count(TSC, &tsc_at_measure_start, base_cpu);
 
 	for (num = 0; num < NHM_CSTATE_COUNT; num++) {
@@ -147,6 +162,11 @@ static int nhm_stop(void)
 	unsigned long long dbg;
 	int num, cpu;
 
+	if (perf) {
+		for (cpu = 0; cpu < cpu_count; cpu++)
+			msr_perf_update(perf, cpu);
+	}
+
 	nhm_get_count(TSC, &tsc_at_measure_end, base_cpu);
 
 	for (num = 0; num < NHM_CSTATE_COUNT; num++) {
@@ -185,6 +205,11 @@ struct cpuidle_monitor *intel_nhm_register(void)
 					sizeof(unsigned long long));
 	}
 
+	perf = msr_perf_open(nhm_msrs, ARRAY_SIZE(nhm_msrs),
+			     cpu_count);
+	if (perf)
+		intel_nhm_monitor.flags.needs_root = 0;
+
 	intel_nhm_monitor.name_len = strlen(intel_nhm_monitor.name);
 	return &intel_nhm_monitor;
 }
@@ -198,6 +223,7 @@ void intel_nhm_unregister(void)
 		free(current_count[num]);
 	}
 	free(is_valid);
+	msr_perf_close(perf);
 }
 
 struct cpuidle_monitor intel_nhm_monitor = {
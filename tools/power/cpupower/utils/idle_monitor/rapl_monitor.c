@@ -26,6 +26,7 @@ struct powercap_zone *rapl_zones_pt[MAX_RAPL_ZONES] = { 0 };
 
 unsigned long long rapl_zone_previous_count[MAX_RAPL_ZONES];
 unsigned long long rapl_zone_current_count[MAX_RAPL_ZONES];
+unsigned long long rapl_zone_range[MAX_RAPL_ZONES];
 unsigned long long rapl_max_count;
 
 static int rapl_get_count_uj(unsigned int id, unsigned long long *count,
@@ -36,6 +37,9 @@ static int rapl_get_count_uj(unsigned int id, unsigned long long *count,
 		return -1;
 
 	*count = rapl_zone_current_count[id] - rapl_zone_previous_count[id];
+	/* energy_uj wrapped around during the measurement */
+	if (rapl_zone_current_count[id] < rapl_zone_previous_count[id])
+		*count += rapl_zone_range[id];
 
 	return 0;
 }
@@ -61,6 +65,8 @@ static int powercap_count_zones(struct powercap_zone *zone)
 	rapl_zones[rapl_zone_count].range = RANGE_MACHINE;
 	rapl_zones[rapl_zone_count].get_count = rapl_get_count_uj;
 	rapl_zones_pt[rapl_zone_count] = zone;
+	if (powercap_get_max_energy_range_uj(zone, &val) == 0)
+		rapl_zone_range[rapl_zone_count] = val;
 	rapl_zone_count++;
 
 	return 0;
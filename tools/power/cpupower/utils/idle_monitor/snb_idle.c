@@ -56,6 +56,13 @@ static unsigned long long *previous_count[SNB_CSTATE_COUNT];
 static unsigned long long *current_count[SNB_CSTATE_COUNT];
 /* valid flag for all CPUs. If a MSR read failed it will be zero */
 static int *is_valid;
+static struct msr_perf *perf;
+static const unsigned int snb_msrs[] = {
+	MSR_CORE_C7_RESIDENCY,
+	MSR_PKG_C2_RESIDENCY,
+	MSR_PKG_C7_RESIDENCY,
+	MSR_TSC,
+};
 
 static int snb_get_count(enum intel_snb_id id, unsigned long long *val,
 			unsigned int cpu)
@@ -78,6 +85,8 @@ static int snb_get_count(enum intel_snb_id id, unsigned long long *val,
 	default:
 		return -1;
 	}
+	if (perf)
+		return msr_perf_get(perf, cpu, msr, val);
 	if (read_msr(cpu, msr, val))
 		return -1;
 	return 0;
@@ -113,6 +122,11 @@ static int snb_start(void)
 	int num, cpu;
 	unsigned long long val;
 
+	if (perf) {
+		for (cpu = 0; cpu < cpu_count; cpu++)
+			msr_perf_update(perf, cpu);
+	}
+
 	for (num = 0; num < SNB_CSTATE_COUNT; num++) {
 		for (cpu = 0; cpu < cpu_count; cpu++) {
 			snb_get_count(num, &val, cpu);
@@ -128,6 +142,11 @@ static int snb_stop(void)
 	unsigned long long val;
 	int num, cpu;
 
+	if (perf) {
+		for (cpu = 0; cpu < cpu_count; cpu++)
+			msr_perf_update(perf, cpu);
+	}
+
 	snb_get_count(TSC, &tsc_at_measure_end, base_cpu);
 
 	for (num = 0; num < SNB_CSTATE_COUNT; num++) {
@@ -170,6 +189,11 @@ static struct cpuidle_monitor *snb_register(void)
 		current_count[num]  = calloc(cpu_count,
 					sizeof(unsigned long long));
 	}
+	perf = msr_perf_open(snb_msrs, ARRAY_SIZE(snb_msrs),
+			     cpu_count);
+	if (perf)
+		intel_snb_monitor.flags.needs_root = 0;
+
 	intel_snb_monitor.name_len = strlen(intel_snb_monitor.name);
 	return &intel_snb_monitor;
 }
@@ -182,6 +206,7 @@ void snb_unregister(void)
 		free(previous_count[num]);
 		free(current_count[num]);
 	}
+	msr_perf_close(perf);
 }
 
 struct cpuidle_monitor intel_snb_monitor = {
@@ -10,19 +10,36 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 
 #include <getopt.h>
 
 #include "powercap.h"
 #include "helpers/helpers.h"
 
+#define MAX_SAMPLE_ZONES 32
+
 int powercap_show_all;
 
 static struct option info_opts[] = {
 	{ "all",		no_argument,		 NULL,	 'a'},
+	{ "monitor",		no_argument,		 NULL,	 'm'},
+	{ "interval",		required_argument,	 NULL,	 'i'},
+	{ "time",		required_argument,	 NULL,	 't'},
 	{ },
 };
 
+struct sample_zone {
+	struct powercap_zone *zone;
+	uint64_t range;		/* energy_uj wraps around after this */
+	uint64_t last;
+	uint64_t total;		/* uJ */
+	double peak;		/* W */
+};
+
+static struct sample_zone sample_zones[MAX_SAMPLE_ZONES];
+static int sample_zone_count;
+
 static int powercap_print_one_zone(struct powercap_zone *zone)
 {
 	int mode, i, ret = 0;
@@ -86,16 +103,127 @@ static int powercap_show(void)
 	return 0;
 }
 
+static int powercap_add_sample_zone(struct powercap_zone *zone)
+{
+	struct sample_zone *z = &sample_zones[sample_zone_count];
+
+	if (!zone->has_energy_uj || sample_zone_count >= MAX_SAMPLE_ZONES)
+		return 0;
+
+	if (powercap_get_energy_uj(zone, &z->last))
+		return 0;
+
+	if (powercap_get_max_energy_range_uj(zone, &z->range))
+		z->range = 0;
+
+	z->zone = zone;
+	sample_zone_count++;
+	return 0;
+}
+
+static uint64_t powercap_energy_delta(struct sample_zone *z, uint64_t now)
+{
+	if (now >= z->last)
+		return now - z->last;
+
+	/* Wrapped around, at most once as long as the interval is short */
+	return z->range > z->last ? z->range - z->last + now : 0;
+}
+
+static unsigned long long powercap_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/*
+ * Sample the energy counters of all zones every interval_ms for time_s
+ * seconds and print the average and peak power of every zone.  The peak can
+ * only be as fine-grained as the interval and the update rate of the
+ * counters (about 1ms for RAPL).
+ */
+static int powercap_monitor(unsigned int interval_ms, unsigned int time_s)
+{
+	unsigned long long start, last, now;
+	struct powercap_zone *root_zone;
+	char line[MAX_LINE_LEN] = "";
+	struct timespec next;
+	struct sample_zone *z;
+	uint64_t val, delta;
+	unsigned int i;
+	int j;
+
+	if (powercap_get_driver(line, MAX_LINE_LEN) < 0) {
+		printf(_("No powercapping driver loaded\n"));
+		return -1;
+	}
+
+	root_zone = powercap_init_zones();
+	if (root_zone)
+		powercap_walk_zones(root_zone, powercap_add_sample_zone);
+
+	if (!sample_zone_count) {
+		printf(_("No powercap energy counters found\n"));
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	start = last = powercap_now_us();
+
+	for (i = 0; i < time_s * 1000 / interval_ms; i++) {
+		next.tv_nsec += (long)interval_ms * 1000000;
+		while (next.tv_nsec >= 1000000000) {
+			next.tv_nsec -= 1000000000;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+		now = powercap_now_us();
+		for (j = 0; j < sample_zone_count; j++) {
+			z = &sample_zones[j];
+			if (powercap_get_energy_uj(z->zone, &val))
+				continue;
+
+			delta = powercap_energy_delta(z, val);
+			z->total += delta;
+			z->last = val;
+			/* uJ per us are W */
+			if (now > last && (double)delta / (now - last) > z->peak)
+				z->peak = (double)delta / (now - last);
+		}
+		last = now;
+	}
+
+	printf(_("%-32s %10s %10s %12s\n"), _("Zone"), _("avg(W)"),
+	       _("peak(W)"), _("energy(J)"));
+
+	for (j = 0; j < sample_zone_count; j++) {
+		char name[64];
+
+		z = &sample_zones[j];
+		snprintf(name, sizeof(name), "%*s%s",
+			 2 * z->zone->tree_depth, "", z->zone->name);
+		printf("%-32s %10.3f %10.3f %12.3f\n", name,
+		       last > start ? (double)z->total / (last - start) : 0,
+		       z->peak, z->total / 1000000.0);
+	}
+
+	return 0;
+}
+
 int cmd_cap_set(int argc, char **argv)
 {
 	return 0;
 };
 int cmd_cap_info(int argc, char **argv)
 {
-	int ret = 0, cont = 1;
+	unsigned int interval_ms = 100, time_s = 10;
+	int ret = 0, cont = 1, monitor = 0;
 
 	do {
-		ret = getopt_long(argc, argv, "a", info_opts, NULL);
+		ret = getopt_long(argc, argv, "ami:t:", info_opts, NULL);
 		switch (ret) {
 		case '?':
 			cont = 0;
@@ -106,12 +234,29 @@ int cmd_cap_info(int argc, char **argv)
 		case 'a':
 			powercap_show_all = 1;
 			break;
+		case 'm':
+			monitor = 1;
+			break;
+		case 'i':
+			interval_ms = strtoul(optarg, NULL, 10);
+			break;
+		case 't':
+			time_s = strtoul(optarg, NULL, 10);
+			break;
 		default:
 			fprintf(stderr, _("invalid or unknown argument\n"));
 			return EXIT_FAILURE;
 		}
 	} while (cont);
 
+	if (monitor) {
+		if (!interval_ms || !time_s) {
+			fprintf(stderr, _("invalid or unknown argument\n"));
+			return EXIT_FAILURE;
+		}
+		return powercap_monitor(interval_ms, time_s) ? EXIT_FAILURE : 0;
+	}
+
 	powercap_show();
 	return 0;
 }
@@ -3530,7 +3530,7 @@ static inline void update_halt_poll_stats(struct kvm_vcpu *vcpu, ktime_t start,
 	}
 }
 
-static unsigned int kvm_vcpu_max_halt_poll_ns(struct kvm_vcpu *vcpu)
+unsigned int kvm_vcpu_max_halt_poll_ns(struct kvm_vcpu *vcpu)
 {
 	struct kvm *kvm = vcpu->kvm;
 